@@ -66,6 +66,110 @@ struct DedupTuple<std::tuple<>, std::tuple<Results...>> {
   typedef std::tuple<Results...> type;
 };
 
+template <typename Tuple, typename T>
+struct TupleAppend;
+
+template <typename... Types, typename T>
+struct TupleAppend<std::tuple<Types...>, T> {
+  typedef std::tuple<Types..., T> type;
+};
+
+template <
+  template <typename T> typename Dependencies,
+  typename T,
+  typename Path,
+  typename Visited,
+  bool visited = TupleMemberIndex<0, T, Visited>::value != -1,
+  bool in_path = TupleMemberIndex<0, T, Path>::value != -1
+>
+struct TopologicalVisit;
+
+template <
+  template <typename T> typename Dependencies,
+  typename Types,
+  typename Path,
+  typename Visited
+>
+struct TopologicalVisitAll;
+
+template <
+  template <typename T> typename Dependencies,
+  typename Path,
+  typename Visited
+>
+struct TopologicalVisitAll<Dependencies, std::tuple<>, Path, Visited> {
+  typedef Visited type;
+};
+
+template <
+  template <typename T> typename Dependencies,
+  typename T,
+  typename... Rest,
+  typename Path,
+  typename Visited
+>
+struct TopologicalVisitAll<Dependencies, std::tuple<T, Rest...>, Path, Visited>:
+  public TopologicalVisitAll<
+    Dependencies,
+    std::tuple<Rest...>,
+    Path,
+    typename TopologicalVisit<Dependencies, T, Path, Visited>::type
+  >
+{};
+
+// Already visited through another path.
+template <
+  template <typename T> typename Dependencies,
+  typename T,
+  typename Path,
+  typename Visited,
+  bool in_path
+>
+struct TopologicalVisit<Dependencies, T, Path, Visited, true, in_path> {
+  typedef Visited type;
+};
+
+// Reached a type which is still being visited, so the graph has a cycle. The
+// recursion stops here so that the assertion is the only error reported.
+template <
+  template <typename T> typename Dependencies,
+  typename T,
+  typename Path,
+  typename Visited
+>
+struct TopologicalVisit<Dependencies, T, Path, Visited, false, true> {
+  static_assert(
+    TupleMemberIndex<0, T, Path>::value == -1,
+    "Dependency cycle detected. T depends on itself through the types in Path."
+  );
+  typedef Visited type;
+};
+
+template <
+  template <typename T> typename Dependencies,
+  typename T,
+  typename... Path,
+  typename... Visited
+>
+struct TopologicalVisit<
+  Dependencies,
+  T,
+  std::tuple<Path...>,
+  std::tuple<Visited...>,
+  false,
+  false
+> {
+  typedef typename TupleAppend<
+    typename TopologicalVisitAll<
+      Dependencies,
+      typename Dependencies<T>::type,
+      std::tuple<Path..., T>,
+      std::tuple<Visited...>
+    >::type,
+    T
+  >::type type;
+};
+
 }
 
 /**
@@ -152,4 +256,31 @@ struct SanitizeTuple {
 template <typename Tuple>
 using sanitize_tuple_t = typename SanitizeTuple<Tuple>::type;
 
+/**
+ * Orders the members of the tuple and all of their transitive dependencies so
+ * that every type comes after all of the types it depends on. Each type appears
+ * once, and otherwise types are kept in the order they are first reached.
+ *
+ * `Dependencies<T>::type` must be a `std::tuple` of the types `T` directly
+ * depends on. A `static_assert` fails if the dependencies contain a cycle.
+ *
+ * For example, if `A` depends on `B` and `C`, and `B` depends on `C`, then
+ * `topological_sort_t<Dependencies, std::tuple<A>>` is `std::tuple<C, B, A>`.
+ */
+template <template <typename T> typename Dependencies, typename Tuple>
+struct TopologicalSort;
+
+template <template <typename T> typename Dependencies, typename... Types>
+struct TopologicalSort<Dependencies, std::tuple<Types...>> {
+  typedef typename internal::TopologicalVisitAll<
+    Dependencies,
+    std::tuple<Types...>,
+    std::tuple<>,
+    std::tuple<>
+  >::type type;
+};
+
+template <template <typename T> typename Dependencies, typename Tuple>
+using topological_sort_t = typename TopologicalSort<Dependencies, Tuple>::type;
+
 }
@@ -101,5 +101,47 @@ TEST(SanitizeTuple, FlattensDeduplicatesAndDecaysTupleTypes) {
   ));
 }
 
+template <typename... Dependencies>
+struct Node {
+  typedef std::tuple<Dependencies...> dependencies;
+};
+
+template <typename T>
+struct NodeDependencies {
+  typedef typename T::dependencies type;
+};
+
+struct Leaf: public Node<> {};
+struct Middle: public Node<Leaf> {};
+struct Top: public Node<Middle, Leaf> {};
+struct Other: public Node<Leaf> {};
+
+TEST(TopologicalSort, OrdersDependenciesFirst) {
+  EXPECT_TRUE((
+    std::is_same_v<
+      topological_sort_t<NodeDependencies, std::tuple<Top>>,
+      std::tuple<Leaf, Middle, Top>
+    >
+  ));
+}
+
+TEST(TopologicalSort, VisitsSharedDependenciesOnce) {
+  EXPECT_TRUE((
+    std::is_same_v<
+      topological_sort_t<NodeDependencies, std::tuple<Other, Top, Leaf>>,
+      std::tuple<Leaf, Other, Middle, Top>
+    >
+  ));
+}
+
+TEST(TopologicalSort, EmptyTuple) {
+  EXPECT_TRUE((
+    std::is_same_v<
+      topological_sort_t<NodeDependencies, std::tuple<>>,
+      std::tuple<>
+    >
+  ));
+}
+
 }
 }
@@ -2,10 +2,15 @@
 
 #include <atomic>
 #include <coroutine>
+#include <cstddef>
 #include <exception>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "lw/co/scheduler.h"
 #include "lw/err/canonical.h"
@@ -362,17 +367,400 @@ Future<T> make_resolved_future(std::exception_ptr err) {
   return promise.get_future();
 }
 
+// -------------------------------------------------------------------------- //
+
+/**
+ * The result of one of several futures, along with its position in the list of
+ * futures it was awaited with.
+ */
+template <typename T>
+struct IndexedResult {
+  std::size_t index;
+  T value;
+};
+
+template <>
+struct IndexedResult<void> {
+  std::size_t index;
+};
+
+namespace internal {
+
+/**
+ * A coroutine which starts immediately and is not awaited by anything. It
+ * cleans itself up once complete.
+ */
+struct DetachedCoroutine {
+  struct promise_type {
+    DetachedCoroutine get_return_object() { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+/**
+ * Suspends until the future is resolved without taking its value.
+ */
+class SettledAwaitable {
+public:
+  explicit SettledAwaitable(FutureBase& future): _future{future} {}
+
+  bool await_ready() const { return _future.await_ready(); }
+  bool await_suspend(std::coroutine_handle<> handle) {
+    return _future.await_suspend(handle);
+  }
+  void await_resume() const {}
+
+private:
+  FutureBase& _future;
+};
+
+/**
+ * Takes ownership of the future and invokes `callback` with it once it is
+ * resolved. The callback is responsible for taking the value or exception out
+ * of the future and must not throw.
+ */
+template <typename T, typename Callback>
+DetachedCoroutine when_settled(Future<T> future, Callback callback) {
+  co_await SettledAwaitable{future};
+  callback(future);
+}
+
+/**
+ * State shared between a combinator and the futures it is watching. Futures
+ * are watched from the combinator's thread, so no synchronization is needed.
+ */
+struct CombinatorState {
+  /**
+   * How many more futures must settle before the combinator is done. The
+   * meaning of a settlement depends on the combinator.
+   */
+  std::size_t remaining = 0;
+  std::exception_ptr error = nullptr;
+  bool done = false;
+  std::coroutine_handle<> waiter;
+  Scheduler* scheduler = nullptr;
+
+  /**
+   * Marks the combinator as done, resuming it if it is suspended.
+   */
+  void finish() {
+    if (done) return;
+    done = true;
+    if (waiter) scheduler->schedule(waiter);
+  }
+
+  void fail(std::exception_ptr err) {
+    if (done) return;
+    error = err;
+    finish();
+  }
+};
+
+class CombinatorAwaitable {
+public:
+  explicit CombinatorAwaitable(CombinatorState& state): _state{state} {}
+
+  bool await_ready() const { return _state.done; }
+  void await_suspend(std::coroutine_handle<> handle) {
+    _state.scheduler = &Scheduler::this_thread();
+    _state.waiter = handle;
+  }
+  void await_resume() const {
+    if (_state.error) std::rethrow_exception(_state.error);
+  }
+
+private:
+  CombinatorState& _state;
+};
+
+template <typename T>
+IndexedResult<T> take_indexed_result(std::size_t index, Future<T>& future) {
+  if constexpr (std::is_void_v<T>) {
+    future.await_resume();
+    return {.index = index};
+  } else {
+    return {.index = index, .value = future.await_resume()};
+  }
+}
+
+template <typename T>
+struct AllState: public CombinatorState {
+  std::vector<std::optional<T>> values;
+};
+
+template <typename T>
+struct QuorumState: public CombinatorState {
+  std::vector<IndexedResult<T>> results;
+  std::size_t failures_allowed = 0;
+};
+
+template <typename... Args>
+struct AllTupleState: public CombinatorState {
+  std::tuple<std::optional<Args>...> values;
+};
+
+template <typename Iterator, typename Sentinel, typename Func>
+struct ForEachState: public CombinatorState {
+  ForEachState(Iterator begin, Sentinel end, std::size_t limit, Func func):
+    next{std::move(begin)},
+    end{std::move(end)},
+    limit{limit},
+    func{std::move(func)}
+  {}
+
+  /**
+   * Starts calls until the concurrency limit is reached or the range is
+   * exhausted. Futures which are already resolved settle immediately, so this
+   * guards against reentry to keep the stack flat.
+   */
+  void pump(std::shared_ptr<ForEachState> self) {
+    if (pumping) return;
+    pumping = true;
+    while (!error && remaining < limit && next != end) {
+      ++remaining;
+      try {
+        when_settled(func(*next++), [self](auto& future) {
+          try {
+            future.await_resume();
+          } catch (...) {
+            if (!self->error) self->error = std::current_exception();
+          }
+          --self->remaining;
+          self->pump(self);
+        });
+      } catch (...) {
+        --remaining;
+        if (!error) error = std::current_exception();
+      }
+    }
+    pumping = false;
+    if (remaining == 0 && (error || next == end)) finish();
+  }
+
+  Iterator next;
+  Sentinel end;
+  std::size_t limit;
+  Func func;
+  bool pumping = false;
+};
+
+}
+
 /**
  * Await all the provided futures concurrently.
  *
+ * The futures are watched with a single shared counter and the caller is
+ * resumed once, when the last future resolves or as soon as any future is
+ * rejected.
+ *
  * @return
  *  A tuple containing all the resolved values from the futures in the order
  *  they are specified in the arguments.
  */
 template <typename... Args>
+  requires (!std::is_void_v<Args> && ...)
 co::Future<std::tuple<Args...>> all(co::Future<Args>... futures) {
-  // TODO(#14): Implement this method for `co::Future<void>`.
-  co_return std::make_tuple((co_await futures)...);
+  auto state = std::make_shared<internal::AllTupleState<Args...>>();
+  state->remaining = sizeof...(Args);
+  [&]<std::size_t... I>(std::index_sequence<I...>) {
+    (
+      internal::when_settled(std::move(futures), [state](auto& future) {
+        if (state->done) return;
+        try {
+          std::get<I>(state->values).emplace(future.await_resume());
+        } catch (...) {
+          state->fail(std::current_exception());
+          return;
+        }
+        if (--state->remaining == 0) state->finish();
+      }),
+      ...
+    );
+  }(std::index_sequence_for<Args...>{});
+  if (sizeof...(Args) == 0) state->finish();
+
+  co_await internal::CombinatorAwaitable{*state};
+  co_return std::apply(
+    [](auto&... values) { return std::make_tuple(std::move(*values)...); },
+    state->values
+  );
+}
+
+/**
+ * Await all of the futures concurrently, rejecting as soon as any future is
+ * rejected.
+ *
+ * @return
+ *  The resolved values in the same order as the futures.
+ */
+template <typename T>
+  requires (!std::is_void_v<T>)
+co::Future<std::vector<T>> all(std::vector<co::Future<T>> futures) {
+  auto state = std::make_shared<internal::AllState<T>>();
+  state->remaining = futures.size();
+  state->values.resize(futures.size());
+  for (std::size_t i = 0; i < futures.size(); ++i) {
+    internal::when_settled(std::move(futures[i]), [state, i](auto& future) {
+      if (state->done) return;
+      try {
+        state->values[i].emplace(future.await_resume());
+      } catch (...) {
+        state->fail(std::current_exception());
+        return;
+      }
+      if (--state->remaining == 0) state->finish();
+    });
+  }
+  if (futures.empty()) state->finish();
+
+  co_await internal::CombinatorAwaitable{*state};
+  std::vector<T> results;
+  results.reserve(state->values.size());
+  for (std::optional<T>& value : state->values) {
+    results.push_back(std::move(*value));
+  }
+  co_return results;
+}
+
+inline co::Future<void> all(std::vector<co::Future<void>> futures) {
+  auto state = std::make_shared<internal::CombinatorState>();
+  state->remaining = futures.size();
+  for (co::Future<void>& future : futures) {
+    internal::when_settled(std::move(future), [state](auto& future) {
+      if (state->done) return;
+      try {
+        future.await_resume();
+      } catch (...) {
+        state->fail(std::current_exception());
+        return;
+      }
+      if (--state->remaining == 0) state->finish();
+    });
+  }
+  if (futures.empty()) state->finish();
+  co_await internal::CombinatorAwaitable{*state};
+}
+
+template <typename... Futures>
+  requires (sizeof...(Futures) > 0) &&
+    (std::is_same_v<Futures, co::Future<void>> && ...)
+co::Future<void> all(Futures... futures) {
+  std::vector<co::Future<void>> future_list;
+  future_list.reserve(sizeof...(Futures));
+  (future_list.push_back(std::move(futures)), ...);
+  return all(std::move(future_list));
+}
+
+/**
+ * Await the first `count` of the futures to resolve successfully.
+ *
+ * Futures which have not resolved by the time the quorum is reached are left
+ * running and their results are discarded.
+ *
+ * @throw InvalidArgument
+ *  If `count` is greater than the number of futures.
+ *
+ * @return
+ *  The first `count` successful results in the order they resolved. If so many
+ *  futures are rejected that a quorum can no longer be reached, the returned
+ *  future is rejected with the exception that made it impossible.
+ */
+template <typename T>
+co::Future<std::vector<IndexedResult<T>>> quorum(
+  std::vector<co::Future<T>> futures,
+  std::size_t count
+) {
+  if (count > futures.size()) {
+    throw InvalidArgument()
+      << "Cannot reach a quorum of " << count << " with only "
+      << futures.size() << " futures.";
+  }
+
+  auto state = std::make_shared<internal::QuorumState<T>>();
+  state->remaining = count;
+  state->failures_allowed = futures.size() - count;
+  state->results.reserve(count);
+  if (count == 0) state->finish();
+  for (std::size_t i = 0; i < futures.size(); ++i) {
+    internal::when_settled(std::move(futures[i]), [state, i](auto& future) {
+      if (state->done) return;
+      try {
+        state->results.push_back(internal::take_indexed_result(i, future));
+      } catch (...) {
+        if (state->failures_allowed-- == 0) {
+          state->fail(std::current_exception());
+        }
+        return;
+      }
+      if (--state->remaining == 0) state->finish();
+    });
+  }
+
+  co_await internal::CombinatorAwaitable{*state};
+  co_return std::move(state->results);
+}
+
+/**
+ * Await the first of the futures to resolve successfully, such as the fastest
+ * of several replicas.
+ *
+ * @throw InvalidArgument
+ *  If there are no futures.
+ *
+ * @return
+ *  The first successful result. If every future is rejected, the returned
+ *  future is rejected with the last exception.
+ */
+template <typename T>
+co::Future<IndexedResult<T>> when_any(std::vector<co::Future<T>> futures) {
+  std::vector<IndexedResult<T>> results =
+    co_await quorum(std::move(futures), 1);
+  co_return std::move(results.front());
+}
+
+/**
+ * Invokes `func` on every element in `range`, with at most `limit` of the
+ * returned futures unresolved at a time.
+ *
+ * Once any call fails, no more calls are started and the returned future is
+ * rejected with the first exception after all calls in progress finish.
+ *
+ * @param range
+ *  The elements to process. Must outlive the returned future.
+ * @param limit
+ *  The maximum number of concurrent calls.
+ * @param func
+ *  Callable taking an element of the range and returning a `co::Future`.
+ *
+ * @throw InvalidArgument
+ *  If `limit` is 0.
+ */
+template <typename Range, typename Func>
+co::Future<void> for_each_concurrent(
+  Range& range,
+  std::size_t limit,
+  Func func
+) {
+  if (limit == 0) {
+    throw InvalidArgument() << "Concurrency limit must be at least 1.";
+  }
+
+  typedef internal::ForEachState<
+    decltype(std::begin(range)),
+    decltype(std::end(range)),
+    Func
+  > State;
+  auto state = std::make_shared<State>(
+    std::begin(range),
+    std::end(range),
+    limit,
+    std::move(func)
+  );
+  state->pump(state);
+  co_await internal::CombinatorAwaitable{*state};
 }
 
 }
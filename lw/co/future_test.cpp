@@ -1,18 +1,23 @@
 #include "lw/co/future.h"
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "lw/co/scheduler.h"
 #include "lw/co/task.h"
 #include "lw/co/testing/destroy_scheduler.h"
+#include "lw/co/time.h"
 #include "lw/err/canonical.h"
 
 namespace lw::co {
 namespace {
 
 using ::lw::co::testing::destroy_all_schedulers;
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
 
 TEST(PromiseInt, ValueComesThroughFuture) {
@@ -374,29 +379,29 @@ TEST(AwaitAll, AllResolve) {
   destroy_all_schedulers();
 }
 
-// TODO(#14): Implement support for Future<void> in co::all.
-// TEST(AwaitAll, AllVoid) {
-//   int counter = 0;
-//   auto coro0 = [&]() -> Future<void> {
-//     co_await next_tick();
-//     EXPECT_EQ(++counter, 1);
-//   };
-//   auto coro1 = [&]() -> Future<void> {
-//     co_await next_tick();
-//     EXPECT_EQ(++counter, 2);
-//   };
-//   auto coro2 = [&]() -> Future<void> {
-//     co_await next_tick();
-//     EXPECT_EQ(++counter, 3);
-//   };
-
-//   Scheduler::this_thread().schedule([&]() -> Task {
-//     co_await all(coro0(), coro1(), coro2());
-//     EXPECT_EQ(counter, 3);
-//   });
-//   Scheduler::this_thread().run();
-//   destroy_all_schedulers();
-// }
+TEST(AwaitAll, AllVoid) {
+  int counter = 0;
+  auto coro0 = [&]() -> Future<void> {
+    co_await next_tick();
+    EXPECT_EQ(++counter, 1);
+  };
+  auto coro1 = [&]() -> Future<void> {
+    co_await next_tick();
+    EXPECT_EQ(++counter, 2);
+  };
+  auto coro2 = [&]() -> Future<void> {
+    co_await next_tick();
+    EXPECT_EQ(++counter, 3);
+  };
+
+  auto test = [&]() -> Task {
+    co_await all(coro0(), coro1(), coro2());
+    EXPECT_EQ(counter, 3);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
 
 TEST(AwaitAll, ResolveOutOfOrder) {
   int counter = 0;
@@ -429,5 +434,248 @@ TEST(AwaitAll, ResolveOutOfOrder) {
   destroy_all_schedulers();
 }
 
+TEST(AwaitAll, RejectsWithFirstFailure) {
+  auto test = []() -> Task {
+    auto fails = []() -> Future<int> {
+      co_await next_tick();
+      throw Unavailable() << "Backend down.";
+    };
+    auto hangs = []() -> Future<int> {
+      co_await sleep_for(std::chrono::milliseconds(200));
+      co_return 1;
+    };
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_THROW(co_await all(hangs(), fails()), Unavailable);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::milliseconds(200));
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+// -------------------------------------------------------------------------- //
+
+constexpr std::chrono::milliseconds BACKEND_LATENCY{20};
+
+Future<int> fetch_from_backend(int value, int latency_multiple = 1) {
+  co_await sleep_for(BACKEND_LATENCY * latency_multiple);
+  co_return value;
+}
+
+TEST(AwaitAllRange, FansOutInParallel) {
+  auto test = []() -> Task {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Future<int>> requests;
+    for (int i = 0; i < 10; ++i) requests.push_back(fetch_from_backend(i));
+    std::vector<int> results = co_await all(std::move(requests));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_THAT(results, ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+    // Serially this would take 10x the latency.
+    EXPECT_GE(elapsed, BACKEND_LATENCY);
+    EXPECT_LT(elapsed, BACKEND_LATENCY * 5);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(AwaitAllRange, Empty) {
+  auto test = []() -> Task {
+    EXPECT_TRUE((co_await all(std::vector<Future<int>>{})).empty());
+    co_await all(std::vector<Future<void>>{});
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(AwaitAllRange, Void) {
+  int completed = 0;
+  auto test = [&]() -> Task {
+    auto work = [&]() -> Future<void> {
+      co_await sleep_for(BACKEND_LATENCY);
+      ++completed;
+    };
+    std::vector<Future<void>> futures;
+    for (int i = 0; i < 5; ++i) futures.push_back(work());
+    co_await all(std::move(futures));
+    EXPECT_EQ(completed, 5);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(WhenAny, ResolvesWithFastestResult) {
+  auto test = []() -> Task {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Future<int>> replicas;
+    replicas.push_back(fetch_from_backend(10, 5));
+    replicas.push_back(fetch_from_backend(20, 1));
+    replicas.push_back(fetch_from_backend(30, 3));
+    IndexedResult<int> fastest = co_await when_any(std::move(replicas));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(fastest.index, 1);
+    EXPECT_EQ(fastest.value, 20);
+    EXPECT_LT(elapsed, BACKEND_LATENCY * 3);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(WhenAny, SkipsFailures) {
+  auto test = []() -> Task {
+    auto fails = []() -> Future<void> {
+      throw Unavailable() << "Replica down.";
+      co_return;
+    };
+    auto succeeds = []() -> Future<void> {
+      co_await next_tick();
+    };
+    std::vector<Future<void>> replicas;
+    replicas.push_back(fails());
+    replicas.push_back(succeeds());
+    EXPECT_EQ((co_await when_any(std::move(replicas))).index, 1);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(WhenAny, RejectsWhenAllFail) {
+  auto test = []() -> Task {
+    auto fails = []() -> Future<int> {
+      co_await next_tick();
+      throw Unavailable() << "Replica down.";
+    };
+    std::vector<Future<int>> replicas;
+    replicas.push_back(fails());
+    replicas.push_back(fails());
+    EXPECT_THROW(co_await when_any(std::move(replicas)), Unavailable);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(Quorum, ResolvesWithFirstResults) {
+  auto test = []() -> Task {
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Future<int>> replicas;
+    replicas.push_back(fetch_from_backend(10, 1));
+    replicas.push_back(fetch_from_backend(20, 10));
+    replicas.push_back(fetch_from_backend(30, 2));
+    std::vector<IndexedResult<int>> results =
+      co_await quorum(std::move(replicas), 2);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(results.size(), 2);
+    if (results.size() == 2) {
+      EXPECT_EQ(results[0].index, 0);
+      EXPECT_EQ(results[0].value, 10);
+      EXPECT_EQ(results[1].index, 2);
+      EXPECT_EQ(results[1].value, 30);
+    }
+    EXPECT_LT(elapsed, BACKEND_LATENCY * 10);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(Quorum, RejectsOnceUnreachable) {
+  auto test = []() -> Task {
+    auto fails = []() -> Future<int> {
+      co_await next_tick();
+      throw Unavailable() << "Replica down.";
+    };
+    std::vector<Future<int>> replicas;
+    replicas.push_back(fails());
+    replicas.push_back(fetch_from_backend(1));
+    replicas.push_back(fails());
+    EXPECT_THROW(co_await quorum(std::move(replicas), 2), Unavailable);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(Quorum, RejectsImpossibleQuorum) {
+  auto test = []() -> Task {
+    std::vector<Future<int>> replicas;
+    replicas.push_back(make_resolved_future(1));
+    EXPECT_THROW(co_await quorum(std::move(replicas), 2), InvalidArgument);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+}
+
+TEST(ForEachConcurrent, LimitsConcurrency) {
+  std::vector<int> items{1, 2, 3, 4, 5, 6};
+  int in_progress = 0;
+  int max_in_progress = 0;
+  int sum = 0;
+  auto test = [&]() -> Task {
+    const auto start = std::chrono::steady_clock::now();
+    co_await for_each_concurrent(items, 2, [&](int item) -> Future<void> {
+      max_in_progress = std::max(max_in_progress, ++in_progress);
+      co_await sleep_for(BACKEND_LATENCY);
+      --in_progress;
+      sum += item;
+    });
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // Three batches of two.
+    EXPECT_GE(elapsed, BACKEND_LATENCY * 3);
+    EXPECT_LT(elapsed, BACKEND_LATENCY * 6);
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+
+  EXPECT_EQ(max_in_progress, 2);
+  EXPECT_EQ(in_progress, 0);
+  EXPECT_EQ(sum, 21);
+}
+
+TEST(ForEachConcurrent, HandlesSynchronousResults) {
+  std::vector<int> items(10'000, 1);
+  int sum = 0;
+  auto test = [&]() -> Task {
+    co_await for_each_concurrent(items, 4, [&](int item) {
+      sum += item;
+      return make_resolved_future();
+    });
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+  EXPECT_EQ(sum, 10'000);
+}
+
+TEST(ForEachConcurrent, StopsAfterFailure) {
+  std::vector<int> items{1, 2, 3, 4, 5, 6};
+  int started = 0;
+  auto test = [&]() -> Task {
+    EXPECT_THROW(
+      co_await for_each_concurrent(items, 2, [&](int item) -> Future<void> {
+        ++started;
+        co_await next_tick();
+        if (item == 2) throw Unavailable() << "Item " << item << " failed.";
+      }),
+      Unavailable
+    );
+  };
+  Scheduler::this_thread().schedule(test);
+  Scheduler::this_thread().run();
+  destroy_all_schedulers();
+  EXPECT_LT(started, 6);
+}
+
 }
 }
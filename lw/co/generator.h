@@ -19,16 +19,36 @@ public:
   using handle_type = std::coroutine_handle<promise_type>;
 
   explicit Generator(handle_type handle) : _handle{std::move(handle)} {}
-  ~Generator() = default;
+  ~Generator() {
+    if (_handle) _handle.destroy();
+  }
 
-  Generator(Generator&&) = default;
-  Generator& operator=(Generator&&) = default;
+  Generator(Generator&& other):
+    _handle{std::exchange(other._handle, nullptr)}
+  {}
+  Generator& operator=(Generator&& other) {
+    if (this != &other) {
+      if (_handle) _handle.destroy();
+      _handle = std::exchange(other._handle, nullptr);
+    }
+    return *this;
+  }
 
   Generator(const Generator&) = delete;
   Generator& operator=(const Generator&) = delete;
 
+  /**
+   * Resumes the generator until it yields its next value or returns.
+   *
+   * @throw
+   *  Whatever the generator threw instead of yielding.
+   */
   bool next() {
+    if (_handle.done()) return false;
     _handle.resume();
+    if (_handle.promise()._exception) {
+      std::rethrow_exception(std::exchange(_handle.promise()._exception, {}));
+    }
     return !_handle.done();
   }
 
@@ -69,10 +89,11 @@ public:
     return std::suspend_always{};
   }
 
-  void unhandled_exception() { std::terminate(); }
+  void unhandled_exception() { _exception = std::current_exception(); }
 
 private:
   std::unique_ptr<T> _current_value;
+  std::exception_ptr _exception;
   friend class Generator<T>;
 };
 
@@ -1,5 +1,7 @@
 #include "lw/co/generator.h"
 
+#include <stdexcept>
+
 #include "gtest/gtest.h"
 #include "lw/co/future.h"
 #include "lw/co/scheduler.h"
@@ -14,6 +16,11 @@ Generator<int> yield_some() {
   co_yield 2;
 }
 
+Generator<int> yield_then_throw() {
+  co_yield 1;
+  throw std::runtime_error("Generator failed.");
+}
+
 Future<int> await_some(int x) {
   co_await next_tick();
   co_return x;
@@ -43,6 +50,14 @@ TEST(Generator, RangeForGeneration) {
   EXPECT_EQ(expected, 2);
 }
 
+TEST(Generator, RethrowsFromNext) {
+  auto gen = yield_then_throw();
+  ASSERT_TRUE(gen.next());
+  EXPECT_EQ(gen.value(), 1);
+  EXPECT_THROW(gen.next(), std::runtime_error);
+  EXPECT_FALSE(gen.next());
+}
+
 TEST(AsyncGenerator, AsyncGeneration) {
   Scheduler::this_thread().schedule([]() -> Task {
     auto gen = yield_async();
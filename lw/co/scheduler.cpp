@@ -1,11 +1,17 @@
 #include "lw/co/scheduler.h"
 
+#include <algorithm>
+#include <atomic>
 #include <coroutine>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <sys/eventfd.h>
 #include <thread>
 #include <unistd.h>
 #include <unordered_map>
+#include <vector>
 
 #include "lw/co/events.h"
 #include "lw/co/systems/epoll.h"
@@ -28,6 +34,15 @@ static std::unordered_map<
   std::thread::id,
   std::unique_ptr<Scheduler>
 > thread_schedulers;
+static std::mutex thread_schedulers_mutex;
+
+// Bumped whenever schedulers are destroyed, invalidating every thread's cached
+// scheduler.
+static std::atomic<std::uint64_t> thread_schedulers_generation = 0;
+
+// This thread's scheduler, cached so `this_thread` only locks to create it.
+thread_local Scheduler* this_thread_scheduler = nullptr;
+thread_local std::uint64_t this_thread_scheduler_generation = 0;
 
 Handle create_eventfd() {
   Handle fd = ::eventfd(/*initval=*/0, EFD_NONBLOCK);
@@ -59,10 +74,14 @@ void ping_eventfd(Handle fd) {
 namespace testing {
 
 void destroy_all_schedulers() {
+  std::lock_guard<std::mutex> lock{thread_schedulers_mutex};
+  ++thread_schedulers_generation;
   thread_schedulers.clear();
 }
 
 void destroy_scheduler(std::thread::id thread_id) {
+  std::lock_guard<std::mutex> lock{thread_schedulers_mutex};
+  ++thread_schedulers_generation;
   thread_schedulers.erase(thread_id);
 }
 
@@ -83,9 +102,21 @@ Scheduler::~Scheduler() {
     ::close(_queue_notification_fd);
     _queue_notification_fd = 0;
   }
+  if (_remote_notification_fd) {
+    ::close(_remote_notification_fd);
+    _remote_notification_fd = 0;
+  }
 }
 
 Scheduler& Scheduler::this_thread() {
+  if (
+    this_thread_scheduler &&
+    this_thread_scheduler_generation == thread_schedulers_generation
+  ) {
+    return *this_thread_scheduler;
+  }
+
+  std::lock_guard<std::mutex> lock{thread_schedulers_mutex};
   auto itr = thread_schedulers.find(std::this_thread::get_id());
   if (itr == thread_schedulers.end()) {
     auto [new_itr, existed] = thread_schedulers.insert({
@@ -95,10 +126,13 @@ Scheduler& Scheduler::this_thread() {
     itr = new_itr;
   }
 
+  this_thread_scheduler = itr->second.get();
+  this_thread_scheduler_generation = thread_schedulers_generation;
   return *itr->second;
 }
 
 Scheduler& Scheduler::for_thread(std::thread::id thread_id) {
+  std::lock_guard<std::mutex> lock{thread_schedulers_mutex};
   auto itr = thread_schedulers.find(thread_id);
   if (itr == thread_schedulers.end()) {
     throw NotFound() << "Thread " << thread_id << " does not have a scheduler.";
@@ -114,13 +148,40 @@ void Scheduler::schedule(
   _schedule(handle, events, [coro]() { coro.resume(); });
 }
 
+void Scheduler::expect_remote_schedule() {
+  {
+    std::lock_guard<std::mutex> lock{_remote_mutex};
+    ++_remote_expected;
+  }
+  _schedule_remote_drain();
+}
+
+void Scheduler::schedule_remote(
+  std::span<const std::coroutine_handle<>> coros
+) {
+  if (coros.empty()) return;
+  Handle notification_fd = 0;
+  {
+    std::lock_guard<std::mutex> lock{_remote_mutex};
+    _remote_queue.insert(_remote_queue.end(), coros.begin(), coros.end());
+    notification_fd = _remote_notification_fd;
+  }
+  // The notification fd is created by `expect_remote_schedule` on the owning
+  // thread. Without it there is nothing to wake, and the coroutines will be
+  // picked up once it is created.
+  if (notification_fd) ping_eventfd(notification_fd);
+}
+
 void Scheduler::run() {
   _continue_polling = true;
-  auto itr = thread_schedulers.find(std::this_thread::get_id());
-  if (itr == thread_schedulers.end() || itr->second.get() != this) {
-    throw FailedPrecondition()
-      << "Cannot call Scheduler::run from a thread other than the one that "
-         "created it.";
+  {
+    std::lock_guard<std::mutex> lock{thread_schedulers_mutex};
+    auto itr = thread_schedulers.find(std::this_thread::get_id());
+    if (itr == thread_schedulers.end() || itr->second.get() != this) {
+      throw FailedPrecondition()
+        << "Cannot call Scheduler::run from a thread other than the one that "
+           "created it.";
+    }
   }
 
   while (_continue_polling && _epoll->has_pending_items()) _epoll->wait();
@@ -155,6 +216,44 @@ void Scheduler::_schedule_queue_drain() {
   ping_eventfd(_queue_notification_fd);
 }
 
+void Scheduler::_schedule_remote_drain() {
+  if (_remote_drain_scheduled) return;
+  if (!_remote_notification_fd) {
+    Handle fd = create_eventfd();
+    std::lock_guard<std::mutex> lock{_remote_mutex};
+    _remote_notification_fd = fd;
+    // Wake up for anything queued before the fd existed.
+    if (!_remote_queue.empty()) ping_eventfd(fd);
+  }
+
+  // One-shot keeps the registration counted by epoll as pending work for as
+  // long as remote coroutines are expected, and is re-armed after each drain.
+  _schedule(
+    _remote_notification_fd,
+    Event::READABLE | Event::ONE_SHOT,
+    [this]() { _drain_remote_queue(); }
+  );
+  _remote_drain_scheduled = true;
+}
+
+void Scheduler::_drain_remote_queue() {
+  _remote_drain_scheduled = false;
+  clear_eventfd(_remote_notification_fd);
+
+  std::vector<std::coroutine_handle<>> coros;
+  bool expecting_more = false;
+  {
+    std::lock_guard<std::mutex> lock{_remote_mutex};
+    coros.swap(_remote_queue);
+    _remote_expected -= std::min(_remote_expected, coros.size());
+    expecting_more = _remote_expected > 0;
+  }
+
+  // Re-arm before resuming in case a resumed coroutine expects more.
+  if (expecting_more) _schedule_remote_drain();
+  for (std::coroutine_handle<> coro : coros) coro.resume();
+}
+
 void Scheduler::_schedule(
   Handle handle,
   Event events,
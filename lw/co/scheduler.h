@@ -5,7 +5,9 @@
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <span>
 #include <thread>
 #include <vector>
 
@@ -96,6 +98,25 @@ public:
    */
   void schedule(std::coroutine_handle<> coro, Handle handle, Event events);
 
+  /**
+   * Registers that another thread will hand a coroutine to `schedule_remote`.
+   * Until that happens the event loop will keep running even if it has nothing
+   * else to do. Must be called from the scheduler's own thread, once per
+   * coroutine that will be remotely scheduled.
+   */
+  void expect_remote_schedule();
+
+  /**
+   * Schedules the coroutines for resumption on this scheduler's thread. Unlike
+   * `schedule`, this is safe to call from any thread and does not consume slots
+   * in the task queue. Each coroutine should be preceded by a call to
+   * `expect_remote_schedule`.
+   */
+  void schedule_remote(std::span<const std::coroutine_handle<>> coros);
+  void schedule_remote(std::coroutine_handle<> coro) {
+    schedule_remote(std::span<const std::coroutine_handle<>>{&coro, 1});
+  }
+
   /**
    * Runs the event loop until it is empty or stop is called.
    */
@@ -111,12 +132,20 @@ private:
 
   void _add_to_queue(std::coroutine_handle<> coro);
   void _schedule_queue_drain();
+  void _schedule_remote_drain();
+  void _drain_remote_queue();
   void _schedule(Handle handle, Event events, std::function<void()> func);
 
   std::atomic_bool _continue_polling = true;
   std::unique_ptr<internal::EPoll> _epoll;
   CircularQueue<std::coroutine_handle<>> _coro_queue;
   Handle _queue_notification_fd = 0;
+
+  std::mutex _remote_mutex;
+  std::vector<std::coroutine_handle<>> _remote_queue;
+  std::size_t _remote_expected = 0;
+  bool _remote_drain_scheduled = false;
+  Handle _remote_notification_fd = 0;
 };
 
 // -------------------------------------------------------------------------- //
@@ -39,6 +39,15 @@ protected:
   }
 };
 
+TEST_F(SchedulerTest, ThisThreadAfterDestroy) {
+  Scheduler& first = Scheduler::this_thread();
+  EXPECT_EQ(&Scheduler::this_thread(), &first);
+
+  testing::destroy_this_scheduler();
+  Scheduler& second = Scheduler::this_thread();
+  EXPECT_EQ(&Scheduler::for_thread(std::this_thread::get_id()), &second);
+}
+
 TEST_F(SchedulerTest, StartAndStop) {
   std::atomic_int ticks = 0;
   std::atomic_int* ticks_ptr = &ticks;
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+
+namespace lw::co {
+
+/**
+ * A lockable which does nothing. Used by `SingleFlight` when all callers share
+ * a single thread.
+ */
+struct NullMutex {
+  void lock() {}
+  void unlock() {}
+};
+
+/**
+ * Deduplicates concurrent computations of the same key.
+ *
+ * The first caller of `run` for a key invokes its function and becomes the
+ * leader of that key's flight. Any calls for the same key made before the
+ * leader's future resolves wait for that result instead of invoking their own
+ * function. Once the flight lands the key is forgotten, so later calls start a
+ * new flight.
+ *
+ * ```cpp
+ *  co::SingleFlight<std::string, UserProfile> profile_fetches;
+ *
+ *  co::Future<UserProfile> get_profile(std::string user_id) {
+ *    return profile_fetches.run(user_id, [user_id]() {
+ *      return backend.fetch_profile(user_id);
+ *    });
+ *  }
+ * ```
+ *
+ * Every waiter receives its own copy of the result, so results which are
+ * expensive to copy should be wrapped in a `std::shared_ptr<const T>`. If the
+ * leader's computation throws, the exception is rethrown to every waiter.
+ *
+ * With the default `NullMutex`, all callers must be on the same thread. Use
+ * `std::mutex` to share flights between threads, in which case each waiter is
+ * resumed on the scheduler of the thread it called `run` from.
+ *
+ * The `SingleFlight` must outlive all flights started on it.
+ *
+ * @tparam Key
+ *  The type identifying computations. Must be hashable by `Hash` and copyable.
+ * @tparam T
+ *  The result type of the computations.
+ * @tparam Mutex
+ *  The lock protecting the set of in-flight keys.
+ */
+template <
+  typename Key,
+  typename T,
+  typename Mutex = NullMutex,
+  typename Hash = std::hash<Key>
+>
+class SingleFlight {
+public:
+  static_assert(
+    !std::is_void_v<T>,
+    "SingleFlight requires a result type. Use a placeholder such as bool for "
+    "computations with no result."
+  );
+
+  SingleFlight() = default;
+  SingleFlight(SingleFlight&&) = default;
+  SingleFlight& operator=(SingleFlight&&) = default;
+  SingleFlight(const SingleFlight&) = delete;
+  SingleFlight& operator=(const SingleFlight&) = delete;
+
+  /**
+   * Returns the result of the flight for `key`, invoking `func` to start one
+   * if there is none in progress.
+   *
+   * @param key
+   *  The identity of the computation.
+   * @param func
+   *  A callable returning `Future<T>`. It is only invoked if this call becomes
+   *  the leader, and is kept alive until the flight lands so it is safe for it
+   *  to be a coroutine lambda with captures.
+   */
+  template <typename Func>
+  Future<T> run(Key key, Func func);
+
+  /**
+   * Returns true if a computation for `key` is currently in progress.
+   */
+  bool in_flight(const Key& key) const {
+    std::lock_guard<Mutex> lock{_mutex};
+    return _flights.contains(key);
+  }
+
+  /**
+   * Returns the number of keys with a computation in progress.
+   */
+  std::size_t size() const {
+    std::lock_guard<Mutex> lock{_mutex};
+    return _flights.size();
+  }
+
+private:
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    Scheduler* scheduler;
+  };
+
+  struct Flight {
+    std::optional<T> value;
+    std::exception_ptr error = nullptr;
+    bool landed = false;
+    std::vector<Waiter> waiters;
+  };
+
+  class FlightAwaitable {
+  public:
+    FlightAwaitable(Mutex& mutex, std::shared_ptr<Flight> flight):
+      _mutex{mutex},
+      _flight{std::move(flight)}
+    {}
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      Scheduler& scheduler = Scheduler::this_thread();
+      std::lock_guard<Mutex> lock{_mutex};
+      if (_flight->landed) return false;
+
+      // Waiters are always resumed through the thread-safe remote queue. This
+      // also lets the leader wake any number of waiters on a scheduler with a
+      // single notification instead of one task queue slot each.
+      scheduler.expect_remote_schedule();
+      _flight->waiters.push_back({.handle = handle, .scheduler = &scheduler});
+      return true;
+    }
+
+    T await_resume() {
+      if (_flight->error) std::rethrow_exception(_flight->error);
+      return *_flight->value;
+    }
+
+  private:
+    Mutex& _mutex;
+    std::shared_ptr<Flight> _flight;
+  };
+
+  void _land(const Key& key, Flight& flight);
+
+  mutable Mutex _mutex;
+  std::unordered_map<Key, std::shared_ptr<Flight>, Hash> _flights;
+};
+
+// -------------------------------------------------------------------------- //
+
+template <typename Key, typename T, typename Mutex, typename Hash>
+template <typename Func>
+Future<T> SingleFlight<Key, T, Mutex, Hash>::run(Key key, Func func) {
+  std::shared_ptr<Flight> flight;
+  bool leader = false;
+  {
+    std::lock_guard<Mutex> lock{_mutex};
+    auto [itr, inserted] = _flights.try_emplace(key);
+    if (inserted) itr->second = std::make_shared<Flight>();
+    flight = itr->second;
+    leader = inserted;
+  }
+
+  if (!leader) co_return co_await FlightAwaitable{_mutex, std::move(flight)};
+
+  try {
+    flight->value.emplace(co_await func());
+  } catch (...) {
+    flight->error = std::current_exception();
+  }
+  _land(key, *flight);
+
+  if (flight->error) std::rethrow_exception(flight->error);
+  co_return T{*flight->value};
+}
+
+template <typename Key, typename T, typename Mutex, typename Hash>
+void SingleFlight<Key, T, Mutex, Hash>::_land(const Key& key, Flight& flight) {
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<Mutex> lock{_mutex};
+    flight.landed = true;
+    waiters.swap(flight.waiters);
+    _flights.erase(key);
+  }
+
+  // Hand each scheduler all of its waiters in one batch, preserving the order
+  // they arrived in.
+  std::vector<std::coroutine_handle<>> batch;
+  batch.reserve(waiters.size());
+  while (!waiters.empty()) {
+    Scheduler* scheduler = waiters.front().scheduler;
+    batch.clear();
+    std::erase_if(waiters, [&](const Waiter& waiter) {
+      if (waiter.scheduler != scheduler) return false;
+      batch.push_back(waiter.handle);
+      return true;
+    });
+    scheduler->schedule_remote(batch);
+  }
+}
+
+}
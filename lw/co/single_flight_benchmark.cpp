@@ -0,0 +1,90 @@
+#include "lw/co/single_flight.h"
+
+#include <mutex>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+
+namespace lw::co {
+namespace {
+
+/**
+ * Starts `waiters` concurrent requests for the same key while the backend
+ * fetch is outstanding, then awaits them all.
+ */
+template <typename Flight>
+Task thundering_herd(Flight& flight, int waiters, int& fetches) {
+  auto fetch = [&fetches]() -> Future<int> {
+    ++fetches;
+    co_await next_tick();
+    co_return 42;
+  };
+
+  std::vector<Future<int>> results;
+  results.reserve(waiters);
+  for (int i = 0; i < waiters; ++i) results.push_back(flight.run(0, fetch));
+
+  int sum = 0;
+  for (Future<int>& result : results) sum += co_await result;
+  benchmark::DoNotOptimize(sum);
+}
+
+template <typename Mutex>
+void BM_SingleFlightThunderingHerd(benchmark::State& state) {
+  const int waiters = static_cast<int>(state.range(0));
+  SingleFlight<int, int, Mutex> flight;
+  int fetches = 0;
+  for (auto _ : state) {
+    auto herd = [&]() { return thundering_herd(flight, waiters, fetches); };
+    Scheduler::this_thread().schedule(herd);
+    Scheduler::this_thread().run();
+  }
+  state.counters["fetches_per_herd"] =
+    static_cast<double>(fetches) / state.iterations();
+  state.SetItemsProcessed(state.iterations() * waiters);
+}
+BENCHMARK_TEMPLATE(BM_SingleFlightThunderingHerd, NullMutex)
+  ->RangeMultiplier(10)->Range(1, 10'000);
+BENCHMARK_TEMPLATE(BM_SingleFlightThunderingHerd, std::mutex)
+  ->RangeMultiplier(10)->Range(1, 10'000);
+
+/**
+ * Baseline for comparison: every request performs its own backend fetch.
+ */
+Task uncoalesced_herd(int waiters, int& fetches) {
+  auto fetch = [&fetches]() -> Future<int> {
+    ++fetches;
+    co_await next_tick();
+    co_return 42;
+  };
+
+  std::vector<Future<int>> results;
+  results.reserve(waiters);
+  for (int i = 0; i < waiters; ++i) results.push_back(fetch());
+
+  int sum = 0;
+  for (Future<int>& result : results) sum += co_await result;
+  benchmark::DoNotOptimize(sum);
+}
+
+void BM_UncoalescedHerd(benchmark::State& state) {
+  const int waiters = static_cast<int>(state.range(0));
+  int fetches = 0;
+  for (auto _ : state) {
+    auto herd = [&]() { return uncoalesced_herd(waiters, fetches); };
+    Scheduler::this_thread().schedule(herd);
+    Scheduler::this_thread().run();
+  }
+  state.counters["fetches_per_herd"] =
+    static_cast<double>(fetches) / state.iterations();
+  state.SetItemsProcessed(state.iterations() * waiters);
+}
+// Each uncoalesced fetch occupies a task queue slot, so this is capped below
+// the default `lw_scheduler_queue_size`.
+BENCHMARK(BM_UncoalescedHerd)->RangeMultiplier(10)->Range(1, 100);
+
+}
+}
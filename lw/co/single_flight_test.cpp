@@ -0,0 +1,174 @@
+#include "lw/co/single_flight.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/co/testing/destroy_scheduler.h"
+#include "lw/co/time.h"
+#include "lw/err/canonical.h"
+
+namespace lw::co {
+namespace {
+
+class SingleFlightTest: public ::testing::Test {
+protected:
+  ~SingleFlightTest() noexcept {
+    testing::destroy_all_schedulers();
+  }
+
+  template <typename Func>
+  void run(Func&& coroutine) {
+    Scheduler::this_thread().schedule(std::forward<Func>(coroutine));
+    Scheduler::this_thread().run();
+  }
+};
+
+TEST_F(SingleFlightTest, CoalescesConcurrentCalls) {
+  SingleFlight<std::string, int> flight;
+  int invocations = 0;
+  std::vector<int> results;
+
+  auto fetch = [&]() -> Future<int> {
+    ++invocations;
+    co_await next_tick();
+    co_return 42;
+  };
+  auto caller = [&]() -> Task {
+    results.push_back(co_await flight.run("foo", fetch));
+  };
+  Scheduler::this_thread().schedule(caller);
+  Scheduler::this_thread().schedule(caller);
+  Scheduler::this_thread().schedule(caller);
+  Scheduler::this_thread().run();
+
+  EXPECT_EQ(invocations, 1);
+  EXPECT_EQ(results, (std::vector<int>{42, 42, 42}));
+  EXPECT_EQ(flight.size(), 0);
+}
+
+TEST_F(SingleFlightTest, TracksKeysInFlight) {
+  SingleFlight<int, int> flight;
+  run([&]() -> Task {
+    Future<int> result = flight.run(1, []() -> Future<int> {
+      co_await next_tick();
+      co_return 1;
+    });
+    EXPECT_TRUE(flight.in_flight(1));
+    EXPECT_FALSE(flight.in_flight(2));
+    EXPECT_EQ(co_await result, 1);
+    EXPECT_FALSE(flight.in_flight(1));
+  });
+}
+
+TEST_F(SingleFlightTest, DistinctKeysRunIndependently) {
+  SingleFlight<int, int> flight;
+  int invocations = 0;
+  run([&]() -> Task {
+    auto fetch = [&](int value) {
+      return [&invocations, value]() -> Future<int> {
+        ++invocations;
+        co_await next_tick();
+        co_return value;
+      };
+    };
+    Future<int> one = flight.run(1, fetch(1));
+    Future<int> two = flight.run(2, fetch(2));
+    EXPECT_EQ(co_await one, 1);
+    EXPECT_EQ(co_await two, 2);
+  });
+  EXPECT_EQ(invocations, 2);
+}
+
+TEST_F(SingleFlightTest, StartsNewFlightAfterLanding) {
+  SingleFlight<int, int> flight;
+  int invocations = 0;
+  run([&]() -> Task {
+    auto fetch = [&]() -> Future<int> { co_return ++invocations; };
+    EXPECT_EQ(co_await flight.run(1, fetch), 1);
+    EXPECT_EQ(co_await flight.run(1, fetch), 2);
+  });
+  EXPECT_EQ(invocations, 2);
+}
+
+TEST_F(SingleFlightTest, PropagatesExceptionsToAllWaiters) {
+  SingleFlight<int, int> flight;
+  int failures = 0;
+  auto caller = [&]() -> Task {
+    try {
+      co_await flight.run(1, []() -> Future<int> {
+        co_await next_tick();
+        throw Unavailable() << "Backend down.";
+      });
+    } catch (const Unavailable&) {
+      ++failures;
+    }
+  };
+  Scheduler::this_thread().schedule(caller);
+  Scheduler::this_thread().schedule(caller);
+  Scheduler::this_thread().run();
+
+  EXPECT_EQ(failures, 2);
+  EXPECT_FALSE(flight.in_flight(1));
+}
+
+TEST_F(SingleFlightTest, SharesResultsAcrossThreads) {
+  SingleFlight<int, int, std::mutex> flight;
+  std::atomic_int invocations = 0;
+  std::atomic_bool leader_started = false;
+  std::atomic_bool waiter_joined = false;
+  std::thread::id waiter_thread_id;
+  std::thread::id waiter_resumed_on;
+  int leader_result = 0;
+  int waiter_result = 0;
+
+  std::jthread leader{[&]() {
+    auto lead = [&]() -> Task {
+      leader_result = co_await flight.run(7, [&]() -> Future<int> {
+        ++invocations;
+        leader_started = true;
+        // Hold the flight open until the other thread has joined it.
+        while (!waiter_joined) {
+          co_await sleep_for(std::chrono::milliseconds(1));
+        }
+        co_return 99;
+      });
+    };
+    Scheduler::this_thread().schedule(lead);
+    Scheduler::this_thread().run();
+  }};
+
+  while (!leader_started) std::this_thread::yield();
+
+  std::jthread waiter{[&]() {
+    auto wait = [&]() -> Task {
+      waiter_thread_id = std::this_thread::get_id();
+      Future<int> result = flight.run(7, [&]() -> Future<int> {
+        ++invocations;
+        co_return -1;
+      });
+      waiter_joined = true;
+      waiter_result = co_await result;
+      waiter_resumed_on = std::this_thread::get_id();
+    };
+    Scheduler::this_thread().schedule(wait);
+    Scheduler::this_thread().run();
+  }};
+
+  leader.join();
+  waiter.join();
+  EXPECT_EQ(invocations, 1);
+  EXPECT_EQ(leader_result, 99);
+  EXPECT_EQ(waiter_result, 99);
+  EXPECT_EQ(waiter_resumed_on, waiter_thread_id);
+}
+
+}
+}
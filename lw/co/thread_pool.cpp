@@ -0,0 +1,60 @@
+#include "lw/co/thread_pool.h"
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "lw/err/canonical.h"
+
+namespace lw::co {
+
+ThreadPool::ThreadPool(std::size_t threads) {
+  if (threads == 0) {
+    throw InvalidArgument() << "Thread pools must have at least one thread.";
+  }
+  _threads.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    _threads.emplace_back([this]() { _work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _stopping = true;
+  }
+  _work_ready.notify_all();
+  for (std::thread& thread : _threads) thread.join();
+}
+
+std::size_t ThreadPool::queued() const {
+  std::lock_guard<std::mutex> lock{_mutex};
+  return _queue.size();
+}
+
+void ThreadPool::_post(std::function<void()> work) {
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    _queue.push_back(std::move(work));
+  }
+  _work_ready.notify_one();
+}
+
+void ThreadPool::_work() {
+  while (true) {
+    std::function<void()> work;
+    {
+      std::unique_lock<std::mutex> lock{_mutex};
+      _work_ready.wait(lock, [&]() { return _stopping || !_queue.empty(); });
+      // Queued work is still finished when stopping, as the coroutines waiting
+      // on it keep their schedulers running until they are resumed.
+      if (_queue.empty()) return;
+      work = std::move(_queue.front());
+      _queue.pop_front();
+    }
+    work();
+  }
+}
+
+}
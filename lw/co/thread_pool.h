@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+
+namespace lw::co {
+
+/**
+ * A fixed set of worker threads for running blocking or CPU heavy work off of
+ * the scheduler threads.
+ *
+ * ```cpp
+ *  co::ThreadPool pool{4};
+ *
+ *  co::Future<Digest> hash_file(std::string contents) {
+ *    co_return co_await pool.run([&]() { return sha256(contents); });
+ *  }
+ * ```
+ *
+ * The coroutine awaiting `run` is resumed on the scheduler of the thread it
+ * called `run` from, so the work must not touch state that thread's other
+ * coroutines may use while it is running.
+ *
+ * Destroying the pool finishes all queued work before joining the workers.
+ */
+class ThreadPool {
+public:
+  /**
+   * @param threads
+   *  Number of worker threads to start. Must be at least 1.
+   */
+  explicit ThreadPool(std::size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Invokes `func` on one of the pool's threads and resolves with its result.
+   * Exceptions thrown by `func` are rethrown to the awaiting coroutine.
+   */
+  template <typename Func>
+  Future<std::invoke_result_t<Func&>> run(Func func);
+
+  /**
+   * Number of worker threads in the pool.
+   */
+  std::size_t size() const { return _threads.size(); }
+
+  /**
+   * Number of work items waiting for a free worker.
+   */
+  std::size_t queued() const;
+
+private:
+  template <typename Func>
+  class RunAwaitable;
+
+  void _post(std::function<void()> work);
+  void _work();
+
+  mutable std::mutex _mutex;
+  std::condition_variable _work_ready;
+  std::deque<std::function<void()>> _queue;
+  bool _stopping = false;
+  std::vector<std::thread> _threads;
+};
+
+// -------------------------------------------------------------------------- //
+
+template <typename Func>
+class ThreadPool::RunAwaitable {
+public:
+  typedef std::invoke_result_t<Func&> result_t;
+
+  RunAwaitable(ThreadPool& pool, Func& func): _pool{pool}, _func{func} {}
+
+  bool await_ready() const { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    Scheduler& scheduler = Scheduler::this_thread();
+    scheduler.expect_remote_schedule();
+    _pool._post([this, handle, &scheduler]() {
+      try {
+        if constexpr (std::is_void_v<result_t>) {
+          _func();
+        } else {
+          _result.emplace(_func());
+        }
+      } catch (...) {
+        _error = std::current_exception();
+      }
+      scheduler.schedule_remote(handle);
+    });
+  }
+
+  result_t await_resume() {
+    if (_error) std::rethrow_exception(_error);
+    if constexpr (!std::is_void_v<result_t>) return std::move(*_result);
+  }
+
+private:
+  struct Empty {};
+
+  ThreadPool& _pool;
+  Func& _func;
+  std::conditional_t<
+    std::is_void_v<result_t>,
+    Empty,
+    std::optional<result_t>
+  > _result;
+  std::exception_ptr _error = nullptr;
+};
+
+template <typename Func>
+Future<std::invoke_result_t<Func&>> ThreadPool::run(Func func) {
+  co_return co_await RunAwaitable<Func>{*this, func};
+}
+
+}
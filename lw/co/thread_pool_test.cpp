@@ -0,0 +1,124 @@
+#include "lw/co/thread_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/co/testing/destroy_scheduler.h"
+#include "lw/err/canonical.h"
+
+namespace lw::co {
+namespace {
+
+class ThreadPoolTest: public ::testing::Test {
+protected:
+  ~ThreadPoolTest() noexcept {
+    testing::destroy_all_schedulers();
+  }
+
+  template <typename Func>
+  void run(Func&& coroutine) {
+    Scheduler::this_thread().schedule(std::forward<Func>(coroutine));
+    Scheduler::this_thread().run();
+  }
+};
+
+TEST_F(ThreadPoolTest, RequiresThreads) {
+  EXPECT_THROW(ThreadPool{0}, InvalidArgument);
+}
+
+TEST_F(ThreadPoolTest, RunsWorkOnPoolThreads) {
+  ThreadPool pool{2};
+  const std::thread::id caller = std::this_thread::get_id();
+  std::thread::id worker;
+  std::thread::id resumed_on;
+  run([&]() -> Task {
+    int result = co_await pool.run([&]() {
+      worker = std::this_thread::get_id();
+      return 42;
+    });
+    resumed_on = std::this_thread::get_id();
+    EXPECT_EQ(result, 42);
+  });
+  EXPECT_NE(worker, caller);
+  EXPECT_EQ(resumed_on, caller);
+}
+
+TEST_F(ThreadPoolTest, RunsVoidWork) {
+  ThreadPool pool{1};
+  bool ran = false;
+  run([&]() -> Task {
+    co_await pool.run([&]() { ran = true; });
+  });
+  EXPECT_TRUE(ran);
+}
+
+TEST_F(ThreadPoolTest, ReturnsMoveOnlyResults) {
+  ThreadPool pool{1};
+  run([&]() -> Task {
+    std::unique_ptr<int> result =
+      co_await pool.run([]() { return std::make_unique<int>(7); });
+    EXPECT_EQ(*result, 7);
+  });
+}
+
+TEST_F(ThreadPoolTest, PropagatesExceptions) {
+  ThreadPool pool{1};
+  bool caught = false;
+  run([&]() -> Task {
+    try {
+      co_await pool.run([]() -> int { throw Unavailable() << "Nope."; });
+    } catch (const Unavailable&) {
+      caught = true;
+    }
+  });
+  EXPECT_TRUE(caught);
+}
+
+TEST_F(ThreadPoolTest, RunsWorkConcurrently) {
+  ThreadPool pool{4};
+  std::atomic_int running = 0;
+  std::atomic_int max_running = 0;
+  auto work = [&]() {
+    int now = ++running;
+    int max = max_running;
+    while (now > max && !max_running.compare_exchange_weak(max, now)) {}
+    while (max_running < 4 && running > 0) std::this_thread::yield();
+    --running;
+  };
+  run([&]() -> Task {
+    std::vector<Future<void>> futures;
+    for (int i = 0; i < 4; ++i) futures.push_back(pool.run(work));
+    co_await all(std::move(futures));
+  });
+  EXPECT_EQ(max_running, 4);
+}
+
+TEST_F(ThreadPoolTest, ResumesOnCallingThread) {
+  ThreadPool pool{2};
+  std::atomic_int resumed_correctly = 0;
+  auto thread_main = [&]() {
+    auto caller = [&]() -> Task {
+      const std::thread::id self = std::this_thread::get_id();
+      for (int i = 0; i < 10; ++i) {
+        co_await pool.run([]() {});
+        if (std::this_thread::get_id() == self) ++resumed_correctly;
+      }
+    };
+    Scheduler::this_thread().schedule(caller);
+    Scheduler::this_thread().run();
+  };
+  {
+    std::jthread a{thread_main};
+    std::jthread b{thread_main};
+  }
+  EXPECT_EQ(resumed_correctly, 20);
+}
+
+}
+}
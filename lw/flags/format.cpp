@@ -2,8 +2,6 @@
 
 #include <charconv>
 #include <chrono>
-#include <cmath>
-#include <cstdlib>
 #include <locale>
 #include <string>
 #include <string_view>
@@ -67,57 +65,14 @@ _LW_NUM_CLI_DEFINE(unsigned short);
 _LW_NUM_CLI_DEFINE(unsigned int);
 _LW_NUM_CLI_DEFINE(unsigned long int);
 _LW_NUM_CLI_DEFINE(unsigned long long int);
+_LW_NUM_CLI_DEFINE(float);
+_LW_NUM_CLI_DEFINE(double);
+_LW_NUM_CLI_DEFINE(long double);
 
 #undef _LW_NUM_CLI_DEFINE
 
 // -------------------------------------------------------------------------- //
 
-// TODO: Move these floating point parsers over to std::from_chars once floating
-// point support is implemented for that.
-template <>
-float parse<float>(std::string_view value) {
-  char* end = nullptr;
-  float out = std::strtof(value.begin(), &end);
-  if (end != value.end()) {
-    throw InvalidArgument()
-      << "String \"" << value << "\" is not a valid float value.";
-  } else if (out == HUGE_VALF) {
-    throw InvalidArgument()
-      << "Flag value \"" << value << "\" is too large for float.";
-  }
-  return out;
-}
-
-template <>
-double parse<double>(std::string_view value) {
-  char* end = nullptr;
-  double out = std::strtod(value.begin(), &end);
-  if (end != value.end()) {
-    throw InvalidArgument()
-      << "String \"" << value << "\" is not a valid double value.";
-  } else if (out == HUGE_VAL) {
-    throw InvalidArgument()
-      << "Flag value \"" << value << "\" is too large for double.";
-  }
-  return out;
-}
-
-template <>
-long double parse<long double>(std::string_view value) {
-  char* end = nullptr;
-  long double out = std::strtold(value.begin(), &end);
-  if (end != value.end()) {
-    throw InvalidArgument()
-      << "String \"" << value << "\" is not a valid long double value.";
-  } else if (out == HUGE_VALL) {
-    throw InvalidArgument()
-      << "Flag value \"" << value << "\" is too large for long double.";
-  }
-  return out;
-}
-
-// -------------------------------------------------------------------------- //
-
 std::string format(std::string_view value) {
   std::string out;
   out.reserve((value.size() * STRING_ESCAPE_SIZE_FACTOR));
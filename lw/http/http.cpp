@@ -1,20 +1,56 @@
 #include "lw/http/http.h"
 
+#include <algorithm>
 #include <exception>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
 
+#include "lw/base/strings.h"
 #include "lw/co/future.h"
 #include "lw/co/task.h"
 #include "lw/err/canonical.h"
+#include "lw/co/scheduler.h"
 #include "lw/io/co/co.h"
+#include "lw/http/internal/http2_connection.h"
+#include "lw/http/internal/http2_frame.h"
 #include "lw/http/internal/http_mount_path.h"
+#include "lw/http/internal/http_responder.h"
+#include "lw/http/internal/http_response_cache.h"
 #include "lw/http/http_request.h"
+#include "lw/http/http_status_error.h"
 #include "lw/log/log.h"
+#include "lw/memory/buffer.h"
 
 namespace lw {
 namespace {
 
+using ::lw::http::internal::CachedResponse;
 using ::lw::http::internal::EndpointTrie;
+using ::lw::http::internal::HTTP2_PREFACE;
+using ::lw::http::internal::Http2Connection;
+using ::lw::http::internal::HttpResponder;
+using ::lw::http::internal::HttpResponseCache;
+using ::lw::http::internal::SharedCachedResponse;
+using ::lw::http::internal::etag_matches;
+using ::lw::http::internal::make_cache_key;
+using ::lw::http::internal::make_etag;
+
+typedef HttpRouter::CacheFills CacheFills;
+
+// Response headers which describe the body.
+constexpr std::string_view BODY_HEADERS[] = {
+  "Content-Encoding",
+  "Content-Language",
+  "Content-Length",
+  "Content-Location",
+  "Content-Range",
+  "Content-Type",
+  "ETag",
+  "Last-Modified",
+  "Vary"
+};
 
 void respond_failure(HttpResponse& res, int status, std::string_view body) {
   res.status(status);
@@ -33,64 +69,309 @@ co::Future<bool> try_read_header(HttpRequest& req, HttpResponse& res) {
   }
 }
 
-co::Future<void> finish_request(
+co::Future<void> send_response(
   io::CoStream& conn,
-  HttpRequest& req,
-  HttpResponse& res
+  const HttpRequest& req,
+  int status,
+  const Buffer& serialized
 ) {
   log(INFO)
-    << "Responding " << res.status() << " to " << req.method() << ' '
-    << req.path();
-  co_await conn.write(res.serialize());
+    << "Responding " << status << " to " << req.method() << ' ' << req.path();
+  co_await conn.write(serialized);
 
-  if (
+  // Switching protocols hands the connection over instead of closing it.
+  if (status == HttpResponse::SWITCHING_PROTOCOLS) {
+    co_await conn.flush();
+  } else if (
     !req.has_header("connection") || req.header("connection") != "keep-alive"
   ) {
+    co_await conn.flush();
     conn.close();
   }
 }
 
-co::Future<void> run_request(
-  io::CoStream& conn,
-  EndpointTrie<BaseHttpHandlerFactory>& trie
+/**
+ * Responds over HTTP/1.x, closing the connection afterwards unless the client
+ * asked to keep it alive.
+ */
+class Http1Responder: public HttpResponder {
+public:
+  explicit Http1Responder(io::CoStream& conn): _conn{conn} {}
+
+  co::Future<void> send(
+    const HttpRequest& req,
+    const HttpResponse& res
+  ) override {
+    co_await send_response(_conn, req, res.status(), res.serialize());
+  }
+
+  co::Future<void> send_cached(
+    const HttpRequest& req,
+    const CachedResponse& cached
+  ) override {
+    co_await send_response(_conn, req, HttpResponse::OK, cached.serialized);
+  }
+
+  io::CoStream* upgrade() override { return &_conn; }
+
+private:
+  io::CoStream& _conn;
+};
+
+/**
+ * Replays the bytes read while detecting the protocol before reading any more
+ * from the connection itself.
+ */
+class ReplayStream: public io::CoStream {
+public:
+  ReplayStream(std::unique_ptr<io::CoStream> conn, std::string replay):
+    _conn{std::move(conn)},
+    _replay{std::move(replay)}
+  {}
+
+  bool eof() const override {
+    return _replay_pos >= _replay.size() && _conn->eof();
+  }
+  bool good() const override {
+    return _replay_pos < _replay.size() || _conn->good();
+  }
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    if (_replay_pos >= _replay.size()) co_return co_await _conn->read(buffer);
+
+    const std::size_t size =
+      std::min(buffer.size(), _replay.size() - _replay_pos);
+    buffer.copy(_replay.begin() + _replay_pos, size);
+    _replay_pos += size;
+    co_return size;
+  }
+
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    return _conn->write(buffer);
+  }
+
+  co::Future<void> flush() override { return _conn->flush(); }
+  void close() override { _conn->close(); }
+
+private:
+  std::unique_ptr<io::CoStream> _conn;
+  std::string _replay;
+  std::size_t _replay_pos = 0;
+};
+
+/**
+ * Reads from the start of the connection for as long as it could still be the
+ * HTTP/2 client preface.
+ *
+ * @return
+ *  True if the connection starts with the preface. Everything read is left in
+ *  `read` either way.
+ */
+co::Future<bool> read_preface(io::CoStream& conn, std::string& read) {
+  Buffer buffer{flags::read_block_size};
+  while (
+    read.size() < HTTP2_PREFACE.size() && HTTP2_PREFACE.starts_with(read)
+  ) {
+    if (!conn.good()) co_return false;
+    const std::size_t bytes_read = co_await conn.read(buffer);
+    read.append(static_cast<std::string_view>(buffer).substr(0, bytes_read));
+  }
+  co_return read.starts_with(HTTP2_PREFACE);
+}
+
+co::Future<void> respond_from_cache(
+  HttpResponder& responder,
+  HttpRequest& req,
+  const CachedResponse& cached
 ) {
-  io::CoReader reader{conn};
-  HttpRequest request{reader};
-  HttpResponse response;
+  if (
+    req.has_header("if-none-match") &&
+    etag_matches(req.header("if-none-match"), cached.etag)
+  ) {
+    HttpResponse not_modified;
+    not_modified.status(HttpResponse::NOT_MODIFIED);
+    not_modified.header("ETag", cached.etag);
+    not_modified.header("Content-Length", std::to_string(cached.body_size));
+    co_await responder.send(req, not_modified);
+  } else {
+    co_await responder.send_cached(req, cached);
+  }
+}
 
-  if (!co_await try_read_header(request, response)) {
-    co_await finish_request(conn, request, response);
+co::Future<void> invoke_handler(
+  HttpHandler& handler,
+  const HttpRequest& request
+) {
+  if (request.method() == "DELETE")       co_await handler.del();
+  else if (request.method() == "GET")     co_await handler.get();
+  else if (request.method() == "HEAD")    co_await handler.head();
+  else if (request.method() == "OPTIONS") co_await handler.options();
+  else if (request.method() == "PATCH")   co_await handler.patch();
+  else if (request.method() == "POST")    co_await handler.post();
+  else if (request.method() == "PUT")     co_await handler.put();
+  else {
+    respond_failure(
+      handler.response(),
+      HttpResponse::BAD_REQUEST,
+      "Unknown method."
+    );
+  }
+}
+
+co::Future<void> run_handler(HttpHandler& handler, const HttpRequest& request) {
+  try {
+    co_await invoke_handler(handler, request);
+  } catch (const HttpStatusError& err) {
+    log(INFO)
+      << "Handler for " << request.method() << ' ' << request.path()
+      << " failed with " << err.status() << ": " << err.what();
+    HttpResponse& response = handler.response();
+    // The handler may have described a body before failing, such as with the
+    // `Content-Type` and `Vary` set by `send`, which the failure replaces.
+    for (std::string_view header : BODY_HEADERS) {
+      response.remove_header(header);
+    }
+    response.status(err.status());
+    respond_failure(response, err.status(), response.status_message());
+  }
+}
+
+bool is_storable(const HttpResponse& response) {
+  if (response.status() != HttpResponse::OK) return false;
+  // The cache key covers `Accept` but no other request headers.
+  if (
+    response.has_header("Vary") &&
+    !CaseInsensitiveEqual()(response.header("Vary"), "Accept")
+  ) {
+    return false;
+  }
+  if (!response.has_header("Cache-Control")) return true;
+  const std::string_view cache_control = response.header("Cache-Control");
+  return (
+    cache_control.find("no-store") == std::string_view::npos &&
+    cache_control.find("private") == std::string_view::npos
+  );
+}
+
+SharedCachedResponse store_response(
+  HttpResponseCache& cache,
+  std::string key,
+  const HttpCachePolicy& policy,
+  HttpResponse& response
+) {
+  if (!response.has_header("ETag")) {
+    response.header("ETag", make_etag(response.body()));
+  }
+  auto cached = std::make_shared<const CachedResponse>(CachedResponse{
+    .serialized = response.serialize(),
+    .etag = std::string{response.header("ETag")},
+    .body_size = response.body().size(),
+    .expires = CachedResponse::Clock::now() + policy.ttl
+  });
+  cache.insert(std::move(key), cached);
+  return cached;
+}
+
+co::Future<void> run_cacheable_request(
+  HttpResponder& responder,
+  HttpRequest& request,
+  HttpResponse& response,
+  const BaseHttpHandlerFactory& endpoint,
+  HttpResponseCache& cache,
+  CacheFills& fills
+) {
+  std::string key = make_cache_key(request);
+  if (auto cached = cache.find(key)) {
+    co_await respond_from_cache(responder, request, *cached);
     co_return;
   }
 
+  // If another request is already running the handler for this key, share its
+  // response instead of invoking the handler again.
+  bool ran_handler = false;
+  auto run_and_store = [&]() -> co::Future<SharedCachedResponse> {
+    ran_handler = true;
+    auto handler = endpoint.make_handler(request, response);
+    log(INFO)
+      << "Running handler for " << request.method() << ' ' << endpoint.route();
+    co_await run_handler(*handler, request);
+    if (!is_storable(response)) co_return nullptr;
+    co_return store_response(cache, key, endpoint.cache_policy(), response);
+  };
+  SharedCachedResponse cached = co_await fills.run(key, run_and_store);
+
+  if (cached) {
+    co_await respond_from_cache(responder, request, *cached);
+    co_return;
+  }
+
+  // The shared response could not be cached (e.g. an error status). If it came
+  // from another request, this one falls back to running its own handler.
+  if (!ran_handler) co_await run_and_store();
+  co_await responder.send(request, response);
+}
+
+/**
+ * Routes a request whose header has been read to its handler, whichever
+ * version of HTTP it arrived in.
+ */
+co::Future<void> dispatch_request(
+  HttpRequest& request,
+  HttpResponse& response,
+  HttpResponder& responder,
+  EndpointTrie<BaseHttpHandlerFactory>& trie,
+  HttpResponseCache& cache,
+  CacheFills& fills
+) {
   auto match_results = trie.match(request.path());
   if (!match_results) {
     respond_failure(response, HttpResponse::NOT_FOUND, "Not Found.");
-    co_await finish_request(conn, request, response);
+    co_await responder.send(request, response);
     co_return;
   }
 
   request.route_params(std::move(match_results->parameters));
-  auto handler = match_results->endpoint.make_handler(request, response);
+  const BaseHttpHandlerFactory& endpoint = match_results->endpoint;
+  if (endpoint.cache_policy().cacheable() && request.method() == "GET") {
+    co_await run_cacheable_request(
+      responder, request, response, endpoint, cache, fills
+    );
+    co_return;
+  }
+
+  auto handler = endpoint.make_handler(request, response);
   log(INFO)
-    << "Running handler for " << request.method() << ' '
-    << match_results->endpoint.route();
-
-  // TODO(alaina): Introduce HttpStatus error class for use by HttpHandlers,
-  // then wrap this invocation in a try-catch for that type and respond with an
-  // appropriate HTTP error message.
-  if (request.method() == "DELETE")       co_await handler->del();
-  else if (request.method() == "GET")     co_await handler->get();
-  else if (request.method() == "HEAD")    co_await handler->head();
-  else if (request.method() == "OPTIONS") co_await handler->options();
-  else if (request.method() == "PATCH")   co_await handler->patch();
-  else if (request.method() == "POST")    co_await handler->post();
-  else if (request.method() == "PUT")     co_await handler->put();
-  else {
-    respond_failure(response, HttpResponse::BAD_REQUEST, "Unknown method.");
+    << "Running handler for " << request.method() << ' ' << endpoint.route();
+  co_await run_handler(*handler, request);
+  co_await responder.send(request, response);
+
+  if (response.status() == HttpResponse::SWITCHING_PROTOCOLS) {
+    if (io::CoStream* conn = responder.upgrade()) {
+      co_await handler->upgrade(*conn);
+    }
   }
+}
 
-  co_await finish_request(conn, request, response);
+/**
+ * Reads and responds to one request. The reader is kept for the whole
+ * connection, so that pipelined requests it has already buffered are not lost.
+ */
+co::Future<void> run_request(
+  io::CoStream& conn,
+  io::BaseCoReader& reader,
+  EndpointTrie<BaseHttpHandlerFactory>& trie,
+  HttpResponseCache& cache,
+  CacheFills& fills
+) {
+  HttpRequest request{reader};
+  HttpResponse response;
+  Http1Responder responder{conn};
+
+  if (!co_await try_read_header(request, response)) {
+    co_await responder.send(request, response);
+    co_return;
+  }
+  co_await dispatch_request(request, response, responder, trie, cache, fills);
 }
 
 }
@@ -111,11 +392,39 @@ co::Task HttpRouter::run(std::unique_ptr<io::CoStream> conn) {
   log(INFO)
     << "HttpRouter handling " << _connection_counter << " concurrent requests.";
 
-  while (conn->good()) {
+  // Clients which know the server speaks HTTP/2, either from ALPN or prior
+  // knowledge, open with the HTTP/2 preface. Anything else is HTTP/1.
+  std::string start;
+  bool http2 = false;
+  try {
+    http2 = co_await read_preface(*conn, start);
+  } catch (const Error& err) {
+    log(ERROR) << "Failed to read from connection: " << err.what();
+  }
+  ReplayStream stream{std::move(conn), std::move(start)};
+
+  if (http2) {
+    Http2Connection http2_conn{
+      stream,
+      [this](
+        HttpRequest& request,
+        HttpResponse& response,
+        HttpResponder& responder
+      ) {
+        return dispatch_request(
+          request, response, responder, _trie, _cache, _cache_fills
+        );
+      }
+    };
+    co_await http2_conn.run();
+  }
+
+  io::CoReader<io::CoStream> reader{stream};
+  while (!http2 && reader.good()) {
     try {
-      co_await run_once(*conn);
+      co_await run_request(stream, reader, _trie, _cache, _cache_fills);
     } catch(const Error& err) {
-      if (conn->good()) conn->close();
+      if (stream.good()) stream.close();
       log(ERROR) << "Unhandled application error: " << err.what();
     }
   }
@@ -123,7 +432,8 @@ co::Task HttpRouter::run(std::unique_ptr<io::CoStream> conn) {
 }
 
 co::Future<void> HttpRouter::run_once(io::CoStream& conn) {
-  return run_request(conn, _trie);
+  io::CoReader<io::CoStream> reader{conn};
+  co_await run_request(conn, reader, _trie, _cache, _cache_fills);
 }
 
 }
@@ -17,19 +17,52 @@
  *  LW_REGISTER_HTTP_HANDLER(MyHandler, "/my/:endpoint");
  *  }
  * ```
+ *
+ * Handlers exchanging structured data can read and write bodies in whichever
+ * registered MIME format the client used or accepts. Throwing an
+ * `HttpStatusError` answers the request with that status instead.
+ *
+ * ```cpp
+ *  co::Future<void> post() override {
+ *    User user = co_await request().body_as<User>();
+ *    if (user.name.empty()) {
+ *      throw HttpStatusError(HttpResponse::UNPROCESSABLE_ENTITY);
+ *    }
+ *    response().send(user);
+ *  }
+ * ```
+ *
+ * Idempotent handlers can opt into response caching by passing an
+ * `HttpCachePolicy` as the last argument. Cached `GET` responses are served
+ * without constructing the handler, and concurrent requests for the same path
+ * and query share a single handler invocation.
+ *
+ * ```cpp
+ *  LW_REGISTER_HTTP_HANDLER(MyHandler, "/my/:endpoint", {
+ *    .ttl = std::chrono::minutes{5}
+ *  });
+ * ```
+ *
+ * Routers speak HTTP/2 to clients which open with its connection preface, as
+ * those which negotiated "h2" through TLS ALPN or know the server supports it
+ * do. Each HTTP/2 stream runs as its own request, so handlers are shared
+ * unchanged between HTTP versions.
  */
 
 #include <memory>
+#include <string>
 
+#include "lw/co/single_flight.h"
 #include "lw/co/task.h"
 #include "lw/http/http_handler.h"
 #include "lw/http/internal/http_mount_path.h"
+#include "lw/http/internal/http_response_cache.h"
 #include "lw/io/co/co.h"
 #include "lw/net/router.h"
 
-#define LW_REGISTER_HTTP_HANDLER(HandlerClass, route) \
-  ::lw::HttpRoute http_route_ ## HandlerClass{        \
-    ::lw::HttpHandlerFactory<HandlerClass>{route}     \
+#define LW_REGISTER_HTTP_HANDLER(HandlerClass, route, ...)                 \
+  ::lw::HttpRoute http_route_ ## HandlerClass{                              \
+    ::lw::HttpHandlerFactory<HandlerClass>{route __VA_OPT__(,) __VA_ARGS__} \
   }
 
 namespace lw {
@@ -47,14 +80,27 @@ private:
 
 class HttpRouter: public net::Router {
 public:
+  /**
+   * Handler invocations for cacheable requests, keyed by cache key so that
+   * concurrent misses share one invocation.
+   */
+  typedef co::SingleFlight<std::string, http::internal::SharedCachedResponse>
+  CacheFills;
+
   void attach_routes() override;
   co::Task run(std::unique_ptr<io::CoStream> conn) override;
   std::size_t connection_count() const override { return _connection_counter; }
 
   co::Future<void> run_once(io::CoStream& conn);
 
+  http::internal::HttpResponseCacheStats cache_stats() const {
+    return _cache.stats();
+  }
+
 private:
   http::internal::EndpointTrie<BaseHttpHandlerFactory> _trie;
+  http::internal::HttpResponseCache _cache;
+  CacheFills _cache_fills;
   std::size_t _connection_counter = 0;
 };
 
@@ -0,0 +1,193 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/co/time.h"
+#include "lw/http/http.h"
+#include "lw/http/http_handler.h"
+#include "lw/http/internal/http2_frame.h"
+#include "lw/http/testing/http2_client.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/socket.h"
+
+namespace lw {
+namespace {
+
+using ::lw::http::testing::Http2TestClient;
+
+constexpr std::string_view RESPONSE_BODY = "hello";
+constexpr std::string_view HTTP1_RESPONSE =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Length: 5\r\n"
+  "\r\n"
+  "hello";
+
+class FastHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    response().body(RESPONSE_BODY);
+    co_return;
+  }
+};
+LW_REGISTER_HTTP_HANDLER(FastHandler, "/fast");
+
+/**
+ * Stands in for a handler waiting on a backend, such as a database.
+ */
+class SlowHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    co_await co::sleep_for(std::chrono::milliseconds{1});
+    response().body(RESPONSE_BODY);
+  }
+};
+LW_REGISTER_HTTP_HANDLER(SlowHandler, "/slow");
+
+const char* handler_path(const benchmark::State& state) {
+  return state.range(1) ? "/slow" : "/fast";
+}
+
+/**
+ * Connects to the router over loopback, leaving the router serving the far
+ * end of the returned socket.
+ */
+std::unique_ptr<net::Socket> connect_router(
+  HttpRouter& router,
+  const char* port
+) {
+  const net::Address addr{.hostname = "localhost", .service = port};
+  std::unique_ptr<net::Socket> client;
+  int remaining = 2;
+  auto accept = [&]() -> co::Task {
+    net::Socket listener;
+    listener.listen(addr);
+    co::Scheduler::this_thread().schedule(router.run(
+      std::make_unique<net::Socket>(co_await listener.accept())
+    ));
+    if (--remaining == 0) co::Scheduler::this_thread().stop();
+  };
+  auto connect = [&]() -> co::Task {
+    client = std::make_unique<net::Socket>();
+    co_await client->connect(addr);
+    if (--remaining == 0) co::Scheduler::this_thread().stop();
+  };
+  co::Scheduler::this_thread().schedule(accept);
+  co::Scheduler::this_thread().schedule(connect);
+  co::Scheduler::this_thread().run();
+  return client;
+}
+
+/**
+ * Closes the client's end and lets the router finish with the connection.
+ */
+void disconnect(std::unique_ptr<net::Socket> client) {
+  client->close();
+  co::Scheduler::this_thread().run();
+}
+
+/**
+ * `state.range(0)` requests sent as concurrent streams on one HTTP/2
+ * connection, to handlers which take `state.range(1)` milliseconds.
+ */
+void BM_Http2ConcurrentStreams(benchmark::State& state) {
+  const std::size_t streams = state.range(0);
+  HttpRouter router;
+  router.attach_routes();
+  std::unique_ptr<net::Socket> socket = connect_router(router, "8447");
+
+  Http2TestClient client;
+  std::uint32_t next_stream_id = 1;
+  std::string requests = client.preface();
+  std::string received;
+  Buffer buffer{64 * 1024};
+  auto run_streams = [&]() -> co::Task {
+    for (std::size_t i = 0; i < streams; ++i) {
+      requests += client.request(next_stream_id, "GET", handler_path(state));
+      next_stream_id += 2;
+    }
+    Buffer out{requests.begin(), requests.end()};
+    co_await socket->write(out);
+
+    std::size_t complete = 0;
+    while (complete < streams) {
+      const std::size_t read = co_await socket->read(buffer);
+      received += static_cast<std::string_view>(buffer).substr(0, read);
+      received.erase(0, client.receive(received));
+      complete = 0;
+      for (const auto& [id, response] : client.responses()) {
+        if (response.complete) ++complete;
+      }
+    }
+
+    // Give back the connection flow control window the responses used.
+    requests.clear();
+    http::internal::append_window_update_frame(
+      requests,
+      0,
+      static_cast<std::uint32_t>(streams * RESPONSE_BODY.size())
+    );
+    client.clear();
+    co::Scheduler::this_thread().stop();
+  };
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(run_streams);
+    co::Scheduler::this_thread().run();
+  }
+
+  disconnect(std::move(socket));
+  state.SetItemsProcessed(state.iterations() * streams);
+}
+BENCHMARK(BM_Http2ConcurrentStreams)
+  ->Args({1, 0})->Args({10, 0})->Args({100, 0})
+  ->Args({1, 1})->Args({10, 1})->Args({100, 1})
+  ->UseRealTime();
+
+/**
+ * The same requests as `BM_Http2ConcurrentStreams`, sent one after the other
+ * on a keep-alive HTTP/1.1 connection.
+ */
+void BM_Http1KeepAliveRequests(benchmark::State& state) {
+  const std::size_t requests = state.range(0);
+  HttpRouter router;
+  router.attach_routes();
+  std::unique_ptr<net::Socket> socket = connect_router(router, "8448");
+
+  const std::string request =
+    std::string{"GET "} + handler_path(state) + " HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+  Buffer out{request.begin(), request.end()};
+  Buffer buffer{64 * 1024};
+  auto run_requests = [&]() -> co::Task {
+    for (std::size_t i = 0; i < requests; ++i) {
+      co_await socket->write(out);
+      std::size_t received = 0;
+      while (received < HTTP1_RESPONSE.size()) {
+        received += co_await socket->read(buffer);
+      }
+    }
+    co::Scheduler::this_thread().stop();
+  };
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(run_requests);
+    co::Scheduler::this_thread().run();
+  }
+
+  disconnect(std::move(socket));
+  state.SetItemsProcessed(state.iterations() * requests);
+}
+BENCHMARK(BM_Http1KeepAliveRequests)
+  ->Args({1, 0})->Args({10, 0})->Args({100, 0})
+  ->Args({1, 1})->Args({10, 1})->Args({100, 1})
+  ->UseRealTime();
+
+}
+}
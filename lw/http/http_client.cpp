@@ -0,0 +1,756 @@
+#include "lw/http/http_client.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/co/time.h"
+#include "lw/err/canonical.h"
+#include "lw/http/internal/http_header_parser.h"
+#include "lw/io/co/co.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/socket.h"
+#include "lw/net/tls.h"
+
+namespace lw {
+namespace {
+
+using ::lw::http::internal::has_header_token;
+using ::lw::http::internal::parse_content_length;
+using ::lw::http::internal::parse_header_lines;
+using ::std::chrono::steady_clock;
+
+constexpr std::size_t READ_BLOCK_SIZE = 16 * 1024;
+constexpr std::size_t MAX_HEADER_SIZE = 64 * 1024;
+constexpr std::chrono::milliseconds MAX_DEADLINE_CHECK_INTERVAL{100};
+
+struct Url {
+  std::string scheme;
+  std::string authority;
+  std::string host;
+  std::string port;
+  std::string target;
+};
+
+/**
+ * Checks for characters which would end the request line or a header early,
+ * letting the rest be read as extra headers or a second request. Control
+ * characters other than tab are always invalid.
+ */
+bool has_invalid_characters(std::string_view str, std::string_view invalid) {
+  for (char c : str) {
+    const auto byte = static_cast<unsigned char>(c);
+    if ((byte < 0x20 && c != '\t') || byte == 0x7f) return true;
+    if (invalid.find(c) != std::string_view::npos) return true;
+  }
+  return false;
+}
+
+Url parse_url(std::string_view url) {
+  if (has_invalid_characters(url, " \t")) {
+    throw InvalidArgument() << "URL contains whitespace or control characters.";
+  }
+  const std::size_t scheme_end = url.find("://");
+  if (scheme_end == std::string_view::npos) {
+    throw InvalidArgument() << "URL \"" << url << "\" is not absolute.";
+  }
+  Url parsed;
+  for (char c : url.substr(0, scheme_end)) {
+    parsed.scheme.push_back(std::tolower(static_cast<unsigned char>(c)));
+  }
+  if (parsed.scheme != "http" && parsed.scheme != "https") {
+    throw InvalidArgument()
+      << "Unsupported scheme in URL \"" << url
+      << "\"; expected http or https.";
+  }
+
+  std::string_view rest = url.substr(scheme_end + 3);
+  const std::size_t authority_end = rest.find_first_of("/?#");
+  const std::string_view authority = rest.substr(0, authority_end);
+  std::string_view target;
+  if (authority_end != std::string_view::npos) {
+    target = rest.substr(authority_end);
+    target = target.substr(0, target.find('#'));
+  }
+  if (target.empty() || target.front() == '?') parsed.target = "/";
+  parsed.target += target;
+  if (authority.find('@') != std::string_view::npos) {
+    throw InvalidArgument()
+      << "User info in URL \"" << url << "\" is not supported.";
+  }
+  parsed.authority = authority;
+
+  // IPv6 addresses are bracketed to set them apart from the port.
+  std::string_view host = authority;
+  std::string_view port;
+  if (authority.starts_with('[')) {
+    const std::size_t close = authority.find(']');
+    if (close == std::string_view::npos) {
+      throw InvalidArgument()
+        << "Unclosed IPv6 address in URL \"" << url << '"';
+    }
+    host = authority.substr(1, close - 1);
+    port = authority.substr(close + 1);
+    if (!port.empty() && !port.starts_with(':')) {
+      throw InvalidArgument() << "Invalid authority in URL \"" << url << '"';
+    }
+    port.remove_prefix(std::min<std::size_t>(1, port.size()));
+  } else if (const std::size_t colon = authority.rfind(':');
+    colon != std::string_view::npos
+  ) {
+    host = authority.substr(0, colon);
+    port = authority.substr(colon + 1);
+  }
+  if (host.empty()) {
+    throw InvalidArgument() << "URL \"" << url << "\" has no host.";
+  }
+  if (!std::all_of(port.begin(), port.end(), [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c));
+  })) {
+    throw InvalidArgument() << "Invalid port in URL \"" << url << '"';
+  }
+  parsed.host = host;
+  if (port.empty()) {
+    parsed.port = parsed.scheme == "https" ? "443" : "80";
+  } else {
+    parsed.port = port;
+  }
+  return parsed;
+}
+
+/**
+ * Requests which leave the server in the same state when sent twice, and so
+ * are safe to pipeline and retry.
+ */
+bool is_idempotent(std::string_view method) {
+  return (
+    method == "GET" || method == "HEAD" || method == "PUT" ||
+    method == "DELETE" || method == "OPTIONS"
+  );
+}
+
+/**
+ * @throw InvalidArgument
+ *  If the method or headers contain characters which would change the meaning
+ *  of the serialized request.
+ */
+std::string serialize_request(const HttpClientRequest& req, const Url& url) {
+  if (req.method.empty() || has_invalid_characters(req.method, " \t")) {
+    throw InvalidArgument() << "Malformed request method.";
+  }
+  for (const auto& [name, value] : req.headers) {
+    if (name.empty() || has_invalid_characters(name, ": \t")) {
+      throw InvalidArgument() << "Malformed request header name.";
+    }
+    if (has_invalid_characters(value, "")) {
+      throw InvalidArgument() << "Malformed value for header " << name;
+    }
+  }
+
+  const bool needs_length =
+    !req.headers.contains("content-length") &&
+    (!req.body.empty() || req.method == "POST" || req.method == "PUT");
+
+  std::string out;
+  out.reserve(128 + url.target.size() + req.body.size());
+  out += req.method;
+  out += ' ';
+  out += url.target;
+  out += " HTTP/1.1\r\n";
+  if (!req.headers.contains("host")) {
+    out += "Host: ";
+    out += url.authority;
+    out += "\r\n";
+  }
+  if (!req.headers.contains("connection")) {
+    out += "Connection: keep-alive\r\n";
+  }
+  if (needs_length) {
+    out += "Content-Length: ";
+    out += std::to_string(req.body.size());
+    out += "\r\n";
+  }
+  for (const auto& [name, value] : req.headers) {
+    out += name;
+    out += ": ";
+    out += value;
+    out += "\r\n";
+  }
+  out += "\r\n";
+  out += req.body;
+  return out;
+}
+
+}
+
+HttpClientResponse::HttpClientResponse(std::string raw_header):
+  _raw_header{std::move(raw_header)}
+{
+  _parse_header();
+}
+
+HttpClientResponse::HttpClientResponse(HttpClientResponse&& other):
+  _raw_header{std::move(other._raw_header)},
+  _body{std::move(other._body)}
+{
+  // Short strings move by copying, leaving the views pointing at the old one.
+  _parse_header();
+}
+
+HttpClientResponse& HttpClientResponse::operator=(HttpClientResponse&& other) {
+  _raw_header = std::move(other._raw_header);
+  _body = std::move(other._body);
+  _headers.clear();
+  _parse_header();
+  return *this;
+}
+
+void HttpClientResponse::_parse_header() {
+  // HTTP/1.1 200 OK\r\n
+  const std::string_view header = _raw_header;
+  const std::size_t line_end = header.find("\r\n");
+  const std::size_t version_end = header.find(' ');
+  if (
+    line_end == std::string_view::npos ||
+    version_end == std::string_view::npos ||
+    version_end + 4 > line_end ||
+    !header.starts_with("HTTP/")
+  ) {
+    throw InvalidArgument() << "Malformed HTTP response status line.";
+  }
+  _http_version = header.substr(0, version_end);
+
+  const std::string_view status = header.substr(version_end + 1, 3);
+  auto res = std::from_chars(status.begin(), status.end(), _status);
+  if (res.ptr != status.end() || _status < 100 || _status > 999) {
+    throw InvalidArgument()
+      << "Invalid HTTP response status \"" << status << "\".";
+  }
+  const std::size_t reason_start = std::min(version_end + 5, line_end);
+  if (reason_start < line_end && header[version_end + 4] != ' ') {
+    throw InvalidArgument() << "Malformed HTTP response status line.";
+  }
+  _reason = header.substr(reason_start, line_end - reason_start);
+  parse_header_lines(header.substr(line_end + 2), &_headers);
+}
+
+// -------------------------------------------------------------------------- //
+
+struct HttpClient::Exchange {
+  co::Promise<HttpClientResponse> promise;
+  std::string request;
+  steady_clock::time_point deadline = steady_clock::time_point::max();
+  bool idempotent = false;
+  bool head = false;
+  bool close_after = false;
+  bool retried = false;
+  bool response_started = false;
+  bool settled = false;
+
+  void resolve(HttpClientResponse response) {
+    if (settled) return;
+    settled = true;
+    promise.set_value(std::move(response));
+  }
+
+  void fail(std::exception_ptr err) {
+    if (settled) return;
+    settled = true;
+    promise.set_exception(err);
+  }
+};
+
+struct HttpClient::Host {
+  Url url;
+  std::deque<std::shared_ptr<Exchange>> waiting;
+  std::vector<std::shared_ptr<Connection>> connections;
+};
+
+struct HttpClient::Connection {
+  explicit Connection(Host& host): host{host} {}
+
+  /**
+   * Reads whatever arrives next onto the end of `input`, making room for at
+   * least `size` bytes.
+   *
+   * @return
+   *  False if the connection closed instead.
+   */
+  co::Future<bool> fill(std::size_t size = READ_BLOCK_SIZE) {
+    if (!stream->good()) co_return false;
+    const std::size_t offset = input.size();
+    const std::size_t block_size = std::max(size, READ_BLOCK_SIZE);
+    input.resize(offset + block_size);
+    Buffer buffer{
+      reinterpret_cast<std::uint8_t*>(input.data()) + offset,
+      block_size
+    };
+    const std::size_t bytes_read = co_await stream->read(buffer);
+    input.resize(offset + bytes_read);
+    co_return bytes_read > 0;
+  }
+
+  /**
+   * Reads until `input` holds at least `size` bytes.
+   *
+   * @throw Unavailable
+   *  If the connection closes first.
+   */
+  co::Future<void> fill_to(std::size_t size) {
+    while (input.size() < size) {
+      if (!co_await fill(size - input.size())) {
+        throw Unavailable()
+          << "Connection closed before the response was complete.";
+      }
+    }
+  }
+
+  /**
+   * Reads until `input` holds a whole line.
+   *
+   * @return
+   *  The length of the line, not including the line ending.
+   */
+  co::Future<std::size_t> read_line() {
+    std::size_t line_end = input.find("\r\n");
+    while (line_end == std::string::npos) {
+      if (input.size() > MAX_HEADER_SIZE) {
+        throw InvalidArgument() << "Response line is too long.";
+      }
+      co_await fill_to(input.size() + 1);
+      line_end = input.find("\r\n");
+    }
+    co_return line_end;
+  }
+
+  /**
+   * Reads a body sent with chunked transfer encoding, dropping any trailers.
+   */
+  co::Future<void> read_chunked(std::string& body, std::size_t max_size) {
+    while (true) {
+      const std::size_t line_end = co_await read_line();
+      std::string_view line{input.data(), line_end};
+      line = line.substr(0, line.find(';'));
+      while (!line.empty() && line.back() == ' ') line.remove_suffix(1);
+
+      std::size_t size = 0;
+      auto res = std::from_chars(line.begin(), line.end(), size, 16);
+      if (line.empty() || res.ec != std::errc{} || res.ptr != line.end()) {
+        throw InvalidArgument() << "Invalid chunk size \"" << line << "\".";
+      }
+      if (size > max_size - body.size()) {
+        throw ResourceExhausted()
+          << "Response body is larger than " << max_size << " bytes.";
+      }
+      input.erase(0, line_end + 2);
+      if (size == 0) break;
+
+      co_await fill_to(size + 2);
+      if (input.compare(size, 2, "\r\n") != 0) {
+        throw InvalidArgument() << "Chunk is missing its line ending.";
+      }
+      body.append(input, 0, size);
+      input.erase(0, size + 2);
+    }
+
+    std::size_t line_end = 0;
+    do {
+      line_end = co_await read_line();
+      input.erase(0, line_end + 2);
+    } while (line_end > 0);
+  }
+
+  Host& host;
+  std::unique_ptr<io::CoStream> stream;
+  net::Socket* socket = nullptr;
+  bool connected = false;
+  bool running = false;
+
+  // Set once no more requests may be sent on the connection.
+  bool closed = false;
+
+  // Requests handed to the connection in the order their responses arrive,
+  // the first `written` of which have been sent.
+  std::deque<std::shared_ptr<Exchange>> in_flight;
+  std::size_t written = 0;
+  std::size_t requests = 0;
+
+  std::string input;
+};
+
+// -------------------------------------------------------------------------- //
+
+HttpClient::HttpClient(Options options): _options{std::move(options)} {
+  if (_options.max_connections_per_host == 0) {
+    throw InvalidArgument() << "Hosts must allow at least 1 connection.";
+  }
+  if (_options.max_pipelined_requests == 0) {
+    throw InvalidArgument() << "Connections must allow at least 1 request.";
+  }
+}
+
+HttpClient::~HttpClient() {
+  *_alive = false;
+  auto err = std::make_exception_ptr(Cancelled() << "HTTP client destroyed.");
+  for (auto& [origin, host] : _hosts) {
+    for (std::shared_ptr<Exchange>& exchange : host->waiting) {
+      exchange->fail(err);
+    }
+    for (std::shared_ptr<Connection>& conn : host->connections) {
+      for (std::shared_ptr<Exchange>& exchange : conn->in_flight) {
+        exchange->fail(err);
+      }
+      // Wakes the connection's coroutine, which sees the client is gone.
+      conn->closed = true;
+      if (conn->socket && conn->socket->is_open()) conn->socket->shutdown();
+    }
+  }
+}
+
+co::Future<HttpClientResponse> HttpClient::send(HttpClientRequest request) {
+  Url url = parse_url(request.url);
+  if (url.scheme == "https" && !_options.tls) {
+    throw FailedPrecondition()
+      << "Cannot send to " << request.url << " without TLS options.";
+  }
+
+  auto exchange = std::make_shared<Exchange>();
+  exchange->request = serialize_request(request, url);
+  exchange->idempotent = is_idempotent(request.method);
+  exchange->head = request.method == "HEAD";
+  exchange->close_after =
+    request.headers.contains("connection") &&
+    has_header_token(request.headers.at("connection"), "close");
+  if (_options.request_timeout.count() > 0) {
+    exchange->deadline = steady_clock::now() + _options.request_timeout;
+    if (!_watching) {
+      _watching = true;
+      co::Scheduler::this_thread().schedule(_watch_deadlines(_alive));
+    }
+  }
+  co::Future<HttpClientResponse> response = exchange->promise.get_future();
+
+  std::unique_ptr<Host>& host = _hosts[url.scheme + "://" + url.authority];
+  if (!host) host = std::make_unique<Host>(Host{.url = std::move(url)});
+  host->waiting.push_back(std::move(exchange));
+  ++_outstanding;
+  _dispatch(*host);
+
+  std::shared_ptr<const bool> alive = _alive;
+  try {
+    HttpClientResponse res = co_await response;
+    if (*alive) --_outstanding;
+    co_return res;
+  } catch (...) {
+    if (*alive) --_outstanding;
+    throw;
+  }
+}
+
+void HttpClient::_dispatch(Host& host) {
+  while (!host.waiting.empty()) {
+    if (host.waiting.front()->settled) {
+      host.waiting.pop_front();
+      continue;
+    }
+
+    // Prefer an idle connection, then a new one, then pipelining.
+    std::shared_ptr<Connection> chosen;
+    for (std::shared_ptr<Connection>& conn : host.connections) {
+      if (!conn->closed && conn->in_flight.empty()) {
+        chosen = conn;
+        break;
+      }
+    }
+    if (
+      !chosen &&
+      host.connections.size() < _options.max_connections_per_host
+    ) {
+      chosen = std::make_shared<Connection>(host);
+      host.connections.push_back(chosen);
+    }
+    if (!chosen && host.waiting.front()->idempotent) {
+      for (std::shared_ptr<Connection>& conn : host.connections) {
+        const std::size_t queued = conn->in_flight.size();
+        if (
+          conn->closed || queued >= _options.max_pipelined_requests ||
+          (chosen && chosen->in_flight.size() <= queued)
+        ) {
+          continue;
+        }
+        const bool all_idempotent = std::all_of(
+          conn->in_flight.begin(),
+          conn->in_flight.end(),
+          [](const std::shared_ptr<Exchange>& e) { return e->idempotent; }
+        );
+        if (all_idempotent) chosen = conn;
+      }
+    }
+    if (!chosen) return;
+
+    chosen->in_flight.push_back(std::move(host.waiting.front()));
+    host.waiting.pop_front();
+    if (!chosen->running) {
+      chosen->running = true;
+      co::Scheduler::this_thread().schedule(_run_connection(chosen, _alive));
+    }
+  }
+}
+
+co::Task HttpClient::_run_connection(
+  std::shared_ptr<Connection> conn,
+  std::shared_ptr<const bool> alive
+) {
+  std::exception_ptr failure = nullptr;
+  try {
+    if (!conn->connected) {
+      co_await _connect(*conn);
+      if (!*alive) co_return;
+      ++_stats.connections_opened;
+    }
+    while (!conn->closed && !conn->in_flight.empty()) {
+      co_await _write_requests(*conn);
+      if (!*alive) co_return;
+
+      std::shared_ptr<Exchange> exchange = conn->in_flight.front();
+      co_await _read_response(*conn, *exchange);
+      if (!*alive) co_return;
+      conn->in_flight.pop_front();
+      --conn->written;
+
+      // Finishing a response may free up room for waiting requests.
+      if (!conn->closed) _dispatch(conn->host);
+    }
+  } catch (...) {
+    failure = std::current_exception();
+  }
+  if (!*alive) co_return;
+
+  conn->running = false;
+  if (failure || conn->closed) {
+    if (!failure) {
+      failure = std::make_exception_ptr(
+        Unavailable() << "Connection closed by the server."
+      );
+    }
+    _abandon(*conn, failure);
+  }
+}
+
+co::Future<void> HttpClient::_connect(Connection& conn) {
+  // Copied as the host is gone if the client is destroyed while connecting.
+  const std::string hostname = conn.host.url.host;
+  const std::string port = conn.host.url.port;
+  net::TLSStreamFactory* tls =
+    conn.host.url.scheme == "https" ? _options.tls : nullptr;
+
+  auto socket = std::make_unique<net::Socket>();
+  conn.socket = socket.get();
+  co_await socket->connect({.hostname = hostname, .service = port});
+  if (!tls) {
+    conn.stream = std::move(socket);
+  } else {
+    std::unique_ptr<net::TLSStream> stream =
+      tls->wrap_stream(std::move(socket), hostname);
+    co_await stream->handshake();
+    conn.stream = std::move(stream);
+  }
+  conn.connected = true;
+}
+
+co::Future<void> HttpClient::_write_requests(Connection& conn) {
+  // Pipelined requests go out together in one write.
+  std::string out;
+  for (; conn.written < conn.in_flight.size(); ++conn.written) {
+    out += conn.in_flight[conn.written]->request;
+    ++_stats.requests_sent;
+    if (conn.requests++ > 0) ++_stats.requests_reused;
+  }
+  if (out.empty()) co_return;
+
+  std::size_t sent = 0;
+  while (sent < out.size()) {
+    const Buffer buffer{
+      reinterpret_cast<std::uint8_t*>(out.data()) + sent,
+      out.size() - sent
+    };
+    const std::size_t bytes_sent = co_await conn.stream->write(buffer);
+    if (bytes_sent == 0) {
+      throw Unavailable() << "Connection closed while sending the request.";
+    }
+    sent += bytes_sent;
+  }
+  co_await conn.stream->flush();
+}
+
+co::Future<void> HttpClient::_read_response(
+  Connection& conn,
+  Exchange& exchange
+) {
+  const std::size_t max_size = _options.max_response_size;
+
+  // Informational responses come before the real one, and are skipped.
+  std::optional<HttpClientResponse> response;
+  while (!response) {
+    std::size_t header_end = conn.input.find("\r\n\r\n");
+    while (header_end == std::string::npos) {
+      if (conn.input.size() > MAX_HEADER_SIZE) {
+        throw ResourceExhausted()
+          << "Response header is larger than " << MAX_HEADER_SIZE << " bytes.";
+      }
+      if (!conn.input.empty()) exchange.response_started = true;
+      if (!co_await conn.fill()) {
+        throw Unavailable()
+          << "Connection closed before the response was complete.";
+      }
+      exchange.response_started = true;
+      header_end = conn.input.find("\r\n\r\n");
+    }
+    exchange.response_started = true;
+    HttpClientResponse parsed{conn.input.substr(0, header_end + 4)};
+    conn.input.erase(0, header_end + 4);
+    if (parsed.status() >= 200) response.emplace(std::move(parsed));
+  }
+
+  bool keep_alive =
+    !exchange.close_after && response->http_version() != "HTTP/1.0";
+  if (response->has_header("connection")) {
+    const std::string_view connection = response->header("connection");
+    if (has_header_token(connection, "close")) keep_alive = false;
+    if (
+      !exchange.close_after && has_header_token(connection, "keep-alive")
+    ) {
+      keep_alive = true;
+    }
+  }
+
+  std::string body;
+  const int status = response->status();
+  if (exchange.head || status == 204 || status == 304) {
+    // These never have a body, whatever their headers say.
+  } else if (
+    response->has_header("transfer-encoding") &&
+    has_header_token(response->header("transfer-encoding"), "chunked")
+  ) {
+    co_await conn.read_chunked(body, max_size);
+  } else if (response->has_header("content-length")) {
+    const std::size_t length =
+      parse_content_length(response->header("content-length"));
+    if (length > max_size) {
+      throw ResourceExhausted()
+        << "Response body is larger than " << max_size << " bytes.";
+    }
+    co_await conn.fill_to(length);
+    if (conn.input.size() == length) {
+      body = std::move(conn.input);
+      conn.input.clear();
+    } else {
+      body = conn.input.substr(0, length);
+      conn.input.erase(0, length);
+    }
+  } else {
+    // Without a length, the body runs until the server closes.
+    while (co_await conn.fill()) {
+      if (conn.input.size() > max_size) {
+        throw ResourceExhausted()
+          << "Response body is larger than " << max_size << " bytes.";
+      }
+    }
+    body = std::move(conn.input);
+    conn.input.clear();
+    keep_alive = false;
+  }
+
+  if (!keep_alive) conn.closed = true;
+  response->body(std::move(body));
+  exchange.resolve(std::move(*response));
+}
+
+void HttpClient::_abandon(Connection& conn, std::exception_ptr err) {
+  Host& host = conn.host;
+  conn.closed = true;
+  std::shared_ptr<Connection> keep_alive;
+  std::erase_if(
+    host.connections,
+    [&](std::shared_ptr<Connection>& c) {
+      if (c.get() != &conn) return false;
+      keep_alive = std::move(c);
+      return true;
+    }
+  );
+  if (conn.stream && conn.stream->good()) conn.stream->close();
+
+  // Retried requests go back to the front of the line, in their order.
+  std::deque<std::shared_ptr<Exchange>> in_flight = std::move(conn.in_flight);
+  conn.in_flight.clear();
+  conn.written = 0;
+  for (auto itr = in_flight.rbegin(); itr != in_flight.rend(); ++itr) {
+    Exchange& exchange = **itr;
+    if (exchange.settled) continue;
+    if (
+      conn.connected && exchange.idempotent && !exchange.retried &&
+      !exchange.response_started
+    ) {
+      exchange.retried = true;
+      host.waiting.push_front(std::move(*itr));
+    } else {
+      exchange.fail(err);
+    }
+  }
+  _dispatch(host);
+}
+
+co::Task HttpClient::_watch_deadlines(std::shared_ptr<const bool> alive) {
+  const std::chrono::milliseconds interval =
+    std::min(_options.request_timeout, MAX_DEADLINE_CHECK_INTERVAL);
+  while (true) {
+    co_await co::sleep_for(interval);
+    if (!*alive) co_return;
+    if (_outstanding == 0) {
+      _watching = false;
+      co_return;
+    }
+
+    const steady_clock::time_point now = steady_clock::now();
+    auto expire = [&](Exchange& exchange) {
+      if (exchange.settled || exchange.deadline > now) return false;
+      exchange.fail(std::make_exception_ptr(
+        DeadlineExceeded()
+          << "Request timed out after " << _options.request_timeout.count()
+          << "ms."
+      ));
+      return true;
+    };
+    for (auto& [origin, host] : _hosts) {
+      std::erase_if(host->waiting, [&](std::shared_ptr<Exchange>& exchange) {
+        return expire(*exchange) || exchange->settled;
+      });
+
+      // A late response would still arrive on the connection, so it is closed
+      // and whatever else was sent on it goes again elsewhere.
+      for (std::shared_ptr<Connection>& conn : host->connections) {
+        bool expired = false;
+        for (std::shared_ptr<Exchange>& exchange : conn->in_flight) {
+          expired = expire(*exchange) || expired;
+        }
+        if (!expired) continue;
+        conn->closed = true;
+        if (conn->socket && conn->socket->is_open()) conn->socket->shutdown();
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "lw/co/future.h"
+#include "lw/co/task.h"
+#include "lw/http/headers.h"
+#include "lw/net/tls.h"
+
+namespace lw {
+
+/**
+ * Outgoing HTTP request to be sent by an `HttpClient`.
+ */
+struct HttpClientRequest {
+  std::string method = "GET";
+
+  /**
+   * Absolute "http" or "https" URL, such as "http://localhost:8080/echo?a=b".
+   */
+  std::string url;
+
+  /**
+   * Sent after the Host header. Connection defaults to keep-alive and
+   * Content-Length to the size of `body` unless given here.
+   */
+  http::Headers headers;
+
+  std::string body;
+};
+
+/**
+ * Incoming HTTP response received by an `HttpClient`. The status line and
+ * headers are views into the raw header, parsed the same way as `HttpRequest`.
+ */
+class HttpClientResponse {
+public:
+  /**
+   * Parses a header read up to and including the empty line which ends it.
+   *
+   * @throw InvalidArgument
+   *  If the header is malformed.
+   */
+  explicit HttpClientResponse(std::string raw_header);
+
+  HttpClientResponse(HttpClientResponse&& other);
+  HttpClientResponse& operator=(HttpClientResponse&& other);
+  HttpClientResponse(const HttpClientResponse&) = delete;
+  HttpClientResponse& operator=(const HttpClientResponse&) = delete;
+
+  std::string_view http_version() const { return _http_version; }
+  int status() const { return _status; }
+  std::string_view reason() const { return _reason; }
+  std::string_view raw_header() const { return _raw_header; }
+
+  bool has_header(std::string_view header_name) const {
+    return _headers.contains(header_name);
+  }
+
+  std::string_view header(std::string_view header_name) const {
+    return _headers.at(header_name);
+  }
+
+  const http::HeadersView& headers() const { return _headers; }
+
+  std::string_view body() const { return _body; }
+  void body(std::string body) { _body = std::move(body); }
+
+private:
+  void _parse_header();
+
+  std::string _raw_header;
+  std::string_view _http_version;
+  int _status = 0;
+  std::string_view _reason;
+  http::HeadersView _headers;
+  std::string _body;
+};
+
+/**
+ * Sends HTTP/1.1 requests, keeping connections to each host open between
+ * them.
+ *
+ * Every host gets its own pool of connections. Requests go to an idle
+ * connection when there is one, open a new connection while the host is under
+ * `max_connections_per_host`, or are pipelined behind earlier requests up to
+ * `max_pipelined_requests`. Past that they wait in order for a connection to
+ * free up, bounding how hard any one host is hit.
+ *
+ * The client must outlive the futures it returns, and be used from only one
+ * scheduler thread.
+ */
+class HttpClient {
+public:
+  struct Options {
+    /**
+     * Most connections open to any one host at a time.
+     */
+    std::size_t max_connections_per_host = 8;
+
+    /**
+     * Most requests sent on a connection before its oldest response arrives.
+     * Only GET, HEAD, PUT, DELETE and OPTIONS requests are pipelined, so that
+     * any cut off by a closed connection can be sent again safely. When 1,
+     * requests wait for the connection to go idle.
+     */
+    std::size_t max_pipelined_requests = 1;
+
+    /**
+     * How long a request may take, from being sent until its whole response
+     * has arrived, including any time spent waiting for a connection. When 0,
+     * requests never time out.
+     */
+    std::chrono::milliseconds request_timeout{30'000};
+
+    /**
+     * Largest response body accepted.
+     */
+    std::size_t max_response_size = 64 * 1024 * 1024;
+
+    /**
+     * Wraps connections to "https" URLs, which fail without it. It must be in
+     * `CONNECT` mode and outlive the client.
+     */
+    net::TLSStreamFactory* tls = nullptr;
+  };
+
+  struct Stats {
+    std::uint64_t connections_opened = 0;
+    std::uint64_t requests_sent = 0;
+
+    /**
+     * Requests sent on a connection which had already been used.
+     */
+    std::uint64_t requests_reused = 0;
+  };
+
+  HttpClient(): HttpClient(Options{}) {}
+  explicit HttpClient(Options options);
+  ~HttpClient();
+
+  HttpClient(const HttpClient&) = delete;
+  HttpClient& operator=(const HttpClient&) = delete;
+
+  /**
+   * Sends the request to the host named in its URL.
+   *
+   * Idempotent requests cut off by their connection closing before any of
+   * their response arrived are sent once more on another connection, as
+   * servers may close idle connections at any time.
+   *
+   * @throw InvalidArgument
+   *  If the URL is not an absolute "http" or "https" URL, or the response is
+   *  malformed.
+   * @throw FailedPrecondition
+   *  If the URL is "https" but no TLS factory was given.
+   * @throw DeadlineExceeded
+   *  If the response is not complete within `request_timeout`.
+   * @throw Unavailable
+   *  If the connection closes before the response is complete.
+   * @throw ResourceExhausted
+   *  If the response is larger than `max_response_size`.
+   */
+  co::Future<HttpClientResponse> send(HttpClientRequest request);
+
+  co::Future<HttpClientResponse> get(std::string url) {
+    return send({.url = std::move(url)});
+  }
+
+  co::Future<HttpClientResponse> post(std::string url, std::string body) {
+    return send({
+      .method = "POST",
+      .url = std::move(url),
+      .body = std::move(body)
+    });
+  }
+
+  Stats stats() const { return _stats; }
+
+private:
+  struct Exchange;
+  struct Host;
+  struct Connection;
+
+  /**
+   * Hands waiting requests to connections until none are left or every
+   * connection to the host is busy.
+   */
+  void _dispatch(Host& host);
+
+  /**
+   * Connects if needed and then sends requests and receives responses on the
+   * connection until it has no more requests.
+   */
+  co::Task _run_connection(
+    std::shared_ptr<Connection> conn,
+    std::shared_ptr<const bool> alive
+  );
+
+  co::Future<void> _connect(Connection& conn);
+  co::Future<void> _write_requests(Connection& conn);
+  co::Future<void> _read_response(Connection& conn, Exchange& exchange);
+
+  /**
+   * Fails the requests still on a connection which can no longer be used,
+   * sending cut off idempotent ones again where allowed.
+   */
+  void _abandon(Connection& conn, std::exception_ptr err);
+
+  /**
+   * Periodically fails requests past their deadline, for as long as any are
+   * outstanding.
+   */
+  co::Task _watch_deadlines(std::shared_ptr<const bool> alive);
+
+  Options _options;
+  Stats _stats;
+  std::unordered_map<std::string, std::unique_ptr<Host>> _hosts;
+  std::size_t _outstanding = 0;
+  bool _watching = false;
+  std::shared_ptr<bool> _alive = std::make_shared<bool>(true);
+};
+
+}
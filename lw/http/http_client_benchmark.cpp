@@ -0,0 +1,98 @@
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/http/http.h"
+#include "lw/http/http_client.h"
+#include "lw/http/http_handler.h"
+#include "lw/net/socket.h"
+
+namespace lw {
+namespace {
+
+constexpr const char* PORT = "8453";
+constexpr const char* URL = "http://localhost:8453/echo?user=1234";
+
+/**
+ * The handler from the echo server example.
+ */
+class EchoHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    response().body(std::string{request().raw_path()});
+    co_return;
+  }
+};
+LW_REGISTER_HTTP_HANDLER(EchoHandler, "/echo");
+
+/**
+ * Serves the router over loopback on this thread for every benchmark.
+ */
+void start_server() {
+  static HttpRouter router;
+  static net::Socket listener;
+  if (listener.is_open()) return;
+
+  router.attach_routes();
+  listener.listen({.hostname = "localhost", .service = PORT});
+  auto accept = []() -> co::Task {
+    while (true) {
+      auto conn = std::make_unique<net::Socket>(co_await listener.accept());
+      co::Scheduler::this_thread().schedule(router.run(std::move(conn)));
+    }
+  };
+  co::Scheduler::this_thread().schedule(accept);
+}
+
+/**
+ * `state.range(0)` concurrent requests, over at most `state.range(1)`
+ * connections pipelining up to `state.range(2)` requests each. When
+ * `state.range(3)` is 0 every request asks for its connection to be closed,
+ * as a client without pooling would.
+ */
+void BM_HttpClientRequests(benchmark::State& state) {
+  start_server();
+  const std::size_t concurrency = state.range(0);
+  HttpClient client{{
+    .max_connections_per_host = static_cast<std::size_t>(state.range(1)),
+    .max_pipelined_requests = static_cast<std::size_t>(state.range(2))
+  }};
+  HttpClientRequest request{.url = URL};
+  if (!state.range(3)) request.headers["Connection"] = "close";
+
+  auto run_requests = [&]() -> co::Task {
+    std::vector<co::Future<HttpClientResponse>> pending;
+    for (std::size_t i = 0; i < concurrency; ++i) {
+      pending.push_back(client.send(request));
+    }
+    std::vector<HttpClientResponse> responses =
+      co_await co::all(std::move(pending));
+    benchmark::DoNotOptimize(responses);
+    co::Scheduler::this_thread().stop();
+  };
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(run_requests);
+    co::Scheduler::this_thread().run();
+  }
+
+  const HttpClient::Stats stats = client.stats();
+  state.SetItemsProcessed(stats.requests_sent);
+  state.counters["connections"] = stats.connections_opened;
+  state.counters["reuse_rate"] =
+    static_cast<double>(stats.requests_reused) / stats.requests_sent;
+}
+BENCHMARK(BM_HttpClientRequests)
+  ->ArgNames({"concurrency", "connections", "pipelined", "keep_alive"})
+  ->Args({1, 1, 1, 0})->Args({1, 1, 1, 1})
+  ->Args({16, 8, 1, 0})->Args({16, 8, 1, 1})
+  ->Args({64, 8, 1, 1})->Args({64, 8, 8, 1})
+  ->UseRealTime();
+
+}
+}
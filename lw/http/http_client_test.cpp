@@ -0,0 +1,304 @@
+#include "lw/http/http_client.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/co/testing/destroy_scheduler.h"
+#include "lw/co/time.h"
+#include "lw/err/canonical.h"
+#include "lw/http/http.h"
+#include "lw/http/http_handler.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/socket.h"
+
+namespace lw {
+namespace {
+
+constexpr const char* PORT = "8452";
+constexpr const char* ORIGIN = "http://localhost:8452";
+
+class ClientEchoHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    response().body(std::string{request().raw_path()});
+    co_return;
+  }
+
+  co::Future<void> post() override {
+    response().body(co_await request().body());
+  }
+};
+LW_REGISTER_HTTP_HANDLER(ClientEchoHandler, "/client/echo");
+
+class ClientSlowHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    co_await co::sleep_for(std::chrono::milliseconds{500});
+    response().body("late");
+  }
+};
+LW_REGISTER_HTTP_HANDLER(ClientSlowHandler, "/client/slow");
+
+class HttpClientTest: public ::testing::Test {
+protected:
+  HttpClientTest() { _router.attach_routes(); }
+  ~HttpClientTest() { co::testing::destroy_all_schedulers(); }
+
+  /**
+   * Runs `test` against the router listening on loopback, or a server which
+   * answers every request with `canned` if given.
+   */
+  void serve(
+    std::function<co::Future<void>()> test,
+    std::optional<std::string> canned = std::nullopt
+  ) {
+    net::Socket listener;
+    listener.listen({.hostname = "localhost", .service = PORT});
+    auto respond = [&](std::unique_ptr<net::Socket> conn) -> co::Task {
+      Buffer request{4096};
+      co_await conn->read(request);
+      Buffer response{canned->begin(), canned->end()};
+      co_await conn->write(response);
+      conn->close();
+    };
+    auto accept = [&]() -> co::Task {
+      while (true) {
+        auto conn = std::make_unique<net::Socket>(co_await listener.accept());
+        if (canned) {
+          co::Scheduler::this_thread().schedule(respond(std::move(conn)));
+        } else {
+          co::Scheduler::this_thread().schedule(_router.run(std::move(conn)));
+        }
+      }
+    };
+    auto run = [&]() -> co::Task {
+      try {
+        co_await test();
+      } catch (const std::exception& err) {
+        ADD_FAILURE() << err.what();
+      }
+      co::Scheduler::this_thread().stop();
+    };
+    co::Scheduler::this_thread().schedule(accept);
+    co::Scheduler::this_thread().schedule(run);
+    co::Scheduler::this_thread().run();
+  }
+
+  HttpRouter _router;
+};
+
+TEST_F(HttpClientTest, ReusesConnections) {
+  HttpClient client;
+  serve([&]() -> co::Future<void> {
+    for (int i = 0; i < 3; ++i) {
+      HttpClientResponse res =
+        co_await client.get(std::string{ORIGIN} + "/client/echo?i=" +
+          std::to_string(i));
+      EXPECT_EQ(res.status(), 200);
+      EXPECT_EQ(res.reason(), "OK");
+      EXPECT_EQ(res.body(), "/client/echo?i=" + std::to_string(i));
+    }
+    HttpClientResponse posted =
+      co_await client.post(std::string{ORIGIN} + "/client/echo", "hello");
+    EXPECT_EQ(posted.body(), "hello");
+  });
+  EXPECT_EQ(client.stats().connections_opened, 1u);
+  EXPECT_EQ(client.stats().requests_sent, 4u);
+  EXPECT_EQ(client.stats().requests_reused, 3u);
+}
+
+TEST_F(HttpClientTest, LimitsConnectionsPerHost) {
+  HttpClient client{{.max_connections_per_host = 2}};
+  serve([&]() -> co::Future<void> {
+    std::vector<co::Future<HttpClientResponse>> pending;
+    for (int i = 0; i < 6; ++i) {
+      pending.push_back(client.get(
+        std::string{ORIGIN} + "/client/echo?i=" + std::to_string(i)
+      ));
+    }
+    std::vector<HttpClientResponse> responses =
+      co_await co::all(std::move(pending));
+    for (int i = 0; i < 6; ++i) {
+      EXPECT_EQ(responses[i].body(), "/client/echo?i=" + std::to_string(i));
+    }
+  });
+  EXPECT_EQ(client.stats().connections_opened, 2u);
+  EXPECT_EQ(client.stats().requests_reused, 4u);
+}
+
+TEST_F(HttpClientTest, PipelinesRequests) {
+  HttpClient client{{
+    .max_connections_per_host = 1,
+    .max_pipelined_requests = 4
+  }};
+  serve([&]() -> co::Future<void> {
+    std::vector<co::Future<HttpClientResponse>> pending;
+    for (int i = 0; i < 4; ++i) {
+      pending.push_back(client.get(
+        std::string{ORIGIN} + "/client/echo?i=" + std::to_string(i)
+      ));
+    }
+    std::vector<HttpClientResponse> responses =
+      co_await co::all(std::move(pending));
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_EQ(responses[i].body(), "/client/echo?i=" + std::to_string(i));
+    }
+  });
+  EXPECT_EQ(client.stats().connections_opened, 1u);
+  EXPECT_EQ(client.stats().requests_sent, 4u);
+}
+
+TEST_F(HttpClientTest, RetriesOnConnectionsClosedWhileIdle) {
+  HttpClient client;
+  serve(
+    [&]() -> co::Future<void> {
+      for (int i = 0; i < 2; ++i) {
+        HttpClientResponse res =
+          co_await client.get(std::string{ORIGIN} + "/");
+        EXPECT_EQ(res.body(), "ok");
+        co_await co::sleep_for(std::chrono::milliseconds{10});
+      }
+    },
+    // Closes the connection after responding, without saying so.
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 2\r\n"
+    "\r\n"
+    "ok"
+  );
+  EXPECT_EQ(client.stats().connections_opened, 2u);
+  EXPECT_EQ(client.stats().requests_sent, 3u);
+}
+
+TEST_F(HttpClientTest, TimesOutSlowRequests) {
+  HttpClient client{{.request_timeout = std::chrono::milliseconds{50}}};
+  serve([&]() -> co::Future<void> {
+    EXPECT_THROW(
+      co_await client.get(std::string{ORIGIN} + "/client/slow"),
+      DeadlineExceeded
+    );
+    HttpClientResponse res =
+      co_await client.get(std::string{ORIGIN} + "/client/echo");
+    EXPECT_EQ(res.body(), "/client/echo");
+  });
+  EXPECT_EQ(client.stats().connections_opened, 2u);
+}
+
+TEST_F(HttpClientTest, DecodesChunkedBodies) {
+  HttpClient client;
+  serve(
+    [&]() -> co::Future<void> {
+      HttpClientResponse res = co_await client.get(std::string{ORIGIN} + "/");
+      EXPECT_EQ(res.status(), 201);
+      EXPECT_EQ(res.reason(), "Created");
+      EXPECT_EQ(res.header("x-test"), "yes");
+      EXPECT_EQ(res.body(), "hello world");
+    },
+    "HTTP/1.1 100 Continue\r\n"
+    "\r\n"
+    "HTTP/1.1 201 Created\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "X-Test: yes\r\n"
+    "\r\n"
+    "5\r\nhello\r\n"
+    "6;name=value\r\n world\r\n"
+    "0\r\n"
+    "Trailer: ignored\r\n"
+    "\r\n"
+  );
+}
+
+TEST_F(HttpClientTest, ReadsBodiesUntilClose) {
+  HttpClient client;
+  serve(
+    [&]() -> co::Future<void> {
+      HttpClientResponse res = co_await client.get(std::string{ORIGIN} + "/");
+      EXPECT_EQ(res.status(), 200);
+      EXPECT_EQ(res.body(), "until the end");
+    },
+    "HTTP/1.0 200 OK\r\n"
+    "\r\n"
+    "until the end"
+  );
+}
+
+TEST_F(HttpClientTest, RejectsMalformedResponses) {
+  HttpClient client;
+  serve(
+    [&]() -> co::Future<void> {
+      EXPECT_THROW(
+        co_await client.get(std::string{ORIGIN} + "/"),
+        InvalidArgument
+      );
+    },
+    "HTTP/1.1 2x0 OK\r\n"
+    "\r\n"
+  );
+}
+
+TEST_F(HttpClientTest, RejectsUnsupportedUrls) {
+  HttpClient client;
+  serve([&]() -> co::Future<void> {
+    EXPECT_THROW(co_await client.get("localhost/foo"), InvalidArgument);
+    EXPECT_THROW(co_await client.get("ftp://localhost/foo"), InvalidArgument);
+    EXPECT_THROW(co_await client.get("http://:80/foo"), InvalidArgument);
+    EXPECT_THROW(
+      co_await client.get("https://localhost/foo"),
+      FailedPrecondition
+    );
+  });
+}
+
+TEST_F(HttpClientTest, RejectsInjectedRequestParts) {
+  const std::vector<HttpClientRequest> requests{
+    {.url = "http://localhost/a HTTP/1.1\r\nX-Evil: 1"},
+    {.url = "http://localhost/a?b=c\r\n\r\nGET /d"},
+    {.url = "http://localhost/a b"},
+    {.url = "http://local\nhost/"},
+    {.method = "GET / HTTP/1.1\r\n", .url = "http://localhost/"},
+    {.method = "", .url = "http://localhost/"},
+    {.url = "http://localhost/", .headers = {{"X-Bad", "a\r\nX-Evil: 1"}}},
+    {.url = "http://localhost/", .headers = {{"X-Bad\r\nX-Evil", "1"}}},
+    {.url = "http://localhost/", .headers = {{"X Bad", "1"}}},
+    {.url = "http://localhost/", .headers = {{"X-Bad:", "1"}}}
+  };
+  HttpClient client;
+  serve([&]() -> co::Future<void> {
+    for (const HttpClientRequest& request : requests) {
+      EXPECT_THROW(co_await client.send(request), InvalidArgument)
+        << request.method << ' ' << request.url;
+    }
+  });
+}
+
+TEST(HttpClientResponse, ParsesStatusAndHeaders) {
+  HttpClientResponse res{
+    "HTTP/1.1 404 Not Found\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n"
+  };
+  EXPECT_EQ(res.http_version(), "HTTP/1.1");
+  EXPECT_EQ(res.status(), 404);
+  EXPECT_EQ(res.reason(), "Not Found");
+  EXPECT_EQ(res.header("content-length"), "0");
+
+  HttpClientResponse moved = std::move(res);
+  EXPECT_EQ(moved.status(), 404);
+  EXPECT_EQ(moved.header("Content-Length"), "0");
+
+  EXPECT_EQ(HttpClientResponse{"HTTP/1.1 204\r\n\r\n"}.reason(), "");
+  EXPECT_THROW(HttpClientResponse{"HTTP/1.1\r\n\r\n"}, InvalidArgument);
+  EXPECT_THROW(HttpClientResponse{"HTTP/1.1 99 Hm\r\n\r\n"}, InvalidArgument);
+  EXPECT_THROW(HttpClientResponse{"FTP/1.1 200 OK\r\n\r\n"}, InvalidArgument);
+}
+
+}
+}
@@ -2,6 +2,7 @@
 
 #include "lw/co/future.h"
 #include "lw/http/http_response.h"
+#include "lw/io/co/co.h"
 
 namespace lw {
 
@@ -13,4 +14,9 @@ co::Future<void> HttpHandler::_default_behavior() {
   return co::make_resolved_future();
 }
 
+co::Future<void> HttpHandler::upgrade(io::CoStream& conn) {
+  conn.close();
+  return co::make_resolved_future();
+}
+
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <string_view>
@@ -7,6 +8,8 @@
 #include "lw/co/future.h"
 #include "lw/http/http_request.h"
 #include "lw/http/http_response.h"
+#include "lw/http/http_status_error.h"
+#include "lw/io/co/co.h"
 
 namespace lw {
 
@@ -21,6 +24,7 @@ public:
   ) {
     _request = &request;
     _response = &response;
+    if (request.has_header("accept")) response.accept(request.header("accept"));
   }
 
   const HttpRequest& request() const { return *_request; }
@@ -34,6 +38,12 @@ public:
   virtual co::Future<void> post() {     return _default_behavior(); }
   virtual co::Future<void> put() {      return _default_behavior(); }
 
+  /**
+   * Takes over the connection once a `101 Switching Protocols` response from
+   * this handler has been sent. By default the connection is just closed.
+   */
+  virtual co::Future<void> upgrade(io::CoStream& conn);
+
 private:
   co::Future<void> _default_behavior();
 
@@ -41,12 +51,45 @@ private:
   HttpResponse* _response = nullptr;
 };
 
+/**
+ * Response caching options for a handler, given at registration time.
+ *
+ * ```cpp
+ *  LW_REGISTER_HTTP_HANDLER(MyHandler, "/my/:endpoint", {
+ *    .ttl = std::chrono::seconds{30}
+ *  });
+ * ```
+ *
+ * Only successful `GET` responses are cached. Cached responses are keyed on the
+ * request path, query parameters and `Accept` header, so the format chosen by
+ * `HttpResponse::send` is respected. Handlers must not vary their output on
+ * anything else (e.g. other headers or cookies) when caching is enabled;
+ * responses with a `Vary` header naming anything besides `Accept` are not
+ * cached.
+ */
+struct HttpCachePolicy {
+  /**
+   * How long a cached response remains fresh. The default of zero disables
+   * caching for the handler.
+   */
+  std::chrono::milliseconds ttl{0};
+
+  bool cacheable() const { return ttl.count() > 0; }
+};
+
 class BaseHttpHandlerFactory {
 public:
-  explicit BaseHttpHandlerFactory(std::string_view route): _route{route} {}
+  explicit BaseHttpHandlerFactory(
+    std::string_view route,
+    HttpCachePolicy cache_policy = {}
+  ):
+    _route{route},
+    _cache_policy{cache_policy}
+  {}
   virtual ~BaseHttpHandlerFactory() = default;
 
   std::string_view route() const { return _route; }
+  const HttpCachePolicy& cache_policy() const { return _cache_policy; }
 
   virtual std::unique_ptr<HttpHandler> make_handler(
     const HttpRequest& request,
@@ -55,13 +98,17 @@ public:
 
 private:
   std::string _route;
+  HttpCachePolicy _cache_policy;
 };
 
 template <typename HandlerType>
 class HttpHandlerFactory: public BaseHttpHandlerFactory {
 public:
-  explicit HttpHandlerFactory(std::string_view route):
-    BaseHttpHandlerFactory{route}
+  explicit HttpHandlerFactory(
+    std::string_view route,
+    HttpCachePolicy cache_policy = {}
+  ):
+    BaseHttpHandlerFactory{route, cache_policy}
   {}
 
   std::unique_ptr<HttpHandler> make_handler(
@@ -0,0 +1,220 @@
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/http/http.h"
+#include "lw/http/http_handler.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/io/serializer/serialized_value.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer.h"
+#include "lw/mime/json.h"
+#include "lw/net/socket.h"
+
+namespace lw {
+namespace {
+
+struct Item {
+  std::uint64_t id;
+  std::string name;
+  double score;
+  bool active;
+};
+
+struct Items {
+  std::vector<Item> items;
+};
+
+}
+}
+
+template <>
+struct lw::io::Serialize<lw::Item> {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::Item& value) {
+    serializer.write("id", value.id);
+    serializer.write("name", value.name);
+    serializer.write("score", value.score);
+    serializer.write("active", value.active);
+  }
+
+  lw::Item deserialize(const SerializedValue& value) {
+    return lw::Item{
+      .id = value.get<std::uint64_t>("id"),
+      .name = std::string{value.get<std::string_view>("name")},
+      .score = value.get<double>("score"),
+      .active = value.get<bool>("active")
+    };
+  }
+};
+
+template <>
+struct lw::io::Serialize<lw::Items> {
+  typedef ListTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::Items& value) {
+    for (const lw::Item& item : value.items) serializer.write(item);
+  }
+
+  lw::Items deserialize(const SerializedValue& value) {
+    lw::Items items;
+    for (std::size_t i = 0; value.has(i); ++i) {
+      items.items.push_back(value.get<lw::Item>(i));
+    }
+    return items;
+  }
+};
+
+namespace lw {
+namespace {
+
+/**
+ * Echoes the body the way handlers did before `body_as` and `send`: copying it
+ * out of the connection, then serializing the reply into a string stream.
+ */
+class ManualEchoHandler: public HttpHandler {
+public:
+  co::Future<void> post() override {
+    Buffer body = co_await request().body();
+    const std::string json{static_cast<std::string_view>(body)};
+    std::unique_ptr<io::DeserializationToken> token =
+      mime::JSONDeserializationParser{}.parse(json);
+    const Items items = io::SerializedValue{*token}.as<Items>();
+
+    std::stringstream stream;
+    io::Serializer serializer{mime::JSONSerializer{}.make_formatter(stream)};
+    serializer.write(items);
+    response().header("Content-Type", "application/json");
+    response().body(stream.str());
+  }
+};
+LW_REGISTER_HTTP_HANDLER(ManualEchoHandler, "/echo/manual");
+
+class TypedEchoHandler: public HttpHandler {
+public:
+  co::Future<void> post() override {
+    response().send(co_await request().body_as<Items>());
+  }
+};
+LW_REGISTER_HTTP_HANDLER(TypedEchoHandler, "/echo/typed");
+
+std::string make_request(std::string_view path, std::size_t count) {
+  std::string body = "[";
+  for (std::size_t i = 0; i < count; ++i) {
+    if (i) body += ',';
+    body +=
+      "{\"id\":" + std::to_string(i * 7919) + ",\"name\":\"user_" +
+      std::to_string(i) + "\",\"score\":" + std::to_string(i % 100) +
+      ".25,\"active\":" + (i % 3 ? "true" : "false") + "}";
+  }
+  body += ']';
+
+  return
+    std::string{"POST "} + std::string{path} + " HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+    "\r\n" + body;
+}
+
+/**
+ * Connects to the router over loopback, leaving the router serving the far
+ * end of the returned socket.
+ */
+std::unique_ptr<net::Socket> connect_router(
+  HttpRouter& router,
+  const char* port
+) {
+  const net::Address addr{.hostname = "localhost", .service = port};
+  std::unique_ptr<net::Socket> client;
+  int remaining = 2;
+  auto accept = [&]() -> co::Task {
+    net::Socket listener;
+    listener.listen(addr);
+    co::Scheduler::this_thread().schedule(router.run(
+      std::make_unique<net::Socket>(co_await listener.accept())
+    ));
+    if (--remaining == 0) co::Scheduler::this_thread().stop();
+  };
+  auto connect = [&]() -> co::Task {
+    client = std::make_unique<net::Socket>();
+    co_await client->connect(addr);
+    if (--remaining == 0) co::Scheduler::this_thread().stop();
+  };
+  co::Scheduler::this_thread().schedule(accept);
+  co::Scheduler::this_thread().schedule(connect);
+  co::Scheduler::this_thread().run();
+  return client;
+}
+
+/**
+ * Reads one whole response, using its `Content-Length` to find the end.
+ */
+co::Future<void> read_response(net::Socket& socket, Buffer& buffer) {
+  std::string received;
+  std::size_t total = 0;
+  while (!total || received.size() < total) {
+    const std::size_t read = co_await socket.read(buffer);
+    received += static_cast<std::string_view>(buffer).substr(0, read);
+    const std::size_t head_end = received.find("\r\n\r\n");
+    if (total || head_end == std::string::npos) continue;
+
+    constexpr std::string_view LENGTH = "Content-Length: ";
+    const std::size_t length_start = received.find(LENGTH) + LENGTH.size();
+    std::size_t length = 0;
+    std::from_chars(
+      received.data() + length_start,
+      received.data() + head_end,
+      length
+    );
+    total = head_end + 4 + length;
+  }
+}
+
+/**
+ * Posts a JSON list of `state.range(0)` records to an endpoint which echoes it
+ * back, over a keep-alive HTTP/1.1 connection.
+ */
+void BM_HttpEchoJSON(benchmark::State& state, const char* path) {
+  HttpRouter router;
+  router.attach_routes();
+  std::unique_ptr<net::Socket> socket = connect_router(router, "8449");
+
+  const std::string request = make_request(path, state.range(0));
+  Buffer out{request.begin(), request.end()};
+  Buffer buffer{64 * 1024};
+  auto echo = [&]() -> co::Task {
+    co_await socket->write(out);
+    co_await read_response(*socket, buffer);
+    co::Scheduler::this_thread().stop();
+  };
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(echo);
+    co::Scheduler::this_thread().run();
+  }
+
+  socket->close();
+  co::Scheduler::this_thread().run();
+  state.SetBytesProcessed(state.iterations() * request.size());
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_HttpEchoJSON, manual, "/echo/manual")
+  ->ArgName("records")->Arg(1)->Arg(100)->Arg(10'000)
+  ->UseRealTime();
+BENCHMARK_CAPTURE(BM_HttpEchoJSON, typed, "/echo/typed")
+  ->ArgName("records")->Arg(1)->Arg(100)->Arg(10'000)
+  ->UseRealTime();
+
+}
+}
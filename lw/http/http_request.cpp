@@ -1,19 +1,28 @@
 #include "lw/http/http_request.h"
 
-#include <charconv>
 #include <experimental/source_location>
 #include <istream>
+#include <memory>
+#include <string>
 #include <string_view>
+#include <utility>
 
 #include "lw/co/future.h"
 #include "lw/err/canonical.h"
 #include "lw/err/macros.h"
 #include "lw/http/headers.h"
+#include "lw/http/http_response.h"
+#include "lw/http/http_status_error.h"
+#include "lw/http/internal/http_header_parser.h"
 #include "lw/io/co/co.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/mime/mime.h"
 
 namespace lw {
 namespace {
 
+using ::lw::http::internal::parse_content_length;
+using ::lw::http::internal::parse_header_lines;
 using std::experimental::source_location;
 
 /**
@@ -54,35 +63,6 @@ void check_is_space(
   }
 }
 
-/**
- * Asserts that the given position is inside the header and not a newline
- * character.
- *
- * @throw InvalidArgument
- *  If the position given by `i` is outside the header.
- * @throw InvalidArgument
- *  If the character at given position is either carriage return (`\r`) or
- *  newline (`\n`).
- */
-void check_not_line_end(
-  std::string_view header_view,
-  std::size_t i,
-  std::string_view expected,
-  const source_location& loc = source_location::current()
-) {
-  if (i >= header_view.size()) {
-    throw InvalidArgument(loc)
-      << "Unexpected end of input at position " << i << "; expected "
-      << expected;
-  }
-
-  if (header_view.at(i) == '\r' || header_view.at(i) == '\n') {
-    throw InvalidArgument(loc)
-      << "Unexpected end of line at position " << i << "; expected "
-      << expected;
-  }
-}
-
 /**
  * Inserts `string_views` defined by the start and end values given as key-value
  * pairs into the provided map.
@@ -149,6 +129,7 @@ void parse_query_params(
 
   // Check for a dangling param.
   if (key_start != i) {
+    if (parsing_key) key_end = value_start = i;
     insert_view_pairs(
       params_str,
       key_start, key_end,
@@ -158,64 +139,13 @@ void parse_query_params(
   }
 }
 
-/**
- * Parses the line as an HTTP header, returning the Key-Value pair and adjusting
- * the header view to after the line.
- *
- * @throw InvalidArgument
- *  If the end of the input is found before a proper header line is parsed.
- *
- * @param header_view
- *  A point to a string view containing an HTTP header. This view will be
- *  trimmed to exclude the parsed header line.
- *
- * @return
- *  The Key-Value pair parsed from the line of header.
- */
-std::pair<std::string_view, std::string_view> parse_header_line(
-  std::string_view* header_view
-) {
-  LW_CHECK_NULL(header_view);
-  std::size_t i = 0;
-  for (; i < header_view->size() && header_view->at(i) != ':'; ++i) {
-    check_not_line_end(*header_view, i, "':'");
-  }
-  if (i >= header_view->size()) {
-    throw InvalidArgument() << "Unexpected end of header at position " << i;
-  }
-  const std::size_t colon_pos = i++;
-
-  for (; i < header_view->size() && std::isspace(header_view->at(i)); ++i) {
-    if (header_view->at(i) == '\r' || header_view->at(i) == '\n') break;
-  }
-  if (i >= header_view->size()) {
-    throw InvalidArgument() << "Unexpected end of header at position " << i;
-  }
-  const std::size_t value_start = i;
-  const std::size_t value_end = header_view->find("\r\n", i);
-  if (value_end == std::string_view::npos) {
-    throw InvalidArgument() << "Unexpected end of input at position " << i;
-  }
-
-  // TODO(alaina): Trim the right-end of the header value. It could containe
-  // extra spaces before the \r\n which should be ignored.
-
-  auto results = std::make_pair(
-    header_view->substr(0, colon_pos),
-    header_view->substr(value_start, value_end - value_start)
-  );
-  header_view->remove_prefix(value_end + 2);
-  return results;
-}
-
 }
 
 co::Future<void> HttpRequest::read_header() {
   if (!_raw_header.empty()) {
     throw FailedPrecondition() << "Header already loaded.";
   }
-  _raw_header = std::string{co_await _connection.read_until("\r\n\r\n")};
-  _raw_header.shrink_to_fit();
+  std::string raw_header{co_await _connection.read_until("\r\n\r\n")};
 
   // TODO(alaina): Check that a proper header was loaded. If "\r\n\r\n" is never
   // encountered, that co_await will never return. This should schedule a
@@ -223,6 +153,16 @@ co::Future<void> HttpRequest::read_header() {
   // amount of time. If the connection closes before the header termination is
   // received then an empty buffer is returned.
 
+  parse_header(std::move(raw_header));
+}
+
+void HttpRequest::parse_header(std::string raw_header) {
+  if (!_raw_header.empty()) {
+    throw FailedPrecondition() << "Header already loaded.";
+  }
+  _raw_header = std::move(raw_header);
+  _raw_header.shrink_to_fit();
+
   std::size_t method_line_end = _parse_method_line(_raw_header);
   _parse_headers(
     std::string_view{
@@ -237,12 +177,35 @@ co::Future<Buffer> HttpRequest::body() const {
   // TODO(alaina): Implement other methods for determining the end of an HTTP
   // request's body.
   if (content_length() == 0) return co::make_resolved_future(Buffer{});
-  if (content_length() > 0) return _connection.read(content_length());
+  if (content_length() > 0) return _connection.read_exactly(content_length());
 
   throw Internal()
     << "Unsupported method of content body determination in request.";
 }
 
+std::unique_ptr<io::DeserializationToken> HttpRequest::_parse_body(
+  std::string_view body
+) const {
+  const std::string_view content_type =
+    has_header("content-type") ? header("content-type") : "application/json";
+  mime::MimeMatch match = mime::find_mime_serializer(content_type);
+  if (!match.serializer) {
+    throw HttpStatusError(HttpResponse::UNSUPPORTED_MEDIA_TYPE)
+      << "No serializer registered for request body of type " << content_type;
+  }
+
+  try {
+    return match.serializer->make_parser()->parse(body);
+  } catch (const InvalidArgument& err) {
+    _throw_bad_body(err);
+  }
+}
+
+void HttpRequest::_throw_bad_body(const Error& err) const {
+  throw HttpStatusError(HttpResponse::BAD_REQUEST)
+    << "Request body could not be deserialized: " << err;
+}
+
 std::size_t HttpRequest::_parse_method_line(std::string_view header_view) {
   // GET /foo/bar HTTP/1.1\r\n
   // Parse HTTP verb.
@@ -258,7 +221,10 @@ std::size_t HttpRequest::_parse_method_line(std::string_view header_view) {
   if (i < header_view.size() && header_view.at(i) == '?') {
     while (is_not_space(header_view, i)) ++i;
     check_is_space(header_view, i);
-    parse_query_params(header_view.substr(end + 1, i - end), &_query_params);
+    parse_query_params(
+      header_view.substr(end + 1, i - end - 1),
+      &_query_params
+    );
   }
   check_is_space(header_view, i);
   _path = header_view.substr(start, end - start);
@@ -280,9 +246,7 @@ std::size_t HttpRequest::_parse_method_line(std::string_view header_view) {
 }
 
 void HttpRequest::_parse_headers(std::string_view header_view) {
-  while (!header_view.starts_with("\r\n")) {
-    _headers.insert(parse_header_line(&header_view));
-  }
+  parse_header_lines(header_view, &_headers);
 }
 
 void HttpRequest::_parse_content_length() {
@@ -291,17 +255,7 @@ void HttpRequest::_parse_content_length() {
     return;
   }
 
-  std::string_view content_length_str = header("content-length");
-  auto res = std::from_chars(
-    content_length_str.begin(),
-    content_length_str.end(),
-    _content_length
-  );
-  if (res.ptr != content_length_str.end() || _content_length < 0) {
-    throw InvalidArgument()
-      << "Invalid Content-Length \"" << content_length_str
-      << "\"; expected a positive integer.";
-  }
+  _content_length = parse_content_length(header("content-length"));
 }
 
 }
@@ -1,12 +1,17 @@
 #pragma once
 
 #include <istream>
+#include <memory>
 #include <string>
 #include <string_view>
 
 #include "lw/co/future.h"
+#include "lw/err/canonical.h"
 #include "lw/http/headers.h"
 #include "lw/io/co/co.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/io/serializer/serialized_value.h"
+#include "lw/memory/buffer.h"
 
 namespace lw {
 
@@ -39,6 +44,7 @@ public:
   std::string_view query_param(std::string_view param_name) const {
     return _query_params.at(param_name);
   }
+  const http::HeadersView& query_params() const { return _query_params; }
 
   bool has_route_param(std::string_view param_name) const {
     return _route_params.contains(param_name);
@@ -64,8 +70,51 @@ public:
    */
   co::Future<void> read_header();
 
+  /**
+   * Parses a header which was read some other way, such as one rebuilt from
+   * the fields of an HTTP/2 request.
+   *
+   * @throw InvalidArgument
+   *  If the header is malformed.
+   *
+   * @throw FailedPrecondition
+   *  If the header has already been loaded.
+   */
+  void parse_header(std::string raw_header);
+
   co::Future<Buffer> body() const;
 
+  /**
+   * Reads the body and deserializes it as a `T` using the MIME serializer for
+   * its `Content-Type`, or JSON if the request has none. The body is parsed in
+   * place within the connection's read buffer.
+   *
+   * ```cpp
+   *  User user = co_await request().body_as<User>();
+   * ```
+   *
+   * @throw HttpStatusError
+   *  With 415 Unsupported Media Type if no serializer is registered for the
+   *  content type, or 400 Bad Request if the body is malformed or is not a
+   *  `T`.
+   */
+  template <typename T>
+  co::Future<T> body_as() const {
+    Buffer body = co_await this->body();
+    std::unique_ptr<io::DeserializationToken> token = _parse_body(body);
+    try {
+      co_return io::SerializedValue{*token}.template as<T>();
+    } catch (const FailedPrecondition& err) {
+      _throw_bad_body(err);
+    } catch (const InvalidArgument& err) {
+      // Values are decoded as they are read, so bad numbers and escapes only
+      // turn up here.
+      _throw_bad_body(err);
+    } catch (const OutOfRange& err) {
+      _throw_bad_body(err);
+    }
+  }
+
   /**
    * Reads and discards the remaining data for the request.
    */
@@ -75,6 +124,10 @@ private:
   std::size_t _parse_method_line(std::string_view header_view);
   void _parse_headers(std::string_view header_view);
   void _parse_content_length();
+  std::unique_ptr<io::DeserializationToken> _parse_body(
+    std::string_view body
+  ) const;
+  [[noreturn]] void _throw_bad_body(const Error& err) const;
 
   io::BaseCoReader& _connection;
 
@@ -1,15 +1,20 @@
 #include "lw/http/http_request.h"
 
 #include <sstream>
+#include <string>
 
 #include "gtest/gtest.h"
 #include "lw/co/scheduler.h"
 #include "lw/co/task.h"
+#include "lw/http/http_response.h"
+#include "lw/http/http_status_error.h"
 #include "lw/io/co/testing/string_reader.h"
+#include "lw/io/serializer/testing/tagged_types.h"
 
 namespace lw {
 namespace {
 
+using ::lw::io::testing::ObjectTagged;
 using ::lw::io::testing::StringReader;
 
 template <typename Func>
@@ -76,6 +81,22 @@ TEST(HttpRequestReadHeader, ParsesQueryString) {
   });
 }
 
+TEST(HttpRequestReadHeader, ParsesTrailingQueryValue) {
+  run([]() -> co::Task {
+    StringReader input{
+      "GET /foo/bar?fizz=bang&bar=42 HTTP/1.1\r\n"
+      "Host: test.com\r\n"
+      "\r\n"
+    };
+    HttpRequest req{input};
+    co_await req.read_header();
+
+    EXPECT_EQ(req.path(), "/foo/bar");
+    EXPECT_EQ(req.query_param("fizz"), "bang");
+    EXPECT_EQ(req.query_param("bar"), "42");
+  });
+}
+
 TEST(HttpRequestHeaders, HasHeaderIsTrueForProvidedHeaders) {
   run([]() -> co::Task {
     StringReader input{
@@ -163,5 +184,99 @@ TEST(HttpRequestBody, IsReadableFromContentLength) {
   });
 }
 
+TEST(HttpRequestBodyAs, DefaultsToJSON) {
+  run([]() -> co::Task {
+    StringReader input{
+      "POST /foo/bar HTTP/1.1\r\n"
+      "Content-Length: 24\r\n"
+      "\r\n"
+      "{\"a\": 1, \"b\": 2, \"c\": 3}"
+    };
+    HttpRequest req{input};
+    co_await req.read_header();
+
+    ObjectTagged body = co_await req.body_as<ObjectTagged>();
+    EXPECT_EQ(body, (ObjectTagged{.a = 1, .b = 2, .c = 3}));
+  });
+}
+
+TEST(HttpRequestBodyAs, UsesContentType) {
+  run([]() -> co::Task {
+    StringReader input{
+      "POST /foo/bar HTTP/1.1\r\n"
+      "Content-Type: application/cbor\r\n"
+      "Content-Length: 10\r\n"
+      "\r\n"
+      "\xa3" "\x61" "a" "\x01" "\x61" "b" "\x02" "\x61" "c" "\x03"
+    };
+    HttpRequest req{input};
+    co_await req.read_header();
+
+    ObjectTagged body = co_await req.body_as<ObjectTagged>();
+    EXPECT_EQ(body, (ObjectTagged{.a = 1, .b = 2, .c = 3}));
+  });
+}
+
+TEST(HttpRequestBodyAs, UnsupportedMediaType) {
+  run([]() -> co::Task {
+    StringReader input{
+      "POST /foo/bar HTTP/1.1\r\n"
+      "Content-Type: text/html\r\n"
+      "Content-Length: 5\r\n"
+      "\r\n"
+      "<br/>"
+    };
+    HttpRequest req{input};
+    co_await req.read_header();
+
+    try {
+      co_await req.body_as<ObjectTagged>();
+      ADD_FAILURE() << "Expected HttpStatusError.";
+    } catch (const HttpStatusError& err) {
+      EXPECT_EQ(err.status(), HttpResponse::UNSUPPORTED_MEDIA_TYPE);
+    }
+  });
+}
+
+TEST(HttpRequestBodyAs, BadRequest) {
+  run([]() -> co::Task {
+    StringReader input{
+      "POST /foo/bar HTTP/1.1\r\n"
+      "Content-Length: 7\r\n"
+      "\r\n"
+      "{\"a\": 1"
+    };
+    HttpRequest req{input};
+    co_await req.read_header();
+
+    try {
+      co_await req.body_as<ObjectTagged>();
+      ADD_FAILURE() << "Expected HttpStatusError.";
+    } catch (const HttpStatusError& err) {
+      EXPECT_EQ(err.status(), HttpResponse::BAD_REQUEST);
+    }
+  });
+}
+
+TEST(HttpRequestBodyAs, WrongShape) {
+  run([]() -> co::Task {
+    StringReader input{
+      "POST /foo/bar HTTP/1.1\r\n"
+      "Content-Length: 8\r\n"
+      "\r\n"
+      "{\"a\": 1}"
+    };
+    HttpRequest req{input};
+    co_await req.read_header();
+
+    try {
+      co_await req.body_as<ObjectTagged>();
+      ADD_FAILURE() << "Expected HttpStatusError.";
+    } catch (const HttpStatusError& err) {
+      EXPECT_EQ(err.status(), HttpResponse::BAD_REQUEST);
+    }
+  });
+}
+
 }
 }
@@ -1,11 +1,19 @@
 #include "lw/http/http_response.h"
 
+#include <algorithm>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 
+#include "lw/err/canonical.h"
+#include "lw/http/http_status_error.h"
+#include "lw/io/serializer/formatter.h"
 #include "lw/io/stream/buffer.h"
+#include "lw/memory/buffer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/mime.h"
 
 namespace lw {
 namespace {
@@ -85,6 +93,28 @@ std::string_view default_status_message(int code) {
   return _messages->at(code);
 }
 
+/**
+ * Writes the status line and headers, up to and including the blank line
+ * before the body.
+ */
+std::ostream& write_head(std::ostream& stream, const HttpResponse& res) {
+  const char end[] = "\r\n";
+  stream
+    << "HTTP/1.1 " << res.status() << " " << res.status_message() << end;
+
+  for (const auto& [key, value] : res.headers()) {
+    stream << key << ": " << value << end;
+  }
+
+  // Informational responses never have a body.
+  if (res.status() >= 200 && !res.has_header("Content-Length")) {
+    stream << "Content-Length: " << res.body().size() << end;
+  }
+
+  // Blank line before the body, nothing after.
+  return stream << end;
+}
+
 }
 
 std::string_view HttpResponse::status_message() const {
@@ -114,29 +144,48 @@ void HttpResponse::header(
   }
 }
 
-Buffer HttpResponse::serialize() const {
-  io::stream::StringBuffer stream_buffer;
-  std::ostream stream{&stream_buffer};
-  stream << *this;
-  return Buffer{stream_buffer.string().begin(), stream_buffer.string().end()};
+void HttpResponse::remove_header(std::string_view header_name) {
+  const auto& itr = _headers.find(header_name);
+  if (itr != _headers.end()) _headers.erase(itr);
 }
 
-std::ostream& operator<<(std::ostream& stream, const HttpResponse& res) {
-  const char end[] = "\r\n";
-  stream
-    << "HTTP/1.1 " << res.status() << " " << res.status_message() << end;
-
-  for (const auto& [key, value] : res.headers()) {
-    stream << key << ": " << value << end;
+std::unique_ptr<io::SerializationFormatter> HttpResponse::_negotiate_formatter(
+  BufferChain& output
+) {
+  mime::MimeMatch match = mime::negotiate_mime_serializer(_accept);
+  if (!match.serializer) {
+    throw HttpStatusError(NOT_ACCEPTABLE)
+      << "No registered serializer is acceptable to " << _accept;
   }
+  header("Content-Type", match.mime_type);
+  header("Vary", "Accept");
+  return match.serializer->make_formatter(output);
+}
 
-  if (!res.has_header("Content-Length")) {
-    stream << "Content-Length: " << res.body().size() << end;
+void HttpResponse::_set_body(const BufferChain& output) {
+  _body.clear();
+  _body.reserve(output.size());
+  for (std::size_t i = 0; i < output.block_count(); ++i) {
+    _body.append(static_cast<std::string_view>(output.block(i)));
   }
+}
 
-  // Blank line before the body, nothing after.
-  stream << end << res.body();
-  return stream;
+Buffer HttpResponse::serialize() const {
+  io::stream::StringBuffer stream_buffer;
+  std::ostream stream{&stream_buffer};
+  write_head(stream, *this);
+
+  // The body is copied straight into the result instead of through the
+  // stream.
+  const std::string& head = stream_buffer.string();
+  Buffer serialized{head.size() + _body.size()};
+  auto out = std::copy(head.begin(), head.end(), serialized.begin());
+  std::copy(_body.begin(), _body.end(), out);
+  return serialized;
+}
+
+std::ostream& operator<<(std::ostream& stream, const HttpResponse& res) {
+  return write_head(stream, res) << res.body();
 }
 
 }
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <string_view>
 #include <ostream>
 
 #include "lw/http/headers.h"
+#include "lw/io/serializer/formatter.h"
+#include "lw/io/serializer/serializer.h"
 #include "lw/memory/buffer.h"
+#include "lw/memory/buffer_chain.h"
 
 namespace lw {
 
@@ -81,8 +85,7 @@ public:
     NETWORK_AUTHENTICATION_REQUIRED = 511,
   };
 
-  // TODO: Turn this into a more advanced class capable of handling streams and
-  // serializing based on MIME type.
+  // TODO: Turn this into a more advanced class capable of handling streams.
   typedef std::string Body;
 
   int status() const { return _status_code ? _status_code : OK; }
@@ -112,18 +115,56 @@ public:
 
   void header(std::string_view header_name, std::string_view value);
 
+  /**
+   * Removes the header if it is set.
+   */
+  void remove_header(std::string_view header_name);
+
   const http::Headers& headers() const { return _headers; }
 
   void body(std::string_view b) { _body = Body{b}; }
   const Body& body() const { return _body; }
 
+  /**
+   * Sets the `Accept` header of the request being answered, which `send`
+   * negotiates the format of the body against.
+   */
+  void accept(std::string_view accept) { _accept = accept; }
+
+  /**
+   * Serializes `value` as the body, using the registered MIME serializer which
+   * the request's `Accept` header prefers, and sets `Content-Type` to match.
+   * JSON is used when the client has no preference.
+   *
+   * ```cpp
+   *  response().send(user);
+   * ```
+   *
+   * @throw HttpStatusError
+   *  With 406 Not Acceptable if the client accepts none of the registered
+   *  types.
+   */
+  template <typename T>
+  void send(const T& value) {
+    BufferChain output;
+    io::Serializer serializer{_negotiate_formatter(output)};
+    serializer.write(value);
+    _set_body(output);
+  }
+
   Buffer serialize() const;
 
 private:
+  std::unique_ptr<io::SerializationFormatter> _negotiate_formatter(
+    BufferChain& output
+  );
+  void _set_body(const BufferChain& output);
+
   int _status_code = 0;
   std::string _status_message;
   http::Headers _headers;
   Body _body;
+  std::string _accept;
 };
 
 std::ostream& operator<<(std::ostream& stream, const HttpResponse& response);
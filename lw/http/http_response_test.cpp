@@ -1,12 +1,18 @@
 #include "lw/http/http_response.h"
 
 #include <sstream>
+#include <string>
+#include <string_view>
 
 #include "gtest/gtest.h"
+#include "lw/http/http_status_error.h"
+#include "lw/io/serializer/testing/tagged_types.h"
 
 namespace lw {
 namespace {
 
+using ::lw::io::testing::ObjectTagged;
+
 TEST(HttpResponseFormat, ContentLengthGenerated) {
   HttpResponse res;
   res.status(200);
@@ -37,5 +43,44 @@ TEST(HttpResponseFormat, EmptyResponse) {
   );
 }
 
+TEST(HttpResponseFormat, SerializeMatchesStream) {
+  HttpResponse res;
+  res.status(201);
+  res.header("Content-Type", "text/plain");
+  res.body("foobar");
+
+  std::stringstream out;
+  out << res;
+  EXPECT_EQ(static_cast<std::string_view>(res.serialize()), out.str());
+}
+
+TEST(HttpResponseSend, DefaultsToJSON) {
+  HttpResponse res;
+  res.send(ObjectTagged{.a = 1, .b = 2, .c = 3});
+  EXPECT_EQ(res.header("Content-Type"), "application/json");
+  EXPECT_EQ(res.header("Vary"), "Accept");
+  EXPECT_EQ(res.body(), R"({"a":1,"b":2,"c":3})");
+}
+
+TEST(HttpResponseSend, NegotiatesAccept) {
+  HttpResponse res;
+  res.accept("text/html, application/msgpack;q=0.9, application/json;q=0.5");
+  res.send(ObjectTagged{.a = 1, .b = 2, .c = 3});
+  EXPECT_EQ(res.header("Content-Type"), "application/msgpack");
+  EXPECT_EQ(res.body(), "\x83\xa1" "a" "\x01\xa1" "b" "\x02\xa1" "c" "\x03");
+}
+
+TEST(HttpResponseSend, NotAcceptable) {
+  HttpResponse res;
+  res.accept("text/html");
+  try {
+    res.send(ObjectTagged{.a = 1, .b = 2, .c = 3});
+    ADD_FAILURE() << "Expected HttpStatusError.";
+  } catch (const HttpStatusError& err) {
+    EXPECT_EQ(err.status(), HttpResponse::NOT_ACCEPTABLE);
+  }
+  EXPECT_TRUE(res.body().empty());
+}
+
 }
 }
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <experimental/source_location>
+
+#include "lw/err/error.h"
+
+namespace lw {
+
+/**
+ * Thrown by handlers, or the helpers they call, to answer the request with an
+ * error status. The message is logged, while the response only carries the
+ * status and its reason phrase.
+ *
+ * ```cpp
+ *  throw HttpStatusError(HttpResponse::NOT_FOUND) << "No such user.";
+ * ```
+ */
+class HttpStatusError: public Error {
+public:
+  explicit HttpStatusError(
+    int status,
+    const std::experimental::source_location& loc =
+      std::experimental::source_location::current()
+  ):
+    Error("HttpStatusError", loc),
+    _status{status}
+  {}
+
+  int status() const { return _status; }
+
+private:
+  int _status;
+};
+
+}
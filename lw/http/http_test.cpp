@@ -1,16 +1,25 @@
 #include "lw/http/http.h"
 
+#include <chrono>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "lw/co/scheduler.h"
 #include "lw/http/http_handler.h"
+#include "lw/http/http_response.h"
+#include "lw/http/http_status_error.h"
+#include "lw/http/testing/http2_client.h"
 #include "lw/io/co/testing/string_stream.h"
+#include "lw/io/serializer/testing/tagged_types.h"
 
 namespace lw {
 namespace {
 
 using ::lw::io::testing::CoStringStream;
+using ::lw::io::testing::ObjectTagged;
 
 class TestHttpHandler: public HttpHandler {
 public:
@@ -21,6 +30,72 @@ public:
 };
 LW_REGISTER_HTTP_HANDLER(TestHttpHandler, "/test/:endpoint");
 
+class EchoBodyHttpHandler: public HttpHandler {
+public:
+  co::Future<void> post() override {
+    response().send(co_await request().body_as<ObjectTagged>());
+  }
+};
+LW_REGISTER_HTTP_HANDLER(EchoBodyHttpHandler, "/echo-body");
+
+class FailAfterSendHttpHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    response().header("ETag", "\"1\"");
+    response().send(ObjectTagged{.a = 1, .b = 2, .c = 3});
+    throw HttpStatusError(HttpResponse::CONFLICT) << "Changed its mind.";
+    co_return;
+  }
+};
+LW_REGISTER_HTTP_HANDLER(FailAfterSendHttpHandler, "/fail-after-send");
+
+int cached_handler_invocations = 0;
+
+class CachedHttpHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    ++cached_handler_invocations;
+    // Yield so concurrent requests can observe the in-flight invocation.
+    co_await co::next_tick();
+    if (request().route_param("endpoint") == "missing") {
+      response().status(HttpResponse::NOT_FOUND);
+    }
+    response().body(request().route_param("endpoint"));
+  }
+};
+LW_REGISTER_HTTP_HANDLER(CachedHttpHandler, "/cached/:endpoint", {
+  .ttl = std::chrono::minutes{1}
+});
+
+class CachedSendHttpHandler: public HttpHandler {
+public:
+  co::Future<void> get() override {
+    ++cached_handler_invocations;
+    response().send(ObjectTagged{.a = 1, .b = 2, .c = 3});
+    co_return;
+  }
+};
+LW_REGISTER_HTTP_HANDLER(CachedSendHttpHandler, "/cached-send", {
+  .ttl = std::chrono::minutes{1}
+});
+
+std::string run_requests(
+  HttpRouter& router,
+  const std::vector<std::string>& requests
+) {
+  std::vector<std::string> responses(requests.size());
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    co::Scheduler::this_thread().schedule(router.run(
+      std::make_unique<CoStringStream>(requests[i], responses[i])
+    ));
+  }
+  co::Scheduler::this_thread().run();
+
+  std::string joined;
+  for (const std::string& response : responses) joined += response;
+  return joined;
+}
+
 TEST(HttpRouter, ExecutesRegisteredHandlers) {
   HttpRouter router;
   router.attach_routes();
@@ -66,5 +141,264 @@ TEST(HttpRouter, RespondsNotFound) {
   );
 }
 
+TEST(HttpRouter, SerializesBodies) {
+  HttpRouter router;
+  router.attach_routes();
+
+  EXPECT_EQ(
+    run_requests(router, {
+      "POST /echo-body HTTP/1.1\r\n"
+      "Content-Type: application/json\r\n"
+      "Content-Length: 19\r\n"
+      "\r\n"
+      R"({"c":3,"b":2,"a":1})"
+    }),
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Vary: Accept\r\n"
+    "Content-Length: 19\r\n"
+    "\r\n"
+    R"({"a":1,"b":2,"c":3})"
+  );
+}
+
+TEST(HttpRouter, RespondsWithHttpStatusErrors) {
+  HttpRouter router;
+  router.attach_routes();
+
+  EXPECT_EQ(
+    run_requests(router, {
+      "POST /echo-body HTTP/1.1\r\n"
+      "Content-Type: text/html\r\n"
+      "Content-Length: 5\r\n"
+      "\r\n"
+      "<br/>"
+    }),
+    "HTTP/1.1 415 Unsupported Media Type\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 22\r\n"
+    "\r\n"
+    "Unsupported Media Type"
+  );
+}
+
+TEST(HttpRouter, RejectsUndecodableBodies) {
+  HttpRouter router;
+  router.attach_routes();
+
+  const std::string body = R"({"a":99999999999999999999,"b":2,"c":3})";
+  EXPECT_EQ(
+    run_requests(router, {
+      "POST /echo-body HTTP/1.1\r\n"
+      "Content-Type: application/json\r\n"
+      "Content-Length: " + std::to_string(body.size()) + "\r\n"
+      "\r\n" + body
+    }),
+    "HTTP/1.1 400 Bad Request\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 11\r\n"
+    "\r\n"
+    "Bad Request"
+  );
+}
+
+TEST(HttpRouter, DropsBodyHeadersOnFailure) {
+  HttpRouter router;
+  router.attach_routes();
+
+  EXPECT_EQ(
+    run_requests(router, {"GET /fail-after-send HTTP/1.1\r\n\r\n"}),
+    "HTTP/1.1 409 Conflict\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 8\r\n"
+    "\r\n"
+    "Conflict"
+  );
+}
+
+TEST(HttpRouter, AnswersPipelinedRequests) {
+  HttpRouter router;
+  router.attach_routes();
+
+  std::string response;
+  auto conn = std::make_unique<CoStringStream>(
+    "GET /test/foo HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: keep-alive\r\n\r\n"
+    "GET /test/bar HTTP/1.1\r\n"
+    "Host: localhost\r\n\r\n",
+    response
+  );
+  co::Scheduler::this_thread().schedule(router.run(std::move(conn)));
+  co::Scheduler::this_thread().run();
+
+  EXPECT_EQ(
+    response,
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 3\r\n"
+    "\r\n"
+    "foo"
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Length: 3\r\n"
+    "\r\n"
+    "bar"
+  );
+}
+
+constexpr std::string_view CACHED_FOOBAR =
+  "HTTP/1.1 200 OK\r\n"
+  "ETag: \"85944171f73967e8\"\r\n"
+  "Content-Length: 6\r\n"
+  "\r\n"
+  "foobar";
+
+TEST(HttpRouterCache, ServesRepeatRequestsFromCache) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  const std::string request =
+    "GET /cached/foobar HTTP/1.1\r\n"
+    "Host: localhost\r\n\r\n";
+  EXPECT_EQ(run_requests(router, {request}), CACHED_FOOBAR);
+  EXPECT_EQ(run_requests(router, {request}), CACHED_FOOBAR);
+
+  EXPECT_EQ(cached_handler_invocations, 1);
+  EXPECT_EQ(router.cache_stats().hits, 1);
+  EXPECT_EQ(router.cache_stats().misses, 1);
+}
+
+TEST(HttpRouterCache, RespondsNotModifiedForMatchingETag) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  EXPECT_EQ(
+    run_requests(router, {
+      "GET /cached/foobar HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "If-None-Match: \"85944171f73967e8\"\r\n\r\n"
+    }),
+    "HTTP/1.1 304 Not Modified\r\n"
+    "Content-Length: 6\r\n"
+    "ETag: \"85944171f73967e8\"\r\n"
+    "\r\n"
+  );
+  EXPECT_EQ(
+    run_requests(router, {
+      "GET /cached/foobar HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "If-None-Match: \"stale\"\r\n\r\n"
+    }),
+    CACHED_FOOBAR
+  );
+  EXPECT_EQ(cached_handler_invocations, 1);
+}
+
+TEST(HttpRouterCache, CoalescesConcurrentMisses) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  const std::string request =
+    "GET /cached/foobar HTTP/1.1\r\n"
+    "Host: localhost\r\n\r\n";
+  EXPECT_EQ(
+    run_requests(router, {request, request, request}),
+    std::string{CACHED_FOOBAR} + std::string{CACHED_FOOBAR} +
+      std::string{CACHED_FOOBAR}
+  );
+  EXPECT_EQ(cached_handler_invocations, 1);
+}
+
+TEST(HttpRouterCache, KeysOnQueryParams) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  run_requests(router, {
+    "GET /cached/foobar?a=1&b=2 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+  });
+  run_requests(router, {
+    "GET /cached/foobar?b=2&a=1 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+  });
+  EXPECT_EQ(cached_handler_invocations, 1);
+
+  run_requests(router, {
+    "GET /cached/foobar?a=2 HTTP/1.1\r\nHost: localhost\r\n\r\n"
+  });
+  EXPECT_EQ(cached_handler_invocations, 2);
+}
+
+TEST(HttpRouterCache, KeysOnAccept) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  const std::string json_request =
+    "GET /cached-send HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Accept: application/json\r\n\r\n";
+  const std::string cbor_request =
+    "GET /cached-send HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Accept: application/cbor\r\n\r\n";
+  const std::string json_response = run_requests(router, {json_request});
+  const std::string cbor_response = run_requests(router, {cbor_request});
+  EXPECT_NE(
+    json_response.find("Content-Type: application/json\r\n"),
+    std::string::npos
+  );
+  EXPECT_NE(
+    cbor_response.find("Content-Type: application/cbor\r\n"),
+    std::string::npos
+  );
+  EXPECT_EQ(cached_handler_invocations, 2);
+
+  EXPECT_EQ(run_requests(router, {json_request}), json_response);
+  EXPECT_EQ(run_requests(router, {cbor_request}), cbor_response);
+  EXPECT_EQ(cached_handler_invocations, 2);
+  EXPECT_EQ(router.cache_stats().hits, 2);
+}
+
+TEST(HttpRouterCache, DoesNotCacheErrors) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  const std::string request =
+    "GET /cached/missing HTTP/1.1\r\n"
+    "Host: localhost\r\n\r\n";
+  run_requests(router, {request, request});
+  run_requests(router, {request});
+  EXPECT_EQ(cached_handler_invocations, 3);
+}
+
+TEST(HttpRouterHttp2, ServesPriorKnowledgeClients) {
+  HttpRouter router;
+  router.attach_routes();
+  cached_handler_invocations = 0;
+
+  http::testing::Http2TestClient client;
+  std::string requests = client.preface();
+  requests += client.request(1, "GET", "/test/foobar");
+  requests += client.request(3, "GET", "/gibberish");
+  requests += client.request(5, "GET", "/cached/foobar");
+  requests += client.request(7, "GET", "/cached/foobar");
+  client.receive(run_requests(router, {requests}));
+
+  EXPECT_EQ(client.response(1).header(":status"), "200");
+  EXPECT_EQ(client.response(1).body, "foobar");
+  EXPECT_EQ(client.response(3).header(":status"), "404");
+  EXPECT_EQ(client.response(3).body, "Not Found.");
+
+  // Cached responses are shared with HTTP/1 and carry the same headers.
+  EXPECT_EQ(client.response(5).body, "foobar");
+  EXPECT_EQ(client.response(7).body, "foobar");
+  EXPECT_EQ(client.response(7).header("content-length"), "6");
+  EXPECT_FALSE(client.response(7).header("etag").empty());
+  EXPECT_EQ(cached_handler_invocations, 1);
+}
+
 }
 }
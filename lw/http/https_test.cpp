@@ -1,6 +1,7 @@
 #include "lw/http/https.h"
 
 #include <memory>
+#include <string>
 #include <string_view>
 #include <tuple>
 
@@ -9,6 +10,7 @@
 #include "lw/co/scheduler.h"
 #include "lw/co/task.h"
 #include "lw/http/http_handler.h"
+#include "lw/http/testing/http2_client.h"
 #include "lw/io/co/testing/string_connection.h"
 #include "lw/net/testing/tls_credentials.h"
 #include "lw/net/tls.h"
@@ -33,12 +35,19 @@ protected:
   HttpsRouterTest():
     _router{{
       .private_key = net::testing::KEY_PATH,
-      .certificate = net::testing::CERT_PATH
+      .certificate = net::testing::CERT_PATH,
+      .alpn_protocols = {"h2", "http/1.1"}
     }},
     _factory{{
       .private_key = net::testing::KEY_PATH,
       .certificate = net::testing::CERT_PATH,
       .connection_mode = net::TLSOptions::CONNECT
+    }},
+    _http2_factory{{
+      .private_key = net::testing::KEY_PATH,
+      .certificate = net::testing::CERT_PATH,
+      .connection_mode = net::TLSOptions::CONNECT,
+      .alpn_protocols = {"h2"}
     }}
   {
     _router.attach_routes();
@@ -48,14 +57,14 @@ protected:
     std::unique_ptr<net::TLSStream>,
     std::unique_ptr<CoStringConnection>
   >
-  make_connection() {
+  make_connection(net::TLSStreamFactory* factory = nullptr) {
     std::pair<
       std::unique_ptr<net::TLSStream>,
       std::unique_ptr<CoStringConnection>
     > ret;
     std::unique_ptr<CoStringConnection> client;
     std::tie(client, ret.second) = CoStringConnection::make_connection();
-    ret.first = _factory.wrap_stream(std::move(client));
+    ret.first = (factory ? *factory : _factory).wrap_stream(std::move(client));
     return ret;
   }
 
@@ -73,15 +82,18 @@ protected:
     buff.copy(message.begin(), message.end());
     co_await conn.write({buff.data(), message.size(), /*own_data=*/false});
 
-    std::size_t read_bytes = co_await conn.read(buff);
-    std::string response;
-    response.reserve(read_bytes);
-    response.replace(0, read_bytes, buff);
-    co_return response;
+    // String connections do not wait for data, so keep reading until the
+    // response arrives.
+    std::size_t read_bytes = 0;
+    while (read_bytes == 0) read_bytes = co_await conn.read(buff);
+    co_return std::string{
+      static_cast<std::string_view>(buff).substr(0, read_bytes)
+    };
   }
 
   HttpsRouter _router;
   net::TLSStreamFactory _factory;
+  net::TLSStreamFactory _http2_factory;
 };
 
 TEST_F(HttpsRouterTest, ExecutesRegisteredHandlers) {
@@ -131,5 +143,38 @@ TEST_F(HttpsRouterTest, RespondsNotFound) {
   scheduler().run();
 }
 
+TEST_F(HttpsRouterTest, SpeaksHttp2AfterAlpn) {
+  auto [client, server] = make_connection(&_http2_factory);
+  http::testing::Http2TestClient http2;
+
+  scheduler().schedule(_router.run(std::move(server)));
+  auto request = [&]() -> co::Task {
+    co_await client->handshake();
+    EXPECT_EQ(client->alpn_protocol(), "h2");
+
+    std::string message = http2.preface();
+    message += http2.request(1, "GET", "/test/foobar");
+    Buffer buff{message.begin(), message.end()};
+    co_await client->write(buff);
+
+    std::string received;
+    Buffer read_buff{1024};
+    while (!http2.responses().contains(1) || !http2.response(1).complete) {
+      const std::size_t read_bytes = co_await client->read(read_buff);
+      received += static_cast<std::string_view>(read_buff).substr(
+        0,
+        read_bytes
+      );
+      received.erase(0, http2.receive(received));
+    }
+    client->close();
+  };
+  scheduler().schedule(request);
+  scheduler().run();
+
+  EXPECT_EQ(http2.response(1).header(":status"), "200");
+  EXPECT_EQ(http2.response(1).body, "foobar");
+}
+
 }
 }
@@ -0,0 +1,535 @@
+#include "lw/http/internal/hpack.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/err/canonical.h"
+
+namespace lw::http::internal {
+namespace {
+
+// Every entry in the dynamic table is counted with this much overhead.
+constexpr std::size_t ENTRY_OVERHEAD = 32;
+
+// The symbol marking the end of a Huffman coded string, which must never
+// appear in one.
+constexpr std::uint16_t EOS = 256;
+
+struct HuffmanCode {
+  std::uint32_t code;
+  std::uint8_t bits;
+};
+
+// RFC 7541 Appendix B, indexed by symbol.
+constexpr HuffmanCode HUFFMAN_CODES[257] = {
+  {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+  {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+  {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+  {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+  {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+  {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+  {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+  {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+  {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12},
+  {0x1ff9, 13}, {0x15, 6}, {0xf8, 8}, {0x7fa, 11},
+  {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+  {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6},
+  {0x0, 5}, {0x1, 5}, {0x2, 5}, {0x19, 6},
+  {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6},
+  {0x1e, 6}, {0x1f, 6}, {0x5c, 7}, {0xfb, 8},
+  {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+  {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7},
+  {0x5f, 7}, {0x60, 7}, {0x61, 7}, {0x62, 7},
+  {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7},
+  {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7},
+  {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+  {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7},
+  {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13},
+  {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+  {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5},
+  {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6},
+  {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7},
+  {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5},
+  {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5},
+  {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+  {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15},
+  {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+  {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20},
+  {0x3fffd3, 22}, {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23},
+  {0x3fffd6, 22}, {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23},
+  {0x7fffdd, 23}, {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23},
+  {0xffffec, 24}, {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23},
+  {0xffffee, 24}, {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23},
+  {0x7fffe4, 23}, {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23},
+  {0x3fffd9, 22}, {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24},
+  {0x3fffda, 22}, {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22},
+  {0x3fffdc, 22}, {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21},
+  {0x7fffea, 23}, {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24},
+  {0x1fffdf, 21}, {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23},
+  {0x1fffe0, 21}, {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21},
+  {0x7fffed, 23}, {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23},
+  {0xfffea, 20}, {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22},
+  {0x7ffff0, 23}, {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23},
+  {0x3ffffe0, 26}, {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19},
+  {0x3fffe7, 22}, {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25},
+  {0x3ffffe2, 26}, {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27},
+  {0x7ffffdf, 27}, {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25},
+  {0x7fff2, 19}, {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27},
+  {0x7ffffe1, 27}, {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24},
+  {0x1fffe4, 21}, {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26},
+  {0xffffffd, 28}, {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27},
+  {0xfffec, 20}, {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21},
+  {0x3fffe9, 22}, {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23},
+  {0x3fffea, 22}, {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25},
+  {0xfffff4, 24}, {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23},
+  {0x3ffffeb, 26}, {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26},
+  {0x7ffffe7, 27}, {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27},
+  {0x7ffffeb, 27}, {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27},
+  {0x7ffffee, 27}, {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26},
+  {0x3fffffff, 30},
+};
+
+const HpackHeader STATIC_TABLE[HpackTable::STATIC_ENTRIES] = {
+  {":authority", ""},
+  {":method", "GET"},
+  {":method", "POST"},
+  {":path", "/"},
+  {":path", "/index.html"},
+  {":scheme", "http"},
+  {":scheme", "https"},
+  {":status", "200"},
+  {":status", "204"},
+  {":status", "206"},
+  {":status", "304"},
+  {":status", "400"},
+  {":status", "404"},
+  {":status", "500"},
+  {"accept-charset", ""},
+  {"accept-encoding", "gzip, deflate"},
+  {"accept-language", ""},
+  {"accept-ranges", ""},
+  {"accept", ""},
+  {"access-control-allow-origin", ""},
+  {"age", ""},
+  {"allow", ""},
+  {"authorization", ""},
+  {"cache-control", ""},
+  {"content-disposition", ""},
+  {"content-encoding", ""},
+  {"content-language", ""},
+  {"content-length", ""},
+  {"content-location", ""},
+  {"content-range", ""},
+  {"content-type", ""},
+  {"cookie", ""},
+  {"date", ""},
+  {"etag", ""},
+  {"expect", ""},
+  {"expires", ""},
+  {"from", ""},
+  {"host", ""},
+  {"if-match", ""},
+  {"if-modified-since", ""},
+  {"if-none-match", ""},
+  {"if-range", ""},
+  {"if-unmodified-since", ""},
+  {"last-modified", ""},
+  {"link", ""},
+  {"location", ""},
+  {"max-forwards", ""},
+  {"proxy-authenticate", ""},
+  {"proxy-authorization", ""},
+  {"range", ""},
+  {"referer", ""},
+  {"refresh", ""},
+  {"retry-after", ""},
+  {"server", ""},
+  {"set-cookie", ""},
+  {"strict-transport-security", ""},
+  {"transfer-encoding", ""},
+  {"user-agent", ""},
+  {"vary", ""},
+  {"via", ""},
+  {"www-authenticate", ""},
+};
+
+/**
+ * A binary tree over the Huffman codes, walked one bit at a time to decode.
+ * Leaves hold the symbol for the code leading to them.
+ */
+class HuffmanTree {
+public:
+  HuffmanTree() {
+    _nodes.push_back({});
+    for (std::uint16_t symbol = 0; symbol <= EOS; ++symbol) {
+      const HuffmanCode& code = HUFFMAN_CODES[symbol];
+      std::size_t node = 0;
+      for (int bit = code.bits - 1; bit >= 0; --bit) {
+        const int branch = (code.code >> bit) & 1;
+        if (!_nodes[node].children[branch]) {
+          _nodes[node].children[branch] =
+            static_cast<std::uint16_t>(_nodes.size());
+          _nodes.push_back({});
+        }
+        node = _nodes[node].children[branch];
+      }
+      _nodes[node].symbol = symbol;
+      _nodes[node].leaf = true;
+    }
+  }
+
+  std::string decode(std::string_view encoded) const {
+    std::string decoded;
+    decoded.reserve(encoded.size() * 8 / 5);
+    std::size_t node = 0;
+    // Bits read since the last complete symbol, and whether all were ones.
+    int pending_bits = 0;
+    bool all_ones = true;
+    for (const char c : encoded) {
+      const auto byte = static_cast<std::uint8_t>(c);
+      for (int bit = 7; bit >= 0; --bit) {
+        const int branch = (byte >> bit) & 1;
+        node = _nodes[node].children[branch];
+        ++pending_bits;
+        all_ones = all_ones && branch;
+        if (!_nodes[node].leaf) continue;
+        if (_nodes[node].symbol == EOS) {
+          throw InvalidArgument() << "Huffman coded string contains EOS.";
+        }
+        decoded.push_back(static_cast<char>(_nodes[node].symbol));
+        node = 0;
+        pending_bits = 0;
+        all_ones = true;
+      }
+    }
+
+    // Padding is a prefix of EOS, which is all ones, shorter than a byte.
+    if (pending_bits > 7 || !all_ones) {
+      throw InvalidArgument() << "Invalid padding on Huffman coded string.";
+    }
+    return decoded;
+  }
+
+private:
+  struct Node {
+    std::array<std::uint16_t, 2> children = {0, 0};
+    std::uint16_t symbol = 0;
+    bool leaf = false;
+  };
+
+  std::vector<Node> _nodes;
+};
+
+const HuffmanTree& huffman_tree() {
+  static const HuffmanTree* tree = new HuffmanTree{};
+  return *tree;
+}
+
+std::size_t entry_size(const HpackHeader& header) {
+  return header.name.size() + header.value.size() + ENTRY_OVERHEAD;
+}
+
+/**
+ * Appends `value` using the HPACK integer representation with an
+ * `prefix_bits` bit prefix. The bits of `first_byte` above the prefix are kept.
+ */
+void encode_integer(
+  std::uint64_t value,
+  int prefix_bits,
+  std::uint8_t first_byte,
+  std::string& out
+) {
+  const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+  if (value < max_prefix) {
+    out.push_back(static_cast<char>(first_byte | value));
+    return;
+  }
+  out.push_back(static_cast<char>(first_byte | max_prefix));
+  value -= max_prefix;
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void encode_string(std::string_view str, std::string& out) {
+  const std::size_t huffman_size = huffman_encoded_size(str);
+  if (huffman_size < str.size()) {
+    encode_integer(huffman_size, 7, 0x80, out);
+    huffman_encode(str, out);
+  } else {
+    encode_integer(str.size(), 7, 0x00, out);
+    out.append(str);
+  }
+}
+
+/**
+ * Reads HPACK primitives from a header block.
+ */
+class BlockReader {
+public:
+  explicit BlockReader(std::string_view block): _block{block} {}
+
+  bool done() const { return _pos >= _block.size(); }
+  std::uint8_t peek() const { return static_cast<std::uint8_t>(_block[_pos]); }
+
+  std::uint64_t integer(int prefix_bits) {
+    const std::uint64_t max_prefix = (1u << prefix_bits) - 1;
+    std::uint64_t value = _next() & max_prefix;
+    if (value < max_prefix) return value;
+
+    // Anything beyond 32 bits is far larger than any table or string.
+    for (int shift = 0; shift <= 28; shift += 7) {
+      const std::uint8_t byte = _next();
+      value += static_cast<std::uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    throw InvalidArgument() << "HPACK integer overflow.";
+  }
+
+  std::string string() {
+    if (done()) throw InvalidArgument() << "Truncated HPACK string.";
+    const bool huffman = peek() & 0x80;
+    const std::uint64_t length = integer(7);
+    if (length > _block.size() - _pos) {
+      throw InvalidArgument() << "HPACK string longer than header block.";
+    }
+    std::string_view raw = _block.substr(_pos, length);
+    _pos += length;
+    return huffman ? huffman_tree().decode(raw) : std::string{raw};
+  }
+
+private:
+  std::uint8_t _next() {
+    if (done()) throw InvalidArgument() << "Truncated HPACK header block.";
+    return static_cast<std::uint8_t>(_block[_pos++]);
+  }
+
+  std::string_view _block;
+  std::size_t _pos = 0;
+};
+
+/**
+ * How a header is represented in blocks from `HpackEncoder`.
+ */
+enum class Indexing {
+  INCREMENTAL,
+  WITHOUT,
+  NEVER
+};
+
+Indexing indexing_for(std::string_view name) {
+  // Values which change with nearly every message would only push reusable
+  // entries out of the table.
+  if (
+    name == ":path" ||
+    name == "content-length" ||
+    name == "date" ||
+    name == "etag" ||
+    name == "last-modified"
+  ) {
+    return Indexing::WITHOUT;
+  }
+  if (
+    name == "authorization" ||
+    name == "cookie" ||
+    name == "proxy-authorization" ||
+    name == "set-cookie"
+  ) {
+    return Indexing::NEVER;
+  }
+  return Indexing::INCREMENTAL;
+}
+
+}
+
+std::size_t huffman_encoded_size(std::string_view str) {
+  std::size_t bits = 0;
+  for (const char c : str) {
+    bits += HUFFMAN_CODES[static_cast<std::uint8_t>(c)].bits;
+  }
+  return (bits + 7) / 8;
+}
+
+void huffman_encode(std::string_view str, std::string& out) {
+  std::uint64_t pending = 0;
+  int pending_bits = 0;
+  for (const char c : str) {
+    const HuffmanCode& code = HUFFMAN_CODES[static_cast<std::uint8_t>(c)];
+    pending = (pending << code.bits) | code.code;
+    pending_bits += code.bits;
+    while (pending_bits >= 8) {
+      pending_bits -= 8;
+      out.push_back(static_cast<char>(pending >> pending_bits));
+    }
+  }
+  if (pending_bits > 0) {
+    // Pad with the most significant bits of EOS, which are all ones.
+    const int padding = 8 - pending_bits;
+    out.push_back(
+      static_cast<char>((pending << padding) | ((1u << padding) - 1))
+    );
+  }
+}
+
+std::string huffman_decode(std::string_view encoded) {
+  return huffman_tree().decode(encoded);
+}
+
+const HpackHeader& HpackTable::at(std::size_t index) const {
+  if (index == 0 || index > STATIC_ENTRIES + _entries.size()) {
+    throw InvalidArgument() << "HPACK index " << index << " out of range.";
+  }
+  if (index <= STATIC_ENTRIES) return STATIC_TABLE[index - 1];
+  return _entries[index - STATIC_ENTRIES - 1];
+}
+
+std::pair<std::size_t, bool> HpackTable::find(
+  std::string_view name,
+  std::string_view value
+) const {
+  std::size_t name_match = 0;
+  for (std::size_t i = 0; i < STATIC_ENTRIES; ++i) {
+    if (STATIC_TABLE[i].name != name) continue;
+    if (STATIC_TABLE[i].value == value) return {i + 1, true};
+    if (!name_match) name_match = i + 1;
+  }
+  for (std::size_t i = 0; i < _entries.size(); ++i) {
+    if (_entries[i].name != name) continue;
+    if (_entries[i].value == value) return {STATIC_ENTRIES + i + 1, true};
+    if (!name_match) name_match = STATIC_ENTRIES + i + 1;
+  }
+  return {name_match, false};
+}
+
+void HpackTable::insert(HpackHeader header) {
+  const std::size_t size = entry_size(header);
+  if (size > _max_size) {
+    // An entry larger than the whole table just empties it.
+    _evict(0);
+    return;
+  }
+  _evict(_max_size - size);
+  _entries.push_front(std::move(header));
+  _size += size;
+}
+
+void HpackTable::max_size(std::size_t size) {
+  _max_size = size;
+  _evict(size);
+}
+
+void HpackTable::_evict(std::size_t limit) {
+  while (_size > limit) {
+    _size -= entry_size(_entries.back());
+    _entries.pop_back();
+  }
+}
+
+HpackHeaders HpackDecoder::decode(std::string_view block) {
+  HpackHeaders headers;
+  BlockReader reader{block};
+  bool headers_started = false;
+  std::size_t list_size = 0;
+  while (!reader.done()) {
+    const std::uint8_t first = reader.peek();
+    if (first & 0x80) {
+      // Indexed header field.
+      const HpackHeader& header = _table.at(reader.integer(7));
+      _add_to_list_size(header, list_size);
+      headers.push_back(header);
+    } else if ((first & 0xe0) == 0x20) {
+      // Dynamic table size update, only allowed before any header.
+      if (headers_started) {
+        throw InvalidArgument()
+          << "HPACK table size update after the first header.";
+      }
+      const std::uint64_t size = reader.integer(5);
+      if (size > _max_table_size) {
+        throw InvalidArgument()
+          << "HPACK table size " << size << " exceeds the limit of "
+          << _max_table_size;
+      }
+      _table.max_size(size);
+      continue;
+    } else {
+      // Literal header field, either indexed afterwards (01xxxxxx), not
+      // indexed (0000xxxx) or never indexed (0001xxxx).
+      const bool index = first & 0x40;
+      const std::uint64_t name_index = reader.integer(index ? 6 : 4);
+      HpackHeader header;
+      header.name =
+        name_index ? _table.at(name_index).name : reader.string();
+      header.value = reader.string();
+      _add_to_list_size(header, list_size);
+      if (index) _table.insert(header);
+      headers.push_back(std::move(header));
+    }
+    headers_started = true;
+  }
+  return headers;
+}
+
+void HpackDecoder::_add_to_list_size(
+  const HpackHeader& header,
+  std::size_t& list_size
+) {
+  list_size += entry_size(header);
+  if (list_size > _max_header_list_size) {
+    throw InvalidArgument()
+      << "HPACK header list exceeds the limit of " << _max_header_list_size
+      << " bytes.";
+  }
+}
+
+void HpackEncoder::encode(const HpackHeaders& headers, std::string& out) {
+  if (_pending_size_update) {
+    encode_integer(*_pending_size_update, 5, 0x20, out);
+    _pending_size_update.reset();
+  }
+  for (const HpackHeader& header : headers) _encode_header(header, out);
+}
+
+void HpackEncoder::max_table_size(std::size_t size) {
+  // Never grow past the default, which bounds the memory used per connection.
+  size = std::min(size, HpackTable::DEFAULT_SIZE);
+  if (size == _table.max_size()) return;
+  _table.max_size(size);
+  _pending_size_update = size;
+}
+
+void HpackEncoder::_encode_header(
+  const HpackHeader& header,
+  std::string& out
+) {
+  const Indexing indexing = indexing_for(header.name);
+  auto [index, exact] = _table.find(header.name, header.value);
+  if (exact && indexing != Indexing::NEVER) {
+    encode_integer(index, 7, 0x80, out);
+    return;
+  }
+
+  switch (indexing) {
+    case Indexing::INCREMENTAL:
+      encode_integer(index, 6, 0x40, out);
+      break;
+    case Indexing::WITHOUT:
+      encode_integer(index, 4, 0x00, out);
+      break;
+    case Indexing::NEVER:
+      encode_integer(index, 4, 0x10, out);
+      break;
+  }
+  if (!index) encode_string(header.name, out);
+  encode_string(header.value, out);
+  if (indexing == Indexing::INCREMENTAL) _table.insert(header);
+}
+
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace lw::http::internal {
+
+/**
+ * A header field as carried by HTTP/2, with names in lowercase and pseudo
+ * headers such as `:path` listed first.
+ */
+struct HpackHeader {
+  std::string name;
+  std::string value;
+
+  bool operator==(const HpackHeader& other) const = default;
+};
+
+typedef std::vector<HpackHeader> HpackHeaders;
+
+/**
+ * The number of bytes `str` takes once Huffman coded, excluding padding.
+ */
+std::size_t huffman_encoded_size(std::string_view str);
+
+/**
+ * Appends the Huffman code for `str` to `out`, padded to a whole byte.
+ */
+void huffman_encode(std::string_view str, std::string& out);
+
+/**
+ * Decodes a Huffman coded string.
+ *
+ * @throw InvalidArgument
+ *  If `encoded` contains the end of string symbol or is not correctly padded.
+ */
+std::string huffman_decode(std::string_view encoded);
+
+/**
+ * The header table shared by an HPACK encoder and decoder pair, made up of the
+ * fixed static table followed by a dynamic table of recently sent headers.
+ * Indices start at 1.
+ */
+class HpackTable {
+public:
+  static constexpr std::size_t DEFAULT_SIZE = 4096;
+  static constexpr std::size_t STATIC_ENTRIES = 61;
+
+  explicit HpackTable(std::size_t max_size = DEFAULT_SIZE):
+    _max_size{max_size}
+  {}
+
+  /**
+   * @throw InvalidArgument
+   *  If there is no entry at `index`.
+   */
+  const HpackHeader& at(std::size_t index) const;
+
+  /**
+   * Searches for `name` and `value`.
+   *
+   * @return
+   *  The index of a matching entry and true, or the index of an entry with the
+   *  same name and false. Index 0 means the name is not in the table at all.
+   */
+  std::pair<std::size_t, bool> find(
+    std::string_view name,
+    std::string_view value
+  ) const;
+
+  /**
+   * Adds a header to the dynamic table, evicting the oldest entries to make
+   * room for it.
+   */
+  void insert(HpackHeader header);
+
+  /**
+   * Changes the size limit of the dynamic table, evicting entries which no
+   * longer fit.
+   */
+  void max_size(std::size_t size);
+  std::size_t max_size() const { return _max_size; }
+
+  /**
+   * The size of the dynamic table as counted by HPACK, which includes 32 bytes
+   * of overhead per entry.
+   */
+  std::size_t size() const { return _size; }
+
+  std::size_t dynamic_entries() const { return _entries.size(); }
+
+private:
+  void _evict(std::size_t limit);
+
+  // Newest entries first, matching their index order.
+  std::deque<HpackHeader> _entries;
+  std::size_t _size = 0;
+  std::size_t _max_size;
+};
+
+/**
+ * Decodes HPACK header blocks (RFC 7541) received on one connection.
+ */
+class HpackDecoder {
+public:
+  static constexpr std::size_t DEFAULT_MAX_HEADER_LIST_SIZE = 64 * 1024;
+
+  /**
+   * @param max_table_size
+   *  The dynamic table size advertised to the peer. The peer's encoder may use
+   *  any size up to this.
+   * @param max_header_list_size
+   *  The largest decoded header list accepted, counted as HPACK does with 32
+   *  bytes of overhead per field. Small blocks referring to large table
+   *  entries can decode to far more than their own size.
+   */
+  explicit HpackDecoder(
+    std::size_t max_table_size = HpackTable::DEFAULT_SIZE,
+    std::size_t max_header_list_size = DEFAULT_MAX_HEADER_LIST_SIZE
+  ):
+    _table{max_table_size},
+    _max_table_size{max_table_size},
+    _max_header_list_size{max_header_list_size}
+  {}
+
+  /**
+   * Decodes one complete header block.
+   *
+   * @throw InvalidArgument
+   *  If the block is malformed or decodes to more than the header list size
+   *  limit, after which the decoder must not be used again.
+   */
+  HpackHeaders decode(std::string_view block);
+
+  const HpackTable& table() const { return _table; }
+  std::size_t max_header_list_size() const { return _max_header_list_size; }
+
+private:
+  void _add_to_list_size(const HpackHeader& header, std::size_t& list_size);
+
+  HpackTable _table;
+  std::size_t _max_table_size;
+  std::size_t _max_header_list_size;
+};
+
+/**
+ * Encodes HPACK header blocks to send on one connection.
+ */
+class HpackEncoder {
+public:
+  /**
+   * Appends the header block for `headers` to `out`.
+   *
+   * Headers likely to repeat are added to the dynamic table so later blocks
+   * can refer to them by index. Credentials and cookies are marked as never to
+   * be indexed, by this or any intermediary.
+   */
+  void encode(const HpackHeaders& headers, std::string& out);
+
+  /**
+   * Limits the dynamic table to the size the peer advertised in its settings.
+   * The change is announced at the start of the next block.
+   */
+  void max_table_size(std::size_t size);
+
+  const HpackTable& table() const { return _table; }
+
+private:
+  void _encode_header(const HpackHeader& header, std::string& out);
+
+  HpackTable _table;
+  std::optional<std::size_t> _pending_size_update;
+};
+
+}
@@ -0,0 +1,194 @@
+#include "lw/http/internal/hpack.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+
+namespace lw::http::internal {
+namespace {
+
+std::string from_hex(std::string_view hex) {
+  std::string bytes;
+  for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+    bytes.push_back(
+      static_cast<char>(std::stoi(std::string{hex.substr(i, 2)}, nullptr, 16))
+    );
+  }
+  return bytes;
+}
+
+TEST(Huffman, EncodesAndDecodes) {
+  // RFC 7541 Appendix C.4.1.
+  const std::string encoded = from_hex("f1e3c2e5f23a6ba0ab90f4ff");
+  std::string out;
+  huffman_encode("www.example.com", out);
+  EXPECT_EQ(out, encoded);
+  EXPECT_EQ(huffman_encoded_size("www.example.com"), encoded.size());
+  EXPECT_EQ(huffman_decode(encoded), "www.example.com");
+}
+
+TEST(Huffman, RoundTripsEveryByte) {
+  std::string all;
+  for (int c = 0; c < 256; ++c) all.push_back(static_cast<char>(c));
+  std::string encoded;
+  huffman_encode(all, encoded);
+  EXPECT_EQ(huffman_decode(encoded), all);
+}
+
+TEST(Huffman, RejectsBadPadding) {
+  // "a" is 00011, so padding with zeros is invalid.
+  EXPECT_THROW(huffman_decode(from_hex("18")), InvalidArgument);
+  // A whole byte of padding is too long.
+  EXPECT_THROW(huffman_decode(from_hex("1fff")), InvalidArgument);
+}
+
+TEST(HpackDecoder, DecodesRequestSequence) {
+  // RFC 7541 Appendix C.4, requests with Huffman coding.
+  HpackDecoder decoder;
+  EXPECT_EQ(
+    decoder.decode(from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff")),
+    (HpackHeaders{
+      {":method", "GET"},
+      {":scheme", "http"},
+      {":path", "/"},
+      {":authority", "www.example.com"}
+    })
+  );
+  EXPECT_EQ(decoder.table().size(), 57u);
+
+  EXPECT_EQ(
+    decoder.decode(from_hex("828684be5886a8eb10649cbf")),
+    (HpackHeaders{
+      {":method", "GET"},
+      {":scheme", "http"},
+      {":path", "/"},
+      {":authority", "www.example.com"},
+      {"cache-control", "no-cache"}
+    })
+  );
+  EXPECT_EQ(decoder.table().size(), 110u);
+
+  EXPECT_EQ(
+    decoder.decode(
+      from_hex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf")
+    ),
+    (HpackHeaders{
+      {":method", "GET"},
+      {":scheme", "https"},
+      {":path", "/index.html"},
+      {":authority", "www.example.com"},
+      {"custom-key", "custom-value"}
+    })
+  );
+  EXPECT_EQ(decoder.table().size(), 164u);
+  EXPECT_EQ(
+    decoder.table().at(62),
+    (HpackHeader{"custom-key", "custom-value"})
+  );
+}
+
+TEST(HpackDecoder, RejectsMalformedBlocks) {
+  HpackDecoder decoder;
+  // Index 0 and indices past the end of the table.
+  EXPECT_THROW(decoder.decode(from_hex("80")), InvalidArgument);
+  EXPECT_THROW(decoder.decode(from_hex("be")), InvalidArgument);
+  // A string running past the end of the block.
+  EXPECT_THROW(decoder.decode(from_hex("400a61")), InvalidArgument);
+  // An integer which never ends.
+  EXPECT_THROW(decoder.decode(from_hex("ffffffffffff")), InvalidArgument);
+}
+
+TEST(HpackDecoder, LimitsTableSizeUpdates) {
+  HpackDecoder decoder{100};
+  EXPECT_NO_THROW(decoder.decode(from_hex("3f45")));
+  EXPECT_EQ(decoder.table().max_size(), 100u);
+  EXPECT_THROW(decoder.decode(from_hex("3f46")), InvalidArgument);
+  // Size updates must come before any header.
+  EXPECT_THROW(decoder.decode(from_hex("8220")), InvalidArgument);
+}
+
+TEST(HpackDecoder, LimitsHeaderListSize) {
+  HpackDecoder decoder{HpackTable::DEFAULT_SIZE, /*max_header_list_size=*/200};
+  // Adds a 100 byte value to the dynamic table, then refers to it by index.
+  EXPECT_EQ(
+    decoder.decode(from_hex("40016164") + std::string(100, 'x')).size(),
+    1u
+  );
+  EXPECT_EQ(decoder.decode(from_hex("be")).size(), 1u);
+  EXPECT_THROW(decoder.decode(from_hex("bebe")), InvalidArgument);
+}
+
+TEST(HpackEncoder, RoundTripsThroughDecoder) {
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+  const HpackHeaders headers{
+    {":status", "200"},
+    {"content-type", "text/plain"},
+    {"content-length", "6"},
+    {"x-custom", "some value"}
+  };
+
+  std::string first;
+  encoder.encode(headers, first);
+  EXPECT_EQ(decoder.decode(first), headers);
+
+  // Repeated headers are sent as indices the second time.
+  std::string second;
+  encoder.encode(headers, second);
+  EXPECT_LT(second.size(), first.size());
+  EXPECT_EQ(decoder.decode(second), headers);
+  EXPECT_EQ(encoder.table().size(), decoder.table().size());
+}
+
+TEST(HpackEncoder, NeverIndexesCredentials) {
+  HpackEncoder encoder;
+  std::string block;
+  encoder.encode({{"set-cookie", "session=secret"}}, block);
+  EXPECT_EQ(encoder.table().dynamic_entries(), 0u);
+  EXPECT_EQ(static_cast<std::uint8_t>(block[0]) & 0xf0, 0x10);
+
+  HpackDecoder decoder;
+  EXPECT_EQ(
+    decoder.decode(block),
+    (HpackHeaders{{"set-cookie", "session=secret"}})
+  );
+  EXPECT_EQ(decoder.table().dynamic_entries(), 0u);
+}
+
+TEST(HpackEncoder, AnnouncesTableSizeChanges) {
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+  std::string block;
+  encoder.encode({{"x-custom", "value"}}, block);
+  decoder.decode(block);
+  EXPECT_EQ(decoder.table().dynamic_entries(), 1u);
+
+  encoder.max_table_size(0);
+  block.clear();
+  encoder.encode({{"x-custom", "value"}}, block);
+  EXPECT_EQ(static_cast<std::uint8_t>(block[0]), 0x20);
+  EXPECT_EQ(decoder.decode(block), (HpackHeaders{{"x-custom", "value"}}));
+  EXPECT_EQ(decoder.table().dynamic_entries(), 0u);
+  EXPECT_EQ(decoder.table().max_size(), 0u);
+}
+
+TEST(HpackTable, EvictsOldestEntries) {
+  HpackTable table{100};
+  table.insert({"aaaa", "1111"});
+  table.insert({"bbbb", "2222"});
+  EXPECT_EQ(table.size(), 80u);
+  table.insert({"cccc", "3333"});
+  EXPECT_EQ(table.dynamic_entries(), 2u);
+  EXPECT_EQ(table.at(62), (HpackHeader{"cccc", "3333"}));
+  EXPECT_EQ(table.at(63), (HpackHeader{"bbbb", "2222"}));
+  EXPECT_EQ(table.find("aaaa", "1111").first, 0u);
+  EXPECT_EQ(table.find(":path", "/"), std::make_pair(std::size_t{4}, true));
+  EXPECT_EQ(table.find(":path", "/x"), std::make_pair(std::size_t{4}, false));
+}
+
+}
+}
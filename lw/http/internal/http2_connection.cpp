@@ -0,0 +1,1000 @@
+#include "lw/http/internal/http2_connection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/err/canonical.h"
+#include "lw/flags/flags.h"
+#include "lw/http/http_request.h"
+#include "lw/http/http_response.h"
+#include "lw/http/internal/hpack.h"
+#include "lw/http/internal/http2_frame.h"
+#include "lw/io/co/co.h"
+#include "lw/log/log.h"
+#include "lw/memory/buffer.h"
+
+LW_FLAG(
+  std::uint32_t, http2_max_concurrent_streams, 100,
+  "Maximum number of requests a client may have open at once on one HTTP/2 "
+  "connection."
+);
+
+LW_FLAG(
+  std::uint32_t, http2_initial_window_size, 1024 * 1024,
+  "Bytes of request bodies an HTTP/2 client may send, per stream and per "
+  "connection, before waiting for the server to catch up."
+);
+
+LW_FLAG(
+  std::size_t, http2_max_request_body_size, 16 * 1024 * 1024,
+  "Largest request body an HTTP/2 client may send. Bodies are held in memory "
+  "until the request ends, so streams sending more are reset."
+);
+
+namespace lw::http::internal {
+namespace {
+
+// Limits the memory a client can tie up with a never ending header block.
+constexpr std::size_t MAX_HEADER_BLOCK_SIZE = 64 * 1024;
+
+// Response data queued beyond this is written out before queueing more.
+constexpr std::size_t OUTPUT_FLUSH_SIZE = 64 * 1024;
+
+std::uint16_t read_uint16(std::string_view data) {
+  return static_cast<std::uint16_t>(
+    (static_cast<std::uint8_t>(data[0]) << 8) |
+    static_cast<std::uint8_t>(data[1])
+  );
+}
+
+std::uint32_t read_uint32(std::string_view data) {
+  return (
+    (static_cast<std::uint32_t>(read_uint16(data)) << 16) |
+    read_uint16(data.substr(2))
+  );
+}
+
+std::string to_lower(std::string_view str) {
+  std::string lower{str};
+  for (char& c : lower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return lower;
+}
+
+/**
+ * Headers describing a single HTTP/1 connection, which HTTP/2 forbids.
+ */
+bool is_connection_specific(std::string_view name) {
+  return (
+    name == "connection" || name == "keep-alive" ||
+    name == "proxy-connection" || name == "transfer-encoding" ||
+    name == "upgrade"
+  );
+}
+
+bool has_invalid_characters(std::string_view str, std::string_view invalid) {
+  for (char c : str) {
+    if (c == '\0' || c == '\r' || c == '\n') return true;
+    if (invalid.find(c) != std::string_view::npos) return true;
+  }
+  return false;
+}
+
+/**
+ * Rebuilds the header of an HTTP/2 request in HTTP/1 form so that it can be
+ * parsed by `HttpRequest` like any other.
+ *
+ * @throw InvalidArgument
+ *  If the fields do not make a well formed request, or contain characters
+ *  which would change the meaning of the rebuilt header.
+ */
+std::string to_http1_header(const HpackHeaders& fields, std::size_t body_size) {
+  std::string_view method;
+  std::string_view path;
+  std::string_view authority;
+  bool seen_scheme = false;
+  bool seen_regular = false;
+  std::map<std::string_view, std::string> headers;
+
+  for (const HpackHeader& field : fields) {
+    if (field.name.starts_with(':')) {
+      if (seen_regular) {
+        throw InvalidArgument()
+          << "Pseudo-header " << field.name << " follows regular headers.";
+      }
+      std::string_view* target = nullptr;
+      if (field.name == ":method") target = &method;
+      else if (field.name == ":path") target = &path;
+      else if (field.name == ":authority") target = &authority;
+      else if (field.name == ":scheme" && !seen_scheme) seen_scheme = true;
+      else throw InvalidArgument() << "Unexpected pseudo-header " << field.name;
+
+      if (target) {
+        if (!target->empty()) {
+          throw InvalidArgument() << "Repeated pseudo-header " << field.name;
+        }
+        *target = field.value;
+      }
+      continue;
+    }
+
+    seen_regular = true;
+    if (
+      field.name.empty() || to_lower(field.name) != field.name ||
+      has_invalid_characters(field.name, ": \t") ||
+      has_invalid_characters(field.value, "")
+    ) {
+      throw InvalidArgument() << "Malformed header field " << field.name;
+    }
+    if (
+      is_connection_specific(field.name) ||
+      (field.name == "te" && field.value != "trailers")
+    ) {
+      throw InvalidArgument()
+        << "Connection-specific header " << field.name << " in HTTP/2.";
+    }
+
+    auto [itr, inserted] = headers.try_emplace(field.name, field.value);
+    if (!inserted) {
+      itr->second += field.name == "cookie" ? "; " : ", ";
+      itr->second += field.value;
+    }
+  }
+
+  if (
+    method.empty() || path.empty() || !seen_scheme ||
+    has_invalid_characters(method, " \t") || has_invalid_characters(path, " \t")
+  ) {
+    throw InvalidArgument()
+      << "Request is missing its method, path, or scheme.";
+  }
+  if (has_invalid_characters(authority, " \t")) {
+    throw InvalidArgument() << "Malformed :authority " << authority;
+  }
+
+  auto content_length = headers.find("content-length");
+  if (content_length == headers.end()) {
+    headers.emplace("content-length", std::to_string(body_size));
+  } else if (content_length->second != std::to_string(body_size)) {
+    throw InvalidArgument()
+      << "Content-Length " << content_length->second << " does not match "
+      << body_size << " bytes of data.";
+  }
+  if (!authority.empty() && !headers.contains("host")) {
+    headers.emplace("host", std::string{authority});
+  }
+
+  std::string raw_header;
+  raw_header.reserve(method.size() + path.size() + 64);
+  raw_header.append(method).append(" ").append(path).append(" HTTP/2\r\n");
+  for (const auto& [name, value] : headers) {
+    raw_header.append(name).append(": ").append(value).append("\r\n");
+  }
+  raw_header.append("\r\n");
+  return raw_header;
+}
+
+HpackHeaders response_headers(
+  int status,
+  const Headers& headers,
+  std::size_t body_size
+) {
+  HpackHeaders fields{{":status", std::to_string(status)}};
+  bool has_content_length = false;
+  for (const auto& [name, value] : headers) {
+    std::string lower = to_lower(name);
+    if (is_connection_specific(lower)) continue;
+    has_content_length = has_content_length || lower == "content-length";
+    fields.push_back({std::move(lower), value});
+  }
+  if (!has_content_length) {
+    fields.push_back({"content-length", std::to_string(body_size)});
+  }
+  return fields;
+}
+
+/**
+ * Recovers the status and headers of a response serialized for HTTP/1, as
+ * stored in the response cache.
+ */
+HpackHeaders cached_response_headers(std::string_view serialized_header) {
+  // HTTP/1.1 200 OK\r\n
+  HpackHeaders fields{{":status", std::string{serialized_header.substr(9, 3)}}};
+  std::size_t pos = serialized_header.find("\r\n") + 2;
+  while (pos < serialized_header.size()) {
+    const std::size_t end = serialized_header.find("\r\n", pos);
+    if (end == pos || end == std::string_view::npos) break;
+    std::string_view line = serialized_header.substr(pos, end - pos);
+    pos = end + 2;
+
+    const std::size_t colon = line.find(": ");
+    std::string name = to_lower(line.substr(0, colon));
+    if (colon == std::string_view::npos || is_connection_specific(name)) {
+      continue;
+    }
+    fields.push_back({std::move(name), std::string{line.substr(colon + 2)}});
+  }
+  return fields;
+}
+
+bool has_response_body(const HttpRequest& request, int status) {
+  return (
+    request.method() != "HEAD" && status != HttpResponse::NO_CONTENT &&
+    status != HttpResponse::NOT_MODIFIED
+  );
+}
+
+/**
+ * Hands a request body which has already arrived in full to `HttpRequest`.
+ */
+class BodyReader: public io::BaseCoReader {
+public:
+  bool eof() const override { return _pos >= _body.size(); }
+  bool good() const override { return !eof(); }
+
+  co::Future<Buffer> read(std::size_t bytes) override {
+    co_return _take(std::min(bytes, _body.size() - _pos));
+  }
+
+  co::Future<Buffer> read_exactly(std::size_t bytes) override {
+    return read(bytes);
+  }
+
+  co::Future<Buffer> read_until(
+    std::uint8_t c,
+    std::size_t limit = 0
+  ) override {
+    co_return _take_through(
+      std::string_view{_body}.find(static_cast<char>(c), _pos), 1, limit
+    );
+  }
+
+  co::Future<Buffer> read_until(
+    std::string_view str,
+    std::size_t limit = 0
+  ) override {
+    co_return _take_through(
+      std::string_view{_body}.find(str, _pos), str.size(), limit
+    );
+  }
+
+  std::string& body() { return _body; }
+
+private:
+  Buffer _take(std::size_t size) {
+    Buffer result{reinterpret_cast<std::uint8_t*>(_body.data()) + _pos, size};
+    _pos += size;
+    return result;
+  }
+
+  Buffer _take_through(std::size_t found, std::size_t size, std::size_t limit) {
+    if (found == std::string::npos) return Buffer{};
+    const std::size_t length = found + size - _pos;
+    if (limit && length > limit) return Buffer{};
+    return _take(length);
+  }
+
+  std::string _body;
+  std::size_t _pos = 0;
+};
+
+}
+
+class Http2Connection::Stream: public HttpResponder {
+public:
+  Stream(Http2Connection& connection, std::uint32_t id):
+    id{id},
+    request{reader},
+    send_window{connection._peer_initial_window},
+    receive_window{flags::http2_initial_window_size},
+    _connection{connection}
+  {}
+
+  co::Future<void> send(
+    const HttpRequest& req,
+    const HttpResponse& res
+  ) override {
+    log(INFO)
+      << "Responding " << res.status() << " to " << req.method() << ' '
+      << req.path();
+    co_await _connection._respond(
+      *this,
+      response_headers(res.status(), res.headers(), res.body().size()),
+      has_response_body(req, res.status()) ? res.body() : std::string_view{}
+    );
+  }
+
+  co::Future<void> send_cached(
+    const HttpRequest& req,
+    const CachedResponse& cached
+  ) override {
+    log(INFO)
+      << "Responding " << HttpResponse::OK << " to " << req.method() << ' '
+      << req.path();
+    const std::string_view serialized = cached.serialized;
+    const std::size_t header_size = serialized.size() - cached.body_size;
+    co_await _connection._respond(
+      *this,
+      cached_response_headers(serialized.substr(0, header_size)),
+      has_response_body(req, HttpResponse::OK) ?
+        serialized.substr(header_size) :
+        std::string_view{}
+    );
+  }
+
+  const std::uint32_t id;
+  HpackHeaders fields;
+  BodyReader reader;
+  HttpRequest request;
+  HttpResponse response;
+  std::int64_t send_window;
+  std::int64_t receive_window;
+
+  bool end_stream_received = false;
+  bool running = false;
+  bool reset = false;
+  bool response_finished = false;
+
+private:
+  Http2Connection& _connection;
+};
+
+Http2Connection::Http2Connection(io::CoStream& conn, Dispatcher dispatch):
+  _conn{conn},
+  _dispatch{std::move(dispatch)},
+  _receive_window{flags::http2_initial_window_size}
+{}
+
+Http2Connection::~Http2Connection() = default;
+
+co::Future<void> Http2Connection::run() {
+  try {
+    if (
+      !co_await _fill(HTTP2_PREFACE.size()) ||
+      !_unread().starts_with(HTTP2_PREFACE)
+    ) {
+      log(INFO) << "Client did not send the HTTP/2 connection preface.";
+      _conn.close();
+      co_return;
+    }
+    _input_pos += HTTP2_PREFACE.size();
+
+    const std::uint32_t window = flags::http2_initial_window_size;
+    append_settings_frame(_pending, {
+      {Http2Setting::ENABLE_PUSH, 0},
+      {
+        Http2Setting::MAX_CONCURRENT_STREAMS,
+        flags::http2_max_concurrent_streams
+      },
+      {Http2Setting::INITIAL_WINDOW_SIZE, window},
+      {
+        Http2Setting::MAX_HEADER_LIST_SIZE,
+        static_cast<std::uint32_t>(_decoder.max_header_list_size())
+      }
+    });
+    if (window > HTTP2_DEFAULT_WINDOW_SIZE) {
+      append_window_update_frame(
+        _pending,
+        0,
+        window - HTTP2_DEFAULT_WINDOW_SIZE
+      );
+    }
+    co_await _flush();
+
+    while (co_await _read_frame()) {
+      // Replies to whole batches of frames, such as SETTINGS and PING acks,
+      // go out together once the input runs dry.
+      if (!_has_buffered_frame()) co_await _flush();
+    }
+  } catch (const Error& err) {
+    if (_error == Http2Error::NO_ERROR) {
+      log(ERROR) << "HTTP/2 connection failed: " << err.what();
+      _error = Http2Error::INTERNAL_ERROR;
+    } else {
+      log(INFO) << "HTTP/2 protocol error from client: " << err.what();
+      append_goaway_frame(_pending, _last_stream_id, _error);
+    }
+  }
+
+  // Nothing more will arrive, so responses waiting on the client to open its
+  // flow control windows give up.
+  _receiving = false;
+  _wake_window_waiters();
+  if (_active_streams > 0) {
+    _streams_finished.emplace();
+    co_await _streams_finished->get_future();
+  }
+
+  try {
+    co_await _flush();
+  } catch (const Error& err) {
+    log(ERROR) << "Failed to flush HTTP/2 connection: " << err.what();
+  }
+  _conn.close();
+}
+
+std::string_view Http2Connection::_unread() const {
+  return std::string_view{_input}.substr(_input_pos);
+}
+
+bool Http2Connection::_has_buffered_frame() const {
+  const std::string_view unread = _unread();
+  return (
+    unread.size() >= HTTP2_FRAME_HEADER_SIZE &&
+    unread.size() >=
+      HTTP2_FRAME_HEADER_SIZE + parse_frame_header(unread).length
+  );
+}
+
+co::Future<bool> Http2Connection::_fill(std::size_t size) {
+  while (_input.size() - _input_pos < size) {
+    if (!_conn.good()) co_return false;
+    if (_input_pos > 0) {
+      _input.erase(0, _input_pos);
+      _input_pos = 0;
+    }
+
+    const std::size_t offset = _input.size();
+    const std::size_t block_size =
+      std::max<std::size_t>(flags::read_block_size, size - offset);
+    _input.resize(offset + block_size);
+    Buffer buffer{
+      reinterpret_cast<std::uint8_t*>(_input.data()) + offset,
+      block_size
+    };
+    const std::size_t bytes_read = co_await _conn.read(buffer);
+    _input.resize(offset + bytes_read);
+  }
+  co_return true;
+}
+
+co::Future<bool> Http2Connection::_read_frame() {
+  if (!co_await _fill(HTTP2_FRAME_HEADER_SIZE)) co_return false;
+  const Http2FrameHeader header = parse_frame_header(_unread());
+  if (header.length > HTTP2_DEFAULT_MAX_FRAME_SIZE) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "Frame larger than SETTINGS allow.");
+  }
+
+  const std::size_t frame_size = HTTP2_FRAME_HEADER_SIZE + header.length;
+  if (!co_await _fill(frame_size)) co_return false;
+  _handle_frame(
+    header,
+    _unread().substr(HTTP2_FRAME_HEADER_SIZE, header.length)
+  );
+  _input_pos += frame_size;
+  co_return true;
+}
+
+co::Future<void> Http2Connection::_flush() {
+  // Whichever caller gets to write sends everything queued so far, so callers
+  // which had to wait usually find nothing left to do.
+  while (_writing) co_await _write_finished();
+  if (_pending.empty()) co_return;
+
+  _writing = true;
+  std::swap(_pending, _sending);
+  _pending.clear();
+  try {
+    Buffer buffer{
+      reinterpret_cast<std::uint8_t*>(_sending.data()),
+      _sending.size()
+    };
+    while (!buffer.empty()) {
+      const std::size_t written = co_await _conn.write(buffer);
+      if (written == 0) {
+        throw Unavailable() << "Connection closed while sending frames.";
+      }
+      buffer = buffer.trim_prefix(written);
+    }
+    co_await _conn.flush();
+  } catch (...) {
+    _writing = false;
+    _wake_write_waiters();
+    throw;
+  }
+  _writing = false;
+  _wake_write_waiters();
+}
+
+co::Future<void> Http2Connection::_write_finished() {
+  co::Promise<void> promise;
+  co::Future<void> future = promise.get_future();
+  _write_waiters.push_back(std::move(promise));
+  return future;
+}
+
+void Http2Connection::_wake_write_waiters() {
+  std::vector<co::Promise<void>> waiters = std::move(_write_waiters);
+  _write_waiters.clear();
+  for (co::Promise<void>& waiter : waiters) waiter.set_value();
+}
+
+void Http2Connection::_fail(Http2Error error, std::string_view message) {
+  _error = error;
+  throw InvalidArgument() << message;
+}
+
+void Http2Connection::_reset(std::uint32_t stream_id, Http2Error error) {
+  append_rst_stream_frame(_pending, stream_id, error);
+  auto itr = _streams.find(stream_id);
+  if (itr == _streams.end()) return;
+  if (itr->second->running) {
+    // The handler owns the stream until it finishes, but nothing more it
+    // sends will go out.
+    itr->second->reset = true;
+    _wake_window_waiters();
+  } else {
+    _streams.erase(itr);
+  }
+}
+
+void Http2Connection::_handle_frame(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (
+    _header_block_stream != 0 &&
+    header.type != Http2FrameType::CONTINUATION
+  ) {
+    _fail(Http2Error::PROTOCOL_ERROR, "Header block interrupted.");
+  }
+
+  switch (header.type) {
+    case Http2FrameType::DATA:          return _on_data(header, payload);
+    case Http2FrameType::HEADERS:       return _on_headers(header, payload);
+    case Http2FrameType::RST_STREAM:    return _on_rst_stream(header, payload);
+    case Http2FrameType::SETTINGS:      return _on_settings(header, payload);
+    case Http2FrameType::PING:          return _on_ping(header, payload);
+    case Http2FrameType::GOAWAY:        return _on_goaway(header, payload);
+    case Http2FrameType::WINDOW_UPDATE:
+      return _on_window_update(header, payload);
+    case Http2FrameType::CONTINUATION:
+      return _on_continuation(header, payload);
+    case Http2FrameType::PRIORITY:
+      if (header.stream_id == 0) {
+        _fail(Http2Error::PROTOCOL_ERROR, "PRIORITY for the connection.");
+      }
+      if (payload.size() != 5) {
+        _reset(header.stream_id, Http2Error::FRAME_SIZE_ERROR);
+      }
+      return;
+    case Http2FrameType::PUSH_PROMISE:
+      _fail(Http2Error::PROTOCOL_ERROR, "Clients must not push.");
+  }
+  // Unknown frame types are ignored.
+}
+
+void Http2Connection::_on_data(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (header.stream_id == 0) {
+    _fail(Http2Error::PROTOCOL_ERROR, "DATA for the connection.");
+  }
+
+  // Padding counts against flow control too.
+  const std::int64_t window = flags::http2_initial_window_size;
+  _receive_window -= header.length;
+  if (_receive_window < 0) {
+    _fail(Http2Error::FLOW_CONTROL_ERROR, "Connection window exceeded.");
+  }
+  if (_receive_window < window / 2) {
+    append_window_update_frame(_pending, 0, window - _receive_window);
+    _receive_window = window;
+  }
+  payload = _unpad(header, payload);
+
+  auto itr = _streams.find(header.stream_id);
+  if (itr == _streams.end() || itr->second->end_stream_received) {
+    if (header.stream_id > _last_stream_id) {
+      _fail(Http2Error::PROTOCOL_ERROR, "DATA for an idle stream.");
+    }
+    _reset(header.stream_id, Http2Error::STREAM_CLOSED);
+    return;
+  }
+
+  Stream& stream = *itr->second;
+  stream.receive_window -= header.length;
+  if (stream.receive_window < 0) {
+    _reset(stream.id, Http2Error::FLOW_CONTROL_ERROR);
+    return;
+  }
+  // Windows are reopened as data arrives, not as handlers read it, so they do
+  // nothing to bound how much of a body is held.
+  if (
+    stream.reader.body().size() + payload.size() >
+    flags::http2_max_request_body_size
+  ) {
+    log(INFO)
+      << "HTTP/2 request body on stream " << stream.id << " is too large.";
+    _reset(stream.id, Http2Error::ENHANCE_YOUR_CALM);
+    return;
+  }
+  stream.reader.body().append(payload);
+
+  if (header.has_flag(http2_flags::END_STREAM)) {
+    _end_stream(stream);
+  } else if (stream.receive_window < window / 2) {
+    append_window_update_frame(
+      _pending,
+      stream.id,
+      window - stream.receive_window
+    );
+    stream.receive_window = window;
+  }
+}
+
+void Http2Connection::_on_headers(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (header.stream_id == 0 || header.stream_id % 2 == 0) {
+    _fail(Http2Error::PROTOCOL_ERROR, "HEADERS for an invalid stream.");
+  }
+  payload = _unpad(header, payload);
+  if (header.has_flag(http2_flags::PRIORITY)) {
+    if (payload.size() < 5) {
+      _fail(Http2Error::PROTOCOL_ERROR, "HEADERS too short for priority.");
+    }
+    payload.remove_prefix(5);
+  }
+
+  _header_block_stream = header.stream_id;
+  _header_block_ends_stream = header.has_flag(http2_flags::END_STREAM);
+  _header_block.assign(payload);
+  if (header.has_flag(http2_flags::END_HEADERS)) _on_header_block();
+}
+
+void Http2Connection::_on_continuation(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (
+    _header_block_stream == 0 || header.stream_id != _header_block_stream
+  ) {
+    _fail(Http2Error::PROTOCOL_ERROR, "Unexpected CONTINUATION.");
+  }
+  if (_header_block.size() + payload.size() > MAX_HEADER_BLOCK_SIZE) {
+    _fail(Http2Error::ENHANCE_YOUR_CALM, "Header block too large.");
+  }
+  _header_block.append(payload);
+  if (header.has_flag(http2_flags::END_HEADERS)) _on_header_block();
+}
+
+void Http2Connection::_on_header_block() {
+  const std::uint32_t stream_id = std::exchange(_header_block_stream, 0);
+  HpackHeaders fields;
+  try {
+    fields = _decoder.decode(_header_block);
+  } catch (const InvalidArgument& err) {
+    _fail(Http2Error::COMPRESSION_ERROR, err.what());
+  }
+  _header_block.clear();
+
+  auto itr = _streams.find(stream_id);
+  if (itr != _streams.end()) {
+    // Trailers, which handlers have no way to read, so only their framing
+    // matters.
+    Stream& stream = *itr->second;
+    if (stream.end_stream_received) {
+      _reset(stream_id, Http2Error::STREAM_CLOSED);
+    } else if (!_header_block_ends_stream) {
+      _reset(stream_id, Http2Error::PROTOCOL_ERROR);
+    } else {
+      _end_stream(stream);
+    }
+    return;
+  }
+  if (stream_id <= _last_stream_id) {
+    _fail(Http2Error::STREAM_CLOSED, "HEADERS for a closed stream.");
+  }
+  _last_stream_id = stream_id;
+
+  if (_streams.size() >= flags::http2_max_concurrent_streams) {
+    append_rst_stream_frame(_pending, stream_id, Http2Error::REFUSED_STREAM);
+    return;
+  }
+  auto stream = std::make_unique<Stream>(*this, stream_id);
+  stream->fields = std::move(fields);
+  Stream& stream_ref = *stream;
+  _streams.emplace(stream_id, std::move(stream));
+  if (_header_block_ends_stream) _end_stream(stream_ref);
+}
+
+void Http2Connection::_on_rst_stream(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (header.stream_id == 0 || header.stream_id > _last_stream_id) {
+    _fail(Http2Error::PROTOCOL_ERROR, "RST_STREAM for an idle stream.");
+  }
+  if (payload.size() != 4) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "RST_STREAM must be 4 bytes.");
+  }
+
+  auto itr = _streams.find(header.stream_id);
+  if (itr == _streams.end()) return;
+  if (itr->second->running) {
+    itr->second->reset = true;
+    _wake_window_waiters();
+  } else {
+    _streams.erase(itr);
+  }
+}
+
+void Http2Connection::_on_settings(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (header.stream_id != 0) {
+    _fail(Http2Error::PROTOCOL_ERROR, "SETTINGS for a stream.");
+  }
+  if (header.has_flag(http2_flags::ACK)) {
+    if (!payload.empty()) {
+      _fail(Http2Error::FRAME_SIZE_ERROR, "SETTINGS ack with a payload.");
+    }
+    return;
+  }
+  if (payload.size() % 6 != 0) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "Truncated SETTINGS.");
+  }
+
+  for (; !payload.empty(); payload.remove_prefix(6)) {
+    const auto setting = static_cast<Http2Setting>(read_uint16(payload));
+    const std::uint32_t value = read_uint32(payload.substr(2));
+    switch (setting) {
+      case Http2Setting::HEADER_TABLE_SIZE:
+        _encoder.max_table_size(value);
+        break;
+      case Http2Setting::ENABLE_PUSH:
+        if (value > 1) _fail(Http2Error::PROTOCOL_ERROR, "Bad ENABLE_PUSH.");
+        break;
+      case Http2Setting::INITIAL_WINDOW_SIZE: {
+        if (value > HTTP2_MAX_WINDOW_SIZE) {
+          _fail(Http2Error::FLOW_CONTROL_ERROR, "INITIAL_WINDOW_SIZE too big.");
+        }
+        const std::int64_t delta = value - _peer_initial_window;
+        for (auto& [id, stream] : _streams) {
+          stream->send_window += delta;
+          if (stream->send_window > HTTP2_MAX_WINDOW_SIZE) {
+            _fail(Http2Error::FLOW_CONTROL_ERROR, "Stream window overflow.");
+          }
+        }
+        _peer_initial_window = value;
+        break;
+      }
+      case Http2Setting::MAX_FRAME_SIZE:
+        if (
+          value < HTTP2_DEFAULT_MAX_FRAME_SIZE ||
+          value > HTTP2_MAX_FRAME_SIZE_LIMIT
+        ) {
+          _fail(Http2Error::PROTOCOL_ERROR, "MAX_FRAME_SIZE out of range.");
+        }
+        _peer_max_frame_size = value;
+        break;
+      default:
+        // Settings which only constrain the server's own requests, or which
+        // are unknown, have no effect.
+        break;
+    }
+  }
+
+  append_frame(_pending, Http2FrameType::SETTINGS, http2_flags::ACK, 0);
+  _wake_window_waiters();
+}
+
+void Http2Connection::_on_ping(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (header.stream_id != 0) {
+    _fail(Http2Error::PROTOCOL_ERROR, "PING for a stream.");
+  }
+  if (payload.size() != 8) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "PING must be 8 bytes.");
+  }
+  if (!header.has_flag(http2_flags::ACK)) {
+    append_frame(_pending, Http2FrameType::PING, http2_flags::ACK, 0, payload);
+  }
+}
+
+void Http2Connection::_on_goaway(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (header.stream_id != 0) {
+    _fail(Http2Error::PROTOCOL_ERROR, "GOAWAY for a stream.");
+  }
+  if (payload.size() < 8) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "GOAWAY too short.");
+  }
+  log(INFO)
+    << "HTTP/2 client going away with error code "
+    << read_uint32(payload.substr(4));
+}
+
+void Http2Connection::_on_window_update(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (payload.size() != 4) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "WINDOW_UPDATE must be 4 bytes.");
+  }
+  const std::uint32_t increment = read_uint31(payload);
+
+  if (header.stream_id == 0) {
+    if (increment == 0) {
+      _fail(Http2Error::PROTOCOL_ERROR, "Empty WINDOW_UPDATE.");
+    }
+    _send_window += increment;
+    if (_send_window > HTTP2_MAX_WINDOW_SIZE) {
+      _fail(Http2Error::FLOW_CONTROL_ERROR, "Connection window overflow.");
+    }
+  } else {
+    if (header.stream_id > _last_stream_id) {
+      _fail(Http2Error::PROTOCOL_ERROR, "WINDOW_UPDATE for an idle stream.");
+    }
+    auto itr = _streams.find(header.stream_id);
+    if (itr == _streams.end()) return;
+    Stream& stream = *itr->second;
+    stream.send_window += increment;
+    if (increment == 0) {
+      _reset(stream.id, Http2Error::PROTOCOL_ERROR);
+      return;
+    }
+    if (stream.send_window > HTTP2_MAX_WINDOW_SIZE) {
+      _reset(stream.id, Http2Error::FLOW_CONTROL_ERROR);
+      return;
+    }
+  }
+  _wake_window_waiters();
+}
+
+std::string_view Http2Connection::_unpad(
+  const Http2FrameHeader& header,
+  std::string_view payload
+) {
+  if (!header.has_flag(http2_flags::PADDED)) return payload;
+  if (payload.empty()) {
+    _fail(Http2Error::FRAME_SIZE_ERROR, "Padded frame without padding.");
+  }
+  const std::size_t padding = static_cast<std::uint8_t>(payload[0]);
+  if (padding >= payload.size()) {
+    _fail(Http2Error::PROTOCOL_ERROR, "Padding longer than frame.");
+  }
+  return payload.substr(1, payload.size() - 1 - padding);
+}
+
+void Http2Connection::_end_stream(Stream& stream) {
+  stream.end_stream_received = true;
+  std::string raw_header;
+  try {
+    raw_header = to_http1_header(stream.fields, stream.reader.body().size());
+  } catch (const InvalidArgument& err) {
+    log(INFO) << "Malformed HTTP/2 request: " << err.what();
+    _reset(stream.id, Http2Error::PROTOCOL_ERROR);
+    return;
+  }
+  stream.fields.clear();
+  stream.running = true;
+  ++_active_streams;
+  co::Scheduler::this_thread().schedule(_serve(stream, std::move(raw_header)));
+}
+
+co::Task Http2Connection::_serve(Stream& stream, std::string raw_header) {
+  const std::uint32_t stream_id = stream.id;
+  try {
+    bool parsed = false;
+    try {
+      stream.request.parse_header(std::move(raw_header));
+      parsed = true;
+    } catch (const InvalidArgument& err) {
+      log(INFO) << "Malformed header from client: " << err.what();
+      stream.response.status(HttpResponse::BAD_REQUEST);
+      stream.response.header("Content-Type", "text/plain");
+      stream.response.body(err.what());
+    }
+
+    if (parsed) {
+      co_await _dispatch(stream.request, stream.response, stream);
+    } else {
+      co_await stream.send(stream.request, stream.response);
+    }
+  } catch (const Error& err) {
+    log(ERROR) << "Unhandled application error: " << err.what();
+  }
+
+  if (
+    !stream.response_finished &&
+    !stream.reset &&
+    _error == Http2Error::NO_ERROR
+  ) {
+    append_rst_stream_frame(_pending, stream_id, Http2Error::INTERNAL_ERROR);
+  }
+  _streams.erase(stream_id);
+  if (--_active_streams == 0 && _streams_finished) {
+    _streams_finished->set_value();
+  }
+}
+
+co::Future<void> Http2Connection::_respond(
+  Stream& stream,
+  const HpackHeaders& headers,
+  std::string_view body
+) {
+  if (_error != Http2Error::NO_ERROR || stream.reset) co_return;
+
+  std::string header_block;
+  _encoder.encode(headers, header_block);
+  append_header_frames(
+    _pending,
+    stream.id,
+    header_block,
+    body.empty(),
+    _peer_max_frame_size
+  );
+
+  while (!body.empty()) {
+    if (_error != Http2Error::NO_ERROR || stream.reset) co_return;
+
+    const std::int64_t window = std::min(_send_window, stream.send_window);
+    if (window <= 0) {
+      if (!_pending.empty()) {
+        co_await _flush();
+      } else if (!_receiving) {
+        log(INFO) << "HTTP/2 client closed before opening its window.";
+        co_return;
+      } else {
+        co_await _window_opened();
+      }
+      continue;
+    }
+
+    const std::size_t size = std::min<std::size_t>(
+      {body.size(), static_cast<std::size_t>(window), _peer_max_frame_size}
+    );
+    append_frame(
+      _pending,
+      Http2FrameType::DATA,
+      size == body.size() ? http2_flags::END_STREAM : 0,
+      stream.id,
+      body.substr(0, size)
+    );
+    body.remove_prefix(size);
+    _send_window -= size;
+    stream.send_window -= size;
+    if (_pending.size() >= OUTPUT_FLUSH_SIZE) co_await _flush();
+  }
+
+  stream.response_finished = true;
+  // Streams finishing together share one write instead of each sending a
+  // small one, which Nagle's algorithm would hold up behind the client's ACK.
+  co_await co::next_tick();
+  co_await _flush();
+}
+
+co::Future<void> Http2Connection::_window_opened() {
+  co::Promise<void> promise;
+  co::Future<void> future = promise.get_future();
+  _window_waiters.push_back(std::move(promise));
+  return future;
+}
+
+void Http2Connection::_wake_window_waiters() {
+  std::vector<co::Promise<void>> waiters = std::move(_window_waiters);
+  _window_waiters.clear();
+  for (co::Promise<void>& waiter : waiters) waiter.set_value();
+}
+
+}
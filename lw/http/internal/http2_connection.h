@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lw/co/future.h"
+#include "lw/co/task.h"
+#include "lw/flags/flags.h"
+#include "lw/http/http_request.h"
+#include "lw/http/http_response.h"
+#include "lw/http/internal/hpack.h"
+#include "lw/http/internal/http2_frame.h"
+#include "lw/http/internal/http_responder.h"
+#include "lw/io/co/co.h"
+
+LW_DECLARE_FLAG(std::uint32_t, http2_max_concurrent_streams);
+LW_DECLARE_FLAG(std::uint32_t, http2_initial_window_size);
+LW_DECLARE_FLAG(std::size_t, http2_max_request_body_size);
+
+namespace lw::http::internal {
+
+/**
+ * Serves one HTTP/2 connection (RFC 9113), running each of its streams as a
+ * separate request so that slow handlers do not hold up the others.
+ *
+ * Request bodies are received in full before their handler starts, matching
+ * the HTTP/1 handlers which read `Content-Length` bytes. Streams whose bodies
+ * grow past `http2_max_request_body_size` are reset. Priorities are ignored
+ * and nothing is ever pushed.
+ */
+class Http2Connection {
+public:
+  /**
+   * Routes a request to its handler and responds through the given responder.
+   */
+  typedef std::function<
+    co::Future<void>(HttpRequest&, HttpResponse&, HttpResponder&)
+  > Dispatcher;
+
+  Http2Connection(io::CoStream& conn, Dispatcher dispatch);
+  ~Http2Connection();
+
+  Http2Connection(const Http2Connection&) = delete;
+  Http2Connection& operator=(const Http2Connection&) = delete;
+
+  /**
+   * Reads the client preface and serves requests until the client closes the
+   * connection or breaks the protocol. Requests which have already started
+   * are allowed to finish responding before the connection is closed.
+   */
+  co::Future<void> run();
+
+private:
+  class Stream;
+
+  std::string_view _unread() const;
+  bool _has_buffered_frame() const;
+  co::Future<bool> _fill(std::size_t size);
+  co::Future<bool> _read_frame();
+  co::Future<void> _flush();
+  co::Future<void> _write_finished();
+  void _wake_write_waiters();
+
+  /**
+   * Records a connection error, to be reported to the client in a GOAWAY.
+   */
+  [[noreturn]] void _fail(Http2Error error, std::string_view message);
+  void _reset(std::uint32_t stream_id, Http2Error error);
+
+  void _handle_frame(const Http2FrameHeader& header, std::string_view payload);
+  void _on_data(const Http2FrameHeader& header, std::string_view payload);
+  void _on_headers(const Http2FrameHeader& header, std::string_view payload);
+  void _on_continuation(
+    const Http2FrameHeader& header,
+    std::string_view payload
+  );
+  void _on_header_block();
+  void _on_rst_stream(const Http2FrameHeader& header, std::string_view payload);
+  void _on_settings(const Http2FrameHeader& header, std::string_view payload);
+  void _on_ping(const Http2FrameHeader& header, std::string_view payload);
+  void _on_goaway(const Http2FrameHeader& header, std::string_view payload);
+  void _on_window_update(
+    const Http2FrameHeader& header,
+    std::string_view payload
+  );
+  std::string_view _unpad(
+    const Http2FrameHeader& header,
+    std::string_view payload
+  );
+
+  void _end_stream(Stream& stream);
+  co::Task _serve(Stream& stream, std::string raw_header);
+  co::Future<void> _respond(
+    Stream& stream,
+    const HpackHeaders& headers,
+    std::string_view body
+  );
+  co::Future<void> _window_opened();
+  void _wake_window_waiters();
+
+  io::CoStream& _conn;
+  Dispatcher _dispatch;
+  HpackDecoder _decoder;
+  HpackEncoder _encoder;
+
+  std::string _input;
+  std::size_t _input_pos = 0;
+  // Frames are queued in `_pending` and swapped into `_sending` for writing so
+  // that only one write is ever in progress and frames are never interleaved.
+  std::string _pending;
+  std::string _sending;
+  bool _writing = false;
+  std::vector<co::Promise<void>> _write_waiters;
+
+  std::map<std::uint32_t, std::unique_ptr<Stream>> _streams;
+  std::uint32_t _last_stream_id = 0;
+  std::size_t _active_streams = 0;
+  std::optional<co::Promise<void>> _streams_finished;
+
+  // A header block spread over HEADERS and CONTINUATION frames.
+  std::uint32_t _header_block_stream = 0;
+  bool _header_block_ends_stream = false;
+  std::string _header_block;
+
+  std::int64_t _send_window = HTTP2_DEFAULT_WINDOW_SIZE;
+  std::int64_t _receive_window;
+  std::int64_t _peer_initial_window = HTTP2_DEFAULT_WINDOW_SIZE;
+  std::uint32_t _peer_max_frame_size = HTTP2_DEFAULT_MAX_FRAME_SIZE;
+  std::vector<co::Promise<void>> _window_waiters;
+
+  bool _receiving = true;
+  Http2Error _error = Http2Error::NO_ERROR;
+};
+
+}
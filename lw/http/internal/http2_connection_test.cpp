@@ -0,0 +1,308 @@
+#include "lw/http/internal/http2_connection.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/http/http_request.h"
+#include "lw/http/http_response.h"
+#include "lw/http/internal/hpack.h"
+#include "lw/http/internal/http2_frame.h"
+#include "lw/http/internal/http_responder.h"
+#include "lw/http/testing/http2_client.h"
+#include "lw/io/co/testing/string_connection.h"
+
+namespace lw::http::internal {
+namespace {
+
+using ::lw::http::testing::Http2TestClient;
+using ::lw::io::testing::CoStringConnection;
+
+/**
+ * Responds with the request's path, followed by its body if it has one.
+ */
+co::Future<void> echo_path(
+  HttpRequest& request,
+  HttpResponse& response,
+  HttpResponder& responder
+) {
+  std::string body{request.path()};
+  if (request.content_length() > 0) {
+    body += ':';
+    body += static_cast<std::string_view>(co_await request.body());
+  }
+  response.header("Content-Type", "text/plain");
+  response.body(body);
+  co_await responder.send(request, response);
+}
+
+/**
+ * Keeps a test connection open after its input runs out, until the test is
+ * done feeding it.
+ */
+class HeldOpenConnection: public io::CoStream {
+public:
+  explicit HeldOpenConnection(io::CoStream& conn): _conn{conn} {}
+
+  bool eof() const override { return !_open && _conn.eof(); }
+  bool good() const override { return _open || _conn.good(); }
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return _conn.read(buffer);
+  }
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    return _conn.write(buffer);
+  }
+  void close() override { _open = false; }
+
+  void release() { _open = false; }
+
+private:
+  io::CoStream& _conn;
+  bool _open = true;
+};
+
+/**
+ * Accepts at most a few bytes per write, the way a socket with a full send
+ * buffer does.
+ */
+class ShortWriteConnection: public io::CoStream {
+public:
+  explicit ShortWriteConnection(io::CoStream& conn): _conn{conn} {}
+
+  bool eof() const override { return _conn.eof(); }
+  bool good() const override { return _conn.good(); }
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return _conn.read(buffer);
+  }
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    const Buffer prefix =
+      buffer.trim_suffix(buffer.size() - std::min(buffer.size(), MAX_WRITE));
+    co_return co_await _conn.write(prefix);
+  }
+  void close() override { _conn.close(); }
+
+private:
+  static constexpr std::size_t MAX_WRITE = 7;
+
+  io::CoStream& _conn;
+};
+
+class Http2ConnectionTest: public ::testing::Test {
+protected:
+  void SetUp() override {
+    auto [client, server] = CoStringConnection::make_connection();
+    client_conn = std::move(client);
+    server_conn = std::move(server);
+  }
+
+  void serve(io::CoStream& conn, Http2Connection::Dispatcher dispatch) {
+    Http2Connection http2{conn, std::move(dispatch)};
+    auto run = [&]() -> co::Task { co_await http2.run(); };
+    co::Scheduler::this_thread().schedule(run);
+    co::Scheduler::this_thread().run();
+    client.receive(server_conn->data());
+  }
+
+  void write(std::string_view data) {
+    Buffer buffer{data.begin(), data.end()};
+    auto write = [&]() -> co::Task { co_await client_conn->write(buffer); };
+    co::Scheduler::this_thread().schedule(write);
+    co::Scheduler::this_thread().run();
+  }
+
+  std::unique_ptr<CoStringConnection> client_conn;
+  std::unique_ptr<CoStringConnection> server_conn;
+  Http2TestClient client;
+};
+
+TEST_F(Http2ConnectionTest, ServesConcurrentStreams) {
+  // Built one at a time as each request's encoding depends on the last.
+  std::string requests = client.preface();
+  requests += client.request(1, "GET", "/first");
+  requests += client.request(3, "GET", "/second");
+  requests += client.request(5, "HEAD", "/third");
+  write(requests);
+  serve(*server_conn, echo_path);
+
+  EXPECT_EQ(client.settings_acks(), 1u);
+  ASSERT_EQ(client.responses().size(), 3u);
+  EXPECT_TRUE(client.response(1).complete);
+  EXPECT_EQ(client.response(1).header(":status"), "200");
+  EXPECT_EQ(client.response(1).header("content-type"), "text/plain");
+  EXPECT_EQ(client.response(1).header("content-length"), "6");
+  EXPECT_EQ(client.response(1).body, "/first");
+  EXPECT_EQ(client.response(3).body, "/second");
+
+  // HEAD responses describe the body without sending it.
+  EXPECT_TRUE(client.response(5).complete);
+  EXPECT_EQ(client.response(5).header("content-length"), "6");
+  EXPECT_EQ(client.response(5).body, "");
+}
+
+TEST_F(Http2ConnectionTest, FinishesShortWrites) {
+  std::string requests = client.preface();
+  requests += client.request(1, "GET", "/a-somewhat-longer-path");
+  write(requests);
+  ShortWriteConnection conn{*server_conn};
+  serve(conn, echo_path);
+
+  EXPECT_EQ(client.settings_acks(), 1u);
+  ASSERT_EQ(client.responses().size(), 1u);
+  EXPECT_TRUE(client.response(1).complete);
+  EXPECT_EQ(client.response(1).body, "/a-somewhat-longer-path");
+}
+
+TEST_F(Http2ConnectionTest, ReceivesRequestBodies) {
+  write(
+    client.preface() +
+    client.request(1, "POST", "/upload", {}, /*end_stream=*/false) +
+    client.data(1, "hello ", /*end_stream=*/false) +
+    client.data(1, "world")
+  );
+  serve(*server_conn, echo_path);
+
+  ASSERT_TRUE(client.response(1).complete);
+  EXPECT_EQ(client.response(1).body, "/upload:hello world");
+}
+
+TEST_F(Http2ConnectionTest, ResetsOversizedRequestBodies) {
+  const std::size_t max_size = flags::http2_max_request_body_size;
+  flags::http2_max_request_body_size = 8;
+  std::string requests = client.preface();
+  requests += client.request(1, "POST", "/small", {}, /*end_stream=*/false);
+  requests += client.data(1, "12345678");
+  requests += client.request(3, "POST", "/big", {}, /*end_stream=*/false);
+  requests += client.data(3, "12345", /*end_stream=*/false);
+  requests += client.data(3, "6789");
+  write(requests);
+  serve(*server_conn, echo_path);
+  flags::http2_max_request_body_size = max_size;
+
+  EXPECT_EQ(client.response(1).body, "/small:12345678");
+  EXPECT_EQ(client.response(3).reset, Http2Error::ENHANCE_YOUR_CALM);
+  EXPECT_FALSE(client.goaway());
+}
+
+TEST_F(Http2ConnectionTest, RebuildsHttp1Headers) {
+  std::string seen;
+  auto dispatch = [&](
+    HttpRequest& request,
+    HttpResponse& response,
+    HttpResponder& responder
+  ) {
+    seen = request.raw_header();
+    return responder.send(request, response);
+  };
+  write(
+    client.preface() +
+    client.request(1, "GET", "/path?query=1", {
+      {"cookie", "a=1"},
+      {"accept", "text/html"},
+      {"cookie", "b=2"}
+    })
+  );
+  serve(*server_conn, dispatch);
+
+  EXPECT_EQ(
+    seen,
+    "GET /path?query=1 HTTP/2\r\n"
+    "accept: text/html\r\n"
+    "content-length: 0\r\n"
+    "cookie: a=1; b=2\r\n"
+    "host: localhost\r\n"
+    "\r\n"
+  );
+}
+
+TEST_F(Http2ConnectionTest, ResetsMalformedRequests) {
+  std::string requests = client.preface();
+  requests += client.request(1, "GET", "/ok");
+  requests += client.request(3, "GET", "/bad", {{"connection", "keep-alive"}});
+  requests += client.request(5, "GET", "/bad", {{"x-bad", "a\r\nhost: evil"}});
+  requests += client.request(7, "GET", "/ok");
+  write(requests);
+  serve(*server_conn, echo_path);
+
+  EXPECT_EQ(client.response(1).body, "/ok");
+  EXPECT_EQ(client.response(3).reset, Http2Error::PROTOCOL_ERROR);
+  EXPECT_EQ(client.response(5).reset, Http2Error::PROTOCOL_ERROR);
+  EXPECT_EQ(client.response(7).body, "/ok");
+  EXPECT_FALSE(client.goaway());
+}
+
+TEST_F(Http2ConnectionTest, AnswersPings) {
+  std::string ping;
+  append_frame(ping, Http2FrameType::PING, 0, 0, "12345678");
+  write(client.preface() + ping);
+  serve(*server_conn, echo_path);
+
+  ASSERT_EQ(client.ping_acks().size(), 1u);
+  EXPECT_EQ(client.ping_acks()[0], "12345678");
+}
+
+TEST_F(Http2ConnectionTest, SendsGoawayOnProtocolErrors) {
+  // Stream IDs from clients must be odd.
+  write(client.preface() + client.request(2, "GET", "/even"));
+  serve(*server_conn, echo_path);
+
+  EXPECT_EQ(client.goaway(), Http2Error::PROTOCOL_ERROR);
+  EXPECT_TRUE(client.responses().empty());
+}
+
+TEST_F(Http2ConnectionTest, ClosesWithoutPreface) {
+  write("GET / HTTP/1.1\r\n\r\n");
+  serve(*server_conn, echo_path);
+  EXPECT_EQ(server_conn->data(), "");
+}
+
+TEST_F(Http2ConnectionTest, RespectsFlowControlWindows) {
+  auto big_response = [](
+    HttpRequest& request,
+    HttpResponse& response,
+    HttpResponder& responder
+  ) {
+    response.body(std::string(25, 'x'));
+    return responder.send(request, response);
+  };
+  write(
+    client.preface({{Http2Setting::INITIAL_WINDOW_SIZE, 10}}) +
+    client.request(1, "GET", "/big")
+  );
+
+  HeldOpenConnection held{*server_conn};
+  Http2Connection http2{held, big_response};
+  auto run = [&]() -> co::Task { co_await http2.run(); };
+  auto receive_all = [&]() {
+    client = Http2TestClient{};
+    client.receive(server_conn->data());
+  };
+  auto feed_window = [&]() -> co::Task {
+    for (int i = 0; i < 20; ++i) co_await co::next_tick();
+    receive_all();
+    EXPECT_EQ(client.response(1).body, std::string(10, 'x'));
+    EXPECT_FALSE(client.response(1).complete);
+
+    std::string update;
+    append_window_update_frame(update, 1, 100);
+    Buffer buffer{update.begin(), update.end()};
+    co_await client_conn->write(buffer);
+    for (int i = 0; i < 20; ++i) co_await co::next_tick();
+    held.release();
+  };
+  co::Scheduler::this_thread().schedule(run);
+  co::Scheduler::this_thread().schedule(feed_window);
+  co::Scheduler::this_thread().run();
+
+  receive_all();
+  EXPECT_EQ(client.response(1).body, std::string(25, 'x'));
+  EXPECT_TRUE(client.response(1).complete);
+}
+
+}
+}
@@ -0,0 +1,149 @@
+#include "lw/http/internal/http2_frame.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace lw::http::internal {
+namespace {
+
+void append_uint16(std::string& out, std::uint16_t value) {
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+void append_uint24(std::string& out, std::uint32_t value) {
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+void append_uint32(std::string& out, std::uint32_t value) {
+  append_uint16(out, static_cast<std::uint16_t>(value >> 16));
+  append_uint16(out, static_cast<std::uint16_t>(value));
+}
+
+void append_frame_header(
+  std::string& out,
+  std::uint32_t length,
+  Http2FrameType type,
+  std::uint8_t flags,
+  std::uint32_t stream_id
+) {
+  append_uint24(out, length);
+  out.push_back(static_cast<char>(type));
+  out.push_back(static_cast<char>(flags));
+  append_uint32(out, stream_id & 0x7fffffff);
+}
+
+std::uint8_t byte_at(std::string_view data, std::size_t i) {
+  return static_cast<std::uint8_t>(data[i]);
+}
+
+}
+
+Http2FrameHeader parse_frame_header(std::string_view data) {
+  return {
+    .length = static_cast<std::uint32_t>(
+      (byte_at(data, 0) << 16) | (byte_at(data, 1) << 8) | byte_at(data, 2)
+    ),
+    .type = static_cast<Http2FrameType>(byte_at(data, 3)),
+    .flags = byte_at(data, 4),
+    .stream_id = read_uint31(data.substr(5))
+  };
+}
+
+std::uint32_t read_uint31(std::string_view data) {
+  return (
+    (static_cast<std::uint32_t>(byte_at(data, 0) & 0x7f) << 24) |
+    (static_cast<std::uint32_t>(byte_at(data, 1)) << 16) |
+    (static_cast<std::uint32_t>(byte_at(data, 2)) << 8) |
+    static_cast<std::uint32_t>(byte_at(data, 3))
+  );
+}
+
+void append_frame(
+  std::string& out,
+  Http2FrameType type,
+  std::uint8_t flags,
+  std::uint32_t stream_id,
+  std::string_view payload
+) {
+  append_frame_header(
+    out,
+    static_cast<std::uint32_t>(payload.size()),
+    type,
+    flags,
+    stream_id
+  );
+  out.append(payload);
+}
+
+void append_settings_frame(
+  std::string& out,
+  std::initializer_list<std::pair<Http2Setting, std::uint32_t>> settings
+) {
+  append_frame_header(
+    out,
+    static_cast<std::uint32_t>(settings.size() * 6),
+    Http2FrameType::SETTINGS,
+    0,
+    0
+  );
+  for (const auto& [id, value] : settings) {
+    append_uint16(out, static_cast<std::uint16_t>(id));
+    append_uint32(out, value);
+  }
+}
+
+void append_window_update_frame(
+  std::string& out,
+  std::uint32_t stream_id,
+  std::uint32_t increment
+) {
+  append_frame_header(out, 4, Http2FrameType::WINDOW_UPDATE, 0, stream_id);
+  append_uint32(out, increment & 0x7fffffff);
+}
+
+void append_rst_stream_frame(
+  std::string& out,
+  std::uint32_t stream_id,
+  Http2Error error
+) {
+  append_frame_header(out, 4, Http2FrameType::RST_STREAM, 0, stream_id);
+  append_uint32(out, static_cast<std::uint32_t>(error));
+}
+
+void append_goaway_frame(
+  std::string& out,
+  std::uint32_t last_stream_id,
+  Http2Error error
+) {
+  append_frame_header(out, 8, Http2FrameType::GOAWAY, 0, 0);
+  append_uint32(out, last_stream_id & 0x7fffffff);
+  append_uint32(out, static_cast<std::uint32_t>(error));
+}
+
+void append_header_frames(
+  std::string& out,
+  std::uint32_t stream_id,
+  std::string_view header_block,
+  bool end_stream,
+  std::uint32_t max_frame_size
+) {
+  Http2FrameType type = Http2FrameType::HEADERS;
+  std::uint8_t flags = end_stream ? http2_flags::END_STREAM : 0;
+  do {
+    const std::size_t size =
+      std::min<std::size_t>(header_block.size(), max_frame_size);
+    if (size == header_block.size()) flags |= http2_flags::END_HEADERS;
+    append_frame(out, type, flags, stream_id, header_block.substr(0, size));
+    header_block.remove_prefix(size);
+    type = Http2FrameType::CONTINUATION;
+    flags = 0;
+  } while (!header_block.empty());
+}
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace lw::http::internal {
+
+/**
+ * What every HTTP/2 client sends first, followed by a SETTINGS frame. Seeing
+ * it at the start of a plaintext connection is how prior knowledge of HTTP/2
+ * (h2c) is detected.
+ */
+constexpr std::string_view HTTP2_PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+constexpr std::size_t HTTP2_FRAME_HEADER_SIZE = 9;
+constexpr std::uint32_t HTTP2_DEFAULT_MAX_FRAME_SIZE = 16 * 1024;
+constexpr std::uint32_t HTTP2_MAX_FRAME_SIZE_LIMIT = (1 << 24) - 1;
+constexpr std::int64_t HTTP2_DEFAULT_WINDOW_SIZE = 65'535;
+constexpr std::int64_t HTTP2_MAX_WINDOW_SIZE = (1ll << 31) - 1;
+
+enum class Http2FrameType: std::uint8_t {
+  DATA          = 0x0,
+  HEADERS       = 0x1,
+  PRIORITY      = 0x2,
+  RST_STREAM    = 0x3,
+  SETTINGS      = 0x4,
+  PUSH_PROMISE  = 0x5,
+  PING          = 0x6,
+  GOAWAY        = 0x7,
+  WINDOW_UPDATE = 0x8,
+  CONTINUATION  = 0x9
+};
+
+namespace http2_flags {
+
+constexpr std::uint8_t END_STREAM  = 0x01;
+constexpr std::uint8_t ACK         = 0x01;
+constexpr std::uint8_t END_HEADERS = 0x04;
+constexpr std::uint8_t PADDED      = 0x08;
+constexpr std::uint8_t PRIORITY    = 0x20;
+
+}
+
+enum class Http2Setting: std::uint16_t {
+  HEADER_TABLE_SIZE      = 0x1,
+  ENABLE_PUSH            = 0x2,
+  MAX_CONCURRENT_STREAMS = 0x3,
+  INITIAL_WINDOW_SIZE    = 0x4,
+  MAX_FRAME_SIZE         = 0x5,
+  MAX_HEADER_LIST_SIZE   = 0x6
+};
+
+enum class Http2Error: std::uint32_t {
+  NO_ERROR            = 0x0,
+  PROTOCOL_ERROR      = 0x1,
+  INTERNAL_ERROR      = 0x2,
+  FLOW_CONTROL_ERROR  = 0x3,
+  SETTINGS_TIMEOUT    = 0x4,
+  STREAM_CLOSED       = 0x5,
+  FRAME_SIZE_ERROR    = 0x6,
+  REFUSED_STREAM      = 0x7,
+  CANCEL              = 0x8,
+  COMPRESSION_ERROR   = 0x9,
+  CONNECT_ERROR       = 0xa,
+  ENHANCE_YOUR_CALM   = 0xb,
+  INADEQUATE_SECURITY = 0xc,
+  HTTP_1_1_REQUIRED   = 0xd
+};
+
+struct Http2FrameHeader {
+  std::uint32_t length = 0;
+  Http2FrameType type = Http2FrameType::DATA;
+  std::uint8_t flags = 0;
+  std::uint32_t stream_id = 0;
+
+  bool has_flag(std::uint8_t flag) const { return flags & flag; }
+};
+
+/**
+ * Parses the first `HTTP2_FRAME_HEADER_SIZE` bytes of `data`.
+ */
+Http2FrameHeader parse_frame_header(std::string_view data);
+
+/**
+ * Reads a big-endian 32-bit integer from the first four bytes of `data`, with
+ * the reserved top bit cleared.
+ */
+std::uint32_t read_uint31(std::string_view data);
+
+/**
+ * Appends a frame header followed by `payload`, which must not be longer than
+ * the peer's maximum frame size.
+ */
+void append_frame(
+  std::string& out,
+  Http2FrameType type,
+  std::uint8_t flags,
+  std::uint32_t stream_id,
+  std::string_view payload = {}
+);
+
+/**
+ * Appends a SETTINGS frame holding each of `settings` in turn.
+ */
+void append_settings_frame(
+  std::string& out,
+  std::initializer_list<std::pair<Http2Setting, std::uint32_t>> settings
+);
+
+void append_window_update_frame(
+  std::string& out,
+  std::uint32_t stream_id,
+  std::uint32_t increment
+);
+
+void append_rst_stream_frame(
+  std::string& out,
+  std::uint32_t stream_id,
+  Http2Error error
+);
+
+void append_goaway_frame(
+  std::string& out,
+  std::uint32_t last_stream_id,
+  Http2Error error
+);
+
+/**
+ * Appends a header block, split into a HEADERS frame and as many CONTINUATION
+ * frames as needed to keep each under `max_frame_size`.
+ */
+void append_header_frames(
+  std::string& out,
+  std::uint32_t stream_id,
+  std::string_view header_block,
+  bool end_stream,
+  std::uint32_t max_frame_size
+);
+
+}
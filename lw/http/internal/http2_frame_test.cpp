@@ -0,0 +1,80 @@
+#include "lw/http/internal/http2_frame.h"
+
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+
+namespace lw::http::internal {
+namespace {
+
+TEST(Http2Frame, RoundTripsHeaders) {
+  std::string out;
+  append_frame(
+    out,
+    Http2FrameType::DATA,
+    http2_flags::END_STREAM,
+    0x80000005,
+    "hello"
+  );
+  ASSERT_EQ(out.size(), HTTP2_FRAME_HEADER_SIZE + 5);
+
+  Http2FrameHeader header = parse_frame_header(out);
+  EXPECT_EQ(header.length, 5u);
+  EXPECT_EQ(header.type, Http2FrameType::DATA);
+  EXPECT_TRUE(header.has_flag(http2_flags::END_STREAM));
+  EXPECT_FALSE(header.has_flag(http2_flags::PADDED));
+  // The reserved bit is never sent.
+  EXPECT_EQ(header.stream_id, 5u);
+  EXPECT_EQ(out.substr(HTTP2_FRAME_HEADER_SIZE), "hello");
+}
+
+TEST(Http2Frame, EncodesSettings) {
+  std::string out;
+  append_settings_frame(out, {
+    {Http2Setting::MAX_CONCURRENT_STREAMS, 100},
+    {Http2Setting::INITIAL_WINDOW_SIZE, 1 << 20}
+  });
+  EXPECT_EQ(
+    out,
+    std::string_view(
+      "\x00\x00\x0c\x04\x00\x00\x00\x00\x00"
+      "\x00\x03\x00\x00\x00\x64"
+      "\x00\x04\x00\x10\x00\x00",
+      21
+    )
+  );
+}
+
+TEST(Http2Frame, SplitsLargeHeaderBlocks) {
+  std::string out;
+  const std::string block(25, 'x');
+  append_header_frames(out, 3, block, /*end_stream=*/true, 10);
+
+  std::string_view frames = out;
+  std::string reassembled;
+  int count = 0;
+  while (!frames.empty()) {
+    Http2FrameHeader header = parse_frame_header(frames);
+    EXPECT_EQ(header.stream_id, 3u);
+    EXPECT_LE(header.length, 10u);
+    EXPECT_EQ(
+      header.type,
+      count == 0 ? Http2FrameType::HEADERS : Http2FrameType::CONTINUATION
+    );
+    // END_STREAM belongs on the HEADERS frame, END_HEADERS on the last one.
+    EXPECT_EQ(header.has_flag(http2_flags::END_STREAM), count == 0);
+    EXPECT_EQ(
+      header.has_flag(http2_flags::END_HEADERS),
+      frames.size() == HTTP2_FRAME_HEADER_SIZE + header.length
+    );
+    reassembled.append(frames.substr(HTTP2_FRAME_HEADER_SIZE, header.length));
+    frames.remove_prefix(HTTP2_FRAME_HEADER_SIZE + header.length);
+    ++count;
+  }
+  EXPECT_EQ(count, 3);
+  EXPECT_EQ(reassembled, block);
+}
+
+}
+}
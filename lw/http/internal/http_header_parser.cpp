@@ -0,0 +1,118 @@
+#include "lw/http/internal/http_header_parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <experimental/source_location>
+#include <string_view>
+#include <utility>
+
+#include "lw/base/strings.h"
+#include "lw/err/canonical.h"
+#include "lw/err/macros.h"
+#include "lw/http/headers.h"
+
+namespace lw::http::internal {
+namespace {
+
+using std::experimental::source_location;
+
+/**
+ * Asserts that the given position is inside the header and not a newline
+ * character.
+ *
+ * @throw InvalidArgument
+ *  If the position given by `i` is outside the header.
+ * @throw InvalidArgument
+ *  If the character at given position is either carriage return (`\r`) or
+ *  newline (`\n`).
+ */
+void check_not_line_end(
+  std::string_view header_view,
+  std::size_t i,
+  std::string_view expected,
+  const source_location& loc = source_location::current()
+) {
+  if (i >= header_view.size()) {
+    throw InvalidArgument(loc)
+      << "Unexpected end of input at position " << i << "; expected "
+      << expected;
+  }
+
+  if (header_view.at(i) == '\r' || header_view.at(i) == '\n') {
+    throw InvalidArgument(loc)
+      << "Unexpected end of line at position " << i << "; expected "
+      << expected;
+  }
+}
+
+}
+
+std::pair<std::string_view, std::string_view> parse_header_line(
+  std::string_view* header_view
+) {
+  LW_CHECK_NULL(header_view);
+  std::size_t i = 0;
+  for (; i < header_view->size() && header_view->at(i) != ':'; ++i) {
+    check_not_line_end(*header_view, i, "':'");
+  }
+  if (i >= header_view->size()) {
+    throw InvalidArgument() << "Unexpected end of header at position " << i;
+  }
+  const std::size_t colon_pos = i++;
+
+  for (; i < header_view->size() && std::isspace(header_view->at(i)); ++i) {
+    if (header_view->at(i) == '\r' || header_view->at(i) == '\n') break;
+  }
+  if (i >= header_view->size()) {
+    throw InvalidArgument() << "Unexpected end of header at position " << i;
+  }
+  const std::size_t value_start = i;
+  const std::size_t value_end = header_view->find("\r\n", i);
+  if (value_end == std::string_view::npos) {
+    throw InvalidArgument() << "Unexpected end of input at position " << i;
+  }
+
+  // TODO(alaina): Trim the right-end of the header value. It could containe
+  // extra spaces before the \r\n which should be ignored.
+
+  auto results = std::make_pair(
+    header_view->substr(0, colon_pos),
+    header_view->substr(value_start, value_end - value_start)
+  );
+  header_view->remove_prefix(value_end + 2);
+  return results;
+}
+
+void parse_header_lines(std::string_view header_view, HeadersView* headers) {
+  LW_CHECK_NULL(headers);
+  while (!header_view.starts_with("\r\n")) {
+    headers->insert(parse_header_line(&header_view));
+  }
+}
+
+bool has_header_token(std::string_view list, std::string_view token) {
+  while (!list.empty()) {
+    const std::size_t end = std::min(list.find(','), list.size());
+    std::string_view item = list.substr(0, end);
+    list.remove_prefix(std::min(end + 1, list.size()));
+    while (!item.empty() && item.front() == ' ') item.remove_prefix(1);
+    while (!item.empty() && item.back() == ' ') item.remove_suffix(1);
+    if (CaseInsensitiveEqual()(item, token)) return true;
+  }
+  return false;
+}
+
+std::size_t parse_content_length(std::string_view value) {
+  std::size_t length = 0;
+  auto res = std::from_chars(value.begin(), value.end(), length);
+  if (value.empty() || res.ec != std::errc{} || res.ptr != value.end()) {
+    throw InvalidArgument()
+      << "Invalid Content-Length \"" << value
+      << "\"; expected a positive integer.";
+  }
+  return length;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+#include "lw/http/headers.h"
+
+namespace lw::http::internal {
+
+/**
+ * Parses the line as an HTTP header, returning the Key-Value pair and adjusting
+ * the header view to after the line.
+ *
+ * @throw InvalidArgument
+ *  If the end of the input is found before a proper header line is parsed.
+ *
+ * @param header_view
+ *  A point to a string view containing an HTTP header. This view will be
+ *  trimmed to exclude the parsed header line.
+ *
+ * @return
+ *  The Key-Value pair parsed from the line of header.
+ */
+std::pair<std::string_view, std::string_view> parse_header_line(
+  std::string_view* header_view
+);
+
+/**
+ * Parses every header line up to the empty line which ends the header. The
+ * parsed names and values are views into `header_view`.
+ *
+ * @throw InvalidArgument
+ *  If any line is malformed or the empty line is missing.
+ */
+void parse_header_lines(std::string_view header_view, HeadersView* headers);
+
+/**
+ * Returns true if the comma separated header value lists `token`, ignoring
+ * case, such as "upgrade" in "keep-alive, Upgrade".
+ */
+bool has_header_token(std::string_view list, std::string_view token);
+
+/**
+ * Parses the value of a Content-Length header.
+ *
+ * @throw InvalidArgument
+ *  If the value is not a non-negative integer.
+ */
+std::size_t parse_content_length(std::string_view value);
+
+}
@@ -0,0 +1,54 @@
+#include "lw/http/internal/http_header_parser.h"
+
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/http/headers.h"
+
+namespace lw::http::internal {
+namespace {
+
+TEST(HttpHeaderParser, ParsesLinesUntilTheEmptyLine) {
+  HeadersView headers;
+  parse_header_lines(
+    "Content-Length: 5\r\n"
+    "Connection:keep-alive\r\n"
+    "\r\n"
+    "hello",
+    &headers
+  );
+  ASSERT_EQ(headers.size(), 2u);
+  EXPECT_EQ(headers.at("content-length"), "5");
+  EXPECT_EQ(headers.at("Connection"), "keep-alive");
+}
+
+TEST(HttpHeaderParser, RejectsMalformedLines) {
+  HeadersView headers;
+  EXPECT_THROW(
+    parse_header_lines("Content-Length\r\n\r\n", &headers),
+    InvalidArgument
+  );
+  EXPECT_THROW(
+    parse_header_lines("Content-Length: 5\r\n", &headers),
+    InvalidArgument
+  );
+}
+
+TEST(HttpHeaderParser, FindsTokensInLists) {
+  EXPECT_TRUE(has_header_token("keep-alive, Upgrade", "upgrade"));
+  EXPECT_TRUE(has_header_token("close", "close"));
+  EXPECT_FALSE(has_header_token("keep-alive", "close"));
+  EXPECT_FALSE(has_header_token("gzip, chunked-ish", "chunked"));
+}
+
+TEST(HttpHeaderParser, ParsesContentLength) {
+  EXPECT_EQ(parse_content_length("0"), 0u);
+  EXPECT_EQ(parse_content_length("1234"), 1234u);
+  EXPECT_THROW(parse_content_length(""), InvalidArgument);
+  EXPECT_THROW(parse_content_length("-1"), InvalidArgument);
+  EXPECT_THROW(parse_content_length("12a"), InvalidArgument);
+}
+
+}
+}
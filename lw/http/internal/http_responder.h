@@ -0,0 +1,39 @@
+#pragma once
+
+#include "lw/co/future.h"
+#include "lw/http/http_request.h"
+#include "lw/http/http_response.h"
+#include "lw/http/internal/http_response_cache.h"
+#include "lw/io/co/co.h"
+
+namespace lw::http::internal {
+
+/**
+ * Sends the response to one request in the version of HTTP the request came
+ * in, so routing and caching are shared between versions.
+ */
+class HttpResponder {
+public:
+  virtual ~HttpResponder() = default;
+
+  virtual co::Future<void> send(
+    const HttpRequest& request,
+    const HttpResponse& response
+  ) = 0;
+
+  /**
+   * Sends a response from the cache.
+   */
+  virtual co::Future<void> send_cached(
+    const HttpRequest& request,
+    const CachedResponse& cached
+  ) = 0;
+
+  /**
+   * The connection to hand over after a `101 Switching Protocols` response,
+   * or null if the request's version of HTTP cannot switch protocols.
+   */
+  virtual io::CoStream* upgrade() { return nullptr; }
+};
+
+}
@@ -0,0 +1,184 @@
+#include "lw/http/internal/http_response_cache.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "lw/err/canonical.h"
+#include "lw/flags/flags.h"
+#include "lw/http/http_request.h"
+
+LW_FLAG(
+  std::size_t, http_response_cache_size, 64 * 1024 * 1024,
+  "Maximum number of bytes of serialized responses held by each HTTP router's "
+  "response cache."
+);
+
+LW_FLAG(
+  std::size_t, http_response_cache_shards, 16,
+  "Number of independently locked shards in the HTTP response cache."
+);
+
+namespace lw::http::internal {
+namespace {
+
+std::string_view trim(std::string_view str) {
+  const std::size_t start = str.find_first_not_of(" \t");
+  if (start == std::string_view::npos) return {};
+  const std::size_t end = str.find_last_not_of(" \t");
+  return str.substr(start, end - start + 1);
+}
+
+}
+
+std::string make_cache_key(const HttpRequest& request) {
+  std::string key;
+  key.reserve(request.method().size() + request.path().size() + 2);
+  key += request.method();
+  key += ' ';
+  key += request.path();
+
+  // HeadersView is an ordered map, so iterating it yields a canonical order.
+  char separator = '?';
+  for (const auto& [name, value] : request.query_params()) {
+    key += separator;
+    key += name;
+    key += '=';
+    key += value;
+    separator = '&';
+  }
+
+  // Handlers may negotiate the body's format on `Accept`, so clients accepting
+  // different formats get their own entries. Newlines can't appear in paths or
+  // header values, so this can't collide with another key.
+  if (request.has_header("Accept")) {
+    key += "\nAccept: ";
+    key += request.header("Accept");
+  }
+  return key;
+}
+
+std::string make_etag(std::string_view body) {
+  // 64-bit FNV-1a. Cheap to compute and plenty to distinguish versions of the
+  // same resource.
+  std::uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : body) {
+    hash ^= static_cast<std::uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+
+  constexpr char HEX[] = "0123456789abcdef";
+  std::string etag(18, '"');
+  for (int i = 16; i > 0; --i, hash >>= 4) etag[i] = HEX[hash & 0xf];
+  return etag;
+}
+
+bool etag_matches(std::string_view if_none_match, std::string_view etag) {
+  while (!if_none_match.empty()) {
+    const std::size_t comma = if_none_match.find(',');
+    std::string_view candidate = trim(if_none_match.substr(0, comma));
+    if_none_match = comma == std::string_view::npos
+      ? std::string_view{}
+      : if_none_match.substr(comma + 1);
+
+    // If-None-Match uses weak comparison, so the W/ prefix is ignored.
+    if (candidate.starts_with("W/")) candidate.remove_prefix(2);
+    if (candidate == "*" || candidate == etag) return true;
+  }
+  return false;
+}
+
+// -------------------------------------------------------------------------- //
+
+HttpResponseCache::HttpResponseCache(
+  std::size_t max_bytes,
+  std::size_t shard_count
+) {
+  if (shard_count == 0) {
+    throw InvalidArgument() << "HttpResponseCache requires at least one shard.";
+  }
+  _shard_capacity = max_bytes / shard_count;
+  _shards.reserve(shard_count);
+  for (std::size_t i = 0; i < shard_count; ++i) {
+    _shards.push_back(std::make_unique<Shard>());
+  }
+}
+
+SharedCachedResponse HttpResponseCache::find(std::string_view key) {
+  Shard& shard = _shard_for(key);
+  std::lock_guard<std::mutex> lock{shard.mutex};
+
+  auto itr = shard.index.find(key);
+  if (itr == shard.index.end()) {
+    ++_misses;
+    return nullptr;
+  }
+  if (itr->second->response->expires <= CachedResponse::Clock::now()) {
+    _erase(shard, itr->second);
+    ++_misses;
+    return nullptr;
+  }
+
+  shard.lru.splice(shard.lru.begin(), shard.lru, itr->second);
+  ++_hits;
+  return itr->second->response;
+}
+
+void HttpResponseCache::insert(
+  std::string key,
+  SharedCachedResponse response
+) {
+  const std::size_t size = key.size() + response->serialized.size();
+  if (size > _shard_capacity) return;
+
+  Shard& shard = _shard_for(key);
+  std::lock_guard<std::mutex> lock{shard.mutex};
+
+  if (auto itr = shard.index.find(key); itr != shard.index.end()) {
+    _erase(shard, itr->second);
+  }
+  while (shard.bytes + size > _shard_capacity) {
+    _erase(shard, std::prev(shard.lru.end()));
+    ++_evictions;
+  }
+
+  shard.lru.push_front({
+    .key = std::move(key),
+    .response = std::move(response),
+    .size = size
+  });
+  shard.index.insert({shard.lru.front().key, shard.lru.begin()});
+  shard.bytes += size;
+}
+
+HttpResponseCacheStats HttpResponseCache::stats() const {
+  return {
+    .hits = _hits.load(),
+    .misses = _misses.load(),
+    .evictions = _evictions.load()
+  };
+}
+
+std::size_t HttpResponseCache::size_bytes() const {
+  std::size_t total = 0;
+  for (const auto& shard : _shards) {
+    std::lock_guard<std::mutex> lock{shard->mutex};
+    total += shard->bytes;
+  }
+  return total;
+}
+
+HttpResponseCache::Shard& HttpResponseCache::_shard_for(std::string_view key) {
+  return *_shards[std::hash<std::string_view>{}(key) % _shards.size()];
+}
+
+void HttpResponseCache::_erase(Shard& shard, std::list<Entry>::iterator itr) {
+  shard.bytes -= itr->size;
+  shard.index.erase(itr->key);
+  shard.lru.erase(itr);
+}
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "lw/flags/flags.h"
+#include "lw/http/http_request.h"
+#include "lw/memory/buffer.h"
+
+LW_DECLARE_FLAG(std::size_t, http_response_cache_size);
+LW_DECLARE_FLAG(std::size_t, http_response_cache_shards);
+
+namespace lw::http::internal {
+
+/**
+ * A fully serialized HTTP response, ready to be written to a connection.
+ */
+struct CachedResponse {
+  typedef std::chrono::steady_clock Clock;
+
+  Buffer serialized;
+  std::string etag;
+  std::size_t body_size;
+  Clock::time_point expires;
+};
+
+typedef std::shared_ptr<const CachedResponse> SharedCachedResponse;
+
+/**
+ * Counters tracking the effectiveness of an `HttpResponseCache`.
+ */
+struct HttpResponseCacheStats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+};
+
+/**
+ * Builds the cache key for a request from its method, path, query parameters
+ * and `Accept` header. Query parameters are ordered by name so that `?a=1&b=2`
+ * and `?b=2&a=1` share a key.
+ */
+std::string make_cache_key(const HttpRequest& request);
+
+/**
+ * Computes a strong entity tag for the given response body.
+ */
+std::string make_etag(std::string_view body);
+
+/**
+ * Returns true if any of the entity tags listed in an `If-None-Match` header
+ * value matches `etag`.
+ */
+bool etag_matches(std::string_view if_none_match, std::string_view etag);
+
+/**
+ * Size-bounded LRU cache of serialized responses.
+ *
+ * Entries are spread across independently locked shards so concurrent lookups
+ * rarely contend. Each shard receives an equal share of the byte budget and
+ * evicts its least recently used entries once that share is exceeded.
+ */
+class HttpResponseCache {
+public:
+  HttpResponseCache():
+    HttpResponseCache{
+      flags::http_response_cache_size,
+      flags::http_response_cache_shards
+    }
+  {}
+
+  HttpResponseCache(std::size_t max_bytes, std::size_t shard_count);
+
+  HttpResponseCache(const HttpResponseCache&) = delete;
+  HttpResponseCache& operator=(const HttpResponseCache&) = delete;
+
+  /**
+   * Looks up a fresh response for the key. Expired entries are dropped and
+   * reported as misses.
+   *
+   * @return
+   *  The cached response, or `nullptr` if there is no fresh entry.
+   */
+  SharedCachedResponse find(std::string_view key);
+
+  /**
+   * Stores the response under the key, replacing any existing entry. Responses
+   * larger than a single shard's budget are not stored.
+   */
+  void insert(std::string key, SharedCachedResponse response);
+
+  HttpResponseCacheStats stats() const;
+
+  /**
+   * Total bytes of keys and serialized responses currently held.
+   */
+  std::size_t size_bytes() const;
+
+private:
+  struct Entry {
+    std::string key;
+    SharedCachedResponse response;
+    std::size_t size;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    std::size_t bytes = 0;
+  };
+
+  Shard& _shard_for(std::string_view key);
+  void _erase(Shard& shard, std::list<Entry>::iterator itr);
+
+  std::size_t _shard_capacity;
+  std::vector<std::unique_ptr<Shard>> _shards;
+  std::atomic<std::uint64_t> _hits = 0;
+  std::atomic<std::uint64_t> _misses = 0;
+  std::atomic<std::uint64_t> _evictions = 0;
+};
+
+}
@@ -0,0 +1,171 @@
+#include "lw/http/internal/http_response_cache.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/http/http_request.h"
+#include "lw/io/co/testing/string_reader.h"
+
+namespace lw::http::internal {
+namespace {
+
+using ::lw::io::testing::StringReader;
+
+SharedCachedResponse make_response(
+  std::string_view body,
+  std::chrono::milliseconds ttl = std::chrono::minutes{1}
+) {
+  return std::make_shared<const CachedResponse>(CachedResponse{
+    .serialized = Buffer{body.begin(), body.end()},
+    .etag = make_etag(body),
+    .body_size = body.size(),
+    .expires = CachedResponse::Clock::now() + ttl
+  });
+}
+
+std::string key_for(
+  std::string_view request_line,
+  std::string_view headers = ""
+) {
+  std::string key;
+  auto read_key = [&]() -> co::Task {
+    const std::string header =
+      std::string{request_line} + "\r\nHost: test.com\r\n" +
+      std::string{headers} + "\r\n";
+    StringReader input{header};
+    HttpRequest req{input};
+    co_await req.read_header();
+    key = make_cache_key(req);
+  };
+  co::Scheduler::this_thread().schedule(read_key);
+  co::Scheduler::this_thread().run();
+  return key;
+}
+
+TEST(HttpResponseCacheKey, IncludesMethodAndPath) {
+  EXPECT_EQ(key_for("GET /foo/bar HTTP/1.1"), "GET /foo/bar");
+  EXPECT_NE(
+    key_for("GET /foo/bar HTTP/1.1"),
+    key_for("GET /foo/baz HTTP/1.1")
+  );
+}
+
+TEST(HttpResponseCacheKey, QueryParamsAreOrderIndependent) {
+  EXPECT_EQ(
+    key_for("GET /foo?b=2&a=1 HTTP/1.1"),
+    key_for("GET /foo?a=1&b=2 HTTP/1.1")
+  );
+  EXPECT_NE(
+    key_for("GET /foo?a=1 HTTP/1.1"),
+    key_for("GET /foo?a=2 HTTP/1.1")
+  );
+}
+
+TEST(HttpResponseCacheKey, IncludesAccept) {
+  EXPECT_EQ(
+    key_for("GET /foo HTTP/1.1", "Accept: application/cbor\r\n"),
+    "GET /foo\nAccept: application/cbor"
+  );
+  EXPECT_NE(
+    key_for("GET /foo HTTP/1.1", "Accept: application/cbor\r\n"),
+    key_for("GET /foo HTTP/1.1", "Accept: application/json\r\n")
+  );
+}
+
+TEST(HttpResponseCacheETag, IsQuotedAndStable) {
+  const std::string etag = make_etag("hello");
+  EXPECT_EQ(etag.size(), 18);
+  EXPECT_EQ(etag.front(), '"');
+  EXPECT_EQ(etag.back(), '"');
+  EXPECT_EQ(etag, make_etag("hello"));
+  EXPECT_NE(etag, make_etag("hello!"));
+}
+
+TEST(HttpResponseCacheETag, MatchesIfNoneMatchLists) {
+  const std::string etag = make_etag("hello");
+  EXPECT_TRUE(etag_matches(etag, etag));
+  EXPECT_TRUE(etag_matches("*", etag));
+  EXPECT_TRUE(etag_matches("\"nope\", " + etag, etag));
+  EXPECT_TRUE(etag_matches("W/" + etag, etag));
+  EXPECT_FALSE(etag_matches("\"nope\"", etag));
+  EXPECT_FALSE(etag_matches("", etag));
+}
+
+TEST(HttpResponseCache, FindsInsertedResponses) {
+  HttpResponseCache cache{1024, 1};
+  EXPECT_EQ(cache.find("GET /foo"), nullptr);
+
+  cache.insert("GET /foo", make_response("foo"));
+  auto cached = cache.find("GET /foo");
+  ASSERT_NE(cached, nullptr);
+  EXPECT_EQ(static_cast<std::string_view>(cached->serialized), "foo");
+  EXPECT_EQ(cached->etag, make_etag("foo"));
+
+  HttpResponseCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+}
+
+TEST(HttpResponseCache, ReplacesExistingEntries) {
+  HttpResponseCache cache{1024, 1};
+  cache.insert("GET /foo", make_response("foo"));
+  cache.insert("GET /foo", make_response("bar"));
+
+  auto cached = cache.find("GET /foo");
+  ASSERT_NE(cached, nullptr);
+  EXPECT_EQ(static_cast<std::string_view>(cached->serialized), "bar");
+  EXPECT_EQ(cache.size_bytes(), std::string_view{"GET /foo"}.size() + 3);
+}
+
+TEST(HttpResponseCache, ExpiredEntriesAreMisses) {
+  HttpResponseCache cache{1024, 1};
+  cache.insert("GET /foo", make_response("foo", std::chrono::milliseconds{-1}));
+  EXPECT_EQ(cache.find("GET /foo"), nullptr);
+  EXPECT_EQ(cache.size_bytes(), 0);
+  EXPECT_EQ(cache.stats().misses, 1);
+}
+
+TEST(HttpResponseCache, EvictsLeastRecentlyUsed) {
+  // Each entry is a 1-byte key and 9-byte body, so three fit.
+  HttpResponseCache cache{30, 1};
+  cache.insert("a", make_response("123456789"));
+  cache.insert("b", make_response("123456789"));
+  cache.insert("c", make_response("123456789"));
+
+  // Touch "a" so "b" becomes the oldest.
+  EXPECT_NE(cache.find("a"), nullptr);
+  cache.insert("d", make_response("123456789"));
+
+  EXPECT_NE(cache.find("a"), nullptr);
+  EXPECT_EQ(cache.find("b"), nullptr);
+  EXPECT_NE(cache.find("c"), nullptr);
+  EXPECT_NE(cache.find("d"), nullptr);
+  EXPECT_EQ(cache.stats().evictions, 1);
+  EXPECT_EQ(cache.size_bytes(), 30);
+}
+
+TEST(HttpResponseCache, SkipsResponsesLargerThanShard) {
+  HttpResponseCache cache{16, 2};
+  cache.insert("a", make_response("123456789"));
+  EXPECT_EQ(cache.find("a"), nullptr);
+  EXPECT_EQ(cache.size_bytes(), 0);
+}
+
+TEST(HttpResponseCache, EvictedEntriesStayAliveWhileReferenced) {
+  HttpResponseCache cache{10, 1};
+  cache.insert("a", make_response("123456789"));
+  auto held = cache.find("a");
+  cache.insert("b", make_response("123456789"));
+
+  EXPECT_EQ(cache.find("a"), nullptr);
+  ASSERT_NE(held, nullptr);
+  EXPECT_EQ(static_cast<std::string_view>(held->serialized), "123456789");
+}
+
+}
+}
@@ -0,0 +1,224 @@
+#include "lw/http/internal/websocket_deflate.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <zlib.h>
+
+#include "lw/base/strings.h"
+#include "lw/err/canonical.h"
+
+namespace lw::http::internal {
+namespace {
+
+constexpr std::string_view PERMESSAGE_DEFLATE = "permessage-deflate";
+
+// RFC 7692 has senders drop this empty stored block from the end of every
+// message, and receivers put it back before inflating.
+constexpr std::string_view EMPTY_BLOCK_TAIL{"\x00\x00\xff\xff", 4};
+
+constexpr std::size_t COMPRESS_CHUNK_SIZE = 16 * 1024;
+
+std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+/**
+ * Splits the next `separator` delimited item off the front of `str`.
+ */
+std::string_view next_item(std::string_view& str, char separator) {
+  const std::size_t end = str.find(separator);
+  const std::string_view item = trim(str.substr(0, end));
+  str.remove_prefix(end == std::string_view::npos ? str.size() : end + 1);
+  return item;
+}
+
+std::optional<int> parse_window_bits(std::string_view value) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  int bits = 0;
+  auto [end, err] =
+    std::from_chars(value.data(), value.data() + value.size(), bits);
+  if (err != std::errc{} || end != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  if (bits < 8 || bits > 15) return std::nullopt;
+  return bits;
+}
+
+/**
+ * Checks the parameters of one permessage-deflate offer.
+ */
+std::optional<WebSocketDeflateParams> accept_offer(std::string_view params) {
+  WebSocketDeflateParams accepted;
+  bool seen_server_no_context = false;
+  bool seen_client_no_context = false;
+  bool seen_server_bits = false;
+  bool seen_client_bits = false;
+  while (!params.empty()) {
+    std::string_view param = next_item(params, ';');
+    const std::size_t equals = param.find('=');
+    const std::string_view name = trim(param.substr(0, equals));
+    const std::optional<std::string_view> value =
+      equals == std::string_view::npos
+        ? std::nullopt
+        : std::optional{trim(param.substr(equals + 1))};
+
+    // Parameters may only be given once per offer.
+    if (name == "server_no_context_takeover" && !value) {
+      if (std::exchange(seen_server_no_context, true)) return std::nullopt;
+    } else if (name == "client_no_context_takeover" && !value) {
+      if (std::exchange(seen_client_no_context, true)) return std::nullopt;
+    } else if (name == "server_max_window_bits" && value) {
+      if (std::exchange(seen_server_bits, true)) return std::nullopt;
+      std::optional<int> bits = parse_window_bits(*value);
+      // zlib cannot make raw deflate streams with a 256 byte window.
+      if (!bits || *bits == 8) return std::nullopt;
+      accepted.server_window_bits = *bits;
+    } else if (name == "client_max_window_bits") {
+      // The client's window only needs to fit in the inflater's, which is
+      // always the largest allowed.
+      if (std::exchange(seen_client_bits, true)) return std::nullopt;
+      if (value && !parse_window_bits(*value)) return std::nullopt;
+    } else {
+      return std::nullopt;
+    }
+  }
+  return accepted;
+}
+
+}
+
+std::optional<WebSocketDeflateParams> negotiate_websocket_deflate(
+  std::string_view extensions
+) {
+  while (!extensions.empty()) {
+    std::string_view offer = next_item(extensions, ',');
+    const std::string_view name = next_item(offer, ';');
+    if (!CaseInsensitiveEqual()(name, PERMESSAGE_DEFLATE)) continue;
+    if (std::optional<WebSocketDeflateParams> params = accept_offer(offer)) {
+      return params;
+    }
+  }
+  return std::nullopt;
+}
+
+std::string websocket_deflate_response(const WebSocketDeflateParams& params) {
+  std::string response{PERMESSAGE_DEFLATE};
+  response += "; server_no_context_takeover";
+  if (params.server_window_bits < 15) {
+    response += "; server_max_window_bits=";
+    response += std::to_string(params.server_window_bits);
+  }
+  return response;
+}
+
+WebSocketDeflater::WebSocketDeflater(int window_bits): _stream{} {
+  // Negative window bits make zlib write raw deflate, without its own header.
+  const int result = ::deflateInit2(
+    &_stream,
+    Z_DEFAULT_COMPRESSION,
+    Z_DEFLATED,
+    -window_bits,
+    8,
+    Z_DEFAULT_STRATEGY
+  );
+  if (result != Z_OK) {
+    throw Internal() << "Failed to initialize deflate: " << result;
+  }
+}
+
+WebSocketDeflater::~WebSocketDeflater() {
+  ::deflateEnd(&_stream);
+}
+
+std::string WebSocketDeflater::compress(std::string_view message) {
+  std::string out;
+  _stream.next_in =
+    reinterpret_cast<Bytef*>(const_cast<char*>(message.data()));
+  _stream.avail_in = static_cast<uInt>(message.size());
+  do {
+    const std::size_t offset = out.size();
+    out.resize(offset + COMPRESS_CHUNK_SIZE);
+    _stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+    _stream.avail_out = COMPRESS_CHUNK_SIZE;
+    const int result = ::deflate(&_stream, Z_SYNC_FLUSH);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      throw Internal() << "Failed to deflate WebSocket message: " << result;
+    }
+    out.resize(out.size() - _stream.avail_out);
+  } while (_stream.avail_out == 0);
+
+  // No context is kept between messages, so each can be sent to any client.
+  ::deflateReset(&_stream);
+  if (out.ends_with(EMPTY_BLOCK_TAIL)) {
+    out.resize(out.size() - EMPTY_BLOCK_TAIL.size());
+  }
+  return out;
+}
+
+WebSocketInflater::WebSocketInflater(): _stream{} {
+  const int result = ::inflateInit2(&_stream, -15);
+  if (result != Z_OK) {
+    throw Internal() << "Failed to initialize inflate: " << result;
+  }
+}
+
+WebSocketInflater::~WebSocketInflater() {
+  ::inflateEnd(&_stream);
+}
+
+void WebSocketInflater::decompress(
+  std::string_view message,
+  std::string& out,
+  std::size_t limit
+) {
+  for (std::string_view input : {message, EMPTY_BLOCK_TAIL}) {
+    _stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    _stream.avail_in = static_cast<uInt>(input.size());
+    bool output_full = false;
+    while (_stream.avail_in > 0 || output_full) {
+      // Room for one byte past the limit shows whether the message is over.
+      const std::size_t offset = out.size();
+      const std::size_t chunk =
+        std::min(COMPRESS_CHUNK_SIZE, limit + 1 - offset);
+      out.resize(offset + chunk);
+      _stream.next_out = reinterpret_cast<Bytef*>(out.data() + offset);
+      _stream.avail_out = static_cast<uInt>(chunk);
+      const int result = ::inflate(&_stream, Z_SYNC_FLUSH);
+      output_full = _stream.avail_out == 0;
+      out.resize(out.size() - _stream.avail_out);
+      if (out.size() > limit) {
+        throw ResourceExhausted()
+          << "WebSocket message inflates to more than " << limit << " bytes.";
+      }
+
+      if (result == Z_STREAM_END) {
+        // The client ended its deflate stream with this message, so the next
+        // one starts a new stream.
+        ::inflateReset(&_stream);
+        return;
+      }
+      if (result == Z_BUF_ERROR && !output_full) break;
+      if (result != Z_OK && result != Z_BUF_ERROR) {
+        throw InvalidArgument()
+          << "Invalid deflate data in WebSocket message: " << result;
+      }
+    }
+  }
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <zlib.h>
+
+namespace lw::http::internal {
+
+/**
+ * The permessage-deflate extension (RFC 7692) as agreed with a client.
+ *
+ * The server never carries compression context between messages, so a message
+ * compressed once can be sent to every client which agreed to the extension.
+ */
+struct WebSocketDeflateParams {
+  /**
+   * Window size, in bits, the server compresses with.
+   */
+  int server_window_bits = 15;
+};
+
+/**
+ * Picks the first permessage-deflate offer in a `Sec-WebSocket-Extensions`
+ * request header which the server can accept.
+ *
+ * @return
+ *  The agreed parameters, or nothing if no offer was acceptable.
+ */
+std::optional<WebSocketDeflateParams> negotiate_websocket_deflate(
+  std::string_view extensions
+);
+
+/**
+ * The `Sec-WebSocket-Extensions` response header value accepting `params`.
+ */
+std::string websocket_deflate_response(const WebSocketDeflateParams& params);
+
+class WebSocketDeflater {
+public:
+  explicit WebSocketDeflater(int window_bits = 15);
+  ~WebSocketDeflater();
+
+  WebSocketDeflater(const WebSocketDeflater&) = delete;
+  WebSocketDeflater& operator=(const WebSocketDeflater&) = delete;
+
+  /**
+   * Compresses one whole message, without the trailing empty block RFC 7692
+   * has senders remove.
+   */
+  std::string compress(std::string_view message);
+
+private:
+  ::z_stream _stream;
+};
+
+class WebSocketInflater {
+public:
+  WebSocketInflater();
+  ~WebSocketInflater();
+
+  WebSocketInflater(const WebSocketInflater&) = delete;
+  WebSocketInflater& operator=(const WebSocketInflater&) = delete;
+
+  /**
+   * Decompresses one whole message into `out`. Clients may carry compression
+   * context between messages, so messages must be given in order.
+   *
+   * @throw InvalidArgument
+   *  If the message is not valid deflate data.
+   *
+   * @throw ResourceExhausted
+   *  If the message decompresses to more than `limit` bytes.
+   */
+  void decompress(
+    std::string_view message,
+    std::string& out,
+    std::size_t limit
+  );
+
+private:
+  ::z_stream _stream;
+};
+
+}
@@ -0,0 +1,111 @@
+#include "lw/http/internal/websocket_deflate.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+
+namespace lw::http::internal {
+namespace {
+
+TEST(WebSocketDeflate, NegotiatesFirstAcceptableOffer) {
+  std::optional<WebSocketDeflateParams> params = negotiate_websocket_deflate(
+    "x-webkit-deflate-frame, "
+    "permessage-deflate; server_max_window_bits=8, "
+    "permessage-deflate; client_max_window_bits"
+  );
+  ASSERT_TRUE(params);
+  EXPECT_EQ(params->server_window_bits, 15);
+  EXPECT_EQ(
+    websocket_deflate_response(*params),
+    "permessage-deflate; server_no_context_takeover"
+  );
+}
+
+TEST(WebSocketDeflate, HonorsServerWindowBits) {
+  std::optional<WebSocketDeflateParams> params = negotiate_websocket_deflate(
+    "permessage-deflate; server_max_window_bits=\"10\"; "
+    "server_no_context_takeover"
+  );
+  ASSERT_TRUE(params);
+  EXPECT_EQ(params->server_window_bits, 10);
+  EXPECT_EQ(
+    websocket_deflate_response(*params),
+    "permessage-deflate; server_no_context_takeover; server_max_window_bits=10"
+  );
+}
+
+TEST(WebSocketDeflate, DeclinesInvalidOffers) {
+  EXPECT_FALSE(negotiate_websocket_deflate(""));
+  EXPECT_FALSE(negotiate_websocket_deflate("x-webkit-deflate-frame"));
+  EXPECT_FALSE(negotiate_websocket_deflate("permessage-deflate; foo"));
+  EXPECT_FALSE(negotiate_websocket_deflate(
+    "permessage-deflate; server_max_window_bits=16"
+  ));
+  EXPECT_FALSE(negotiate_websocket_deflate(
+    "permessage-deflate; client_no_context_takeover; "
+    "client_no_context_takeover"
+  ));
+}
+
+TEST(WebSocketDeflate, InflatesRfcExamples) {
+  // Examples from RFC 7692 section 7.2.3, the second reusing the first's
+  // compression context.
+  WebSocketInflater inflater;
+  std::string first;
+  inflater.decompress(
+    std::string_view{"\xf2\x48\xcd\xc9\xc9\x07\x00", 7},
+    first,
+    1024
+  );
+  EXPECT_EQ(first, "Hello");
+
+  std::string second;
+  inflater.decompress(
+    std::string_view{"\xf2\x00\x11\x00\x00", 5},
+    second,
+    1024
+  );
+  EXPECT_EQ(second, "Hello");
+}
+
+TEST(WebSocketDeflate, RoundTripsMessages) {
+  WebSocketDeflater deflater;
+  WebSocketInflater inflater;
+  std::string message;
+  for (int i = 0; i < 10'000; ++i) message += "update " + std::to_string(i);
+
+  for (int i = 0; i < 3; ++i) {
+    const std::string compressed = deflater.compress(message);
+    EXPECT_LT(compressed.size(), message.size() / 2);
+    std::string out;
+    inflater.decompress(compressed, out, message.size());
+    EXPECT_EQ(out, message);
+  }
+}
+
+TEST(WebSocketDeflate, LimitsInflatedSize) {
+  WebSocketDeflater deflater;
+  const std::string compressed = deflater.compress(std::string(100'000, 'a'));
+
+  WebSocketInflater inflater;
+  std::string out;
+  EXPECT_THROW(
+    inflater.decompress(compressed, out, 1'000),
+    ResourceExhausted
+  );
+}
+
+TEST(WebSocketDeflate, RejectsCorruptData) {
+  WebSocketInflater inflater;
+  std::string out;
+  EXPECT_THROW(
+    inflater.decompress(std::string_view{"\xff\xff\xff\xff", 4}, out, 1024),
+    InvalidArgument
+  );
+}
+
+}
+}
@@ -0,0 +1,159 @@
+#include "lw/http/internal/websocket_frame.h"
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lw/err/canonical.h"
+
+namespace lw::http::internal {
+namespace {
+
+constexpr std::uint8_t FIN_BIT = 0x80;
+constexpr std::uint8_t RSV1_BIT = 0x40;
+constexpr std::uint8_t RSV2_BIT = 0x20;
+constexpr std::uint8_t RSV3_BIT = 0x10;
+constexpr std::uint8_t MASK_BIT = 0x80;
+
+std::uint8_t byte_at(std::string_view data, std::size_t i) {
+  return static_cast<std::uint8_t>(data[i]);
+}
+
+}
+
+std::optional<WebSocketFrameHeader> parse_websocket_frame_header(
+  std::string_view data
+) {
+  if (data.size() < 2) return std::nullopt;
+
+  WebSocketFrameHeader header{
+    .fin = static_cast<bool>(byte_at(data, 0) & FIN_BIT),
+    .rsv1 = static_cast<bool>(byte_at(data, 0) & RSV1_BIT),
+    .rsv2 = static_cast<bool>(byte_at(data, 0) & RSV2_BIT),
+    .rsv3 = static_cast<bool>(byte_at(data, 0) & RSV3_BIT),
+    .opcode = static_cast<WebSocketOpcode>(byte_at(data, 0) & 0x0f),
+    .masked = static_cast<bool>(byte_at(data, 1) & MASK_BIT),
+    .payload_length = static_cast<std::uint64_t>(byte_at(data, 1) & 0x7f),
+    .size = 2
+  };
+
+  // Lengths of 126 and 127 mean the real length follows in 2 or 8 bytes.
+  std::size_t length_bytes = 0;
+  if (header.payload_length == 126) length_bytes = 2;
+  else if (header.payload_length == 127) length_bytes = 8;
+  const std::size_t size = 2 + length_bytes + (header.masked ? 4 : 0);
+  if (data.size() < size) return std::nullopt;
+
+  if (length_bytes > 0) {
+    header.payload_length = 0;
+    for (std::size_t i = 0; i < length_bytes; ++i) {
+      header.payload_length =
+        (header.payload_length << 8) | byte_at(data, 2 + i);
+    }
+    if (header.payload_length >> 63) {
+      throw InvalidArgument() << "WebSocket frame length exceeds 63 bits.";
+    }
+  }
+  if (header.masked) {
+    for (std::size_t i = 0; i < 4; ++i) {
+      header.mask[i] = byte_at(data, 2 + length_bytes + i);
+    }
+  }
+  header.size = size;
+  return header;
+}
+
+void append_websocket_frame_header(
+  std::string& out,
+  WebSocketOpcode opcode,
+  std::uint64_t length,
+  bool fin,
+  bool rsv1,
+  const WebSocketMask* mask
+) {
+  out.push_back(static_cast<char>(
+    (fin ? FIN_BIT : 0) | (rsv1 ? RSV1_BIT : 0) |
+    static_cast<std::uint8_t>(opcode)
+  ));
+
+  const std::uint8_t mask_bit = mask ? MASK_BIT : 0;
+  if (length < 126) {
+    out.push_back(static_cast<char>(mask_bit | length));
+  } else if (length <= 0xffff) {
+    out.push_back(static_cast<char>(mask_bit | 126));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+  } else {
+    out.push_back(static_cast<char>(mask_bit | 127));
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      out.push_back(static_cast<char>(length >> shift));
+    }
+  }
+
+  if (mask) out.append(reinterpret_cast<const char*>(mask->data()), 4);
+}
+
+void append_websocket_frame(
+  std::string& out,
+  WebSocketOpcode opcode,
+  std::string_view payload,
+  bool fin,
+  bool rsv1
+) {
+  append_websocket_frame_header(out, opcode, payload.size(), fin, rsv1);
+  out.append(payload);
+}
+
+void append_masked_websocket_frame(
+  std::string& out,
+  WebSocketOpcode opcode,
+  std::string_view payload,
+  const WebSocketMask& mask,
+  bool fin,
+  bool rsv1
+) {
+  append_websocket_frame_header(out, opcode, payload.size(), fin, rsv1, &mask);
+  const std::size_t offset = out.size();
+  out.append(payload);
+  unmask_websocket_payload(out.data() + offset, payload.size(), mask);
+}
+
+void unmask_websocket_payload(
+  char* data,
+  std::size_t size,
+  const WebSocketMask& mask
+) {
+  // The mask repeated across a whole vector register. Each block below is a
+  // multiple of 4 bytes, so the pattern stays lined up with the payload.
+  std::uint8_t pattern[16];
+  for (std::size_t i = 0; i < sizeof(pattern); ++i) pattern[i] = mask[i % 4];
+
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i key =
+    _mm_loadu_si128(reinterpret_cast<const __m128i*>(pattern));
+  for (; i + 16 <= size; i += 16) {
+    __m128i* block = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(block, _mm_xor_si128(_mm_loadu_si128(block), key));
+  }
+#endif
+
+  std::uint64_t word_key;
+  std::memcpy(&word_key, pattern, sizeof(word_key));
+  for (; i + 8 <= size; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    word ^= word_key;
+    std::memcpy(data + i, &word, sizeof(word));
+  }
+
+  for (; i < size; ++i) data[i] ^= mask[i % 4];
+}
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace lw::http::internal {
+
+/**
+ * The GUID appended to a client's `Sec-WebSocket-Key` before hashing it for
+ * the `Sec-WebSocket-Accept` response header.
+ */
+constexpr std::string_view WEBSOCKET_GUID =
+  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+constexpr std::size_t WEBSOCKET_MAX_HEADER_SIZE = 14;
+constexpr std::size_t WEBSOCKET_MAX_CONTROL_PAYLOAD = 125;
+
+enum class WebSocketOpcode: std::uint8_t {
+  CONTINUATION = 0x0,
+  TEXT         = 0x1,
+  BINARY       = 0x2,
+  CLOSE        = 0x8,
+  PING         = 0x9,
+  PONG         = 0xa
+};
+
+typedef std::array<std::uint8_t, 4> WebSocketMask;
+
+/**
+ * The header of a frame as defined by RFC 6455 section 5.2.
+ */
+struct WebSocketFrameHeader {
+  bool fin = true;
+  bool rsv1 = false;
+  bool rsv2 = false;
+  bool rsv3 = false;
+  WebSocketOpcode opcode = WebSocketOpcode::CONTINUATION;
+  bool masked = false;
+  WebSocketMask mask = {0, 0, 0, 0};
+  std::uint64_t payload_length = 0;
+
+  /**
+   * Bytes the header took up on the wire, from 2 to 14.
+   */
+  std::size_t size = 0;
+
+  bool is_control() const {
+    return static_cast<std::uint8_t>(opcode) & 0x8;
+  }
+};
+
+/**
+ * Parses the frame header at the start of `data`.
+ *
+ * @return
+ *  The header, or nothing if `data` ends before the header does.
+ *
+ * @throw InvalidArgument
+ *  If the payload length does not fit in 63 bits.
+ */
+std::optional<WebSocketFrameHeader> parse_websocket_frame_header(
+  std::string_view data
+);
+
+/**
+ * Appends a frame header for a payload of `length` bytes. The header is masked
+ * when a `mask` is given, as frames from clients must be.
+ */
+void append_websocket_frame_header(
+  std::string& out,
+  WebSocketOpcode opcode,
+  std::uint64_t length,
+  bool fin = true,
+  bool rsv1 = false,
+  const WebSocketMask* mask = nullptr
+);
+
+/**
+ * Appends a whole unmasked frame, as servers send them.
+ */
+void append_websocket_frame(
+  std::string& out,
+  WebSocketOpcode opcode,
+  std::string_view payload,
+  bool fin = true,
+  bool rsv1 = false
+);
+
+/**
+ * Appends a whole frame masked with `mask`, as clients send them.
+ */
+void append_masked_websocket_frame(
+  std::string& out,
+  WebSocketOpcode opcode,
+  std::string_view payload,
+  const WebSocketMask& mask,
+  bool fin = true,
+  bool rsv1 = false
+);
+
+/**
+ * XORs `data` with the repeating mask in place. Masking and unmasking are the
+ * same operation. The payload is processed a vector register at a time where
+ * the target supports it.
+ */
+void unmask_websocket_payload(
+  char* data,
+  std::size_t size,
+  const WebSocketMask& mask
+);
+
+}
@@ -0,0 +1,105 @@
+#include "lw/http/internal/websocket_frame.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+
+namespace lw::http::internal {
+namespace {
+
+constexpr WebSocketMask MASK = {0x37, 0xfa, 0x21, 0x3d};
+
+TEST(WebSocketFrame, MatchesRfcExamples) {
+  // Examples from RFC 6455 section 5.7.
+  std::string unmasked;
+  append_websocket_frame(unmasked, WebSocketOpcode::TEXT, "Hello");
+  EXPECT_EQ(unmasked, std::string_view("\x81\x05Hello", 7));
+
+  std::string masked;
+  append_masked_websocket_frame(masked, WebSocketOpcode::TEXT, "Hello", MASK);
+  EXPECT_EQ(
+    masked,
+    std::string_view("\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58", 11)
+  );
+
+  std::optional<WebSocketFrameHeader> header =
+    parse_websocket_frame_header(masked);
+  ASSERT_TRUE(header);
+  EXPECT_TRUE(header->fin);
+  EXPECT_EQ(header->opcode, WebSocketOpcode::TEXT);
+  EXPECT_TRUE(header->masked);
+  EXPECT_EQ(header->mask, MASK);
+  EXPECT_EQ(header->payload_length, 5u);
+  EXPECT_EQ(header->size, 6u);
+  EXPECT_FALSE(header->is_control());
+}
+
+TEST(WebSocketFrame, RoundTripsExtendedLengths) {
+  for (std::uint64_t length : {125, 126, 65535, 65536}) {
+    for (bool masked : {false, true}) {
+      std::string frame;
+      append_websocket_frame_header(
+        frame,
+        WebSocketOpcode::BINARY,
+        length,
+        /*fin=*/false,
+        /*rsv1=*/true,
+        masked ? &MASK : nullptr
+      );
+      std::optional<WebSocketFrameHeader> header =
+        parse_websocket_frame_header(frame);
+      ASSERT_TRUE(header) << length;
+      EXPECT_EQ(header->payload_length, length);
+      EXPECT_EQ(header->size, frame.size());
+      EXPECT_FALSE(header->fin);
+      EXPECT_TRUE(header->rsv1);
+      EXPECT_EQ(header->masked, masked);
+      EXPECT_EQ(header->opcode, WebSocketOpcode::BINARY);
+    }
+  }
+}
+
+TEST(WebSocketFrame, WaitsForWholeHeaders) {
+  std::string frame;
+  append_websocket_frame_header(
+    frame,
+    WebSocketOpcode::PING,
+    70000,
+    /*fin=*/true,
+    /*rsv1=*/false,
+    &MASK
+  );
+  for (std::size_t i = 0; i < frame.size(); ++i) {
+    EXPECT_FALSE(parse_websocket_frame_header(frame.substr(0, i))) << i;
+  }
+  EXPECT_TRUE(parse_websocket_frame_header(frame)->is_control());
+}
+
+TEST(WebSocketFrame, RejectsLengthsOver63Bits) {
+  const std::string frame{"\x82\x7f\x80\x00\x00\x00\x00\x00\x00\x00", 10};
+  EXPECT_THROW(parse_websocket_frame_header(frame), InvalidArgument);
+}
+
+TEST(WebSocketFrame, UnmasksLikeTheByteLoop) {
+  std::string payload;
+  for (int i = 0; i < 1000; ++i) payload.push_back(static_cast<char>(i * 7));
+
+  for (std::size_t size : {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 100, 1000}) {
+    std::string expected = payload.substr(0, size);
+    for (std::size_t i = 0; i < size; ++i) expected[i] ^= MASK[i % 4];
+
+    std::string masked = payload.substr(0, size);
+    unmask_websocket_payload(masked.data(), masked.size(), MASK);
+    EXPECT_EQ(masked, expected) << size;
+
+    unmask_websocket_payload(masked.data(), masked.size(), MASK);
+    EXPECT_EQ(masked, payload.substr(0, size)) << size;
+  }
+}
+
+}
+}
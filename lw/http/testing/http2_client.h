@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/http/internal/hpack.h"
+#include "lw/http/internal/http2_frame.h"
+
+namespace lw::http::testing {
+
+struct Http2TestResponse {
+  internal::HpackHeaders headers;
+  std::string body;
+  bool complete = false;
+  std::optional<internal::Http2Error> reset;
+
+  std::string_view header(std::string_view name) const {
+    for (const internal::HpackHeader& header : headers) {
+      if (header.name == name) return header.value;
+    }
+    return {};
+  }
+};
+
+/**
+ * Speaks just enough of the client side of HTTP/2 to test servers: it encodes
+ * requests and decodes whatever frames the server sends back.
+ *
+ * This class is only useful for testing. If you find a non-testing use for this
+ * you should rearchitect your solution.
+ */
+class Http2TestClient {
+public:
+  /**
+   * The connection preface, including the client's SETTINGS frame.
+   */
+  std::string preface(
+    std::initializer_list<std::pair<internal::Http2Setting, std::uint32_t>>
+      settings = {}
+  ) const {
+    std::string out{internal::HTTP2_PREFACE};
+    internal::append_settings_frame(out, settings);
+    return out;
+  }
+
+  std::string request(
+    std::uint32_t stream_id,
+    std::string_view method,
+    std::string_view path,
+    const internal::HpackHeaders& headers = {},
+    bool end_stream = true
+  ) {
+    internal::HpackHeaders fields{
+      {":method", std::string{method}},
+      {":scheme", "https"},
+      {":path", std::string{path}},
+      {":authority", "localhost"}
+    };
+    fields.insert(fields.end(), headers.begin(), headers.end());
+
+    std::string block;
+    _encoder.encode(fields, block);
+    std::string out;
+    internal::append_header_frames(
+      out,
+      stream_id,
+      block,
+      end_stream,
+      internal::HTTP2_DEFAULT_MAX_FRAME_SIZE
+    );
+    return out;
+  }
+
+  std::string data(
+    std::uint32_t stream_id,
+    std::string_view data,
+    bool end_stream = true
+  ) const {
+    std::string out;
+    internal::append_frame(
+      out,
+      internal::Http2FrameType::DATA,
+      end_stream ? internal::http2_flags::END_STREAM : 0,
+      stream_id,
+      data
+    );
+    return out;
+  }
+
+  /**
+   * Decodes every complete frame at the start of `data`.
+   *
+   * @return
+   *  The number of bytes decoded.
+   */
+  std::size_t receive(std::string_view data) {
+    std::size_t consumed = 0;
+    while (data.size() - consumed >= internal::HTTP2_FRAME_HEADER_SIZE) {
+      const std::string_view rest = data.substr(consumed);
+      const internal::Http2FrameHeader header =
+        internal::parse_frame_header(rest);
+      if (rest.size() < internal::HTTP2_FRAME_HEADER_SIZE + header.length) {
+        break;
+      }
+      _receive_frame(
+        header,
+        rest.substr(internal::HTTP2_FRAME_HEADER_SIZE, header.length)
+      );
+      consumed += internal::HTTP2_FRAME_HEADER_SIZE + header.length;
+    }
+    return consumed;
+  }
+
+  const std::vector<internal::Http2FrameHeader>& frames() const {
+    return _frames;
+  }
+
+  const std::map<std::uint32_t, Http2TestResponse>& responses() const {
+    return _responses;
+  }
+
+  const Http2TestResponse& response(std::uint32_t stream_id) const {
+    return _responses.at(stream_id);
+  }
+
+  /**
+   * Forgets the responses and frames received so far, keeping the header
+   * compression state.
+   */
+  void clear() {
+    _frames.clear();
+    _responses.clear();
+  }
+
+  std::size_t settings_acks() const { return _settings_acks; }
+  const std::vector<std::string>& ping_acks() const { return _ping_acks; }
+  std::optional<internal::Http2Error> goaway() const { return _goaway; }
+
+private:
+  static std::uint32_t _read_uint32(std::string_view data) {
+    return (
+      static_cast<std::uint32_t>(static_cast<std::uint8_t>(data[0])) << 24 |
+      internal::read_uint31(data)
+    );
+  }
+
+  void _receive_frame(
+    const internal::Http2FrameHeader& header,
+    std::string_view payload
+  ) {
+    using internal::Http2FrameType;
+    namespace http2_flags = internal::http2_flags;
+
+    _frames.push_back(header);
+    switch (header.type) {
+      case Http2FrameType::HEADERS:
+      case Http2FrameType::CONTINUATION:
+        if (header.type == Http2FrameType::HEADERS) {
+          _header_block.clear();
+          _header_block_ends_stream =
+            header.has_flag(http2_flags::END_STREAM);
+        }
+        _header_block.append(payload);
+        if (header.has_flag(http2_flags::END_HEADERS)) {
+          Http2TestResponse& response = _responses[header.stream_id];
+          for (auto& field : _decoder.decode(_header_block)) {
+            response.headers.push_back(std::move(field));
+          }
+          response.complete = _header_block_ends_stream;
+        }
+        break;
+      case Http2FrameType::DATA: {
+        Http2TestResponse& response = _responses[header.stream_id];
+        response.body.append(payload);
+        response.complete = header.has_flag(http2_flags::END_STREAM);
+        break;
+      }
+      case Http2FrameType::RST_STREAM:
+        _responses[header.stream_id].reset =
+          static_cast<internal::Http2Error>(_read_uint32(payload));
+        break;
+      case Http2FrameType::SETTINGS:
+        if (header.has_flag(http2_flags::ACK)) ++_settings_acks;
+        break;
+      case Http2FrameType::PING:
+        if (header.has_flag(http2_flags::ACK)) {
+          _ping_acks.push_back(std::string{payload});
+        }
+        break;
+      case Http2FrameType::GOAWAY:
+        _goaway = static_cast<internal::Http2Error>(
+          _read_uint32(payload.substr(4))
+        );
+        break;
+      default:
+        break;
+    }
+  }
+
+  internal::HpackEncoder _encoder;
+  internal::HpackDecoder _decoder;
+  std::string _header_block;
+  bool _header_block_ends_stream = false;
+
+  std::vector<internal::Http2FrameHeader> _frames;
+  std::map<std::uint32_t, Http2TestResponse> _responses;
+  std::size_t _settings_acks = 0;
+  std::vector<std::string> _ping_acks;
+  std::optional<internal::Http2Error> _goaway;
+};
+
+}
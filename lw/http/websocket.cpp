@@ -0,0 +1,644 @@
+#include "lw/http/websocket.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+#include "lw/co/future.h"
+#include "lw/err/canonical.h"
+#include "lw/flags/flags.h"
+#include "lw/http/http_response.h"
+#include "lw/http/internal/http_header_parser.h"
+#include "lw/http/internal/websocket_deflate.h"
+#include "lw/http/internal/websocket_frame.h"
+#include "lw/io/co/co.h"
+#include "lw/log/log.h"
+#include "lw/memory/buffer.h"
+
+LW_FLAG(
+  std::size_t, websocket_max_message_size, 16 * 1024 * 1024,
+  "Largest message, after decompression, a WebSocket client may send."
+);
+
+LW_FLAG(
+  bool, websocket_deflate, true,
+  "Compress WebSocket messages for clients offering permessage-deflate."
+);
+
+namespace lw {
+namespace {
+
+using ::lw::http::internal::WEBSOCKET_GUID;
+using ::lw::http::internal::WEBSOCKET_MAX_CONTROL_PAYLOAD;
+using ::lw::http::internal::WebSocketDeflateParams;
+using ::lw::http::internal::WebSocketDeflater;
+using ::lw::http::internal::WebSocketFrameHeader;
+using ::lw::http::internal::WebSocketInflater;
+using ::lw::http::internal::WebSocketOpcode;
+using ::lw::http::internal::append_websocket_frame;
+using ::lw::http::internal::has_header_token;
+using ::lw::http::internal::negotiate_websocket_deflate;
+using ::lw::http::internal::parse_websocket_frame_header;
+using ::lw::http::internal::unmask_websocket_payload;
+using ::lw::http::internal::websocket_deflate_response;
+
+// Compressing messages this small costs more than it saves.
+constexpr std::size_t MIN_DEFLATE_SIZE = 64;
+
+constexpr std::size_t READ_BLOCK_SIZE = 16 * 1024;
+
+/**
+ * Validates UTF-8, which text messages and close reasons must be.
+ */
+bool is_valid_utf8(std::string_view str) {
+  const auto* data = reinterpret_cast<const std::uint8_t*>(str.data());
+  const std::size_t size = str.size();
+  std::size_t i = 0;
+  while (i < size) {
+    // Skip through ASCII a word at a time.
+    if (i + 8 <= size) {
+      std::uint64_t word;
+      std::memcpy(&word, data + i, sizeof(word));
+      if ((word & 0x8080808080808080ull) == 0) {
+        i += 8;
+        continue;
+      }
+    }
+
+    const std::uint8_t lead = data[i];
+    std::size_t length = 0;
+    std::uint8_t min_next = 0x80;
+    std::uint8_t max_next = 0xbf;
+    if (lead < 0x80) {
+      ++i;
+      continue;
+    } else if (lead >= 0xc2 && lead <= 0xdf) {
+      length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      length = 3;
+      // No overlong encodings or UTF-16 surrogates.
+      if (lead == 0xe0) min_next = 0xa0;
+      if (lead == 0xed) max_next = 0x9f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      length = 4;
+      // No overlong encodings or code points past U+10FFFF.
+      if (lead == 0xf0) min_next = 0x90;
+      if (lead == 0xf4) max_next = 0x8f;
+    } else {
+      return false;
+    }
+
+    if (i + length > size) return false;
+    if (data[i + 1] < min_next || data[i + 1] > max_next) return false;
+    for (std::size_t j = 2; j < length; ++j) {
+      if ((data[i + j] & 0xc0) != 0x80) return false;
+    }
+    i += length;
+  }
+  return true;
+}
+
+bool is_valid_close_code(std::uint16_t code) {
+  return (
+    (code >= 1000 && code <= 1003) ||
+    (code >= 1007 && code <= 1014) ||
+    (code >= 3000 && code <= 4999)
+  );
+}
+
+/**
+ * Keys are 16 random bytes in base64, which is always 24 characters ending in
+ * two padding characters.
+ */
+bool is_valid_key(std::string_view key) {
+  if (key.size() != 24 || !key.ends_with("==")) return false;
+  return std::all_of(key.begin(), key.end() - 2, [](char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '+' || c == '/';
+  });
+}
+
+std::string make_accept_key(std::string_view key) {
+  std::string input{key};
+  input += WEBSOCKET_GUID;
+  std::uint8_t digest[SHA_DIGEST_LENGTH];
+  ::SHA1(
+    reinterpret_cast<const std::uint8_t*>(input.data()),
+    input.size(),
+    digest
+  );
+
+  // Base64 of the digest, plus the terminator EVP_EncodeBlock writes.
+  std::string accept(4 * ((SHA_DIGEST_LENGTH + 2) / 3) + 1, '\0');
+  const int size = ::EVP_EncodeBlock(
+    reinterpret_cast<std::uint8_t*>(accept.data()),
+    digest,
+    SHA_DIGEST_LENGTH
+  );
+  accept.resize(size);
+  return accept;
+}
+
+void respond_upgrade_required(HttpResponse& response, std::string_view body) {
+  response.status(HttpResponse::UPGRADE_REQUIRED);
+  response.header("Connection", "Upgrade");
+  response.header("Upgrade", "websocket");
+  response.header("Sec-WebSocket-Version", "13");
+  response.header("Content-Type", "text/plain");
+  response.body(body);
+}
+
+/**
+ * Messages are compressed without context from earlier ones, so every
+ * connection on a thread can share one compressor per window size instead of
+ * each holding its own few hundred kilobytes of zlib state.
+ */
+WebSocketDeflater& shared_deflater(int window_bits) {
+  thread_local std::map<int, std::unique_ptr<WebSocketDeflater>> deflaters;
+  std::unique_ptr<WebSocketDeflater>& deflater = deflaters[window_bits];
+  if (!deflater) deflater = std::make_unique<WebSocketDeflater>(window_bits);
+  return *deflater;
+}
+
+co::Future<void> send_or_drop(WebSocket& socket, const WebSocketFrame& frame) {
+  try {
+    co_await socket.send(frame);
+  } catch (const Error& err) {
+    log(INFO) << "Dropped WebSocket broadcast: " << err.what();
+  }
+}
+
+}
+
+WebSocketFrame WebSocketFrame::text(std::string_view text) {
+  return WebSocketFrame{WebSocketOpcode::TEXT, text};
+}
+
+WebSocketFrame WebSocketFrame::binary(std::string_view data) {
+  return WebSocketFrame{WebSocketOpcode::BINARY, data};
+}
+
+WebSocketFrame::WebSocketFrame(WebSocketOpcode opcode, std::string_view data):
+  _opcode{opcode},
+  _payload{data}
+{
+  append_websocket_frame(_plain, _opcode, _payload);
+}
+
+std::string_view WebSocketFrame::deflated(int window_bits) const {
+  if (_payload.size() < MIN_DEFLATE_SIZE) return _plain;
+
+  auto itr = _deflated.find(window_bits);
+  if (itr == _deflated.end()) {
+    std::string frame;
+    append_websocket_frame(
+      frame,
+      _opcode,
+      shared_deflater(window_bits).compress(_payload),
+      /*fin=*/true,
+      /*rsv1=*/true
+    );
+    itr = _deflated.emplace(window_bits, std::move(frame)).first;
+  }
+  return itr->second;
+}
+
+WebSocket::WebSocket(
+  io::CoStream& conn,
+  std::optional<WebSocketDeflateParams> deflate
+):
+  _conn{conn},
+  _deflate{deflate}
+{}
+
+WebSocket::~WebSocket() = default;
+
+co::Future<std::optional<WebSocketMessage>> WebSocket::receive() {
+  while (!_close_received) {
+    std::optional<WebSocketMessage> message;
+    bool failed = false;
+    try {
+      std::optional<WebSocketFrameHeader> header;
+      while (!(header = parse_websocket_frame_header(_unread()))) {
+        if (!co_await _fill(_unread().size() + 1)) break;
+      }
+      if (!header) {
+        log(INFO) << "WebSocket connection dropped without a close frame.";
+        _close_received = true;
+        _close_code = WebSocketCloseCode::ABNORMAL;
+        break;
+      }
+
+      // Check the length before buffering a payload which could never fit.
+      if (
+        header->payload_length >
+        flags::websocket_max_message_size - _message.size()
+      ) {
+        _fail(WebSocketCloseCode::MESSAGE_TOO_BIG, "Message too big.");
+      }
+      const std::size_t frame_size = header->size + header->payload_length;
+      if (!co_await _fill(frame_size)) {
+        log(INFO) << "WebSocket connection dropped mid-frame.";
+        _close_received = true;
+        _close_code = WebSocketCloseCode::ABNORMAL;
+        break;
+      }
+
+      char* payload = _input.data() + _input_pos + header->size;
+      unmask_websocket_payload(payload, header->payload_length, header->mask);
+      message = _handle_frame(
+        *header,
+        std::string_view{payload, header->payload_length}
+      );
+      _input_pos += frame_size;
+    } catch (const Error& err) {
+      log(INFO) << "WebSocket client failed: " << err.what();
+      if (_failure == WebSocketCloseCode::NORMAL) {
+        _failure = WebSocketCloseCode::PROTOCOL_ERROR;
+      }
+      failed = true;
+    }
+
+    if (failed) {
+      _close_received = true;
+      if (!_close_sent) {
+        try {
+          co_await close(_failure);
+        } catch (const Error& err) {
+          log(INFO) << "Failed to send WebSocket close: " << err.what();
+        }
+      }
+      break;
+    }
+
+    if (!_replies.empty()) {
+      const std::string replies = std::move(_replies);
+      _replies.clear();
+      co_await _write(replies);
+    }
+    if (message) co_return message;
+  }
+
+  // Both sides have closed, so the connection is done with.
+  if (_conn.good()) _conn.close();
+  co_return std::nullopt;
+}
+
+co::Future<void> WebSocket::send_text(std::string_view text) {
+  return _send_message(WebSocketOpcode::TEXT, text);
+}
+
+co::Future<void> WebSocket::send_binary(std::string_view data) {
+  return _send_message(WebSocketOpcode::BINARY, data);
+}
+
+co::Future<void> WebSocket::send(const WebSocketFrame& frame) {
+  if (!is_open()) {
+    throw FailedPrecondition() << "WebSocket is closed, cannot send.";
+  }
+  std::string_view serialized = frame.plain();
+  if (_deflate) serialized = frame.deflated(_deflate->server_window_bits);
+  co_await _write(serialized);
+}
+
+co::Future<void> WebSocket::ping(std::string_view payload) {
+  return _send_control(WebSocketOpcode::PING, payload);
+}
+
+co::Future<void> WebSocket::close(
+  WebSocketCloseCode code,
+  std::string_view reason
+) {
+  if (_close_sent) co_return;
+
+  std::string payload;
+  payload.push_back(static_cast<char>(static_cast<std::uint16_t>(code) >> 8));
+  payload.push_back(static_cast<char>(code));
+  payload += reason.substr(0, WEBSOCKET_MAX_CONTROL_PAYLOAD - 2);
+  co_await _send_control(WebSocketOpcode::CLOSE, payload);
+  _close_sent = true;
+  if (_close_received && _conn.good()) _conn.close();
+}
+
+std::string_view WebSocket::_unread() const {
+  return std::string_view{_input}.substr(_input_pos);
+}
+
+co::Future<bool> WebSocket::_fill(std::size_t size) {
+  while (_input.size() - _input_pos < size) {
+    if (!_conn.good()) co_return false;
+    if (_input_pos > 0) {
+      _input.erase(0, _input_pos);
+      _input_pos = 0;
+    }
+
+    const std::size_t offset = _input.size();
+    const std::size_t block_size = std::max(READ_BLOCK_SIZE, size - offset);
+    _input.resize(offset + block_size);
+    Buffer buffer{
+      reinterpret_cast<std::uint8_t*>(_input.data()) + offset,
+      block_size
+    };
+    const std::size_t bytes_read = co_await _conn.read(buffer);
+    _input.resize(offset + bytes_read);
+  }
+  co_return true;
+}
+
+co::Future<void> WebSocket::_write(std::string_view data) {
+  // Frames must go out whole, so writes wait their turn.
+  while (_writing) co_await _write_finished();
+  _writing = true;
+  try {
+    Buffer buffer{
+      reinterpret_cast<std::uint8_t*>(const_cast<char*>(data.data())),
+      data.size()
+    };
+    while (!buffer.empty()) {
+      const std::size_t written = co_await _conn.write(buffer);
+      if (written == 0) {
+        throw Unavailable() << "Connection closed while sending a frame.";
+      }
+      buffer = buffer.trim_prefix(written);
+    }
+    co_await _conn.flush();
+  } catch (...) {
+    _writing = false;
+    _wake_write_waiters();
+    throw;
+  }
+  _writing = false;
+  _wake_write_waiters();
+}
+
+co::Future<void> WebSocket::_write_finished() {
+  co::Promise<void> promise;
+  co::Future<void> future = promise.get_future();
+  _write_waiters.push_back(std::move(promise));
+  return future;
+}
+
+void WebSocket::_wake_write_waiters() {
+  std::vector<co::Promise<void>> waiters = std::move(_write_waiters);
+  _write_waiters.clear();
+  for (co::Promise<void>& waiter : waiters) waiter.set_value();
+}
+
+co::Future<void> WebSocket::_send_message(
+  WebSocketOpcode opcode,
+  std::string_view data
+) {
+  if (!is_open()) {
+    throw FailedPrecondition() << "WebSocket is closed, cannot send.";
+  }
+
+  std::string frame;
+  if (_deflate && data.size() >= MIN_DEFLATE_SIZE) {
+    append_websocket_frame(
+      frame,
+      opcode,
+      shared_deflater(_deflate->server_window_bits).compress(data),
+      /*fin=*/true,
+      /*rsv1=*/true
+    );
+  } else {
+    append_websocket_frame(frame, opcode, data);
+  }
+  co_await _write(frame);
+}
+
+co::Future<void> WebSocket::_send_control(
+  WebSocketOpcode opcode,
+  std::string_view payload
+) {
+  if (_close_sent) {
+    throw FailedPrecondition() << "WebSocket is closed, cannot send.";
+  }
+  if (payload.size() > WEBSOCKET_MAX_CONTROL_PAYLOAD) {
+    throw InvalidArgument()
+      << "WebSocket control frames carry at most "
+      << WEBSOCKET_MAX_CONTROL_PAYLOAD << " bytes.";
+  }
+
+  std::string frame;
+  append_websocket_frame(frame, opcode, payload);
+  co_await _write(frame);
+}
+
+void WebSocket::_fail(WebSocketCloseCode code, std::string_view message) {
+  _failure = code;
+  throw InvalidArgument() << message;
+}
+
+std::optional<WebSocketMessage> WebSocket::_handle_frame(
+  const WebSocketFrameHeader& header,
+  std::string_view payload
+) {
+  if (header.rsv2 || header.rsv3) {
+    _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Reserved bits set on frame.");
+  }
+  if (!header.masked) {
+    _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Client frame not masked.");
+  }
+
+  if (header.is_control()) {
+    if (!header.fin || header.rsv1) {
+      _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Fragmented control frame.");
+    }
+    if (payload.size() > WEBSOCKET_MAX_CONTROL_PAYLOAD) {
+      _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Control frame too big.");
+    }
+    switch (header.opcode) {
+      case WebSocketOpcode::PING:
+        if (!_close_sent) {
+          append_websocket_frame(_replies, WebSocketOpcode::PONG, payload);
+        }
+        return std::nullopt;
+      case WebSocketOpcode::PONG:
+        return std::nullopt;
+      case WebSocketOpcode::CLOSE:
+        _on_close_frame(payload);
+        return std::nullopt;
+      default:
+        _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Unknown control opcode.");
+    }
+  }
+
+  switch (header.opcode) {
+    case WebSocketOpcode::CONTINUATION:
+      if (!_message_type) {
+        _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Unexpected continuation.");
+      }
+      if (header.rsv1) {
+        _fail(WebSocketCloseCode::PROTOCOL_ERROR, "RSV1 set on continuation.");
+      }
+      break;
+    case WebSocketOpcode::TEXT:
+    case WebSocketOpcode::BINARY:
+      if (_message_type) {
+        _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Unfinished message.");
+      }
+      if (header.rsv1 && !_deflate) {
+        _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Compression not agreed.");
+      }
+      _message_type = header.opcode == WebSocketOpcode::TEXT
+        ? WebSocketMessage::TEXT
+        : WebSocketMessage::BINARY;
+      _message_compressed = header.rsv1;
+      break;
+    default:
+      _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Unknown data opcode.");
+  }
+
+  _message.append(payload);
+  if (!header.fin) return std::nullopt;
+
+  WebSocketMessage message{.type = *_message_type};
+  _message_type.reset();
+  if (_message_compressed) {
+    if (!_inflater) _inflater = std::make_unique<WebSocketInflater>();
+    try {
+      _inflater->decompress(
+        _message,
+        message.data,
+        flags::websocket_max_message_size
+      );
+    } catch (const ResourceExhausted& err) {
+      _fail(WebSocketCloseCode::MESSAGE_TOO_BIG, err.what());
+    } catch (const InvalidArgument& err) {
+      _fail(WebSocketCloseCode::INVALID_PAYLOAD, err.what());
+    }
+    _message.clear();
+  } else {
+    message.data = std::move(_message);
+    _message.clear();
+  }
+
+  if (message.type == WebSocketMessage::TEXT && !is_valid_utf8(message.data)) {
+    _fail(WebSocketCloseCode::INVALID_PAYLOAD, "Text message not UTF-8.");
+  }
+  return message;
+}
+
+void WebSocket::_on_close_frame(std::string_view payload) {
+  WebSocketCloseCode code = WebSocketCloseCode::NO_STATUS;
+  if (payload.size() == 1) {
+    _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Truncated close code.");
+  } else if (payload.size() >= 2) {
+    const std::uint16_t value = static_cast<std::uint16_t>(
+      (static_cast<std::uint8_t>(payload[0]) << 8) |
+      static_cast<std::uint8_t>(payload[1])
+    );
+    if (!is_valid_close_code(value)) {
+      _fail(WebSocketCloseCode::PROTOCOL_ERROR, "Invalid close code.");
+    }
+    if (!is_valid_utf8(payload.substr(2))) {
+      _fail(WebSocketCloseCode::INVALID_PAYLOAD, "Close reason not UTF-8.");
+    }
+    code = static_cast<WebSocketCloseCode>(value);
+  }
+
+  _close_received = true;
+  _close_code = code;
+  if (!_close_sent) {
+    // Echo the client's code back to complete the closing handshake.
+    append_websocket_frame(
+      _replies,
+      WebSocketOpcode::CLOSE,
+      code == WebSocketCloseCode::NO_STATUS ? "" : payload.substr(0, 2)
+    );
+    _close_sent = true;
+  }
+}
+
+co::Future<void> broadcast(
+  std::span<WebSocket* const> sockets,
+  const WebSocketFrame& frame
+) {
+  std::vector<co::Future<void>> sends;
+  sends.reserve(sockets.size());
+  for (WebSocket* socket : sockets) {
+    if (socket->is_open()) sends.push_back(send_or_drop(*socket, frame));
+  }
+  co_await co::all(std::move(sends));
+}
+
+co::Future<void> WebSocketHandler::get() {
+  const HttpRequest& req = request();
+  HttpResponse& res = response();
+  if (
+    req.http_version() != "HTTP/1.1" ||
+    !req.has_header("connection") ||
+    !has_header_token(req.header("connection"), "upgrade") ||
+    !req.has_header("upgrade") ||
+    !has_header_token(req.header("upgrade"), "websocket")
+  ) {
+    respond_upgrade_required(res, "WebSocket upgrade required.");
+    co_return;
+  }
+  if (
+    !req.has_header("sec-websocket-version") ||
+    req.header("sec-websocket-version") != "13"
+  ) {
+    respond_upgrade_required(res, "Unsupported WebSocket version.");
+    co_return;
+  }
+  if (
+    !req.has_header("sec-websocket-key") ||
+    !is_valid_key(req.header("sec-websocket-key"))
+  ) {
+    res.status(HttpResponse::BAD_REQUEST);
+    res.header("Content-Type", "text/plain");
+    res.body("Invalid Sec-WebSocket-Key.");
+    co_return;
+  }
+
+  res.status(HttpResponse::SWITCHING_PROTOCOLS);
+  res.header("Connection", "Upgrade");
+  res.header("Upgrade", "websocket");
+  res.header(
+    "Sec-WebSocket-Accept",
+    make_accept_key(req.header("sec-websocket-key"))
+  );
+  if (flags::websocket_deflate && req.has_header("sec-websocket-extensions")) {
+    _deflate =
+      negotiate_websocket_deflate(req.header("sec-websocket-extensions"));
+    if (_deflate) {
+      res.header(
+        "Sec-WebSocket-Extensions",
+        websocket_deflate_response(*_deflate)
+      );
+    }
+  }
+}
+
+co::Future<void> WebSocketHandler::upgrade(io::CoStream& conn) {
+  WebSocket socket{conn, _deflate};
+  try {
+    co_await run(socket);
+  } catch (const Error& err) {
+    log(ERROR) << "WebSocket handler failed: " << err.what();
+  }
+
+  // Nothing is listening for the client's reply anymore, so the closing
+  // handshake ends with this side's close frame.
+  try {
+    co_await socket.close();
+  } catch (const Error& err) {
+    log(INFO) << "Failed to send WebSocket close: " << err.what();
+  }
+  if (conn.good()) conn.close();
+}
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+/**
+ * @file
+ * To accept WebSocket connections subclass `WebSocketHandler`, implementing
+ * `WebSocketHandler::run`, and register it like any other `HttpHandler`. The
+ * router answers the upgrade request and then hands the connection over for as
+ * long as `run` keeps going.
+ *
+ * ```cpp
+ *  class EchoHandler: public ::lw::WebSocketHandler {
+ *  protected:
+ *    co::Future<void> run(WebSocket& socket) override {
+ *      while (auto message = co_await socket.receive()) {
+ *        co_await socket.send_text(message->data);
+ *      }
+ *    }
+ *  };
+ *  LW_REGISTER_HTTP_HANDLER(EchoHandler, "/echo");
+ * ```
+ *
+ * Messages going to many connections at once should be serialized once into a
+ * `WebSocketFrame` and sent with `broadcast`.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lw/co/future.h"
+#include "lw/flags/flags.h"
+#include "lw/http/http_handler.h"
+#include "lw/http/internal/websocket_deflate.h"
+#include "lw/http/internal/websocket_frame.h"
+#include "lw/io/co/co.h"
+
+LW_DECLARE_FLAG(std::size_t, websocket_max_message_size);
+LW_DECLARE_FLAG(bool, websocket_deflate);
+
+namespace lw {
+
+/**
+ * Status codes sent in WebSocket close frames (RFC 6455 section 7.4).
+ */
+enum class WebSocketCloseCode: std::uint16_t {
+  NORMAL           = 1000,
+  GOING_AWAY       = 1001,
+  PROTOCOL_ERROR   = 1002,
+  UNSUPPORTED_DATA = 1003,
+  NO_STATUS        = 1005,
+  ABNORMAL         = 1006,
+  INVALID_PAYLOAD  = 1007,
+  POLICY_VIOLATION = 1008,
+  MESSAGE_TOO_BIG  = 1009,
+  INTERNAL_ERROR   = 1011
+};
+
+struct WebSocketMessage {
+  enum Type {
+    TEXT,
+    BINARY
+  };
+
+  Type type = TEXT;
+  std::string data;
+};
+
+/**
+ * A message serialized once so that it can be sent on any number of
+ * connections without framing or compressing it again for each of them.
+ */
+class WebSocketFrame {
+public:
+  static WebSocketFrame text(std::string_view text);
+  static WebSocketFrame binary(std::string_view data);
+
+  /**
+   * The frame as sent on connections without compression.
+   */
+  std::string_view plain() const { return _plain; }
+
+  /**
+   * The frame as sent on connections using permessage-deflate with the given
+   * window size. Each size is compressed the first time it is needed.
+   */
+  std::string_view deflated(int window_bits) const;
+
+private:
+  WebSocketFrame(http::internal::WebSocketOpcode opcode, std::string_view data);
+
+  http::internal::WebSocketOpcode _opcode;
+  std::string _payload;
+  std::string _plain;
+  mutable std::map<int, std::string> _deflated;
+};
+
+/**
+ * The server side of a WebSocket connection (RFC 6455) after the handshake.
+ *
+ * Messages are received one whole message at a time, with fragments joined
+ * back together. Pings are answered and the closing handshake is completed
+ * while receiving, so connections should always have something receiving.
+ * Sends may happen at any time and are written one frame at a time.
+ */
+class WebSocket {
+public:
+  explicit WebSocket(
+    io::CoStream& conn,
+    std::optional<http::internal::WebSocketDeflateParams> deflate = {}
+  );
+  ~WebSocket();
+
+  WebSocket(const WebSocket&) = delete;
+  WebSocket& operator=(const WebSocket&) = delete;
+
+  /**
+   * True until a close frame has been sent or received, or the connection
+   * dropped. Messages can only be sent while open.
+   */
+  bool is_open() const { return !_close_sent && !_close_received; }
+
+  /**
+   * The code the client gave when closing, if it has.
+   */
+  std::optional<WebSocketCloseCode> close_code() const { return _close_code; }
+
+  /**
+   * Waits for the next whole message from the client.
+   *
+   * @return
+   *  The message, or nothing once the connection has closed. Clients breaking
+   *  the protocol have their connection closed with the matching code.
+   */
+  co::Future<std::optional<WebSocketMessage>> receive();
+
+  co::Future<void> send_text(std::string_view text);
+  co::Future<void> send_binary(std::string_view data);
+  co::Future<void> send(const WebSocketFrame& frame);
+  co::Future<void> ping(std::string_view payload = {});
+
+  /**
+   * Starts the closing handshake. Messages can still be received until the
+   * client replies with its own close frame.
+   */
+  co::Future<void> close(
+    WebSocketCloseCode code = WebSocketCloseCode::NORMAL,
+    std::string_view reason = {}
+  );
+
+private:
+  std::string_view _unread() const;
+  co::Future<bool> _fill(std::size_t size);
+  co::Future<void> _write(std::string_view data);
+  co::Future<void> _write_finished();
+  void _wake_write_waiters();
+  co::Future<void> _send_message(
+    http::internal::WebSocketOpcode opcode,
+    std::string_view data
+  );
+  co::Future<void> _send_control(
+    http::internal::WebSocketOpcode opcode,
+    std::string_view payload
+  );
+
+  /**
+   * Records a protocol violation, to be closed over once the frame that
+   * caused it has been abandoned.
+   */
+  [[noreturn]] void _fail(WebSocketCloseCode code, std::string_view message);
+  std::optional<WebSocketMessage> _handle_frame(
+    const http::internal::WebSocketFrameHeader& header,
+    std::string_view payload
+  );
+  void _on_close_frame(std::string_view payload);
+
+  io::CoStream& _conn;
+  std::optional<http::internal::WebSocketDeflateParams> _deflate;
+  std::unique_ptr<http::internal::WebSocketInflater> _inflater;
+
+  std::string _input;
+  std::size_t _input_pos = 0;
+  bool _writing = false;
+  std::vector<co::Promise<void>> _write_waiters;
+
+  // A message spread over a data frame and its continuations.
+  std::optional<WebSocketMessage::Type> _message_type;
+  bool _message_compressed = false;
+  std::string _message;
+
+  // Control frames the client is owed, sent before the next receive.
+  std::string _replies;
+
+  bool _close_sent = false;
+  bool _close_received = false;
+  std::optional<WebSocketCloseCode> _close_code;
+  WebSocketCloseCode _failure = WebSocketCloseCode::NORMAL;
+};
+
+/**
+ * Sends one frame on every open socket given. Writes to all of the sockets are
+ * started together, so one slow client does not hold up the rest.
+ */
+co::Future<void> broadcast(
+  std::span<WebSocket* const> sockets,
+  const WebSocketFrame& frame
+);
+
+/**
+ * Accepts WebSocket upgrades on its route and runs each connection.
+ */
+class WebSocketHandler: public HttpHandler {
+public:
+  /**
+   * Checks the upgrade request and answers with `101 Switching Protocols`, or
+   * `426 Upgrade Required` for requests which are not WebSocket handshakes.
+   */
+  co::Future<void> get() final;
+
+  co::Future<void> upgrade(io::CoStream& conn) final;
+
+protected:
+  /**
+   * Talks to one client for as long as the connection should stay open. The
+   * connection is closed when this returns, if it was not already.
+   */
+  virtual co::Future<void> run(WebSocket& socket) = 0;
+
+private:
+  std::optional<http::internal::WebSocketDeflateParams> _deflate;
+};
+
+}
@@ -0,0 +1,117 @@
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/http/websocket.h"
+#include "lw/io/co/co.h"
+#include "lw/memory/buffer.h"
+
+namespace lw {
+namespace {
+
+constexpr std::size_t CONNECTIONS = 10'000;
+
+/**
+ * Accepts every write immediately, leaving just the cost of framing and
+ * compressing messages.
+ */
+class DiscardStream: public io::CoStream {
+public:
+  bool eof() const override { return false; }
+  bool good() const override { return true; }
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return co::make_resolved_future(std::size_t{0});
+  }
+
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    return co::make_resolved_future(buffer.size());
+  }
+
+  void close() override {}
+};
+
+/**
+ * Connections to fan out to, with permessage-deflate when `state.range(1)` is
+ * set.
+ */
+class Audience {
+public:
+  explicit Audience(const benchmark::State& state) {
+    std::optional<http::internal::WebSocketDeflateParams> deflate;
+    if (state.range(1)) deflate.emplace();
+    for (std::size_t i = 0; i < CONNECTIONS; ++i) {
+      _streams.push_back(std::make_unique<DiscardStream>());
+      _sockets.push_back(
+        std::make_unique<WebSocket>(*_streams.back(), deflate)
+      );
+      _pointers.push_back(_sockets.back().get());
+    }
+  }
+
+  const std::vector<WebSocket*>& sockets() const { return _pointers; }
+
+private:
+  std::vector<std::unique_ptr<DiscardStream>> _streams;
+  std::vector<std::unique_ptr<WebSocket>> _sockets;
+  std::vector<WebSocket*> _pointers;
+};
+
+std::string make_update(std::size_t size) {
+  std::string update = "{\"updates\":[";
+  for (int i = 0; update.size() < size; ++i) {
+    update += "{\"id\":" + std::to_string(i) + ",\"price\":123.45},";
+  }
+  update.resize(size);
+  return update;
+}
+
+/**
+ * One `state.range(0)` byte message sent to 10k connections, serialized once.
+ */
+void BM_BroadcastFrame(benchmark::State& state) {
+  Audience audience{state};
+  const std::string update = make_update(state.range(0));
+  auto fan_out = [&]() -> co::Task {
+    const WebSocketFrame frame = WebSocketFrame::text(update);
+    co_await broadcast(audience.sockets(), frame);
+  };
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(fan_out);
+    co::Scheduler::this_thread().run();
+  }
+  state.SetItemsProcessed(state.iterations() * CONNECTIONS);
+}
+BENCHMARK(BM_BroadcastFrame)
+  ->Args({64, 0})->Args({4096, 0})
+  ->Args({64, 1})->Args({4096, 1});
+
+/**
+ * The same fan out, framing and compressing the message for each connection.
+ */
+void BM_SendToEach(benchmark::State& state) {
+  Audience audience{state};
+  const std::string update = make_update(state.range(0));
+  auto fan_out = [&]() -> co::Task {
+    for (WebSocket* socket : audience.sockets()) {
+      co_await socket->send_text(update);
+    }
+  };
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(fan_out);
+    co::Scheduler::this_thread().run();
+  }
+  state.SetItemsProcessed(state.iterations() * CONNECTIONS);
+}
+BENCHMARK(BM_SendToEach)
+  ->Args({64, 0})->Args({4096, 0})
+  ->Args({64, 1})->Args({4096, 1});
+
+}
+}
@@ -0,0 +1,370 @@
+#include "lw/http/websocket.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/flags/flags.h"
+#include "lw/http/http.h"
+#include "lw/http/internal/websocket_deflate.h"
+#include "lw/http/internal/websocket_frame.h"
+#include "lw/io/co/co.h"
+#include "lw/io/co/testing/string_stream.h"
+#include "lw/memory/buffer.h"
+
+namespace lw {
+namespace {
+
+using ::lw::http::internal::WebSocketDeflateParams;
+using ::lw::http::internal::WebSocketInflater;
+using ::lw::http::internal::WebSocketMask;
+using ::lw::http::internal::WebSocketOpcode;
+using ::lw::http::internal::append_masked_websocket_frame;
+using ::lw::http::internal::append_websocket_frame;
+using ::lw::http::internal::parse_websocket_frame_header;
+using ::lw::io::testing::CoStringStream;
+
+constexpr WebSocketMask MASK = {1, 2, 3, 4};
+
+std::string client_frame(
+  WebSocketOpcode opcode,
+  std::string_view payload,
+  bool fin = true,
+  bool rsv1 = false
+) {
+  std::string frame;
+  append_masked_websocket_frame(frame, opcode, payload, MASK, fin, rsv1);
+  return frame;
+}
+
+std::string server_frame(WebSocketOpcode opcode, std::string_view payload) {
+  std::string frame;
+  append_websocket_frame(frame, opcode, payload);
+  return frame;
+}
+
+std::string close_payload(WebSocketCloseCode code) {
+  const auto value = static_cast<std::uint16_t>(code);
+  return {static_cast<char>(value >> 8), static_cast<char>(value)};
+}
+
+class WebSocketTest: public ::testing::Test {
+protected:
+  /**
+   * Echoes every message received over `input` back to the client.
+   */
+  std::string echo(
+    std::string_view input,
+    std::optional<WebSocketDeflateParams> deflate = {}
+  ) {
+    std::string output;
+    CoStringStream conn{input, output};
+    WebSocket socket{conn, deflate};
+    auto run = [&]() -> co::Task {
+      while (auto message = co_await socket.receive()) {
+        if (message->type == WebSocketMessage::TEXT) {
+          co_await socket.send_text(message->data);
+        } else {
+          co_await socket.send_binary(message->data);
+        }
+        received.push_back(std::move(*message));
+      }
+      close_code = socket.close_code();
+    };
+    co::Scheduler::this_thread().schedule(run);
+    co::Scheduler::this_thread().run();
+    return output;
+  }
+
+  std::vector<WebSocketMessage> received;
+  std::optional<WebSocketCloseCode> close_code;
+};
+
+TEST_F(WebSocketTest, EchoesMessages) {
+  const std::string close = close_payload(WebSocketCloseCode::NORMAL);
+  EXPECT_EQ(
+    echo(
+      client_frame(WebSocketOpcode::TEXT, "hello") +
+      client_frame(WebSocketOpcode::BINARY, std::string_view{"\0\1", 2}) +
+      client_frame(WebSocketOpcode::CLOSE, close)
+    ),
+    server_frame(WebSocketOpcode::TEXT, "hello") +
+    server_frame(WebSocketOpcode::BINARY, std::string_view{"\0\1", 2}) +
+    server_frame(WebSocketOpcode::CLOSE, close)
+  );
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[0].type, WebSocketMessage::TEXT);
+  EXPECT_EQ(received[1].type, WebSocketMessage::BINARY);
+  EXPECT_EQ(close_code, WebSocketCloseCode::NORMAL);
+}
+
+TEST_F(WebSocketTest, JoinsFragmentsAroundPings) {
+  EXPECT_EQ(
+    echo(
+      client_frame(WebSocketOpcode::TEXT, "hel", /*fin=*/false) +
+      client_frame(WebSocketOpcode::PING, "ping") +
+      client_frame(WebSocketOpcode::CONTINUATION, "lo") +
+      client_frame(WebSocketOpcode::CLOSE, "")
+    ),
+    server_frame(WebSocketOpcode::PONG, "ping") +
+    server_frame(WebSocketOpcode::TEXT, "hello") +
+    server_frame(WebSocketOpcode::CLOSE, "")
+  );
+  ASSERT_EQ(received.size(), 1u);
+  EXPECT_EQ(received[0].data, "hello");
+  EXPECT_EQ(close_code, WebSocketCloseCode::NO_STATUS);
+}
+
+TEST_F(WebSocketTest, ClosesOnProtocolErrors) {
+  std::string unmasked;
+  append_websocket_frame(unmasked, WebSocketOpcode::TEXT, "hello");
+  EXPECT_EQ(
+    echo(unmasked),
+    server_frame(
+      WebSocketOpcode::CLOSE,
+      close_payload(WebSocketCloseCode::PROTOCOL_ERROR)
+    )
+  );
+  EXPECT_TRUE(received.empty());
+
+  EXPECT_EQ(
+    echo(client_frame(WebSocketOpcode::CONTINUATION, "lo")),
+    server_frame(
+      WebSocketOpcode::CLOSE,
+      close_payload(WebSocketCloseCode::PROTOCOL_ERROR)
+    )
+  );
+}
+
+TEST_F(WebSocketTest, ClosesOnInvalidText) {
+  EXPECT_EQ(
+    echo(client_frame(WebSocketOpcode::TEXT, "\xc0\xaf")),
+    server_frame(
+      WebSocketOpcode::CLOSE,
+      close_payload(WebSocketCloseCode::INVALID_PAYLOAD)
+    )
+  );
+  EXPECT_TRUE(received.empty());
+}
+
+TEST_F(WebSocketTest, ClosesOnOversizedMessages) {
+  const std::size_t max_size = flags::websocket_max_message_size;
+  flags::websocket_max_message_size = 4;
+  EXPECT_EQ(
+    echo(
+      client_frame(WebSocketOpcode::TEXT, "hel", /*fin=*/false) +
+      client_frame(WebSocketOpcode::CONTINUATION, "lo")
+    ),
+    server_frame(
+      WebSocketOpcode::CLOSE,
+      close_payload(WebSocketCloseCode::MESSAGE_TOO_BIG)
+    )
+  );
+  flags::websocket_max_message_size = max_size;
+}
+
+TEST_F(WebSocketTest, CompressesWithDeflate) {
+  // "Hello" compressed, from RFC 7692 section 7.2.3.
+  const std::string compressed{"\xf2\x48\xcd\xc9\xc9\x07\x00", 7};
+  const std::string long_message(1000, 'x');
+  const std::string output = echo(
+    client_frame(WebSocketOpcode::TEXT, compressed, true, /*rsv1=*/true) +
+    client_frame(WebSocketOpcode::TEXT, long_message),
+    WebSocketDeflateParams{}
+  );
+  ASSERT_EQ(received.size(), 2u);
+  EXPECT_EQ(received[0].data, "Hello");
+  EXPECT_EQ(received[1].data, long_message);
+
+  // Short replies go out as they are, long ones compressed.
+  const std::string hello = server_frame(WebSocketOpcode::TEXT, "Hello");
+  ASSERT_TRUE(output.starts_with(hello));
+  const std::string_view reply = std::string_view{output}.substr(hello.size());
+  auto header = parse_websocket_frame_header(reply);
+  ASSERT_TRUE(header);
+  EXPECT_TRUE(header->rsv1);
+  EXPECT_LT(header->payload_length, 100u);
+
+  WebSocketInflater inflater;
+  std::string inflated;
+  inflater.decompress(
+    reply.substr(header->size, header->payload_length),
+    inflated,
+    long_message.size()
+  );
+  EXPECT_EQ(inflated, long_message);
+}
+
+TEST(WebSocketBroadcast, SendsOneFrameToOpenSockets) {
+  std::string outputs[3];
+  CoStringStream conns[3] = {
+    CoStringStream{"", outputs[0]},
+    CoStringStream{"", outputs[1]},
+    CoStringStream{"", outputs[2]}
+  };
+  WebSocket plain{conns[0]};
+  WebSocket deflated{conns[1], WebSocketDeflateParams{}};
+  WebSocket closed{conns[2]};
+
+  const std::string text(200, 'y');
+  const WebSocketFrame frame = WebSocketFrame::text(text);
+  auto run = [&]() -> co::Task {
+    co_await closed.close();
+    const std::vector<WebSocket*> sockets = {&plain, &deflated, &closed};
+    co_await broadcast(sockets, frame);
+  };
+  co::Scheduler::this_thread().schedule(run);
+  co::Scheduler::this_thread().run();
+
+  EXPECT_EQ(outputs[0], server_frame(WebSocketOpcode::TEXT, text));
+  EXPECT_EQ(outputs[1], frame.deflated(15));
+  EXPECT_LT(outputs[1].size(), outputs[0].size());
+  EXPECT_EQ(
+    outputs[2],
+    server_frame(
+      WebSocketOpcode::CLOSE,
+      close_payload(WebSocketCloseCode::NORMAL)
+    )
+  );
+}
+
+/**
+ * Takes a few bytes per write, a tick at a time, like a slow client.
+ */
+class TrickleStream: public io::CoStream {
+public:
+  explicit TrickleStream(std::string& out): _out{out} {}
+
+  bool eof() const override { return false; }
+  bool good() const override { return true; }
+  void close() override {}
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return co::make_resolved_future(std::size_t{0});
+  }
+
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    co_await co::next_tick();
+    const std::size_t size = std::min<std::size_t>(buffer.size(), 5);
+    _out += static_cast<std::string_view>(buffer).substr(0, size);
+    co_return size;
+  }
+
+private:
+  std::string& _out;
+};
+
+TEST(WebSocketSend, FinishesFramesBeforeTheNext) {
+  std::string output;
+  TrickleStream conn{output};
+  WebSocket socket{conn};
+  const std::string first(40, 'a');
+  const std::string second(30, 'b');
+  co::Scheduler::this_thread().schedule([&]() -> co::Task {
+    co_await socket.send_text(first);
+  });
+  co::Scheduler::this_thread().schedule([&]() -> co::Task {
+    co_await socket.send_text(second);
+  });
+  co::Scheduler::this_thread().run();
+
+  EXPECT_EQ(
+    output,
+    server_frame(WebSocketOpcode::TEXT, first) +
+      server_frame(WebSocketOpcode::TEXT, second)
+  );
+}
+
+class GreetingHandler: public WebSocketHandler {
+protected:
+  co::Future<void> run(WebSocket& socket) override {
+    co_await socket.send_text("hi");
+  }
+};
+LW_REGISTER_HTTP_HANDLER(GreetingHandler, "/greet");
+
+std::string run_router(std::string_view request) {
+  HttpRouter router;
+  router.attach_routes();
+  std::string response;
+  co::Scheduler::this_thread().schedule(router.run(
+    std::make_unique<CoStringStream>(request, response)
+  ));
+  co::Scheduler::this_thread().run();
+  return response;
+}
+
+TEST(WebSocketHandler, UpgradesConnections) {
+  // The key and accept values are the example from RFC 6455 section 1.3.
+  EXPECT_EQ(
+    run_router(
+      "GET /greet HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Connection: keep-alive, Upgrade\r\n"
+      "Upgrade: websocket\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+      "Sec-WebSocket-Version: 13\r\n"
+      "\r\n"
+    ),
+    "HTTP/1.1 101 Switching Protocols\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+    "Upgrade: websocket\r\n"
+    "\r\n" +
+    server_frame(WebSocketOpcode::TEXT, "hi") +
+    server_frame(
+      WebSocketOpcode::CLOSE,
+      close_payload(WebSocketCloseCode::NORMAL)
+    )
+  );
+}
+
+TEST(WebSocketHandler, NegotiatesDeflate) {
+  const std::string response = run_router(
+    "GET /greet HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: Upgrade\r\n"
+    "Upgrade: websocket\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+    "\r\n"
+  );
+  EXPECT_TRUE(response.starts_with("HTTP/1.1 101 Switching Protocols\r\n"));
+  EXPECT_NE(
+    response.find(
+      "Sec-WebSocket-Extensions: permessage-deflate; "
+      "server_no_context_takeover\r\n"
+    ),
+    std::string::npos
+  );
+}
+
+TEST(WebSocketHandler, RequiresUpgradeRequests) {
+  EXPECT_TRUE(run_router(
+    "GET /greet HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "\r\n"
+  ).starts_with("HTTP/1.1 426 Upgrade Required\r\n"));
+
+  EXPECT_TRUE(run_router(
+    "GET /greet HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "Connection: Upgrade\r\n"
+    "Upgrade: websocket\r\n"
+    "Sec-WebSocket-Key: short\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n"
+  ).starts_with("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+}
+}
@@ -31,6 +31,14 @@ public:
   virtual bool good() const = 0;
 
   virtual co::Future<Buffer> read(std::size_t bytes) = 0;
+
+  /**
+   * Reads until `bytes` have arrived, or the source ends, and returns them as
+   * one contiguous view. Unlike `read`, which returns whatever is available up
+   * to `bytes`.
+   */
+  virtual co::Future<Buffer> read_exactly(std::size_t bytes) = 0;
+
   virtual co::Future<Buffer> read_until(std::uint8_t c, std::size_t limit = 0) = 0;
   virtual co::Future<Buffer> read_until(
     std::string_view str,
@@ -60,6 +68,15 @@ public:
     co_return result;
   }
 
+  co::Future<Buffer> read_exactly(std::size_t bytes) override {
+    while (_read_window.size() < bytes && _source.good()) {
+      co_await _load_buffer(bytes - _read_window.size());
+    }
+    Buffer result{_read_window.data(), std::min(bytes, _read_window.size())};
+    _read_window = _read_window.trim_prefix(result.size());
+    co_return result;
+  }
+
   co::Future<Buffer> read_until(
     std::uint8_t c,
     std::size_t limit = 0
@@ -139,6 +156,12 @@ public:
   virtual co::Future<std::size_t> read(Buffer& buffer) = 0;
   virtual co::Future<std::size_t> write(const Buffer& buffer) = 0;
 
+  /**
+   * Sends any data which `write` held back to combine with later writes.
+   * Streams which send each write immediately have nothing to do.
+   */
+  virtual co::Future<void> flush() { co_return; }
+
   virtual void close() = 0;
 };
 
@@ -1,5 +1,10 @@
 #include "lw/io/co/co.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
 #include "gtest/gtest.h"
 #include "lw/co/scheduler.h"
 #include "lw/co/task.h"
@@ -10,6 +15,30 @@ namespace {
 
 using ::lw::io::testing::StringReadable;
 
+/**
+ * Gives back at most two bytes per read, like a slow connection.
+ */
+class TrickleReadable {
+public:
+  explicit TrickleReadable(std::string_view str): _str{str} {}
+
+  bool eof() const { return !good(); }
+  bool good() const { return _read_pos < _str.size(); }
+
+  co::Future<std::size_t> read(Buffer& buffer) {
+    co_await co::next_tick();
+    std::size_t read_size =
+      std::min({_str.size() - _read_pos, buffer.size(), std::size_t{2}});
+    buffer.copy(_str.begin() + _read_pos, read_size);
+    _read_pos += read_size;
+    co_return read_size;
+  }
+
+private:
+  std::size_t _read_pos = 0;
+  std::string _str;
+};
+
 TEST(CoReader, IsGood) {
   co::Scheduler::this_thread().schedule([]() -> co::Task {
     StringReadable readable{"foobar"};
@@ -44,6 +73,23 @@ TEST(CoReader, ReadBytes) {
   co::Scheduler::this_thread().run();
 }
 
+TEST(CoReader, ReadExactly) {
+  co::Scheduler::this_thread().schedule([]() -> co::Task {
+    TrickleReadable readable{"foobar"};
+    CoReader<TrickleReadable> reader{readable};
+    Buffer b = co_await reader.read(5);
+    EXPECT_EQ(static_cast<std::string_view>(b), "fo");
+
+    b = co_await reader.read_exactly(3);
+    EXPECT_EQ(static_cast<std::string_view>(b), "oba");
+
+    b = co_await reader.read_exactly(100);
+    EXPECT_EQ(static_cast<std::string_view>(b), "r");
+    EXPECT_TRUE(reader.eof());
+  });
+  co::Scheduler::this_thread().run();
+}
+
 TEST(CoReader, ReadUntilChar) {
   co::Scheduler::this_thread().schedule([]() -> co::Task {
     StringReadable readable{"foobar"};
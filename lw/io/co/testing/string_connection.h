@@ -28,7 +28,8 @@ public:
 
   co::Future<std::size_t> read(Buffer& buffer) override {
     co_await co::next_tick();
-    std::size_t read_size = std::min(_read_str.size(), buffer.size());
+    std::size_t read_size =
+      std::min(_read_str.size() - _read_pos, buffer.size());
     buffer.copy(_read_str.begin() + _read_pos, read_size);
     _read_pos += read_size;
     co_return read_size;
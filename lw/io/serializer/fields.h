@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "lw/io/serializer/serializer.h"
+
+namespace lw::io {
+
+/**
+ * A named member of `T`, made with `field`.
+ */
+template <typename T, typename Member>
+struct Field {
+  typedef T object_type;
+  typedef Member member_type;
+
+  std::string_view name;
+  Member T::* member;
+};
+
+template <typename T, typename Member>
+constexpr Field<T, Member> field(std::string_view name, Member T::* member) {
+  return {.name = name, .member = member};
+}
+
+/**
+ * Types whose `Serialize` specialization declares their fields, in order, as a
+ * `static constexpr` tuple of `Field` named `fields`.
+ */
+template <typename T>
+concept FieldSerializable = requires() {
+  std::tuple_size<
+    std::remove_cvref_t<decltype(Serialize<T>::fields)>
+  >::value;
+};
+
+/**
+ * Base for `Serialize` specializations which declare their fields instead of
+ * writing them one by one. Any `Serializer` writes them as an object, and
+ * formats with their own encoder, like `mime::encode_json`, can write them
+ * without going through a `SerializationFormatter` at all.
+ *
+ * @example{.cpp}
+ *  template <>
+ *  struct Serialize<Foo>: SerializeFields<Foo> {
+ *    static constexpr std::tuple fields = {
+ *      field("id", &Foo::id),
+ *      field("name", &Foo::name)
+ *    };
+ *  };
+ */
+template <typename T>
+struct SerializeFields {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const T& value) {
+    std::apply(
+      [&](const auto&... fields) {
+        (serializer.write(fields.name, value.*fields.member), ...);
+      },
+      Serialize<T>::fields
+    );
+  }
+};
+
+}
@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <string_view>
 
+#include "lw/co/future.h"
+
 namespace lw::io {
 
 /**
@@ -24,6 +26,15 @@ public:
   virtual void put_signed_integer(std::int64_t number) = 0;
   virtual void put_unsigned_integer(std::uint64_t number) = 0;
   virtual void put_floating_point(double number) = 0;
+
+  /**
+   * Widened to a double unless the format can do better, such as writing the
+   * shortest text which reads back as the same float.
+   */
+  virtual void put_floating_point(float number) {
+    put_floating_point(static_cast<double>(number));
+  }
+
   virtual void put_string(std::string_view str) = 0;
 
   virtual void start_list() = 0;
@@ -33,6 +44,19 @@ public:
   virtual void start_pair_key() = 0;
   virtual void end_pair_key() = 0;
   virtual void end_pair() = 0;
+
+  /**
+   * True once enough output is buffered that it should be `flush`ed before
+   * more values are written. Formatters which keep all of their output in
+   * memory are never full.
+   */
+  virtual bool full() const { return false; }
+
+  /**
+   * Sends the buffered output on to its destination, resolving once the
+   * destination has taken it.
+   */
+  virtual co::Future<void> flush() { return co::make_resolved_future(); }
 };
 
 }
@@ -3,8 +3,10 @@
 #include <concepts>
 #include <memory>
 #include <string_view>
+#include <utility>
 
 #include "lw/co/future.h"
+#include "lw/co/generator.h"
 #include "lw/io/serializer/concepts.h"
 #include "lw/io/serializer/formatter.h"
 
@@ -106,6 +108,10 @@ struct Serialize;
  * There are also key-value versions that take `std::pair` to make working with
  * STL maps easier.
  *
+ * Asynchronous writes give formatters which send their output on as it is made,
+ * such as `mime::CoStreamFormatter`, the chance to wait for it to be taken
+ * between elements. Only then can a long list be written in bounded memory.
+ *
  * The key-value versions should only be used by `Serialize` specializations
  * that specify `typedef ObjectTag serialization_category`.
  */
@@ -139,7 +145,11 @@ public:
 
   template <std::floating_point Number>
   void write(Number n) {
-    _formatter->put_floating_point(n);
+    if constexpr (std::same_as<Number, float>) {
+      _formatter->put_floating_point(n);
+    } else {
+      _formatter->put_floating_point(static_cast<double>(n));
+    }
   }
 
   void write(const char* s) {
@@ -185,6 +195,20 @@ public:
     co_await s.serialize(*this, value);
   }
 
+  /**
+   * Writes each value yielded by `values` as a list. The generator is only
+   * resumed once the formatter has room for its next value.
+   */
+  template <Serializeable Value>
+  co::Future<void> write(co::Generator<Value> values) {
+    _formatter->start_list();
+    while (values.next()) {
+      write(values.value());
+      if (_formatter->full()) co_await _formatter->flush();
+    }
+    _formatter->end_list();
+  }
+
   /**
    * Specialization for key-value pairs using `std::pair`.
    *
@@ -241,6 +265,35 @@ public:
     _formatter->end_pair();
   }
 
+  /**
+   * Key-value pair writing for a generated list.
+   *
+   * @see ::lw::io::ObjectTag
+   */
+  template <Serializeable Key, Serializeable Value>
+  co::Future<void> write(const Key& key, co::Generator<Value> values) {
+    _formatter->start_pair_key();
+    write(key);
+    _formatter->end_pair_key();
+    co_await write(std::move(values));
+    _formatter->end_pair();
+  }
+
+  /**
+   * Waits for the formatter to send on its buffered output if it is full.
+   * Asynchronous `Serialize` specializations should wait on this between
+   * elements, as the serializer does for lists.
+   */
+  co::Future<void> drain() {
+    if (_formatter->full()) co_await _formatter->flush();
+  }
+
+  /**
+   * Sends on everything the formatter has buffered. Call once the top-level
+   * value is written.
+   */
+  co::Future<void> flush() { return _formatter->flush(); }
+
 private:
   template <internal::ListSerializationTagged<void> List>
   void _serialize_list(const List& l) {
@@ -261,7 +314,10 @@ private:
 
   template <internal::ListSerializationCapable<co::Future<void>> List>
   co::Future<void> _serialize_list(const List& l) {
-    for (const auto& v : l) co_await write(v);
+    for (const auto& v : l) {
+      co_await write(v);
+      if (_formatter->full()) co_await _formatter->flush();
+    }
   }
 
   template <internal::ObjectSerializationTagged<void> Object>
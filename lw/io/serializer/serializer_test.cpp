@@ -7,6 +7,8 @@
 #include <map>
 
 #include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/generator.h"
 #include "lw/io/serializer/testing/mock_formatter.h"
 #include "lw/io/serializer/testing/tagged_types.h"
 
@@ -15,8 +17,14 @@ namespace {
 
 using ::lw::io::testing::MockFormatter;
 using ::testing::_;
+using ::testing::InSequence;
+using ::testing::Return;
 using ::testing::StrictMock;
 
+co::Generator<int> count_to(int n) {
+  for (int i = 1; i <= n; ++i) co_yield i;
+}
+
 TEST(Serializer, WriteNull) {
   auto formatter = std::make_unique<StrictMock<MockFormatter>>();
   EXPECT_CALL(*formatter, put_null()).Times(1);
@@ -150,5 +158,51 @@ TEST(Serializer, WriteObjectTagged) {
   s.write(testing::ObjectTagged{.a = 1, .b = 2, .c = 3});
 }
 
+TEST(Serializer, WriteFields) {
+  auto formatter = std::make_unique<StrictMock<MockFormatter>>();
+  EXPECT_CALL(*formatter, put_string(std::string_view{"a"})).Times(2);
+  EXPECT_CALL(*formatter, put_string(std::string_view{"b"})).Times(2);
+  EXPECT_CALL(*formatter, put_string(std::string_view{"c"})).Times(2);
+  EXPECT_CALL(*formatter, put_string(std::string_view{"two"})).Times(1);
+  EXPECT_CALL(*formatter, put_signed_integer(1)).Times(1);
+  EXPECT_CALL(*formatter, put_signed_integer(3)).Times(1);
+  EXPECT_CALL(*formatter, put_signed_integer(4)).Times(1);
+  EXPECT_CALL(*formatter, put_signed_integer(5)).Times(1);
+  EXPECT_CALL(*formatter, start_object()).Times(2);
+  EXPECT_CALL(*formatter, start_pair_key()).Times(6);
+  EXPECT_CALL(*formatter, end_pair_key()).Times(6);
+  EXPECT_CALL(*formatter, end_pair()).Times(6);
+  EXPECT_CALL(*formatter, end_object()).Times(2);
+
+  Serializer s{std::move(formatter)};
+  s.write(testing::FieldTagged{
+    .a = 1,
+    .b = "two",
+    .c = {.a = 3, .b = 4, .c = 5}
+  });
+}
+
+TEST(Serializer, WriteGenerator) {
+  auto formatter = std::make_unique<StrictMock<MockFormatter>>();
+  {
+    InSequence sequence;
+    EXPECT_CALL(*formatter, start_list());
+    EXPECT_CALL(*formatter, put_signed_integer(1));
+    EXPECT_CALL(*formatter, full()).WillOnce(Return(false));
+    EXPECT_CALL(*formatter, put_signed_integer(2));
+    EXPECT_CALL(*formatter, full()).WillOnce(Return(true));
+    EXPECT_CALL(*formatter, flush()).WillOnce([]() {
+      return co::make_resolved_future();
+    });
+    EXPECT_CALL(*formatter, put_signed_integer(3));
+    EXPECT_CALL(*formatter, full()).WillOnce(Return(false));
+    EXPECT_CALL(*formatter, end_list());
+  }
+
+  Serializer s{std::move(formatter)};
+  co::Future<void> done = s.write(count_to(3));
+  EXPECT_TRUE(done.await_ready());
+}
+
 }
 }
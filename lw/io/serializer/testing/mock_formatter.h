@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gmock/gmock.h"
+#include "lw/co/future.h"
 #include "lw/io/serializer/formatter.h"
 
 namespace lw::io::testing {
@@ -21,6 +22,8 @@ public:
   MOCK_METHOD(void, start_pair_key, (), (override));
   MOCK_METHOD(void, end_pair_key, (), (override));
   MOCK_METHOD(void, end_pair, (), (override));
+  MOCK_METHOD(bool, full, (), (const, override));
+  MOCK_METHOD(co::Future<void>, flush, (), (override));
 };
 
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <string>
+#include <tuple>
+
+#include "lw/io/serializer/fields.h"
 #include "lw/io/serializer/serializer.h"
 #include "lw/io/serializer/serialized_value.h"
 
@@ -26,6 +30,12 @@ bool operator==(const ListTagged& lhs, const ListTagged& rhs) {
   return lhs.a == rhs.a && lhs.b == rhs.b && lhs.c == rhs.c;
 }
 
+struct FieldTagged {
+  int a;
+  std::string b;
+  ObjectTagged c;
+};
+
 }
 
 template <>
@@ -66,4 +76,13 @@ struct Serialize<testing::ListTagged> {
   }
 };
 
+template <>
+struct Serialize<testing::FieldTagged>: SerializeFields<testing::FieldTagged> {
+  static constexpr std::tuple fields = {
+    field("a", &testing::FieldTagged::a),
+    field("b", &testing::FieldTagged::b),
+    field("c", &testing::FieldTagged::c)
+  };
+};
+
 }
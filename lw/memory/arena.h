@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace lw {
+
+/**
+ * A bump allocator handing out memory from large blocks, for building many
+ * small objects which all share one lifetime.
+ *
+ * Nothing is freed until the arena is destroyed, and the destructors of
+ * objects made in the arena are never run. Only make objects which own no
+ * resources of their own.
+ *
+ * This class is not thread safe.
+ */
+class Arena {
+public:
+  /**
+   * @param block_size
+   *  The size of each block requested from the allocator. Allocations larger
+   *  than this get a block of their own.
+   */
+  explicit Arena(std::size_t block_size = 4096): _block_size{block_size} {}
+
+  Arena(Arena&&) = default;
+  Arena& operator=(Arena&&) = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /**
+   * Total bytes of blocks requested from the allocator.
+   */
+  std::size_t capacity() const { return _capacity; }
+
+  /**
+   * Returns `size` uninitialized bytes aligned to `alignment`, which must be a
+   * power of two no larger than `alignof(std::max_align_t)`.
+   */
+  void* allocate(
+    std::size_t size,
+    std::size_t alignment = alignof(std::max_align_t)
+  ) {
+    std::size_t padding = -reinterpret_cast<std::uintptr_t>(_head) &
+      (alignment - 1);
+    if (padding + size > _remaining) {
+      _add_block(size);
+      padding = 0;
+    }
+    std::byte* out = _head + padding;
+    _head = out + size;
+    _remaining -= padding + size;
+    return out;
+  }
+
+  /**
+   * Constructs an object in the arena.
+   */
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Returns uninitialized space for `count` objects of type `T`.
+   */
+  template <typename T>
+  T* allocate_array(std::size_t count) {
+    return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+private:
+  void _add_block(std::size_t min_size) {
+    const std::size_t size = std::max(min_size, _block_size);
+    // operator new[] of std::byte returns memory aligned for any fundamental
+    // type, which is all `allocate` promises. It is left uninitialized, as
+    // std::make_unique_for_overwrite would, without needing a library new
+    // enough to have it.
+    _blocks.push_back(std::unique_ptr<std::byte[]>(new std::byte[size]));
+    _head = _blocks.back().get();
+    _remaining = size;
+    _capacity += size;
+  }
+
+  std::size_t _block_size;
+  std::vector<std::unique_ptr<std::byte[]>> _blocks;
+  std::byte* _head = nullptr;
+  std::size_t _remaining = 0;
+  std::size_t _capacity = 0;
+};
+
+}
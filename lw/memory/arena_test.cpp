@@ -0,0 +1,53 @@
+#include "lw/memory/arena.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+namespace lw {
+namespace {
+
+TEST(Arena, AllocatesFromSharedBlocks) {
+  Arena arena{64};
+  EXPECT_EQ(arena.capacity(), 0);
+
+  char* a = static_cast<char*>(arena.allocate(10, 1));
+  char* b = static_cast<char*>(arena.allocate(10, 1));
+  EXPECT_EQ(b, a + 10);
+  EXPECT_EQ(arena.capacity(), 64);
+}
+
+TEST(Arena, AlignsAllocations) {
+  Arena arena{64};
+  arena.allocate(1, 1);
+  void* aligned = arena.allocate(8, 8);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 8, 0);
+
+  std::uint64_t* numbers = arena.allocate_array<std::uint64_t>(2);
+  EXPECT_EQ(
+    reinterpret_cast<std::uintptr_t>(numbers) % alignof(std::uint64_t),
+    0
+  );
+}
+
+TEST(Arena, GivesLargeAllocationsTheirOwnBlock) {
+  Arena arena{64};
+  arena.allocate(10, 1);
+  arena.allocate(100, 1);
+  EXPECT_EQ(arena.capacity(), 164);
+}
+
+TEST(Arena, MakesObjects) {
+  struct Point {
+    int x;
+    int y;
+  };
+  Arena arena;
+  Point* point = arena.make<Point>(1, 2);
+  EXPECT_EQ(point->x, 1);
+  EXPECT_EQ(point->y, 2);
+}
+
+}
+}
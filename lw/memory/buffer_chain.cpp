@@ -0,0 +1,85 @@
+#include "lw/memory/buffer_chain.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+#include "lw/err/canonical.h"
+
+namespace lw {
+
+BufferChain::BufferChain(std::size_t block_size): _block_size{block_size} {
+  if (_block_size == 0) {
+    throw InvalidArgument() << "Buffer chain blocks must not be empty.";
+  }
+}
+
+BufferChain::BufferChain(BufferChain&& other):
+  _block_size{other._block_size},
+  _blocks{std::move(other._blocks)},
+  _cursor{std::exchange(other._cursor, nullptr)},
+  _limit{std::exchange(other._limit, nullptr)}
+{
+  other._blocks.clear();
+}
+
+BufferChain& BufferChain::operator=(BufferChain&& other) {
+  _block_size = other._block_size;
+  _blocks = std::move(other._blocks);
+  _cursor = std::exchange(other._cursor, nullptr);
+  _limit = std::exchange(other._limit, nullptr);
+  other._blocks.clear();
+  return *this;
+}
+
+Buffer BufferChain::block(std::size_t i) const {
+  if (i >= _blocks.size()) {
+    throw OutOfRange()
+      << "Block " << i << " is past the end of this chain of "
+      << _blocks.size() << " blocks.";
+  }
+  const Buffer& block = _blocks[i];
+  const std::size_t size =
+    i + 1 == _blocks.size() ? _cursor - block.data() : _block_size;
+  return Buffer{const_cast<std::uint8_t*>(block.data()), size};
+}
+
+Buffer BufferChain::flatten() const {
+  Buffer flat{size()};
+  std::uint8_t* out = flat.data();
+  for (std::size_t i = 0; i < _blocks.size(); ++i) {
+    const Buffer view = block(i);
+    out = std::copy(view.begin(), view.end(), out);
+  }
+  return flat;
+}
+
+void BufferChain::clear() {
+  if (_blocks.empty()) return;
+  _blocks.erase(_blocks.begin() + 1, _blocks.end());
+  _cursor = _blocks.front().data();
+  _limit = _cursor + _block_size;
+}
+
+void BufferChain::_append_slow(std::string_view data) {
+  const std::uint8_t* source =
+    reinterpret_cast<const std::uint8_t*>(data.data());
+  std::size_t remaining = data.size();
+  while (remaining > 0) {
+    if (_cursor == _limit) _add_block();
+    const std::size_t count =
+      std::min(remaining, static_cast<std::size_t>(_limit - _cursor));
+    _cursor = std::copy_n(source, count, _cursor);
+    source += count;
+    remaining -= count;
+  }
+}
+
+void BufferChain::_add_block() {
+  _cursor = _blocks.emplace_back(_block_size).data();
+  _limit = _cursor + _block_size;
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "lw/memory/buffer.h"
+
+namespace lw {
+
+/**
+ * A growable run of bytes stored in a chain of equally sized buffers.
+ *
+ * Appending never moves what has already been written. Once the last block is
+ * full another is added to the chain, so growing costs one allocation per
+ * block instead of a copy of everything so far. Each block can be handed to a
+ * writer such as `net::Socket::send` as it is, without flattening the chain.
+ *
+ * This class is not thread safe.
+ */
+class BufferChain {
+public:
+  static constexpr std::size_t DEFAULT_BLOCK_SIZE = 16 * 1024;
+
+  /**
+   * @param block_size
+   *  The size of every block in the chain.
+   *
+   * @throw InvalidArgument
+   *  If `block_size` is zero.
+   */
+  explicit BufferChain(std::size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  BufferChain(const BufferChain&) = delete;
+  BufferChain& operator=(const BufferChain&) = delete;
+
+  BufferChain(BufferChain&& other);
+  BufferChain& operator=(BufferChain&& other);
+
+  std::size_t block_size() const { return _block_size; }
+
+  /**
+   * Number of bytes appended since construction or the last `clear`.
+   */
+  std::size_t size() const {
+    if (_blocks.empty()) return 0;
+    return (
+      (_blocks.size() - 1) * _block_size + (_cursor - _blocks.back().data())
+    );
+  }
+  [[nodiscard]] bool empty() const { return size() == 0; }
+
+  /**
+   * Number of blocks in the chain. Only the last may be partly filled, or
+   * empty after `clear`.
+   */
+  std::size_t block_count() const { return _blocks.size(); }
+
+  /**
+   * Returns a view of the bytes written to the `i`th block. The view does not
+   * own the memory and is invalidated by `clear`.
+   */
+  Buffer block(std::size_t i) const;
+
+  void append(std::string_view data) {
+    if (data.size() <= static_cast<std::size_t>(_limit - _cursor)) {
+      _cursor = std::copy_n(
+        reinterpret_cast<const std::uint8_t*>(data.data()),
+        data.size(),
+        _cursor
+      );
+    } else {
+      _append_slow(data);
+    }
+  }
+
+  void push_back(char c) {
+    if (_cursor == _limit) _add_block();
+    *_cursor++ = static_cast<std::uint8_t>(c);
+  }
+
+  /**
+   * Copies every block into one new buffer of exactly `size()` bytes.
+   */
+  Buffer flatten() const;
+
+  /**
+   * Drops everything written, keeping the first block for reuse.
+   */
+  void clear();
+
+private:
+  void _append_slow(std::string_view data);
+  void _add_block();
+
+  std::size_t _block_size;
+  std::vector<Buffer> _blocks;
+  std::uint8_t* _cursor = nullptr;
+  std::uint8_t* _limit = nullptr;
+};
+
+}
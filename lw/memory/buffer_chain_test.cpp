@@ -0,0 +1,76 @@
+#include "lw/memory/buffer_chain.h"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/memory/buffer.h"
+
+namespace lw {
+namespace {
+
+TEST(BufferChain, StartsEmpty) {
+  BufferChain chain{/*block_size=*/8};
+  EXPECT_TRUE(chain.empty());
+  EXPECT_EQ(chain.size(), 0);
+  EXPECT_EQ(chain.block_count(), 0);
+  EXPECT_EQ(chain.flatten().size(), 0);
+}
+
+TEST(BufferChain, AppendsAcrossBlocks) {
+  BufferChain chain{/*block_size=*/8};
+  chain.append("hello");
+  chain.push_back(' ');
+  chain.append("buffer chain");
+  chain.push_back('!');
+  EXPECT_EQ(chain.size(), 19);
+  ASSERT_EQ(chain.block_count(), 3);
+  EXPECT_EQ(static_cast<std::string_view>(chain.block(0)), "hello bu");
+  EXPECT_EQ(static_cast<std::string_view>(chain.block(1)), "ffer cha");
+  EXPECT_EQ(static_cast<std::string_view>(chain.block(2)), "in!");
+  EXPECT_EQ(
+    static_cast<std::string_view>(chain.flatten()),
+    "hello buffer chain!"
+  );
+  EXPECT_THROW(chain.block(3), OutOfRange);
+}
+
+TEST(BufferChain, AppendsLargerThanBlock) {
+  BufferChain chain{/*block_size=*/4};
+  const std::string data(37, 'x');
+  chain.append(data);
+  EXPECT_EQ(chain.size(), 37);
+  EXPECT_EQ(chain.block_count(), 10);
+  EXPECT_EQ(static_cast<std::string_view>(chain.flatten()), data);
+}
+
+TEST(BufferChain, ClearKeepsFirstBlock) {
+  BufferChain chain{/*block_size=*/4};
+  chain.append("abcdefgh");
+  const std::uint8_t* first = chain.block(0).data();
+  chain.clear();
+  EXPECT_TRUE(chain.empty());
+  EXPECT_EQ(chain.block_count(), 1);
+
+  chain.append("xy");
+  EXPECT_EQ(chain.block(0).data(), first);
+  EXPECT_EQ(static_cast<std::string_view>(chain.flatten()), "xy");
+}
+
+TEST(BufferChain, Moves) {
+  BufferChain chain{/*block_size=*/4};
+  chain.append("abcdef");
+  BufferChain moved{std::move(chain)};
+  moved.append("gh");
+  EXPECT_EQ(static_cast<std::string_view>(moved.flatten()), "abcdefgh");
+  EXPECT_TRUE(chain.empty());
+}
+
+TEST(BufferChain, RejectsEmptyBlocks) {
+  EXPECT_THROW(BufferChain{0}, InvalidArgument);
+}
+
+}
+}
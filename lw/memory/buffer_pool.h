@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "lw/memory/buffer.h"
+
+namespace lw {
+
+/**
+ * A free list of equally sized buffers, for reusing short lived buffers without
+ * going back to the allocator each time.
+ *
+ * Buffers are handed out by value and must be given back with `release` to be
+ * reused. Buffers which are never released are simply freed when destroyed.
+ *
+ * This class is not thread safe. Buffers may be moved between pools, for
+ * example acquired from one thread's pool and released into another's.
+ */
+class BufferPool {
+public:
+  /**
+   * @param buffer_size
+   *  The size of every buffer handed out by this pool.
+   * @param max_free
+   *  The most released buffers kept for reuse. Any released beyond this are
+   *  freed.
+   */
+  BufferPool(std::size_t buffer_size, std::size_t max_free):
+    _buffer_size{buffer_size},
+    _max_free{max_free}
+  {}
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  std::size_t buffer_size() const { return _buffer_size; }
+
+  /**
+   * Number of released buffers waiting to be reused.
+   */
+  std::size_t free_count() const { return _free.size(); }
+
+  /**
+   * Returns a buffer of `buffer_size` bytes. The contents are unspecified.
+   */
+  Buffer acquire() {
+    if (_free.empty()) return Buffer{_buffer_size};
+    Buffer buffer = std::move(_free.back());
+    _free.pop_back();
+    return buffer;
+  }
+
+  /**
+   * Returns a buffer to the pool. Buffers not of `buffer_size` are freed.
+   */
+  void release(Buffer buffer) {
+    if (buffer.size() != _buffer_size || _free.size() >= _max_free) return;
+    _free.push_back(std::move(buffer));
+  }
+
+private:
+  std::size_t _buffer_size;
+  std::size_t _max_free;
+  std::vector<Buffer> _free;
+};
+
+}
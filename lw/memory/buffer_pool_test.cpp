@@ -0,0 +1,47 @@
+#include "lw/memory/buffer_pool.h"
+
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "lw/memory/buffer.h"
+
+namespace lw {
+namespace {
+
+TEST(BufferPool, AllocatesBuffersOfConfiguredSize) {
+  BufferPool pool{/*buffer_size=*/128, /*max_free=*/2};
+  Buffer buffer = pool.acquire();
+  EXPECT_EQ(buffer.size(), 128);
+  EXPECT_NE(buffer.data(), nullptr);
+  EXPECT_EQ(pool.free_count(), 0);
+}
+
+TEST(BufferPool, ReusesReleasedBuffers) {
+  BufferPool pool{/*buffer_size=*/128, /*max_free=*/2};
+  Buffer buffer = pool.acquire();
+  const std::uint8_t* data = buffer.data();
+  pool.release(std::move(buffer));
+  EXPECT_EQ(pool.free_count(), 1);
+
+  Buffer reused = pool.acquire();
+  EXPECT_EQ(reused.data(), data);
+  EXPECT_EQ(pool.free_count(), 0);
+}
+
+TEST(BufferPool, FreesBuffersBeyondLimit) {
+  BufferPool pool{/*buffer_size=*/128, /*max_free=*/1};
+  Buffer first = pool.acquire();
+  Buffer second = pool.acquire();
+  pool.release(std::move(first));
+  pool.release(std::move(second));
+  EXPECT_EQ(pool.free_count(), 1);
+}
+
+TEST(BufferPool, FreesBuffersOfOtherSizes) {
+  BufferPool pool{/*buffer_size=*/128, /*max_free=*/2};
+  pool.release(Buffer{64});
+  EXPECT_EQ(pool.free_count(), 0);
+}
+
+}
+}
@@ -0,0 +1,366 @@
+#include "lw/mime/cbor.h"
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/mime/internal/big_endian.h"
+#include "lw/mime/internal/binary_document.h"
+
+namespace lw::mime {
+namespace {
+
+constexpr std::uint8_t UNSIGNED = 0;
+constexpr std::uint8_t NEGATIVE = 1;
+constexpr std::uint8_t BYTES = 2;
+constexpr std::uint8_t TEXT = 3;
+constexpr std::uint8_t ARRAY = 4;
+constexpr std::uint8_t MAP = 5;
+constexpr std::uint8_t TAG = 6;
+
+constexpr std::uint8_t INDEFINITE = 31;
+constexpr char SIMPLE_FALSE = '\xf4';
+constexpr char SIMPLE_TRUE = '\xf5';
+constexpr char SIMPLE_NULL = '\xf6';
+constexpr char FLOAT32 = '\xfa';
+constexpr char FLOAT64 = '\xfb';
+constexpr char BREAK = '\xff';
+
+/**
+ * Writes the initial byte of a data item, and the argument after it if it does
+ * not fit there, in as few bytes as possible.
+ */
+char* write_head(std::uint8_t major_type, std::uint64_t argument, char* out) {
+  const std::uint8_t type = major_type << 5;
+  if (argument < 24) {
+    *out = static_cast<char>(type | argument);
+    return out + 1;
+  } else if (argument <= 0xff) {
+    *out = static_cast<char>(type | 24);
+    return internal::write_big_endian<1>(argument, out + 1);
+  } else if (argument <= 0xffff) {
+    *out = static_cast<char>(type | 25);
+    return internal::write_big_endian<2>(argument, out + 1);
+  } else if (argument <= 0xffffffff) {
+    *out = static_cast<char>(type | 26);
+    return internal::write_big_endian<4>(argument, out + 1);
+  }
+  *out = static_cast<char>(type | 27);
+  return internal::write_big_endian<8>(argument, out + 1);
+}
+
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+//          #####  ###  ####  #     #  ###  ##### ##### ##### ####            //
+//          #     #   # #   # ##   ## #   #   #     #   #     #   #           //
+//          ####  #   # ####  # # # # #####   #     #   ####  ####            //
+//          #     #   # #   # #  #  # #   #   #     #   #     #   #           //
+//          #      ###  #   # #     # #   #   #     #   ##### #   #           //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+
+void CBORSerializationFormatter::put_null() {
+  check_can_add_value();
+  append({&SIMPLE_NULL, 1});
+  value_added();
+}
+
+void CBORSerializationFormatter::put_boolean(bool boolean) {
+  check_can_add_value();
+  append({boolean ? &SIMPLE_TRUE : &SIMPLE_FALSE, 1});
+  value_added();
+}
+
+void CBORSerializationFormatter::put_char(char c) {
+  put_string({&c, 1});
+}
+
+void CBORSerializationFormatter::put_signed_integer(std::int64_t number) {
+  if (number >= 0) {
+    _put_head(UNSIGNED, static_cast<std::uint64_t>(number));
+  } else {
+    // -1 - n, without overflowing on the smallest int64.
+    _put_head(NEGATIVE, ~static_cast<std::uint64_t>(number));
+  }
+}
+
+void CBORSerializationFormatter::put_unsigned_integer(std::uint64_t number) {
+  _put_head(UNSIGNED, number);
+}
+
+void CBORSerializationFormatter::put_floating_point(double number) {
+  const float narrow = static_cast<float>(number);
+  if (static_cast<double>(narrow) == number || std::isnan(number)) {
+    put_floating_point(narrow);
+    return;
+  }
+  check_can_add_value();
+  char buffer[9] = {FLOAT64};
+  internal::write_big_endian<8>(
+    std::bit_cast<std::uint64_t>(number),
+    buffer + 1
+  );
+  append({buffer, sizeof(buffer)});
+  value_added();
+}
+
+void CBORSerializationFormatter::put_floating_point(float number) {
+  check_can_add_value();
+  char buffer[5] = {FLOAT32};
+  internal::write_big_endian<4>(
+    std::bit_cast<std::uint32_t>(number),
+    buffer + 1
+  );
+  append({buffer, sizeof(buffer)});
+  value_added();
+}
+
+void CBORSerializationFormatter::put_string(std::string_view str) {
+  check_can_add_value();
+  char buffer[CONTAINER_HEAD_SIZE];
+  const char* end = write_head(TEXT, str.size(), buffer);
+  append({buffer, static_cast<std::size_t>(end - buffer)});
+  append(str);
+  value_added();
+}
+
+char* CBORSerializationFormatter::write_container_head(
+  Container container,
+  std::uint64_t size,
+  char* out
+) const {
+  return write_head(container == Container::LIST ? ARRAY : MAP, size, out);
+}
+
+void CBORSerializationFormatter::_put_head(
+  std::uint8_t major_type,
+  std::uint64_t argument
+) {
+  check_can_add_value();
+  char buffer[CONTAINER_HEAD_SIZE];
+  const char* end = write_head(major_type, argument, buffer);
+  append({buffer, static_cast<std::size_t>(end - buffer)});
+  value_added();
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+//                     ####   ###  ####   #### ##### ####                     //
+//                     #   # #   # #   # #     #     #   #                    //
+//                     ####  ##### ####   ###  ####  ####                     //
+//                     #     #   # #   #     # #     #   #                    //
+//                     #     #   # #   # ####  ##### #   #                    //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+
+namespace {
+
+double decode_half(std::uint16_t half) {
+  const int exponent = (half >> 10) & 0x1f;
+  const int mantissa = half & 0x3ff;
+  double value;
+  if (exponent == 0) {
+    value = std::ldexp(mantissa, -24);
+  } else if (exponent != 31) {
+    value = std::ldexp(mantissa + 1024, exponent - 25);
+  } else {
+    value = mantissa == 0 ?
+      std::numeric_limits<double>::infinity() :
+      std::numeric_limits<double>::quiet_NaN();
+  }
+  return half & 0x8000 ? -value : value;
+}
+
+using Kind = internal::BinaryDocument::Kind;
+
+class CBORDecoder {
+public:
+  CBORDecoder(std::string_view cbor, internal::BinaryDocument& document):
+    _cbor{cbor},
+    _document{document}
+  {}
+
+  void decode() {
+    _item(1);
+    if (_pos != _cbor.size()) {
+      throw InvalidArgument()
+          << "Unexpected data after CBOR item at byte " << _pos;
+    }
+  }
+
+private:
+  void _item(std::size_t depth) {
+    if (depth > internal::BinaryDocument::MAX_DEPTH) {
+      throw InvalidArgument()
+          << "CBOR nested deeper than " << internal::BinaryDocument::MAX_DEPTH;
+    }
+    const std::uint8_t initial = _byte();
+    const std::uint8_t major_type = initial >> 5;
+    const std::uint8_t info = initial & 0x1f;
+    switch (major_type) {
+      case UNSIGNED: return _document.add_unsigned(_argument(info));
+      case NEGATIVE: {
+        const std::uint64_t argument = _argument(info);
+        if (argument > std::numeric_limits<std::int64_t>::max()) {
+          throw InvalidArgument()
+              << "CBOR negative integer at byte " << (_pos - 1)
+              << " is too small for a 64-bit integer.";
+        }
+        return _document.add_signed(-static_cast<std::int64_t>(argument) - 1);
+      }
+      case BYTES:
+      case TEXT: {
+        if (info == INDEFINITE) return _chunked_string(major_type);
+        return _document.add_string(_take(_argument(info)));
+      }
+      case ARRAY:
+      case MAP: return _container(major_type, info, depth);
+      case TAG: {
+        _argument(info);
+        return _item(depth + 1);
+      }
+      default: return _simple(info);
+    }
+  }
+
+  void _container(
+    std::uint8_t major_type,
+    std::uint8_t info,
+    std::size_t depth
+  ) {
+    const bool map = major_type == MAP;
+    const std::uint32_t index =
+      _document.start_container(map ? Kind::OBJECT : Kind::LIST);
+    std::uint64_t count = 0;
+    if (info == INDEFINITE) {
+      for (; _peek() != BREAK; ++count) {
+        _item(depth + 1);
+        if (map) _item(depth + 1);
+      }
+      ++_pos;
+    } else {
+      count = _argument(info);
+      // Every element takes at least a byte.
+      if (count > (_cbor.size() - _pos) / (map ? 2 : 1)) _unexpected_end();
+      for (std::uint64_t i = 0; i < count; ++i) {
+        _item(depth + 1);
+        if (map) _item(depth + 1);
+      }
+    }
+    if (count > std::numeric_limits<std::uint32_t>::max()) {
+      throw InvalidArgument()
+          << "CBOR containers of 2^32 or more elements are not supported.";
+    }
+    _document.end_container(index, static_cast<std::uint32_t>(count));
+  }
+
+  void _chunked_string(std::uint8_t major_type) {
+    std::string str;
+    while (_peek() != BREAK) {
+      const std::uint8_t initial = _byte();
+      if ((initial >> 5) != major_type || (initial & 0x1f) == INDEFINITE) {
+        throw InvalidArgument()
+            << "Invalid chunk in indefinite length CBOR string at byte "
+            << (_pos - 1);
+      }
+      str.append(_take(_argument(initial & 0x1f)));
+    }
+    ++_pos;
+    return _document.add_string(std::move(str));
+  }
+
+  void _simple(std::uint8_t info) {
+    switch (info) {
+      case 20: return _document.add_boolean(false);
+      case 21: return _document.add_boolean(true);
+      case 22:
+      case 23: return _document.add_null();
+      case 25: {
+        return _document.add_float(
+          decode_half(internal::read_big_endian<2>(_take(2).data()))
+        );
+      }
+      case 26: {
+        return _document.add_float(std::bit_cast<float>(
+          static_cast<std::uint32_t>(
+            internal::read_big_endian<4>(_take(4).data())
+          )
+        ));
+      }
+      case 27: {
+        return _document.add_float(std::bit_cast<double>(
+          internal::read_big_endian<8>(_take(8).data())
+        ));
+      }
+      default: {
+        throw InvalidArgument()
+            << "Unsupported CBOR simple value " << static_cast<int>(info)
+            << " at byte " << (_pos - 1);
+      }
+    }
+  }
+
+  std::uint64_t _argument(std::uint8_t info) {
+    if (info < 24) return info;
+    switch (info) {
+      case 24: return internal::read_big_endian<1>(_take(1).data());
+      case 25: return internal::read_big_endian<2>(_take(2).data());
+      case 26: return internal::read_big_endian<4>(_take(4).data());
+      case 27: return internal::read_big_endian<8>(_take(8).data());
+    }
+    throw InvalidArgument()
+        << "Invalid CBOR additional information " << static_cast<int>(info)
+        << " at byte " << (_pos - 1);
+  }
+
+  std::uint8_t _byte() {
+    if (_pos >= _cbor.size()) _unexpected_end();
+    return static_cast<std::uint8_t>(_cbor[_pos++]);
+  }
+
+  char _peek() const {
+    if (_pos >= _cbor.size()) _unexpected_end();
+    return _cbor[_pos];
+  }
+
+  std::string_view _take(std::uint64_t count) {
+    if (count > _cbor.size() - _pos) _unexpected_end();
+    std::string_view bytes = _cbor.substr(_pos, count);
+    _pos += count;
+    return bytes;
+  }
+
+  [[noreturn]] void _unexpected_end() const {
+    throw InvalidArgument() << "Unexpected end of input to CBOR parser.";
+  }
+
+  std::string_view _cbor;
+  internal::BinaryDocument& _document;
+  std::size_t _pos = 0;
+};
+
+}
+
+std::unique_ptr<io::DeserializationToken> CBORDeserializationParser::parse(
+  std::string_view str
+) const {
+  auto document = std::make_unique<internal::BinaryDocument>();
+  CBORDecoder{str, *document}.decode();
+  return document;
+}
+
+// -------------------------------------------------------------------------- //
+
+LW_REGISTER_MIME_SERIALIZER(CBORSerializer, "application/cbor");
+
+}
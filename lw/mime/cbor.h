@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+#include "lw/io/serializer/formatter.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/internal/binary_formatter.h"
+#include "lw/mime/mime.h"
+
+namespace lw::mime {
+
+/**
+ * Writes CBOR (RFC 8949) into a chain of buffers, or through one into a
+ * `std::ostream`.
+ *
+ * Every length is definite and uses the shortest encoding, and floating point
+ * numbers are written in single precision when that loses nothing. Characters
+ * are written as one byte strings.
+ */
+class CBORSerializationFormatter: public internal::BinaryFormatter {
+public:
+  using internal::BinaryFormatter::BinaryFormatter;
+
+  void put_null() override;
+  void put_boolean(bool boolean) override;
+  void put_char(char c) override;
+  void put_signed_integer(std::int64_t number) override;
+  void put_unsigned_integer(std::uint64_t number) override;
+  void put_floating_point(double number) override;
+  void put_floating_point(float number) override;
+  void put_string(std::string_view str) override;
+
+protected:
+  char* write_container_head(
+    Container container,
+    std::uint64_t size,
+    char* out
+  ) const override;
+
+private:
+  void _put_head(std::uint8_t major_type, std::uint64_t argument);
+};
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * Decodes a single CBOR data item.
+ *
+ * Text and byte strings both read as strings, and definite ones view the
+ * source directly so it must outlive the returned token. Tags are skipped
+ * over, keeping only the value they tag, and undefined reads as null. Map keys
+ * which are not strings are kept but never match a key lookup.
+ */
+class CBORDeserializationParser: public io::DeserializationParser {
+public:
+  /**
+   * @throw InvalidArgument
+   *  If `str` is not exactly one well formed CBOR data item, or nests more
+   *  than `internal::BinaryDocument::MAX_DEPTH` deep.
+   */
+  std::unique_ptr<io::DeserializationToken> parse(
+    std::string_view str
+  ) const override;
+};
+
+// -------------------------------------------------------------------------- //
+
+class CBORSerializer: public MimeSerializer {
+public:
+  std::unique_ptr<io::SerializationFormatter> make_formatter(
+    std::ostream& output
+  ) override {
+    return std::make_unique<CBORSerializationFormatter>(output);
+  }
+
+  std::unique_ptr<io::SerializationFormatter> make_formatter(
+    BufferChain& output
+  ) override {
+    return std::make_unique<CBORSerializationFormatter>(output);
+  }
+
+  std::unique_ptr<io::DeserializationParser> make_parser() override {
+    return std::make_unique<CBORDeserializationParser>();
+  }
+};
+
+}
@@ -0,0 +1,340 @@
+#include "lw/mime/cbor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/io/serializer/serialized_value.h"
+#include "lw/io/serializer/testing/tagged_types.h"
+#include "lw/memory/buffer_chain.h"
+
+namespace lw::mime {
+namespace {
+
+using ::lw::io::testing::FieldTagged;
+using ::lw::io::testing::ListTagged;
+using ::lw::io::testing::ObjectTagged;
+
+template <typename T>
+std::string serialize(const T& value) {
+  std::stringstream stream;
+  CBORSerializer cbor;
+  io::Serializer serializer{cbor.make_formatter(stream)};
+  serializer.write(value);
+  return stream.str();
+}
+
+std::unique_ptr<io::DeserializationToken> parse(std::string_view str) {
+  return CBORDeserializationParser{}.parse(str);
+}
+
+// Expected encodings are from RFC 8949 Appendix A where it has them.
+
+TEST(CBORSerializer, Null) {
+  EXPECT_EQ(serialize(nullptr), "\xf6");
+}
+
+TEST(CBORSerializer, Boolean) {
+  EXPECT_EQ(serialize(false), "\xf4");
+  EXPECT_EQ(serialize(true), "\xf5");
+}
+
+TEST(CBORSerializer, Integer) {
+  EXPECT_EQ(serialize(0), std::string(1, '\x00'));
+  EXPECT_EQ(serialize(23), "\x17");
+  EXPECT_EQ(serialize(24), "\x18\x18");
+  EXPECT_EQ(serialize(1000), "\x19\x03\xe8");
+  EXPECT_EQ(serialize(1000000), std::string("\x1a\x00\x0f\x42\x40", 5));
+  EXPECT_EQ(
+    serialize(std::numeric_limits<std::uint64_t>::max()),
+    "\x1b\xff\xff\xff\xff\xff\xff\xff\xff"
+  );
+  EXPECT_EQ(serialize(-1), "\x20");
+  EXPECT_EQ(serialize(-100), "\x38\x63");
+  EXPECT_EQ(serialize(-1000), "\x39\x03\xe7");
+  EXPECT_EQ(
+    serialize(std::numeric_limits<std::int64_t>::min()),
+    "\x3b\x7f\xff\xff\xff\xff\xff\xff\xff"
+  );
+}
+
+TEST(CBORSerializer, Float) {
+  EXPECT_EQ(serialize(1.5), std::string("\xfa\x3f\xc0\x00\x00", 5));
+  EXPECT_EQ(serialize(100000.0f), std::string("\xfa\x47\xc3\x50\x00", 5));
+  EXPECT_EQ(serialize(1.1), "\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a");
+  EXPECT_EQ(
+    serialize(std::numeric_limits<double>::infinity()),
+    std::string("\xfa\x7f\x80\x00\x00", 5)
+  );
+}
+
+TEST(CBORSerializer, String) {
+  EXPECT_EQ(serialize(std::string{}), "\x60");
+  EXPECT_EQ(serialize(std::string{"IETF"}), "\x64IETF");
+  EXPECT_EQ(serialize('a'), "\x61" "a");
+  EXPECT_EQ(
+    serialize(std::string(300, 'x')),
+    "\x79\x01\x2c" + std::string(300, 'x')
+  );
+}
+
+TEST(CBORSerializer, List) {
+  EXPECT_EQ(serialize(std::vector<int>{}), "\x80");
+  EXPECT_EQ(serialize(std::vector<int>{{1, 2, 3}}), "\x83\x01\x02\x03");
+  EXPECT_EQ(
+    serialize(ListTagged{.a = 1, .b = 2, .c = 3}),
+    "\x83\x01\x02\x03"
+  );
+
+  std::vector<int> long_list(25);
+  for (std::size_t i = 0; i < long_list.size(); ++i) long_list[i] = i + 1;
+  std::string expected = "\x98\x19";
+  for (int i = 1; i <= 25; ++i) expected += serialize(i);
+  EXPECT_EQ(serialize(long_list), expected);
+}
+
+TEST(CBORSerializer, NestedList) {
+  EXPECT_EQ(
+    serialize(std::vector<std::vector<int>>{{1}, {2, 3}, {4, 5}}),
+    "\x83\x81\x01\x82\x02\x03\x82\x04\x05"
+  );
+}
+
+TEST(CBORSerializer, Object) {
+  EXPECT_EQ(
+    serialize(std::map<std::string, int>{{"a", 1}, {"b", 2}}),
+    "\xa2\x61" "a" "\x01\x61" "b" "\x02"
+  );
+  EXPECT_EQ(
+    serialize(ObjectTagged{.a = 1, .b = 2, .c = 3}),
+    "\xa3\x61" "a" "\x01\x61" "b" "\x02\x61" "c" "\x03"
+  );
+}
+
+TEST(CBORSerializer, NestedObject) {
+  EXPECT_EQ(
+    serialize(FieldTagged{.a = 1, .b = "x", .c = {.a = 2, .b = 3, .c = 4}}),
+    "\xa3\x61" "a" "\x01\x61" "b" "\x61" "x" "\x61" "c"
+      "\xa3\x61" "a" "\x02\x61" "b" "\x03\x61" "c" "\x04"
+  );
+}
+
+TEST(CBORSerializer, BufferChain) {
+  BufferChain chain{/*block_size=*/8};
+  CBORSerializer cbor;
+  io::Serializer serializer{cbor.make_formatter(chain)};
+  serializer.write(std::vector<std::string>{"abcdefgh", "ijklmnop"});
+  EXPECT_GT(chain.block_count(), 1);
+  EXPECT_EQ(
+    static_cast<std::string_view>(chain.flatten()),
+    "\x82\x68" "abcdefgh" "\x68" "ijklmnop"
+  );
+}
+
+TEST(CBORSerializer, ValueAfterDone) {
+  BufferChain chain;
+  CBORSerializationFormatter formatter{chain};
+  formatter.put_null();
+  EXPECT_THROW(formatter.put_null(), InvalidArgument);
+  EXPECT_THROW(formatter.end_list(), FailedPrecondition);
+}
+
+TEST(CBORSerializer, MaxDepth) {
+  BufferChain chain;
+  CBORSerializationFormatter formatter{chain};
+  const std::size_t max_depth = CBORSerializationFormatter::MAX_DEPTH;
+  for (std::size_t i = 1; i + 1 < max_depth; ++i) formatter.start_list();
+  EXPECT_THROW(formatter.start_list(), ResourceExhausted);
+  EXPECT_EQ(chain.size(), 0);
+}
+
+// -------------------------------------------------------------------------- //
+
+TEST(CBORParser, Null) {
+  EXPECT_TRUE(parse("\xf6")->is_null());
+  EXPECT_TRUE(parse("\xf7")->is_null()); // undefined
+}
+
+TEST(CBORParser, Boolean) {
+  auto token = parse("\xf5");
+  EXPECT_TRUE(token->is_boolean());
+  EXPECT_TRUE(token->get_boolean());
+  EXPECT_FALSE(parse("\xf4")->get_boolean());
+}
+
+TEST(CBORParser, UnsignedInteger) {
+  auto token = parse("\x19\x03\xe8");
+  EXPECT_TRUE(token->is_signed_integer());
+  EXPECT_TRUE(token->is_unsigned_integer());
+  EXPECT_TRUE(token->is_floating_point());
+  EXPECT_FALSE(token->is_string());
+  EXPECT_EQ(token->get_unsigned_integer(), 1000);
+  EXPECT_EQ(token->get_signed_integer(), 1000);
+  EXPECT_EQ(token->get_floating_point(), 1000.0);
+
+  token = parse("\x1b\xff\xff\xff\xff\xff\xff\xff\xff");
+  EXPECT_FALSE(token->is_signed_integer());
+  EXPECT_EQ(
+    token->get_unsigned_integer(),
+    std::numeric_limits<std::uint64_t>::max()
+  );
+}
+
+TEST(CBORParser, NegativeInteger) {
+  auto token = parse("\x39\x03\xe7");
+  EXPECT_TRUE(token->is_signed_integer());
+  EXPECT_FALSE(token->is_unsigned_integer());
+  EXPECT_TRUE(token->is_floating_point());
+  EXPECT_EQ(token->get_signed_integer(), -1000);
+  EXPECT_THROW(token->get_unsigned_integer(), FailedPrecondition);
+
+  EXPECT_EQ(
+    parse("\x3b\x7f\xff\xff\xff\xff\xff\xff\xff")->get_signed_integer(),
+    std::numeric_limits<std::int64_t>::min()
+  );
+  EXPECT_THROW(
+    parse(std::string("\x3b\x80\x00\x00\x00\x00\x00\x00\x00", 9)),
+    InvalidArgument
+  );
+}
+
+TEST(CBORParser, Float) {
+  EXPECT_EQ(parse(std::string("\xf9\x00\x00", 3))->get_floating_point(), 0.0);
+  EXPECT_EQ(parse(std::string("\xf9\x3c\x00", 3))->get_floating_point(), 1.0);
+  EXPECT_EQ(parse("\xf9\x7b\xff")->get_floating_point(), 65504.0);
+  EXPECT_EQ(parse(std::string("\xf9\xc4\x00", 3))->get_floating_point(), -4.0);
+  EXPECT_EQ(
+    parse(std::string("\xf9\x00\x01", 3))->get_floating_point(),
+    5.960464477539063e-8
+  );
+  EXPECT_EQ(
+    parse(std::string("\xf9\x7c\x00", 3))->get_floating_point(),
+    std::numeric_limits<double>::infinity()
+  );
+  EXPECT_EQ(
+    parse(std::string("\xfa\x47\xc3\x50\x00", 5))->get_floating_point(),
+    100000.0
+  );
+  auto token = parse("\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a");
+  EXPECT_TRUE(token->is_floating_point());
+  EXPECT_FALSE(token->is_signed_integer());
+  EXPECT_EQ(token->get_floating_point(), 1.1);
+}
+
+TEST(CBORParser, String) {
+  const std::string cbor = "\x64IETF";
+  auto token = parse(cbor);
+  EXPECT_TRUE(token->is_string());
+  EXPECT_FALSE(token->is_char());
+  EXPECT_EQ(token->size(), 4);
+  EXPECT_EQ(token->get_string(), "IETF");
+  EXPECT_EQ(token->get_string().data(), cbor.data() + 1);
+
+  token = parse("\x61" "a");
+  EXPECT_TRUE(token->is_char());
+  EXPECT_EQ(token->get_char(), 'a');
+
+  EXPECT_EQ(parse("\x44\x01\x02\x03\x04")->get_string(), "\x01\x02\x03\x04");
+}
+
+TEST(CBORParser, ChunkedString) {
+  EXPECT_EQ(
+    parse("\x7f\x65strea\x64ming\xff")->get_string(),
+    "streaming"
+  );
+  EXPECT_THROW(parse("\x7f\x45strea\xff"), InvalidArgument);
+}
+
+TEST(CBORParser, List) {
+  auto token = parse("\x83\x01\x82\x02\x03\x82\x04\x05");
+  EXPECT_TRUE(token->is_list());
+  EXPECT_FALSE(token->is_object());
+  EXPECT_EQ(token->size(), 3);
+  EXPECT_TRUE(token->has_index(2));
+  EXPECT_FALSE(token->has_index(3));
+  EXPECT_FALSE(token->has_key("a"));
+  EXPECT_EQ(token->get_index(0).get_unsigned_integer(), 1);
+  EXPECT_EQ(token->get_index(1).size(), 2);
+  EXPECT_EQ(token->get_index(1).get_index(1).get_unsigned_integer(), 3);
+  EXPECT_EQ(token->get_index(2).get_index(0).get_unsigned_integer(), 4);
+  EXPECT_THROW(token->get_index(3), OutOfRange);
+  EXPECT_THROW(token->get_key("a"), FailedPrecondition);
+}
+
+TEST(CBORParser, IndefiniteList) {
+  auto token = parse("\x9f\x01\x82\x02\x03\x9f\x04\x05\xff\xff");
+  ASSERT_EQ(token->size(), 3);
+  EXPECT_EQ(token->get_index(1).get_index(0).get_unsigned_integer(), 2);
+  EXPECT_EQ(token->get_index(2).size(), 2);
+  EXPECT_EQ(token->get_index(2).get_index(1).get_unsigned_integer(), 5);
+}
+
+TEST(CBORParser, Object) {
+  auto token = parse("\xa2\x61" "a" "\x01\x61" "b" "\x82\x02\x03");
+  EXPECT_TRUE(token->is_object());
+  EXPECT_EQ(token->size(), 2);
+  EXPECT_TRUE(token->has_key("a"));
+  EXPECT_TRUE(token->has_key("b"));
+  EXPECT_FALSE(token->has_key("c"));
+  EXPECT_FALSE(token->has_index(0));
+  EXPECT_EQ(token->get_key("a").get_unsigned_integer(), 1);
+  EXPECT_EQ(token->get_key("b").get_index(1).get_unsigned_integer(), 3);
+  EXPECT_THROW(token->get_key("c"), OutOfRange);
+
+  // Keys which are not strings are skipped over.
+  token = parse("\xa2\x01\x02\x61" "a" "\x03");
+  EXPECT_EQ(token->size(), 2);
+  EXPECT_EQ(token->get_key("a").get_unsigned_integer(), 3);
+}
+
+TEST(CBORParser, IndefiniteObject) {
+  auto token = parse("\xbf\x63" "Fun" "\xf5\x63" "Amt" "\x21\xff");
+  EXPECT_TRUE(token->get_key("Fun").get_boolean());
+  EXPECT_EQ(token->get_key("Amt").get_signed_integer(), -2);
+  EXPECT_THROW(parse("\xbf\x63" "Fun" "\xff"), InvalidArgument);
+}
+
+TEST(CBORParser, Tag) {
+  auto token = parse("\xc1\x1a\x51\x4b\x67\xb0");
+  EXPECT_EQ(token->get_unsigned_integer(), 1363896240);
+}
+
+TEST(CBORParser, Malformed) {
+  EXPECT_THROW(parse(""), InvalidArgument);
+  EXPECT_THROW(parse("\x18"), InvalidArgument);
+  EXPECT_THROW(parse("\x64IET"), InvalidArgument);
+  EXPECT_THROW(parse("\x83\x01\x02"), InvalidArgument);
+  EXPECT_THROW(parse("\x9f\x01"), InvalidArgument);
+  EXPECT_THROW(parse("\x01\x02"), InvalidArgument);
+  EXPECT_THROW(parse("\xff"), InvalidArgument);
+  EXPECT_THROW(parse("\x1c"), InvalidArgument);
+  EXPECT_THROW(parse("\x9b\xff\xff\xff\xff\xff\xff\xff\xff"), InvalidArgument);
+  EXPECT_THROW(
+    parse(std::string(CBORSerializationFormatter::MAX_DEPTH, '\x81') + "\x01"),
+    InvalidArgument
+  );
+}
+
+TEST(CBORParser, RoundTrip) {
+  const std::string cbor =
+    serialize(FieldTagged{.a = -7, .b = "bee", .c = {.a = 1, .b = 2, .c = 3}});
+  auto token = parse(cbor);
+  io::SerializedValue value{*token};
+  EXPECT_EQ(value.get<int>("a"), -7);
+  EXPECT_EQ(value.get<std::string_view>("b"), "bee");
+  EXPECT_EQ(
+    value.get<ObjectTagged>("c"),
+    (ObjectTagged{.a = 1, .b = 2, .c = 3})
+  );
+}
+
+}
+}
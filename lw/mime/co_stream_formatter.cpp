@@ -0,0 +1,43 @@
+#include "lw/mime/co_stream_formatter.h"
+
+#include <cstddef>
+
+#include "lw/co/future.h"
+#include "lw/err/canonical.h"
+#include "lw/io/co/co.h"
+#include "lw/memory/buffer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/mime.h"
+
+namespace lw::mime {
+
+CoStreamFormatter::CoStreamFormatter(
+  io::CoStream& stream,
+  MimeSerializer& serializer,
+  std::size_t chunk_size
+):
+  _stream{stream},
+  _chunk_size{chunk_size},
+  _output{chunk_size},
+  _formatter{serializer.make_formatter(_output)}
+{}
+
+co::Future<void> CoStreamFormatter::flush() {
+  for (std::size_t i = 0; i < _output.block_count(); ++i) {
+    // Streams may take less than they are given, so keep writing until the
+    // whole block is gone.
+    Buffer remaining = _output.block(i);
+    while (!remaining.empty()) {
+      const std::size_t written = co_await _stream.write(remaining);
+      if (written == 0) {
+        throw Unavailable() << "Stream stopped taking serialized output.";
+      }
+      _bytes_sent += written;
+      remaining = remaining.trim_prefix(written);
+    }
+  }
+  _output.clear();
+  co_await _stream.flush();
+}
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "lw/co/future.h"
+#include "lw/io/co/co.h"
+#include "lw/io/serializer/formatter.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/mime.h"
+
+namespace lw::mime {
+
+/**
+ * Writes a MIME serializer's output to an `io::CoStream` in chunks.
+ *
+ * Output is buffered until a chunk of it has built up, at which point the
+ * formatter is `full` and asynchronous writes with `io::Serializer` wait while
+ * it is sent. Writing a generated list then only holds a chunk or so in memory
+ * at a time, and the stream paces how fast the list is generated.
+ *
+ * ```cpp
+ *  io::Serializer serializer{
+ *    std::make_unique<CoStreamFormatter>(conn, json_serializer)
+ *  };
+ *  co_await serializer.write(generate_rows());
+ *  co_await serializer.flush();
+ * ```
+ *
+ * Formats which can only write a list or object once they know its size, such
+ * as CBOR and MessagePack, produce nothing until the whole value is written.
+ * Those are sent in one go by the final `flush`.
+ */
+class CoStreamFormatter: public io::SerializationFormatter {
+public:
+  static constexpr std::size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+  /**
+   * @param stream
+   *  Where the output is sent. It must outlive the formatter.
+   * @param serializer
+   *  The MIME type's serializer, which makes the formatter for the output.
+   * @param chunk_size
+   *  How much output to buffer before the formatter is full.
+   */
+  CoStreamFormatter(
+    io::CoStream& stream,
+    MimeSerializer& serializer,
+    std::size_t chunk_size = DEFAULT_CHUNK_SIZE
+  );
+
+  void put_null() override { _formatter->put_null(); }
+  void put_boolean(bool boolean) override { _formatter->put_boolean(boolean); }
+  void put_char(char c) override { _formatter->put_char(c); }
+  void put_signed_integer(std::int64_t number) override {
+    _formatter->put_signed_integer(number);
+  }
+  void put_unsigned_integer(std::uint64_t number) override {
+    _formatter->put_unsigned_integer(number);
+  }
+  void put_floating_point(double number) override {
+    _formatter->put_floating_point(number);
+  }
+  void put_floating_point(float number) override {
+    _formatter->put_floating_point(number);
+  }
+  void put_string(std::string_view str) override {
+    _formatter->put_string(str);
+  }
+
+  void start_list() override { _formatter->start_list(); }
+  void end_list() override { _formatter->end_list(); }
+  void start_object() override { _formatter->start_object(); }
+  void end_object() override { _formatter->end_object(); }
+  void start_pair_key() override { _formatter->start_pair_key(); }
+  void end_pair_key() override { _formatter->end_pair_key(); }
+  void end_pair() override { _formatter->end_pair(); }
+
+  bool full() const override { return _output.size() >= _chunk_size; }
+
+  /**
+   * Writes everything buffered so far to the stream and flushes it, resolving
+   * once the stream has taken all of it.
+   */
+  co::Future<void> flush() override;
+
+  /**
+   * Total bytes written to the stream.
+   */
+  std::size_t bytes_sent() const { return _bytes_sent; }
+
+private:
+  io::CoStream& _stream;
+  std::size_t _chunk_size;
+  std::size_t _bytes_sent = 0;
+  BufferChain _output;
+  std::unique_ptr<io::SerializationFormatter> _formatter;
+};
+
+}
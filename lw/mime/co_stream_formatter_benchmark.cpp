@@ -0,0 +1,172 @@
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/generator.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/io/co/co.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/co_stream_formatter.h"
+#include "lw/mime/json.h"
+
+namespace lw::mime {
+namespace {
+
+struct Row {
+  std::uint64_t id;
+  std::string name;
+  double score;
+};
+
+struct Rows {
+  std::vector<Row> rows;
+};
+
+}
+}
+
+template <>
+struct lw::io::Serialize<lw::mime::Row> {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::Row& value) {
+    serializer.write("id", value.id);
+    serializer.write("name", value.name);
+    serializer.write("score", value.score);
+  }
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::Rows> {
+  typedef ListTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::Rows& value) {
+    for (const lw::mime::Row& row : value.rows) serializer.write(row);
+  }
+};
+
+namespace lw::mime {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+co::Generator<Row> generate_rows(std::size_t count) {
+  for (std::size_t i = 0; i < count; ++i) {
+    Row row{
+      .id = i * 7919,
+      .name = "user_" + std::to_string(i),
+      .score = (i % 100) + 0.25
+    };
+    co_yield row;
+  }
+}
+
+/**
+ * Stands in for a socket: each write waits a scheduler tick, then discards
+ * what it was given, noting when the first byte arrived.
+ */
+class DiscardStream: public io::CoStream {
+public:
+  bool eof() const override { return false; }
+  bool good() const override { return true; }
+  void close() override {}
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return co::make_resolved_future(std::size_t{0});
+  }
+
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    co_await co::next_tick();
+    if (!bytes) first_byte = Clock::now();
+    bytes += buffer.size();
+    co_return buffer.size();
+  }
+
+  std::size_t bytes = 0;
+  Clock::time_point first_byte;
+};
+
+double peak_rss_mib() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0; // ru_maxrss is in KiB on Linux.
+}
+
+co::Task stream_rows(DiscardStream& stream, std::size_t count) {
+  JSONSerializer json;
+  io::Serializer serializer{std::make_unique<CoStreamFormatter>(stream, json)};
+  co_await serializer.write(generate_rows(count));
+  co_await serializer.flush();
+}
+
+/**
+ * Builds the whole list, serializes it and only then writes it, the way a
+ * handler sending a complete body does.
+ */
+co::Task buffer_rows(DiscardStream& stream, std::size_t count) {
+  Rows rows;
+  co::Generator<Row> generator = generate_rows(count);
+  while (generator.next()) rows.rows.push_back(generator.value());
+
+  BufferChain body;
+  io::Serializer serializer{JSONSerializer{}.make_formatter(body)};
+  serializer.write(rows);
+  for (std::size_t i = 0; i < body.block_count(); ++i) {
+    co_await stream.write(body.block(i));
+  }
+}
+
+template <typename Func>
+void run_rows(benchmark::State& state, Func&& write_rows) {
+  const std::size_t count = state.range(0);
+  std::size_t bytes = 0;
+  double first_byte_ms = 0;
+  for (auto _ : state) {
+    DiscardStream stream;
+    const Clock::time_point start = Clock::now();
+    co::Scheduler::this_thread().schedule(write_rows(stream, count));
+    co::Scheduler::this_thread().run();
+    bytes = stream.bytes;
+    first_byte_ms = std::chrono::duration<double, std::milli>(
+      stream.first_byte - start
+    ).count();
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["first_byte_ms"] = first_byte_ms;
+  state.counters["peak_rss_MiB"] = peak_rss_mib();
+}
+
+/**
+ * Streams `state.range(0)` generated rows as a JSON list.
+ */
+void BM_StreamedListResponse(benchmark::State& state) {
+  run_rows(state, stream_rows);
+}
+BENCHMARK(BM_StreamedListResponse)
+  ->ArgName("rows")->Arg(1'000'000)
+  ->Iterations(1)->Unit(benchmark::kMillisecond);
+
+/**
+ * For comparison, buffers the whole list before sending it. Peak RSS only ever
+ * grows, so this runs after the streaming benchmark.
+ */
+void BM_BufferedListResponse(benchmark::State& state) {
+  run_rows(state, buffer_rows);
+}
+BENCHMARK(BM_BufferedListResponse)
+  ->ArgName("rows")->Arg(1'000'000)
+  ->Iterations(1)->Unit(benchmark::kMillisecond);
+
+}
+}
@@ -0,0 +1,136 @@
+#include "lw/mime/co_stream_formatter.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/co/future.h"
+#include "lw/co/generator.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/io/co/co.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer.h"
+#include "lw/mime/cbor.h"
+#include "lw/mime/json.h"
+
+namespace lw::mime {
+namespace {
+
+/**
+ * Takes at most `max_write` bytes per write, noting how many values had been
+ * generated when each write was made.
+ */
+class RecordingStream: public io::CoStream {
+public:
+  explicit RecordingStream(const std::size_t& generated):
+    _generated{generated}
+  {}
+
+  bool eof() const override { return false; }
+  bool good() const override { return true; }
+  void close() override {}
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return co::make_resolved_future(std::size_t{0});
+  }
+
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    co_await co::next_tick();
+    const std::size_t size = std::min(buffer.size(), max_write);
+    data += static_cast<std::string_view>(buffer).substr(0, size);
+    generated_at_write.push_back(_generated);
+    co_return size;
+  }
+
+  std::size_t max_write = 16;
+  std::string data;
+  std::vector<std::size_t> generated_at_write;
+
+private:
+  const std::size_t& _generated;
+};
+
+co::Generator<int> count_to(int n, std::size_t& generated) {
+  for (int i = 1; i <= n; ++i) {
+    ++generated;
+    co_yield i;
+  }
+}
+
+template <typename Func>
+void run(Func&& coroutine) {
+  co::Scheduler::this_thread().schedule(std::forward<Func>(coroutine));
+  co::Scheduler::this_thread().run();
+}
+
+TEST(CoStreamFormatter, StreamsGeneratedLists) {
+  std::size_t generated = 0;
+  RecordingStream stream{generated};
+  JSONSerializer json;
+  run([&]() -> co::Task {
+    auto formatter = std::make_unique<CoStreamFormatter>(
+      stream, json, /*chunk_size=*/32
+    );
+    CoStreamFormatter& streamer = *formatter;
+    io::Serializer serializer{std::move(formatter)};
+    co_await serializer.write(count_to(1000, generated));
+    co_await serializer.flush();
+    EXPECT_EQ(streamer.bytes_sent(), stream.data.size());
+  });
+
+  std::stringstream expected;
+  expected << '[';
+  for (int i = 1; i <= 1000; ++i) expected << (i > 1 ? "," : "") << i;
+  expected << ']';
+  EXPECT_EQ(stream.data, expected.str());
+
+  // Output is sent as it is made, rather than all at the end.
+  ASSERT_GT(stream.generated_at_write.size(), 2);
+  EXPECT_LT(stream.generated_at_write.front(), 32);
+  const std::size_t middle = stream.generated_at_write.size() / 2;
+  EXPECT_LT(stream.generated_at_write[middle], 1000);
+}
+
+TEST(CoStreamFormatter, NotFullUntilChunkBuffered) {
+  std::size_t generated = 0;
+  RecordingStream stream{generated};
+  JSONSerializer json;
+  CoStreamFormatter formatter{stream, json, /*chunk_size=*/8};
+  formatter.start_list();
+  formatter.put_string("abc");
+  EXPECT_FALSE(formatter.full());
+  formatter.put_string("def");
+  EXPECT_TRUE(formatter.full());
+  EXPECT_TRUE(stream.data.empty());
+}
+
+TEST(CoStreamFormatter, SizedFormatsSendOnFlush) {
+  std::size_t generated = 0;
+  RecordingStream stream{generated};
+  CBORSerializer cbor;
+  run([&]() -> co::Task {
+    io::Serializer serializer{
+      std::make_unique<CoStreamFormatter>(stream, cbor, /*chunk_size=*/4)
+    };
+    co_await serializer.write(count_to(30, generated));
+    EXPECT_TRUE(stream.data.empty());
+    co_await serializer.flush();
+  });
+
+  std::string expected = "\x98\x1e";
+  for (int i = 1; i <= 23; ++i) expected += static_cast<char>(i);
+  for (int i = 24; i <= 30; ++i) {
+    expected += '\x18';
+    expected += static_cast<char>(i);
+  }
+  EXPECT_EQ(stream.data, expected);
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lw::mime::internal {
+
+/**
+ * Writes the low `Bytes` bytes of `value` to `out`, most significant first.
+ *
+ * @return
+ *  One past the last byte written.
+ */
+template <std::size_t Bytes>
+constexpr char* write_big_endian(std::uint64_t value, char* out) {
+  for (std::size_t i = 0; i < Bytes; ++i) {
+    out[i] = static_cast<char>(value >> (8 * (Bytes - 1 - i)));
+  }
+  return out + Bytes;
+}
+
+/**
+ * Reads `Bytes` bytes from `in`, most significant first.
+ */
+template <std::size_t Bytes>
+constexpr std::uint64_t read_big_endian(const char* in) {
+  std::uint64_t value = 0;
+  for (std::size_t i = 0; i < Bytes; ++i) {
+    value = (value << 8) | static_cast<std::uint8_t>(in[i]);
+  }
+  return value;
+}
+
+}
@@ -0,0 +1,219 @@
+#include "lw/mime/internal/binary_document.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <string_view>
+
+#include "lw/err/canonical.h"
+
+namespace lw::mime::internal {
+namespace {
+
+using Kind = BinaryDocument::Kind;
+
+std::string_view kind_name(Kind kind) {
+  switch (kind) {
+    case Kind::NUL: return "NUL";
+    case Kind::BOOLEAN: return "BOOLEAN";
+    case Kind::UNSIGNED:
+    case Kind::NEGATIVE: return "INTEGER";
+    case Kind::FLOAT: return "FLOAT";
+    case Kind::STRING: return "STRING";
+    case Kind::LIST: return "LIST";
+    case Kind::OBJECT: return "OBJECT";
+  }
+  return "UNKNOWN";
+}
+
+std::string_view to_string(const BinaryDocument::Entry& entry) {
+  return {entry.string, entry.size};
+}
+
+}
+
+std::size_t BinaryValue::size() const {
+  const BinaryDocument::Entry& entry = _document->entry(_index);
+  if (entry.kind == Kind::STRING || entry.kind == Kind::LIST ||
+      entry.kind == Kind::OBJECT) {
+    return entry.size;
+  }
+  throw FailedPrecondition()
+      << "Token is " << kind_name(entry.kind)
+      << " which does not have a size.";
+}
+
+bool BinaryValue::is_null() const {
+  return _document->entry(_index).kind == Kind::NUL;
+}
+
+bool BinaryValue::is_boolean() const {
+  return _document->entry(_index).kind == Kind::BOOLEAN;
+}
+
+bool BinaryValue::is_char() const {
+  const BinaryDocument::Entry& entry = _document->entry(_index);
+  return entry.kind == Kind::STRING && entry.size == 1;
+}
+
+bool BinaryValue::is_signed_integer() const {
+  const BinaryDocument::Entry& entry = _document->entry(_index);
+  return entry.kind == Kind::NEGATIVE || (
+    entry.kind == Kind::UNSIGNED &&
+    entry.unsigned_integer <= std::numeric_limits<std::int64_t>::max()
+  );
+}
+
+bool BinaryValue::is_unsigned_integer() const {
+  return _document->entry(_index).kind == Kind::UNSIGNED;
+}
+
+bool BinaryValue::is_floating_point() const {
+  const Kind kind = _document->entry(_index).kind;
+  return kind == Kind::UNSIGNED || kind == Kind::NEGATIVE ||
+    kind == Kind::FLOAT;
+}
+
+bool BinaryValue::is_string() const {
+  return _document->entry(_index).kind == Kind::STRING;
+}
+
+bool BinaryValue::is_list() const {
+  return _document->entry(_index).kind == Kind::LIST;
+}
+
+bool BinaryValue::is_object() const {
+  return _document->entry(_index).kind == Kind::OBJECT;
+}
+
+bool BinaryValue::get_boolean() const {
+  if (!is_boolean()) _wrong_type("BOOLEAN");
+  return _document->entry(_index).boolean;
+}
+
+char BinaryValue::get_char() const {
+  if (!is_char()) _wrong_type("CHAR");
+  return *_document->entry(_index).string;
+}
+
+std::int64_t BinaryValue::get_signed_integer() const {
+  if (!is_signed_integer()) _wrong_type("INTEGER");
+  return _document->entry(_index).signed_integer;
+}
+
+std::uint64_t BinaryValue::get_unsigned_integer() const {
+  if (!is_unsigned_integer()) _wrong_type("unsigned INTEGER");
+  return _document->entry(_index).unsigned_integer;
+}
+
+double BinaryValue::get_floating_point() const {
+  const BinaryDocument::Entry& entry = _document->entry(_index);
+  switch (entry.kind) {
+    case Kind::UNSIGNED: return static_cast<double>(entry.unsigned_integer);
+    case Kind::NEGATIVE: return static_cast<double>(entry.signed_integer);
+    case Kind::FLOAT: return entry.floating_point;
+    default: _wrong_type("FLOAT");
+  }
+}
+
+std::string_view BinaryValue::get_string() const {
+  if (!is_string()) _wrong_type("STRING");
+  return to_string(_document->entry(_index));
+}
+
+bool BinaryValue::has_index(std::size_t idx) const {
+  return is_list() && idx < _document->entry(_index).size;
+}
+
+const io::DeserializationToken& BinaryValue::get_index(std::size_t idx) const {
+  if (!is_list()) _wrong_type("LIST");
+  const std::size_t count = _document->entry(_index).size;
+  if (idx >= count) {
+    throw OutOfRange() << "Index " << idx << " is larger than this list of "
+                       << count;
+  }
+  return _elements()[idx];
+}
+
+bool BinaryValue::has_key(std::string_view key) const {
+  return is_object() && _find(key);
+}
+
+const io::DeserializationToken& BinaryValue::get_key(
+  std::string_view key
+) const {
+  if (!is_object()) _wrong_type("OBJECT");
+  const BinaryValue* value = _find(key);
+  if (!value) {
+    throw OutOfRange() << "Key " << key << " is not present in this object.";
+  }
+  return *value;
+}
+
+void BinaryValue::_wrong_type(std::string_view expected) const {
+  throw FailedPrecondition()
+      << "Token is " << kind_name(_document->entry(_index).kind) << ", not "
+      << expected;
+}
+
+const BinaryValue* BinaryValue::_elements() const {
+  if (_children) return _children;
+
+  const std::size_t count = _document->entry(_index).size;
+  const bool object = is_object();
+  BinaryValue* elements =
+    _document->arena().allocate_array<BinaryValue>(count);
+  std::uint32_t i = _index + 1;
+  for (std::size_t k = 0; k < count; ++k) {
+    if (object) i = _document->next(i); // Skip over the key.
+    new (&elements[k]) BinaryValue{*_document, i};
+    i = _document->next(i);
+  }
+  _children = elements;
+  return _children;
+}
+
+const BinaryValue* BinaryValue::_find(std::string_view key) const {
+  const std::size_t count = _document->entry(_index).size;
+  std::uint32_t i = _index + 1;
+  for (std::size_t k = 0; k < count; ++k) {
+    const BinaryDocument::Entry& candidate = _document->entry(i);
+    if (candidate.kind == Kind::STRING && to_string(candidate) == key) {
+      return &_elements()[k];
+    }
+    i = _document->next(_document->next(i));
+  }
+  return nullptr;
+}
+
+// -------------------------------------------------------------------------- //
+
+void BinaryDocument::add_string(std::string_view str) {
+  if (str.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw InvalidArgument() << "Strings of 4GiB or more are not supported.";
+  }
+  Entry& entry = _add(Kind::STRING);
+  entry.string = str.data();
+  entry.size = static_cast<std::uint32_t>(str.size());
+}
+
+std::uint32_t BinaryDocument::start_container(Kind kind) {
+  _add(kind);
+  return static_cast<std::uint32_t>(_entries.size() - 1);
+}
+
+void BinaryDocument::end_container(std::uint32_t index, std::uint32_t size) {
+  Entry& entry = _entries[index];
+  entry.end = static_cast<std::uint32_t>(_entries.size());
+  entry.size = size;
+}
+
+BinaryDocument::Entry& BinaryDocument::_add(Kind kind) {
+  if (_entries.size() == std::numeric_limits<std::uint32_t>::max()) {
+    throw ResourceExhausted() << "Too many values in binary document.";
+  }
+  return _entries.emplace_back(Entry{.unsigned_integer = 0, .kind = kind});
+}
+
+}
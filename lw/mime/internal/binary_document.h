@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/arena.h"
+
+namespace lw::mime::internal {
+
+class BinaryDocument;
+
+/**
+ * A view of one value decoded from a binary format like CBOR or MessagePack.
+ * Views of list and object elements are made in the document's arena when
+ * first indexed.
+ */
+class BinaryValue: public io::DeserializationToken {
+public:
+  BinaryValue(const BinaryDocument& document, std::uint32_t index):
+    _document{&document},
+    _index{index}
+  {}
+
+  std::size_t size() const override;
+
+  bool is_null() const override;
+  bool is_boolean() const override;
+  bool is_char() const override;
+  bool is_signed_integer() const override;
+  bool is_unsigned_integer() const override;
+  bool is_floating_point() const override;
+  bool is_string() const override;
+  bool is_list() const override;
+  bool is_object() const override;
+
+  bool get_boolean() const override;
+  char get_char() const override;
+  std::int64_t get_signed_integer() const override;
+  std::uint64_t get_unsigned_integer() const override;
+  double get_floating_point() const override;
+  std::string_view get_string() const override;
+
+  bool has_index(std::size_t idx) const override;
+  const io::DeserializationToken& get_index(std::size_t idx) const override;
+
+  bool has_key(std::string_view key) const override;
+  const io::DeserializationToken& get_key(std::string_view key) const override;
+
+private:
+  [[noreturn]] void _wrong_type(std::string_view expected) const;
+  const BinaryValue* _elements() const;
+  const BinaryValue* _find(std::string_view key) const;
+
+  const BinaryDocument* _document;
+  std::uint32_t _index;
+  mutable const BinaryValue* _children = nullptr;
+};
+
+/**
+ * The root value of a decoded document, holding every value as a flat array of
+ * 16-byte entries in document order, and the arena for their views.
+ *
+ * Format decoders add each value with the `add_*` methods. Lists and objects
+ * are added with `start_container` before any of their elements, and closed
+ * with `end_container` once the last is added. Object elements alternate
+ * between keys and values.
+ *
+ * Strings are views into the source wherever the format stores them whole, so
+ * the source must outlive the document.
+ */
+class BinaryDocument: public BinaryValue {
+public:
+  enum class Kind: std::uint8_t {
+    NUL,
+    BOOLEAN,
+    UNSIGNED,
+    NEGATIVE,
+    FLOAT,
+    STRING,
+    LIST,
+    OBJECT
+  };
+
+  struct Entry {
+    union {
+      bool boolean;
+      std::uint64_t unsigned_integer;
+      std::int64_t signed_integer;
+      double floating_point;
+      const char* string;
+
+      /**
+       * For lists and objects, the index of the entry after their last
+       * element.
+       */
+      std::uint32_t end;
+    };
+
+    /**
+     * The length of a string, the number of elements in a list, or the number
+     * of pairs in an object.
+     */
+    std::uint32_t size;
+    Kind kind;
+  };
+
+  /**
+   * Nesting limit for decoders to enforce, matching the formatters.
+   */
+  static constexpr std::size_t MAX_DEPTH = 256;
+
+  BinaryDocument(): BinaryValue{*this, 0} {}
+  BinaryDocument(const BinaryDocument&) = delete;
+  BinaryDocument& operator=(const BinaryDocument&) = delete;
+
+  const Entry& entry(std::uint32_t index) const { return _entries[index]; }
+
+  /**
+   * The index of the entry after the value at `index`, skipping over all of
+   * its elements if it is a list or object.
+   */
+  std::uint32_t next(std::uint32_t index) const {
+    const Entry& e = _entries[index];
+    return e.kind == Kind::LIST || e.kind == Kind::OBJECT ? e.end : index + 1;
+  }
+
+  Arena& arena() const { return _arena; }
+
+  void add_null() { _add(Kind::NUL); }
+  void add_boolean(bool boolean) { _add(Kind::BOOLEAN).boolean = boolean; }
+  void add_unsigned(std::uint64_t number) {
+    _add(Kind::UNSIGNED).unsigned_integer = number;
+  }
+
+  /**
+   * Adds a negative number, or a non-negative one as unsigned.
+   */
+  void add_signed(std::int64_t number) {
+    if (number >= 0) {
+      add_unsigned(static_cast<std::uint64_t>(number));
+    } else {
+      _add(Kind::NEGATIVE).signed_integer = number;
+    }
+  }
+
+  void add_float(double number) { _add(Kind::FLOAT).floating_point = number; }
+
+  /**
+   * Adds a string which views memory outliving the document.
+   *
+   * @throw InvalidArgument
+   *  If the string is 4GiB or larger.
+   */
+  void add_string(std::string_view str);
+
+  /**
+   * Adds a string assembled while decoding, such as from chunks, storing it in
+   * the document.
+   */
+  void add_string(std::string str) {
+    add_string(std::string_view{_strings.emplace_back(std::move(str))});
+  }
+
+  /**
+   * Adds a list or object, returning its index for `end_container`.
+   */
+  std::uint32_t start_container(Kind kind);
+
+  /**
+   * Closes the list or object at `index` after its last element.
+   *
+   * @param size
+   *  The number of elements in the list, or pairs in the object.
+   */
+  void end_container(std::uint32_t index, std::uint32_t size);
+
+private:
+  Entry& _add(Kind kind);
+
+  std::vector<Entry> _entries;
+  std::deque<std::string> _strings;
+  mutable Arena _arena{16 * 1024};
+};
+
+}
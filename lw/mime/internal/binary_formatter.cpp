@@ -0,0 +1,140 @@
+#include "lw/mime/internal/binary_formatter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <experimental/source_location>
+#include <ostream>
+#include <string_view>
+
+#include "lw/err/canonical.h"
+#include "lw/memory/buffer_chain.h"
+
+namespace lw::mime::internal {
+
+BinaryFormatter::BinaryFormatter(BufferChain& output): _output{output} {}
+
+BinaryFormatter::BinaryFormatter(std::ostream& output):
+  _output{_stream_buffer},
+  _stream{&output}
+{}
+
+void BinaryFormatter::start_list() {
+  _start_container(Container::LIST, State::LIST);
+}
+
+void BinaryFormatter::end_list() {
+  _end_container(Container::LIST, State::LIST);
+}
+
+void BinaryFormatter::start_object() {
+  _start_container(Container::OBJECT, State::OBJECT);
+}
+
+void BinaryFormatter::end_object() {
+  _end_container(Container::OBJECT, State::OBJECT);
+}
+
+void BinaryFormatter::start_pair_key() {
+  if (_top().state != State::OBJECT) {
+    throw FailedPrecondition()
+        << "Unexpected start of object key while formatting.";
+  }
+  _push(State::KEY);
+}
+
+void BinaryFormatter::end_pair_key() {
+  if (_top().state != State::KEY_ADDED) {
+    throw FailedPrecondition()
+        << "Unexpected end of object key while formatting.";
+  }
+  _levels[_depth].state = State::PAIR_VALUE;
+}
+
+void BinaryFormatter::end_pair() {
+  if (_top().state != State::OBJECT) {
+    throw FailedPrecondition()
+        << "Unexpected end of object value while formatting.";
+  }
+  ++_gaps[_top().gap].size;
+}
+
+void BinaryFormatter::check_can_add_value(
+    const std::experimental::source_location& loc) {
+  const State state = _top().state;
+  if (state != State::VALUE && state != State::LIST && state != State::KEY &&
+      state != State::PAIR_VALUE) {
+    throw InvalidArgument(loc) << "Unexpected value while formatting.";
+  }
+}
+
+void BinaryFormatter::value_added() {
+  switch (_top().state) {
+    case State::LIST: {
+      ++_gaps[_top().gap].size;
+      break;
+    }
+    case State::KEY: {
+      _levels[_depth].state = State::KEY_ADDED;
+      break;
+    }
+    case State::VALUE:
+    case State::PAIR_VALUE: {
+      --_depth;
+      break;
+    }
+    default: {
+      throw Internal() << "Invalid state reached for adding a value.";
+    }
+  }
+  if (_depth == 0) _finish();
+}
+
+void BinaryFormatter::_push(State state) {
+  if (_depth + 1 == MAX_DEPTH) {
+    throw ResourceExhausted()
+        << "Nested deeper than " << MAX_DEPTH << " while formatting.";
+  }
+  _levels[++_depth] = {.state = state, .gap = _gaps.size()};
+}
+
+void BinaryFormatter::_start_container(Container container, State state) {
+  check_can_add_value();
+  _push(state);
+  _gaps.push_back({.offset = _body.size(), .container = container, .size = 0});
+}
+
+void BinaryFormatter::_end_container(Container container, State state) {
+  if (_top().state != state) {
+    throw FailedPrecondition()
+        << "Unexpected end of "
+        << (container == Container::LIST ? "list" : "object")
+        << " while formatting.";
+  }
+  --_depth;
+  value_added();
+}
+
+void BinaryFormatter::_finish() {
+  std::string_view body = _body;
+  std::size_t written = 0;
+  char head[CONTAINER_HEAD_SIZE];
+  for (const Gap& gap : _gaps) {
+    _output.append(body.substr(written, gap.offset - written));
+    const char* end = write_container_head(gap.container, gap.size, head);
+    _output.append({head, static_cast<std::size_t>(end - head)});
+    written = gap.offset;
+  }
+  _output.append(body.substr(written));
+  _body.clear();
+  _gaps.clear();
+
+  if (_stream) {
+    for (std::size_t i = 0; i < _output.block_count(); ++i) {
+      const std::string_view block = _output.block(i);
+      _stream->write(block.data(), block.size());
+    }
+    _output.clear();
+  }
+}
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <experimental/source_location>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lw/io/serializer/formatter.h"
+#include "lw/memory/buffer_chain.h"
+
+namespace lw::mime::internal {
+
+/**
+ * Base for binary formats, like CBOR and MessagePack, which prefix lists and
+ * objects with their number of elements.
+ *
+ * Those numbers are only known once a list or object ends, so each value is
+ * encoded into a contiguous body with a gap left wherever a list or object
+ * starts. Once the top-level value is complete the body is copied to the
+ * output in one pass, filling every gap with the head from
+ * `write_container_head`. Whole values are therefore held in memory until they
+ * are complete.
+ *
+ * Subclasses write scalars with `append`, between `check_can_add_value` and
+ * `value_added`.
+ */
+class BinaryFormatter: public io::SerializationFormatter {
+public:
+  static constexpr std::size_t MAX_DEPTH = 256;
+
+  /**
+   * Room needed for any head written by `write_container_head`.
+   */
+  static constexpr std::size_t CONTAINER_HEAD_SIZE = 9;
+
+  /**
+   * Appends each complete value to `output`, which must outlive the formatter.
+   */
+  explicit BinaryFormatter(BufferChain& output);
+
+  /**
+   * Writes each complete value to `output`.
+   */
+  explicit BinaryFormatter(std::ostream& output);
+
+  void start_list() override;
+  void end_list() override;
+  void start_object() override;
+  void end_object() override;
+  void start_pair_key() override;
+  void end_pair_key() override;
+  void end_pair() override;
+
+protected:
+  enum class Container: std::uint8_t {
+    LIST,
+    OBJECT
+  };
+
+  /**
+   * Writes the head of a list of `size` values or an object of `size` pairs.
+   *
+   * @param out
+   *  Where to write the head, with room for `CONTAINER_HEAD_SIZE` bytes.
+   *
+   * @return
+   *  One past the last byte written to `out`.
+   */
+  virtual char* write_container_head(
+    Container container,
+    std::uint64_t size,
+    char* out
+  ) const = 0;
+
+  void append(std::string_view bytes) { _body.append(bytes); }
+
+  void check_can_add_value(
+    const std::experimental::source_location& loc =
+      std::experimental::source_location::current()
+  );
+  void value_added();
+
+private:
+  enum class State: std::uint8_t {
+    /**
+     * Below the top-level value, which is done once this is the top state.
+     */
+    DONE,
+    VALUE,
+    LIST,
+    OBJECT,
+    KEY,
+    KEY_ADDED,
+    PAIR_VALUE
+  };
+
+  struct Level {
+    State state;
+
+    /**
+     * The gap for the head of this level's list or object.
+     */
+    std::size_t gap;
+  };
+
+  struct Gap {
+    std::size_t offset;
+    Container container;
+    std::uint64_t size;
+  };
+
+  const Level& _top() const { return _levels[_depth]; }
+  void _push(State state);
+  void _start_container(Container container, State state);
+  void _end_container(Container container, State state);
+  void _finish();
+
+  BufferChain _stream_buffer;
+  BufferChain& _output;
+  std::ostream* _stream = nullptr;
+  std::string _body;
+  std::vector<Gap> _gaps;
+  std::size_t _depth = 1;
+  std::array<Level, MAX_DEPTH> _levels = {
+    Level{.state = State::DONE},
+    Level{.state = State::VALUE}
+  };
+};
+
+}
@@ -0,0 +1,433 @@
+#include "lw/mime/internal/json_on_demand.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/arena.h"
+#include "lw/mime/internal/json_scalars.h"
+#include "lw/mime/internal/json_structural_index.h"
+#include "lw/mime/internal/json_tape.h"
+
+namespace lw::mime::internal {
+namespace {
+
+using Tag = JSONTape::Tag;
+
+bool is_json_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/**
+ * A document and the offsets of its tokens, as found by
+ * `index_json_structure`. Tokens are referred to by their position in the
+ * index.
+ */
+class StructuralIndex {
+public:
+  explicit StructuralIndex(std::string_view json):
+    _json{json},
+    _offsets{index_json_structure(json)}
+  {}
+
+  std::size_t size() const { return _offsets.size(); }
+
+  char at(std::size_t token) const {
+    if (token >= _offsets.size()) _unexpected_end();
+    return _json[_offsets[token]];
+  }
+
+  [[noreturn]] void unexpected(std::size_t token) const {
+    if (token >= _offsets.size()) _unexpected_end();
+    throw InvalidArgument()
+        << "Unexpected '" << at(token) << "' at character " << _offsets[token]
+        << " in JSON.";
+  }
+
+  /**
+   * The contents of the string starting at `token`, between its quotes. The
+   * closing quote is always the next token.
+   */
+  std::string_view string(std::size_t token) const {
+    at(token + 1);
+    const std::size_t start = _offsets[token] + 1;
+    return _json.substr(start, _offsets[token + 1] - start);
+  }
+
+  /**
+   * The text of the number or keyword starting at `token`, which runs up to
+   * the whitespace or token after it.
+   */
+  std::string_view scalar(std::size_t token) const {
+    const std::size_t start = _offsets[token];
+    std::size_t end =
+      token + 1 < _offsets.size() ? _offsets[token + 1] : _json.size();
+    while (end > start && is_json_space(_json[end - 1])) --end;
+    return _json.substr(start, end - start);
+  }
+
+  /**
+   * Works out the type of the value starting at `token`, validating it unless
+   * it is a list or object.
+   */
+  Tag classify(std::size_t token) const {
+    switch (at(token)) {
+      case '"': {
+        string(token);
+        return Tag::STRING;
+      }
+      case '[': return Tag::LIST_START;
+      case '{': return Tag::OBJECT_START;
+      case 't': return _keyword(token, "true", Tag::TRUE);
+      case 'f': return _keyword(token, "false", Tag::FALSE);
+      case 'n': return _keyword(token, "null", Tag::NUL);
+      case '+':
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9': {
+        const std::string_view raw = scalar(token);
+        bool is_float;
+        const std::size_t end = scan_json_number(raw, 0, is_float);
+        if (end != raw.size()) {
+          throw InvalidArgument()
+              << "Unexpected '" << raw[end] << "' at character "
+              << _offsets[token] + end << " in JSON number.";
+        }
+        return is_float ? Tag::FLOAT : Tag::INTEGER;
+      }
+      default: {
+        unexpected(token);
+      }
+    }
+  }
+
+  /**
+   * The token after the value starting at `token`. Lists and objects are
+   * stepped over by counting brackets, without looking at anything inside of
+   * them but the quotes which hide brackets in strings.
+   */
+  std::size_t skip(std::size_t token) const {
+    const char c = at(token);
+    if (c == '"') return token + 2;
+    if (c != '[' && c != '{') return token + 1;
+
+    const char* json = _json.data();
+    const std::uint32_t* offsets = _offsets.data();
+    const std::size_t size = _offsets.size();
+    std::size_t depth = 0;
+    for (std::size_t i = token; i < size; ++i) {
+      switch (json[offsets[i]]) {
+        case '"': {
+          ++i; // Skip the closing quote.
+          break;
+        }
+        case '[':
+        case '{': {
+          ++depth;
+          break;
+        }
+        case ']':
+        case '}': {
+          if (--depth == 0) return i + 1;
+          break;
+        }
+      }
+    }
+    _unexpected_end();
+  }
+
+private:
+  [[noreturn]] void _unexpected_end() const {
+    throw InvalidArgument() << "Unexpected end of input to JSON parser.";
+  }
+
+  Tag _keyword(std::size_t token, std::string_view keyword, Tag tag) const {
+    if (scalar(token) != keyword) {
+      throw InvalidArgument()
+          << "Unknown keyword at character " << _offsets[token] << " in JSON.";
+    }
+    return tag;
+  }
+
+  std::string_view _json;
+  std::vector<std::uint32_t> _offsets;
+};
+
+// -------------------------------------------------------------------------- //
+
+class OnDemandDocument;
+
+/**
+ * A value at some token in the document. Lists and objects remember the
+ * elements they have scanned so far and where to pick up scanning from.
+ */
+class OnDemandValue: public io::DeserializationToken {
+public:
+  OnDemandValue(const OnDemandDocument& document, std::size_t token, Tag tag):
+    _document{&document},
+    _token{token},
+    _tag{tag},
+    _next{token + 1}
+  {}
+
+  std::size_t size() const override {
+    if (is_string()) return _string().size();
+    if (!is_list() && !is_object()) {
+      throw FailedPrecondition()
+          << "Token is " << json_type_name(_tag)
+          << " which does not have a size.";
+    }
+    while (_scan_next()) {}
+    return _elements.size();
+  }
+
+  bool is_null() const override { return _tag == Tag::NUL; }
+  bool is_boolean() const override {
+    return _tag == Tag::TRUE || _tag == Tag::FALSE;
+  }
+  bool is_char() const override { return is_string() && size() == 1; }
+  bool is_signed_integer() const override { return _tag == Tag::INTEGER; }
+  bool is_unsigned_integer() const override {
+    return _tag == Tag::INTEGER && _index().scalar(_token).front() != '-';
+  }
+  bool is_floating_point() const override {
+    return _tag == Tag::INTEGER || _tag == Tag::FLOAT;
+  }
+  bool is_string() const override { return _tag == Tag::STRING; }
+  bool is_list() const override { return _tag == Tag::LIST_START; }
+  bool is_object() const override { return _tag == Tag::OBJECT_START; }
+
+  bool get_boolean() const override {
+    if (!is_boolean()) _wrong_type("BOOLEAN");
+    return _tag == Tag::TRUE;
+  }
+
+  char get_char() const override {
+    if (!is_char()) _wrong_type("CHAR");
+    return _string().front();
+  }
+
+  std::int64_t get_signed_integer() const override {
+    if (!is_signed_integer()) _wrong_type("INTEGER");
+    return parse_json_signed_integer(_index().scalar(_token));
+  }
+
+  std::uint64_t get_unsigned_integer() const override {
+    if (!is_unsigned_integer()) _wrong_type("unsigned INTEGER");
+    return parse_json_unsigned_integer(_index().scalar(_token));
+  }
+
+  double get_floating_point() const override {
+    if (!is_floating_point()) _wrong_type("FLOAT");
+    return parse_json_floating_point(_index().scalar(_token));
+  }
+
+  std::string_view get_string() const override {
+    if (!is_string()) _wrong_type("STRING");
+    return _string();
+  }
+
+  bool has_index(std::size_t idx) const override {
+    return is_list() && _find(idx);
+  }
+
+  const io::DeserializationToken& get_index(std::size_t idx) const override {
+    if (!is_list()) _wrong_type("LIST");
+    if (!_find(idx)) {
+      throw OutOfRange() << "Index " << idx << " is larger than this list of "
+                         << size();
+    }
+    return _value(idx);
+  }
+
+  bool has_key(std::string_view key) const override {
+    return is_object() && _find(key);
+  }
+
+  const io::DeserializationToken& get_key(std::string_view key) const override {
+    if (!is_object()) _wrong_type("OBJECT");
+    const OnDemandValue* value = _find(key);
+    if (!value) {
+      throw OutOfRange() << "Key " << key << " is not present in this object.";
+    }
+    return *value;
+  }
+
+private:
+  struct Element {
+    /**
+     * Where the element's value starts. In objects its key starts 3 tokens
+     * earlier, before the closing quote and colon.
+     */
+    std::size_t token;
+
+    /**
+     * Made the first time the element is read.
+     */
+    const OnDemandValue* value;
+  };
+
+  const StructuralIndex& _index() const;
+  Arena& _arena() const;
+  const OnDemandValue& _make_value(std::size_t token) const;
+
+  [[noreturn]] void _wrong_type(std::string_view expected) const {
+    throw FailedPrecondition()
+        << "Token is " << json_type_name(_tag) << ", not " << expected;
+  }
+
+  /**
+   * The decoded string, decoded into the arena on first use if it has any
+   * escape sequences.
+   */
+  std::string_view _string() const {
+    if (_decoded.data()) return _decoded;
+    std::string_view raw = _index().string(_token);
+    if (std::memchr(raw.data(), '\\', raw.size())) {
+      char* out = _arena().allocate_array<char>(raw.size());
+      _decoded = {out, decode_json_string(raw, out)};
+    } else {
+      _decoded = raw;
+    }
+    return _decoded;
+  }
+
+  /**
+   * Finds the next element of this list or object, checking the separators
+   * around it but skipping over its value. Returns false once there are no
+   * elements left.
+   */
+  bool _scan_next() const {
+    if (_complete) return false;
+
+    const StructuralIndex& index = _index();
+    const char close = is_object() ? '}' : ']';
+    std::size_t token = _next;
+    if (_elements.empty() && index.at(token) == close) {
+      _complete = true;
+      return false;
+    }
+    if (is_object()) {
+      if (index.at(token) != '"') {
+        throw InvalidArgument()
+            << "Unexpected '" << index.at(token)
+            << "' in JSON map. Expected STRING key.";
+      }
+      if (index.at(token + 2) != ':') index.unexpected(token + 2);
+      token += 3;
+    }
+
+    const std::size_t after = index.skip(token);
+    const char separator = index.at(after);
+    if (separator == ',') {
+      _next = after + 1;
+    } else if (separator == close) {
+      _complete = true;
+    } else {
+      index.unexpected(after);
+    }
+    _elements.push_back({.token = token, .value = nullptr});
+    return true;
+  }
+
+  const OnDemandValue& _value(std::size_t k) const {
+    Element& element = _elements[k];
+    if (!element.value) element.value = &_make_value(element.token);
+    return *element.value;
+  }
+
+  bool _find(std::size_t idx) const {
+    while (_elements.size() <= idx) {
+      if (!_scan_next()) return false;
+    }
+    return true;
+  }
+
+  const OnDemandValue* _find(std::string_view key) const {
+    const StructuralIndex& index = _index();
+    for (std::size_t k = 0; k < _elements.size() || _scan_next(); ++k) {
+      std::string_view raw = index.string(_elements[k].token - 3);
+      if (!std::memchr(raw.data(), '\\', raw.size())) {
+        if (raw == key) return &_value(k);
+      } else if (raw.size() >= key.size()) {
+        std::string decoded(raw.size(), '\0');
+        char* end = decode_json_string(raw, decoded.data());
+        decoded.resize(end - decoded.data());
+        if (decoded == key) return &_value(k);
+      }
+    }
+    return nullptr;
+  }
+
+  const OnDemandDocument* _document;
+  std::size_t _token;
+  Tag _tag;
+  mutable std::size_t _next;
+  mutable bool _complete = false;
+  mutable std::vector<Element> _elements;
+  mutable std::string_view _decoded;
+};
+
+/**
+ * The root value, owning the index and every value made from it.
+ */
+class OnDemandDocument: public OnDemandValue {
+public:
+  OnDemandDocument(StructuralIndex index, Tag tag):
+    OnDemandValue{*this, 0, tag},
+    _index{std::move(index)}
+  {}
+
+  const StructuralIndex& index() const { return _index; }
+  Arena& arena() const { return _arena; }
+
+  const OnDemandValue& make_value(std::size_t token) const {
+    return _values.emplace_back(*this, token, _index.classify(token));
+  }
+
+private:
+  StructuralIndex _index;
+  mutable std::deque<OnDemandValue> _values;
+  mutable Arena _arena;
+};
+
+const StructuralIndex& OnDemandValue::_index() const {
+  return _document->index();
+}
+
+Arena& OnDemandValue::_arena() const { return _document->arena(); }
+
+const OnDemandValue& OnDemandValue::_make_value(std::size_t token) const {
+  return _document->make_value(token);
+}
+
+}
+
+std::unique_ptr<io::DeserializationToken> parse_json_on_demand(
+  std::string_view json
+) {
+  StructuralIndex index{json};
+  if (index.size() == 0) {
+    throw InvalidArgument() << "Unexpected end of input to JSON parser.";
+  }
+  const Tag tag = index.classify(0);
+  return std::make_unique<OnDemandDocument>(std::move(index), tag);
+}
+
+}
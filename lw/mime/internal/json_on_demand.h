@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+
+#include "lw/io/serializer/parser.h"
+
+namespace lw::mime::internal {
+
+/**
+ * Indexes where the tokens of a JSON document are, returning a token which
+ * finds, validates and decodes values only once they are read.
+ *
+ * Looking up a key or index scans the list or object from the structural
+ * index only as far as that element, stepping over the values before it by
+ * matching brackets in the index rather than parsing them. Elements found are
+ * remembered, so each part of the document is scanned at most once.
+ *
+ * Parts of the document which are never read are never validated, so errors
+ * in them go unnoticed. Errors in parts which are read throw
+ * `InvalidArgument` from the accessor which found them. When an object has a
+ * key more than once, the first is found.
+ *
+ * Nothing is copied out of the source, which must outlive the token.
+ *
+ * @throw InvalidArgument
+ *  If the document is empty or 4GiB or larger.
+ */
+std::unique_ptr<io::DeserializationToken> parse_json_on_demand(
+  std::string_view json
+);
+
+}
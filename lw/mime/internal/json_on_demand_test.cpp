@@ -0,0 +1,87 @@
+#include "lw/mime/internal/json_on_demand.h"
+
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+
+namespace lw::mime::internal {
+namespace {
+
+TEST(JSONOnDemand, SkipsOverNestedValues) {
+  auto token = parse_json_on_demand(R"({
+    "skipped": {"a": [1, {"b": "]}"}], "c": "\"}"},
+    "list": [[1, [2]], "x"],
+    "id": 42
+  })");
+  ASSERT_TRUE(token->is_object());
+  EXPECT_EQ(token->get_key("id").get_signed_integer(), 42);
+  EXPECT_EQ(token->get_key("list").size(), 2);
+  EXPECT_EQ(token->get_key("list").get_index(1).get_string(), "x");
+  EXPECT_EQ(
+    token->get_key("list").get_index(0).get_index(1).get_index(0)
+      .get_signed_integer(),
+    2
+  );
+  EXPECT_EQ(
+    token->get_key("skipped").get_key("a").get_index(1).get_key("b")
+      .get_string(),
+    "]}"
+  );
+  EXPECT_EQ(token->size(), 3);
+}
+
+TEST(JSONOnDemand, ReturnsSameTokenForRepeatedReads) {
+  auto token = parse_json_on_demand(R"({"a": [1, 2], "b": "c"})");
+  EXPECT_EQ(&token->get_key("b"), &token->get_key("b"));
+  EXPECT_EQ(&token->get_key("a"), &token->get_key("a"));
+  EXPECT_EQ(
+    &token->get_key("a").get_index(1),
+    &token->get_key("a").get_index(1)
+  );
+}
+
+TEST(JSONOnDemand, DecodesStringsLazily) {
+  auto token =
+    parse_json_on_demand(R"({"plain": "foo", "esc\"aped": "b\\ar"})");
+  EXPECT_EQ(token->get_key("plain").get_string(), "foo");
+  EXPECT_TRUE(token->has_key("esc\"aped"));
+  EXPECT_EQ(token->get_key("esc\"aped").get_string(), "b\\ar");
+  EXPECT_FALSE(token->has_key("missing"));
+  EXPECT_THROW(token->get_key("missing"), OutOfRange);
+}
+
+TEST(JSONOnDemand, FindsFirstOfDuplicateKeys) {
+  auto token = parse_json_on_demand(R"({"a": 1, "a": 2})");
+  EXPECT_EQ(token->get_key("a").get_signed_integer(), 1);
+  EXPECT_EQ(token->size(), 2);
+}
+
+TEST(JSONOnDemand, OnlyValidatesWhatIsRead) {
+  auto token = parse_json_on_demand(R"({"bad": [1 2 tru], "good": 1})");
+  EXPECT_EQ(token->get_key("good").get_signed_integer(), 1);
+  EXPECT_THROW(token->get_key("bad").get_index(0), InvalidArgument);
+}
+
+TEST(JSONOnDemand, RejectsMalformedValuesWhenRead) {
+  for (std::string_view json : {
+    "[tru]", "[nulls]", "[01]", "[1.]", "[1e]", "[-]", "[1x]", "[\"abc]",
+    "[$]"
+  }) {
+    auto token = parse_json_on_demand(json);
+    EXPECT_THROW(token->get_index(0), InvalidArgument) << json;
+  }
+  for (std::string_view json : {
+    "[", "[1,", "[1 2]", "[1}", "{\"a\" 1}", "{1: 2}", "{\"a\": 1,}",
+    "{\"a\": [}"
+  }) {
+    auto token = parse_json_on_demand(json);
+    EXPECT_THROW(token->size(), InvalidArgument) << json;
+  }
+  EXPECT_THROW(parse_json_on_demand(""), InvalidArgument);
+  EXPECT_THROW(parse_json_on_demand("   "), InvalidArgument);
+  EXPECT_THROW(parse_json_on_demand("tru"), InvalidArgument);
+}
+
+}
+}
@@ -0,0 +1,338 @@
+#include "lw/mime/internal/json_scalars.h"
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "lw/err/canonical.h"
+#include "lw/memory/buffer_chain.h"
+
+namespace lw::mime::internal {
+namespace {
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/**
+ * Reads the four hex digits of a `\uXXXX` escape starting at `raw[i]`.
+ *
+ * @throw InvalidArgument
+ *  If there are not four hex digits at `i`.
+ */
+std::uint32_t read_unicode_escape(std::string_view raw, std::size_t i) {
+  if (i + 4 > raw.size()) {
+    throw InvalidArgument() << "Truncated \\u escape in JSON string.";
+  }
+  std::uint32_t code = 0;
+  const char* digits_end = raw.data() + i + 4;
+  const auto [end, err] =
+    std::from_chars(raw.data() + i, digits_end, code, /*base=*/16);
+  if (err != std::errc{} || end != digits_end) {
+    throw InvalidArgument()
+      << "Invalid \\u escape in JSON string: " << raw.substr(i, 4);
+  }
+  return code;
+}
+
+char* append_utf8(std::uint32_t code, char* out) {
+  if (code < 0x80) {
+    *out++ = static_cast<char>(code);
+  } else if (code < 0x800) {
+    *out++ = static_cast<char>(0xc0 | (code >> 6));
+    *out++ = static_cast<char>(0x80 | (code & 0x3f));
+  } else if (code < 0x10000) {
+    *out++ = static_cast<char>(0xe0 | (code >> 12));
+    *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    *out++ = static_cast<char>(0x80 | (code & 0x3f));
+  } else {
+    *out++ = static_cast<char>(0xf0 | (code >> 18));
+    *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+    *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+    *out++ = static_cast<char>(0x80 | (code & 0x3f));
+  }
+  return out;
+}
+
+std::size_t skip_digits(std::string_view json, std::size_t i) {
+  while (i < json.size() && is_digit(json[i])) ++i;
+  return i;
+}
+
+std::size_t expect_digits(std::string_view json, std::size_t i) {
+  if (i >= json.size() || !is_digit(json[i])) {
+    throw InvalidArgument()
+        << "Unexpected end of number at character " << i << " in JSON.";
+  }
+  return skip_digits(json, i);
+}
+
+/**
+ * Whether a number which is out of range for a double is too small for one
+ * rather than too large, by finding the power of ten of its first significant
+ * digit.
+ */
+bool is_too_small(std::string_view token) {
+  std::size_t i = 0;
+  if (i < token.size() && (token[i] == '+' || token[i] == '-')) ++i;
+  std::int64_t power = -1;
+  bool significant = false;
+  for (; i < token.size() && is_digit(token[i]); ++i) {
+    significant = significant || token[i] != '0';
+    if (significant) ++power;
+  }
+  if (!significant && i < token.size() && token[i] == '.') {
+    for (++i; i < token.size() && token[i] == '0'; ++i) --power;
+  }
+
+  const std::size_t e = token.find_first_of("eE");
+  if (e == std::string_view::npos) return power < 0;
+  const char* begin = token.data() + e + 1;
+  const bool negative = begin < token.end() && *begin == '-';
+  if (begin < token.end() && (*begin == '+' || *begin == '-')) ++begin;
+  std::int64_t exponent;
+  if (std::from_chars(begin, token.end(), exponent).ec != std::errc{}) {
+    return negative;
+  }
+  return power + (negative ? -exponent : exponent) < 0;
+}
+
+template <typename Number>
+char* format_integer(Number number, char* out) {
+  return std::to_chars(out, out + JSON_NUMBER_BUFFER_SIZE, number).ptr;
+}
+
+template <typename Number>
+char* format_floating_point(Number number, char* out) {
+  if (!std::isfinite(number)) {
+    throw InvalidArgument()
+        << "JSON can not represent the number " << number << ".";
+  }
+  return std::to_chars(out, out + JSON_NUMBER_BUFFER_SIZE, number).ptr;
+}
+
+}
+
+char* decode_json_string(std::string_view raw, char* out) {
+  for (std::size_t i = 0; i < raw.size(); ++i) {
+    const char c = raw[i];
+    if (c != '\\' || i + 1 == raw.size()) {
+      *out++ = c;
+      continue;
+    }
+    switch (raw[++i]) {
+      case '"':
+      case '\\':
+      case '/': {
+        *out++ = raw[i];
+        break;
+      }
+      case 'b': {
+        *out++ = '\b';
+        break;
+      }
+      case 'f': {
+        *out++ = '\f';
+        break;
+      }
+      case 'n': {
+        *out++ = '\n';
+        break;
+      }
+      case 'r': {
+        *out++ = '\r';
+        break;
+      }
+      case 't': {
+        *out++ = '\t';
+        break;
+      }
+      case 'u': {
+        // Characters outside the Basic Multilingual Plane are escaped as a
+        // UTF-16 surrogate pair. Unpaired surrogates have no UTF-8 encoding,
+        // so they become the replacement character.
+        std::uint32_t code = read_unicode_escape(raw, i + 1);
+        i += 4;
+        if (code >= 0xd800 && code < 0xdc00) {
+          if (
+            i + 6 < raw.size() && raw[i + 1] == '\\' && raw[i + 2] == 'u'
+          ) {
+            const std::uint32_t low = read_unicode_escape(raw, i + 3);
+            if (low >= 0xdc00 && low < 0xe000) {
+              code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+              i += 6;
+            } else {
+              code = 0xfffd;
+            }
+          } else {
+            code = 0xfffd;
+          }
+        } else if (code >= 0xdc00 && code < 0xe000) {
+          code = 0xfffd;
+        }
+        out = append_utf8(code, out);
+        break;
+      }
+    }
+  }
+  return out;
+}
+
+std::size_t find_json_escape(std::string_view str, std::size_t start) {
+  std::size_t i = start;
+#if defined(__x86_64__)
+  // SSE2 is part of x86-64, so this needs no target attribute or CPU check.
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i slash = _mm_set1_epi8('/');
+  const __m128i last_control = _mm_set1_epi8(0x1f);
+  for (; i + 16 <= str.size(); i += 16) {
+    const __m128i chars = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(str.data() + i)
+    );
+    // Unsigned `chars <= 0x1f`, which SSE2 only has as min-and-compare.
+    const __m128i control =
+      _mm_cmpeq_epi8(_mm_min_epu8(chars, last_control), chars);
+    const __m128i escaped = _mm_or_si128(
+      _mm_or_si128(
+        _mm_cmpeq_epi8(chars, quote),
+        _mm_cmpeq_epi8(chars, backslash)
+      ),
+      _mm_or_si128(_mm_cmpeq_epi8(chars, slash), control)
+    );
+    const int mask = _mm_movemask_epi8(escaped);
+    if (mask) return i + std::countr_zero(static_cast<unsigned>(mask));
+  }
+#endif
+  for (; i < str.size(); ++i) {
+    if (json_needs_escape(str[i])) return i;
+  }
+  return str.size();
+}
+
+void append_json_string(std::string_view str, BufferChain& output) {
+  char escaped[JSON_ESCAPE_BUFFER_SIZE];
+  output.push_back('"');
+  std::size_t start = 0;
+  while (true) {
+    const std::size_t end = find_json_escape(str, start);
+    output.append(str.substr(start, end - start));
+    if (end == str.size()) break;
+    const char* escaped_end = escape_json_char(str[end], escaped);
+    output.append({escaped, static_cast<std::size_t>(escaped_end - escaped)});
+    start = end + 1;
+  }
+  output.push_back('"');
+}
+
+std::size_t scan_json_number(
+  std::string_view json,
+  std::size_t start,
+  bool& is_float
+) {
+  is_float = false;
+  std::size_t i = start;
+  if (i < json.size() && (json[i] == '+' || json[i] == '-')) ++i;
+  if (i >= json.size()) {
+    throw InvalidArgument() << "Unexpected end of input to JSON parser.";
+  }
+  if (json[i] == '0') {
+    ++i;
+    if (i < json.size() && is_digit(json[i])) {
+      throw InvalidArgument()
+          << "Unexpected digit at character " << i
+          << " in JSON number. Expected '.' or end of number.";
+    }
+  } else if (!is_digit(json[i])) {
+    throw InvalidArgument()
+        << "Unexpected '" << json[i] << "' at character " << i
+        << " in JSON number.";
+  }
+  i = skip_digits(json, i);
+  if (i < json.size() && json[i] == '.') {
+    is_float = true;
+    i = expect_digits(json, i + 1);
+  }
+  if (i < json.size() && (json[i] == 'e' || json[i] == 'E')) {
+    is_float = true;
+    ++i;
+    if (i < json.size() && (json[i] == '+' || json[i] == '-')) ++i;
+    i = expect_digits(json, i);
+  }
+  return i;
+}
+
+std::int64_t parse_json_signed_integer(std::string_view token) {
+  auto begin = token.begin();
+  if (begin != token.end() && *begin == '+') ++begin;
+  std::int64_t out;
+  auto [end, err] = std::from_chars(begin, token.end(), out);
+  if (end != token.end() || err == std::errc::invalid_argument) {
+    throw InvalidArgument()
+        << "String " << token << " is not a valid signed integer.";
+  } else if (err == std::errc::result_out_of_range) {
+    throw InvalidArgument()
+        << "Value " << token << " is too large for a 64-bit integer.";
+  }
+  return out;
+}
+
+std::uint64_t parse_json_unsigned_integer(std::string_view token) {
+  auto begin = token.begin();
+  if (begin != token.end() && *begin == '+') ++begin;
+  std::uint64_t out;
+  auto [end, err] = std::from_chars(begin, token.end(), out);
+  if (end != token.end() || err == std::errc::invalid_argument) {
+    throw InvalidArgument()
+        << "String " << token << " is not a valid unsigned integer.";
+  } else if (err == std::errc::result_out_of_range) {
+    throw InvalidArgument()
+        << "Value " << token
+        << " is too large for an unsigned 64-bit integer.";
+  }
+  return out;
+}
+
+double parse_json_floating_point(std::string_view token) {
+  // std::from_chars is locale independent, unlike std::strtod. From GCC 12,
+  // libstdc++ implements it with the Eisel-Lemire algorithm from fast_float,
+  // while GCC 11 still calls strtod under the "C" locale.
+  auto begin = token.begin();
+  if (begin != token.end() && *begin == '+') ++begin;
+  double out;
+  auto [end, err] = std::from_chars(begin, token.end(), out);
+  if (end != token.end() || err == std::errc::invalid_argument) {
+    throw InvalidArgument()
+        << "String \"" << token << "\" is not a valid double value.";
+  } else if (err == std::errc::result_out_of_range) {
+    if (!is_too_small(token)) {
+      throw InvalidArgument()
+          << "Value \"" << token << "\" is too large for double.";
+    }
+    return token.front() == '-' ? -0.0 : 0.0;
+  }
+  return out;
+}
+
+char* format_json_number(double number, char* out) {
+  return format_floating_point(number, out);
+}
+
+char* format_json_number(float number, char* out) {
+  return format_floating_point(number, out);
+}
+
+char* format_json_number(std::int64_t number, char* out) {
+  return format_integer(number, out);
+}
+
+char* format_json_number(std::uint64_t number, char* out) {
+  return format_integer(number, out);
+}
+
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "lw/memory/buffer_chain.h"
+
+namespace lw::mime::internal {
+
+/**
+ * Decodes the escape sequences in the contents of a JSON string, not including
+ * its quotation marks. `\uXXXX` escapes, including surrogate pairs, are
+ * written as UTF-8, with unpaired surrogates replaced by U+FFFD.
+ *
+ * @param raw
+ *  The string as it appears in the JSON document, between the quotes.
+ * @param out
+ *  Where to write the decoded string. Decoding never lengthens a string, so
+ *  `raw.size()` characters of room is always enough.
+ *
+ * @return
+ *  One past the last character written to `out`.
+ *
+ * @throw InvalidArgument
+ *  If a `\u` escape is not followed by four hex digits.
+ */
+char* decode_json_string(std::string_view raw, char* out);
+
+/**
+ * Whether `c` has to be escaped in a JSON string: quotation marks,
+ * backslashes, slashes and control characters.
+ */
+constexpr bool json_needs_escape(char c) {
+  return (
+    c == '"' || c == '\\' || c == '/' || static_cast<unsigned char>(c) < 0x20
+  );
+}
+
+/**
+ * Finds the first character at or after `start` which has to be escaped.
+ * Searches 16 characters at a time on x86-64, so the runs of characters in
+ * between can be copied as they are.
+ *
+ * @return
+ *  The offset of the character, or `str.size()` if there are none.
+ */
+std::size_t find_json_escape(std::string_view str, std::size_t start);
+
+/**
+ * Room needed for any escape sequence written by `escape_json_char`.
+ */
+constexpr std::size_t JSON_ESCAPE_BUFFER_SIZE = 6;
+
+/**
+ * Writes the escape sequence for a character which `json_needs_escape`.
+ * Control characters without a short form are written as "\u00XX".
+ *
+ * @param out
+ *  Where to write the sequence, with room for at least
+ *  `JSON_ESCAPE_BUFFER_SIZE` characters.
+ *
+ * @return
+ *  One past the last character written to `out`.
+ */
+constexpr char* escape_json_char(char c, char* out) {
+  *out++ = '\\';
+  switch (c) {
+    case '"':
+    case '\\':
+    case '/': {
+      *out++ = c;
+      break;
+    }
+    case '\b': {
+      *out++ = 'b';
+      break;
+    }
+    case '\f': {
+      *out++ = 'f';
+      break;
+    }
+    case '\n': {
+      *out++ = 'n';
+      break;
+    }
+    case '\r': {
+      *out++ = 'r';
+      break;
+    }
+    case '\t': {
+      *out++ = 't';
+      break;
+    }
+    default: {
+      constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+      const unsigned char byte = static_cast<unsigned char>(c);
+      *out++ = 'u';
+      *out++ = '0';
+      *out++ = '0';
+      *out++ = HEX_DIGITS[byte >> 4];
+      *out++ = HEX_DIGITS[byte & 0xf];
+      break;
+    }
+  }
+  return out;
+}
+
+/**
+ * Appends `str` to `output` as a JSON string, quoted and escaped.
+ */
+void append_json_string(std::string_view str, BufferChain& output);
+
+/**
+ * The length of `key` as an object key made by `make_json_key`.
+ */
+constexpr std::size_t json_key_size(std::string_view key) {
+  std::size_t size = 4; // The separator, quotes and colon.
+  for (char c : key) {
+    char escaped[JSON_ESCAPE_BUFFER_SIZE];
+    size += json_needs_escape(c) ? escape_json_char(c, escaped) - escaped : 1;
+  }
+  return size;
+}
+
+/**
+ * Formats an object key known at compile time, so that it does not need to be
+ * escaped each time it is written.
+ *
+ * @tparam Size
+ *  The length of the key, from `json_key_size`.
+ *
+ * @param separator
+ *  The '{' or ',' written before the key.
+ *
+ * @return
+ *  The separator, the quoted and escaped key, and a colon.
+ */
+template <std::size_t Size>
+constexpr std::array<char, Size> make_json_key(
+  std::string_view key,
+  char separator
+) {
+  std::array<char, Size> formatted{};
+  char* out = formatted.data();
+  *out++ = separator;
+  *out++ = '"';
+  for (char c : key) {
+    if (json_needs_escape(c)) {
+      out = escape_json_char(c, out);
+    } else {
+      *out++ = c;
+    }
+  }
+  *out++ = '"';
+  *out++ = ':';
+  return formatted;
+}
+
+/**
+ * Finds the end of the JSON number starting at `start`, checking that it
+ * follows the grammar for numbers. A leading '+' is also accepted.
+ *
+ * @param is_float
+ *  Set to whether the number has a fraction or exponent.
+ *
+ * @return
+ *  The offset just past the last character of the number.
+ *
+ * @throw InvalidArgument
+ *  If there is no valid number at `start`.
+ */
+std::size_t scan_json_number(
+  std::string_view json,
+  std::size_t start,
+  bool& is_float
+);
+
+/**
+ * Parses a JSON integer token, which may have a leading '+'.
+ *
+ * @throw InvalidArgument
+ *  If the token is not an integer or does not fit in the result.
+ */
+std::int64_t parse_json_signed_integer(std::string_view token);
+std::uint64_t parse_json_unsigned_integer(std::string_view token);
+
+/**
+ * Parses a JSON number token as a double, rounding correctly to the nearest
+ * one. Numbers too small for a double become zero.
+ *
+ * @throw InvalidArgument
+ *  If the token is not a number or is too large for a double.
+ */
+double parse_json_floating_point(std::string_view token);
+
+/**
+ * Room needed for any number written by `format_json_number`.
+ */
+constexpr std::size_t JSON_NUMBER_BUFFER_SIZE = 32;
+
+/**
+ * Writes a number as JSON. Floating point numbers are written with the fewest
+ * digits which read back as the same value, using exponents where that is
+ * shorter.
+ *
+ * @param out
+ *  Where to write the number, with room for at least
+ *  `JSON_NUMBER_BUFFER_SIZE` characters.
+ *
+ * @return
+ *  One past the last character written to `out`.
+ *
+ * @throw InvalidArgument
+ *  If the number is infinite or NaN, which JSON can not represent.
+ */
+char* format_json_number(double number, char* out);
+char* format_json_number(float number, char* out);
+char* format_json_number(std::int64_t number, char* out);
+char* format_json_number(std::uint64_t number, char* out);
+
+}
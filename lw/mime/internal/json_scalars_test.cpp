@@ -0,0 +1,171 @@
+#include "lw/mime/internal/json_scalars.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+
+namespace lw::mime::internal {
+namespace {
+
+std::string decode(std::string_view raw) {
+  std::string out(raw.size(), '\0');
+  out.resize(decode_json_string(raw, out.data()) - out.data());
+  return out;
+}
+
+TEST(JSONScalars, DecodesStrings) {
+  EXPECT_EQ(decode("foobar"), "foobar");
+  EXPECT_EQ(decode(R"(foo\"bar)"), "foo\"bar");
+  EXPECT_EQ(decode(R"(\\\/\b\f\n\r\t)"), "\\/\b\f\n\r\t");
+  EXPECT_EQ(decode(""), "");
+}
+
+TEST(JSONScalars, DecodesUnicodeEscapes) {
+  EXPECT_EQ(decode(R"(\u0041\u00e9\u20AC)"), "A\u00e9\u20ac");
+  EXPECT_EQ(decode(R"(a\u0000b)"), std::string("a\0b", 3));
+  EXPECT_EQ(decode(R"(\u001f)"), "\x1f");
+  // U+1F600 as a surrogate pair.
+  EXPECT_EQ(decode(R"(\ud83d\ude00)"), "\U0001f600");
+  // Unpaired surrogates.
+  EXPECT_EQ(decode(R"(\ud83dx)"), "\ufffdx");
+  EXPECT_EQ(decode(R"(\ude00)"), "\ufffd");
+  EXPECT_EQ(decode(R"(\ud83d\u0041)"), "\ufffdA");
+
+  EXPECT_THROW(decode(R"(\u12)"), InvalidArgument);
+  EXPECT_THROW(decode(R"(\u12g4)"), InvalidArgument);
+  EXPECT_THROW(decode(R"(\u-123)"), InvalidArgument);
+}
+
+TEST(JSONScalars, FindsEscapes) {
+  EXPECT_EQ(find_json_escape("", 0), 0);
+  EXPECT_EQ(find_json_escape("plain", 0), 5);
+  // Every escaped character at every position in and after a 16-byte block.
+  for (char c : std::string_view{"\"\\/\0\n\x1f", 6}) {
+    for (std::size_t i = 0; i < 40; ++i) {
+      std::string str(40, 'x');
+      str[i] = c;
+      EXPECT_EQ(find_json_escape(str, 0), i);
+      EXPECT_EQ(find_json_escape(str, i + 1), 40);
+    }
+  }
+  for (char c : {' ', '\x7f', '\x80', '\xff'}) {
+    EXPECT_EQ(find_json_escape(std::string(40, c), 0), 40);
+  }
+}
+
+TEST(JSONScalars, EscapesCharacters) {
+  std::string escaped;
+  for (char c : std::string_view{"\"\\/\b\f\n\r\t\0\x1f", 10}) {
+    char out[JSON_ESCAPE_BUFFER_SIZE];
+    escaped.append(out, escape_json_char(c, out));
+  }
+  EXPECT_EQ(escaped, R"(\"\\\/\b\f\n\r\t\u0000\u001f)");
+}
+
+TEST(JSONScalars, ScansNumbers) {
+  bool is_float = true;
+  EXPECT_EQ(scan_json_number("[-42,", 1, is_float), 4);
+  EXPECT_FALSE(is_float);
+  EXPECT_EQ(scan_json_number("0.5e+3}", 0, is_float), 6);
+  EXPECT_TRUE(is_float);
+  EXPECT_EQ(scan_json_number("+1E2", 0, is_float), 4);
+  EXPECT_TRUE(is_float);
+
+  EXPECT_THROW(scan_json_number("01", 0, is_float), InvalidArgument);
+  EXPECT_THROW(scan_json_number("1.", 0, is_float), InvalidArgument);
+  EXPECT_THROW(scan_json_number("1e", 0, is_float), InvalidArgument);
+  EXPECT_THROW(scan_json_number("-", 0, is_float), InvalidArgument);
+  EXPECT_THROW(scan_json_number("-x", 0, is_float), InvalidArgument);
+}
+
+TEST(JSONScalars, ParsesIntegers) {
+  EXPECT_EQ(parse_json_signed_integer("-42"), -42);
+  EXPECT_EQ(parse_json_signed_integer("+42"), 42);
+  EXPECT_EQ(parse_json_unsigned_integer("18446744073709551615"), ~0ull);
+  EXPECT_THROW(
+    parse_json_signed_integer("9223372036854775808"),
+    InvalidArgument
+  );
+  EXPECT_THROW(parse_json_unsigned_integer("-1"), InvalidArgument);
+  EXPECT_THROW(parse_json_signed_integer("4.2"), InvalidArgument);
+}
+
+TEST(JSONScalars, ParsesFloatingPoints) {
+  EXPECT_EQ(parse_json_floating_point(std::string_view{"3.14,", 4}), 3.14);
+  EXPECT_EQ(parse_json_floating_point(std::string_view{"-1e3]", 4}), -1000.0);
+  EXPECT_THROW(
+    parse_json_floating_point(std::string_view{"1e999,", 5}),
+    InvalidArgument
+  );
+  EXPECT_THROW(
+    parse_json_floating_point("1" + std::string(400, '0')),
+    InvalidArgument
+  );
+  EXPECT_THROW(parse_json_floating_point("1.5x"), InvalidArgument);
+}
+
+TEST(JSONScalars, RoundsFloatingPointsCorrectly) {
+  EXPECT_EQ(parse_json_floating_point("+2.5"), 2.5);
+  EXPECT_EQ(parse_json_floating_point("9007199254740993"), 9007199254740992.0);
+  EXPECT_EQ(
+    parse_json_floating_point("2.2250738585072011e-308"),
+    2.2250738585072011e-308
+  );
+  EXPECT_EQ(parse_json_floating_point("4.9406564584124654e-324"), 5e-324);
+  EXPECT_EQ(parse_json_floating_point("1e-400"), 0.0);
+  EXPECT_TRUE(std::signbit(parse_json_floating_point("-1e-400")));
+  EXPECT_EQ(
+    parse_json_floating_point("0." + std::string(400, '0') + "1"),
+    0.0
+  );
+}
+
+std::string format(auto number) {
+  char buffer[JSON_NUMBER_BUFFER_SIZE];
+  return {buffer, format_json_number(number, buffer)};
+}
+
+TEST(JSONScalars, FormatsNumbers) {
+  EXPECT_EQ(
+    format(std::numeric_limits<std::int64_t>::min()),
+    "-9223372036854775808"
+  );
+  EXPECT_EQ(format(~std::uint64_t{0}), "18446744073709551615");
+  EXPECT_EQ(format(0.1), "0.1");
+  EXPECT_EQ(format(0.1 + 0.2), "0.30000000000000004");
+  EXPECT_EQ(format(1e21), "1e+21");
+  EXPECT_EQ(format(-0.0), "-0");
+  EXPECT_EQ(format(1.234f), "1.234");
+  EXPECT_EQ(format(-1.7976931348623157e308), "-1.7976931348623157e+308");
+  EXPECT_THROW(
+    format(std::numeric_limits<double>::quiet_NaN()),
+    InvalidArgument
+  );
+  EXPECT_THROW(
+    format(std::numeric_limits<float>::infinity()),
+    InvalidArgument
+  );
+}
+
+TEST(JSONScalars, FloatingPointsRoundTrip) {
+  std::mt19937_64 random{42};
+  for (int i = 0; i < 10000; ++i) {
+    double number;
+    do {
+      const std::uint64_t bits = random();
+      std::memcpy(&number, &bits, sizeof(number));
+    } while (!std::isfinite(number));
+    EXPECT_EQ(parse_json_floating_point(format(number)), number);
+  }
+}
+
+}
+}
@@ -0,0 +1,337 @@
+#include "lw/mime/internal/json_structural_index.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "lw/err/canonical.h"
+
+namespace lw::mime::internal {
+namespace {
+
+constexpr std::size_t BLOCK_SIZE = 64;
+
+/**
+ * Blocks classified per call to a classifier, so the cost of calling through
+ * a function pointer is paid once per 4KiB.
+ */
+constexpr std::size_t BATCH_SIZE = 64;
+
+/**
+ * One bit per character of a 64-byte block, the lowest bit being the first
+ * character.
+ */
+struct BlockMasks {
+  std::uint64_t backslash;
+  std::uint64_t quote;
+  std::uint64_t whitespace;
+
+  /**
+   * Braces, brackets, colons and commas. These are matched as `c | 0x20`
+   * being one of "{}:,", which also catches a few control characters. Those
+   * are never valid outside of strings, so the second stage rejects them all
+   * the same.
+   */
+  std::uint64_t punctuation;
+};
+
+using Classifier = void (*)(const char* data, std::size_t count, BlockMasks*);
+
+bool is_whitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool is_punctuation(char c) {
+  const char folded = c | 0x20;
+  return folded == '{' || folded == '}' || folded == ':' || folded == ',';
+}
+
+void classify_scalar(const char* data, std::size_t count, BlockMasks* out) {
+  for (std::size_t b = 0; b < count; ++b) {
+    const char* block = data + b * BLOCK_SIZE;
+    BlockMasks masks{};
+    for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+      const std::uint64_t bit = 1ull << i;
+      const char c = block[i];
+      if (c == '\\') masks.backslash |= bit;
+      if (c == '"') masks.quote |= bit;
+      if (is_whitespace(c)) masks.whitespace |= bit;
+      if (is_punctuation(c)) masks.punctuation |= bit;
+    }
+    out[b] = masks;
+  }
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is part of x86-64, so this needs no target attribute or CPU check.
+void classify_sse2(const char* data, std::size_t count, BlockMasks* out) {
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i carriage_return = _mm_set1_epi8('\r');
+  const __m128i fold = _mm_set1_epi8(0x20);
+  const __m128i open_brace = _mm_set1_epi8('{');
+  const __m128i close_brace = _mm_set1_epi8('}');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+
+  for (std::size_t b = 0; b < count; ++b) {
+    const char* block = data + b * BLOCK_SIZE;
+    BlockMasks masks{};
+    for (std::size_t i = 0; i < BLOCK_SIZE; i += 16) {
+      const __m128i chars = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(block + i)
+      );
+      const __m128i folded = _mm_or_si128(chars, fold);
+      const __m128i whitespace = _mm_or_si128(
+        _mm_or_si128(
+          _mm_cmpeq_epi8(chars, space),
+          _mm_cmpeq_epi8(chars, tab)
+        ),
+        _mm_or_si128(
+          _mm_cmpeq_epi8(chars, newline),
+          _mm_cmpeq_epi8(chars, carriage_return)
+        )
+      );
+      const __m128i punctuation = _mm_or_si128(
+        _mm_or_si128(
+          _mm_cmpeq_epi8(folded, open_brace),
+          _mm_cmpeq_epi8(folded, close_brace)
+        ),
+        _mm_or_si128(
+          _mm_cmpeq_epi8(folded, colon),
+          _mm_cmpeq_epi8(folded, comma)
+        )
+      );
+      auto bits = [i](__m128i matches) -> std::uint64_t {
+        return static_cast<std::uint64_t>(
+          static_cast<std::uint16_t>(_mm_movemask_epi8(matches))
+        ) << i;
+      };
+      masks.backslash |= bits(_mm_cmpeq_epi8(chars, backslash));
+      masks.quote |= bits(_mm_cmpeq_epi8(chars, quote));
+      masks.whitespace |= bits(whitespace);
+      masks.punctuation |= bits(punctuation);
+    }
+    out[b] = masks;
+  }
+}
+
+__attribute__((target("avx2"), always_inline))
+inline std::uint64_t movemask_avx2(__m256i low, __m256i high) {
+  const std::uint32_t low_bits = _mm256_movemask_epi8(low);
+  const std::uint32_t high_bits = _mm256_movemask_epi8(high);
+  return low_bits | (static_cast<std::uint64_t>(high_bits) << 32);
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m256i whitespace_avx2(__m256i chars) {
+  return _mm256_or_si256(
+    _mm256_or_si256(
+      _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+      _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t'))
+    ),
+    _mm256_or_si256(
+      _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')),
+      _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r'))
+    )
+  );
+}
+
+__attribute__((target("avx2"), always_inline))
+inline __m256i punctuation_avx2(__m256i chars) {
+  const __m256i folded = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+  return _mm256_or_si256(
+    _mm256_or_si256(
+      _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('{')),
+      _mm256_cmpeq_epi8(folded, _mm256_set1_epi8('}'))
+    ),
+    _mm256_or_si256(
+      _mm256_cmpeq_epi8(folded, _mm256_set1_epi8(':')),
+      _mm256_cmpeq_epi8(folded, _mm256_set1_epi8(','))
+    )
+  );
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const char* data, std::size_t count, BlockMasks* out) {
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i quote = _mm256_set1_epi8('"');
+  for (std::size_t b = 0; b < count; ++b) {
+    const char* block = data + b * BLOCK_SIZE;
+    const __m256i low = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(block)
+    );
+    const __m256i high = _mm256_loadu_si256(
+      reinterpret_cast<const __m256i*>(block + 32)
+    );
+    out[b] = {
+      .backslash = movemask_avx2(
+        _mm256_cmpeq_epi8(low, backslash),
+        _mm256_cmpeq_epi8(high, backslash)
+      ),
+      .quote = movemask_avx2(
+        _mm256_cmpeq_epi8(low, quote),
+        _mm256_cmpeq_epi8(high, quote)
+      ),
+      .whitespace =
+        movemask_avx2(whitespace_avx2(low), whitespace_avx2(high)),
+      .punctuation =
+        movemask_avx2(punctuation_avx2(low), punctuation_avx2(high))
+    };
+  }
+}
+
+#endif
+
+Classifier get_classifier(SimdLevel level) {
+#if defined(__x86_64__)
+  if (level == SimdLevel::AVX2) return &classify_avx2;
+  if (level == SimdLevel::SSE2) return &classify_sse2;
+#endif
+  return &classify_scalar;
+}
+
+/**
+ * Each bit set to the XOR of itself and every bit below it, which turns a
+ * mask of quotes into a mask of the characters from each opening quote up to
+ * but not including its closing quote.
+ */
+std::uint64_t prefix_xor(std::uint64_t bits) {
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+  return bits;
+}
+
+/**
+ * Turns the classified blocks of a document, in order, into masks of where
+ * tokens start.
+ */
+class BlockScanner {
+public:
+  std::uint64_t structurals(const BlockMasks& masks) {
+    const std::uint64_t quote = masks.quote & ~_escaped(masks.backslash);
+    const std::uint64_t in_string = prefix_xor(quote) ^ _in_string;
+    _in_string = static_cast<std::uint64_t>(
+      static_cast<std::int64_t>(in_string) >> 63
+    );
+
+    // A scalar starts at any non-whitespace, non-punctuation character which
+    // does not directly follow another. Quotes are left out of the
+    // continuation so that anything stuck to the end of a string stands out.
+    const std::uint64_t scalar = ~(masks.punctuation | masks.whitespace);
+    const std::uint64_t continuing = scalar & ~quote;
+    const std::uint64_t follows_scalar = (continuing << 1) | _continuing;
+    _continuing = continuing >> 63;
+    const std::uint64_t scalar_start = scalar & ~follows_scalar;
+
+    return ((masks.punctuation | scalar_start) & ~in_string) | quote;
+  }
+
+private:
+  /**
+   * Finds the characters escaped by a backslash: those after an odd-length
+   * run of backslashes. Runs starting on even and odd bits are told apart by
+   * adding their starts, which carries through to the end of each run.
+   */
+  std::uint64_t _escaped(std::uint64_t backslash) {
+    constexpr std::uint64_t EVEN_BITS = 0x5555'5555'5555'5555ull;
+    backslash &= ~_escaped_carry;
+    const std::uint64_t follows_escape = (backslash << 1) | _escaped_carry;
+    const std::uint64_t odd_starts = backslash & ~EVEN_BITS & ~follows_escape;
+    unsigned long long even_starts;
+    _escaped_carry =
+      __builtin_uaddll_overflow(odd_starts, backslash, &even_starts);
+    const std::uint64_t invert = even_starts << 1;
+    return (EVEN_BITS ^ invert) & follows_escape;
+  }
+
+  std::uint64_t _escaped_carry = 0;
+  std::uint64_t _in_string = 0;
+  std::uint64_t _continuing = 0;
+};
+
+void append_offsets(
+  std::uint64_t bits,
+  std::uint32_t base,
+  std::vector<std::uint32_t>& out
+) {
+  const std::size_t size = out.size();
+  out.resize(size + std::popcount(bits));
+  std::uint32_t* offset = out.data() + size;
+  while (bits) {
+    *offset++ = base + std::countr_zero(bits);
+    bits &= bits - 1;
+  }
+}
+
+}
+
+SimdLevel best_simd_level() {
+#if defined(__x86_64__)
+  static const SimdLevel level =
+    __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 : SimdLevel::SSE2;
+  return level;
+#else
+  return SimdLevel::SCALAR;
+#endif
+}
+
+std::vector<std::uint32_t> index_json_structure(
+  std::string_view json,
+  SimdLevel level
+) {
+  if (json.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw InvalidArgument()
+        << "JSON document of " << json.size()
+        << " bytes is too large to index.";
+  }
+
+  const Classifier classify = get_classifier(level);
+  std::vector<std::uint32_t> offsets;
+  offsets.reserve(json.size() / 8 + BLOCK_SIZE);
+  BlockScanner scanner;
+  BlockMasks masks[BATCH_SIZE];
+
+  const std::size_t full_blocks = json.size() / BLOCK_SIZE;
+  for (std::size_t block = 0; block < full_blocks; block += BATCH_SIZE) {
+    const std::size_t count = std::min(BATCH_SIZE, full_blocks - block);
+    classify(json.data() + block * BLOCK_SIZE, count, masks);
+    for (std::size_t i = 0; i < count; ++i) {
+      append_offsets(
+        scanner.structurals(masks[i]),
+        (block + i) * BLOCK_SIZE,
+        offsets
+      );
+    }
+  }
+
+  // Pad the last partial block with whitespace, which is never indexed.
+  const std::size_t tail = full_blocks * BLOCK_SIZE;
+  if (tail < json.size()) {
+    char padded[BLOCK_SIZE];
+    std::memset(padded, ' ', BLOCK_SIZE);
+    std::memcpy(padded, json.data() + tail, json.size() - tail);
+    classify(padded, 1, masks);
+    append_offsets(scanner.structurals(masks[0]), tail, offsets);
+  }
+  return offsets;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lw::mime::internal {
+
+/**
+ * Instruction sets the structural indexer can use to classify characters.
+ */
+enum class SimdLevel {
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+/**
+ * The fastest level supported by the CPU this is running on.
+ */
+SimdLevel best_simd_level();
+
+/**
+ * Finds where every token in a JSON document starts, the first stage of
+ * parsing it, after simdjson.
+ *
+ * The document is classified 64 bytes at a time into bitmasks of quotes,
+ * backslashes, whitespace and punctuation. Escaped quotes are dropped and the
+ * remaining quotes turned into a mask of which characters lie inside strings,
+ * carrying state between blocks. The result lists the offset of:
+ *
+ *  - Every brace, bracket, colon and comma outside of strings.
+ *  - Both quotation marks of every string.
+ *  - The first character of every other run of non-whitespace, such as
+ *    numbers and keywords.
+ *
+ * Nothing is validated here. Any character outside of a string which is not
+ * part of a token shows up as the start of a bogus one for the second stage to
+ * reject.
+ *
+ * @param level
+ *  Instructions to use, which must be supported by the CPU.
+ *
+ * @throw InvalidArgument
+ *  If the document is 4GiB or larger.
+ */
+std::vector<std::uint32_t> index_json_structure(
+  std::string_view json,
+  SimdLevel level = best_simd_level()
+);
+
+}
@@ -0,0 +1,96 @@
+#include "lw/mime/internal/json_structural_index.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace lw::mime::internal {
+namespace {
+
+/**
+ * Indexes the document one character at a time. Like the vectorized scan,
+ * backslashes escape the next character even outside of strings, where they
+ * are invalid anyway.
+ */
+std::vector<std::uint32_t> reference_index(std::string_view json) {
+  std::vector<std::uint32_t> offsets;
+  bool in_string = false;
+  bool escaped = false;
+  bool continuing = false;
+  for (std::uint32_t i = 0; i < json.size(); ++i) {
+    const char c = json[i];
+    const bool quote = c == '"' && !escaped;
+    escaped = c == '\\' && !escaped;
+    if (in_string) {
+      if (quote) {
+        offsets.push_back(i);
+        in_string = false;
+        continuing = false;
+      }
+      continue;
+    }
+    const char folded = c | 0x20;
+    const bool whitespace = c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    const bool punctuation =
+      folded == '{' || folded == '}' || folded == ':' || folded == ',';
+    if (quote) {
+      offsets.push_back(i);
+      in_string = true;
+    } else if (punctuation || (!whitespace && !continuing)) {
+      offsets.push_back(i);
+    }
+    continuing = !whitespace && !punctuation && !quote;
+  }
+  return offsets;
+}
+
+std::vector<SimdLevel> supported_levels() {
+  std::vector<SimdLevel> levels = {SimdLevel::SCALAR};
+  if (best_simd_level() >= SimdLevel::SSE2) levels.push_back(SimdLevel::SSE2);
+  if (best_simd_level() >= SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+  return levels;
+}
+
+TEST(JSONStructuralIndex, FindsTokens) {
+  const std::string_view json = R"({"a": [1, -2.5e3, true], "b\"c": null})";
+  const std::vector<std::uint32_t> expected = {
+    0, 1, 3, 4, 6, 7, 8, 10, 16, 18, 22, 23, 25, 30, 31, 33, 37
+  };
+  for (SimdLevel level : supported_levels()) {
+    EXPECT_EQ(index_json_structure(json, level), expected);
+  }
+}
+
+TEST(JSONStructuralIndex, MatchesReferenceAcrossBlocks) {
+  // Long runs of backslashes and quotes cross block boundaries, testing the
+  // state carried between blocks.
+  std::mt19937 random{42};
+  const std::string_view alphabet = "\\\\\\\\\"\"\"{}[]:, \n1a";
+  std::uniform_int_distribution<std::size_t> pick{0, alphabet.size() - 1};
+  for (int round = 0; round < 200; ++round) {
+    std::string json(1 + round * 7, ' ');
+    for (char& c : json) c = alphabet[pick(random)];
+    const std::vector<std::uint32_t> expected = reference_index(json);
+    for (SimdLevel level : supported_levels()) {
+      EXPECT_EQ(index_json_structure(json, level), expected)
+        << "Level " << static_cast<int>(level) << " on " << json;
+    }
+  }
+}
+
+TEST(JSONStructuralIndex, IgnoresEverythingInStrings) {
+  std::string json = "[\"" + std::string(100, 'x') + "\\\\\\\"{},:\", 1]";
+  for (SimdLevel level : supported_levels()) {
+    EXPECT_EQ(
+      index_json_structure(json, level),
+      (std::vector<std::uint32_t>{0, 1, 110, 111, 113, 114})
+    );
+  }
+}
+
+}
+}
@@ -0,0 +1,495 @@
+#include "lw/mime/internal/json_tape.h"
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/arena.h"
+#include "lw/mime/internal/json_scalars.h"
+#include "lw/mime/internal/json_structural_index.h"
+
+namespace lw::mime::internal {
+namespace {
+
+using Tag = JSONTape::Tag;
+
+std::uint64_t make_entry(Tag tag, std::uint64_t payload) {
+  return (static_cast<std::uint64_t>(tag) << 56) | payload;
+}
+
+bool is_json_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/**
+ * Validates a JSON document while appending its values to a tape, keeping
+ * only a stack of the lists and objects still open. This is the second stage
+ * of parsing, walking from token to token using the structural index instead
+ * of looking at every character.
+ */
+class TapeBuilder {
+public:
+  TapeBuilder(std::string_view json, std::vector<std::uint32_t> structurals):
+    _json{json},
+    _structurals{std::move(structurals)}
+  {
+    // Every token takes about one entry.
+    _entries.reserve(_structurals.size() + 2);
+  }
+
+  std::vector<std::uint64_t> build() {
+    Expect expect = Expect::VALUE;
+    std::size_t i = _next_token(0);
+    while (true) {
+      switch (expect) {
+        case Expect::FIRST_ELEMENT: {
+          if (i < _json.size() && _json[i] == ']') {
+            i = _close(i);
+            expect = Expect::SEPARATOR;
+            break;
+          }
+          [[fallthrough]];
+        }
+        case Expect::VALUE: {
+          i = _parse_value(i, expect);
+          break;
+        }
+        case Expect::FIRST_KEY: {
+          if (i < _json.size() && _json[i] == '}') {
+            i = _close(i);
+            expect = Expect::SEPARATOR;
+            break;
+          }
+          [[fallthrough]];
+        }
+        case Expect::KEY: {
+          if (i >= _json.size() || _json[i] != '"') _unexpected_key(i);
+          i = _next_token(_parse_string(i));
+          if (i >= _json.size() || _json[i] != ':') _unexpected(i);
+          ++i;
+          expect = Expect::VALUE;
+          break;
+        }
+        case Expect::SEPARATOR: {
+          if (_stack.empty()) {
+            if (i < _json.size()) {
+              throw InvalidArgument()
+                  << "Unexpected additional input after value at character "
+                  << i << " in JSON.";
+            }
+            return std::move(_entries);
+          }
+          Frame& frame = _stack.back();
+          ++frame.count;
+          if (i < _json.size() && _json[i] == ',') {
+            expect = frame.object ? Expect::KEY : Expect::VALUE;
+            ++i;
+          } else if (
+            i < _json.size() && _json[i] == (frame.object ? '}' : ']')
+          ) {
+            i = _close(i);
+          } else {
+            _unexpected(i);
+          }
+          break;
+        }
+      }
+      i = _next_token(i);
+    }
+  }
+
+private:
+  enum class Expect { VALUE, FIRST_ELEMENT, FIRST_KEY, KEY, SEPARATOR };
+
+  struct Frame {
+    std::size_t start;
+    std::size_t count;
+    bool object;
+  };
+
+  /**
+   * Moves on to the next indexed token after the one ending at `end`.
+   *
+   * Any character between tokens other than whitespace is indexed as a token
+   * of its own, except for those stuck onto the end of a number or keyword,
+   * which leave the next token somewhere other than `end`.
+   */
+  std::size_t _next_token(std::size_t end) {
+    const std::size_t next = _take_structural();
+    if (next != end && !is_json_space(_json[end])) _unexpected(end);
+    return next;
+  }
+
+  std::size_t _take_structural() {
+    if (_cursor == _structurals.size()) return _json.size();
+    return _structurals[_cursor++];
+  }
+
+  [[noreturn]] void _unexpected(std::size_t i) const {
+    if (i >= _json.size()) {
+      throw InvalidArgument() << "Unexpected end of input to JSON parser.";
+    }
+    throw InvalidArgument()
+        << "Unexpected '" << _json[i] << "' at character " << i
+        << " in JSON.";
+  }
+
+  [[noreturn]] void _unexpected_key(std::size_t i) const {
+    if (i >= _json.size()) _unexpected(i);
+    throw InvalidArgument()
+        << "Unexpected '" << _json[i] << "' at character " << i
+        << " in JSON map. Expected STRING key.";
+  }
+
+  std::size_t _parse_value(std::size_t i, Expect& expect) {
+    if (i >= _json.size()) _unexpected(i);
+    switch (_json[i]) {
+      case '{': {
+        _open(Tag::OBJECT_START);
+        expect = Expect::FIRST_KEY;
+        return i + 1;
+      }
+      case '[': {
+        _open(Tag::LIST_START);
+        expect = Expect::FIRST_ELEMENT;
+        return i + 1;
+      }
+      case '"': {
+        expect = Expect::SEPARATOR;
+        return _parse_string(i);
+      }
+      case 't': {
+        expect = Expect::SEPARATOR;
+        return _parse_keyword(i, "true", Tag::TRUE);
+      }
+      case 'f': {
+        expect = Expect::SEPARATOR;
+        return _parse_keyword(i, "false", Tag::FALSE);
+      }
+      case 'n': {
+        expect = Expect::SEPARATOR;
+        return _parse_keyword(i, "null", Tag::NUL);
+      }
+      case '+':
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9': {
+        expect = Expect::SEPARATOR;
+        return _parse_number(i);
+      }
+      default: {
+        _unexpected(i);
+      }
+    }
+  }
+
+  void _open(Tag tag) {
+    _stack.push_back({
+      .start = _entries.size(),
+      .count = 0,
+      .object = tag == Tag::OBJECT_START
+    });
+    _entries.push_back(make_entry(tag, 0));
+    _entries.push_back(0);
+  }
+
+  std::size_t _close(std::size_t i) {
+    const Frame& frame = _stack.back();
+    const std::size_t end = _entries.size();
+    _entries[frame.start] |= end;
+    _entries[frame.start + 1] = frame.count;
+    _entries.push_back(make_entry(
+      frame.object ? Tag::OBJECT_END : Tag::LIST_END,
+      frame.start
+    ));
+    _stack.pop_back();
+    return i + 1;
+  }
+
+  std::size_t _parse_string(std::size_t pos) {
+    // The closing quote is always the next token indexed.
+    const std::size_t start = pos + 1;
+    const std::size_t end = _take_structural();
+    if (end >= _json.size()) {
+      throw InvalidArgument()
+          << "Unexpected end of input at character " << end
+          << " in JSON string starting at character " << pos;
+    }
+    const bool escaped =
+      std::memchr(_json.data() + start, '\\', end - start) != nullptr;
+    _entries.push_back(
+      make_entry(escaped ? Tag::ESCAPED_STRING : Tag::STRING, start)
+    );
+    _entries.push_back(end - start);
+    return end + 1;
+  }
+
+  std::size_t _parse_keyword(
+    std::size_t pos,
+    std::string_view keyword,
+    Tag tag
+  ) {
+    const std::size_t end = pos + keyword.size();
+    if (
+      _json.substr(pos, keyword.size()) != keyword ||
+      (end < _json.size() && (std::isalnum(_json[end]) || _json[end] == '_'))
+    ) {
+      throw InvalidArgument()
+          << "Unknown keyword at character " << pos << " in JSON.";
+    }
+    _entries.push_back(make_entry(tag, pos));
+    return end;
+  }
+
+  std::size_t _parse_number(std::size_t start) {
+    bool is_float;
+    const std::size_t end = scan_json_number(_json, start, is_float);
+    _entries.push_back(
+      make_entry(is_float ? Tag::FLOAT : Tag::INTEGER, start)
+    );
+    _entries.push_back(end - start);
+    return end;
+  }
+
+  std::string_view _json;
+  std::vector<std::uint32_t> _structurals;
+  std::size_t _cursor = 0;
+  std::vector<std::uint64_t> _entries;
+  std::vector<Frame> _stack;
+};
+
+// -------------------------------------------------------------------------- //
+
+class TapeDocument;
+
+/**
+ * A view of one value on a document's tape. Views of list and object elements
+ * are made in the document's arena when first indexed.
+ */
+class TapeValue: public io::DeserializationToken {
+public:
+  TapeValue(const TapeDocument& document, std::size_t index):
+    _document{&document},
+    _index{index}
+  {}
+
+  std::size_t size() const override {
+    if (is_string()) return _string().size();
+    if (is_list() || is_object()) return _tape().entry(_index + 1);
+    throw FailedPrecondition()
+        << "Token is " << json_type_name(_tag())
+        << " which does not have a size.";
+  }
+
+  bool is_null() const override { return _tag() == Tag::NUL; }
+  bool is_boolean() const override {
+    return _tag() == Tag::TRUE || _tag() == Tag::FALSE;
+  }
+  bool is_char() const override { return is_string() && size() == 1; }
+  bool is_signed_integer() const override { return _tag() == Tag::INTEGER; }
+  bool is_unsigned_integer() const override {
+    return _tag() == Tag::INTEGER && _tape().raw(_index).front() != '-';
+  }
+  bool is_floating_point() const override {
+    return _tag() == Tag::INTEGER || _tag() == Tag::FLOAT;
+  }
+  bool is_string() const override {
+    return _tag() == Tag::STRING || _tag() == Tag::ESCAPED_STRING;
+  }
+  bool is_list() const override { return _tag() == Tag::LIST_START; }
+  bool is_object() const override { return _tag() == Tag::OBJECT_START; }
+
+  bool get_boolean() const override {
+    if (!is_boolean()) _wrong_type("BOOLEAN");
+    return _tag() == Tag::TRUE;
+  }
+
+  char get_char() const override {
+    if (!is_char()) _wrong_type("CHAR");
+    return _string().front();
+  }
+
+  std::int64_t get_signed_integer() const override {
+    if (!is_signed_integer()) _wrong_type("INTEGER");
+    return parse_json_signed_integer(_tape().raw(_index));
+  }
+
+  std::uint64_t get_unsigned_integer() const override {
+    if (!is_unsigned_integer()) _wrong_type("unsigned INTEGER");
+    return parse_json_unsigned_integer(_tape().raw(_index));
+  }
+
+  double get_floating_point() const override {
+    if (!is_floating_point()) _wrong_type("FLOAT");
+    return parse_json_floating_point(_tape().raw(_index));
+  }
+
+  std::string_view get_string() const override {
+    if (!is_string()) _wrong_type("STRING");
+    return _string();
+  }
+
+  bool has_index(std::size_t idx) const override {
+    return is_list() && idx < size();
+  }
+
+  const io::DeserializationToken& get_index(std::size_t idx) const override {
+    if (!is_list()) _wrong_type("LIST");
+    if (idx >= size()) {
+      throw OutOfRange() << "Index " << idx << " is larger than this list of "
+                         << size();
+    }
+    return _elements()[idx];
+  }
+
+  bool has_key(std::string_view key) const override {
+    return is_object() && _find(key);
+  }
+
+  const io::DeserializationToken& get_key(std::string_view key) const override {
+    if (!is_object()) _wrong_type("OBJECT");
+    const TapeValue* value = _find(key);
+    if (!value) {
+      throw OutOfRange() << "Key " << key << " is not present in this object.";
+    }
+    return *value;
+  }
+
+private:
+  const JSONTape& _tape() const;
+  Arena& _arena() const;
+
+  Tag _tag() const { return _tape().tag(_index); }
+
+  [[noreturn]] void _wrong_type(std::string_view expected) const {
+    throw FailedPrecondition()
+        << "Token is " << json_type_name(_tag()) << ", not " << expected;
+  }
+
+  /**
+   * The decoded string, decoded into the arena on first use if it has any
+   * escape sequences.
+   */
+  std::string_view _string() const {
+    if (_tag() == Tag::STRING) return _tape().raw(_index);
+    if (!_decoded.data()) {
+      std::string_view raw = _tape().raw(_index);
+      char* out = _arena().allocate_array<char>(raw.size());
+      _decoded = {out, decode_json_string(raw, out)};
+    }
+    return _decoded;
+  }
+
+  const TapeValue* _elements() const {
+    if (_children) return _children;
+
+    const JSONTape& tape = _tape();
+    const std::size_t count = tape.entry(_index + 1);
+    const bool object = is_object();
+    TapeValue* elements = _arena().allocate_array<TapeValue>(count);
+    std::size_t i = _index + 2;
+    for (std::size_t k = 0; k < count; ++k) {
+      if (object) i += 2; // Skip over the key.
+      new (&elements[k]) TapeValue{*_document, i};
+      i = tape.next(i);
+    }
+    _children = elements;
+    return _children;
+  }
+
+  const TapeValue* _find(std::string_view key) const {
+    const JSONTape& tape = _tape();
+    const TapeValue* elements = _elements();
+    const std::size_t count = size();
+    for (std::size_t k = 0; k < count; ++k) {
+      const std::size_t key_index = elements[k]._index - 2;
+      std::string_view raw = tape.raw(key_index);
+      if (tape.tag(key_index) == Tag::STRING) {
+        if (raw == key) return &elements[k];
+      } else if (raw.size() >= key.size()) {
+        std::string decoded(raw.size(), '\0');
+        char* end = decode_json_string(raw, decoded.data());
+        decoded.resize(end - decoded.data());
+        if (decoded == key) return &elements[k];
+      }
+    }
+    return nullptr;
+  }
+
+  const TapeDocument* _document;
+  std::size_t _index;
+  mutable const TapeValue* _children = nullptr;
+  mutable std::string_view _decoded;
+};
+
+/**
+ * The root value, owning the tape and the arena all the other values live in.
+ */
+class TapeDocument: public TapeValue {
+public:
+  explicit TapeDocument(JSONTape tape):
+    TapeValue{*this, 0},
+    _tape{std::move(tape)}
+  {}
+
+  const JSONTape& tape() const { return _tape; }
+  Arena& arena() const { return _arena; }
+
+private:
+  JSONTape _tape;
+  mutable Arena _arena{16 * 1024};
+};
+
+const JSONTape& TapeValue::_tape() const { return _document->tape(); }
+Arena& TapeValue::_arena() const { return _document->arena(); }
+
+}
+
+std::string_view json_type_name(JSONTape::Tag tag) {
+  switch (tag) {
+    case Tag::NUL: return "NUL";
+    case Tag::TRUE:
+    case Tag::FALSE: return "BOOLEAN";
+    case Tag::STRING:
+    case Tag::ESCAPED_STRING: return "STRING";
+    case Tag::INTEGER: return "INTEGER";
+    case Tag::FLOAT: return "FLOAT";
+    case Tag::LIST_START:
+    case Tag::LIST_END: return "LIST";
+    case Tag::OBJECT_START:
+    case Tag::OBJECT_END: return "OBJECT";
+  }
+  return "UNKNOWN";
+}
+
+JSONTape JSONTape::parse(std::string_view json) {
+  return JSONTape{
+    json,
+    TapeBuilder{json, index_json_structure(json)}.build()
+  };
+}
+
+std::unique_ptr<io::DeserializationToken> parse_json_tape(
+  std::string_view json
+) {
+  return std::make_unique<TapeDocument>(JSONTape::parse(json));
+}
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "lw/io/serializer/parser.h"
+
+namespace lw::mime::internal {
+
+/**
+ * A JSON document parsed into one flat array of tagged 64-bit entries, after
+ * the tape used by simdjson.
+ *
+ * Each entry keeps its `Tag` in the top byte and a payload in the rest. Values
+ * are laid out in document order:
+ *
+ *  - NUL, TRUE and FALSE take a single entry.
+ *  - STRING, ESCAPED_STRING, INTEGER and FLOAT hold the offset of the value in
+ *    the source document, and are followed by an entry holding its length.
+ *    Strings are recorded without their quotation marks, and only
+ *    ESCAPED_STRING ones need decoding.
+ *  - LIST_START and OBJECT_START hold the index of their matching end entry,
+ *    and are followed by an entry holding their number of elements. Object
+ *    elements are a STRING or ESCAPED_STRING key followed by the value.
+ *  - LIST_END and OBJECT_END hold the index of their matching start entry.
+ *
+ * Nothing is copied out of the source, which must outlive the tape.
+ */
+class JSONTape {
+public:
+  enum class Tag: std::uint8_t {
+    NUL = 'n',
+    TRUE = 't',
+    FALSE = 'f',
+    STRING = '"',
+    ESCAPED_STRING = '\\',
+    INTEGER = 'i',
+    FLOAT = 'd',
+    LIST_START = '[',
+    LIST_END = ']',
+    OBJECT_START = '{',
+    OBJECT_END = '}'
+  };
+
+  static constexpr std::uint64_t PAYLOAD_MASK = (1ull << 56) - 1;
+
+  /**
+   * Parses and validates a whole JSON document, first indexing where its
+   * tokens are with `index_json_structure`.
+   *
+   * @throw InvalidArgument
+   *  If the document is not valid JSON or is 4GiB or larger.
+   */
+  static JSONTape parse(std::string_view json);
+
+  std::string_view source() const { return _source; }
+  std::size_t size() const { return _entries.size(); }
+  std::uint64_t entry(std::size_t index) const { return _entries[index]; }
+
+  Tag tag(std::size_t index) const {
+    return static_cast<Tag>(_entries[index] >> 56);
+  }
+
+  std::uint64_t payload(std::size_t index) const {
+    return _entries[index] & PAYLOAD_MASK;
+  }
+
+  /**
+   * The source text of the STRING, ESCAPED_STRING, INTEGER or FLOAT value
+   * starting at `index`.
+   */
+  std::string_view raw(std::size_t index) const {
+    return _source.substr(payload(index), _entries[index + 1]);
+  }
+
+  /**
+   * The index of the entry after the value starting at `index`, skipping over
+   * all of its elements if it is a list or object.
+   */
+  std::size_t next(std::size_t index) const {
+    switch (tag(index)) {
+      case Tag::NUL:
+      case Tag::TRUE:
+      case Tag::FALSE:
+        return index + 1;
+      case Tag::LIST_START:
+      case Tag::OBJECT_START:
+        return payload(index) + 1;
+      default:
+        return index + 2;
+    }
+  }
+
+private:
+  JSONTape(std::string_view source, std::vector<std::uint64_t> entries):
+    _source{source},
+    _entries{std::move(entries)}
+  {}
+
+  std::string_view _source;
+  std::vector<std::uint64_t> _entries;
+};
+
+/**
+ * The name of the type of value tagged with `tag`, for error messages.
+ */
+std::string_view json_type_name(JSONTape::Tag tag);
+
+/**
+ * Parses the JSON document onto a tape, returning a token which owns the tape
+ * and an arena for everything its values need later.
+ *
+ * Strings are only decoded the first time they are read, and values only get
+ * tokens of their own when their list or object is first indexed. When an
+ * object has a key more than once, the first is found.
+ *
+ * @throw InvalidArgument
+ *  If the document is not valid JSON.
+ */
+std::unique_ptr<io::DeserializationToken> parse_json_tape(
+  std::string_view json
+);
+
+}
@@ -0,0 +1,84 @@
+#include "lw/mime/internal/json_tape.h"
+
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+
+namespace lw::mime::internal {
+namespace {
+
+using Tag = JSONTape::Tag;
+
+TEST(JSONTape, RecordsScalars) {
+  JSONTape tape = JSONTape::parse(R"([null, true, false, "a\nb", -1, 2.5e3])");
+  ASSERT_EQ(tape.size(), 12);
+  EXPECT_EQ(tape.tag(0), Tag::LIST_START);
+  EXPECT_EQ(tape.payload(0), 11);
+  EXPECT_EQ(tape.entry(1), 6);
+  EXPECT_EQ(tape.tag(2), Tag::NUL);
+  EXPECT_EQ(tape.tag(3), Tag::TRUE);
+  EXPECT_EQ(tape.tag(4), Tag::FALSE);
+  EXPECT_EQ(tape.tag(5), Tag::ESCAPED_STRING);
+  EXPECT_EQ(tape.raw(5), R"(a\nb)");
+  EXPECT_EQ(tape.tag(7), Tag::INTEGER);
+  EXPECT_EQ(tape.raw(7), "-1");
+  EXPECT_EQ(tape.tag(9), Tag::FLOAT);
+  EXPECT_EQ(tape.raw(9), "2.5e3");
+  EXPECT_EQ(tape.tag(11), Tag::LIST_END);
+  EXPECT_EQ(tape.payload(11), 0);
+}
+
+TEST(JSONTape, SkipsNestedValues) {
+  JSONTape tape = JSONTape::parse(R"({"a": {"b": [1, 2]}, "c": "d"})");
+  EXPECT_EQ(tape.tag(0), Tag::OBJECT_START);
+  EXPECT_EQ(tape.entry(1), 2);
+  EXPECT_EQ(tape.raw(2), "a");
+  EXPECT_EQ(tape.tag(4), Tag::OBJECT_START);
+  const std::size_t c = tape.next(4);
+  EXPECT_EQ(tape.tag(c), Tag::STRING);
+  EXPECT_EQ(tape.raw(c), "c");
+  EXPECT_EQ(tape.raw(tape.next(c)), "d");
+  EXPECT_EQ(tape.next(0), tape.size());
+}
+
+TEST(JSONTape, RejectsMalformedDocuments) {
+  for (std::string_view json : {
+    "", "[", "[1,]", "[1 2]", "{\"a\" 1}", "{1: 2}", "{\"a\": 1,}", "[1]]",
+    "\"abc", "tru", "nulls", "01", "1.", "1e", "-", "[1} ", "{\"a\": 1]",
+    "1x", "[\"a\"b]", "[1\\]", "true$", "[\\\"a\"]", "{\"a\"\"b\": 1}"
+  }) {
+    EXPECT_THROW(JSONTape::parse(json), InvalidArgument) << json;
+  }
+}
+
+TEST(JSONTape, DecodesStringsLazily) {
+  auto token = parse_json_tape(R"({"plain": "foo", "esc\"aped": "b\\ar"})");
+  ASSERT_TRUE(token->is_object());
+  EXPECT_EQ(token->size(), 2);
+  EXPECT_EQ(token->get_key("plain").get_string(), "foo");
+  EXPECT_TRUE(token->has_key("esc\"aped"));
+  EXPECT_FALSE(token->has_key("esc\\\"aped"));
+  EXPECT_EQ(token->get_key("esc\"aped").get_string(), "b\\ar");
+  EXPECT_EQ(token->get_key("esc\"aped").size(), 4);
+}
+
+TEST(JSONTape, IndexesNestedValues) {
+  auto token = parse_json_tape(R"([[], {"a": [1, {"b": 2}]}, 3])");
+  ASSERT_EQ(token->size(), 3);
+  EXPECT_EQ(token->get_index(0).size(), 0);
+  EXPECT_FALSE(token->get_index(0).has_index(0));
+  const io::DeserializationToken& a = token->get_index(1).get_key("a");
+  EXPECT_EQ(a.get_index(0).get_unsigned_integer(), 1);
+  EXPECT_EQ(a.get_index(1).get_key("b").get_signed_integer(), 2);
+  EXPECT_EQ(token->get_index(2).get_floating_point(), 3.0);
+  EXPECT_EQ(&token->get_index(2), &token->get_index(2));
+
+  EXPECT_THROW(token->get_index(3), OutOfRange);
+  EXPECT_THROW(token->get_key("a"), FailedPrecondition);
+  EXPECT_THROW(token->get_index(1).get_key("b"), OutOfRange);
+  EXPECT_THROW(token->get_index(2).get_string(), FailedPrecondition);
+}
+
+}
+}
@@ -1,14 +1,14 @@
 #include "lw/mime/json.h"
 
 #include <cctype>
-#include <charconv>
-#include <cmath>
+#include <cstddef>
 #include <cstdint>
-#include <cstdlib>
+#include <deque>
 #include <memory>
 #include <optional>
 #include <ostream>
 #include <stack>
+#include <string>
 #include <string_view>
 #include <unordered_map>
 #include <variant>
@@ -16,6 +16,10 @@
 
 #include "lw/err/canonical.h"
 #include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/internal/json_on_demand.h"
+#include "lw/mime/internal/json_scalars.h"
+#include "lw/mime/internal/json_tape.h"
 
 namespace lw::mime {
 
@@ -29,9 +33,17 @@ namespace lw::mime {
 //                                                                            //
 // -------------------------------------------------------------------------- //
 
-JSONSerializationFormatter::JSONSerializationFormatter(std::ostream& output)
-    : _output{output} {
-  _state.push(State::VALUE);
+JSONSerializationFormatter::JSONSerializationFormatter(BufferChain& output):
+  _output{output}
+{}
+
+JSONSerializationFormatter::JSONSerializationFormatter(std::ostream& output):
+  _output{_stream_buffer},
+  _stream{&output}
+{}
+
+JSONSerializationFormatter::~JSONSerializationFormatter() {
+  if (_stream) _flush();
 }
 
 void JSONSerializationFormatter::put_null() { _add_literal("null"); }
@@ -43,141 +55,137 @@ void JSONSerializationFormatter::put_boolean(bool boolean) {
 void JSONSerializationFormatter::put_char(char c) {
   _check_can_add_string();
   _maybe_comma();
-  _output << '"';
-  _put_char(c);
-  _output << '"';
+  internal::append_json_string({&c, 1}, _output);
   _string_added();
 }
 
 void JSONSerializationFormatter::put_signed_integer(std::int64_t number) {
-  _check_can_add_value();
-  _maybe_comma();
-  _output << number;
-  _value_added();
+  _put_number(number);
 }
 
 void JSONSerializationFormatter::put_unsigned_integer(std::uint64_t number) {
-  _check_can_add_value();
-  _maybe_comma();
-  _output << number;
-  _value_added();
+  _put_number(number);
 }
 
 void JSONSerializationFormatter::put_floating_point(double number) {
-  _check_can_add_value();
-  _maybe_comma();
-  _output << number;
-  _value_added();
+  _put_number(number);
+}
+
+void JSONSerializationFormatter::put_floating_point(float number) {
+  _put_number(number);
 }
 
 void JSONSerializationFormatter::put_string(std::string_view str) {
   _check_can_add_string();
   _maybe_comma();
-  _output << '"';
-  for (char c : str)
-    _put_char(c);
-  _output << '"';
+  internal::append_json_string(str, _output);
   _string_added();
 }
 
 void JSONSerializationFormatter::start_list() {
   _check_can_add_value();
   _maybe_comma();
-  _output << '[';
-  _state.push(State::LIST);
+  _push(State::LIST);
+  _output.push_back('[');
 }
 
 void JSONSerializationFormatter::end_list() {
-  if (_state.top() != State::LIST && _state.top() != State::LIST_VALUE) {
+  if (_top() != State::LIST && _top() != State::LIST_VALUE) {
     throw FailedPrecondition()
         << "Unexpected end of list while formatting JSON.";
   }
-  _output << ']';
+  _output.push_back(']');
+  --_depth;
   _value_added();
 }
 
 void JSONSerializationFormatter::start_object() {
   _check_can_add_value();
   _maybe_comma();
-  _output << '{';
-  _state.push(State::OBJECT);
+  _push(State::OBJECT);
+  _output.push_back('{');
 }
 
 void JSONSerializationFormatter::end_object() {
-  if (_state.top() != State::OBJECT && _state.top() != State::OBJECT_VALUE) {
+  if (_top() != State::OBJECT && _top() != State::OBJECT_VALUE) {
     throw FailedPrecondition()
         << "Unexpected end of object while formatting JSON.";
   }
-  _output << '}';
+  _output.push_back('}');
+  --_depth;
   _value_added();
 }
 
 void JSONSerializationFormatter::start_pair_key() {
-  if (_state.top() != State::OBJECT && _state.top() != State::OBJECT_VALUE) {
+  if (_top() != State::OBJECT && _top() != State::OBJECT_VALUE) {
     throw FailedPrecondition()
         << "Unexpected start of object key while formatting JSON.";
   }
   _maybe_comma();
-  _state.push(State::KEY_STARTED);
+  _push(State::KEY_STARTED);
 }
 
 void JSONSerializationFormatter::end_pair_key() {
-  if (_state.top() != State::KEY_ADDED) {
+  if (_top() != State::KEY_ADDED) {
     throw FailedPrecondition()
         << "Unexpected end of object key while formatting JSON.";
   }
-  _output << ':';
-  _state.pop();
-  _state.push(State::KEY_ENDED);
+  _output.push_back(':');
+  _state[_depth] = State::KEY_ENDED;
 }
 
 void JSONSerializationFormatter::end_pair() {
-  if (_state.top() != State::OBJECT && _state.top() != State::OBJECT_VALUE) {
+  if (_top() != State::OBJECT && _top() != State::OBJECT_VALUE) {
     throw FailedPrecondition()
         << "Unexpected end of object value while formatting JSON.";
   }
   _value_added();
 }
 
+void JSONSerializationFormatter::_push(State state) {
+  if (_depth + 1 == MAX_DEPTH) {
+    throw ResourceExhausted()
+        << "JSON nested deeper than " << MAX_DEPTH << " while formatting.";
+  }
+  _state[++_depth] = state;
+}
+
 void JSONSerializationFormatter::_maybe_comma() {
-  if (_state.top() == State::LIST_VALUE ||
-      _state.top() == State::OBJECT_VALUE) {
-    _output << ',';
+  if (_top() == State::LIST_VALUE || _top() == State::OBJECT_VALUE) {
+    _output.push_back(',');
   }
 }
 
 void JSONSerializationFormatter::_check_can_add_value(
     const std::experimental::source_location& loc) {
-  if (_state.top() != State::VALUE && _state.top() != State::LIST &&
-      _state.top() != State::LIST_VALUE && _state.top() != State::KEY_ENDED) {
+  if (_top() != State::VALUE && _top() != State::LIST &&
+      _top() != State::LIST_VALUE && _top() != State::KEY_ENDED) {
     throw InvalidArgument(loc) << "Unexpected value while formatting JSON.";
   }
 }
 
 void JSONSerializationFormatter::_check_can_add_string(
     const std::experimental::source_location& loc) {
-  if (_state.top() != State::VALUE && _state.top() != State::LIST &&
-      _state.top() != State::LIST_VALUE && _state.top() != State::KEY_STARTED &&
-      _state.top() != State::KEY_ENDED) {
+  if (_top() != State::VALUE && _top() != State::LIST &&
+      _top() != State::LIST_VALUE && _top() != State::KEY_STARTED &&
+      _top() != State::KEY_ENDED) {
     throw InvalidArgument(loc) << "Unexpected string while formatting JSON.";
   }
 }
 
 void JSONSerializationFormatter::_value_added() {
-  switch (_state.top()) {
+  switch (_top()) {
     case State::LIST: {
-      _state.pop();
-      _state.push(State::LIST_VALUE);
+      _state[_depth] = State::LIST_VALUE;
       break;
     }
     case State::OBJECT: {
-      _state.pop();
-      _state.push(State::OBJECT_VALUE);
+      _state[_depth] = State::OBJECT_VALUE;
       break;
     }
     case State::VALUE:
     case State::KEY_ENDED: {
-      _state.pop();
+      --_depth;
       break;
     }
     case State::LIST_VALUE:
@@ -189,12 +197,14 @@ void JSONSerializationFormatter::_value_added() {
       throw Internal() << "Invalid state reached for adding a value.";
     }
   }
+  if (_stream && (_depth == 0 || _output.size() >= _output.block_size())) {
+    _flush();
+  }
 }
 
 void JSONSerializationFormatter::_string_added() {
-  if (_state.top() == State::KEY_STARTED) {
-    _state.pop();
-    _state.push(State::KEY_ADDED);
+  if (_top() == State::KEY_STARTED) {
+    _state[_depth] = State::KEY_ADDED;
   } else {
     _value_added();
   }
@@ -203,26 +213,26 @@ void JSONSerializationFormatter::_string_added() {
 void JSONSerializationFormatter::_add_literal(std::string_view value) {
   _check_can_add_value();
   _maybe_comma();
-  _output << value;
+  _output.append(value);
   _value_added();
 }
 
-void JSONSerializationFormatter::_put_char(char c) {
-  if (c == '"' || c == '\\' || c == '/') {
-    _output << '\\' << c;
-  } else if (c == '\b') {
-    _output << "\\b";
-  } else if (c == '\f') {
-    _output << "\\f";
-  } else if (c == '\n') {
-    _output << "\\n";
-  } else if (c == '\r') {
-    _output << "\\r";
-  } else if (c == '\t') {
-    _output << "\\t";
-  } else {
-    _output << c;
+template <typename Number>
+void JSONSerializationFormatter::_put_number(Number number) {
+  _check_can_add_value();
+  char buffer[internal::JSON_NUMBER_BUFFER_SIZE];
+  const char* end = internal::format_json_number(number, buffer);
+  _maybe_comma();
+  _output.append({buffer, static_cast<std::size_t>(end - buffer)});
+  _value_added();
+}
+
+void JSONSerializationFormatter::_flush() {
+  for (std::size_t i = 0; i < _output.block_count(); ++i) {
+    const std::string_view block = _output.block(i);
+    _stream->write(block.data(), block.size());
   }
+  _output.clear();
 }
 
 // -------------------------------------------------------------------------- //
@@ -256,48 +266,12 @@ std::string_view json_type_name(JSONType type) {
 /**
  * Parses and decodes a JSON-encoded string, including quotation marks, into a
  * plain C++ string.
- *
- * @todo UTF-8 decoding.
  */
 std::string decode_string(std::string_view token) {
-  // TODO(#12): Parse "\uXXXX" sequence as a UTF-8 character.
-  std::string out;
-  out.reserve(token.size());
-  for (std::size_t i = 1; i < token.size() - 1; ++i) {
-    char c = token.at(i);
-    if (c == '\\') {
-      switch (token.at(++i)) {
-        case '"':
-        case '\\':
-        case '/': {
-          out.push_back(token.at(i));
-          break;
-        }
-        case 'b': {
-          out.push_back('\b');
-          break;
-        }
-        case 'f': {
-          out.push_back('\f');
-          break;
-        }
-        case 'n': {
-          out.push_back('\n');
-          break;
-        }
-        case 'r': {
-          out.push_back('\r');
-          break;
-        }
-        case 't': {
-          out.push_back('\t');
-          break;
-        }
-      }
-    } else {
-      out.push_back(c);
-    }
-  }
+  std::string out(token.size() - 2, '\0');
+  char* end =
+    internal::decode_json_string(token.substr(1, out.size()), out.data());
+  out.resize(end - out.data());
   return out;
 }
 
@@ -356,18 +330,7 @@ public:
           << json_type_name(JSONType::INTEGER);
     }
 
-    auto begin = _token.begin();
-    if (*begin == '+') ++begin;
-    std::int64_t out;
-    auto [end, err] = std::from_chars(begin, _token.end(), out);
-    if (end != _token.end() || err == std::errc::invalid_argument) {
-      throw InvalidArgument()
-          << "String " << _token << " is not a valid signed integer.";
-    } else if (err == std::errc::result_out_of_range) {
-      throw InvalidArgument()
-          << "Value " << _token << " is too large for a 64-bit integer.";
-    }
-    return out;
+    return internal::parse_json_signed_integer(_token);
   }
 
   std::uint64_t get_unsigned_integer() const override {
@@ -377,19 +340,7 @@ public:
           << json_type_name(JSONType::INTEGER);
     }
 
-    auto begin = _token.begin();
-    if (*begin == '+') ++begin;
-    std::uint64_t out;
-    auto [end, err] = std::from_chars(begin, _token.end(), out);
-    if (end != _token.end() || err == std::errc::invalid_argument) {
-      throw InvalidArgument()
-          << "String " << _token << " is not a valid unsigned integer.";
-    } else if (err == std::errc::result_out_of_range) {
-      throw InvalidArgument()
-          << "Value " << _token
-          << " is too large for an unsigned 64-bit integer.";
-    }
-    return out;
+    return internal::parse_json_unsigned_integer(_token);
   }
 
   double get_floating_point() const override {
@@ -398,16 +349,7 @@ public:
                                  << ", not " << json_type_name(JSONType::FLOAT);
     }
 
-    char* end = nullptr;
-    double out = std::strtod(_token.begin(), &end);
-    if (end != _token.end()) {
-      throw InvalidArgument()
-          << "String \"" << _token << "\" is not a valid double value.";
-    } else if (out == HUGE_VAL) {
-      throw InvalidArgument()
-          << "Value \"" << _token << "\" is too large for double.";
-    }
-    return out;
+    return internal::parse_json_floating_point(_token);
   }
 
   std::string_view get_string() const override {
@@ -509,8 +451,22 @@ public:
   JSONObjectToken() = default;
   ~JSONObjectToken() = default;
 
+  /**
+   * @param raw_key
+   *  The key as it appears in the document, between the quotes. Keys with
+   *  escapes are decoded into storage owned by the object.
+   */
   void insert(
-      std::string_view key, std::unique_ptr<io::DeserializationToken> value) {
+      std::string_view raw_key,
+      std::unique_ptr<io::DeserializationToken> value) {
+    std::string_view key = raw_key;
+    if (raw_key.find('\\') != std::string_view::npos) {
+      std::string& decoded = _decoded_keys.emplace_back(raw_key.size(), '\0');
+      decoded.resize(
+          internal::decode_json_string(raw_key, decoded.data()) -
+          decoded.data());
+      key = decoded;
+    }
     if (has_key(key)) {
       throw FailedPrecondition()
           << "Key " << key << " already added to object.";
@@ -582,6 +538,8 @@ private:
   std::
       unordered_map<std::string_view, std::unique_ptr<io::DeserializationToken>>
           _elements;
+  // A deque so that adding keys never moves those already viewed.
+  std::deque<std::string> _decoded_keys;
 };
 
 typedef std::variant<
@@ -748,7 +706,10 @@ private:
     std::size_t end = pos;
     std::size_t i;
     for (i = pos + 1; i < str.size(); ++i) {
-      if (str[i] == '\\') continue;
+      if (str[i] == '\\') {
+        ++i; // Skip the escaped character, which may be a quote.
+        continue;
+      }
       if (str[i] == '"') {
         end = i;
         break;
@@ -789,45 +750,12 @@ private:
   }
 
   std::size_t _parse_number(std::string_view str, std::size_t pos) {
-    std::size_t start = pos;
-    JSONType type = JSONType::INTEGER;
-    if (str[pos] == '+' || str[pos] == '-') {
-      ++pos;
-      if (pos >= str.size()) {
-        throw InvalidArgument() << "Unexpected end of input to JSON parser.";
-      }
-    }
-    if (str[pos] == '0') {
-      ++pos;
-      if (pos < str.size() && std::isdigit(str[pos])) {
-        throw InvalidArgument()
-            << "Unexpected digit at character " << pos
-            << " in JSON number. Expected '.' or end of number.";
-      }
-    } else if (!std::isdigit(str[pos])) {
-      throw InvalidArgument() << "Unexpected '" << str[pos] << "' at character "
-                              << pos << " in JSON number.";
-    }
-
-    for (; pos < str.size(); ++pos) {
-      if (str[pos] == '.') {
-        if (type == JSONType::FLOAT) {
-          throw InvalidArgument()
-              << "Unexpected '.' at character " << pos << " in JSON number.";
-        }
-        type = JSONType::FLOAT;
-      } else if (!std::isdigit(str[pos])) {
-        break;
-      }
-    }
-    if (str[pos - 1] == '.') {
-      throw InvalidArgument()
-          << "Unexpected end of number at character " << pos << " in JSON.";
-    }
-
+    bool is_float;
+    const std::size_t end = internal::scan_json_number(str, pos, is_float);
     _token_stack.push(std::make_unique<JSONScalarToken>(
-        type, str.substr(start, pos - start)));
-    return pos - 1;
+        is_float ? JSONType::FLOAT : JSONType::INTEGER,
+        str.substr(pos, end - pos)));
+    return end - 1;
   }
 
   void _pop_top(std::size_t i) {
@@ -884,6 +812,9 @@ private:
 
 std::unique_ptr<io::DeserializationToken>
 JSONDeserializationParser::parse(std::string_view str) const {
+  if (_mode == Mode::TAPE) return internal::parse_json_tape(str);
+  if (_mode == Mode::ON_DEMAND) return internal::parse_json_on_demand(str);
+
   JSONParse parser;
   auto token = parser.update(str);
   if (!token) {
@@ -895,4 +826,8 @@ JSONDeserializationParser::parse(std::string_view str) const {
   return to_io_token(std::move(*token));
 }
 
+// -------------------------------------------------------------------------- //
+
+LW_REGISTER_MIME_SERIALIZER(JSONSerializer, "application/json");
+
 } // namespace lw::mime
@@ -1,20 +1,42 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <experimental/source_location>
 #include <memory>
-#include <stack>
 #include <string_view>
 #include <ostream>
 
 #include "lw/io/serializer/formatter.h"
 #include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer_chain.h"
 #include "lw/mime/mime.h"
 
 namespace lw::mime {
 
+/**
+ * Writes JSON into a chain of buffers, or through one into a `std::ostream`.
+ *
+ * Nesting is tracked in a fixed array, so no more than `MAX_DEPTH` lists,
+ * objects and keys can be open at once.
+ */
 class JSONSerializationFormatter: public io::SerializationFormatter {
 public:
-  JSONSerializationFormatter(std::ostream& output);
+  static constexpr std::size_t MAX_DEPTH = 256;
+
+  /**
+   * Appends the JSON to `output`, which must outlive the formatter.
+   */
+  explicit JSONSerializationFormatter(BufferChain& output);
+
+  /**
+   * Writes the JSON to `output` whenever a block of it has been formatted,
+   * once the top-level value is complete, and when the formatter is destroyed.
+   */
+  explicit JSONSerializationFormatter(std::ostream& output);
+
+  ~JSONSerializationFormatter();
 
   void put_null() override;
   void put_boolean(bool boolean) override;
@@ -22,6 +44,7 @@ public:
   void put_signed_integer(std::int64_t number) override;
   void put_unsigned_integer(std::uint64_t number) override;
   void put_floating_point(double number) override;
+  void put_floating_point(float number) override;
   void put_string(std::string_view str) override;
 
   void start_list() override;
@@ -33,7 +56,11 @@ public:
   void end_pair() override;
 
 private:
-  enum class State {
+  enum class State: std::uint8_t {
+    /**
+     * Below the top-level value, which is done once this is the top state.
+     */
+    DONE,
     VALUE,
     LIST,
     LIST_VALUE,
@@ -44,6 +71,8 @@ private:
     KEY_ENDED
   };
 
+  State _top() const { return _state[_depth]; }
+  void _push(State state);
   void _maybe_comma();
   void _check_can_add_value(
     const std::experimental::source_location& loc =
@@ -56,19 +85,57 @@ private:
   void _value_added();
   void _string_added();
   void _add_literal(std::string_view value);
-  void _put_char(char c);
 
-  std::stack<State> _state;
-  std::ostream& _output;
+  template <typename Number>
+  void _put_number(Number number);
+  void _flush();
+
+  BufferChain _stream_buffer;
+  BufferChain& _output;
+  std::ostream* _stream = nullptr;
+  std::size_t _depth = 1;
+  std::array<State, MAX_DEPTH> _state = {State::DONE, State::VALUE};
 };
 
 // -------------------------------------------------------------------------- //
 
 class JSONDeserializationParser: public io::DeserializationParser {
 public:
+  enum class Mode {
+    /**
+     * Builds a tree of tokens, each allocated separately, decoding every
+     * string as it is parsed.
+     */
+    TREE,
+
+    /**
+     * Records the document on a flat tape of tagged 64-bit entries, making
+     * tokens and decoding strings only when they are first read. Parsing
+     * large documents takes a handful of allocations instead of several per
+     * value.
+     */
+    TAPE,
+
+    /**
+     * Only indexes where the tokens are, finding and validating values when
+     * they are first read and stepping over everything in between. Suits
+     * reading a few fields out of large documents, but errors in the parts
+     * which are never read go unnoticed.
+     */
+    ON_DEMAND
+  };
+
+  JSONDeserializationParser() = default;
+  explicit JSONDeserializationParser(Mode mode): _mode{mode} {}
+
+  Mode mode() const { return _mode; }
+
   std::unique_ptr<io::DeserializationToken> parse(
     std::string_view str
   ) const override;
+
+private:
+  Mode _mode = Mode::TREE;
 };
 
 // -------------------------------------------------------------------------- //
@@ -81,8 +148,16 @@ public:
     return std::make_unique<JSONSerializationFormatter>(output);
   }
 
+  std::unique_ptr<io::SerializationFormatter> make_formatter(
+    BufferChain& output
+  ) override {
+    return std::make_unique<JSONSerializationFormatter>(output);
+  }
+
   std::unique_ptr<io::DeserializationParser> make_parser() override {
-    return std::make_unique<JSONDeserializationParser>();
+    return std::make_unique<JSONDeserializationParser>(
+      JSONDeserializationParser::Mode::TAPE
+    );
   }
 };
 
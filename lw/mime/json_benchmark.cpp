@@ -0,0 +1,467 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/internal/json_structural_index.h"
+#include "lw/mime/json.h"
+
+namespace {
+
+std::atomic<std::uint64_t> allocations{0};
+
+}
+
+// Counts every allocation made while the benchmarks run.
+void* operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size)) return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace lw::mime {
+namespace {
+
+struct Location {
+  double lat;
+  double lng;
+  std::string city;
+};
+
+/**
+ * The records of `make_document`, for benchmarking the formatter.
+ */
+struct UserRecord {
+  std::uint64_t id;
+  std::string name;
+  double score;
+  bool active;
+  std::string bio;
+  std::vector<std::string> tags;
+  Location location;
+};
+
+struct UserRecords {
+  std::vector<UserRecord> records;
+};
+
+}
+}
+
+template <>
+struct lw::io::Serialize<lw::mime::Location> {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::Location& value) {
+    serializer.write("lat", value.lat);
+    serializer.write("lng", value.lng);
+    serializer.write("city", value.city);
+  }
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::UserRecord> {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::UserRecord& value) {
+    serializer.write("id", value.id);
+    serializer.write("name", value.name);
+    serializer.write("score", value.score);
+    serializer.write("active", value.active);
+    serializer.write("bio", value.bio);
+    serializer.write("tags", value.tags);
+    serializer.write("manager", nullptr);
+    serializer.write("location", value.location);
+  }
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::UserRecords> {
+  typedef ListTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::UserRecords& value) {
+    for (const lw::mime::UserRecord& record : value.records) {
+      serializer.write(record);
+    }
+  }
+};
+
+namespace lw::mime {
+namespace {
+
+using Mode = JSONDeserializationParser::Mode;
+
+/**
+ * A list of user records like those returned by typical APIs, roughly
+ * `bytes` long.
+ */
+std::string make_document(std::size_t bytes) {
+  std::string json = "[";
+  for (std::size_t i = 0; json.size() < bytes; ++i) {
+    if (i) json += ',';
+    json += R"({"id":)" + std::to_string(i * 7919) +
+      R"(,"name":"user_)" + std::to_string(i) +
+      R"(","score":)" + std::to_string(i % 100) + ".25" +
+      R"(,"active":)" + (i % 3 ? "true" : "false") +
+      R"(,"bio":"Likes \"quotes\" and\nnew lines, )" +
+      std::string(40, 'x') +
+      R"(","tags":["alpha","beta","gamma"],"manager":null,)" +
+      R"("location":{"lat":45.5,"lng":-122.6,"city":"Portland"}})";
+  }
+  json += ']';
+  return json;
+}
+
+const std::string& document(std::size_t bytes) {
+  static std::map<std::size_t, std::string> documents;
+  auto [itr, added] = documents.try_emplace(bytes);
+  if (added) itr->second = make_document(bytes);
+  return itr->second;
+}
+
+/**
+ * Parses the whole document without reading any of it back.
+ */
+void BM_JSONParse(benchmark::State& state, Mode mode) {
+  const std::string& json = document(state.range(0));
+  JSONDeserializationParser parser{mode};
+  const std::uint64_t start = allocations.load();
+  for (auto _ : state) {
+    std::unique_ptr<io::DeserializationToken> token = parser.parse(json);
+    benchmark::DoNotOptimize(token);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+  state.counters["allocs_per_parse"] =
+    static_cast<double>(allocations.load() - start) / state.iterations();
+}
+BENCHMARK_CAPTURE(BM_JSONParse, tree, Mode::TREE)
+  ->Arg(64 * 1024)->Arg(10 * 1024 * 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONParse, tape, Mode::TAPE)
+  ->Arg(64 * 1024)->Arg(10 * 1024 * 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONParse, on_demand, Mode::ON_DEMAND)
+  ->Arg(64 * 1024)->Arg(10 * 1024 * 1024)->Unit(benchmark::kMillisecond);
+
+/**
+ * Parses the document and then reads every value in it.
+ */
+void BM_JSONParseAndRead(benchmark::State& state, Mode mode) {
+  const std::string& json = document(state.range(0));
+  JSONDeserializationParser parser{mode};
+  const std::uint64_t start = allocations.load();
+  for (auto _ : state) {
+    std::unique_ptr<io::DeserializationToken> token = parser.parse(json);
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < token->size(); ++i) {
+      const io::DeserializationToken& user = token->get_index(i);
+      total += user.get_key("id").get_unsigned_integer();
+      total += user.get_key("name").get_string().size();
+      total += user.get_key("score").get_floating_point();
+      total += user.get_key("active").get_boolean();
+      total += user.get_key("bio").get_string().size();
+      const io::DeserializationToken& tags = user.get_key("tags");
+      for (std::size_t j = 0; j < tags.size(); ++j) {
+        total += tags.get_index(j).get_string().size();
+      }
+      total += user.get_key("manager").is_null();
+      const io::DeserializationToken& location = user.get_key("location");
+      total += location.get_key("lat").get_floating_point();
+      total += location.get_key("lng").get_floating_point();
+      total += location.get_key("city").get_string().size();
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+  state.counters["allocs_per_parse"] =
+    static_cast<double>(allocations.load() - start) / state.iterations();
+}
+BENCHMARK_CAPTURE(BM_JSONParseAndRead, tree, Mode::TREE)
+  ->Arg(64 * 1024)->Arg(10 * 1024 * 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONParseAndRead, tape, Mode::TAPE)
+  ->Arg(64 * 1024)->Arg(10 * 1024 * 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONParseAndRead, on_demand, Mode::ON_DEMAND)
+  ->Arg(64 * 1024)->Arg(10 * 1024 * 1024)->Unit(benchmark::kMillisecond);
+
+/**
+ * A single object of roughly `bytes` with a few small fields around large
+ * nested ones, like a request carrying a bulky payload.
+ */
+std::string make_object(std::size_t bytes) {
+  const std::string& records = document(bytes);
+  return R"({"id":12345,"records":)" + records +
+    R"(,"tags":["a","b","c"],"owner":{"name":"Alaina","roles":["admin"]},)" +
+    R"("history":)" + records.substr(0, records.find("},{") + 1) + "]" +
+    R"(,"name":"bulk upload","count":)" + std::to_string(bytes) + "}";
+}
+
+/**
+ * Reads three fields from the top of a large object: one before the bulk of
+ * it, one after and one at the very end.
+ */
+void BM_JSONExtractFields(benchmark::State& state, Mode mode) {
+  const std::string json = make_object(state.range(0));
+  JSONDeserializationParser parser{mode};
+  const std::uint64_t start = allocations.load();
+  for (auto _ : state) {
+    std::unique_ptr<io::DeserializationToken> token = parser.parse(json);
+    std::size_t total = token->get_key("id").get_unsigned_integer();
+    total += token->get_key("name").get_string().size();
+    total += token->get_key("count").get_unsigned_integer();
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+  state.counters["allocs_per_parse"] =
+    static_cast<double>(allocations.load() - start) / state.iterations();
+}
+BENCHMARK_CAPTURE(BM_JSONExtractFields, tree, Mode::TREE)
+  ->Arg(1024 * 1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_JSONExtractFields, tape, Mode::TAPE)
+  ->Arg(1024 * 1024)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_JSONExtractFields, on_demand, Mode::ON_DEMAND)
+  ->Arg(1024 * 1024)->Unit(benchmark::kMicrosecond);
+
+// -------------------------------------------------------------------------- //
+
+enum Corpus {
+  /**
+   * Status updates with nested users and entities, heavy on short strings
+   * and keys.
+   */
+  TWITTER,
+
+  /**
+   * A time series as an array of floating point numbers.
+   */
+  NUMBERS,
+
+  /**
+   * Multi-kilobyte strings with the occasional escape sequence.
+   */
+  LONG_STRINGS
+};
+
+constexpr std::size_t CORPUS_SIZE = 4 * 1024 * 1024;
+
+std::string make_twitter(std::size_t bytes) {
+  std::string json = R"({"statuses":[)";
+  for (std::size_t i = 0; json.size() < bytes; ++i) {
+    if (i) json += ',';
+    const std::string id = std::to_string(505874924095815700 + i);
+    json +=
+      R"({"created_at":"Sun Aug 31 00:29:15 +0000 2014","id":)" + id +
+      R"(,"id_str":")" + id + R"(","text":"@aym0566x \u540d\u524d: )" +
+      R"(\u524d\u7530\u3042\u3086\u307f https:\/\/t.co\/)" +
+      std::to_string(i) + R"(","truncated":false,)" +
+      R"("entities":{"hashtags":[],"urls":[],"user_mentions":[{)" +
+      R"("screen_name":"aym0566x","id":866260188,"indices":[0,9]}]},)" +
+      R"("user":{"id":1186275104,"name":"\u3042\u3086\u307f",)" +
+      R"("screen_name":"ayuu0123","followers_count":262,)" +
+      R"("friends_count":252,"verified":false,"lang":"ja"},)" +
+      R"("retweet_count":0,"favorite_count":0,"favorited":false,)" +
+      R"("coordinates":null,"lang":"ja"})";
+  }
+  json += R"(],"search_metadata":{"count":100}})";
+  return json;
+}
+
+std::string make_numbers(std::size_t bytes) {
+  std::string json = "[";
+  for (std::size_t i = 0; json.size() < bytes; ++i) {
+    if (i) json += ',';
+    json += std::to_string((i * 7919 % 100000) / 7.0 - 5000.0);
+  }
+  json += ']';
+  return json;
+}
+
+std::string make_long_strings(std::size_t bytes) {
+  std::string json = "[";
+  for (std::size_t i = 0; json.size() < bytes; ++i) {
+    if (i) json += ',';
+    json += '"';
+    for (std::size_t j = 0; j < 64; ++j) {
+      json += "Lorem ipsum dolor sit amet, consectetur adipiscing elit ";
+      if (j % 16 == 15) json += R"(\"quoted\" \\ )";
+    }
+    json += '"';
+  }
+  json += ']';
+  return json;
+}
+
+const std::string& corpus(std::int64_t which) {
+  static const std::string corpora[] = {
+    make_twitter(CORPUS_SIZE),
+    make_numbers(CORPUS_SIZE),
+    make_long_strings(CORPUS_SIZE)
+  };
+  return corpora[which];
+}
+
+/**
+ * The first stage of tape parsing alone, finding every token.
+ */
+void BM_JSONStructuralIndex(benchmark::State& state) {
+  const std::string& json = corpus(state.range(0));
+  const auto level = static_cast<internal::SimdLevel>(state.range(1));
+  if (level > internal::best_simd_level()) {
+    state.SkipWithError("Instructions not supported by this CPU.");
+    return;
+  }
+  for (auto _ : state) {
+    std::vector<std::uint32_t> index =
+      internal::index_json_structure(json, level);
+    benchmark::DoNotOptimize(index);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK(BM_JSONStructuralIndex)
+  ->ArgNames({"corpus", "simd"})
+  ->ArgsProduct({
+    {TWITTER, NUMBERS, LONG_STRINGS},
+    {
+      static_cast<int>(internal::SimdLevel::SCALAR),
+      static_cast<int>(internal::SimdLevel::SSE2),
+      static_cast<int>(internal::SimdLevel::AVX2)
+    }
+  });
+
+/**
+ * Reads back every number in the NUMBERS corpus.
+ */
+void BM_JSONReadNumbers(benchmark::State& state, Mode mode) {
+  const std::string& json = corpus(NUMBERS);
+  JSONDeserializationParser parser{mode};
+  for (auto _ : state) {
+    std::unique_ptr<io::DeserializationToken> token = parser.parse(json);
+    double total = 0;
+    const std::size_t size = token->size();
+    for (std::size_t i = 0; i < size; ++i) {
+      total += token->get_index(i).get_floating_point();
+    }
+    benchmark::DoNotOptimize(total);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK_CAPTURE(BM_JSONReadNumbers, tree, Mode::TREE)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONReadNumbers, tape, Mode::TAPE)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONReadNumbers, on_demand, Mode::ON_DEMAND)
+  ->Unit(benchmark::kMillisecond);
+
+/**
+ * Writes a time series of doubles, or of integers, the size of the NUMBERS
+ * corpus.
+ */
+template <typename Number>
+void BM_JSONWriteNumbers(benchmark::State& state) {
+  std::vector<Number> numbers;
+  for (std::size_t i = 0; i < 400'000; ++i) {
+    numbers.push_back(
+      static_cast<Number>((i * 7919 % 100000) / 7.0 - 5000.0)
+    );
+  }
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    std::stringstream stream;
+    io::Serializer serializer{JSONSerializer{}.make_formatter(stream)};
+    serializer.write(numbers);
+    bytes += stream.tellp();
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * numbers.size());
+}
+BENCHMARK_TEMPLATE(BM_JSONWriteNumbers, double)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_JSONWriteNumbers, std::int64_t)
+  ->Unit(benchmark::kMillisecond);
+
+UserRecords make_user_records(std::size_t count) {
+  UserRecords records;
+  for (std::size_t i = 0; i < count; ++i) {
+    records.records.push_back({
+      .id = i * 7919,
+      .name = "user_" + std::to_string(i),
+      .score = (i % 100) + 0.25,
+      .active = i % 3 != 0,
+      .bio = "Likes \"quotes\" and\nnew lines, " + std::string(40, 'x'),
+      .tags = {"alpha", "beta", "gamma"},
+      .location = {.lat = 45.5, .lng = -122.6, .city = "Portland"}
+    });
+  }
+  return records;
+}
+
+enum class Sink {
+  STREAM,
+  BUFFER_CHAIN
+};
+
+/**
+ * Writes `state.range(0)` user records, about 240 bytes of JSON each, into a
+ * `std::stringstream` or a `BufferChain`.
+ */
+void BM_JSONWriteRecords(benchmark::State& state, Sink sink) {
+  const UserRecords records = make_user_records(state.range(0));
+  std::size_t bytes = 0;
+  const std::uint64_t start = allocations.load();
+  for (auto _ : state) {
+    if (sink == Sink::STREAM) {
+      std::stringstream stream;
+      io::Serializer serializer{JSONSerializer{}.make_formatter(stream)};
+      serializer.write(records);
+      bytes += stream.tellp();
+    } else {
+      BufferChain chain;
+      io::Serializer serializer{JSONSerializer{}.make_formatter(chain)};
+      serializer.write(records);
+      bytes += chain.size();
+    }
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * records.records.size());
+  state.counters["allocs"] =
+    static_cast<double>(allocations.load() - start) / state.iterations();
+}
+BENCHMARK_CAPTURE(BM_JSONWriteRecords, stream, Sink::STREAM)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONWriteRecords, buffer_chain, Sink::BUFFER_CHAIN)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+
+void BM_JSONParseCorpus(benchmark::State& state, Mode mode) {
+  const std::string& json = corpus(state.range(0));
+  JSONDeserializationParser parser{mode};
+  for (auto _ : state) {
+    std::unique_ptr<io::DeserializationToken> token = parser.parse(json);
+    benchmark::DoNotOptimize(token);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+BENCHMARK_CAPTURE(BM_JSONParseCorpus, tree, Mode::TREE)
+  ->ArgName("corpus")->DenseRange(TWITTER, LONG_STRINGS)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONParseCorpus, tape, Mode::TAPE)
+  ->ArgName("corpus")->DenseRange(TWITTER, LONG_STRINGS)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONParseCorpus, on_demand, Mode::ON_DEMAND)
+  ->ArgName("corpus")->DenseRange(TWITTER, LONG_STRINGS)
+  ->Unit(benchmark::kMillisecond);
+
+}
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "lw/base/concepts.h"
+#include "lw/io/serializer/concepts.h"
+#include "lw/io/serializer/fields.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/internal/json_scalars.h"
+#include "lw/mime/json.h"
+
+namespace lw::mime {
+namespace internal {
+
+template <typename T, std::size_t I>
+constexpr std::string_view json_field_name =
+  std::get<I>(io::Serialize<T>::fields).name;
+
+/**
+ * The formatted key of field `I`, worked out once at compile time.
+ */
+template <typename T, std::size_t I>
+constexpr auto json_field_key =
+  make_json_key<json_key_size(json_field_name<T, I>)>(
+    json_field_name<T, I>,
+    I == 0 ? '{' : ','
+  );
+
+}
+
+/**
+ * Writes values as JSON straight into a buffer chain, resolving at compile time
+ * how to write each type.
+ *
+ * Types whose `Serialize` specialization declares its `fields` are written
+ * member by member with their keys already quoted and escaped. Lists, strings,
+ * numbers, booleans and null are written directly. Every other type, such as
+ * maps and types with a hand-written `Serialize::serialize`, falls back to an
+ * `io::Serializer` writing through a `JSONSerializationFormatter`.
+ *
+ * The output is the same as formatting the value with `JSONSerializer`.
+ */
+class JSONEncoder {
+public:
+  /**
+   * @param output
+   *  Where to write the JSON, which must outlive the encoder.
+   */
+  explicit JSONEncoder(BufferChain& output): _output{output} {}
+
+  template <typename T>
+  void encode(const T& value) {
+    if constexpr (std::same_as<T, std::nullptr_t>) {
+      _output.append("null");
+    } else if constexpr (std::same_as<T, bool>) {
+      _output.append(value ? "true" : "false");
+    } else if constexpr (std::same_as<T, char>) {
+      internal::append_json_string({&value, 1}, _output);
+    } else if constexpr (io::SignedIntegerSerializable<T>) {
+      _put_number(static_cast<std::int64_t>(value));
+    } else if constexpr (io::UnsignedIntegerSerializable<T>) {
+      _put_number(static_cast<std::uint64_t>(value));
+    } else if constexpr (std::same_as<T, float>) {
+      _put_number(value);
+    } else if constexpr (std::floating_point<T>) {
+      _put_number(static_cast<double>(value));
+    } else if constexpr (std::convertible_to<const T&, std::string_view>) {
+      internal::append_json_string(value, _output);
+    } else if constexpr (io::FieldSerializable<T>) {
+      _put_fields(
+        value,
+        std::make_index_sequence<
+          std::tuple_size_v<std::remove_cvref_t<
+            decltype(io::Serialize<T>::fields)
+          >>
+        >{}
+      );
+    } else if constexpr (
+      ForwardIterable<T> && !io::ObjectSerializable<T> &&
+      !requires { typename io::Serialize<T>::serialization_category; }
+    ) {
+      _put_list(value);
+    } else {
+      io::Serializer serializer{
+        std::make_unique<JSONSerializationFormatter>(_output)
+      };
+      serializer.write(value);
+    }
+  }
+
+private:
+  template <typename Number>
+  void _put_number(Number number) {
+    char buffer[internal::JSON_NUMBER_BUFFER_SIZE];
+    const char* end = internal::format_json_number(number, buffer);
+    _output.append({buffer, static_cast<std::size_t>(end - buffer)});
+  }
+
+  template <typename T, std::size_t... I>
+  void _put_fields(const T& value, std::index_sequence<I...>) {
+    if constexpr (sizeof...(I) == 0) _output.push_back('{');
+    (_put_field<T, I>(value), ...);
+    _output.push_back('}');
+  }
+
+  template <typename T, std::size_t I>
+  void _put_field(const T& value) {
+    constexpr const auto& key = internal::json_field_key<T, I>;
+    _output.append({key.data(), key.size()});
+    encode(value.*std::get<I>(io::Serialize<T>::fields).member);
+  }
+
+  template <typename List>
+  void _put_list(const List& list) {
+    _output.push_back('[');
+    bool first = true;
+    for (const auto& element : list) {
+      if (!first) _output.push_back(',');
+      first = false;
+      encode(element);
+    }
+    _output.push_back(']');
+  }
+
+  BufferChain& _output;
+};
+
+/**
+ * Appends `value` to `output` as JSON using a `JSONEncoder`.
+ */
+template <typename T>
+void encode_json(const T& value, BufferChain& output) {
+  JSONEncoder{output}.encode(value);
+}
+
+}
@@ -0,0 +1,145 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/io/serializer/fields.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/json.h"
+#include "lw/mime/json_encoder.h"
+
+namespace lw::mime {
+namespace {
+
+/**
+ * An order from a typical shop API, with 20 fields of mixed types.
+ */
+struct Order {
+  std::uint64_t id;
+  std::uint64_t customer_id;
+  std::string customer_name;
+  std::string email;
+  std::string status;
+  std::string currency;
+  double subtotal;
+  double tax;
+  double total;
+  std::int32_t item_count;
+  std::int32_t priority;
+  bool paid;
+  bool shipped;
+  bool gift;
+  std::string street;
+  std::string city;
+  std::string postal_code;
+  std::string note;
+  std::int64_t created_at;
+  std::int64_t updated_at;
+};
+
+}
+}
+
+template <>
+struct lw::io::Serialize<lw::mime::Order>: SerializeFields<lw::mime::Order> {
+  using Order = lw::mime::Order;
+
+  static constexpr std::tuple fields = {
+    field("id", &Order::id),
+    field("customer_id", &Order::customer_id),
+    field("customer_name", &Order::customer_name),
+    field("email", &Order::email),
+    field("status", &Order::status),
+    field("currency", &Order::currency),
+    field("subtotal", &Order::subtotal),
+    field("tax", &Order::tax),
+    field("total", &Order::total),
+    field("item_count", &Order::item_count),
+    field("priority", &Order::priority),
+    field("paid", &Order::paid),
+    field("shipped", &Order::shipped),
+    field("gift", &Order::gift),
+    field("street", &Order::street),
+    field("city", &Order::city),
+    field("postal_code", &Order::postal_code),
+    field("note", &Order::note),
+    field("created_at", &Order::created_at),
+    field("updated_at", &Order::updated_at)
+  };
+};
+
+namespace lw::mime {
+namespace {
+
+constexpr std::size_t ORDER_COUNT = 10'000;
+
+std::vector<Order> make_orders() {
+  std::vector<Order> orders;
+  for (std::size_t i = 0; i < ORDER_COUNT; ++i) {
+    orders.push_back({
+      .id = 1'000'000 + i,
+      .customer_id = i * 7919 % 100'000,
+      .customer_name = "Customer " + std::to_string(i),
+      .email = "customer" + std::to_string(i) + "@example.com",
+      .status = i % 4 ? "processing" : "delivered",
+      .currency = "USD",
+      .subtotal = (i % 1000) + 0.99,
+      .tax = (i % 1000) * 0.0825,
+      .total = (i % 1000) * 1.0825 + 0.99,
+      .item_count = static_cast<std::int32_t>(i % 12 + 1),
+      .priority = static_cast<std::int32_t>(i % 3),
+      .paid = i % 5 != 0,
+      .shipped = i % 2 == 0,
+      .gift = i % 17 == 0,
+      .street = std::to_string(i % 9000 + 100) + " Main Street",
+      .city = "Portland",
+      .postal_code = "97201",
+      .note = i % 10 ? "" : "Leave at the \"side\" door",
+      .created_at = 1'600'000'000 + static_cast<std::int64_t>(i) * 60,
+      .updated_at = 1'600'000'000 + static_cast<std::int64_t>(i) * 90
+    });
+  }
+  return orders;
+}
+
+/**
+ * Writes each order through `io::Serializer`, calling the formatter through
+ * its virtual interface and escaping every key.
+ */
+void BM_JSONEncodeOrders_Serializer(benchmark::State& state) {
+  const std::vector<Order> orders = make_orders();
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    BufferChain chain;
+    for (const Order& order : orders) {
+      io::Serializer serializer{JSONSerializer{}.make_formatter(chain)};
+      serializer.write(order);
+    }
+    bytes += chain.size();
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * orders.size());
+}
+BENCHMARK(BM_JSONEncodeOrders_Serializer)->Unit(benchmark::kMillisecond);
+
+/**
+ * Writes each order with the `JSONEncoder` generated from its fields.
+ */
+void BM_JSONEncodeOrders_Encoder(benchmark::State& state) {
+  const std::vector<Order> orders = make_orders();
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    BufferChain chain;
+    for (const Order& order : orders) encode_json(order, chain);
+    bytes += chain.size();
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * orders.size());
+}
+BENCHMARK(BM_JSONEncodeOrders_Encoder)->Unit(benchmark::kMillisecond);
+
+}
+}
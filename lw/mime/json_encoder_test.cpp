@@ -0,0 +1,147 @@
+#include "lw/mime/json_encoder.h"
+
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/fields.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/io/serializer/testing/tagged_types.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/json.h"
+
+namespace lw::mime {
+namespace {
+
+struct EscapedKey {
+  int value;
+};
+
+struct NoFields {};
+
+struct Nested {
+  io::testing::FieldTagged object;
+  std::vector<std::string> list;
+  std::map<std::string, int> map;
+  double number;
+  float small;
+  std::uint8_t byte;
+};
+
+}
+}
+
+template <>
+struct lw::io::Serialize<lw::mime::EscapedKey>:
+  SerializeFields<lw::mime::EscapedKey>
+{
+  static constexpr std::tuple fields = {
+    field("say \"hi\"\n", &lw::mime::EscapedKey::value)
+  };
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::NoFields>:
+  SerializeFields<lw::mime::NoFields>
+{
+  static constexpr std::tuple<> fields = {};
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::Nested>: SerializeFields<lw::mime::Nested> {
+  static constexpr std::tuple fields = {
+    field("object", &lw::mime::Nested::object),
+    field("list", &lw::mime::Nested::list),
+    field("map", &lw::mime::Nested::map),
+    field("number", &lw::mime::Nested::number),
+    field("small", &lw::mime::Nested::small),
+    field("byte", &lw::mime::Nested::byte)
+  };
+};
+
+namespace lw::mime {
+namespace {
+
+using ::lw::io::testing::FieldTagged;
+
+constexpr std::string_view key_text(const auto& key) {
+  return {key.data(), key.size()};
+}
+
+static_assert(
+  key_text(internal::json_field_key<EscapedKey, 0>) ==
+    R"({"say \"hi\"\n":)"
+);
+static_assert(key_text(internal::json_field_key<Nested, 2>) == R"(,"map":)");
+
+template <typename T>
+std::string encode(const T& value) {
+  BufferChain chain{/*block_size=*/16};
+  encode_json(value, chain);
+  return std::string{static_cast<std::string_view>(chain.flatten())};
+}
+
+template <typename T>
+std::string serialize(const T& value) {
+  std::stringstream stream;
+  io::Serializer serializer{JSONSerializer{}.make_formatter(stream)};
+  serializer.write(value);
+  return stream.str();
+}
+
+TEST(JSONEncoder, Scalars) {
+  EXPECT_EQ(encode(nullptr), "null");
+  EXPECT_EQ(encode(true), "true");
+  EXPECT_EQ(encode(-42), "-42");
+  EXPECT_EQ(encode(42u), "42");
+  EXPECT_EQ(encode(0.1), "0.1");
+  EXPECT_EQ(encode(1.234f), "1.234");
+  EXPECT_EQ(encode('"'), R"("\"")");
+  EXPECT_EQ(encode("tab\there"), R"("tab\there")");
+  EXPECT_EQ(encode(std::string{"a/b"}), R"("a\/b")");
+  EXPECT_EQ(encode(std::vector<int>{1, 2, 3}), "[1,2,3]");
+  EXPECT_EQ(encode(std::vector<int>{}), "[]");
+}
+
+TEST(JSONEncoder, Fields) {
+  const FieldTagged value{.a = 1, .b = "two", .c = {.a = 3, .b = 4, .c = 5}};
+  EXPECT_EQ(encode(value), R"({"a":1,"b":"two","c":{"a":3,"b":4,"c":5}})");
+  EXPECT_EQ(encode(value), serialize(value));
+  EXPECT_EQ(encode(EscapedKey{.value = 7}), R"({"say \"hi\"\n":7})");
+  EXPECT_EQ(encode(EscapedKey{.value = 7}), serialize(EscapedKey{.value = 7}));
+  EXPECT_EQ(encode(NoFields{}), "{}");
+}
+
+TEST(JSONEncoder, MatchesSerializer) {
+  const Nested value{
+    .object = {.a = -1, .b = "x\"", .c = {.a = 1, .b = 2, .c = 3}},
+    .list = {"a", "caf\xc3\xa9\n", ""},
+    .map = {{"k\n", 1}, {"l", 2}},
+    .number = 1e100,
+    .small = 0.5f,
+    .byte = 255
+  };
+  EXPECT_EQ(encode(value), serialize(value));
+}
+
+TEST(JSONEncoder, ListOfFields) {
+  // `io::Serializer` can not write lists of object types, but the encoder can.
+  EXPECT_EQ(
+    encode(std::vector<EscapedKey>{{.value = 1}, {.value = 2}}),
+    R"([{"say \"hi\"\n":1},{"say \"hi\"\n":2}])"
+  );
+}
+
+TEST(JSONEncoder, NonFiniteFloat) {
+  BufferChain chain;
+  EXPECT_THROW(encode_json(1.0 / 0.0, chain), InvalidArgument);
+}
+
+}
+}
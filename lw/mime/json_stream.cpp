@@ -0,0 +1,205 @@
+#include "lw/mime/json_stream.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "lw/co/future.h"
+#include "lw/co/generator.h"
+#include "lw/err/canonical.h"
+#include "lw/io/co/co.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer.h"
+
+namespace lw::mime {
+namespace {
+
+bool is_whitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+}
+
+void JSONStreamParser::push(std::string_view chunk) {
+  if (_finished) {
+    throw FailedPrecondition()
+      << "Cannot push more data to a finished JSON stream.";
+  }
+
+  // Drop everything already yielded so only the partial element is kept.
+  if (_start > 0) {
+    _buffer.erase(0, _start);
+    _scan -= _start;
+    _start = 0;
+  }
+  _buffer.append(chunk);
+}
+
+co::Generator<std::unique_ptr<io::DeserializationToken>>
+JSONStreamParser::elements() {
+  if (_framing == Framing::LINES) {
+    while (true) {
+      const std::size_t newline = _buffer.find('\n', _scan);
+      if (newline == std::string::npos && !_finished) {
+        _scan = _buffer.size();
+        co_return;
+      }
+      const std::size_t end =
+        newline == std::string::npos ? _buffer.size() : newline;
+      std::unique_ptr<io::DeserializationToken> element = _parse(end);
+      _start = _scan = newline == std::string::npos ? end : newline + 1;
+      if (element) co_yield std::move(element);
+      if (newline == std::string::npos) co_return;
+    }
+  }
+
+  while (true) {
+    switch (_state) {
+      case State::BEFORE_ARRAY:
+        if (!_skip_whitespace()) break;
+        if (_buffer[_scan] != '[') {
+          throw InvalidArgument()
+            << "JSON array stream must start with '[', found '"
+            << _buffer[_scan] << "'.";
+        }
+        _start = ++_scan;
+        _state = State::FIRST_ELEMENT;
+        continue;
+
+      case State::FIRST_ELEMENT:
+      case State::ELEMENT: {
+        if (!_find_element_end()) break;
+        const bool closed = _buffer[_scan] == ']';
+        const bool first = _state == State::FIRST_ELEMENT;
+        std::unique_ptr<io::DeserializationToken> element = _parse(_scan);
+        _start = ++_scan;
+        _state = closed ? State::AFTER_ARRAY : State::ELEMENT;
+        if (element) {
+          co_yield std::move(element);
+        } else if (!(first && closed)) {
+          throw InvalidArgument() << "Missing element in JSON array stream.";
+        }
+        continue;
+      }
+
+      case State::AFTER_ARRAY:
+        if (_skip_whitespace()) {
+          throw InvalidArgument()
+            << "Unexpected '" << _buffer[_scan]
+            << "' after the end of JSON array stream.";
+        }
+        break;
+    }
+
+    // Everything buffered so far has been scanned.
+    if (_finished && _state != State::AFTER_ARRAY) {
+      throw InvalidArgument()
+        << "JSON array stream ended before the array was closed.";
+    }
+    co_return;
+  }
+}
+
+bool JSONStreamParser::_find_element_end() {
+  const char* data = _buffer.data();
+  const std::size_t size = _buffer.size();
+  std::size_t i = _scan;
+  while (i < size) {
+    if (_in_string) {
+      for (; i < size; ++i) {
+        const char c = data[i];
+        if (_escaped) {
+          _escaped = false;
+        } else if (c == '\\') {
+          _escaped = true;
+        } else if (c == '"') {
+          _in_string = false;
+          ++i;
+          break;
+        }
+      }
+      continue;
+    }
+
+    switch (data[i]) {
+      case '"':
+        _in_string = true;
+        break;
+      case '[':
+      case '{':
+        ++_depth;
+        break;
+      case ']':
+        if (_depth == 0) {
+          _scan = i;
+          return true;
+        }
+        --_depth;
+        break;
+      case '}':
+        if (_depth == 0) {
+          throw InvalidArgument() << "Unbalanced '}' in JSON array stream.";
+        }
+        --_depth;
+        break;
+      case ',':
+        if (_depth == 0) {
+          _scan = i;
+          return true;
+        }
+        break;
+    }
+    ++i;
+  }
+  _scan = size;
+  return false;
+}
+
+bool JSONStreamParser::_skip_whitespace() {
+  while (_scan < _buffer.size() && is_whitespace(_buffer[_scan])) ++_scan;
+  _start = _scan;
+  return _scan < _buffer.size();
+}
+
+std::unique_ptr<io::DeserializationToken> JSONStreamParser::_parse(
+  std::size_t end
+) const {
+  std::size_t start = _start;
+  while (start < end && is_whitespace(_buffer[start])) ++start;
+  while (end > start && is_whitespace(_buffer[end - 1])) --end;
+  if (start == end) return nullptr;
+  return _parser.parse(std::string_view{_buffer}.substr(start, end - start));
+}
+
+// -------------------------------------------------------------------------- //
+
+co::Future<std::size_t> parse_json_stream(
+  io::BaseCoReader& reader,
+  JSONStreamParser::Framing framing,
+  std::function<void(const io::DeserializationToken&)> callback
+) {
+  JSONStreamParser parser{framing};
+  std::size_t count = 0;
+  while (reader.good()) {
+    Buffer chunk = co_await reader.read(flags::read_block_size);
+    parser.push(chunk);
+    for (std::unique_ptr<io::DeserializationToken>& element :
+      parser.elements()
+    ) {
+      callback(*element);
+      ++count;
+    }
+  }
+
+  parser.finish();
+  for (std::unique_ptr<io::DeserializationToken>& element : parser.elements()) {
+    callback(*element);
+    ++count;
+  }
+  co_return count;
+}
+
+}
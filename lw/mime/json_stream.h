@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "lw/co/future.h"
+#include "lw/co/generator.h"
+#include "lw/io/co/co.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/mime/json.h"
+
+namespace lw::mime {
+
+/**
+ * Parses a stream of JSON values as it arrives, one element at a time.
+ *
+ * Chunks of the stream are `push`ed in as they are read and each element is
+ * parsed on its own as soon as all of it has arrived. Only the element still
+ * being received is held onto, so memory is bounded by the largest element
+ * rather than the whole stream.
+ *
+ * ```cpp
+ *  JSONStreamParser parser{JSONStreamParser::Framing::LINES};
+ *  while (reader.good()) {
+ *    parser.push(co_await reader.read(flags::read_block_size));
+ *    for (auto& element : parser.elements()) ingest(*element);
+ *  }
+ *  parser.finish();
+ *  for (auto& element : parser.elements()) ingest(*element);
+ * ```
+ */
+class JSONStreamParser {
+public:
+  enum class Framing {
+    /**
+     * A single JSON array, each of whose elements is parsed on its own.
+     */
+    ARRAY,
+
+    /**
+     * Newline-delimited JSON, one value per line. Blank lines are skipped.
+     */
+    LINES
+  };
+
+  explicit JSONStreamParser(
+    Framing framing,
+    JSONDeserializationParser::Mode mode =
+      JSONDeserializationParser::Mode::TAPE
+  ):
+    _framing{framing},
+    _parser{mode}
+  {}
+
+  JSONStreamParser(const JSONStreamParser&) = delete;
+  JSONStreamParser& operator=(const JSONStreamParser&) = delete;
+
+  Framing framing() const { return _framing; }
+
+  /**
+   * The number of bytes held onto for elements which have not been completely
+   * received yet.
+   */
+  std::size_t buffered() const { return _buffer.size() - _start; }
+
+  /**
+   * Appends the next chunk of the stream.
+   *
+   * Tokens yielded by `elements` refer to the buffered stream and must not be
+   * used after the next chunk is pushed.
+   *
+   * @throw FailedPrecondition
+   *  If the stream has already been `finish`ed.
+   */
+  void push(std::string_view chunk);
+
+  /**
+   * Marks the end of the stream, so that a final line without a trailing
+   * newline is yielded by the next call to `elements`.
+   */
+  void finish() { _finished = true; }
+
+  /**
+   * Yields every element completely received since the last call, in order.
+   *
+   * @throw InvalidArgument
+   *  If an element is not valid JSON or the stream is not framed properly,
+   *  including ending part way through an element or array.
+   */
+  co::Generator<std::unique_ptr<io::DeserializationToken>> elements();
+
+private:
+  enum class State {
+    BEFORE_ARRAY,
+    FIRST_ELEMENT,
+    ELEMENT,
+    AFTER_ARRAY
+  };
+
+  /**
+   * Moves `_scan` forward to the comma or bracket ending the current array
+   * element, returning false if the buffer ends before it.
+   */
+  bool _find_element_end();
+
+  /**
+   * Moves `_scan` past any whitespace, returning false if the buffer ends
+   * first.
+   */
+  bool _skip_whitespace();
+
+  std::unique_ptr<io::DeserializationToken> _parse(std::size_t end) const;
+
+  Framing _framing;
+  JSONDeserializationParser _parser;
+  std::string _buffer;
+  bool _finished = false;
+
+  /**
+   * Offset in `_buffer` of the first byte not belonging to an element which
+   * has already been yielded.
+   */
+  std::size_t _start = 0;
+
+  /**
+   * Offset in `_buffer` scanning for the end of the current element has
+   * reached.
+   */
+  std::size_t _scan = 0;
+
+  // Scanning state carried between chunks for array elements.
+  State _state = State::BEFORE_ARRAY;
+  std::size_t _depth = 0;
+  bool _in_string = false;
+  bool _escaped = false;
+};
+
+/**
+ * Reads `reader` to its end, parsing each element of the stream as soon as it
+ * has arrived and passing it to `callback`.
+ *
+ * The token passed to `callback` is only valid for the duration of the call.
+ *
+ * @return
+ *  The number of elements read.
+ *
+ * @throw InvalidArgument
+ *  If an element is not valid JSON or the stream is not framed properly.
+ */
+co::Future<std::size_t> parse_json_stream(
+  io::BaseCoReader& reader,
+  JSONStreamParser::Framing framing,
+  std::function<void(const io::DeserializationToken&)> callback
+);
+
+}
@@ -0,0 +1,178 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/io/co/co.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer.h"
+#include "lw/mime/json.h"
+#include "lw/mime/json_stream.h"
+
+namespace lw::mime {
+namespace {
+
+using Framing = JSONStreamParser::Framing;
+
+constexpr std::size_t MiB = 1024 * 1024;
+
+std::string make_record(std::size_t i) {
+  return R"({"id":)" + std::to_string(i) +
+    R"(,"name":"user_)" + std::to_string(i) +
+    R"(","score":)" + std::to_string(i % 100) + ".25" +
+    R"(,"bio":"Likes \"quotes\", [brackets] and {braces})" +
+    R"(","tags":["alpha","beta"],"location":{"lat":45.5,"lng":-122.6}})";
+}
+
+/**
+ * An endless-looking stream of records, generated on the fly so that the
+ * stream itself takes no memory. Each record is followed by a newline or a
+ * comma, depending on the framing.
+ */
+class RecordReadable {
+public:
+  RecordReadable(Framing framing, std::size_t bytes) {
+    const char separator = framing == Framing::LINES ? '\n' : ',';
+    if (framing == Framing::ARRAY) _prefix = "[";
+    for (std::size_t i = 0; _block.size() < 64 * 1024; ++i) {
+      _block += make_record(i);
+      _block += separator;
+    }
+    _suffix = framing == Framing::LINES ? "{}\n" : "{}]";
+    _remaining_blocks = bytes / _block.size();
+  }
+
+  bool eof() const { return !good(); }
+  bool good() const {
+    return !_prefix.empty() || _remaining_blocks > 0 || !_suffix.empty();
+  }
+
+  co::Future<std::size_t> read(Buffer& buffer) {
+    std::string_view source;
+    if (!_prefix.empty()) {
+      source = _prefix;
+    } else if (_remaining_blocks > 0) {
+      source = std::string_view{_block}.substr(_block_pos);
+    } else {
+      source = _suffix;
+    }
+
+    const std::size_t size = std::min(source.size(), buffer.size());
+    buffer.copy(source.data(), size);
+    if (!_prefix.empty()) {
+      _prefix = _prefix.substr(size);
+    } else if (_remaining_blocks > 0) {
+      _block_pos += size;
+      if (_block_pos == _block.size()) {
+        _block_pos = 0;
+        --_remaining_blocks;
+      }
+    } else {
+      _suffix = _suffix.substr(size);
+    }
+    co_return size;
+  }
+
+private:
+  std::string _block;
+  std::size_t _block_pos = 0;
+  std::size_t _remaining_blocks;
+  std::string_view _prefix;
+  std::string_view _suffix;
+};
+
+double peak_rss_mib() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss / 1024.0; // ru_maxrss is in KiB on Linux.
+}
+
+co::Task stream_records(
+  Framing framing,
+  std::size_t bytes,
+  std::size_t* elements,
+  std::int64_t* total
+) {
+  RecordReadable readable{framing, bytes};
+  io::CoReader<RecordReadable> reader{readable};
+  *elements = co_await parse_json_stream(
+    reader,
+    framing,
+    [total](const io::DeserializationToken& element) {
+      if (element.has_key("id")) {
+        *total += element.get_key("id").get_signed_integer();
+      }
+    }
+  );
+}
+
+co::Task buffer_records(std::size_t bytes, std::int64_t* total) {
+  RecordReadable readable{Framing::ARRAY, bytes};
+  io::CoReader<RecordReadable> reader{readable};
+  std::string json;
+  while (reader.good()) {
+    Buffer chunk = co_await reader.read(flags::read_block_size);
+    json += static_cast<std::string_view>(chunk);
+  }
+  JSONDeserializationParser parser{JSONDeserializationParser::Mode::TAPE};
+  std::unique_ptr<io::DeserializationToken> token = parser.parse(json);
+  for (std::size_t i = 0; i + 1 < token->size(); ++i) {
+    *total += token->get_index(i).get_key("id").get_signed_integer();
+  }
+}
+
+/**
+ * Reads a stream of `state.range(0)` MiB with `parse_json_stream`.
+ */
+void BM_JSONStreamIngest(benchmark::State& state, Framing framing) {
+  const std::size_t bytes = state.range(0) * MiB;
+  std::size_t elements = 0;
+  std::int64_t total = 0;
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(
+      stream_records(framing, bytes, &elements, &total)
+    );
+    co::Scheduler::this_thread().run();
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["elements"] = elements;
+  state.counters["peak_rss_MiB"] = peak_rss_mib();
+}
+BENCHMARK_CAPTURE(BM_JSONStreamIngest, lines, Framing::LINES)
+  ->ArgName("MiB")->Arg(256)->Arg(2048)
+  ->Iterations(1)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_JSONStreamIngest, array, Framing::ARRAY)
+  ->ArgName("MiB")->Arg(256)->Arg(2048)
+  ->Iterations(1)->Unit(benchmark::kMillisecond);
+
+/**
+ * For comparison, buffers the whole array before parsing it in one go the way
+ * a handler using `HttpRequest::body()` would. Peak RSS only ever grows, so
+ * this runs after the streaming benchmarks and on a smaller stream.
+ */
+void BM_JSONBufferedIngest(benchmark::State& state) {
+  const std::size_t bytes = state.range(0) * MiB;
+  std::int64_t total = 0;
+  for (auto _ : state) {
+    co::Scheduler::this_thread().schedule(buffer_records(bytes, &total));
+    co::Scheduler::this_thread().run();
+  }
+  benchmark::DoNotOptimize(total);
+  state.SetBytesProcessed(state.iterations() * bytes);
+  state.counters["peak_rss_MiB"] = peak_rss_mib();
+}
+BENCHMARK(BM_JSONBufferedIngest)
+  ->ArgName("MiB")->Arg(256)
+  ->Iterations(1)->Unit(benchmark::kMillisecond);
+
+}
+}
@@ -0,0 +1,189 @@
+#include "lw/mime/json_stream.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/err/canonical.h"
+#include "lw/io/co/testing/string_reader.h"
+#include "lw/io/serializer/parser.h"
+
+namespace lw::mime {
+namespace {
+
+using Framing = JSONStreamParser::Framing;
+using ::lw::io::testing::StringReader;
+
+/**
+ * Pushes `json` into the parser `chunk_size` bytes at a time, reading the
+ * "id" of every element as it is yielded.
+ */
+std::vector<std::int64_t> read_ids(
+  JSONStreamParser& parser,
+  std::string_view json,
+  std::size_t chunk_size
+) {
+  std::vector<std::int64_t> ids;
+  for (std::size_t i = 0; i < json.size(); i += chunk_size) {
+    parser.push(json.substr(i, chunk_size));
+    for (auto& element : parser.elements()) {
+      ids.push_back(element->get_key("id").get_signed_integer());
+    }
+  }
+  parser.finish();
+  for (auto& element : parser.elements()) {
+    ids.push_back(element->get_key("id").get_signed_integer());
+  }
+  return ids;
+}
+
+void read_all(JSONStreamParser& parser, std::string_view json) {
+  parser.push(json);
+  parser.finish();
+  for (auto& element : parser.elements()) EXPECT_NE(element, nullptr);
+}
+
+TEST(JSONStreamParser, Lines) {
+  constexpr std::string_view json =
+    "{\"id\":1}\n{\"id\": 2, \"tags\": [\"a\\n\"]}\r\n\n  \n{\"id\":3}";
+  for (std::size_t chunk_size : {1, 2, 7, 100}) {
+    JSONStreamParser parser{Framing::LINES};
+    EXPECT_EQ(
+      read_ids(parser, json, chunk_size),
+      (std::vector<std::int64_t>{1, 2, 3})
+    ) << "Chunk size: " << chunk_size;
+  }
+}
+
+TEST(JSONStreamParser, Array) {
+  constexpr std::string_view json =
+    " [ {\"id\":1, \"s\": \"a,]\\\"}[\"}, {\"id\":2,\"l\":[[],{}]}"
+    ",{\"id\":3}\n] ";
+  for (std::size_t chunk_size : {1, 2, 7, 100}) {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_EQ(
+      read_ids(parser, json, chunk_size),
+      (std::vector<std::int64_t>{1, 2, 3})
+    ) << "Chunk size: " << chunk_size;
+  }
+}
+
+TEST(JSONStreamParser, ArrayOfScalars) {
+  JSONStreamParser parser{
+    Framing::ARRAY,
+    JSONDeserializationParser::Mode::TREE
+  };
+  parser.push("[1, \"two\", null, 4");
+  std::vector<std::string> values;
+  for (auto& element : parser.elements()) {
+    values.push_back(
+      element->is_string() ? std::string{element->get_string()} :
+      element->is_null() ? "null" :
+      std::to_string(element->get_signed_integer())
+    );
+  }
+  EXPECT_EQ(values, (std::vector<std::string>{"1", "two", "null"}));
+
+  parser.push("2]");
+  parser.finish();
+  for (auto& element : parser.elements()) {
+    EXPECT_EQ(element->get_signed_integer(), 42);
+  }
+}
+
+TEST(JSONStreamParser, EmptyArray) {
+  JSONStreamParser parser{Framing::ARRAY};
+  EXPECT_EQ(read_ids(parser, "[ \n ]", 1), std::vector<std::int64_t>{});
+}
+
+TEST(JSONStreamParser, OnlyBuffersPartialElement) {
+  JSONStreamParser parser{Framing::ARRAY};
+  parser.push("[{\"id\":1},{\"id\":2},{\"id\"");
+  std::size_t count = 0;
+  for ([[maybe_unused]] auto& element : parser.elements()) ++count;
+  EXPECT_EQ(count, 2);
+  EXPECT_EQ(parser.buffered(), 5);
+
+  parser.push(":3}]");
+  for (auto& element : parser.elements()) {
+    EXPECT_EQ(element->get_key("id").get_signed_integer(), 3);
+  }
+  EXPECT_EQ(parser.buffered(), 0);
+}
+
+TEST(JSONStreamParser, InvalidFraming) {
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "{\"id\":1}"), InvalidArgument);
+  }
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "[1,,2]"), InvalidArgument);
+  }
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "[1,]"), InvalidArgument);
+  }
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "[1,2"), InvalidArgument);
+  }
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "[1}"), InvalidArgument);
+  }
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "[1] 2"), InvalidArgument);
+  }
+}
+
+TEST(JSONStreamParser, InvalidElement) {
+  {
+    JSONStreamParser parser{Framing::ARRAY};
+    EXPECT_THROW(read_all(parser, "[{\"id\":}]"), InvalidArgument);
+  }
+  {
+    JSONStreamParser parser{Framing::LINES};
+    EXPECT_THROW(read_all(parser, "{\"id\":1}\n{\"id\":1"), InvalidArgument);
+  }
+}
+
+TEST(JSONStreamParser, PushAfterFinish) {
+  JSONStreamParser parser{Framing::LINES};
+  parser.finish();
+  EXPECT_THROW(parser.push("{}"), FailedPrecondition);
+}
+
+TEST(JSONStream, ParsesReader) {
+  co::Scheduler::this_thread().schedule([]() -> co::Task {
+    std::string json = "[";
+    for (std::size_t i = 0; i < 5000; ++i) {
+      if (i) json += ',';
+      json += "{\"id\":" + std::to_string(i) + ",\"pad\":\"" +
+        std::string(i % 50, 'x') + "\"}";
+    }
+    json += ']';
+
+    StringReader reader{json};
+    std::int64_t expected = 0;
+    std::size_t count = co_await parse_json_stream(
+      reader,
+      Framing::ARRAY,
+      [&](const io::DeserializationToken& element) {
+        EXPECT_EQ(element.get_key("id").get_signed_integer(), expected++);
+      }
+    );
+    EXPECT_EQ(count, 5000);
+    EXPECT_EQ(expected, 5000);
+  });
+  co::Scheduler::this_thread().run();
+}
+
+}
+}
@@ -1,5 +1,7 @@
 #include "lw/mime/json.h"
 
+#include <cstddef>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <string>
@@ -7,8 +9,10 @@
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "lw/err/canonical.h"
 #include "lw/io/serializer/serializer.h"
 #include "lw/io/serializer/testing/tagged_types.h"
+#include "lw/memory/buffer_chain.h"
 
 namespace lw::mime {
 namespace {
@@ -26,10 +30,25 @@ std::string serialize(const T& value) {
   return stream.str();
 }
 
-std::unique_ptr<io::DeserializationToken> parse(std::string_view str) {
-  JSONDeserializationParser parser;
-  return parser.parse(str);
-}
+class JSONParser:
+  public ::testing::TestWithParam<JSONDeserializationParser::Mode>
+{
+protected:
+  std::unique_ptr<io::DeserializationToken> parse(std::string_view str) {
+    JSONDeserializationParser parser{GetParam()};
+    return parser.parse(str);
+  }
+};
+
+INSTANTIATE_TEST_SUITE_P(
+  Modes,
+  JSONParser,
+  ::testing::Values(
+    JSONDeserializationParser::Mode::TREE,
+    JSONDeserializationParser::Mode::TAPE,
+    JSONDeserializationParser::Mode::ON_DEMAND
+  )
+);
 
 TEST(JSONSerializer, Null) {
   EXPECT_EQ(serialize(nullptr), "null");
@@ -44,6 +63,16 @@ TEST(JSONSerializer, Integer) {
 TEST(JSONSerializer, Float) {
   EXPECT_EQ(serialize(3.14), "3.14");
   EXPECT_EQ(serialize(1.234f), "1.234");
+  EXPECT_EQ(serialize(0.1 + 0.2), "0.30000000000000004");
+  EXPECT_EQ(serialize(1e100), "1e+100");
+  EXPECT_EQ(serialize(std::vector<double>{0.5, -2.0}), "[0.5,-2]");
+}
+
+TEST(JSONSerializer, NonFiniteFloat) {
+  EXPECT_THROW(
+    serialize(std::numeric_limits<double>::infinity()),
+    InvalidArgument
+  );
 }
 
 TEST(JSONSerializer, String) {
@@ -54,6 +83,15 @@ TEST(JSONSerializer, String) {
   EXPECT_EQ(serialize("foo\"bar"), R"("foo\"bar")");
 }
 
+TEST(JSONSerializer, StringControlCharacters) {
+  EXPECT_EQ(serialize("a\x01\x1f/\n"), R"("a\u0001\u001f\/\n")");
+  EXPECT_EQ(serialize('\x7f'), "\"\x7f\"");
+  EXPECT_EQ(
+    serialize(std::string(20, 'x') + "\t" + std::string(20, 'y')),
+    "\"" + std::string(20, 'x') + "\\t" + std::string(20, 'y') + "\""
+  );
+}
+
 TEST(JSONSerializer, Boolean) {
   EXPECT_EQ(serialize(true), "true");
   EXPECT_EQ(serialize(false), "false");
@@ -63,6 +101,13 @@ TEST(JSONSerializer, List) {
   EXPECT_EQ(serialize(std::vector<int>{{1, 2, 3}}), "[1,2,3]");
 }
 
+TEST(JSONSerializer, NestedList) {
+  EXPECT_EQ(
+    serialize(std::vector<std::vector<int>>{{1, 2}, {}, {3}}),
+    "[[1,2],[],[3]]"
+  );
+}
+
 TEST(JSONSerializer, ListTagged) {
   EXPECT_EQ(serialize(ListTagged{.a = 1, .b = 2, .c = 3}), "[1,2,3]");
 }
@@ -81,9 +126,55 @@ TEST(JSONSerializer, ObjectTagged) {
   );
 }
 
+TEST(JSONSerializer, NestedObject) {
+  EXPECT_EQ(
+    serialize(std::map<std::string, std::map<std::string, int>>{
+      {"a", {{"b", 1}}},
+      {"c", {}}
+    }),
+    R"({"a":{"b":1},"c":{}})"
+  );
+}
+
+TEST(JSONSerializer, BufferChain) {
+  BufferChain chain{/*block_size=*/16};
+  JSONSerializer json;
+  io::Serializer serializer{json.make_formatter(chain)};
+  serializer.write(std::map<std::string, std::vector<std::string>>{
+    {"quoted", {"say \"hi\"", "tab\there"}},
+    {"plain", {std::string(40, 'x')}}
+  });
+  EXPECT_GT(chain.block_count(), 1);
+  EXPECT_EQ(
+    static_cast<std::string_view>(chain.flatten()),
+    R"({"plain":[")" + std::string(40, 'x') +
+      R"("],"quoted":["say \"hi\"","tab\there"]})"
+  );
+}
+
+TEST(JSONSerializer, MaxDepth) {
+  BufferChain chain;
+  JSONSerializationFormatter formatter{chain};
+  for (std::size_t i = 1; i + 1 < JSONSerializationFormatter::MAX_DEPTH; ++i) {
+    formatter.start_list();
+  }
+  EXPECT_THROW(formatter.start_list(), ResourceExhausted);
+  EXPECT_THROW(formatter.start_object(), ResourceExhausted);
+  formatter.put_null();
+  EXPECT_EQ(chain.size(), JSONSerializationFormatter::MAX_DEPTH - 2 + 4);
+}
+
+TEST(JSONSerializer, ValueAfterDone) {
+  BufferChain chain;
+  JSONSerializationFormatter formatter{chain};
+  formatter.put_null();
+  EXPECT_THROW(formatter.put_null(), InvalidArgument);
+  EXPECT_THROW(formatter.end_list(), FailedPrecondition);
+}
+
 // -------------------------------------------------------------------------- //
 
-TEST(JSONParser, Null) {
+TEST_P(JSONParser, Null) {
   auto token = parse("null");
   ASSERT_NE(token, nullptr);
 
@@ -101,7 +192,7 @@ TEST(JSONParser, Null) {
   EXPECT_FALSE(token->has_key("null"));
 }
 
-TEST(JSONParser, Integer) {
+TEST_P(JSONParser, Integer) {
   auto token = parse("42");
   ASSERT_NE(token, nullptr);
 
@@ -123,7 +214,7 @@ TEST(JSONParser, Integer) {
   EXPECT_EQ(token->get_floating_point(), 42.0);
 }
 
-TEST(JSONParser, NegativeSignedInteger) {
+TEST_P(JSONParser, NegativeSignedInteger) {
   auto token = parse("-42");
   ASSERT_NE(token, nullptr);
 
@@ -144,7 +235,7 @@ TEST(JSONParser, NegativeSignedInteger) {
   EXPECT_EQ(token->get_floating_point(), -42.0);
 }
 
-TEST(JSONParser, PositiveSignedInteger) {
+TEST_P(JSONParser, PositiveSignedInteger) {
   auto token = parse("+42");
   ASSERT_NE(token, nullptr);
 
@@ -166,7 +257,7 @@ TEST(JSONParser, PositiveSignedInteger) {
   EXPECT_EQ(token->get_floating_point(), 42.0);
 }
 
-TEST(JSONParser, Float) {
+TEST_P(JSONParser, Float) {
   auto token = parse("3.14");
   ASSERT_NE(token, nullptr);
 
@@ -186,7 +277,7 @@ TEST(JSONParser, Float) {
   EXPECT_EQ(token->get_floating_point(), 3.14);
 }
 
-TEST(JSONParser, NegativeSignedFloat) {
+TEST_P(JSONParser, NegativeSignedFloat) {
   auto token = parse("-3.14");
   ASSERT_NE(token, nullptr);
 
@@ -206,7 +297,7 @@ TEST(JSONParser, NegativeSignedFloat) {
   EXPECT_EQ(token->get_floating_point(), -3.14);
 }
 
-TEST(JSONParser, PositiveSignedFloat) {
+TEST_P(JSONParser, PositiveSignedFloat) {
   auto token = parse("+3.14");
   ASSERT_NE(token, nullptr);
 
@@ -226,7 +317,17 @@ TEST(JSONParser, PositiveSignedFloat) {
   EXPECT_EQ(token->get_floating_point(), 3.14);
 }
 
-TEST(JSONParser, String) {
+TEST_P(JSONParser, Exponent) {
+  auto token = parse("[-1.5e3, 2E-2, 1e+2]");
+  ASSERT_NE(token, nullptr);
+
+  EXPECT_EQ(token->get_index(0).get_floating_point(), -1500.0);
+  EXPECT_EQ(token->get_index(1).get_floating_point(), 0.02);
+  EXPECT_EQ(token->get_index(2).get_floating_point(), 100.0);
+  EXPECT_FALSE(token->get_index(2).is_signed_integer());
+}
+
+TEST_P(JSONParser, String) {
   auto token = parse(R"("foobar")");
   ASSERT_NE(token, nullptr);
 
@@ -248,7 +349,7 @@ TEST(JSONParser, String) {
   EXPECT_EQ(token->get_string(), "foobar");
 }
 
-TEST(JSONParser, StringEscapes) {
+TEST_P(JSONParser, StringEscapes) {
   auto token = parse(R"("\\\\")");
   ASSERT_NE(token, nullptr);
 
@@ -270,7 +371,16 @@ TEST(JSONParser, StringEscapes) {
   EXPECT_EQ(token->get_string(), "\\\\");
 }
 
-TEST(JSONParser, DecodesString) {
+TEST_P(JSONParser, EscapedQuote) {
+  auto token = parse(R"(["foo\"bar", 1])");
+  ASSERT_NE(token, nullptr);
+
+  EXPECT_EQ(token->size(), 2);
+  EXPECT_EQ(token->get_index(0).get_string(), "foo\"bar");
+  EXPECT_EQ(token->get_index(1).get_unsigned_integer(), 1);
+}
+
+TEST_P(JSONParser, DecodesString) {
   auto token = parse(R"("\fooba\r")");
   ASSERT_NE(token, nullptr);
 
@@ -292,7 +402,32 @@ TEST(JSONParser, DecodesString) {
   EXPECT_EQ(token->get_string(), "\fooba\r");
 }
 
-TEST(JSONParser, Char) {
+TEST_P(JSONParser, DecodesUnicodeEscapes) {
+  auto token = parse(R"(["\u00e9\u20ac", "\ud83d\ude00"])");
+  ASSERT_NE(token, nullptr);
+  EXPECT_EQ(token->get_index(0).get_string(), "\u00e9\u20ac");
+  EXPECT_EQ(token->get_index(1).get_string(), "\U0001f600");
+}
+
+TEST_P(JSONParser, RoundTripsFormattedStrings) {
+  std::string str = "quote\" slash/ backslash\\ \u00e9 ";
+  for (char c = 0; c < 0x20; ++c) str += c;
+
+  BufferChain chain;
+  JSONSerializer json;
+  io::Serializer serializer{json.make_formatter(chain)};
+  serializer.write(std::map<std::string, std::string>{{str, str}});
+  const std::string serialized{
+    static_cast<std::string_view>(chain.flatten())
+  };
+
+  auto token = parse(serialized);
+  ASSERT_NE(token, nullptr);
+  ASSERT_TRUE(token->has_key(str));
+  EXPECT_EQ(token->get_key(str).get_string(), str);
+}
+
+TEST_P(JSONParser, Char) {
   auto token = parse(R"("f")");
   ASSERT_NE(token, nullptr);
 
@@ -315,7 +450,7 @@ TEST(JSONParser, Char) {
   EXPECT_EQ(token->get_string(), "f");
 }
 
-TEST(JSONParser, DecodesChar) {
+TEST_P(JSONParser, DecodesChar) {
   auto token = parse(R"("\n")");
   ASSERT_NE(token, nullptr);
 
@@ -338,7 +473,7 @@ TEST(JSONParser, DecodesChar) {
   EXPECT_EQ(token->get_string(), "\n");
 }
 
-TEST(JSONParser, True) {
+TEST_P(JSONParser, True) {
   auto token = parse("true");
   ASSERT_NE(token, nullptr);
 
@@ -358,7 +493,7 @@ TEST(JSONParser, True) {
   EXPECT_TRUE(token->get_boolean());
 }
 
-TEST(JSONParser, False) {
+TEST_P(JSONParser, False) {
   auto token = parse("false");
   ASSERT_NE(token, nullptr);
 
@@ -378,7 +513,7 @@ TEST(JSONParser, False) {
   EXPECT_FALSE(token->get_boolean());
 }
 
-TEST(JSONParser, List) {
+TEST_P(JSONParser, List) {
   auto token = parse(R"(["foo", 2, null])");
   ASSERT_NE(token, nullptr);
 
@@ -409,7 +544,7 @@ TEST(JSONParser, List) {
   EXPECT_EQ(token->get_index(1).get_unsigned_integer(), 2);
 }
 
-TEST(JSONParser, EmptyList) {
+TEST_P(JSONParser, EmptyList) {
   auto token = parse(R"([])");
   ASSERT_NE(token, nullptr);
 
@@ -429,7 +564,7 @@ TEST(JSONParser, EmptyList) {
   EXPECT_EQ(token->size(), 0);
 }
 
-TEST(JSONParser, NestedList) {
+TEST_P(JSONParser, NestedList) {
   auto token = parse(R"([[1,2]])");
   ASSERT_NE(token, nullptr);
 
@@ -457,7 +592,7 @@ TEST(JSONParser, NestedList) {
   EXPECT_EQ(token->get_index(0).get_index(1).get_unsigned_integer(), 2);
 }
 
-TEST(JSONParser, Object) {
+TEST_P(JSONParser, Object) {
   auto token = parse(R"({"foo": "bar", "fizz":2})");
   ASSERT_NE(token, nullptr);
 
@@ -0,0 +1,152 @@
+#include "lw/mime/mime.h"
+
+#include <cctype>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace lw::mime {
+namespace {
+
+typedef std::map<std::string, std::unique_ptr<MimeSerializer>, std::less<>>
+MimeRegistry;
+
+MimeRegistry& get_registry() {
+  static auto* registry = new MimeRegistry{};
+  return *registry;
+}
+
+std::string_view trim(std::string_view str) {
+  while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+    str.remove_prefix(1);
+  }
+  while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+    str.remove_suffix(1);
+  }
+  return str;
+}
+
+std::string to_lower(std::string_view str) {
+  std::string lower{str};
+  for (char& c : lower) c = std::tolower(static_cast<unsigned char>(c));
+  return lower;
+}
+
+/**
+ * The media type of a header value, before any parameters.
+ */
+std::string media_type(std::string_view value) {
+  return to_lower(trim(value.substr(0, value.find(';'))));
+}
+
+// Qualities are compared as whole thousandths, the finest a q value can give.
+constexpr int MAX_QUALITY = 1000;
+
+/**
+ * Parses a q value, "0" or "1" with up to three decimal places, into
+ * thousandths. Malformed values count as 0, making their range unacceptable.
+ */
+int parse_quality(std::string_view value) {
+  if (value.empty() || (value[0] != '0' && value[0] != '1')) return 0;
+  int q = (value[0] - '0') * MAX_QUALITY;
+  if (value.size() == 1) return q;
+  if (value[1] != '.' || value.size() > 5) return 0;
+
+  int scale = MAX_QUALITY;
+  for (const char c : value.substr(2)) {
+    if (!std::isdigit(static_cast<unsigned char>(c))) return 0;
+    scale /= 10;
+    q += (c - '0') * scale;
+  }
+  return q > MAX_QUALITY ? 0 : q;
+}
+
+/**
+ * Reads the "q" parameter of an `Accept` media range, defaulting to 1.
+ */
+int quality(std::string_view params) {
+  while (!params.empty()) {
+    const std::size_t end = params.find(';');
+    std::string_view param = trim(params.substr(0, end));
+    params = end == std::string_view::npos ? "" : params.substr(end + 1);
+    if (param.size() < 2 || (param[0] != 'q' && param[0] != 'Q') ||
+        param[1] != '=') {
+      continue;
+    }
+    return parse_quality(param.substr(2));
+  }
+  return MAX_QUALITY;
+}
+
+/**
+ * How closely `range` matches `mime_type`: 2 for exactly, 1 for all subtypes
+ * of its type, 0 for every type, and -1 not at all.
+ */
+int specificity(std::string_view range, std::string_view mime_type) {
+  if (range == "*/*") return 0;
+  if (range == mime_type) return 2;
+  if (range.ends_with("/*") &&
+      mime_type.starts_with(range.substr(0, range.size() - 1))) {
+    return 1;
+  }
+  return -1;
+}
+
+MimeMatch make_match(const MimeRegistry::value_type& entry) {
+  return {.mime_type = entry.first, .serializer = entry.second.get()};
+}
+
+}
+
+bool register_mime_serializer(
+  std::string_view mime_type,
+  std::unique_ptr<MimeSerializer> serializer
+) {
+  get_registry()[to_lower(mime_type)] = std::move(serializer);
+  return true;
+}
+
+MimeMatch find_mime_serializer(std::string_view content_type) {
+  MimeRegistry& registry = get_registry();
+  auto itr = registry.find(media_type(content_type));
+  return itr == registry.end() ? MimeMatch{} : make_match(*itr);
+}
+
+MimeMatch negotiate_mime_serializer(
+  std::string_view accept,
+  std::string_view preferred
+) {
+  const std::string preferred_type = to_lower(preferred);
+  MimeMatch best;
+  int best_quality = 0;
+  for (const auto& entry : get_registry()) {
+    int entry_specificity = -1;
+    int entry_quality = trim(accept).empty() ? MAX_QUALITY : 0;
+    std::string_view ranges = accept;
+    while (!ranges.empty()) {
+      const std::size_t end = ranges.find(',');
+      const std::string_view range = ranges.substr(0, end);
+      ranges = end == std::string_view::npos ? "" : ranges.substr(end + 1);
+
+      const std::size_t params = range.find(';');
+      const int s = specificity(media_type(range), entry.first);
+      if (s > entry_specificity) {
+        entry_specificity = s;
+        entry_quality = params == std::string_view::npos ?
+          MAX_QUALITY : quality(range.substr(params + 1));
+      }
+    }
+    if (entry_quality > best_quality ||
+        (entry_quality > 0 && entry_quality == best_quality &&
+         entry.first == preferred_type)) {
+      best = make_match(entry);
+      best_quality = entry_quality;
+    }
+  }
+  return best;
+}
+
+}
@@ -2,18 +2,98 @@
 
 #include <memory>
 #include <ostream>
+#include <string_view>
 
 #include "lw/io/serializer/formatter.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer_chain.h"
+
+#define _LW_CONCAT_INNER(x, y) x ## y
+#define _LW_CONCAT(x, y) _LW_CONCAT_INNER(x, y)
+
+/**
+ * Registers a `MimeSerializer` subclass as the serializer for a MIME type, so
+ * it can be found from `Content-Type` and `Accept` headers.
+ *
+ * ```cpp
+ *  LW_REGISTER_MIME_SERIALIZER(JSONSerializer, "application/json");
+ * ```
+ */
+#define LW_REGISTER_MIME_SERIALIZER(SerializerClass, mime_type)           \
+  namespace {                                                             \
+  static const bool _LW_CONCAT(mime_registration, __LINE__) =             \
+    ::lw::mime::register_mime_serializer(                                 \
+      mime_type,                                                          \
+      std::make_unique<SerializerClass>()                                 \
+    );                                                                    \
+  } // Ignore me.
 
 namespace lw::mime {
 
 class MimeSerializer {
 public:
+  virtual ~MimeSerializer() = default;
+
   virtual std::unique_ptr<io::SerializationFormatter> make_formatter(
     std::ostream& output
   ) = 0;
 
+  virtual std::unique_ptr<io::SerializationFormatter> make_formatter(
+    BufferChain& output
+  ) = 0;
+
+  /**
+   * Makes a parser for this format. Its tokens may view the string they were
+   * parsed from, so it must outlive them.
+   */
   virtual std::unique_ptr<io::DeserializationParser> make_parser() = 0;
 };
 
+/**
+ * A registered MIME type and its serializer. The serializer is null if there
+ * was no match.
+ */
+struct MimeMatch {
+  std::string_view mime_type;
+  MimeSerializer* serializer = nullptr;
+};
+
+/**
+ * Makes `serializer` the one used for `mime_type`, replacing any registered
+ * before it. MIME types are matched case insensitively.
+ *
+ * Registration is not thread safe, and is meant to happen during static
+ * initialization through `LW_REGISTER_MIME_SERIALIZER`.
+ *
+ * @return
+ *  Always true, so it can initialize a static.
+ */
+bool register_mime_serializer(
+  std::string_view mime_type,
+  std::unique_ptr<MimeSerializer> serializer
+);
+
+/**
+ * Finds the serializer for the media type of a `Content-Type` header, ignoring
+ * parameters such as "charset".
+ */
+MimeMatch find_mime_serializer(std::string_view content_type);
+
+/**
+ * Picks the registered serializer which an `Accept` header prefers most.
+ *
+ * Each registered type takes the quality of the most specific media range
+ * matching it. An exact type is more specific than a range covering all of its
+ * subtypes, which is more specific than the range of every type. The type with
+ * the highest quality above zero wins. Ties, and empty headers which accept
+ * anything, go to `preferred` when it is among them.
+ *
+ * @param preferred
+ *  The MIME type to use when the client has no preference.
+ */
+MimeMatch negotiate_mime_serializer(
+  std::string_view accept,
+  std::string_view preferred = "application/json"
+);
+
 }
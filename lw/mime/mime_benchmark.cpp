@@ -0,0 +1,186 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/cbor.h"
+#include "lw/mime/json.h"
+#include "lw/mime/msgpack.h"
+
+namespace lw::mime {
+namespace {
+
+struct Location {
+  double lat;
+  double lng;
+  std::string city;
+};
+
+struct UserRecord {
+  std::uint64_t id;
+  std::string name;
+  double score;
+  bool active;
+  std::string bio;
+  std::vector<std::string> tags;
+  Location location;
+};
+
+struct UserRecords {
+  std::vector<UserRecord> records;
+};
+
+}
+}
+
+template <>
+struct lw::io::Serialize<lw::mime::Location> {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::Location& value) {
+    serializer.write("lat", value.lat);
+    serializer.write("lng", value.lng);
+    serializer.write("city", value.city);
+  }
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::UserRecord> {
+  typedef ObjectTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::UserRecord& value) {
+    serializer.write("id", value.id);
+    serializer.write("name", value.name);
+    serializer.write("score", value.score);
+    serializer.write("active", value.active);
+    serializer.write("bio", value.bio);
+    serializer.write("tags", value.tags);
+    serializer.write("location", value.location);
+  }
+};
+
+template <>
+struct lw::io::Serialize<lw::mime::UserRecords> {
+  typedef ListTag serialization_category;
+
+  void serialize(Serializer& serializer, const lw::mime::UserRecords& value) {
+    for (const lw::mime::UserRecord& record : value.records) {
+      serializer.write(record);
+    }
+  }
+};
+
+namespace lw::mime {
+namespace {
+
+enum Format {
+  JSON,
+  CBOR,
+  MSGPACK
+};
+
+std::unique_ptr<MimeSerializer> make_serializer(Format format) {
+  switch (format) {
+    case JSON: return std::make_unique<JSONSerializer>();
+    case CBOR: return std::make_unique<CBORSerializer>();
+    case MSGPACK: return std::make_unique<MessagePackSerializer>();
+  }
+  return nullptr;
+}
+
+UserRecords make_user_records(std::size_t count) {
+  UserRecords records;
+  for (std::size_t i = 0; i < count; ++i) {
+    records.records.push_back({
+      .id = i * 7919,
+      .name = "user_" + std::to_string(i),
+      .score = (i % 100) + 0.25,
+      .active = i % 3 != 0,
+      .bio = "Likes \"quotes\" and\nnew lines, " + std::string(40, 'x'),
+      .tags = {"alpha", "beta", "gamma"},
+      .location = {.lat = 45.5, .lng = -122.6, .city = "Portland"}
+    });
+  }
+  return records;
+}
+
+std::string encode(Format format, const UserRecords& records) {
+  BufferChain chain;
+  io::Serializer serializer{make_serializer(format)->make_formatter(chain)};
+  serializer.write(records);
+  return std::string{static_cast<std::string_view>(chain.flatten())};
+}
+
+/**
+ * Writes `state.range(0)` user records into a `BufferChain`.
+ */
+void BM_MimeEncode(benchmark::State& state, Format format) {
+  const UserRecords records = make_user_records(state.range(0));
+  std::unique_ptr<MimeSerializer> mime = make_serializer(format);
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    BufferChain chain;
+    io::Serializer serializer{mime->make_formatter(chain)};
+    serializer.write(records);
+    bytes += chain.size();
+  }
+  state.SetBytesProcessed(bytes);
+  state.SetItemsProcessed(state.iterations() * records.records.size());
+  state.counters["size"] = static_cast<double>(bytes) / state.iterations();
+}
+BENCHMARK_CAPTURE(BM_MimeEncode, json, JSON)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_MimeEncode, cbor, CBOR)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_MimeEncode, msgpack, MSGPACK)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+
+/**
+ * Decodes `state.range(0)` encoded user records and reads back every field.
+ */
+void BM_MimeDecode(benchmark::State& state, Format format) {
+  const std::string encoded =
+    encode(format, make_user_records(state.range(0)));
+  std::unique_ptr<io::DeserializationParser> parser =
+    make_serializer(format)->make_parser();
+  for (auto _ : state) {
+    std::unique_ptr<io::DeserializationToken> token = parser->parse(encoded);
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < token->size(); ++i) {
+      const io::DeserializationToken& record = token->get_index(i);
+      sum += record.get_key("id").get_unsigned_integer();
+      sum += record.get_key("name").get_string().size();
+      sum += record.get_key("score").get_floating_point();
+      sum += record.get_key("active").get_boolean();
+      sum += record.get_key("bio").get_string().size();
+      sum += record.get_key("tags").get_index(2).get_string().size();
+      const io::DeserializationToken& location = record.get_key("location");
+      sum += location.get_key("lat").get_floating_point();
+      sum += location.get_key("city").get_string().size();
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetBytesProcessed(state.iterations() * encoded.size());
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_MimeDecode, json, JSON)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_MimeDecode, cbor, CBOR)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_MimeDecode, msgpack, MSGPACK)
+  ->ArgName("records")->Arg(100'000)
+  ->Unit(benchmark::kMillisecond);
+
+}
+}
@@ -0,0 +1,154 @@
+#include "lw/mime/mime.h"
+
+#include <memory>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/mime/cbor.h"
+#include "lw/mime/json.h"
+#include "lw/mime/msgpack.h"
+
+namespace lw::mime {
+namespace {
+
+TEST(FindMimeSerializer, RegisteredTypes) {
+  EXPECT_NE(
+    dynamic_cast<JSONSerializer*>(
+      find_mime_serializer("application/json").serializer
+    ),
+    nullptr
+  );
+  EXPECT_NE(
+    dynamic_cast<CBORSerializer*>(
+      find_mime_serializer("application/cbor").serializer
+    ),
+    nullptr
+  );
+  EXPECT_NE(
+    dynamic_cast<MessagePackSerializer*>(
+      find_mime_serializer("application/msgpack").serializer
+    ),
+    nullptr
+  );
+  EXPECT_NE(
+    dynamic_cast<MessagePackSerializer*>(
+      find_mime_serializer("application/x-msgpack").serializer
+    ),
+    nullptr
+  );
+}
+
+TEST(FindMimeSerializer, IgnoresParametersAndCase) {
+  MimeMatch match = find_mime_serializer("Application/JSON; charset=utf-8");
+  EXPECT_EQ(match.mime_type, "application/json");
+  EXPECT_NE(match.serializer, nullptr);
+}
+
+TEST(FindMimeSerializer, Unknown) {
+  MimeMatch match = find_mime_serializer("text/html");
+  EXPECT_EQ(match.serializer, nullptr);
+  EXPECT_TRUE(match.mime_type.empty());
+  EXPECT_EQ(find_mime_serializer("").serializer, nullptr);
+}
+
+TEST(RegisterMimeSerializer, Registers) {
+  register_mime_serializer(
+    "application/vnd.lw-test+json",
+    std::make_unique<JSONSerializer>()
+  );
+  MimeMatch match = find_mime_serializer("application/vnd.lw-test+json");
+  EXPECT_EQ(match.mime_type, "application/vnd.lw-test+json");
+  EXPECT_NE(match.serializer, nullptr);
+}
+
+TEST(NegotiateMimeSerializer, EmptyAcceptsPreferred) {
+  EXPECT_EQ(negotiate_mime_serializer("").mime_type, "application/json");
+  EXPECT_EQ(
+    negotiate_mime_serializer("", "application/cbor").mime_type,
+    "application/cbor"
+  );
+}
+
+TEST(NegotiateMimeSerializer, ExactType) {
+  EXPECT_EQ(
+    negotiate_mime_serializer("application/cbor").mime_type,
+    "application/cbor"
+  );
+  EXPECT_EQ(
+    negotiate_mime_serializer("text/html, application/msgpack").mime_type,
+    "application/msgpack"
+  );
+}
+
+TEST(NegotiateMimeSerializer, WildcardsPickPreferred) {
+  EXPECT_EQ(negotiate_mime_serializer("*/*").mime_type, "application/json");
+  EXPECT_EQ(
+    negotiate_mime_serializer("application/*").mime_type,
+    "application/json"
+  );
+  EXPECT_EQ(
+    negotiate_mime_serializer("application/*", "application/cbor").mime_type,
+    "application/cbor"
+  );
+}
+
+TEST(NegotiateMimeSerializer, Quality) {
+  EXPECT_EQ(
+    negotiate_mime_serializer(
+      "application/json;q=0.5, application/cbor;q=0.9"
+    ).mime_type,
+    "application/cbor"
+  );
+  EXPECT_EQ(
+    negotiate_mime_serializer("application/cbor; q=0.1, */*;q=0.5").mime_type,
+    "application/json"
+  );
+}
+
+TEST(NegotiateMimeSerializer, QualityPrecision) {
+  EXPECT_EQ(
+    negotiate_mime_serializer(
+      "application/json;q=0.333, application/cbor;q=0.334"
+    ).mime_type,
+    "application/cbor"
+  );
+  EXPECT_EQ(
+    negotiate_mime_serializer(
+      "application/json;q=1.000, application/cbor;q=0.999"
+    ).mime_type,
+    "application/json"
+  );
+}
+
+TEST(NegotiateMimeSerializer, MalformedQualityIsUnacceptable) {
+  for (std::string_view accept : {
+    "application/json;q=0.5x",
+    "application/json;q=1.5",
+    "application/json;q=0.1234",
+    "application/json;q=.5",
+    "application/json;q=5e-1",
+    "application/json;q="
+  }) {
+    EXPECT_EQ(negotiate_mime_serializer(accept).serializer, nullptr) << accept;
+  }
+}
+
+TEST(NegotiateMimeSerializer, MostSpecificRangeWins) {
+  EXPECT_EQ(
+    negotiate_mime_serializer(
+      "application/json;q=0, application/msgpack;q=0.2, application/*;q=0.1"
+    ).mime_type,
+    "application/msgpack"
+  );
+}
+
+TEST(NegotiateMimeSerializer, NothingAcceptable) {
+  EXPECT_EQ(negotiate_mime_serializer("text/html").serializer, nullptr);
+  EXPECT_EQ(
+    negotiate_mime_serializer("application/json;q=0").serializer,
+    nullptr
+  );
+}
+
+}
+}
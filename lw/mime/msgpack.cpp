@@ -0,0 +1,361 @@
+#include "lw/mime/msgpack.h"
+
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/mime/internal/big_endian.h"
+#include "lw/mime/internal/binary_document.h"
+
+namespace lw::mime {
+namespace {
+
+constexpr std::uint8_t NIL = 0xc0;
+constexpr std::uint8_t FALSE_VALUE = 0xc2;
+constexpr std::uint8_t TRUE_VALUE = 0xc3;
+constexpr std::uint8_t BIN_8 = 0xc4;
+constexpr std::uint8_t BIN_16 = 0xc5;
+constexpr std::uint8_t BIN_32 = 0xc6;
+constexpr std::uint8_t FLOAT_32 = 0xca;
+constexpr std::uint8_t FLOAT_64 = 0xcb;
+constexpr std::uint8_t UINT_8 = 0xcc;
+constexpr std::uint8_t UINT_16 = 0xcd;
+constexpr std::uint8_t UINT_32 = 0xce;
+constexpr std::uint8_t UINT_64 = 0xcf;
+constexpr std::uint8_t INT_8 = 0xd0;
+constexpr std::uint8_t INT_16 = 0xd1;
+constexpr std::uint8_t INT_32 = 0xd2;
+constexpr std::uint8_t INT_64 = 0xd3;
+constexpr std::uint8_t STR_8 = 0xd9;
+constexpr std::uint8_t STR_16 = 0xda;
+constexpr std::uint8_t STR_32 = 0xdb;
+constexpr std::uint8_t ARRAY_16 = 0xdc;
+constexpr std::uint8_t ARRAY_32 = 0xdd;
+constexpr std::uint8_t MAP_16 = 0xde;
+constexpr std::uint8_t MAP_32 = 0xdf;
+
+constexpr std::uint8_t FIXMAP = 0x80;
+constexpr std::uint8_t FIXARRAY = 0x90;
+constexpr std::uint8_t FIXSTR = 0xa0;
+
+/**
+ * Writes the head of a string, list or object of `size` elements, using the
+ * fix format if `size` is below `fix_limit` or else the smallest of the 8, 16
+ * or 32-bit formats starting at `format_8`, `format_16` or `format_32`. Lists
+ * and objects have no 8-bit format, which `format_8` of zero marks.
+ */
+char* write_sized_head(
+  std::uint64_t size,
+  std::uint8_t fix,
+  std::uint64_t fix_limit,
+  std::uint8_t format_8,
+  std::uint8_t format_16,
+  std::uint8_t format_32,
+  char* out
+) {
+  if (size < fix_limit) {
+    *out = static_cast<char>(fix | size);
+    return out + 1;
+  } else if (format_8 && size <= 0xff) {
+    *out = static_cast<char>(format_8);
+    return internal::write_big_endian<1>(size, out + 1);
+  } else if (size <= 0xffff) {
+    *out = static_cast<char>(format_16);
+    return internal::write_big_endian<2>(size, out + 1);
+  } else if (size <= 0xffffffff) {
+    *out = static_cast<char>(format_32);
+    return internal::write_big_endian<4>(size, out + 1);
+  }
+  throw ResourceExhausted()
+      << "MessagePack cannot hold " << size << " elements in one value.";
+}
+
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+//          #####  ###  ####  #     #  ###  ##### ##### ##### ####            //
+//          #     #   # #   # ##   ## #   #   #     #   #     #   #           //
+//          ####  #   # ####  # # # # #####   #     #   ####  ####            //
+//          #     #   # #   # #  #  # #   #   #     #   #     #   #           //
+//          #      ###  #   # #     # #   #   #     #   ##### #   #           //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+
+void MessagePackSerializationFormatter::put_null() {
+  const char format = static_cast<char>(NIL);
+  _put_scalar({&format, 1});
+}
+
+void MessagePackSerializationFormatter::put_boolean(bool boolean) {
+  const char format = static_cast<char>(boolean ? TRUE_VALUE : FALSE_VALUE);
+  _put_scalar({&format, 1});
+}
+
+void MessagePackSerializationFormatter::put_char(char c) {
+  const char buffer[2] = {static_cast<char>(FIXSTR | 1), c};
+  _put_scalar({buffer, sizeof(buffer)});
+}
+
+void MessagePackSerializationFormatter::put_signed_integer(
+  std::int64_t number
+) {
+  if (number >= 0) {
+    put_unsigned_integer(static_cast<std::uint64_t>(number));
+    return;
+  }
+
+  char buffer[9];
+  const std::uint64_t bits = static_cast<std::uint64_t>(number);
+  const char* end;
+  if (number >= -32) {
+    buffer[0] = static_cast<char>(number); // Negative fixint.
+    end = buffer + 1;
+  } else if (number >= std::numeric_limits<std::int8_t>::min()) {
+    buffer[0] = static_cast<char>(INT_8);
+    end = internal::write_big_endian<1>(bits, buffer + 1);
+  } else if (number >= std::numeric_limits<std::int16_t>::min()) {
+    buffer[0] = static_cast<char>(INT_16);
+    end = internal::write_big_endian<2>(bits, buffer + 1);
+  } else if (number >= std::numeric_limits<std::int32_t>::min()) {
+    buffer[0] = static_cast<char>(INT_32);
+    end = internal::write_big_endian<4>(bits, buffer + 1);
+  } else {
+    buffer[0] = static_cast<char>(INT_64);
+    end = internal::write_big_endian<8>(bits, buffer + 1);
+  }
+  _put_scalar({buffer, static_cast<std::size_t>(end - buffer)});
+}
+
+void MessagePackSerializationFormatter::put_unsigned_integer(
+  std::uint64_t number
+) {
+  char buffer[9];
+  const char* end;
+  if (number < 0x80) {
+    buffer[0] = static_cast<char>(number); // Positive fixint.
+    end = buffer + 1;
+  } else if (number <= 0xff) {
+    buffer[0] = static_cast<char>(UINT_8);
+    end = internal::write_big_endian<1>(number, buffer + 1);
+  } else if (number <= 0xffff) {
+    buffer[0] = static_cast<char>(UINT_16);
+    end = internal::write_big_endian<2>(number, buffer + 1);
+  } else if (number <= 0xffffffff) {
+    buffer[0] = static_cast<char>(UINT_32);
+    end = internal::write_big_endian<4>(number, buffer + 1);
+  } else {
+    buffer[0] = static_cast<char>(UINT_64);
+    end = internal::write_big_endian<8>(number, buffer + 1);
+  }
+  _put_scalar({buffer, static_cast<std::size_t>(end - buffer)});
+}
+
+void MessagePackSerializationFormatter::put_floating_point(double number) {
+  const float narrow = static_cast<float>(number);
+  if (static_cast<double>(narrow) == number || std::isnan(number)) {
+    put_floating_point(narrow);
+    return;
+  }
+  char buffer[9] = {static_cast<char>(FLOAT_64)};
+  internal::write_big_endian<8>(
+    std::bit_cast<std::uint64_t>(number),
+    buffer + 1
+  );
+  _put_scalar({buffer, sizeof(buffer)});
+}
+
+void MessagePackSerializationFormatter::put_floating_point(float number) {
+  char buffer[5] = {static_cast<char>(FLOAT_32)};
+  internal::write_big_endian<4>(
+    std::bit_cast<std::uint32_t>(number),
+    buffer + 1
+  );
+  _put_scalar({buffer, sizeof(buffer)});
+}
+
+void MessagePackSerializationFormatter::put_string(std::string_view str) {
+  check_can_add_value();
+  char buffer[CONTAINER_HEAD_SIZE];
+  const char* end = write_sized_head(
+    str.size(), FIXSTR, 32, STR_8, STR_16, STR_32, buffer
+  );
+  append({buffer, static_cast<std::size_t>(end - buffer)});
+  append(str);
+  value_added();
+}
+
+char* MessagePackSerializationFormatter::write_container_head(
+  Container container,
+  std::uint64_t size,
+  char* out
+) const {
+  if (container == Container::LIST) {
+    return write_sized_head(size, FIXARRAY, 16, 0, ARRAY_16, ARRAY_32, out);
+  }
+  return write_sized_head(size, FIXMAP, 16, 0, MAP_16, MAP_32, out);
+}
+
+void MessagePackSerializationFormatter::_put_scalar(std::string_view bytes) {
+  check_can_add_value();
+  append(bytes);
+  value_added();
+}
+
+// -------------------------------------------------------------------------- //
+//                                                                            //
+//                     ####   ###  ####   #### ##### ####                     //
+//                     #   # #   # #   # #     #     #   #                    //
+//                     ####  ##### ####   ###  ####  ####                     //
+//                     #     #   # #   #     # #     #   #                    //
+//                     #     #   # #   # ####  ##### #   #                    //
+//                                                                            //
+// -------------------------------------------------------------------------- //
+
+namespace {
+
+using Kind = internal::BinaryDocument::Kind;
+
+class MessagePackDecoder {
+public:
+  MessagePackDecoder(
+    std::string_view msgpack,
+    internal::BinaryDocument& document
+  ):
+    _msgpack{msgpack},
+    _document{document}
+  {}
+
+  void decode() {
+    _object(1);
+    if (_pos != _msgpack.size()) {
+      throw InvalidArgument()
+          << "Unexpected data after MessagePack object at byte " << _pos;
+    }
+  }
+
+private:
+  void _object(std::size_t depth) {
+    if (depth > internal::BinaryDocument::MAX_DEPTH) {
+      throw InvalidArgument()
+          << "MessagePack nested deeper than "
+          << internal::BinaryDocument::MAX_DEPTH;
+    }
+    const std::uint8_t format = _byte();
+    if (format < 0x80) return _document.add_unsigned(format);
+    if (format < 0x90) return _map(format & 0x0f, depth);
+    if (format < 0xa0) return _array(format & 0x0f, depth);
+    if (format < 0xc0) return _document.add_string(_take(format & 0x1f));
+    if (format >= 0xe0) {
+      return _document.add_signed(static_cast<std::int8_t>(format));
+    }
+
+    switch (format) {
+      case NIL: return _document.add_null();
+      case FALSE_VALUE: return _document.add_boolean(false);
+      case TRUE_VALUE: return _document.add_boolean(true);
+      case BIN_8:
+      case STR_8: return _document.add_string(_take(_read<1>()));
+      case BIN_16:
+      case STR_16: return _document.add_string(_take(_read<2>()));
+      case BIN_32:
+      case STR_32: return _document.add_string(_take(_read<4>()));
+      case FLOAT_32: {
+        return _document.add_float(
+          std::bit_cast<float>(static_cast<std::uint32_t>(_read<4>()))
+        );
+      }
+      case FLOAT_64: {
+        return _document.add_float(std::bit_cast<double>(_read<8>()));
+      }
+      case UINT_8: return _document.add_unsigned(_read<1>());
+      case UINT_16: return _document.add_unsigned(_read<2>());
+      case UINT_32: return _document.add_unsigned(_read<4>());
+      case UINT_64: return _document.add_unsigned(_read<8>());
+      case INT_8: {
+        return _document.add_signed(static_cast<std::int8_t>(_read<1>()));
+      }
+      case INT_16: {
+        return _document.add_signed(static_cast<std::int16_t>(_read<2>()));
+      }
+      case INT_32: {
+        return _document.add_signed(static_cast<std::int32_t>(_read<4>()));
+      }
+      case INT_64: {
+        return _document.add_signed(static_cast<std::int64_t>(_read<8>()));
+      }
+      case ARRAY_16: return _array(_read<2>(), depth);
+      case ARRAY_32: return _array(_read<4>(), depth);
+      case MAP_16: return _map(_read<2>(), depth);
+      case MAP_32: return _map(_read<4>(), depth);
+    }
+    throw InvalidArgument()
+        << "Unsupported MessagePack format " << static_cast<int>(format)
+        << " at byte " << (_pos - 1);
+  }
+
+  void _array(std::uint64_t count, std::size_t depth) {
+    // Every element takes at least a byte.
+    if (count > _msgpack.size() - _pos) _unexpected_end();
+    const std::uint32_t index = _document.start_container(Kind::LIST);
+    for (std::uint64_t i = 0; i < count; ++i) _object(depth + 1);
+    _document.end_container(index, static_cast<std::uint32_t>(count));
+  }
+
+  void _map(std::uint64_t count, std::size_t depth) {
+    if (count > (_msgpack.size() - _pos) / 2) _unexpected_end();
+    const std::uint32_t index = _document.start_container(Kind::OBJECT);
+    for (std::uint64_t i = 0; i < count; ++i) {
+      _object(depth + 1);
+      _object(depth + 1);
+    }
+    _document.end_container(index, static_cast<std::uint32_t>(count));
+  }
+
+  template <std::size_t Bytes>
+  std::uint64_t _read() {
+    return internal::read_big_endian<Bytes>(_take(Bytes).data());
+  }
+
+  std::uint8_t _byte() {
+    if (_pos >= _msgpack.size()) _unexpected_end();
+    return static_cast<std::uint8_t>(_msgpack[_pos++]);
+  }
+
+  std::string_view _take(std::uint64_t count) {
+    if (count > _msgpack.size() - _pos) _unexpected_end();
+    std::string_view bytes = _msgpack.substr(_pos, count);
+    _pos += count;
+    return bytes;
+  }
+
+  [[noreturn]] void _unexpected_end() const {
+    throw InvalidArgument() << "Unexpected end of input to MessagePack parser.";
+  }
+
+  std::string_view _msgpack;
+  internal::BinaryDocument& _document;
+  std::size_t _pos = 0;
+};
+
+}
+
+std::unique_ptr<io::DeserializationToken>
+MessagePackDeserializationParser::parse(std::string_view str) const {
+  auto document = std::make_unique<internal::BinaryDocument>();
+  MessagePackDecoder{str, *document}.decode();
+  return document;
+}
+
+// -------------------------------------------------------------------------- //
+
+LW_REGISTER_MIME_SERIALIZER(MessagePackSerializer, "application/msgpack");
+LW_REGISTER_MIME_SERIALIZER(MessagePackSerializer, "application/x-msgpack");
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+#include "lw/io/serializer/formatter.h"
+#include "lw/io/serializer/parser.h"
+#include "lw/memory/buffer_chain.h"
+#include "lw/mime/internal/binary_formatter.h"
+#include "lw/mime/mime.h"
+
+namespace lw::mime {
+
+/**
+ * Writes MessagePack into a chain of buffers, or through one into a
+ * `std::ostream`.
+ *
+ * Integers, strings, lists and objects use their smallest format, and floating
+ * point numbers are written as float 32 when that loses nothing. Characters
+ * are written as one byte strings. Strings, lists and objects are limited to
+ * 2^32 - 1 elements, beyond which formatting throws `ResourceExhausted`.
+ */
+class MessagePackSerializationFormatter: public internal::BinaryFormatter {
+public:
+  using internal::BinaryFormatter::BinaryFormatter;
+
+  void put_null() override;
+  void put_boolean(bool boolean) override;
+  void put_char(char c) override;
+  void put_signed_integer(std::int64_t number) override;
+  void put_unsigned_integer(std::uint64_t number) override;
+  void put_floating_point(double number) override;
+  void put_floating_point(float number) override;
+  void put_string(std::string_view str) override;
+
+protected:
+  char* write_container_head(
+    Container container,
+    std::uint64_t size,
+    char* out
+  ) const override;
+
+private:
+  void _put_scalar(std::string_view bytes);
+};
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * Decodes a single MessagePack object.
+ *
+ * Str and bin both read as strings viewing the source directly, so it must
+ * outlive the returned token. Map keys which are not strings are kept but never
+ * match a key lookup. Extension types are not supported.
+ */
+class MessagePackDeserializationParser: public io::DeserializationParser {
+public:
+  /**
+   * @throw InvalidArgument
+   *  If `str` is not exactly one well formed MessagePack object, holds an
+   *  extension type, or nests more than `internal::BinaryDocument::MAX_DEPTH`
+   *  deep.
+   */
+  std::unique_ptr<io::DeserializationToken> parse(
+    std::string_view str
+  ) const override;
+};
+
+// -------------------------------------------------------------------------- //
+
+class MessagePackSerializer: public MimeSerializer {
+public:
+  std::unique_ptr<io::SerializationFormatter> make_formatter(
+    std::ostream& output
+  ) override {
+    return std::make_unique<MessagePackSerializationFormatter>(output);
+  }
+
+  std::unique_ptr<io::SerializationFormatter> make_formatter(
+    BufferChain& output
+  ) override {
+    return std::make_unique<MessagePackSerializationFormatter>(output);
+  }
+
+  std::unique_ptr<io::DeserializationParser> make_parser() override {
+    return std::make_unique<MessagePackDeserializationParser>();
+  }
+};
+
+}
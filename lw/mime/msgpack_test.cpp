@@ -0,0 +1,269 @@
+#include "lw/mime/msgpack.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/io/serializer/serializer.h"
+#include "lw/io/serializer/serialized_value.h"
+#include "lw/io/serializer/testing/tagged_types.h"
+#include "lw/memory/buffer_chain.h"
+
+namespace lw::mime {
+namespace {
+
+using ::lw::io::testing::FieldTagged;
+using ::lw::io::testing::ListTagged;
+using ::lw::io::testing::ObjectTagged;
+
+template <typename T>
+std::string serialize(const T& value) {
+  std::stringstream stream;
+  MessagePackSerializer msgpack;
+  io::Serializer serializer{msgpack.make_formatter(stream)};
+  serializer.write(value);
+  return stream.str();
+}
+
+std::unique_ptr<io::DeserializationToken> parse(std::string_view str) {
+  return MessagePackDeserializationParser{}.parse(str);
+}
+
+TEST(MessagePackSerializer, Null) {
+  EXPECT_EQ(serialize(nullptr), "\xc0");
+}
+
+TEST(MessagePackSerializer, Boolean) {
+  EXPECT_EQ(serialize(false), "\xc2");
+  EXPECT_EQ(serialize(true), "\xc3");
+}
+
+TEST(MessagePackSerializer, Integer) {
+  EXPECT_EQ(serialize(0), std::string(1, '\x00'));
+  EXPECT_EQ(serialize(127), "\x7f");
+  EXPECT_EQ(serialize(128), "\xcc\x80");
+  EXPECT_EQ(serialize(1000), "\xcd\x03\xe8");
+  EXPECT_EQ(serialize(1000000), std::string("\xce\x00\x0f\x42\x40", 5));
+  EXPECT_EQ(
+    serialize(std::numeric_limits<std::uint64_t>::max()),
+    "\xcf\xff\xff\xff\xff\xff\xff\xff\xff"
+  );
+  EXPECT_EQ(serialize(-1), "\xff");
+  EXPECT_EQ(serialize(-32), "\xe0");
+  EXPECT_EQ(serialize(-33), "\xd0\xdf");
+  EXPECT_EQ(serialize(-1000), "\xd1\xfc\x18");
+  EXPECT_EQ(serialize(-100000), std::string("\xd2\xff\xfe\x79\x60", 5));
+  EXPECT_EQ(
+    serialize(std::numeric_limits<std::int64_t>::min()),
+    std::string("\xd3\x80\x00\x00\x00\x00\x00\x00\x00", 9)
+  );
+}
+
+TEST(MessagePackSerializer, Float) {
+  EXPECT_EQ(serialize(1.5), std::string("\xca\x3f\xc0\x00\x00", 5));
+  EXPECT_EQ(serialize(1.1), "\xcb\x3f\xf1\x99\x99\x99\x99\x99\x9a");
+}
+
+TEST(MessagePackSerializer, String) {
+  EXPECT_EQ(serialize(std::string{}), "\xa0");
+  EXPECT_EQ(serialize(std::string{"foo"}), "\xa3" "foo");
+  EXPECT_EQ(serialize('a'), "\xa1" "a");
+  EXPECT_EQ(
+    serialize(std::string(32, 'x')),
+    "\xd9\x20" + std::string(32, 'x')
+  );
+  EXPECT_EQ(
+    serialize(std::string(300, 'x')),
+    "\xda\x01\x2c" + std::string(300, 'x')
+  );
+}
+
+TEST(MessagePackSerializer, List) {
+  EXPECT_EQ(serialize(std::vector<int>{}), "\x90");
+  EXPECT_EQ(serialize(std::vector<int>{{1, 2, 3}}), "\x93\x01\x02\x03");
+  EXPECT_EQ(
+    serialize(ListTagged{.a = 1, .b = 2, .c = 3}),
+    "\x93\x01\x02\x03"
+  );
+
+  std::vector<int> long_list(16, 1);
+  EXPECT_EQ(
+    serialize(long_list),
+    std::string("\xdc\x00\x10", 3) + std::string(16, '\x01')
+  );
+}
+
+TEST(MessagePackSerializer, NestedList) {
+  EXPECT_EQ(
+    serialize(std::vector<std::vector<int>>{{1}, {}, {2, 3}}),
+    "\x93\x91\x01\x90\x92\x02\x03"
+  );
+}
+
+TEST(MessagePackSerializer, Object) {
+  EXPECT_EQ(
+    serialize(std::map<std::string, int>{{"a", 1}, {"b", 2}}),
+    "\x82\xa1" "a" "\x01\xa1" "b" "\x02"
+  );
+  EXPECT_EQ(
+    serialize(FieldTagged{.a = 1, .b = "x", .c = {.a = 2, .b = 3, .c = 4}}),
+    "\x83\xa1" "a" "\x01\xa1" "b" "\xa1" "x" "\xa1" "c"
+      "\x83\xa1" "a" "\x02\xa1" "b" "\x03\xa1" "c" "\x04"
+  );
+}
+
+TEST(MessagePackSerializer, BufferChain) {
+  BufferChain chain{/*block_size=*/8};
+  MessagePackSerializer msgpack;
+  io::Serializer serializer{msgpack.make_formatter(chain)};
+  serializer.write(std::vector<std::string>{"abcdefgh", "ijklmnop"});
+  EXPECT_GT(chain.block_count(), 1);
+  EXPECT_EQ(
+    static_cast<std::string_view>(chain.flatten()),
+    "\x92\xa8" "abcdefgh" "\xa8" "ijklmnop"
+  );
+}
+
+TEST(MessagePackSerializer, ValueAfterDone) {
+  BufferChain chain;
+  MessagePackSerializationFormatter formatter{chain};
+  formatter.put_null();
+  EXPECT_THROW(formatter.put_null(), InvalidArgument);
+  EXPECT_THROW(formatter.end_object(), FailedPrecondition);
+}
+
+// -------------------------------------------------------------------------- //
+
+TEST(MessagePackParser, Scalars) {
+  EXPECT_TRUE(parse("\xc0")->is_null());
+  EXPECT_FALSE(parse("\xc2")->get_boolean());
+  EXPECT_TRUE(parse("\xc3")->get_boolean());
+  EXPECT_EQ(parse("\x7f")->get_unsigned_integer(), 127);
+  EXPECT_EQ(parse("\xcc\x80")->get_unsigned_integer(), 128);
+  EXPECT_EQ(parse("\xcd\x03\xe8")->get_unsigned_integer(), 1000);
+  EXPECT_EQ(
+    parse(std::string("\xce\x00\x0f\x42\x40", 5))->get_unsigned_integer(),
+    1000000
+  );
+  EXPECT_EQ(
+    parse("\xcf\xff\xff\xff\xff\xff\xff\xff\xff")->get_unsigned_integer(),
+    std::numeric_limits<std::uint64_t>::max()
+  );
+  EXPECT_EQ(parse("\xff")->get_signed_integer(), -1);
+  EXPECT_EQ(parse("\xe0")->get_signed_integer(), -32);
+  EXPECT_EQ(parse("\xd0\xdf")->get_signed_integer(), -33);
+  EXPECT_EQ(parse("\xd1\xfc\x18")->get_signed_integer(), -1000);
+  EXPECT_EQ(
+    parse(std::string("\xd3\x80\x00\x00\x00\x00\x00\x00\x00", 9))
+      ->get_signed_integer(),
+    std::numeric_limits<std::int64_t>::min()
+  );
+  EXPECT_EQ(parse("\xd0\x05")->get_unsigned_integer(), 5);
+  EXPECT_EQ(
+    parse(std::string("\xca\x3f\xc0\x00\x00", 5))->get_floating_point(),
+    1.5
+  );
+  EXPECT_EQ(
+    parse("\xcb\x3f\xf1\x99\x99\x99\x99\x99\x9a")->get_floating_point(),
+    1.1
+  );
+}
+
+TEST(MessagePackParser, IntegerTypes) {
+  auto token = parse("\xcd\x03\xe8");
+  EXPECT_TRUE(token->is_signed_integer());
+  EXPECT_TRUE(token->is_unsigned_integer());
+  EXPECT_TRUE(token->is_floating_point());
+  EXPECT_EQ(token->get_floating_point(), 1000.0);
+
+  token = parse("\xd1\xfc\x18");
+  EXPECT_TRUE(token->is_signed_integer());
+  EXPECT_FALSE(token->is_unsigned_integer());
+  EXPECT_THROW(token->get_unsigned_integer(), FailedPrecondition);
+  EXPECT_THROW(token->get_string(), FailedPrecondition);
+}
+
+TEST(MessagePackParser, String) {
+  const std::string msgpack = "\xa3" "foo";
+  auto token = parse(msgpack);
+  EXPECT_TRUE(token->is_string());
+  EXPECT_EQ(token->size(), 3);
+  EXPECT_EQ(token->get_string(), "foo");
+  EXPECT_EQ(token->get_string().data(), msgpack.data() + 1);
+
+  EXPECT_EQ(parse("\xd9\x03" "bar")->get_string(), "bar");
+  EXPECT_EQ(
+    parse(std::string("\xda\x00\x03", 3) + "baz")->get_string(),
+    "baz"
+  );
+  EXPECT_EQ(parse("\xc4\x02\x01\x02")->get_string(), "\x01\x02");
+  EXPECT_EQ(parse("\xa1" "a")->get_char(), 'a');
+}
+
+TEST(MessagePackParser, List) {
+  auto token = parse("\x93\x01\x92\x02\x03\xa1" "a");
+  EXPECT_TRUE(token->is_list());
+  EXPECT_EQ(token->size(), 3);
+  EXPECT_FALSE(token->has_index(3));
+  EXPECT_EQ(token->get_index(0).get_unsigned_integer(), 1);
+  EXPECT_EQ(token->get_index(1).get_index(1).get_unsigned_integer(), 3);
+  EXPECT_EQ(token->get_index(2).get_string(), "a");
+  EXPECT_THROW(token->get_index(3), OutOfRange);
+
+  token = parse(std::string("\xdc\x00\x02", 3) + "\xc0\xc3");
+  EXPECT_EQ(token->size(), 2);
+  EXPECT_TRUE(token->get_index(1).get_boolean());
+}
+
+TEST(MessagePackParser, Object) {
+  auto token = parse("\x82\xa1" "a" "\x01\xa1" "b" "\x91\x02");
+  EXPECT_TRUE(token->is_object());
+  EXPECT_EQ(token->size(), 2);
+  EXPECT_TRUE(token->has_key("a"));
+  EXPECT_FALSE(token->has_key("c"));
+  EXPECT_EQ(token->get_key("a").get_unsigned_integer(), 1);
+  EXPECT_EQ(token->get_key("b").get_index(0).get_unsigned_integer(), 2);
+  EXPECT_THROW(token->get_key("c"), OutOfRange);
+}
+
+TEST(MessagePackParser, Malformed) {
+  EXPECT_THROW(parse(""), InvalidArgument);
+  EXPECT_THROW(parse("\xcd\x03"), InvalidArgument);
+  EXPECT_THROW(parse("\xa3" "fo"), InvalidArgument);
+  EXPECT_THROW(parse("\x93\x01\x02"), InvalidArgument);
+  EXPECT_THROW(parse("\x81\xa1" "a"), InvalidArgument);
+  EXPECT_THROW(parse("\xc0\xc0"), InvalidArgument);
+  EXPECT_THROW(parse("\xc1"), InvalidArgument);
+  EXPECT_THROW(parse("\xd4\x01\x02"), InvalidArgument);
+  EXPECT_THROW(parse("\xdd\xff\xff\xff\xff"), InvalidArgument);
+  EXPECT_THROW(
+    parse(
+      std::string(MessagePackSerializationFormatter::MAX_DEPTH, '\x91') +
+      "\x01"
+    ),
+    InvalidArgument
+  );
+}
+
+TEST(MessagePackParser, RoundTrip) {
+  const std::string msgpack =
+    serialize(FieldTagged{.a = -7, .b = "bee", .c = {.a = 1, .b = 2, .c = 3}});
+  auto token = parse(msgpack);
+  io::SerializedValue value{*token};
+  EXPECT_EQ(value.get<int>("a"), -7);
+  EXPECT_EQ(value.get<std::string_view>("b"), "bee");
+  EXPECT_EQ(
+    value.get<ObjectTagged>("c"),
+    (ObjectTagged{.a = 1, .b = 2, .c = 3})
+  );
+}
+
+}
+}
@@ -0,0 +1,96 @@
+#include "lw/net/internal/kernel_tls.h"
+
+#include <cstdint>
+#include <cstring>
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "lw/net/internal/tls_client.h"
+#include "openssl/crypto.h"
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+namespace lw::net::internal {
+namespace {
+
+template <typename CryptoInfo>
+bool install_aes_gcm(
+  int socket_fd,
+  TLSDirection direction,
+  const TLSTrafficKeys& keys,
+  std::uint16_t cipher_type
+) {
+  CryptoInfo info{};
+  info.info.version = TLS_1_3_VERSION;
+  info.info.cipher_type = cipher_type;
+  static_assert(sizeof(info.salt) + sizeof(info.iv) == sizeof(keys.iv));
+  if (keys.key_size != sizeof(info.key)) return false;
+
+  // The kernel splits the TLS 1.3 nonce into a fixed salt and the part that is
+  // combined with the record sequence number.
+  std::memcpy(info.key, keys.key, sizeof(info.key));
+  std::memcpy(info.salt, keys.iv, sizeof(info.salt));
+  std::memcpy(info.iv, keys.iv + sizeof(info.salt), sizeof(info.iv));
+  for (std::size_t i = 0; i < sizeof(info.rec_seq); ++i) {
+    info.rec_seq[i] = static_cast<std::uint8_t>(
+      keys.sequence >> (8 * (sizeof(info.rec_seq) - 1 - i))
+    );
+  }
+
+  const int result = ::setsockopt(
+    socket_fd,
+    SOL_TLS,
+    direction == TLSDirection::SEND ? TLS_TX : TLS_RX,
+    &info,
+    sizeof(info)
+  );
+  OPENSSL_cleanse(&info, sizeof(info));
+  return result == 0;
+}
+
+}
+
+bool enable_kernel_tls(int socket_fd) {
+  constexpr char ULP_NAME[] = "tls";
+  return ::setsockopt(
+    socket_fd,
+    SOL_TCP,
+    TCP_ULP,
+    ULP_NAME,
+    sizeof(ULP_NAME)
+  ) == 0;
+}
+
+bool install_kernel_tls_keys(
+  int socket_fd,
+  TLSDirection direction,
+  const TLSTrafficKeys& keys
+) {
+  switch (keys.cipher_suite) {
+    case TLSTrafficKeys::AES_128_GCM_SHA256:
+      return install_aes_gcm<tls12_crypto_info_aes_gcm_128>(
+        socket_fd,
+        direction,
+        keys,
+        TLS_CIPHER_AES_GCM_128
+      );
+    case TLSTrafficKeys::AES_256_GCM_SHA384:
+      return install_aes_gcm<tls12_crypto_info_aes_gcm_256>(
+        socket_fd,
+        direction,
+        keys,
+        TLS_CIPHER_AES_GCM_256
+      );
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "lw/net/internal/tls_client.h"
+
+namespace lw::net::internal {
+
+/**
+ * Attaches the kernel's TLS layer to a connected TCP socket. Data passes
+ * through unchanged until keys are installed for a direction.
+ *
+ * @return
+ *  False if the kernel does not support TLS, in which case the socket is left
+ *  untouched.
+ */
+bool enable_kernel_tls(int socket_fd);
+
+/**
+ * Hands the record keys for one direction of the connection to the kernel.
+ * From then on data sent or received in that direction is plaintext, with the
+ * kernel encrypting or decrypting records.
+ *
+ * @return
+ *  False if the kernel does not support the cipher, in which case records in
+ *  that direction must still be processed in user space.
+ */
+bool install_kernel_tls_keys(
+  int socket_fd,
+  TLSDirection direction,
+  const TLSTrafficKeys& keys
+);
+
+}
@@ -0,0 +1,225 @@
+#include "lw/net/internal/tls_certificates.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <variant>
+
+#include "lw/log/log.h"
+#include "lw/net/internal/errors.h"
+#include "lw/net/tls_options.h"
+#include "openssl/bio.h"
+#include "openssl/err.h"
+#include "openssl/evp.h"
+#include "openssl/pem.h"
+#include "openssl/ssl.h"
+#include "openssl/x509.h"
+
+namespace lw::net::internal {
+namespace {
+
+typedef std::unique_ptr<BIO, decltype(&BIO_free)> BIOPtr;
+typedef std::unique_ptr<X509, decltype(&X509_free)> X509Ptr;
+typedef std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> KeyPtr;
+
+BIOPtr pem_bio(const TLSPem& pem) {
+  BIOPtr bio{
+    BIO_new_mem_buf(pem.data().data(), static_cast<int>(pem.data().size())),
+    &BIO_free
+  };
+  if (!bio) check_all_errors("Unknown error reading PEM data.");
+  return bio;
+}
+
+void use_certificate_pem(SSL_CTX* context, const TLSPem& pem) {
+  BIOPtr bio = pem_bio(pem);
+  X509Ptr leaf{
+    PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr),
+    &X509_free
+  };
+  if (!leaf || SSL_CTX_use_certificate(context, leaf.get()) != 1) {
+    check_all_errors("Unknown error setting certificate.");
+  }
+
+  // Anything after the leaf is its chain, and running out of PEM blocks is the
+  // expected way for reading it to end.
+  while (
+    X509Ptr link{
+      PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr),
+      &X509_free
+    }
+  ) {
+    if (SSL_CTX_add1_chain_cert(context, link.get()) != 1) {
+      check_all_errors("Unknown error adding certificate chain.");
+    }
+  }
+  ERR_clear_error();
+}
+
+void use_private_key_pem(SSL_CTX* context, const TLSPem& pem) {
+  BIOPtr bio = pem_bio(pem);
+  KeyPtr key{
+    PEM_read_bio_PrivateKey(bio.get(), nullptr, nullptr, nullptr),
+    &EVP_PKEY_free
+  };
+  if (!key || SSL_CTX_use_PrivateKey(context, key.get()) != 1) {
+    check_all_errors("Unknown error setting private key.");
+  }
+}
+
+std::filesystem::file_time_type last_modified(const TLSKeyMaterial& material) {
+  const auto* path = std::get_if<std::filesystem::path>(&material);
+  if (!path) return std::filesystem::file_time_type::min();
+
+  // Missing files are reported by the reload that follows.
+  std::error_code err;
+  auto modified = std::filesystem::last_write_time(*path, err);
+  return err ? std::filesystem::file_time_type::min() : modified;
+}
+
+std::filesystem::file_time_type last_modified(
+  const TLSCertificate& certificate
+) {
+  return std::max(
+    last_modified(certificate.certificate),
+    last_modified(certificate.private_key)
+  );
+}
+
+std::string to_lower(std::string_view str) {
+  std::string lower{str};
+  for (char& c : lower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return lower;
+}
+
+}
+
+void use_certificate(SSL_CTX* context, const TLSCertificate& certificate) {
+  if (const auto* pem = std::get_if<TLSPem>(&certificate.certificate)) {
+    use_certificate_pem(context, *pem);
+  } else {
+    const auto& path = std::get<std::filesystem::path>(certificate.certificate);
+    if (
+      SSL_CTX_use_certificate_file(
+        context,
+        path.c_str(),
+        SSL_FILETYPE_PEM
+      ) != 1
+    ) {
+      check_all_errors("Unknown error setting certificate file.");
+    }
+  }
+
+  if (const auto* pem = std::get_if<TLSPem>(&certificate.private_key)) {
+    use_private_key_pem(context, *pem);
+  } else {
+    const auto& path = std::get<std::filesystem::path>(certificate.private_key);
+    if (
+      SSL_CTX_use_PrivateKey_file(
+        context,
+        path.c_str(),
+        SSL_FILETYPE_PEM
+      ) != 1
+    ) {
+      check_all_errors("Unknown error setting private key file.");
+    }
+  }
+
+  if (SSL_CTX_check_private_key(context) != 1) {
+    check_all_errors("Unknown error with private key.");
+  }
+}
+
+TLSCertificateStore::TLSCertificateStore(
+  std::map<std::string, TLSCertificate> certificates,
+  std::chrono::steady_clock::duration reload_interval,
+  Loader loader
+):
+  _reload_interval{reload_interval},
+  _loader{std::move(loader)}
+{
+  for (auto& [hostname, certificate] : certificates) {
+    _entries.insert({
+      to_lower(hostname),
+      Entry{.certificate = std::move(certificate)}
+    });
+  }
+}
+
+TLSCertificateStore::Context TLSCertificateStore::find(
+  std::string_view hostname
+) {
+  Entry* entry = _match(to_lower(hostname));
+  return entry ? _get(*entry) : nullptr;
+}
+
+std::size_t TLSCertificateStore::loaded() const {
+  std::lock_guard<std::mutex> lock{_mutex};
+  return _loaded;
+}
+
+TLSCertificateStore::Entry* TLSCertificateStore::_match(
+  const std::string& hostname
+) {
+  // The set of entries never changes, so they can be searched without locking.
+  auto itr = _entries.find(hostname);
+  if (itr != _entries.end()) return &itr->second;
+
+  const std::size_t dot = hostname.find('.');
+  if (dot != std::string::npos && dot != 0) {
+    itr = _entries.find("*" + hostname.substr(dot));
+    if (itr != _entries.end()) return &itr->second;
+  }
+  itr = _entries.find("");
+  return itr == _entries.end() ? nullptr : &itr->second;
+}
+
+TLSCertificateStore::Context TLSCertificateStore::_get(Entry& entry) {
+  const auto now = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock{_mutex};
+  if (entry.context) {
+    if (_reload_interval.count() == 0 || now < entry.next_check) {
+      return entry.context;
+    }
+    // Other handshakes keep using the current context while this one checks.
+    entry.next_check = now + _reload_interval;
+  }
+  Context current = entry.context;
+  const std::filesystem::file_time_type loaded_modified = entry.modified;
+  lock.unlock();
+
+  // Loading happens outside the lock so other hostnames are not held up by
+  // parsing this certificate. Concurrent first loads of the same entry simply
+  // race and the last one is kept.
+  const std::filesystem::file_time_type modified =
+    last_modified(entry.certificate);
+  if (current && modified == loaded_modified) return current;
+
+  Context context;
+  try {
+    context = _loader(entry.certificate);
+  } catch (const std::exception& err) {
+    if (!current) throw;
+    log(WARN) << "Failed to reload TLS certificate, keeping the previous one: "
+              << err.what();
+    return current;
+  }
+
+  lock.lock();
+  if (!entry.context) ++_loaded;
+  entry.context = context;
+  entry.modified = modified;
+  entry.next_check = now + _reload_interval;
+  return context;
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "lw/net/tls_options.h"
+#include "openssl/base.h"
+
+namespace lw::net::internal {
+
+/**
+ * Configures `context` to present `certificate`. Certificates in memory may be
+ * followed by the rest of their chain.
+ */
+void use_certificate(SSL_CTX* context, const TLSCertificate& certificate);
+
+/**
+ * SSL contexts for a set of certificates, keyed by hostname. A certificate is
+ * only loaded the first time a hostname matching it is looked up.
+ *
+ * Safe to use from multiple threads.
+ */
+class TLSCertificateStore {
+public:
+  typedef std::shared_ptr<SSL_CTX> Context;
+  typedef std::function<Context(const TLSCertificate&)> Loader;
+
+  /**
+   * @param certificates
+   *  Certificates by hostname. Names starting with "*." match any one label in
+   *  its place, and the empty name matches hostnames with no other match.
+   * @param reload_interval
+   *  Minimum time between checks of a certificate's files for changes. Zero to
+   *  never reload certificates once loaded.
+   * @param loader
+   *  Creates the context for a certificate, throwing if it cannot be loaded.
+   */
+  TLSCertificateStore(
+    std::map<std::string, TLSCertificate> certificates,
+    std::chrono::steady_clock::duration reload_interval,
+    Loader loader
+  );
+
+  /**
+   * The context for `hostname`, loading or reloading it first if needed. Null
+   * if no certificate matches the hostname.
+   *
+   * A failed reload is logged and the previous context kept, so a certificate
+   * and key caught mid-update do not stop new handshakes.
+   */
+  Context find(std::string_view hostname);
+
+  /**
+   * The number of certificates loaded so far.
+   */
+  std::size_t loaded() const;
+
+private:
+  struct Entry {
+    TLSCertificate certificate;
+    Context context;
+    std::filesystem::file_time_type modified;
+    std::chrono::steady_clock::time_point next_check;
+  };
+
+  Entry* _match(const std::string& hostname);
+  Context _get(Entry& entry);
+
+  std::map<std::string, Entry> _entries;
+  std::chrono::steady_clock::duration _reload_interval;
+  Loader _loader;
+
+  mutable std::mutex _mutex;
+  std::size_t _loaded = 0;
+};
+
+}
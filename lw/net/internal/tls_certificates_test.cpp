@@ -0,0 +1,254 @@
+#include "lw/net/internal/tls_certificates.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/net/testing/tls_credentials.h"
+#include "lw/net/tls_options.h"
+#include "openssl/ssl.h"
+
+namespace lw::net::internal {
+namespace {
+
+namespace fs = ::std::filesystem;
+using ::std::chrono::nanoseconds;
+using ::std::chrono::seconds;
+
+std::string read_file(const fs::path& path) {
+  std::ifstream file{path};
+  return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+TLSCertificate test_certificate() {
+  return {
+    .private_key = fs::path{testing::KEY_PATH},
+    .certificate = fs::path{testing::CERT_PATH}
+  };
+}
+
+TLSCertificate other_certificate() {
+  return {
+    .private_key = fs::path{testing::OTHER_KEY_PATH},
+    .certificate = fs::path{testing::OTHER_CERT_PATH}
+  };
+}
+
+TLSCertificateStore::Context load(const TLSCertificate& certificate) {
+  TLSCertificateStore::Context context{
+    SSL_CTX_new(TLS_server_method()),
+    &SSL_CTX_free
+  };
+  use_certificate(context.get(), certificate);
+  return context;
+}
+
+TEST(UseCertificate, LoadsFiles) {
+  EXPECT_NO_THROW(load(test_certificate()));
+}
+
+TEST(UseCertificate, LoadsPemFromMemory) {
+  EXPECT_NO_THROW(load({
+    .private_key = TLSPem{read_file(testing::KEY_PATH)},
+    .certificate = TLSPem{read_file(testing::CERT_PATH)}
+  }));
+}
+
+TEST(UseCertificate, RejectsMismatchedKey) {
+  EXPECT_THROW(
+    load({
+      .private_key = TLSPem{read_file(testing::OTHER_KEY_PATH)},
+      .certificate = TLSPem{read_file(testing::CERT_PATH)}
+    }),
+    Internal
+  );
+}
+
+TEST(UseCertificate, RejectsMissingFiles) {
+  EXPECT_THROW(
+    load({
+      .private_key = fs::path{"does/not/exist.key.pem"},
+      .certificate = fs::path{"does/not/exist.cert.pem"}
+    }),
+    Internal
+  );
+}
+
+class TLSCertificateStoreTest: public ::testing::Test {
+protected:
+  std::unique_ptr<TLSCertificateStore> make_store(
+    std::map<std::string, TLSCertificate> certificates,
+    nanoseconds reload_interval = seconds{0}
+  ) {
+    return std::make_unique<TLSCertificateStore>(
+      std::move(certificates),
+      reload_interval,
+      [this](const TLSCertificate& certificate) {
+        ++loads;
+        return load(certificate);
+      }
+    );
+  }
+
+  int loads = 0;
+};
+
+TEST_F(TLSCertificateStoreTest, LoadsCertificatesOnFirstUse) {
+  auto store = make_store({
+    {"a.example.com", test_certificate()},
+    {"b.example.com", other_certificate()}
+  });
+  EXPECT_EQ(store->loaded(), 0u);
+  EXPECT_EQ(loads, 0);
+
+  TLSCertificateStore::Context context = store->find("a.example.com");
+  ASSERT_NE(context, nullptr);
+  EXPECT_EQ(store->loaded(), 1u);
+  EXPECT_EQ(store->find("a.example.com"), context);
+  EXPECT_EQ(loads, 1);
+
+  EXPECT_NE(store->find("b.example.com"), context);
+  EXPECT_EQ(store->loaded(), 2u);
+}
+
+TEST_F(TLSCertificateStoreTest, MatchesHostnames) {
+  auto store = make_store({
+    {"Exact.Example.com", test_certificate()},
+    {"*.example.com", other_certificate()}
+  });
+  TLSCertificateStore::Context exact = store->find("exact.example.com");
+  ASSERT_NE(exact, nullptr);
+  EXPECT_EQ(store->find("EXACT.EXAMPLE.COM"), exact);
+
+  TLSCertificateStore::Context wildcard = store->find("www.example.com");
+  ASSERT_NE(wildcard, nullptr);
+  EXPECT_NE(wildcard, exact);
+  EXPECT_EQ(store->find("api.example.com"), wildcard);
+
+  // Wildcards cover exactly one label.
+  EXPECT_EQ(store->find("example.com"), nullptr);
+  EXPECT_EQ(store->find("a.b.example.com"), nullptr);
+  EXPECT_EQ(store->find("other.org"), nullptr);
+  EXPECT_EQ(store->find(""), nullptr);
+}
+
+TEST_F(TLSCertificateStoreTest, FallsBackToDefault) {
+  auto store = make_store({
+    {"", test_certificate()},
+    {"other.example.com", other_certificate()}
+  });
+  TLSCertificateStore::Context fallback = store->find("");
+  ASSERT_NE(fallback, nullptr);
+  EXPECT_EQ(store->find("unknown.example.com"), fallback);
+  EXPECT_NE(store->find("other.example.com"), fallback);
+}
+
+class TLSCertificateReloadTest: public TLSCertificateStoreTest {
+protected:
+  void SetUp() override {
+    dir = fs::temp_directory_path() / (
+      std::string{"lw_tls_certificates_test_"} +
+      ::testing::UnitTest::GetInstance()->current_test_info()->name()
+    );
+    fs::create_directories(dir);
+    fs::copy_file(
+      testing::CERT_PATH,
+      dir / "cert.pem",
+      fs::copy_options::overwrite_existing
+    );
+    fs::copy_file(
+      testing::KEY_PATH,
+      dir / "key.pem",
+      fs::copy_options::overwrite_existing
+    );
+  }
+
+  void TearDown() override {
+    fs::remove_all(dir);
+  }
+
+  TLSCertificate certificate() const {
+    return {.private_key = dir / "key.pem", .certificate = dir / "cert.pem"};
+  }
+
+  void touch(const fs::path& path) {
+    fs::last_write_time(path, fs::last_write_time(path) + seconds{1});
+  }
+
+  fs::path dir;
+};
+
+TEST_F(TLSCertificateReloadTest, ReloadsChangedFiles) {
+  auto store = make_store({{"", certificate()}}, nanoseconds{1});
+  TLSCertificateStore::Context original = store->find("");
+  ASSERT_NE(original, nullptr);
+
+  std::this_thread::sleep_for(nanoseconds{1000});
+  EXPECT_EQ(store->find(""), original);
+  EXPECT_EQ(loads, 1);
+
+  fs::copy_file(
+    testing::OTHER_CERT_PATH,
+    dir / "cert.pem",
+    fs::copy_options::overwrite_existing
+  );
+  fs::copy_file(
+    testing::OTHER_KEY_PATH,
+    dir / "key.pem",
+    fs::copy_options::overwrite_existing
+  );
+  touch(dir / "cert.pem");
+  std::this_thread::sleep_for(nanoseconds{1000});
+
+  TLSCertificateStore::Context reloaded = store->find("");
+  ASSERT_NE(reloaded, nullptr);
+  EXPECT_NE(reloaded, original);
+  EXPECT_EQ(loads, 2);
+  EXPECT_EQ(store->loaded(), 1u);
+}
+
+TEST_F(TLSCertificateReloadTest, KeepsContextWhenReloadFails) {
+  auto store = make_store({{"", certificate()}}, nanoseconds{1});
+  TLSCertificateStore::Context original = store->find("");
+  ASSERT_NE(original, nullptr);
+
+  // A certificate replaced without its key is caught mid-update.
+  fs::copy_file(
+    testing::OTHER_CERT_PATH,
+    dir / "cert.pem",
+    fs::copy_options::overwrite_existing
+  );
+  touch(dir / "cert.pem");
+  std::this_thread::sleep_for(nanoseconds{1000});
+  EXPECT_EQ(store->find(""), original);
+  EXPECT_EQ(loads, 2);
+
+  // Once the key catches up the new certificate is used.
+  fs::copy_file(
+    testing::OTHER_KEY_PATH,
+    dir / "key.pem",
+    fs::copy_options::overwrite_existing
+  );
+  std::this_thread::sleep_for(nanoseconds{1000});
+  TLSCertificateStore::Context reloaded = store->find("");
+  EXPECT_NE(reloaded, original);
+  EXPECT_NE(reloaded, nullptr);
+}
+
+TEST_F(TLSCertificateReloadTest, NeverReloadsWithoutInterval) {
+  auto store = make_store({{"", certificate()}});
+  TLSCertificateStore::Context original = store->find("");
+  touch(dir / "cert.pem");
+  EXPECT_EQ(store->find(""), original);
+  EXPECT_EQ(loads, 1);
+}
+
+}
+}
@@ -1,26 +1,150 @@
 #include "lw/net/internal/tls_client.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <string>
 #include <string_view>
 
 #include "lw/err/canonical.h"
+#include "lw/flags/flags.h"
 #include "lw/memory/buffer.h"
+#include "lw/memory/buffer_pool.h"
 #include "lw/memory/buffer_view.h"
 #include "lw/net/internal/errors.h"
 #include "openssl/bio.h"
+#include "openssl/crypto.h"
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
 #include "openssl/ssl.h"
+#include "openssl/x509.h"
+
+LW_FLAG(
+  std::size_t, tls_buffer_size, 17 * 1024,
+  "Size of the pooled buffers holding TLS records in flight. Fits a full TLS "
+  "record with its overhead."
+);
+
+LW_FLAG(
+  std::size_t, tls_buffer_pool_size, 64,
+  "Maximum number of idle TLS record buffers kept for reuse by each thread."
+);
 
 namespace lw::net::internal {
+namespace {
+
+/**
+ * HKDF-Expand-Label from RFC 8446 section 7.1 with an empty context. Outputs no
+ * longer than the digest take a single HMAC.
+ */
+void expand_label(
+  const EVP_MD* digest,
+  const std::vector<std::uint8_t>& secret,
+  std::string_view label,
+  std::uint8_t* out,
+  std::size_t out_size
+) {
+  constexpr std::string_view PREFIX = "tls13 ";
+  std::uint8_t info[4 + PREFIX.size() + 16];
+  std::size_t length = 0;
+  info[length++] = static_cast<std::uint8_t>(out_size >> 8);
+  info[length++] = static_cast<std::uint8_t>(out_size);
+  info[length++] = static_cast<std::uint8_t>(PREFIX.size() + label.size());
+  std::memcpy(info + length, PREFIX.data(), PREFIX.size());
+  length += PREFIX.size();
+  std::memcpy(info + length, label.data(), label.size());
+  length += label.size();
+  info[length++] = 0; // Empty context.
+  info[length++] = 1; // First HKDF-Expand block.
+
+  std::uint8_t block[EVP_MAX_MD_SIZE];
+  unsigned int block_size = 0;
+  if (
+    !HMAC(
+      digest,
+      secret.data(),
+      secret.size(),
+      info,
+      length,
+      block,
+      &block_size
+    ) ||
+    block_size < out_size
+  ) {
+    check_all_errors("Unknown error deriving TLS traffic keys.");
+  }
+  std::memcpy(out, block, out_size);
+  OPENSSL_cleanse(block, sizeof(block));
+}
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return 0;
+}
+
+void erase_secret(std::vector<std::uint8_t>& secret) {
+  if (!secret.empty()) OPENSSL_cleanse(secret.data(), secret.size());
+  secret.clear();
+}
+
+}
+
+TLSTrafficKeys::~TLSTrafficKeys() {
+  OPENSSL_cleanse(key, sizeof(key));
+  OPENSSL_cleanse(iv, sizeof(iv));
+}
+
+BufferPool& tls_record_buffers() {
+  thread_local BufferPool pool{
+    flags::tls_buffer_size,
+    flags::tls_buffer_pool_size
+  };
+  return pool;
+}
+
+TLSClientImpl::TLSClientImpl(SSL* client, TLSHandshakeCounters* counters):
+  _client{client},
+  _counters{counters}
+{
+  BIO* bio = BIO_new(_bio_method());
+  if (!bio) {
+    SSL_free(_client);
+    check_all_errors("Unknown error instantiating TLS client BIO.");
+  }
+  BIO_set_data(bio, this);
+  BIO_set_init(bio, 1);
+
+  // The same BIO is used in both directions, and the SSL client takes its one
+  // reference to it.
+  SSL_set_bio(_client, bio, bio);
+}
 
 TLSClientImpl::~TLSClientImpl() {
-  // BIOs are freed by the SSL client for us.
-  if (_client) SSL_free(_client);
+  if (!_client) return;
+
+  // Connections are commonly closed without a close_notify, which would
+  // otherwise evict their session from the server's cache. Only sessions from
+  // incomplete handshakes are treated as bad.
+  if (SSL_is_init_finished(_client)) {
+    SSL_set_shutdown(_client, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+  }
+
+  // The BIO is freed by the SSL client for us.
+  SSL_free(_client);
+  forget_traffic_secrets();
+  if (!_input.empty()) _release_record_buffer(std::move(_input));
+  if (!_output.empty()) _release_record_buffer(std::move(_output));
 }
 
 TLSResult TLSClientImpl::handshake() {
   if (SSL_is_init_finished(_client)) return TLSResult::COMPLETED;
 
   int ret = SSL_do_handshake(_client);
+  if (ret == 1 && _counters) {
+    ++(session_reused() ? _counters->resumed : _counters->full);
+  }
   int err = SSL_get_error(_client, ret);
   switch (err) {
     case SSL_ERROR_NONE:
@@ -34,22 +158,66 @@ TLSResult TLSClientImpl::handshake() {
   throw Internal() << "Unknown error during handshake.";
 }
 
+bool TLSClientImpl::handshake_finished() const {
+  return SSL_is_init_finished(_client);
+}
+
 TLSIOResult TLSClientImpl::buffer_encrypted_data(BufferView buffer) {
-  if (!BIO_write_all(_encrypted, buffer.data(), buffer.size())) {
-    // TODO(alaina): Check BIO_should_retry before throwing errors if the
-    // write failed. This may just be a buffer full issue and we should wait
-    // for the underlying socket to become available again.
-    check_all_errors("Unknown BIO write error.");
-  };
+  if (buffer.empty()) return {.result = TLSResult::COMPLETED};
+
+  const std::size_t buffered = _input_end - _input_begin;
+  if (_input.size() - _input_end < buffer.size()) {
+    // Compact the buffered data to the front, growing past the pooled size
+    // only when more than a record's worth is waiting.
+    const std::size_t needed = buffered + buffer.size();
+    Buffer input = needed <= tls_record_buffers().buffer_size()
+      ? _acquire_record_buffer()
+      : Buffer{needed};
+    if (buffered > 0) {
+      std::memcpy(input.data(), _input.data() + _input_begin, buffered);
+    }
+    if (!_input.empty()) _release_record_buffer(std::move(_input));
+    _input = std::move(input);
+    _input_begin = 0;
+    _input_end = buffered;
+  }
+  std::memcpy(_input.data() + _input_end, buffer.data(), buffer.size());
+  _input_end += buffer.size();
   return {.result = TLSResult::COMPLETED, .bytes = buffer.size()};
 }
 
-TLSIOResult TLSClientImpl::read_decrypted_data(Buffer& buffer) {
-  int bytes_read = SSL_read(_client, buffer.data(), buffer.size());
-  if (bytes_read <= 0) check_all_errors("Unknown SSL read error.");
-  return {
-      .result = TLSResult::COMPLETED,
-      .bytes = static_cast<std::size_t>(bytes_read)};
+TLSIOResult TLSClientImpl::decrypt(BufferView encrypted, Buffer& plaintext) {
+  _borrowed = encrypted;
+  _borrowed_begin = 0;
+
+  std::size_t total = 0;
+  TLSResult result = TLSResult::COMPLETED;
+  while (total < plaintext.size()) {
+    int bytes_read = SSL_read(
+      _client,
+      plaintext.data() + total,
+      plaintext.size() - total
+    );
+    if (bytes_read > 0) {
+      total += static_cast<std::size_t>(bytes_read);
+      continue;
+    }
+
+    // Post-handshake messages, such as session tickets, are consumed without
+    // producing any plaintext.
+    int err = SSL_get_error(_client, bytes_read);
+    if (err == SSL_ERROR_WANT_READ) {
+      result = TLSResult::NEED_TO_READ;
+      break;
+    }
+    if (err == SSL_ERROR_ZERO_RETURN) break;
+    _retain_input();
+    check_all_errors("Unknown SSL read error.");
+  }
+  _retain_input();
+
+  if (total == 0 && result != TLSResult::COMPLETED) return {.result = result};
+  return {.result = TLSResult::COMPLETED, .bytes = total};
 }
 
 TLSIOResult TLSClientImpl::buffer_plaintext_data(BufferView buffer) {
@@ -70,15 +238,269 @@ TLSIOResult TLSClientImpl::buffer_plaintext_data(BufferView buffer) {
 }
 
 TLSIOResult TLSClientImpl::read_encrypted_data(Buffer& buffer) {
-  int bytes_read = BIO_read(_plaintext, buffer.data(), buffer.size());
-  if (bytes_read < 0) {
-    if (BIO_should_retry(_plaintext)) return {.result = TLSResult::AGAIN};
-    check_all_errors("Unknown BIO read error.");
+  BufferView pending = encrypted_data();
+  if (pending.empty()) return {.result = TLSResult::AGAIN};
+
+  const std::size_t bytes = std::min(pending.size(), buffer.size());
+  std::memcpy(buffer.data(), pending.data(), bytes);
+  consume_encrypted_data(bytes);
+  return {.result = TLSResult::COMPLETED, .bytes = bytes};
+}
+
+void TLSClientImpl::consume_encrypted_data(std::size_t bytes) {
+  _output_begin += std::min(bytes, _output_end - _output_begin);
+  if (_output_begin == _output_end) {
+    _output_begin = _output_end = 0;
+    _release_record_buffer(std::move(_output));
+    _output = Buffer{};
   }
+}
 
-  return {
-      .result = TLSResult::COMPLETED,
-      .bytes = static_cast<std::size_t>(bytes_read)};
+TLSResult TLSClientImpl::offloaded_handshake() {
+  _offloaded = true;
+  try {
+    const TLSResult result = handshake();
+    _offloaded = false;
+    return result;
+  } catch (...) {
+    _offloaded = false;
+    throw;
+  }
+}
+
+Buffer TLSClientImpl::_acquire_record_buffer() {
+  if (_offloaded) return Buffer{tls_record_buffers().buffer_size()};
+  return tls_record_buffers().acquire();
+}
+
+void TLSClientImpl::_release_record_buffer(Buffer buffer) {
+  // Buffers let go of during an offloaded handshake are simply freed.
+  if (!_offloaded) tls_record_buffers().release(std::move(buffer));
+}
+
+bool TLSClientImpl::session_reused() const {
+  return SSL_session_reused(_client) == 1;
 }
 
-} // namespace lw::net::internal
+TLSSession TLSClientImpl::session() const {
+  SSL_SESSION* session = SSL_get1_session(_client);
+  if (!session) return nullptr;
+  return TLSSession{session, &SSL_SESSION_free};
+}
+
+void TLSClientImpl::resume_session(const TLSSession& session) {
+  if (SSL_set_session(_client, session.get()) != 1) {
+    check_all_errors("Unknown error setting TLS session to resume.");
+  }
+}
+
+std::string TLSClientImpl::peer_subject() const {
+  X509* certificate = SSL_get_peer_certificate(_client);
+  if (!certificate) return {};
+
+  char subject[256] = {0};
+  X509_NAME_oneline(
+    X509_get_subject_name(certificate),
+    subject,
+    sizeof(subject)
+  );
+  X509_free(certificate);
+  return subject;
+}
+
+std::string_view TLSClientImpl::alpn_protocol() const {
+  const std::uint8_t* protocol = nullptr;
+  unsigned int length = 0;
+  SSL_get0_alpn_selected(_client, &protocol, &length);
+  return {reinterpret_cast<const char*>(protocol), length};
+}
+
+bool TLSClientImpl::is_server() const {
+  return SSL_is_server(_client) == 1;
+}
+
+bool TLSClientImpl::has_buffered_input() const {
+  return _input_end > _input_begin || SSL_has_pending(_client) == 1;
+}
+
+std::optional<TLSTrafficKeys> TLSClientImpl::traffic_keys(
+  TLSDirection direction
+) const {
+  if (!handshake_finished() || SSL_version(_client) != TLS1_3_VERSION) {
+    return std::nullopt;
+  }
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(_client);
+  if (!cipher) return std::nullopt;
+
+  TLSTrafficKeys keys;
+  const EVP_MD* digest = nullptr;
+  keys.cipher_suite = SSL_CIPHER_get_protocol_id(cipher);
+  switch (keys.cipher_suite) {
+    case TLSTrafficKeys::AES_128_GCM_SHA256:
+      keys.key_size = 16;
+      digest = EVP_sha256();
+      break;
+    case TLSTrafficKeys::AES_256_GCM_SHA384:
+      keys.key_size = 32;
+      digest = EVP_sha384();
+      break;
+    default:
+      return std::nullopt;
+  }
+
+  // Servers send with the server secret and clients with the client secret.
+  const std::vector<std::uint8_t>& secret =
+    (direction == TLSDirection::SEND) == is_server()
+      ? _server_traffic_secret
+      : _client_traffic_secret;
+  if (secret.empty()) return std::nullopt;
+
+  expand_label(digest, secret, "key", keys.key, keys.key_size);
+  expand_label(digest, secret, "iv", keys.iv, sizeof(keys.iv));
+  keys.sequence = direction == TLSDirection::SEND
+    ? SSL_get_write_sequence(_client)
+    : SSL_get_read_sequence(_client);
+  return keys;
+}
+
+void TLSClientImpl::forget_traffic_secrets() {
+  erase_secret(_client_traffic_secret);
+  erase_secret(_server_traffic_secret);
+}
+
+void TLSClientImpl::capture_traffic_secret(const SSL* ssl, const char* line) {
+  // Lines are formatted as "<label> <client random> <secret>", with the last
+  // two in hex.
+  const std::string_view entry{line};
+  auto& self = *static_cast<TLSClientImpl*>(BIO_get_data(SSL_get_rbio(ssl)));
+  std::vector<std::uint8_t>* secret = nullptr;
+  if (entry.starts_with("CLIENT_TRAFFIC_SECRET_0 ")) {
+    secret = &self._client_traffic_secret;
+  } else if (entry.starts_with("SERVER_TRAFFIC_SECRET_0 ")) {
+    secret = &self._server_traffic_secret;
+  } else {
+    return;
+  }
+
+  const std::string_view hex = entry.substr(entry.rfind(' ') + 1);
+  erase_secret(*secret);
+  secret->reserve(hex.size() / 2);
+  for (std::size_t i = 0; i + 1 < hex.size(); i += 2) {
+    secret->push_back(static_cast<std::uint8_t>(
+      (hex_value(hex[i]) << 4) | hex_value(hex[i + 1])
+    ));
+  }
+}
+
+void TLSClientImpl::_retain_input() {
+  const std::size_t remaining = _borrowed.size() - _borrowed_begin;
+  if (remaining > 0) {
+    buffer_encrypted_data({_borrowed.data() + _borrowed_begin, remaining});
+  }
+  _borrowed = BufferView{};
+  _borrowed_begin = 0;
+}
+
+BIO_METHOD* TLSClientImpl::_bio_method() {
+  static BIO_METHOD* const method = []() {
+    BIO_METHOD* method = BIO_meth_new(
+      BIO_get_new_index() | BIO_TYPE_SOURCE_SINK,
+      "lw TLS client"
+    );
+    if (
+      !method ||
+      !BIO_meth_set_read(method, &TLSClientImpl::_bio_read) ||
+      !BIO_meth_set_write(method, &TLSClientImpl::_bio_write) ||
+      !BIO_meth_set_ctrl(method, &TLSClientImpl::_bio_ctrl)
+    ) {
+      check_all_errors("Unknown error creating TLS client BIO method.");
+    }
+    return method;
+  }();
+  return method;
+}
+
+int TLSClientImpl::_bio_read(BIO* bio, char* out, int length) {
+  auto& self = *static_cast<TLSClientImpl*>(BIO_get_data(bio));
+  BIO_clear_retry_flags(bio);
+
+  std::size_t copied = 0;
+  auto take = [&](const std::uint8_t* data, std::size_t available) {
+    if (available == 0) return std::size_t{0};
+    const std::size_t bytes =
+      std::min(available, static_cast<std::size_t>(length) - copied);
+    std::memcpy(out + copied, data, bytes);
+    copied += bytes;
+    return bytes;
+  };
+
+  // Previously buffered data always comes before borrowed data.
+  self._input_begin += take(
+    self._input.data() + self._input_begin,
+    self._input_end - self._input_begin
+  );
+  if (self._input_begin == self._input_end && !self._input.empty()) {
+    self._input_begin = self._input_end = 0;
+    self._release_record_buffer(std::move(self._input));
+    self._input = Buffer{};
+  }
+  self._borrowed_begin += take(
+    self._borrowed.data() + self._borrowed_begin,
+    self._borrowed.size() - self._borrowed_begin
+  );
+
+  if (copied == 0) {
+    BIO_set_retry_read(bio);
+    return -1;
+  }
+  return static_cast<int>(copied);
+}
+
+int TLSClientImpl::_bio_write(BIO* bio, const char* data, int length) {
+  auto& self = *static_cast<TLSClientImpl*>(BIO_get_data(bio));
+  BIO_clear_retry_flags(bio);
+
+  if (self._output.empty()) self._output = self._acquire_record_buffer();
+  if (self._output_end == self._output.size() && self._output_begin > 0) {
+    const std::size_t pending = self._output_end - self._output_begin;
+    std::memmove(
+      self._output.data(),
+      self._output.data() + self._output_begin,
+      pending
+    );
+    self._output_begin = 0;
+    self._output_end = pending;
+  }
+
+  const std::size_t bytes = std::min(
+    static_cast<std::size_t>(length),
+    self._output.size() - self._output_end
+  );
+  if (bytes == 0) {
+    // Full, the SSL client retries once the pending data has been sent.
+    BIO_set_retry_write(bio);
+    return -1;
+  }
+  std::memcpy(self._output.data() + self._output_end, data, bytes);
+  self._output_end += bytes;
+  return static_cast<int>(bytes);
+}
+
+long TLSClientImpl::_bio_ctrl(BIO* bio, int command, long, void*) {
+  auto& self = *static_cast<TLSClientImpl*>(BIO_get_data(bio));
+  switch (command) {
+    case BIO_CTRL_FLUSH:
+      // Data is sent by the owner of the client, nothing to do here.
+      return 1;
+    case BIO_CTRL_PENDING:
+      return static_cast<long>(
+        (self._input_end - self._input_begin) +
+        (self._borrowed.size() - self._borrowed_begin)
+      );
+    case BIO_CTRL_WPENDING:
+      return static_cast<long>(self._output_end - self._output_begin);
+  }
+  return 0;
+}
+
+}
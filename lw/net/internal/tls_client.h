@@ -1,6 +1,15 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "lw/memory/buffer.h"
+#include "lw/memory/buffer_pool.h"
 #include "lw/memory/buffer_view.h"
 #include "openssl/base.h"
 
@@ -41,6 +50,53 @@ struct TLSIOResult {
   operator bool() const { return result == TLSResult::COMPLETED; }
 };
 
+/**
+ * Shared counts of handshakes completed by the clients of a `TLSContextImpl`.
+ */
+struct TLSHandshakeCounters {
+  std::atomic<std::uint64_t> full = 0;
+  std::atomic<std::uint64_t> resumed = 0;
+};
+
+/**
+ * A shared reference to a negotiated TLS session.
+ */
+typedef std::shared_ptr<SSL_SESSION> TLSSession;
+
+enum class TLSDirection {
+  SEND,
+  RECEIVE
+};
+
+/**
+ * The keys protecting records in one direction of an established connection.
+ */
+struct TLSTrafficKeys {
+  // IANA identifiers of the supported TLS 1.3 cipher suites.
+  static constexpr std::uint16_t AES_128_GCM_SHA256 = 0x1301;
+  static constexpr std::uint16_t AES_256_GCM_SHA384 = 0x1302;
+
+  TLSTrafficKeys() = default;
+  TLSTrafficKeys(const TLSTrafficKeys&) = default;
+  TLSTrafficKeys& operator=(const TLSTrafficKeys&) = default;
+  ~TLSTrafficKeys();
+
+  std::uint16_t cipher_suite = 0;
+  std::uint8_t key[32] = {};
+  std::size_t key_size = 0;
+  std::uint8_t iv[12] = {};
+
+  /**
+   * Sequence number of the next record in this direction.
+   */
+  std::uint64_t sequence = 0;
+};
+
+/**
+ * The per-thread pool of buffers sized to hold TLS records in flight.
+ */
+BufferPool& tls_record_buffers();
+
 /**
  * Simplified interface for setting up and utilizing a TLS connection.
  *
@@ -48,12 +104,22 @@ struct TLSIOResult {
  * encryption and decryption internally. This means it is necessary to first
  * buffer decrypted or encrypted data before attempting to read. Failure to do
  * so will result in `TLSResult::NEED_TO_READ`.
+ *
+ * Encrypted data is only held in buffers from `tls_record_buffers` while it is
+ * in flight, so idle clients hold no transport buffers.
  */
 class TLSClientImpl {
 public:
-  TLSClientImpl(SSL* client, BIO* encrypted, BIO* plaintext)
-      : _client{client}, _encrypted{encrypted}, _plaintext{plaintext} {}
+  /**
+   * Takes ownership of the SSL client and connects it to this object's
+   * transport buffers.
+   */
+  explicit TLSClientImpl(
+      SSL* client,
+      TLSHandshakeCounters* counters = nullptr);
 
+  TLSClientImpl(const TLSClientImpl&) = delete;
+  TLSClientImpl& operator=(const TLSClientImpl&) = delete;
   ~TLSClientImpl();
 
   /**
@@ -79,7 +145,21 @@ public:
   TLSResult handshake();
 
   /**
-   * Add encrypted data to the decryption buffer.
+   * Advances the handshake like `handshake`, from a thread other than the one
+   * using this client. Record buffers needed meanwhile are neither taken from
+   * nor given back to the calling thread's `tls_record_buffers`, so buffers do
+   * not wander between the pools of different threads.
+   */
+  TLSResult offloaded_handshake();
+
+  /**
+   * Returns true once the handshake has completed. Unlike `handshake`, this
+   * never advances the handshake.
+   */
+  bool handshake_finished() const;
+
+  /**
+   * Add encrypted data to the decryption buffer. The data is copied.
    *
    * Data buffered with this method may be read as plaintext using the
    * `read_decrypted_data` method.
@@ -88,10 +168,27 @@ public:
    */
   TLSIOResult buffer_encrypted_data(BufferView buffer);
 
+  /**
+   * Decrypts previously buffered data followed by `encrypted` directly into
+   * `plaintext`, without copying `encrypted` into the decryption buffer first.
+   * Only the trailing part of `encrypted` which could not be processed yet is
+   * copied and kept for the next call.
+   *
+   * `encrypted` may lie within `plaintext` to decrypt in place, provided it
+   * starts at least one full record in if `has_buffered_input` is true.
+   *
+   * @return
+   *  The number of plaintext bytes written, or `TLSResult::NEED_TO_READ` if no
+   *  complete record has been received.
+   */
+  TLSIOResult decrypt(BufferView encrypted, Buffer& plaintext);
+
   /**
    * Reads as plaintext data which was buffered using `buffer_encrypted_data`.
    */
-  TLSIOResult read_decrypted_data(Buffer& buffer);
+  TLSIOResult read_decrypted_data(Buffer& buffer) {
+    return decrypt({}, buffer);
+  }
 
   /**
    * Add plaintext data to the encryption buffer.
@@ -99,19 +196,138 @@ public:
    * Data buffered with this method may be read encrypted using the
    * `read_encrypted_data` method.
    *
-   * @return The number of bytes written to the encryption buffer.
+   * @return
+   *  The number of bytes written to the encryption buffer, which may be less
+   *  than given. Returns `TLSResult::NEED_TO_WRITE` if the encryption buffer is
+   *  full, in which case it must be drained and the call repeated with the
+   *  same data.
    */
   TLSIOResult buffer_plaintext_data(BufferView buffer);
 
   /**
-   * Reads encrypted data previously buffered using `buffer_plaintext_data`.
+   * Copies out encrypted data previously buffered using
+   * `buffer_plaintext_data`.
    */
   TLSIOResult read_encrypted_data(Buffer& buffer);
 
+  /**
+   * The encrypted data waiting to be sent, which stays valid until the next
+   * call to any other method.
+   */
+  BufferView encrypted_data() const {
+    return {_output.data() + _output_begin, _output_end - _output_begin};
+  }
+
+  /**
+   * Marks the first `bytes` of `encrypted_data` as sent.
+   */
+  void consume_encrypted_data(std::size_t bytes);
+
+  /**
+   * Returns true if the completed handshake resumed an earlier session instead
+   * of negotiating a new one.
+   */
+  bool session_reused() const;
+
+  /**
+   * The session negotiated by this connection, which a later connection to the
+   * same server may offer using `resume_session`. Null before the handshake
+   * completes.
+   */
+  TLSSession session() const;
+
+  /**
+   * Offers a previously negotiated session to the server. Must be called before
+   * the handshake starts.
+   */
+  void resume_session(const TLSSession& session);
+
+  /**
+   * The subject name of the certificate presented by the other end of the
+   * connection, or empty if it presented none.
+   */
+  std::string peer_subject() const;
+
+  /**
+   * The application protocol agreed on with ALPN, or empty if there was none.
+   */
+  std::string_view alpn_protocol() const;
+
+  /**
+   * Returns true if this client is the accepting end of the connection.
+   */
+  bool is_server() const;
+
+  /**
+   * Returns true if received data is waiting to be decrypted, including any
+   * partial record.
+   */
+  bool has_buffered_input() const;
+
+  /**
+   * The current keys of an established TLS 1.3 connection using AES-GCM, which
+   * let another party, such as the kernel, take over that direction of the
+   * connection. The SSL client must not process records in that direction
+   * afterwards.
+   *
+   * Only available from contexts which capture traffic secrets, and until
+   * `forget_traffic_secrets` is called.
+   */
+  std::optional<TLSTrafficKeys> traffic_keys(TLSDirection direction) const;
+
+  /**
+   * Erases the captured traffic secrets.
+   */
+  void forget_traffic_secrets();
+
+  /**
+   * Key log callback for SSL contexts, capturing the application traffic
+   * secrets of connections for `traffic_keys`.
+   */
+  static void capture_traffic_secret(const SSL* ssl, const char* line);
+
 private:
+  /**
+   * The BIO method moving encrypted data between SSL clients and the buffers
+   * of their `TLSClientImpl`.
+   */
+  static BIO_METHOD* _bio_method();
+  static int _bio_read(BIO* bio, char* out, int length);
+  static int _bio_write(BIO* bio, const char* data, int length);
+  static long _bio_ctrl(BIO* bio, int command, long num, void* ptr);
+
+  /**
+   * Copies any unread borrowed data into the decryption buffer.
+   */
+  void _retain_input();
+
+  /**
+   * Takes a record buffer from, or gives one back to, this thread's
+   * `tls_record_buffers`, unless in an offloaded handshake.
+   */
+  Buffer _acquire_record_buffer();
+  void _release_record_buffer(Buffer buffer);
+
   SSL* _client = nullptr;
-  BIO* _encrypted = nullptr;
-  BIO* _plaintext = nullptr;
+  TLSHandshakeCounters* _counters = nullptr;
+  bool _offloaded = false;
+
+  // Received encrypted data the SSL client has not read yet. Data handed to
+  // `decrypt` is borrowed and read after anything already buffered.
+  Buffer _input;
+  std::size_t _input_begin = 0;
+  std::size_t _input_end = 0;
+  BufferView _borrowed;
+  std::size_t _borrowed_begin = 0;
+
+  // Encrypted data produced by the SSL client which has not been sent yet.
+  Buffer _output;
+  std::size_t _output_begin = 0;
+  std::size_t _output_end = 0;
+
+  // Application traffic secrets, when captured.
+  std::vector<std::uint8_t> _client_traffic_secret;
+  std::vector<std::uint8_t> _server_traffic_secret;
 };
 
 } // namespace lw::net::internal
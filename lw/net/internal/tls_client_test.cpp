@@ -1,15 +1,22 @@
 #include "lw/net/internal/tls_client.h"
 
+#include <algorithm>
 #include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
 #include <variant>
 
 #include "lw/memory/buffer.h"
+#include "lw/memory/buffer_pool.h"
 #include "lw/memory/buffer_view.h"
 #include "lw/net/internal/tls_context.h"
 #include "lw/net/testing/tls_credentials.h"
 #include "lw/net/tls_options.h"
 #include "gtest/gtest.h"
+#include "openssl/evp.h"
 
 namespace lw::net::internal {
 namespace {
@@ -83,5 +90,268 @@ TEST(TLSClientImpl, CanCommunicateWithItself) {
   EXPECT_EQ(static_cast<std::string_view>(server_read_view), message);
 }
 
+TEST(TLSClientImpl, OffloadedHandshakesKeepToTheirOwnBuffers) {
+  std::unique_ptr<TLSContextImpl> client_ctx = TLSContextImpl::from_options(
+      {.private_key = {testing::KEY_PATH},
+       .certificate = {testing::CERT_PATH},
+       .connection_mode = TLSOptions::CONNECT});
+  std::unique_ptr<TLSContextImpl> server_ctx = TLSContextImpl::from_options(
+      {.private_key = {testing::KEY_PATH},
+       .certificate = {testing::CERT_PATH},
+       .connection_mode = TLSOptions::ACCEPT});
+  std::unique_ptr<TLSClientImpl> client = client_ctx->make_client();
+  std::unique_ptr<TLSClientImpl> server = server_ctx->make_client();
+
+  auto send = [](TLSClientImpl& from, TLSClientImpl& to) {
+    for (BufferView pending = from.encrypted_data(); !pending.empty();
+         pending = from.encrypted_data()) {
+      to.buffer_encrypted_data(pending);
+      from.consume_encrypted_data(pending.size());
+    }
+  };
+
+  // Each server step runs on a new thread, whose pool must be left empty.
+  TLSResult server_state = TLSResult::AGAIN;
+  auto step_server = [&]() {
+    std::size_t worker_free_buffers = 0;
+    std::thread worker{[&]() {
+      server_state = server->offloaded_handshake();
+      worker_free_buffers = tls_record_buffers().free_count();
+    }};
+    worker.join();
+    EXPECT_EQ(worker_free_buffers, 0);
+  };
+
+  // The hello arrives in two parts, so the first step only reads.
+  TLSResult client_state = client->handshake();
+  const BufferView hello = client->encrypted_data();
+  const std::size_t half = hello.size() / 2;
+  server->buffer_encrypted_data({hello.data(), half});
+  step_server();
+  EXPECT_EQ(server_state, TLSResult::NEED_TO_READ);
+  server->buffer_encrypted_data({hello.data() + half, hello.size() - half});
+  client->consume_encrypted_data(hello.size());
+
+  while (client_state != TLSResult::COMPLETED ||
+         server_state != TLSResult::COMPLETED) {
+    step_server();
+    send(*server, *client);
+    client_state = client->handshake();
+    send(*client, *server);
+  }
+}
+
+class TLSClientTransportTest : public ::testing::Test {
+protected:
+  explicit TLSClientTransportTest(bool kernel_tls = false)
+      : _client_ctx{TLSContextImpl::from_options(
+            {.private_key = {testing::KEY_PATH},
+             .certificate = {testing::CERT_PATH},
+             .connection_mode = TLSOptions::CONNECT,
+             .kernel_tls = kernel_tls})},
+        _server_ctx{TLSContextImpl::from_options(
+            {.private_key = {testing::KEY_PATH},
+             .certificate = {testing::CERT_PATH},
+             .connection_mode = TLSOptions::ACCEPT,
+             .kernel_tls = kernel_tls})},
+        _client{_client_ctx->make_client()},
+        _server{_server_ctx->make_client()} {
+    TLSResult client_state = TLSResult::AGAIN;
+    TLSResult server_state = TLSResult::AGAIN;
+    while (client_state != TLSResult::COMPLETED ||
+           server_state != TLSResult::COMPLETED) {
+      client_state = _client->handshake();
+      send(*_client, *_server);
+      server_state = _server->handshake();
+      send(*_server, *_client);
+    }
+  }
+
+  static void send(TLSClientImpl& from, TLSClientImpl& to) {
+    for (BufferView pending = from.encrypted_data(); !pending.empty();
+         pending = from.encrypted_data()) {
+      to.buffer_encrypted_data(pending);
+      from.consume_encrypted_data(pending.size());
+    }
+  }
+
+  /**
+   * Encrypts all of `message` with `from`, draining its record buffer into the
+   * returned string whenever it fills up.
+   */
+  static std::string encrypt(TLSClientImpl& from, std::string_view message) {
+    std::string wire;
+    std::size_t buffered = 0;
+    while (buffered < message.size()) {
+      TLSIOResult res = from.buffer_plaintext_data(
+          {reinterpret_cast<const std::uint8_t*>(message.data()) + buffered,
+           message.size() - buffered});
+      if (res.result != TLSResult::NEED_TO_WRITE) {
+        EXPECT_TRUE(res);
+        buffered += res.bytes;
+      }
+      wire += static_cast<std::string_view>(from.encrypted_data());
+      from.consume_encrypted_data(from.encrypted_data().size());
+    }
+    return wire;
+  }
+
+  std::unique_ptr<TLSContextImpl> _client_ctx;
+  std::unique_ptr<TLSContextImpl> _server_ctx;
+  std::unique_ptr<TLSClientImpl> _client;
+  std::unique_ptr<TLSClientImpl> _server;
+};
+
+TEST_F(TLSClientTransportTest, EncryptsMessagesLargerThanRecordBuffer) {
+  const std::string message(100 * 1024, 'x');
+  const std::string wire = encrypt(*_client, message);
+  EXPECT_GT(wire.size(), message.size());
+  EXPECT_TRUE(_client->encrypted_data().empty());
+
+  Buffer plaintext{message.size()};
+  TLSIOResult res = _server->decrypt(
+      {reinterpret_cast<const std::uint8_t*>(wire.data()), wire.size()},
+      plaintext);
+  ASSERT_TRUE(res);
+  EXPECT_EQ(res.bytes, message.size());
+  EXPECT_EQ(static_cast<std::string_view>(plaintext), message);
+}
+
+TEST_F(TLSClientTransportTest, DecryptsRecordsSplitAcrossReads) {
+  std::string message;
+  for (int i = 0; message.size() < 40 * 1024; ++i) {
+    message += std::to_string(i);
+  }
+  const std::string wire = encrypt(*_client, message);
+
+  // Feed the ciphertext through a small reused buffer, as a socket would.
+  Buffer chunk{1000};
+  Buffer plaintext{4096};
+  std::string received;
+  for (std::size_t offset = 0; offset < wire.size(); offset += chunk.size()) {
+    const std::size_t size = std::min(chunk.size(), wire.size() - offset);
+    chunk.copy(wire.begin() + offset, size);
+    TLSIOResult res = _server->decrypt({chunk.data(), size}, plaintext);
+    while (res && res.bytes > 0) {
+      received += static_cast<std::string_view>(
+          BufferView{plaintext.data(), res.bytes});
+      res = _server->read_decrypted_data(plaintext);
+    }
+  }
+  EXPECT_EQ(received, message);
+}
+
+TEST_F(TLSClientTransportTest, DecryptNeedsCompleteRecords) {
+  const std::string wire = encrypt(*_client, "hello");
+  Buffer plaintext{64};
+
+  TLSIOResult res = _server->decrypt(
+      {reinterpret_cast<const std::uint8_t*>(wire.data()), 3}, plaintext);
+  EXPECT_EQ(res.result, TLSResult::NEED_TO_READ);
+
+  res = _server->decrypt(
+      {reinterpret_cast<const std::uint8_t*>(wire.data()) + 3,
+       wire.size() - 3},
+      plaintext);
+  ASSERT_TRUE(res);
+  EXPECT_EQ(
+      static_cast<std::string_view>(BufferView{plaintext.data(), res.bytes}),
+      "hello");
+}
+
+TEST_F(TLSClientTransportTest, NoTrafficKeysWithoutKernelTLS) {
+  EXPECT_FALSE(_client->traffic_keys(TLSDirection::SEND));
+  EXPECT_FALSE(_server->traffic_keys(TLSDirection::RECEIVE));
+}
+
+class TLSClientTrafficKeysTest : public TLSClientTransportTest {
+protected:
+  TLSClientTrafficKeysTest() : TLSClientTransportTest{/*kernel_tls=*/true} {}
+
+  static void expect_same_keys(
+      const std::optional<TLSTrafficKeys>& sender,
+      const std::optional<TLSTrafficKeys>& receiver) {
+    ASSERT_TRUE(sender);
+    ASSERT_TRUE(receiver);
+    EXPECT_EQ(sender->cipher_suite, receiver->cipher_suite);
+    ASSERT_EQ(sender->key_size, receiver->key_size);
+    EXPECT_TRUE(std::equal(
+        sender->key, sender->key + sender->key_size, receiver->key));
+    EXPECT_TRUE(std::equal(
+        std::begin(sender->iv), std::end(sender->iv), receiver->iv));
+  }
+};
+
+TEST_F(TLSClientTrafficKeysTest, PeersAgreeOnKeys) {
+  expect_same_keys(
+      _client->traffic_keys(TLSDirection::SEND),
+      _server->traffic_keys(TLSDirection::RECEIVE));
+  expect_same_keys(
+      _server->traffic_keys(TLSDirection::SEND),
+      _client->traffic_keys(TLSDirection::RECEIVE));
+
+  const std::optional<TLSTrafficKeys> client_keys =
+      _client->traffic_keys(TLSDirection::SEND);
+  const std::optional<TLSTrafficKeys> server_keys =
+      _server->traffic_keys(TLSDirection::SEND);
+  EXPECT_FALSE(std::equal(
+      client_keys->key, client_keys->key + client_keys->key_size,
+      server_keys->key));
+}
+
+TEST_F(TLSClientTrafficKeysTest, KeysDecryptRecordsFromTheWire) {
+  const std::optional<TLSTrafficKeys> keys =
+      _client->traffic_keys(TLSDirection::SEND);
+  ASSERT_TRUE(keys);
+  const std::string wire = encrypt(*_client, "hello");
+
+  // A TLS 1.3 record is a 5 byte header, which is authenticated, followed by
+  // the encrypted message and content type, then a 16 byte tag.
+  constexpr std::size_t HEADER_SIZE = 5;
+  constexpr std::size_t TAG_SIZE = 16;
+  ASSERT_EQ(wire.size(), HEADER_SIZE + 5 + 1 + TAG_SIZE);
+  const auto* record = reinterpret_cast<const std::uint8_t*>(wire.data());
+  std::uint8_t nonce[sizeof(keys->iv)];
+  std::copy(std::begin(keys->iv), std::end(keys->iv), nonce);
+  for (std::size_t i = 0; i < 8; ++i) {
+    nonce[sizeof(nonce) - 1 - i] ^=
+        static_cast<std::uint8_t>(keys->sequence >> (8 * i));
+  }
+
+  EVP_CIPHER_CTX* cipher = EVP_CIPHER_CTX_new();
+  std::uint8_t plaintext[6];
+  int length = 0;
+  ASSERT_EQ(
+      EVP_DecryptInit_ex(
+          cipher,
+          keys->key_size == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm(),
+          nullptr, keys->key, nonce),
+      1);
+  ASSERT_EQ(
+      EVP_DecryptUpdate(cipher, nullptr, &length, record, HEADER_SIZE), 1);
+  ASSERT_EQ(
+      EVP_DecryptUpdate(
+          cipher, plaintext, &length, record + HEADER_SIZE,
+          sizeof(plaintext)),
+      1);
+  ASSERT_EQ(
+      EVP_CIPHER_CTX_ctrl(
+          cipher, EVP_CTRL_GCM_SET_TAG, TAG_SIZE,
+          const_cast<std::uint8_t*>(record + wire.size() - TAG_SIZE)),
+      1);
+  EXPECT_EQ(EVP_DecryptFinal_ex(cipher, plaintext + length, &length), 1);
+  EVP_CIPHER_CTX_free(cipher);
+
+  EXPECT_EQ(
+      std::string_view(reinterpret_cast<const char*>(plaintext), 5), "hello");
+  EXPECT_EQ(plaintext[5], 0x17); // Application data content type.
+}
+
+TEST_F(TLSClientTrafficKeysTest, ForgottenSecretsYieldNoKeys) {
+  _client->forget_traffic_secrets();
+  EXPECT_FALSE(_client->traffic_keys(TLSDirection::SEND));
+  EXPECT_FALSE(_client->traffic_keys(TLSDirection::RECEIVE));
+}
+
 } // namespace
 } // namespace lw::net::internal
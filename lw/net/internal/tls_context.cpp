@@ -1,13 +1,25 @@
 #include "lw/net/internal/tls_context.h"
 
+#include <cstring>
+#include <exception>
 #include <experimental/source_location>
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "lw/err/canonical.h"
+#include "lw/log/log.h"
 #include "lw/net/internal/errors.h"
+#include "lw/net/internal/tls_certificates.h"
+#include "lw/net/internal/tls_session.h"
 #include "openssl/bio.h"
 #include "openssl/crypto.h"
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+#include "openssl/rand.h"
 #include "openssl/ssl.h"
 
 namespace lw::net::internal {
@@ -24,81 +36,398 @@ using std::experimental::source_location;
   check_all_errors(backup_message, loc);
 }
 
+/**
+ * Index of the `SSL_CTX` extra data slot pointing back at the owning
+ * `TLSContextImpl`.
+ */
+int context_ex_index() {
+  static const int index =
+    SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+  return index;
 }
 
-TLSContextImpl::~TLSContextImpl() {
-  if (_context) SSL_CTX_free(_context);
-}
-
-std::unique_ptr<TLSContextImpl> TLSContextImpl::from_options(
-  const TLSOptions& options
+SSL_CTX* new_context(
+  TLSOptions::ConnectionMode connection_mode,
+  TLSOptions::Version max_version
 ) {
-  // Instantiate the SSL context.
   SSL_CTX* context = SSL_CTX_new(
-    options.connection_mode == TLSOptions::ACCEPT
+    connection_mode == TLSOptions::ACCEPT
       ? TLS_server_method()
       : TLS_client_method()
   );
   if (!context) {
     check_all_errors("Unknown error instantiating SSL_CTX.");
   }
+  // Writes may be split across several calls once the transport buffer fills,
+  // and the SSL library's own buffers are freed while connections are idle.
+  SSL_CTX_set_mode(
+    context,
+    SSL_MODE_ENABLE_PARTIAL_WRITE |
+      SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+      SSL_MODE_RELEASE_BUFFERS
+  );
   if (!SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION)) {
     context_setup_error(context, "Unknown error setting min TLS version.");
   }
-
-  // Configure the certificate and private key.
-  auto key_path = std::get<std::filesystem::path>(options.private_key);
-  auto cert_path = std::get<std::filesystem::path>(options.certificate);
   if (
-    SSL_CTX_use_certificate_file(
+    !SSL_CTX_set_max_proto_version(
       context,
-      cert_path.c_str(),
-      SSL_FILETYPE_PEM
-    ) != 1
+      max_version == TLSOptions::TLS_1_2 ? TLS1_2_VERSION : TLS1_3_VERSION
+    )
   ) {
-    context_setup_error(context, "Unknown error setting certificate file.");
+    context_setup_error(context, "Unknown error setting max TLS version.");
   }
-  if (
-    SSL_CTX_use_PrivateKey_file(
+  return context;
+}
+
+/**
+ * Encodes protocol names as ALPN sends them, each prefixed by its length.
+ */
+std::string encode_alpn_protocols(const std::vector<std::string>& protocols) {
+  std::string wire;
+  for (const std::string& protocol : protocols) {
+    if (protocol.empty() || protocol.size() > 255) {
+      throw InvalidArgument()
+        << "Invalid ALPN protocol name \"" << protocol << "\".";
+    }
+    wire.push_back(static_cast<char>(protocol.size()));
+    wire += protocol;
+  }
+  return wire;
+}
+
+// Session ID context shared by all lw servers. Sessions are only ever resumed
+// through the cache of the context that created them.
+constexpr std::uint8_t SESSION_ID_CONTEXT[] = {'l', 'w'};
+
+}
+
+TLSContextImpl::~TLSContextImpl() {
+  if (_context) SSL_CTX_free(_context);
+}
+
+std::unique_ptr<TLSContextImpl> TLSContextImpl::from_options(
+  const TLSOptions& options
+) {
+  SSL_CTX* context = new_context(options.connection_mode, options.max_version);
+  try {
+    use_certificate(context, {
+      .private_key = options.private_key,
+      .certificate = options.certificate
+    });
+  } catch (...) {
+    SSL_CTX_free(context);
+    throw;
+  }
+
+  // The traffic secrets are needed to hand established connections over to
+  // kernel TLS.
+  if (options.kernel_tls) {
+    SSL_CTX_set_keylog_callback(
       context,
-      key_path.c_str(),
-      SSL_FILETYPE_PEM
-    ) != 1
+      &TLSClientImpl::capture_traffic_secret
+    );
+  }
+
+  std::unique_ptr<TLSContextImpl> impl{new TLSContextImpl{options, context}};
+  impl->_configure_alpn(options.alpn_protocols);
+  if (options.connection_mode == TLSOptions::ACCEPT) {
+    impl->_configure_session_resumption(options.session_resumption);
+    impl->_configure_certificates(options);
+  }
+  return impl;
+}
+
+void TLSContextImpl::_configure_session_resumption(
+  const TLSSessionResumptionOptions& options
+) {
+  if (!SSL_CTX_set_ex_data(_context, context_ex_index(), this)) {
+    check_all_errors("Unknown error attaching TLS context data.");
+  }
+  SSL_CTX_set_timeout(_context, options.session_lifetime.count());
+
+  if (options.session_cache) {
+    _session_cache = std::make_unique<TLSSessionCache>(
+      options.session_cache_size,
+      options.session_cache_shards,
+      options.session_lifetime
+    );
+    if (
+      !SSL_CTX_set_session_id_context(
+        _context,
+        SESSION_ID_CONTEXT,
+        sizeof(SESSION_ID_CONTEXT)
+      )
+    ) {
+      check_all_errors("Unknown error setting session ID context.");
+    }
+    // The internal cache is replaced by our own sharded one.
+    SSL_CTX_set_session_cache_mode(
+      _context,
+      SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL
+    );
+    SSL_CTX_sess_set_new_cb(_context, &TLSContextImpl::_new_session);
+    SSL_CTX_sess_set_get_cb(_context, &TLSContextImpl::_get_session);
+    SSL_CTX_sess_set_remove_cb(_context, &TLSContextImpl::_remove_session);
+  } else {
+    SSL_CTX_set_session_cache_mode(_context, SSL_SESS_CACHE_OFF);
+  }
+
+  if (options.session_tickets) {
+    _ticket_keys = std::make_unique<TLSTicketKeys>(
+      options.ticket_key_rotation,
+      options.session_lifetime
+    );
+    SSL_CTX_set_tlsext_ticket_key_cb(_context, &TLSContextImpl::_ticket_key);
+  } else {
+    SSL_CTX_set_options(_context, SSL_OP_NO_TICKET);
+  }
+}
+
+void TLSContextImpl::_configure_certificates(const TLSOptions& options) {
+  std::map<std::string, TLSCertificate> certificates = options.certificates;
+  if (options.certificate_reload_interval.count() > 0) {
+    // The default certificate only needs its own entry to be reloaded, it is
+    // otherwise presented by the base context.
+    certificates.insert({"", {
+      .private_key = options.private_key,
+      .certificate = options.certificate
+    }});
+  } else if (certificates.empty()) {
+    return;
+  }
+
+  _certificates = std::make_unique<TLSCertificateStore>(
+    std::move(certificates),
+    options.certificate_reload_interval,
+    [this](const TLSCertificate& certificate) {
+      return _new_host_context(certificate);
+    }
+  );
+  SSL_CTX_set_tlsext_servername_callback(
+    _context,
+    &TLSContextImpl::_select_certificate
+  );
+  SSL_CTX_set_tlsext_servername_arg(_context, this);
+}
+
+void TLSContextImpl::_configure_alpn(
+  const std::vector<std::string>& protocols
+) {
+  if (protocols.empty()) return;
+  _alpn_protocols = encode_alpn_protocols(protocols);
+  if (_connection_mode == TLSOptions::ACCEPT) {
+    SSL_CTX_set_alpn_select_cb(
+      _context,
+      &TLSContextImpl::_select_protocol,
+      this
+    );
+  } else if (
+    SSL_CTX_set_alpn_protos(
+      _context,
+      reinterpret_cast<const std::uint8_t*>(_alpn_protocols.data()),
+      _alpn_protocols.size()
+    ) != 0
+  ) {
+    check_all_errors("Unknown error setting ALPN protocols.");
+  }
+}
+
+TLSCertificateStore::Context TLSContextImpl::_new_host_context(
+  const TLSCertificate& certificate
+) {
+  TLSCertificateStore::Context context{
+    new_context(TLSOptions::ACCEPT, _max_version),
+    &SSL_CTX_free
+  };
+  use_certificate(context.get(), certificate);
+
+  // Handshakes are only partly moved over to the host context. Sessions are
+  // still cached through the base context, but some callbacks are looked up on
+  // whichever context the connection currently uses.
+  if (!SSL_CTX_set_ex_data(context.get(), context_ex_index(), this)) {
+    check_all_errors("Unknown error attaching TLS context data.");
+  }
+  if (
+    !SSL_CTX_set_session_id_context(
+      context.get(),
+      SESSION_ID_CONTEXT,
+      sizeof(SESSION_ID_CONTEXT)
+    )
   ) {
-    context_setup_error(context, "Unknown error setting private key file.");
+    check_all_errors("Unknown error setting session ID context.");
+  }
+  if (_kernel_tls) {
+    SSL_CTX_set_keylog_callback(
+      context.get(),
+      &TLSClientImpl::capture_traffic_secret
+    );
   }
-  if (SSL_CTX_check_private_key(context) != 1) {
-    context_setup_error(context, "Unknown error with private key.");
+  if (!_alpn_protocols.empty()) {
+    SSL_CTX_set_alpn_select_cb(
+      context.get(),
+      &TLSContextImpl::_select_protocol,
+      this
+    );
+  }
+  return context;
+}
+
+int TLSContextImpl::_select_certificate(SSL* ssl, int* alert, void* arg) {
+  auto* self = static_cast<TLSContextImpl*>(arg);
+  const char* server_name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  try {
+    TLSCertificateStore::Context context =
+      self->_certificates->find(server_name ? server_name : "");
+    if (context && context.get() != SSL_get_SSL_CTX(ssl)) {
+      // The connection takes its own reference to the context, keeping it
+      // alive even if the certificate is reloaded meanwhile.
+      if (!SSL_set_SSL_CTX(ssl, context.get())) {
+        *alert = SSL_AD_INTERNAL_ERROR;
+        return SSL_TLSEXT_ERR_ALERT_FATAL;
+      }
+    }
+  } catch (const std::exception& err) {
+    log(WARN) << "Failed to load TLS certificate for "
+              << (server_name ? server_name : "default host") << ": "
+              << err.what();
+    *alert = SSL_AD_INTERNAL_ERROR;
+    return SSL_TLSEXT_ERR_ALERT_FATAL;
+  }
+  return SSL_TLSEXT_ERR_OK;
+}
+
+int TLSContextImpl::_select_protocol(
+  SSL* ssl,
+  const std::uint8_t** out,
+  std::uint8_t* out_length,
+  const std::uint8_t* in,
+  unsigned int in_length,
+  void* arg
+) {
+  const std::string_view offered{reinterpret_cast<const char*>(in), in_length};
+  const std::string_view supported =
+    static_cast<TLSContextImpl*>(arg)->_alpn_protocols;
+
+  // The server's preference wins over the order the client offered them in.
+  for (std::size_t i = 0; i < supported.size();) {
+    const std::size_t length = static_cast<std::uint8_t>(supported[i]);
+    const std::string_view protocol = supported.substr(i, length + 1);
+    for (std::size_t j = 0; j < offered.size();) {
+      if (offered.substr(j, length + 1) == protocol) {
+        *out = in + j + 1;
+        *out_length = static_cast<std::uint8_t>(length);
+        return SSL_TLSEXT_ERR_OK;
+      }
+      j += static_cast<std::uint8_t>(offered[j]) + 1;
+    }
+    i += length + 1;
   }
+  return SSL_TLSEXT_ERR_NOACK;
+}
+
+TLSHandshakeStats TLSContextImpl::handshake_stats() const {
+  return {
+    .full = _handshakes.full.load(),
+    .resumed = _handshakes.resumed.load()
+  };
+}
+
+TLSContextImpl& TLSContextImpl::_from_ssl(SSL* ssl) {
+  return *static_cast<TLSContextImpl*>(
+    SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), context_ex_index())
+  );
+}
+
+int TLSContextImpl::_new_session(SSL* ssl, SSL_SESSION* session) {
+  _from_ssl(ssl)._session_cache->insert(session);
+
+  // The cache took its own reference to the session.
+  return 0;
+}
+
+SSL_SESSION* TLSContextImpl::_get_session(
+  SSL* ssl,
+  const std::uint8_t* id,
+  int id_length,
+  int* out_copy
+) {
+  // The returned reference is handed over to the SSL library.
+  *out_copy = 0;
+  return _from_ssl(ssl)._session_cache->find({
+    reinterpret_cast<const char*>(id),
+    static_cast<std::size_t>(id_length)
+  }).release();
+}
 
-  return std::unique_ptr<TLSContextImpl>{new TLSContextImpl{options, context}};
+void TLSContextImpl::_remove_session(SSL_CTX* context, SSL_SESSION* session) {
+  auto* self = static_cast<TLSContextImpl*>(
+    SSL_CTX_get_ex_data(context, context_ex_index())
+  );
+  unsigned int length = 0;
+  const std::uint8_t* id = SSL_SESSION_get_id(session, &length);
+  self->_session_cache->erase({reinterpret_cast<const char*>(id), length});
 }
 
-std::unique_ptr<TLSClientImpl> TLSContextImpl::make_client() {
-  BIO* encrypted = BIO_new(BIO_s_mem());
-  if (!encrypted) {
-    check_all_errors("Unknown error instantiating encrypted BIO.");
+int TLSContextImpl::_ticket_key(
+  SSL* ssl,
+  std::uint8_t* key_name,
+  std::uint8_t* iv,
+  EVP_CIPHER_CTX* cipher,
+  HMAC_CTX* hmac,
+  int encrypt
+) {
+  TLSTicketKeys& keys = *_from_ssl(ssl)._ticket_keys;
+  const EVP_CIPHER* cipher_type = EVP_aes_256_cbc();
+  const EVP_MD* digest = EVP_sha256();
+
+  if (encrypt) {
+    TLSTicketKey key = keys.encryption_key();
+    if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher_type)) != 1) return -1;
+    std::memcpy(key_name, key.name, TLSTicketKey::NAME_SIZE);
+    if (
+      !EVP_EncryptInit_ex(cipher, cipher_type, nullptr, key.aes_key, iv) ||
+      !HMAC_Init_ex(hmac, key.hmac_key, sizeof(key.hmac_key), digest, nullptr)
+    ) {
+      return -1;
+    }
+    return 1;
   }
-  BIO* plaintext = BIO_new(BIO_s_mem());
-  if (!plaintext) {
-    BIO_free(encrypted);
-    check_all_errors("Unknown error instantiating plaintext BIO.");
+
+  // Unknown or expired keys fall back to a full handshake.
+  std::optional<TLSTicketKeys::Lookup> lookup = keys.find(key_name);
+  if (!lookup) return 0;
+  const TLSTicketKey& key = lookup->key;
+  if (
+    !EVP_DecryptInit_ex(cipher, cipher_type, nullptr, key.aes_key, iv) ||
+    !HMAC_Init_ex(hmac, key.hmac_key, sizeof(key.hmac_key), digest, nullptr)
+  ) {
+    return -1;
   }
 
+  // Tickets from retired keys are accepted but replaced with a fresh one.
+  return lookup->current ? 1 : 2;
+}
+
+std::unique_ptr<TLSClientImpl> TLSContextImpl::make_client(
+  std::string_view server_name
+) {
   SSL* client = SSL_new(_context);
-  if (!client) {
-    BIO_free(encrypted);
-    BIO_free(plaintext);
-    check_all_errors("Unknown error creating SSL client.");
-  }
+  if (!client) check_all_errors("Unknown error creating SSL client.");
 
   if (_connection_mode == TLSOptions::ACCEPT) {
     SSL_set_accept_state(client);
   } else {
     SSL_set_connect_state(client);
+    if (
+      !server_name.empty() &&
+      !SSL_set_tlsext_host_name(client, std::string{server_name}.c_str())
+    ) {
+      SSL_free(client);
+      check_all_errors("Unknown error setting TLS server name.");
+    }
   }
-  SSL_set_bio(client, encrypted, plaintext);
-  return std::make_unique<TLSClientImpl>(client, encrypted, plaintext);
+  return std::make_unique<TLSClientImpl>(client, &_handshakes);
 }
 
 }
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "lw/net/internal/tls_certificates.h"
 #include "lw/net/internal/tls_client.h"
+#include "lw/net/internal/tls_session.h"
 #include "lw/net/tls_options.h"
 #include "openssl/base.h"
 
@@ -15,14 +20,84 @@ public:
   static std::unique_ptr<TLSContextImpl>
   from_options(const TLSOptions& options);
 
-  std::unique_ptr<TLSClientImpl> make_client();
+  /**
+   * @param server_name
+   *  The hostname to ask the server for with SNI when connecting. Ignored by
+   *  accepting contexts.
+   */
+  std::unique_ptr<TLSClientImpl> make_client(std::string_view server_name = {});
+
+  /**
+   * Counts of handshakes completed by clients made from this context.
+   */
+  TLSHandshakeStats handshake_stats() const;
+
+  /**
+   * The server-side session cache, or null if it is disabled.
+   */
+  const TLSSessionCache* session_cache() const { return _session_cache.get(); }
+
+  /**
+   * The per-hostname certificates, or null if there are none to pick from.
+   */
+  const TLSCertificateStore* certificates() const {
+    return _certificates.get();
+  }
 
 private:
   TLSContextImpl(const TLSOptions& options, SSL_CTX* context)
-      : _connection_mode{options.connection_mode}, _context{context} {}
+      : _connection_mode{options.connection_mode},
+        _max_version{options.max_version},
+        _kernel_tls{options.kernel_tls},
+        _context{context} {}
+
+  static TLSContextImpl& _from_ssl(SSL* ssl);
+  static int _new_session(SSL* ssl, SSL_SESSION* session);
+  static SSL_SESSION* _get_session(
+      SSL* ssl,
+      const std::uint8_t* id,
+      int id_length,
+      int* out_copy);
+  static void _remove_session(SSL_CTX* context, SSL_SESSION* session);
+  static int _ticket_key(
+      SSL* ssl,
+      std::uint8_t* key_name,
+      std::uint8_t* iv,
+      EVP_CIPHER_CTX* cipher,
+      HMAC_CTX* hmac,
+      int encrypt);
+
+  static int _select_certificate(SSL* ssl, int* alert, void* arg);
+  static int _select_protocol(
+      SSL* ssl,
+      const std::uint8_t** out,
+      std::uint8_t* out_length,
+      const std::uint8_t* in,
+      unsigned int in_length,
+      void* arg);
+
+  void _configure_session_resumption(
+      const TLSSessionResumptionOptions& options);
+  void _configure_certificates(const TLSOptions& options);
+  void _configure_alpn(const std::vector<std::string>& protocols);
+
+  /**
+   * Creates the context presenting one of the per-hostname certificates, which
+   * handshakes switch to once the client's SNI hostname is known.
+   */
+  TLSCertificateStore::Context _new_host_context(
+      const TLSCertificate& certificate);
 
   TLSOptions::ConnectionMode _connection_mode;
+  TLSOptions::Version _max_version;
+  bool _kernel_tls = false;
   SSL_CTX* _context = nullptr;
+  // ALPN protocols in wire format, each prefixed by its length.
+  std::string _alpn_protocols;
+  TLSHandshakeCounters _handshakes;
+  std::unique_ptr<TLSSessionCache> _session_cache;
+  std::unique_ptr<TLSTicketKeys> _ticket_keys;
+  std::unique_ptr<TLSCertificateStore> _certificates;
 };
 
 } // namespace lw::net::internal
@@ -1,14 +1,60 @@
 #include "lw/net/internal/tls_context.h"
 
+#include <chrono>
+#include <filesystem>
 #include <memory>
+#include <string>
+#include <string_view>
 
 #include "gtest/gtest.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/internal/tls_client.h"
 #include "lw/net/tls_options.h"
 #include "lw/net/testing/tls_credentials.h"
 
 namespace lw::net::internal {
 namespace {
 
+void transfer(TLSClientImpl& from, TLSClientImpl& to) {
+  Buffer buffer{16 * 1024};
+  while (TLSIOResult res = from.read_encrypted_data(buffer)) {
+    if (res.bytes == 0) break;
+    to.buffer_encrypted_data({buffer.data(), res.bytes});
+  }
+}
+
+/**
+ * Completes a handshake asking the server for `server_name` and returns the
+ * subject of the certificate the server presented.
+ */
+std::string presented_subject(
+  TLSContextImpl& server_context,
+  std::string_view server_name
+) {
+  std::unique_ptr<TLSContextImpl> client_context =
+    TLSContextImpl::from_options({
+      .private_key = {testing::KEY_PATH},
+      .certificate = {testing::CERT_PATH},
+      .connection_mode = TLSOptions::CONNECT
+    });
+  std::unique_ptr<TLSClientImpl> client =
+    client_context->make_client(server_name);
+  std::unique_ptr<TLSClientImpl> server = server_context.make_client();
+
+  TLSResult client_state = TLSResult::AGAIN;
+  TLSResult server_state = TLSResult::AGAIN;
+  while (
+    client_state != TLSResult::COMPLETED ||
+    server_state != TLSResult::COMPLETED
+  ) {
+    client_state = client->handshake();
+    transfer(*client, *server);
+    server_state = server->handshake();
+    transfer(*server, *client);
+  }
+  return client->peer_subject();
+}
+
 TEST(TLSContextImpl, MakesClients) {
   std::unique_ptr<TLSContextImpl> context = TLSContextImpl::from_options({
     .private_key = {testing::KEY_PATH},
@@ -20,5 +66,62 @@ TEST(TLSContextImpl, MakesClients) {
   EXPECT_NE(client, nullptr);
 }
 
+TEST(TLSContextImpl, SelectsCertificateByServerName) {
+  std::unique_ptr<TLSContextImpl> context = TLSContextImpl::from_options({
+    .private_key = {testing::KEY_PATH},
+    .certificate = {testing::CERT_PATH},
+    .certificates = {{
+      "*.example.com",
+      {
+        .private_key = std::filesystem::path{testing::OTHER_KEY_PATH},
+        .certificate = std::filesystem::path{testing::OTHER_CERT_PATH}
+      }
+    }},
+    .connection_mode = TLSOptions::ACCEPT
+  });
+  ASSERT_NE(context->certificates(), nullptr);
+  EXPECT_EQ(context->certificates()->loaded(), 0u);
+
+  EXPECT_NE(
+    presented_subject(*context, "other.example.com").find(
+      "CN=other.example.com"
+    ),
+    std::string::npos
+  );
+  EXPECT_EQ(context->certificates()->loaded(), 1u);
+  EXPECT_NE(
+    presented_subject(*context, "unknown.test").find("CN=Tests"),
+    std::string::npos
+  );
+  EXPECT_NE(
+    presented_subject(*context, "").find("CN=Tests"),
+    std::string::npos
+  );
+}
+
+TEST(TLSContextImpl, NoCertificateStoreWithOneCertificate) {
+  std::unique_ptr<TLSContextImpl> context = TLSContextImpl::from_options({
+    .private_key = {testing::KEY_PATH},
+    .certificate = {testing::CERT_PATH},
+    .connection_mode = TLSOptions::ACCEPT
+  });
+  EXPECT_EQ(context->certificates(), nullptr);
+}
+
+TEST(TLSContextImpl, ReloadsDefaultCertificate) {
+  std::unique_ptr<TLSContextImpl> context = TLSContextImpl::from_options({
+    .private_key = {testing::KEY_PATH},
+    .certificate = {testing::CERT_PATH},
+    .certificate_reload_interval = std::chrono::seconds{60},
+    .connection_mode = TLSOptions::ACCEPT
+  });
+  ASSERT_NE(context->certificates(), nullptr);
+  EXPECT_NE(
+    presented_subject(*context, "").find("CN=Tests"),
+    std::string::npos
+  );
+  EXPECT_EQ(context->certificates()->loaded(), 1u);
+}
+
 }
 }
@@ -0,0 +1,174 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "benchmark/benchmark.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/internal/tls_client.h"
+#include "lw/net/internal/tls_context.h"
+#include "lw/net/testing/tls_credentials.h"
+#include "lw/net/tls_options.h"
+
+namespace lw::net::internal {
+namespace {
+
+void transfer(TLSClientImpl& from, TLSClientImpl& to) {
+  Buffer buffer{16 * 1024};
+  while (TLSIOResult res = from.read_encrypted_data(buffer)) {
+    if (res.bytes == 0) break;
+    to.buffer_encrypted_data({buffer.data(), res.bytes});
+  }
+}
+
+/**
+ * Performs a complete in-memory handshake between a new client and server,
+ * returning the client's session for later resumption.
+ */
+TLSSession handshake(
+  TLSContextImpl& client_context,
+  TLSContextImpl& server_context,
+  const TLSSession& session,
+  std::string_view server_name = {}
+) {
+  std::unique_ptr<TLSClientImpl> client =
+    client_context.make_client(server_name);
+  std::unique_ptr<TLSClientImpl> server = server_context.make_client();
+  if (session) client->resume_session(session);
+
+  TLSResult client_state = TLSResult::AGAIN;
+  TLSResult server_state = TLSResult::AGAIN;
+  while (
+    client_state != TLSResult::COMPLETED ||
+    server_state != TLSResult::COMPLETED
+  ) {
+    client_state = client->handshake();
+    transfer(*client, *server);
+    server_state = server->handshake();
+    transfer(*server, *client);
+  }
+
+  Buffer buffer{1024};
+  client->read_decrypted_data(buffer);
+  return client->session();
+}
+
+std::unique_ptr<TLSContextImpl> make_context(
+  TLSOptions::ConnectionMode mode,
+  TLSSessionResumptionOptions resumption,
+  TLSOptions::Version max_version
+) {
+  return TLSContextImpl::from_options({
+    .private_key = {testing::KEY_PATH},
+    .certificate = {testing::CERT_PATH},
+    .connection_mode = mode,
+    .max_version = max_version,
+    .session_resumption = resumption
+  });
+}
+
+/**
+ * Handshakes per second with the given resumption mechanism. The first
+ * handshake is always a full one, every following client resumes the session
+ * of the previous one when `resume` is set.
+ */
+void run_handshakes(
+  benchmark::State& state,
+  TLSSessionResumptionOptions resumption,
+  TLSOptions::Version max_version,
+  bool resume
+) {
+  auto client_context = make_context(TLSOptions::CONNECT, {}, max_version);
+  auto server_context =
+    make_context(TLSOptions::ACCEPT, resumption, max_version);
+
+  TLSSession session;
+  for (auto _ : state) {
+    TLSSession next = handshake(*client_context, *server_context, session);
+    if (resume) session = std::move(next);
+  }
+
+  TLSHandshakeStats stats = server_context->handshake_stats();
+  state.counters["resumed_ratio"] =
+    static_cast<double>(stats.resumed) / state.iterations();
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_FullHandshake(benchmark::State& state) {
+  run_handshakes(state, {}, TLSOptions::TLS_1_3, /*resume=*/false);
+}
+BENCHMARK(BM_FullHandshake);
+
+void BM_ResumeFromTicket(benchmark::State& state) {
+  run_handshakes(
+    state,
+    {.session_cache = false},
+    TLSOptions::TLS_1_3,
+    /*resume=*/true
+  );
+}
+BENCHMARK(BM_ResumeFromTicket);
+
+void BM_ResumeFromSessionCache(benchmark::State& state) {
+  run_handshakes(
+    state,
+    {.session_tickets = false},
+    TLSOptions::TLS_1_2,
+    /*resume=*/true
+  );
+}
+BENCHMARK(BM_ResumeFromSessionCache);
+
+std::string read_file(const std::filesystem::path& path) {
+  std::ifstream file{path};
+  return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+/**
+ * Full handshakes against a server with a certificate for each of
+ * `state.range(0)` hostnames, held in memory, with clients asking for each
+ * hostname in turn. Certificates are loaded as hostnames are first asked for,
+ * so the first pass over the hostnames includes loading them.
+ */
+void BM_SniHandshake(benchmark::State& state) {
+  const int hostnames = static_cast<int>(state.range(0));
+  const TLSCertificate certificate{
+    .private_key = TLSPem{read_file(testing::OTHER_KEY_PATH)},
+    .certificate = TLSPem{read_file(testing::OTHER_CERT_PATH)}
+  };
+  std::map<std::string, TLSCertificate> certificates;
+  for (int i = 0; i < hostnames; ++i) {
+    certificates.insert({
+      "host" + std::to_string(i) + ".example.com",
+      certificate
+    });
+  }
+
+  auto client_context =
+    make_context(TLSOptions::CONNECT, {}, TLSOptions::TLS_1_3);
+  auto server_context = TLSContextImpl::from_options({
+    .private_key = {testing::KEY_PATH},
+    .certificate = {testing::CERT_PATH},
+    .certificates = std::move(certificates),
+    .connection_mode = TLSOptions::ACCEPT
+  });
+
+  int next = 0;
+  std::string server_name;
+  for (auto _ : state) {
+    server_name = "host" + std::to_string(next) + ".example.com";
+    next = (next + 1) % hostnames;
+    handshake(*client_context, *server_context, nullptr, server_name);
+  }
+
+  state.counters["certificates_loaded"] =
+    static_cast<double>(server_context->certificates()->loaded());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SniHandshake)->Arg(1)->Arg(1'000);
+
+}
+}
@@ -0,0 +1,199 @@
+#include "lw/net/internal/tls_session.h"
+
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+#include "lw/err/canonical.h"
+#include "lw/net/internal/errors.h"
+#include "openssl/rand.h"
+#include "openssl/ssl.h"
+
+namespace lw::net::internal {
+namespace {
+
+std::string_view session_id(const SSL_SESSION* session) {
+  unsigned int length = 0;
+  const std::uint8_t* id = SSL_SESSION_get_id(session, &length);
+  return {reinterpret_cast<const char*>(id), length};
+}
+
+TLSTicketKey generate_ticket_key() {
+  TLSTicketKey key;
+  if (
+    RAND_bytes(key.name, sizeof(key.name)) != 1 ||
+    RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) != 1 ||
+    RAND_bytes(key.aes_key, sizeof(key.aes_key)) != 1
+  ) {
+    check_all_errors("Unknown error generating session ticket key.");
+  }
+  return key;
+}
+
+}
+
+void SSLSessionDeleter::operator()(SSL_SESSION* session) const {
+  SSL_SESSION_free(session);
+}
+
+// -------------------------------------------------------------------------- //
+
+TLSSessionCache::TLSSessionCache(
+  std::size_t max_sessions,
+  std::size_t shard_count,
+  std::chrono::seconds lifetime
+):
+  _lifetime{lifetime}
+{
+  if (shard_count == 0) {
+    throw InvalidArgument() << "TLSSessionCache requires at least one shard.";
+  }
+  _shard_capacity = max_sessions / shard_count;
+  if (_shard_capacity == 0) {
+    throw InvalidArgument()
+      << "TLSSessionCache of " << max_sessions << " sessions is too small for "
+      << shard_count << " shards.";
+  }
+  _shards.reserve(shard_count);
+  for (std::size_t i = 0; i < shard_count; ++i) {
+    _shards.push_back(std::make_unique<Shard>());
+  }
+}
+
+void TLSSessionCache::insert(SSL_SESSION* session) {
+  SSL_SESSION_up_ref(session);
+  UniqueSSLSession reference{session};
+  std::string id{session_id(session)};
+
+  Shard& shard = _shard_for(id);
+  std::lock_guard<std::mutex> lock{shard.mutex};
+
+  if (auto itr = shard.index.find(id); itr != shard.index.end()) {
+    _erase(shard, itr->second);
+  }
+  while (shard.lru.size() >= _shard_capacity) {
+    _erase(shard, std::prev(shard.lru.end()));
+    ++_evictions;
+  }
+
+  shard.lru.push_front({
+    .id = std::move(id),
+    .session = std::move(reference),
+    .expires = Clock::now() + _lifetime
+  });
+  shard.index.insert({shard.lru.front().id, shard.lru.begin()});
+}
+
+UniqueSSLSession TLSSessionCache::find(std::string_view id) {
+  Shard& shard = _shard_for(id);
+  std::lock_guard<std::mutex> lock{shard.mutex};
+
+  auto itr = shard.index.find(id);
+  if (itr == shard.index.end()) {
+    ++_misses;
+    return nullptr;
+  }
+  if (itr->second->expires <= Clock::now()) {
+    _erase(shard, itr->second);
+    ++_misses;
+    return nullptr;
+  }
+
+  shard.lru.splice(shard.lru.begin(), shard.lru, itr->second);
+  ++_hits;
+  SSL_SESSION* session = itr->second->session.get();
+  SSL_SESSION_up_ref(session);
+  return UniqueSSLSession{session};
+}
+
+void TLSSessionCache::erase(std::string_view id) {
+  Shard& shard = _shard_for(id);
+  std::lock_guard<std::mutex> lock{shard.mutex};
+  if (auto itr = shard.index.find(id); itr != shard.index.end()) {
+    _erase(shard, itr->second);
+  }
+}
+
+TLSSessionCacheStats TLSSessionCache::stats() const {
+  return {
+    .hits = _hits.load(),
+    .misses = _misses.load(),
+    .evictions = _evictions.load()
+  };
+}
+
+std::size_t TLSSessionCache::size() const {
+  std::size_t total = 0;
+  for (const auto& shard : _shards) {
+    std::lock_guard<std::mutex> lock{shard->mutex};
+    total += shard->lru.size();
+  }
+  return total;
+}
+
+TLSSessionCache::Shard& TLSSessionCache::_shard_for(std::string_view id) {
+  return *_shards[std::hash<std::string_view>{}(id) % _shards.size()];
+}
+
+void TLSSessionCache::_erase(Shard& shard, std::list<Entry>::iterator itr) {
+  shard.index.erase(itr->id);
+  shard.lru.erase(itr);
+}
+
+// -------------------------------------------------------------------------- //
+
+TLSTicketKeys::TLSTicketKeys(
+  std::chrono::seconds rotation_interval,
+  std::chrono::seconds ticket_lifetime
+):
+  _rotation_interval{rotation_interval},
+  _ticket_lifetime{ticket_lifetime}
+{
+  if (rotation_interval.count() <= 0) {
+    throw InvalidArgument() << "Ticket key rotation interval must be positive.";
+  }
+  _keys.push_front({.key = generate_ticket_key(), .created = Clock::now()});
+}
+
+TLSTicketKey TLSTicketKeys::encryption_key() {
+  std::lock_guard<std::mutex> lock{_mutex};
+  _rotate_if_due(Clock::now());
+  return _keys.front().key;
+}
+
+std::optional<TLSTicketKeys::Lookup> TLSTicketKeys::find(
+  const std::uint8_t* name
+) {
+  std::lock_guard<std::mutex> lock{_mutex};
+  _rotate_if_due(Clock::now());
+  for (const DatedKey& dated_key : _keys) {
+    if (std::memcmp(dated_key.key.name, name, TLSTicketKey::NAME_SIZE) == 0) {
+      return Lookup{
+        .key = dated_key.key,
+        .current = &dated_key == &_keys.front()
+      };
+    }
+  }
+  return std::nullopt;
+}
+
+void TLSTicketKeys::_rotate_if_due(Clock::time_point now) {
+  if (now - _keys.front().created >= _rotation_interval) {
+    _keys.push_front({.key = generate_ticket_key(), .created = now});
+  }
+
+  // A key stops issuing tickets when the next one is created, so the last
+  // ticket it issued expires one ticket lifetime after that.
+  while (
+    _keys.size() > 1 &&
+    now - _keys[_keys.size() - 2].created >= _ticket_lifetime
+  ) {
+    _keys.pop_back();
+  }
+}
+
+}
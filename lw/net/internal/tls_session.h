@@ -0,0 +1,175 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "openssl/base.h"
+
+namespace lw::net::internal {
+
+struct SSLSessionDeleter {
+  void operator()(SSL_SESSION* session) const;
+};
+
+/**
+ * An owned reference to an `SSL_SESSION`.
+ */
+typedef std::unique_ptr<SSL_SESSION, SSLSessionDeleter> UniqueSSLSession;
+
+/**
+ * Counters tracking the effectiveness of a `TLSSessionCache`.
+ */
+struct TLSSessionCacheStats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+};
+
+/**
+ * Bounded, server-side store of established TLS sessions keyed by session ID.
+ *
+ * Entries are spread across independently locked shards so that handshakes on
+ * different threads rarely contend. Each shard holds an equal share of the
+ * session budget, evicting its least recently used sessions once full, and
+ * sessions are dropped once their lifetime has passed.
+ */
+class TLSSessionCache {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  TLSSessionCache(
+    std::size_t max_sessions,
+    std::size_t shard_count,
+    std::chrono::seconds lifetime
+  );
+
+  TLSSessionCache(const TLSSessionCache&) = delete;
+  TLSSessionCache& operator=(const TLSSessionCache&) = delete;
+
+  /**
+   * Stores a new reference to the session, replacing any session with the same
+   * ID.
+   */
+  void insert(SSL_SESSION* session);
+
+  /**
+   * Looks up a live session by ID.
+   *
+   * @return
+   *  A new reference to the session, or null if there is none.
+   */
+  UniqueSSLSession find(std::string_view id);
+
+  /**
+   * Forgets the session with the given ID, if there is one.
+   */
+  void erase(std::string_view id);
+
+  TLSSessionCacheStats stats() const;
+
+  /**
+   * The number of sessions currently held.
+   */
+  std::size_t size() const;
+
+private:
+  struct Entry {
+    std::string id;
+    UniqueSSLSession session;
+    Clock::time_point expires;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::list<Entry> lru;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+  };
+
+  Shard& _shard_for(std::string_view id);
+  void _erase(Shard& shard, std::list<Entry>::iterator itr);
+
+  std::size_t _shard_capacity;
+  std::chrono::seconds _lifetime;
+  std::vector<std::unique_ptr<Shard>> _shards;
+  std::atomic<std::uint64_t> _hits = 0;
+  std::atomic<std::uint64_t> _misses = 0;
+  std::atomic<std::uint64_t> _evictions = 0;
+};
+
+// -------------------------------------------------------------------------- //
+
+struct TLSTicketKey {
+  static constexpr std::size_t NAME_SIZE = 16;
+  static constexpr std::size_t SECRET_SIZE = 32;
+
+  std::uint8_t name[NAME_SIZE];
+  std::uint8_t hmac_key[SECRET_SIZE];
+  std::uint8_t aes_key[SECRET_SIZE];
+};
+
+/**
+ * The keys used to encrypt and authenticate session tickets.
+ *
+ * New tickets are always issued with the newest key, which is replaced every
+ * rotation interval. Retired keys are kept long enough to decrypt every ticket
+ * they issued which has not yet expired.
+ */
+class TLSTicketKeys {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Lookup {
+    TLSTicketKey key;
+
+    /**
+     * False if the key has been retired, in which case the ticket should be
+     * replaced with one using the current key.
+     */
+    bool current;
+  };
+
+  TLSTicketKeys(
+    std::chrono::seconds rotation_interval,
+    std::chrono::seconds ticket_lifetime
+  );
+
+  /**
+   * The key to issue new tickets with, rotating first if it is due.
+   */
+  TLSTicketKey encryption_key();
+
+  /**
+   * Finds the key a ticket was issued with by name.
+   *
+   * @return
+   *  The key, or nothing if the name is unknown or the key has expired.
+   */
+  std::optional<Lookup> find(const std::uint8_t* name);
+
+private:
+  struct DatedKey {
+    TLSTicketKey key;
+    Clock::time_point created;
+  };
+
+  void _rotate_if_due(Clock::time_point now);
+
+  std::chrono::seconds _rotation_interval;
+  std::chrono::seconds _ticket_lifetime;
+  std::mutex _mutex;
+
+  // Newest key at the front.
+  std::deque<DatedKey> _keys;
+};
+
+}
@@ -0,0 +1,238 @@
+#include "lw/net/internal/tls_session.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "gtest/gtest.h"
+#include "lw/err/canonical.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/internal/tls_client.h"
+#include "lw/net/internal/tls_context.h"
+#include "lw/net/testing/tls_credentials.h"
+#include "lw/net/tls_options.h"
+#include "openssl/ssl.h"
+
+namespace lw::net::internal {
+namespace {
+
+using ::std::chrono::seconds;
+
+void transfer(TLSClientImpl& from, TLSClientImpl& to) {
+  Buffer buffer{16 * 1024};
+  while (TLSIOResult res = from.read_encrypted_data(buffer)) {
+    if (res.bytes == 0) break;
+    to.buffer_encrypted_data({buffer.data(), res.bytes});
+  }
+}
+
+/**
+ * Connects a new client to a new server, optionally offering a session to
+ * resume, and returns the client once the handshake is done.
+ */
+std::unique_ptr<TLSClientImpl> connect(
+  TLSContextImpl& client_context,
+  TLSContextImpl& server_context,
+  const TLSSession& session = nullptr
+) {
+  std::unique_ptr<TLSClientImpl> client = client_context.make_client();
+  std::unique_ptr<TLSClientImpl> server = server_context.make_client();
+  if (session) client->resume_session(session);
+
+  TLSResult client_state = TLSResult::AGAIN;
+  TLSResult server_state = TLSResult::AGAIN;
+  while (
+    client_state != TLSResult::COMPLETED ||
+    server_state != TLSResult::COMPLETED
+  ) {
+    client_state = client->handshake();
+    transfer(*client, *server);
+    server_state = server->handshake();
+    transfer(*server, *client);
+  }
+
+  // Let the client take in any session tickets sent after the handshake.
+  Buffer buffer{1024};
+  client->read_decrypted_data(buffer);
+  return client;
+}
+
+std::unique_ptr<TLSContextImpl> make_context(
+  TLSOptions::ConnectionMode mode,
+  TLSSessionResumptionOptions resumption = {},
+  TLSOptions::Version max_version = TLSOptions::TLS_1_3
+) {
+  return TLSContextImpl::from_options({
+    .private_key = {testing::KEY_PATH},
+    .certificate = {testing::CERT_PATH},
+    .connection_mode = mode,
+    .max_version = max_version,
+    .session_resumption = resumption
+  });
+}
+
+TEST(TLSSessionResumption, ResumesFromTickets) {
+  auto client_context = make_context(TLSOptions::CONNECT);
+  auto server_context = make_context(
+    TLSOptions::ACCEPT,
+    {.session_cache = false}
+  );
+
+  auto first = connect(*client_context, *server_context);
+  EXPECT_FALSE(first->session_reused());
+  auto second = connect(*client_context, *server_context, first->session());
+  EXPECT_TRUE(second->session_reused());
+
+  TLSHandshakeStats stats = server_context->handshake_stats();
+  EXPECT_EQ(stats.full, 1);
+  EXPECT_EQ(stats.resumed, 1);
+  EXPECT_EQ(server_context->session_cache(), nullptr);
+}
+
+TEST(TLSSessionResumption, ResumesFromSessionCache) {
+  // Session IDs are only used for resumption before TLS 1.3.
+  auto client_context = make_context(
+    TLSOptions::CONNECT,
+    {},
+    TLSOptions::TLS_1_2
+  );
+  auto server_context = make_context(
+    TLSOptions::ACCEPT,
+    {.session_tickets = false}
+  );
+
+  auto first = connect(*client_context, *server_context);
+  auto second = connect(*client_context, *server_context, first->session());
+  EXPECT_TRUE(second->session_reused());
+
+  TLSHandshakeStats stats = server_context->handshake_stats();
+  EXPECT_EQ(stats.full, 1);
+  EXPECT_EQ(stats.resumed, 1);
+  ASSERT_NE(server_context->session_cache(), nullptr);
+  EXPECT_EQ(server_context->session_cache()->size(), 1);
+  EXPECT_EQ(server_context->session_cache()->stats().hits, 1);
+}
+
+TEST(TLSSessionResumption, FullHandshakeWhenDisabled) {
+  auto client_context = make_context(TLSOptions::CONNECT);
+  auto server_context = make_context(
+    TLSOptions::ACCEPT,
+    {.session_cache = false, .session_tickets = false}
+  );
+
+  auto first = connect(*client_context, *server_context);
+  auto second = connect(*client_context, *server_context, first->session());
+  EXPECT_FALSE(second->session_reused());
+
+  TLSHandshakeStats stats = server_context->handshake_stats();
+  EXPECT_EQ(stats.full, 2);
+  EXPECT_EQ(stats.resumed, 0);
+}
+
+// -------------------------------------------------------------------------- //
+
+class TLSSessionCacheTest: public ::testing::Test {
+protected:
+  TLSSessionCacheTest():
+    _client_context{
+      make_context(TLSOptions::CONNECT, {}, TLSOptions::TLS_1_2)
+    },
+    _server_context{make_context(TLSOptions::ACCEPT)}
+  {}
+
+  TLSSession new_session() {
+    return connect(*_client_context, *_server_context)->session();
+  }
+
+  std::string_view id(const TLSSession& session) {
+    unsigned int length = 0;
+    const std::uint8_t* id = SSL_SESSION_get_id(session.get(), &length);
+    return {reinterpret_cast<const char*>(id), length};
+  }
+
+  std::unique_ptr<TLSContextImpl> _client_context;
+  std::unique_ptr<TLSContextImpl> _server_context;
+};
+
+TEST_F(TLSSessionCacheTest, FindsInsertedSessions) {
+  TLSSessionCache cache{10, 2, seconds(60)};
+  TLSSession session = new_session();
+  cache.insert(session.get());
+
+  UniqueSSLSession found = cache.find(id(session));
+  EXPECT_EQ(found.get(), session.get());
+  EXPECT_EQ(cache.find("unknown"), nullptr);
+  EXPECT_EQ(cache.stats().hits, 1);
+  EXPECT_EQ(cache.stats().misses, 1);
+}
+
+TEST_F(TLSSessionCacheTest, EvictsLeastRecentlyUsed) {
+  TLSSessionCache cache{2, 1, seconds(60)};
+  TLSSession first = new_session();
+  TLSSession second = new_session();
+  TLSSession third = new_session();
+  cache.insert(first.get());
+  cache.insert(second.get());
+  EXPECT_NE(cache.find(id(first)), nullptr);
+  cache.insert(third.get());
+
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.stats().evictions, 1);
+  EXPECT_NE(cache.find(id(first)), nullptr);
+  EXPECT_EQ(cache.find(id(second)), nullptr);
+  EXPECT_NE(cache.find(id(third)), nullptr);
+}
+
+TEST_F(TLSSessionCacheTest, ExpiresSessions) {
+  TLSSessionCache cache{10, 1, seconds(0)};
+  TLSSession session = new_session();
+  cache.insert(session.get());
+  EXPECT_EQ(cache.find(id(session)), nullptr);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(TLSSessionCacheTest, Erases) {
+  TLSSessionCache cache{10, 1, seconds(60)};
+  TLSSession session = new_session();
+  cache.insert(session.get());
+  cache.erase(id(session));
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(TLSSessionCache, RejectsTooManyShards) {
+  EXPECT_THROW((TLSSessionCache{2, 4, seconds(60)}), InvalidArgument);
+}
+
+// -------------------------------------------------------------------------- //
+
+TEST(TLSTicketKeys, FindsCurrentKey) {
+  TLSTicketKeys keys{seconds(60), seconds(60)};
+  TLSTicketKey key = keys.encryption_key();
+  auto lookup = keys.find(key.name);
+  ASSERT_TRUE(lookup.has_value());
+  EXPECT_TRUE(lookup->current);
+  EXPECT_EQ(
+    std::string_view(
+      reinterpret_cast<const char*>(lookup->key.aes_key),
+      TLSTicketKey::SECRET_SIZE
+    ),
+    std::string_view(
+      reinterpret_cast<const char*>(key.aes_key),
+      TLSTicketKey::SECRET_SIZE
+    )
+  );
+}
+
+TEST(TLSTicketKeys, UnknownKeysAreNotFound) {
+  TLSTicketKeys keys{seconds(60), seconds(60)};
+  const std::uint8_t name[TLSTicketKey::NAME_SIZE] = {0};
+  EXPECT_FALSE(keys.find(name).has_value());
+}
+
+TEST(TLSTicketKeys, RejectsNonPositiveRotation) {
+  EXPECT_THROW((TLSTicketKeys{seconds(0), seconds(60)}), InvalidArgument);
+}
+
+}
+}
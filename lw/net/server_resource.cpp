@@ -1,43 +1,500 @@
 #include "lw/net/server_resource.h"
 
+#include <coroutine>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string_view>
 #include <typeindex>
 #include <typeinfo>
 #include <unordered_map>
-#include <variant>
+#include <utility>
+#include <vector>
 
 #include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/single_flight.h"
 #include "lw/err/canonical.h"
 
 namespace lw {
+namespace internal {
+
+/**
+ * A bounded set of resource instances which are lent out to one request at a
+ * time. Shared by all threads.
+ */
+class ResourcePool {
+public:
+  ResourcePool(ServerResourceFactoryBase& factory, std::size_t max_size):
+    _factory{factory},
+    _max_size{max_size}
+  {}
+
+  /**
+   * Takes an idle member of the pool, constructing a new one if none are idle
+   * and the pool is not full, or waiting for one to be released otherwise.
+   */
+  co::Future<ServerResourceBase*> checkout();
+
+  /**
+   * Returns a member of the pool, handing it directly to the longest waiting
+   * checkout if there is one.
+   */
+  void release(ServerResourceBase* resource);
+
+private:
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    co::Scheduler* scheduler = nullptr;
+    ServerResourceBase* resource = nullptr;
+  };
+
+  class ReleaseAwaitable {
+  public:
+    explicit ReleaseAwaitable(ResourcePool& pool): _pool{pool} {}
+
+    bool await_ready() const { return false; }
+    bool await_suspend(std::coroutine_handle<> handle);
+    ServerResourceBase* await_resume() const { return _waiter.resource; }
+
+  private:
+    ResourcePool& _pool;
+    Waiter _waiter;
+  };
+
+  ServerResourceBase* _take_idle() {
+    if (_idle.empty()) return nullptr;
+    ServerResourceBase* resource = _idle.back();
+    _idle.pop_back();
+    return resource;
+  }
+
+  void _wake_one(ServerResourceBase* resource);
+
+  ServerResourceFactoryBase& _factory;
+  const std::size_t _max_size;
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<ServerResourceBase>> _members;
+  std::vector<ServerResourceBase*> _idle;
+  std::size_t _reserved = 0;
+  std::deque<Waiter*> _waiters;
+};
+
+}
+
 namespace {
 
-std::unordered_map<std::type_index, std::unique_ptr<ServerResourceFactoryBase>>&
-get_server_resources() {
-  static auto* resource_map = new std::unordered_map<
-      std::type_index,
-      std::unique_ptr<ServerResourceFactoryBase>>{};
-  return *resource_map;
+using ::lw::internal::ResourcePool;
+
+struct ResourceRegistration {
+  const std::type_info* info = nullptr;
+  std::unique_ptr<ServerResourceFactoryBase> factory;
+  ResourceOptions options;
+  std::unique_ptr<ResourcePool> pool;
+};
+
+struct ResourceRegistry {
+  std::mutex mutex;
+  std::unordered_map<std::type_index, std::size_t> indices;
+  std::vector<ResourceRegistration> registrations;
+
+  std::size_t index_of(const std::type_info& resource_info) {
+    auto [itr, inserted] = indices.try_emplace(
+      std::type_index{resource_info},
+      registrations.size()
+    );
+    if (inserted) registrations.push_back({.info = &resource_info});
+    return itr->second;
+  }
+};
+
+ResourceRegistry& get_registry() {
+  static auto* registry = new ResourceRegistry{};
+  return *registry;
+}
+
+/**
+ * Registrations are only added during static initialization or application
+ * setup, so lookups while serving are not locked.
+ */
+const ResourceRegistration& get_registration(std::size_t index) {
+  const auto& registrations = get_registry().registrations;
+  if (index >= registrations.size()) {
+    throw NotFound() << "Server resource index " << index << " is unknown.";
+  }
+  if (!registrations[index].factory) {
+    throw NotFound()
+      << "Server resource " << registrations[index].info->name()
+      << " has no factory registered.";
+  }
+  return registrations[index];
+}
+
+/**
+ * Returns the registration for the index, or null if it has no factory.
+ */
+const ResourceRegistration* find_registration(std::size_t index) {
+  const auto& registrations = get_registry().registrations;
+  if (index >= registrations.size() || !registrations[index].factory) {
+    return nullptr;
+  }
+  return &registrations[index];
+}
+
+std::string_view scope_name(ResourceScope scope) {
+  switch (scope) {
+    case ResourceScope::REQUEST: return "REQUEST";
+    case ResourceScope::THREAD: return "THREAD";
+    case ResourceScope::PROCESS: return "PROCESS";
+    case ResourceScope::POOLED: return "POOLED";
+  }
+  return "UNKNOWN";
+}
+
+/**
+ * Returns true if resources in the `dependency` scope are guaranteed to live
+ * at least as long as, and be usable from the same threads as, resources in
+ * the `dependent` scope.
+ */
+bool can_depend_on(ResourceScope dependent, ResourceScope dependency) {
+  switch (dependent) {
+    case ResourceScope::REQUEST:
+      return true;
+    case ResourceScope::THREAD:
+      return (
+        dependency == ResourceScope::THREAD ||
+        dependency == ResourceScope::PROCESS
+      );
+    case ResourceScope::PROCESS:
+    case ResourceScope::POOLED:
+      return dependency == ResourceScope::PROCESS;
+  }
+  return false;
+}
+
+/**
+ * Deduplicates construction of process resources requested by several threads
+ * at once.
+ */
+co::SingleFlight<std::size_t, ServerResourceBase*, std::mutex>&
+process_constructions() {
+  static auto* constructions =
+    new co::SingleFlight<std::size_t, ServerResourceBase*, std::mutex>{};
+  return *constructions;
 }
 
 } // namespace
 
+// -------------------------------------------------------------------------- //
+
+namespace internal {
+
+std::size_t resource_index(const std::type_info& resource_info) {
+  ResourceRegistry& registry = get_registry();
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  return registry.index_of(resource_info);
+}
+
+std::size_t resource_count() {
+  ResourceRegistry& registry = get_registry();
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  return registry.registrations.size();
+}
+
+ResourceGraph::ResourceGraph(std::vector<ResourceGraphNode> nodes) {
+  if (nodes.empty()) return;
+  const std::size_t root = nodes.size() - 1;
+  auto position_of = [&](std::size_t index) {
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      if (nodes[i].index == index) return i;
+    }
+    return nodes.size();
+  };
+
+  for (ResourceScope scope : {
+    ResourceScope::REQUEST,
+    ResourceScope::THREAD,
+    ResourceScope::PROCESS,
+    ResourceScope::POOLED
+  }) {
+    // Walk from the root back towards the leaves, only descending into the
+    // dependencies of resources which would be constructed in this context.
+    std::vector<bool> needed(nodes.size(), false);
+    std::vector<bool> direct(nodes.size(), false);
+    needed[root] = true;
+    for (std::size_t i = root + 1; i-- > 0;) {
+      if (!needed[i]) continue;
+      const ResourceRegistration* registration =
+        find_registration(nodes[i].index);
+      const bool constructed_here = i == root || (
+        registration && registration->options.scope == scope
+      );
+      if (!constructed_here) continue;
+      for (std::size_t dependency : nodes[i].dependencies) {
+        const std::size_t position = position_of(dependency);
+        needed[position] = true;
+        if (i == root) direct[position] = true;
+      }
+    }
+
+    std::vector<Step>& plan = _plans[static_cast<std::size_t>(scope)];
+    for (std::size_t i = 0; i < root; ++i) {
+      if (!needed[i]) continue;
+      plan.push_back({.index = nodes[i].index, .direct = direct[i]});
+    }
+  }
+}
+
+co::Future<ServerResourceBase*> ResourcePool::checkout() {
+  while (true) {
+    bool construct = false;
+    {
+      std::lock_guard<std::mutex> lock{_mutex};
+      if (ServerResourceBase* resource = _take_idle()) co_return resource;
+      if (_reserved < _max_size) {
+        ++_reserved;
+        construct = true;
+      }
+    }
+
+    if (!construct) {
+      // A null resource means a member's construction failed and freed its
+      // slot, so loop around and try to construct one ourselves.
+      if (ServerResourceBase* resource = co_await ReleaseAwaitable{*this}) {
+        co_return resource;
+      }
+      continue;
+    }
+
+    std::unique_ptr<ServerResourceBase> resource;
+    try {
+      resource = co_await _factory(process_resource_context());
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock{_mutex};
+        --_reserved;
+      }
+      // Let a waiter take over the slot this construction had reserved.
+      _wake_one(nullptr);
+      throw;
+    }
+    std::lock_guard<std::mutex> lock{_mutex};
+    _members.push_back(std::move(resource));
+    co_return _members.back().get();
+  }
+}
+
+void ResourcePool::release(ServerResourceBase* resource) {
+  _wake_one(resource);
+}
+
+void ResourcePool::_wake_one(ServerResourceBase* resource) {
+  Waiter* waiter = nullptr;
+  {
+    std::lock_guard<std::mutex> lock{_mutex};
+    if (_waiters.empty()) {
+      if (resource) _idle.push_back(resource);
+      return;
+    }
+    waiter = _waiters.front();
+    _waiters.pop_front();
+    waiter->resource = resource;
+  }
+  waiter->scheduler->schedule_remote(waiter->handle);
+}
+
+bool ResourcePool::ReleaseAwaitable::await_suspend(
+  std::coroutine_handle<> handle
+) {
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+  std::lock_guard<std::mutex> lock{_pool._mutex};
+
+  // Something may have changed between checking and suspending.
+  if ((_waiter.resource = _pool._take_idle())) return false;
+  if (_pool._reserved < _pool._max_size) return false;
+
+  scheduler.expect_remote_schedule();
+  _waiter.handle = handle;
+  _waiter.scheduler = &scheduler;
+  _pool._waiters.push_back(&_waiter);
+  return true;
+}
+
+}
+
+// -------------------------------------------------------------------------- //
+
+ServerResourceContext& process_resource_context() {
+  static auto* context = new ServerResourceContext{ResourceScope::PROCESS};
+  return *context;
+}
+
+ServerResourceContext& thread_resource_context() {
+  thread_local ServerResourceContext context{ResourceScope::THREAD};
+  return context;
+}
+
+ServerResourceContext::PoolLease&
+ServerResourceContext::PoolLease::operator=(PoolLease&& other) {
+  if (pool) pool->release(resource);
+  pool = std::exchange(other.pool, nullptr);
+  resource = other.resource;
+  return *this;
+}
+
+ServerResourceContext::PoolLease::~PoolLease() {
+  if (pool) pool->release(resource);
+}
+
+ServerResourceContext::ServerResourceContext(ResourceScope scope):
+  _scope{scope},
+  _slots(internal::resource_count())
+{}
+
+ServerResourceBase* ServerResourceContext::_get(std::size_t index) const {
+  ServerResourceBase* resource = index < _slots.size()
+    ? _slots[index].resource.load(std::memory_order_acquire)
+    : nullptr;
+  if (!resource) {
+    throw FailedPrecondition()
+      << "Server resource " << get_registry().registrations[index].info->name()
+      << " has not been created in this context.";
+  }
+  return resource;
+}
+
+co::Future<void> ServerResourceContext::resolve_dependencies(
+  const internal::ResourceGraph& graph
+) {
+  std::vector<co::Future<ServerResourceBase*>> pending;
+  for (const internal::ResourceGraph::Step& step : graph.plan(_scope)) {
+    if (_slot(step.index).resource.load(std::memory_order_acquire)) continue;
+
+    // An indirect dependency already under construction is awaited by the
+    // direct dependencies which need it, so there is no need to join it here.
+    if (!step.direct && _in_flight(step.index)) continue;
+    pending.push_back(_resolve(step.index));
+  }
+  for (co::Future<ServerResourceBase*>& resolution : pending) {
+    co_await resolution;
+  }
+}
+
+ServerResourceContext::Slot& ServerResourceContext::_slot(std::size_t index) {
+  if (index >= _slots.size()) {
+    // Shared contexts are read from multiple threads without locking, so their
+    // slots can not be reallocated.
+    if (_scope == ResourceScope::PROCESS) {
+      throw FailedPrecondition()
+        << "Server resource " << get_registration(index).info->name()
+        << " was registered after the process resource context was created.";
+    }
+    _slots.resize(internal::resource_count());
+  }
+  return _slots[index];
+}
+
+bool ServerResourceContext::_in_flight(std::size_t index) const {
+  if (_scope == ResourceScope::PROCESS) {
+    return process_constructions().in_flight(index);
+  }
+  return _construction.in_flight(index);
+}
+
+co::Future<ServerResourceBase*> ServerResourceContext::_resolve(
+  std::size_t index
+) {
+  const ResourceRegistration& registration = get_registration(index);
+  const ResourceScope scope = registration.options.scope;
+  if (!can_depend_on(_scope, scope)) {
+    throw FailedPrecondition()
+      << "Server resource " << registration.info->name() << " has scope "
+      << scope_name(scope) << " and cannot be a dependency of a "
+      << scope_name(_scope) << " scoped resource.";
+  }
+
+  auto resolve = [this, index, scope]() -> co::Future<ServerResourceBase*> {
+    // An earlier flight may have finished before this one started.
+    ServerResourceBase* resource =
+      _slot(index).resource.load(std::memory_order_acquire);
+    if (resource) co_return resource;
+
+    if (scope == _scope) {
+      co_return co_await _construct(index);
+    } else if (scope == ResourceScope::POOLED) {
+      co_return co_await _lease(index);
+    } else if (scope == ResourceScope::PROCESS) {
+      resource = co_await process_resource_context()._resolve(index);
+    } else {
+      resource = co_await thread_resource_context()._resolve(index);
+    }
+
+    // Cache a reference to the shared resource so later lookups and `get` calls
+    // from resources in this context stay local.
+    _slot(index).resource.store(resource, std::memory_order_release);
+    co_return resource;
+  };
+
+  if (_scope == ResourceScope::PROCESS) {
+    co_return co_await process_constructions().run(index, resolve);
+  }
+  co_return co_await _construction.run(index, resolve);
+}
+
+co::Future<ServerResourceBase*> ServerResourceContext::_construct(
+  std::size_t index
+) {
+  auto resource = co_await (*get_registration(index).factory)(*this);
+  ServerResourceBase* resource_ptr = resource.get();
+
+  // Slots may have moved while the factory was running.
+  Slot& slot = _slot(index);
+  slot.owned = std::move(resource);
+  slot.resource.store(resource_ptr, std::memory_order_release);
+  co_return resource_ptr;
+}
+
+co::Future<ServerResourceBase*> ServerResourceContext::_lease(
+  std::size_t index
+) {
+  ResourcePool& pool = *get_registration(index).pool;
+  ServerResourceBase* resource = co_await pool.checkout();
+
+  Slot& slot = _slot(index);
+  slot.lease = PoolLease{&pool, resource};
+  slot.resource.store(resource, std::memory_order_release);
+  co_return resource;
+}
+
+// -------------------------------------------------------------------------- //
+
 bool register_server_resource(
     const std::type_info& resource_info,
-    std::unique_ptr<ServerResourceFactoryBase> factory) {
-  get_server_resources().insert(
-      {std::type_index{resource_info}, std::move(factory)});
+    std::unique_ptr<ServerResourceFactoryBase> factory,
+    ResourceOptions options) {
+  if (options.scope == ResourceScope::POOLED && options.max_pool_size == 0) {
+    throw InvalidArgument() << "Server resource " << resource_info.name()
+                            << " is pooled but has a max pool size of 0.";
+  }
+
+  ResourceRegistry& registry = get_registry();
+  std::lock_guard<std::mutex> lock{registry.mutex};
+  ResourceRegistration& registration =
+      registry.registrations[registry.index_of(resource_info)];
+  registration.factory = std::move(factory);
+  registration.options = options;
+  registration.pool =
+      options.scope == ResourceScope::POOLED
+          ? std::make_unique<ResourcePool>(*registration.factory,
+                                           options.max_pool_size)
+          : nullptr;
   return true;
 }
 
 co::Future<std::unique_ptr<ServerResourceBase>> construct_server_resource(
     const std::type_info& resource_info, ServerResourceContext& context) {
-  std::type_index resource_idx{resource_info};
-  if (!get_server_resources().contains(resource_idx)) {
-    throw NotFound() << "Server resource " << resource_info.name()
-                     << " has no factory registered.";
-  }
-  return (*get_server_resources()[resource_idx])(context);
+  return (*get_registration(internal::resource_index(resource_info)).factory)(
+      context);
 }
 
 } // namespace lw
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <tuple>
@@ -7,19 +9,35 @@
 #include <typeinfo>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "lw/base/tuple.h"
 #include "lw/co/future.h"
+#include "lw/co/single_flight.h"
 
 #define _LW_CONCAT_INNER(x, y) x ## y
 #define _LW_CONCAT(x, y) _LW_CONCAT_INNER(x, y)
 
-#define LW_REGISTER_RESOURCE_FACTORY(ServerResource, factory)             \
+/**
+ * Registers the factory used to construct `ServerResource`. An optional
+ * `ResourceOptions` initializer may follow the factory to control how long
+ * constructed instances live:
+ *
+ * ```cpp
+ *  LW_REGISTER_RESOURCE_FACTORY(DatabaseClient, make_database_client, {
+ *    .scope = ::lw::ResourceScope::POOLED,
+ *    .max_pool_size = 8
+ *  });
+ * ```
+ */
+#define LW_REGISTER_RESOURCE_FACTORY(ServerResource, factory, ...)        \
   namespace {                                                             \
   static const bool _LW_CONCAT(server_resource_registration, __LINE__) =  \
     ::lw::register_server_resource(                                       \
       typeid(ServerResource),                                             \
       ::lw::internal::create_resource_factory<ServerResource>(factory)    \
+      __VA_OPT__(, ::lw::ResourceOptions __VA_ARGS__)                     \
     );                                                                    \
   } // Ignore me.
 
@@ -28,6 +46,73 @@
 namespace lw {
 
 class ServerResourceContext;
+class ServerResourceFactoryBase;
+
+/**
+ * How long a constructed server resource lives and who it is shared with.
+ *
+ * Resources may only depend on resources which live at least as long as they
+ * do: `PROCESS` resources and the members of a `POOLED` resource's pool may
+ * only depend on `PROCESS` resources, and `THREAD` resources may depend on
+ * `PROCESS` or `THREAD` resources. `REQUEST` resources may depend on anything.
+ */
+enum class ResourceScope {
+  /**
+   * Constructed for, and destroyed with, each request's context. The default.
+   */
+  REQUEST,
+
+  /**
+   * Constructed once per thread and shared by all requests on that thread.
+   */
+  THREAD,
+
+  /**
+   * Constructed once and shared by every request in the process.
+   */
+  PROCESS,
+
+  /**
+   * Checked out of a shared, bounded pool for the duration of a request and
+   * returned to it afterwards. Requests wait for an instance to be returned
+   * when the pool is exhausted.
+   */
+  POOLED,
+};
+
+struct ResourceOptions {
+  ResourceScope scope = ResourceScope::REQUEST;
+
+  /**
+   * Maximum number of instances a `POOLED` resource may have constructed.
+   */
+  std::size_t max_pool_size = 16;
+};
+
+namespace internal {
+
+class ResourceGraph;
+class ResourcePool;
+
+/**
+ * Returns the dense index assigned to the resource type, assigning the next
+ * free index on the first call for the type.
+ */
+std::size_t resource_index(const std::type_info& resource_info);
+
+/**
+ * The number of resource indices assigned so far.
+ */
+std::size_t resource_count();
+
+/**
+ * The resource type's index, resolved once during static initialization so
+ * that lookups by type are a plain array access.
+ */
+template <typename T>
+inline const std::size_t resource_index_v = resource_index(typeid(T));
+
+}
 
 /**
  * Base for server resources. Final server resources should inherit from the
@@ -65,11 +150,12 @@ private:
  * resources for a given request cycle.
  *
  * One of these is created for every request that comes into a router utilizing
- * server resources.
+ * server resources. Resources with a wider `ResourceScope` are owned by shared
+ * contexts and only referenced from the request's context.
  */
 class ServerResourceContext {
 public:
-  ServerResourceContext() = default;
+  ServerResourceContext(): ServerResourceContext{ResourceScope::REQUEST} {}
   ~ServerResourceContext() = default;
   ServerResourceContext(const ServerResourceContext&) = delete;
   ServerResourceContext& operator=(const ServerResourceContext&) = delete;
@@ -78,31 +164,103 @@ public:
 
   /**
    * Fetches the identified resource. If this is the first time the resource is
-   * requested, it is constructed first.
+   * requested, it is constructed, checked out, or fetched from the shared
+   * context according to its scope first.
    */
   template <typename T>
   co::Future<T*> create_and_get();
 
   /**
-   * Fetches the identified resource without performing any check for its
-   * existence first.
+   * Fetches the identified resource without constructing it.
+   *
+   * @throw FailedPrecondition
+   *  If the resource has not been created in this context.
    */
   template <typename T>
   T& unsafe_get() {
-    return *static_cast<T*>(_dependencies.at({typeid(T)}).get());
+    return *static_cast<T*>(_get(internal::resource_index_v<T>));
   }
   template <typename T>
   const T& unsafe_get() const {
-    return *static_cast<T*>(_dependencies.at({typeid(T)}).get());
+    return *static_cast<const T*>(_get(internal::resource_index_v<T>));
   }
 
-private:
-  std::unordered_map<std::type_index, std::unique_ptr<ServerResourceBase>>
-  _dependencies;
+  /**
+   * Resolves every dependency in the graph needed to construct its resource in
+   * this context. Constructions are all started before any are awaited, so
+   * asynchronous factories that do not depend on each other run concurrently.
+   */
+  co::Future<void> resolve_dependencies(const internal::ResourceGraph& graph);
 
-  std::unordered_multimap<std::type_index, co::Promise<void>> _construction;
+  /**
+   * The scope of resources owned by this context.
+   */
+  ResourceScope scope() const { return _scope; }
+
+private:
+  /**
+   * Returns a leased pooled resource to its pool on destruction.
+   */
+  struct PoolLease {
+    PoolLease() = default;
+    PoolLease(internal::ResourcePool* pool, ServerResourceBase* resource):
+      pool{pool},
+      resource{resource}
+    {}
+    PoolLease(PoolLease&& other):
+      pool{std::exchange(other.pool, nullptr)},
+      resource{other.resource}
+    {}
+    PoolLease& operator=(PoolLease&& other);
+    PoolLease(const PoolLease&) = delete;
+    PoolLease& operator=(const PoolLease&) = delete;
+    ~PoolLease();
+
+    internal::ResourcePool* pool = nullptr;
+    ServerResourceBase* resource = nullptr;
+  };
+
+  struct Slot {
+    Slot() = default;
+    Slot(Slot&& other):
+      resource{other.resource.load(std::memory_order_relaxed)},
+      owned{std::move(other.owned)},
+      lease{std::move(other.lease)}
+    {}
+
+    std::atomic<ServerResourceBase*> resource = nullptr;
+    std::unique_ptr<ServerResourceBase> owned;
+    PoolLease lease;
+  };
+
+  friend ServerResourceContext& process_resource_context();
+  friend ServerResourceContext& thread_resource_context();
+
+  explicit ServerResourceContext(ResourceScope scope);
+
+  ServerResourceBase* _get(std::size_t index) const;
+  Slot& _slot(std::size_t index);
+  bool _in_flight(std::size_t index) const;
+  co::Future<ServerResourceBase*> _resolve(std::size_t index);
+  co::Future<ServerResourceBase*> _construct(std::size_t index);
+  co::Future<ServerResourceBase*> _lease(std::size_t index);
+
+  ResourceScope _scope;
+  std::vector<Slot> _slots;
+  co::SingleFlight<std::size_t, ServerResourceBase*> _construction;
 };
 
+/**
+ * The context owning all `PROCESS` scoped resources and providing the
+ * dependencies of `POOLED` resources.
+ */
+ServerResourceContext& process_resource_context();
+
+/**
+ * The context owning this thread's `THREAD` scoped resources.
+ */
+ServerResourceContext& thread_resource_context();
+
 // -------------------------------------------------------------------------- //
 
 namespace internal {
@@ -121,6 +279,98 @@ struct ServerResourceFactoryTypes<ServerResource, std::tuple<Dependencies...>> {
 
 // -------------------------------------------------------------------------- //
 
+template <typename ServerResource>
+struct ResourceDependencies {
+  typedef typename ServerResource::dependencies_t type;
+};
+
+/**
+ * All of the resource's transitive dependencies, followed by the resource
+ * itself, ordered so each resource comes after everything it depends on.
+ * Dependency cycles fail to compile.
+ */
+template <typename ServerResource>
+using resource_graph_t =
+  topological_sort_t<ResourceDependencies, std::tuple<ServerResource>>;
+
+struct ResourceGraphNode {
+  std::size_t index;
+  std::vector<std::size_t> dependencies;
+};
+
+/**
+ * A resource's dependency graph, with resource types replaced by their indices.
+ * Nodes are in topological order, ending with the resource itself.
+ */
+class ResourceGraph {
+public:
+  struct Step {
+    std::size_t index;
+
+    /**
+     * True if the graph's resource depends on this one directly.
+     */
+    bool direct;
+  };
+
+  explicit ResourceGraph(std::vector<ResourceGraphNode> nodes);
+
+  /**
+   * The dependencies which must be resolved in a context of the given scope
+   * before the resource can be constructed in it, in topological order.
+   *
+   * Dependencies with a different scope are resolved by their own contexts,
+   * so the plan does not descend into them.
+   */
+  const std::vector<Step>& plan(ResourceScope scope) const {
+    return _plans[static_cast<std::size_t>(scope)];
+  }
+
+private:
+  // One plan per `ResourceScope`.
+  std::vector<Step> _plans[4];
+};
+
+template <typename Tuple>
+struct ResourceIndices;
+
+template <typename... Resources>
+struct ResourceIndices<std::tuple<Resources...>> {
+  static std::vector<std::size_t> get() {
+    return {resource_index_v<Resources>...};
+  }
+};
+
+template <typename Tuple>
+struct ResourceGraphBuilder;
+
+template <typename... Resources>
+struct ResourceGraphBuilder<std::tuple<Resources...>> {
+  static ResourceGraph build() {
+    return ResourceGraph{{
+      ResourceGraphNode{
+        .index = resource_index_v<Resources>,
+        .dependencies = ResourceIndices<
+          typename Resources::dependencies_t
+        >::get()
+      }...
+    }};
+  }
+};
+
+/**
+ * The resource's dependency graph. Built on first use, after all resources
+ * have been registered with their scopes.
+ */
+template <typename ServerResource>
+const ResourceGraph& resource_graph() {
+  static const ResourceGraph graph =
+    ResourceGraphBuilder<resource_graph_t<ServerResource>>::build();
+  return graph;
+}
+
+// -------------------------------------------------------------------------- //
+
 template <typename Factory, typename DependenciesTuple>
 class FactoryInvocationResult;
 
@@ -176,10 +426,8 @@ struct FetchDependenciesAndInvoke<ServerResource, std::tuple<Dependencies...>> {
     Factory& factory,
     ServerResourceContext& context
   ) {
-    auto resource = co_await std::apply(
-      [&](auto... deps) { return factory((*deps)...); },
-      co_await co::all(context.create_and_get<Dependencies>()...)
-    );
+    co_await context.resolve_dependencies(resource_graph<ServerResource>());
+    auto resource = co_await factory(context.unsafe_get<Dependencies>()...);
 
     resource->server_resource_context(context);
     co_return std::move(resource);
@@ -297,7 +545,8 @@ private:
 
 bool register_server_resource(
   const std::type_info& resource_info,
-  std::unique_ptr<ServerResourceFactoryBase> factory
+  std::unique_ptr<ServerResourceFactoryBase> factory,
+  ResourceOptions options = {}
 );
 
 co::Future<std::unique_ptr<ServerResourceBase>> construct_server_resource(
@@ -309,26 +558,12 @@ co::Future<std::unique_ptr<ServerResourceBase>> construct_server_resource(
 
 template <typename T>
 co::Future<T*> ServerResourceContext::create_and_get() {
-  const std::type_info& info{typeid(T)};
-  std::type_index idx{info};
-  if (!_dependencies.contains(idx)) {
-    if (_construction.contains(idx)) {
-      // The dependency is currently under construction. Add ourselves to the
-      // notification queue to await its completion.
-      auto itr = _construction.emplace(idx, co::Promise<void>{});
-      co_await itr->second.get_future();
-    } else {
-      // The dependency is not yet being built. Tag the type as under
-      // construction, build it, and then notify everyone waiting for its
-      // completion.
-      _construction.emplace(idx, co::Promise<void>{});
-      _dependencies[idx] = co_await construct_server_resource(info, *this);
-      auto [itr, end] = _construction.equal_range(idx);
-      for (; itr != end; ++itr) itr->second.set_value();
-      _construction.erase(idx);
-    }
-  }
-  co_return static_cast<T*>(_dependencies.at(idx).get());
+  const std::size_t index = internal::resource_index_v<T>;
+  ServerResourceBase* resource = _slot(index).resource.load(
+    std::memory_order_acquire
+  );
+  if (!resource) resource = co_await _resolve(index);
+  co_return static_cast<T*>(resource);
 }
 
 // -------------------------------------------------------------------------- //
@@ -344,6 +579,8 @@ std::unique_ptr<ServerResourceFactoryBase> create_resource_factory(
     "Server resource factories must return a unique_ptr to the server resource "
     "or a future unique_ptr."
   );
+  // Instantiated here so that dependency cycles are reported at registration.
+  static_assert(std::tuple_size_v<resource_graph_t<ServerResource>> > 0);
   return std::make_unique<ServerResourceFactory<ServerResource>>(
     std::forward<Factory>(factory)
   );
@@ -0,0 +1,184 @@
+#include "lw/net/server_resource.h"
+
+#include <chrono>
+#include <memory>
+#include <tuple>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/co/time.h"
+
+namespace lw {
+namespace {
+
+template <ResourceScope scope>
+struct ScopedResource: public ServerResource<> {};
+
+LW_REGISTER_RESOURCE_FACTORY(ScopedResource<ResourceScope::REQUEST>, []() {
+  return std::make_unique<ScopedResource<ResourceScope::REQUEST>>();
+});
+LW_REGISTER_RESOURCE_FACTORY(ScopedResource<ResourceScope::THREAD>, []() {
+  return std::make_unique<ScopedResource<ResourceScope::THREAD>>();
+}, {.scope = ResourceScope::THREAD});
+LW_REGISTER_RESOURCE_FACTORY(ScopedResource<ResourceScope::PROCESS>, []() {
+  return std::make_unique<ScopedResource<ResourceScope::PROCESS>>();
+}, {.scope = ResourceScope::PROCESS});
+LW_REGISTER_RESOURCE_FACTORY(ScopedResource<ResourceScope::POOLED>, []() {
+  return std::make_unique<ScopedResource<ResourceScope::POOLED>>();
+}, {.scope = ResourceScope::POOLED});
+
+template <typename Func>
+void run(Func& func) {
+  co::Scheduler::this_thread().schedule(func);
+  co::Scheduler::this_thread().run();
+}
+
+/**
+ * Simulates a stream of requests which each create a fresh context and resolve
+ * one resource from it.
+ */
+template <ResourceScope scope>
+co::Task resolve_per_request(benchmark::State& state) {
+  for (auto _ : state) {
+    ServerResourceContext context;
+    benchmark::DoNotOptimize(
+      co_await context.create_and_get<ScopedResource<scope>>()
+    );
+  }
+}
+
+template <ResourceScope scope>
+void BM_ResolvePerRequest(benchmark::State& state) {
+  auto requests = [&]() { return resolve_per_request<scope>(state); };
+  run(requests);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ResolvePerRequest, ResourceScope::REQUEST);
+BENCHMARK_TEMPLATE(BM_ResolvePerRequest, ResourceScope::THREAD);
+BENCHMARK_TEMPLATE(BM_ResolvePerRequest, ResourceScope::PROCESS);
+BENCHMARK_TEMPLATE(BM_ResolvePerRequest, ResourceScope::POOLED);
+
+/**
+ * Cost of fetching an already resolved resource, as done by `get` from within
+ * dependent resources.
+ */
+void BM_LookupResolvedResource(benchmark::State& state) {
+  using Resource = ScopedResource<ResourceScope::REQUEST>;
+  ServerResourceContext context;
+  auto setup = [&]() -> co::Task {
+    co_await context.create_and_get<Resource>();
+  };
+  run(setup);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(&context.unsafe_get<Resource>());
+  }
+}
+BENCHMARK(BM_LookupResolvedResource);
+
+// -------------------------------------------------------------------------- //
+
+template <int id, typename... Dependencies>
+struct GraphResource: public ServerResource<Dependencies...> {};
+
+// A 20 resource graph four levels deep, where every factory waits on I/O.
+using Leaf0 = GraphResource<0>;
+using Leaf1 = GraphResource<1>;
+using Leaf2 = GraphResource<2>;
+using Leaf3 = GraphResource<3>;
+using Leaf4 = GraphResource<4>;
+using Leaf5 = GraphResource<5>;
+using Leaf6 = GraphResource<6>;
+using Leaf7 = GraphResource<7>;
+using Middle0 = GraphResource<10, Leaf0, Leaf1>;
+using Middle1 = GraphResource<11, Leaf1, Leaf2>;
+using Middle2 = GraphResource<12, Leaf2, Leaf3>;
+using Middle3 = GraphResource<13, Leaf4, Leaf5>;
+using Middle4 = GraphResource<14, Leaf5, Leaf6>;
+using Middle5 = GraphResource<15, Leaf6, Leaf7>;
+using Upper0 = GraphResource<20, Middle0, Middle1>;
+using Upper1 = GraphResource<21, Middle1, Middle2>;
+using Upper2 = GraphResource<22, Middle2, Middle3>;
+using Upper3 = GraphResource<23, Middle3, Middle4>;
+using Upper4 = GraphResource<24, Middle4, Middle5>;
+using Root = GraphResource<30, Upper0, Upper1, Upper2, Upper3, Upper4>;
+
+static_assert(std::tuple_size_v<internal::resource_graph_t<Root>> == 20);
+
+constexpr std::chrono::microseconds IO_LATENCY{100};
+
+template <typename Resource>
+const auto io_factory = [](auto&...) -> co::Future<std::unique_ptr<Resource>> {
+  co_await co::sleep_for(IO_LATENCY);
+  co_return std::make_unique<Resource>();
+};
+
+LW_REGISTER_RESOURCE_FACTORY(Leaf0, io_factory<Leaf0>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf1, io_factory<Leaf1>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf2, io_factory<Leaf2>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf3, io_factory<Leaf3>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf4, io_factory<Leaf4>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf5, io_factory<Leaf5>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf6, io_factory<Leaf6>);
+LW_REGISTER_RESOURCE_FACTORY(Leaf7, io_factory<Leaf7>);
+LW_REGISTER_RESOURCE_FACTORY(Middle0, io_factory<Middle0>);
+LW_REGISTER_RESOURCE_FACTORY(Middle1, io_factory<Middle1>);
+LW_REGISTER_RESOURCE_FACTORY(Middle2, io_factory<Middle2>);
+LW_REGISTER_RESOURCE_FACTORY(Middle3, io_factory<Middle3>);
+LW_REGISTER_RESOURCE_FACTORY(Middle4, io_factory<Middle4>);
+LW_REGISTER_RESOURCE_FACTORY(Middle5, io_factory<Middle5>);
+LW_REGISTER_RESOURCE_FACTORY(Upper0, io_factory<Upper0>);
+LW_REGISTER_RESOURCE_FACTORY(Upper1, io_factory<Upper1>);
+LW_REGISTER_RESOURCE_FACTORY(Upper2, io_factory<Upper2>);
+LW_REGISTER_RESOURCE_FACTORY(Upper3, io_factory<Upper3>);
+LW_REGISTER_RESOURCE_FACTORY(Upper4, io_factory<Upper4>);
+LW_REGISTER_RESOURCE_FACTORY(Root, io_factory<Root>);
+
+co::Task resolve_graph(benchmark::State& state) {
+  for (auto _ : state) {
+    ServerResourceContext context;
+    benchmark::DoNotOptimize(co_await context.create_and_get<Root>());
+  }
+}
+
+void BM_ResolveGraph(benchmark::State& state) {
+  auto requests = [&]() { return resolve_graph(state); };
+  run(requests);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ResolveGraph)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+/**
+ * Baseline for comparison: every resource in the graph is constructed one at a
+ * time, in topological order.
+ */
+template <typename... Resources>
+co::Future<void> resolve_sequentially(
+  ServerResourceContext& context,
+  std::tuple<Resources...>*
+) {
+  (benchmark::DoNotOptimize(co_await context.create_and_get<Resources>()), ...);
+}
+
+co::Task resolve_graph_sequentially(benchmark::State& state) {
+  for (auto _ : state) {
+    ServerResourceContext context;
+    co_await resolve_sequentially(
+      context,
+      static_cast<internal::resource_graph_t<Root>*>(nullptr)
+    );
+  }
+}
+
+void BM_ResolveGraphSequentially(benchmark::State& state) {
+  auto requests = [&]() { return resolve_graph_sequentially(state); };
+  run(requests);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ResolveGraphSequentially)
+  ->Unit(benchmark::kMicrosecond)
+  ->UseRealTime();
+
+}
+}
@@ -1,6 +1,10 @@
 #include "lw/net/server_resource.h"
 
+#include <algorithm>
 #include <memory>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <typeinfo>
 
 #include "gtest/gtest.h"
@@ -8,6 +12,7 @@
 #include "lw/co/scheduler.h"
 #include "lw/co/task.h"
 #include "lw/co/testing/destroy_scheduler.h"
+#include "lw/err/canonical.h"
 
 namespace lw {
 
@@ -95,6 +100,121 @@ LW_REGISTER_RESOURCE_FACTORY(
   }
 );
 
+struct ProcessTestServerResource: public ServerResource<> {
+  static inline int constructions = 0;
+  ProcessTestServerResource() { ++constructions; }
+};
+
+LW_REGISTER_RESOURCE_FACTORY(ProcessTestServerResource, []() {
+  return std::make_unique<ProcessTestServerResource>();
+}, {.scope = ResourceScope::PROCESS});
+
+struct ThreadTestServerResource:
+  public ServerResource<std::tuple<ProcessTestServerResource>>
+{
+  std::thread::id thread_id = std::this_thread::get_id();
+};
+
+LW_REGISTER_RESOURCE_FACTORY(
+  ThreadTestServerResource,
+  [](ProcessTestServerResource&) {
+    return std::make_unique<ThreadTestServerResource>();
+  },
+  {.scope = ResourceScope::THREAD}
+);
+
+struct PooledTestServerResource:
+  public ServerResource<std::tuple<ProcessTestServerResource>>
+{
+  static inline int constructions = 0;
+  PooledTestServerResource() { ++constructions; }
+};
+
+LW_REGISTER_RESOURCE_FACTORY(
+  PooledTestServerResource,
+  [](ProcessTestServerResource&)
+    -> co::Future<std::unique_ptr<PooledTestServerResource>>
+  {
+    co_await co::next_tick();
+    co_return std::make_unique<PooledTestServerResource>();
+  },
+  {.scope = ResourceScope::POOLED, .max_pool_size = 1}
+);
+
+struct RequestOnWiderScopesTestServerResource:
+  public ServerResource<std::tuple<
+    ProcessTestServerResource,
+    ThreadTestServerResource,
+    PooledTestServerResource
+  >>
+{
+  ProcessTestServerResource& process() {
+    return get<ProcessTestServerResource>();
+  }
+  PooledTestServerResource& pooled() { return get<PooledTestServerResource>(); }
+};
+
+LW_REGISTER_RESOURCE_FACTORY(
+  RequestOnWiderScopesTestServerResource,
+  [](
+    ProcessTestServerResource&,
+    ThreadTestServerResource&,
+    PooledTestServerResource&
+  ) {
+    return std::make_unique<RequestOnWiderScopesTestServerResource>();
+  }
+);
+
+struct InvalidProcessTestServerResource:
+  public ServerResource<std::tuple<TestServerResource<int>>>
+{};
+
+LW_REGISTER_RESOURCE_FACTORY(
+  InvalidProcessTestServerResource,
+  [](TestServerResource<int>&) {
+    return std::make_unique<InvalidProcessTestServerResource>();
+  },
+  {.scope = ResourceScope::PROCESS}
+);
+
+struct GraphConstructionTracker {
+  static inline int in_progress = 0;
+  static inline int max_in_progress = 0;
+  static inline int constructions = 0;
+};
+
+template <typename Resource>
+co::Future<std::unique_ptr<Resource>> track_async_construction() {
+  auto& tracker = GraphConstructionTracker::in_progress;
+  ++GraphConstructionTracker::constructions;
+  GraphConstructionTracker::max_in_progress =
+    std::max(GraphConstructionTracker::max_in_progress, ++tracker);
+  co_await co::next_tick();
+  --tracker;
+  co_return std::make_unique<Resource>();
+}
+
+struct GraphLeafA: public ServerResource<> {};
+struct GraphLeafB: public ServerResource<> {};
+struct GraphMiddle: public ServerResource<GraphLeafA> {};
+struct GraphRoot: public ServerResource<GraphMiddle, GraphLeafB, GraphLeafA> {};
+
+LW_REGISTER_RESOURCE_FACTORY(GraphLeafA, []() {
+  return track_async_construction<GraphLeafA>();
+});
+LW_REGISTER_RESOURCE_FACTORY(GraphLeafB, []() {
+  return track_async_construction<GraphLeafB>();
+});
+LW_REGISTER_RESOURCE_FACTORY(GraphMiddle, [](GraphLeafA&) {
+  return track_async_construction<GraphMiddle>();
+});
+LW_REGISTER_RESOURCE_FACTORY(
+  GraphRoot,
+  [](GraphMiddle&, GraphLeafB&, GraphLeafA&) {
+    return track_async_construction<GraphRoot>();
+  }
+);
+
 // -------------------------------------------------------------------------- //
 
 namespace {
@@ -228,3 +348,135 @@ TEST(ServerResource, AsynchronousResources) {
 
 }
 }
+
+namespace lw {
+namespace {
+
+TEST(ServerResourceScope, ProcessResourcesAreConstructedOnce) {
+  run([]() -> co::Future<void> {
+    ServerResourceContext first;
+    ServerResourceContext second;
+    auto* a = co_await first.create_and_get<ProcessTestServerResource>();
+    auto* b = co_await second.create_and_get<ProcessTestServerResource>();
+    EXPECT_EQ(a, b);
+    EXPECT_EQ(ProcessTestServerResource::constructions, 1);
+    EXPECT_EQ(&first.unsafe_get<ProcessTestServerResource>(), a);
+  });
+}
+
+TEST(ServerResourceScope, ThreadResourcesArePerThread) {
+  ThreadTestServerResource* main_resource = nullptr;
+  run([&]() -> co::Future<void> {
+    ServerResourceContext first;
+    ServerResourceContext second;
+    main_resource = co_await first.create_and_get<ThreadTestServerResource>();
+    EXPECT_EQ(
+      co_await second.create_and_get<ThreadTestServerResource>(),
+      main_resource
+    );
+  });
+  EXPECT_EQ(main_resource->thread_id, std::this_thread::get_id());
+
+  std::thread::id other_thread_id;
+  std::jthread other{[&]() {
+    run([&]() -> co::Future<void> {
+      ServerResourceContext context;
+      auto* resource =
+        co_await context.create_and_get<ThreadTestServerResource>();
+      EXPECT_NE(resource, main_resource);
+      other_thread_id = resource->thread_id;
+    });
+  }};
+  other.join();
+  EXPECT_NE(other_thread_id, main_resource->thread_id);
+}
+
+TEST(ServerResourceScope, PooledResourcesAreReturnedAndReused) {
+  run([]() -> co::Future<void> {
+    PooledTestServerResource* first_resource = nullptr;
+    {
+      ServerResourceContext context;
+      first_resource =
+        co_await context.create_and_get<PooledTestServerResource>();
+    }
+    ServerResourceContext context;
+    EXPECT_EQ(
+      co_await context.create_and_get<PooledTestServerResource>(),
+      first_resource
+    );
+    EXPECT_EQ(PooledTestServerResource::constructions, 1);
+  });
+}
+
+TEST(ServerResourceScope, PooledCheckoutWaitsWhenExhausted) {
+  run([]() -> co::Future<void> {
+    auto holder = std::make_unique<ServerResourceContext>();
+    auto* held = co_await holder->create_and_get<PooledTestServerResource>();
+
+    ServerResourceContext waiter;
+    auto pending = waiter.create_and_get<PooledTestServerResource>();
+    co_await co::next_tick();
+    EXPECT_FALSE(pending.await_ready());
+
+    holder.reset();
+    EXPECT_EQ(co_await pending, held);
+  });
+}
+
+TEST(ServerResourceScope, RequestResourcesUseWiderScopedDependencies) {
+  run([]() -> co::Future<void> {
+    ServerResourceContext context;
+    auto* resource =
+      co_await context.create_and_get<RequestOnWiderScopesTestServerResource>();
+    EXPECT_EQ(
+      &resource->process(),
+      co_await ServerResourceContext{}
+        .create_and_get<ProcessTestServerResource>()
+    );
+    EXPECT_EQ(
+      &resource->pooled(),
+      &context.unsafe_get<PooledTestServerResource>()
+    );
+  });
+}
+
+TEST(ServerResourceScope, RejectsDependenciesWithNarrowerScope) {
+  run([]() -> co::Future<void> {
+    ServerResourceContext context;
+    EXPECT_THROW(
+      co_await context.create_and_get<InvalidProcessTestServerResource>(),
+      FailedPrecondition
+    );
+  });
+}
+
+}
+}
+
+namespace lw {
+namespace {
+
+TEST(ServerResourceGraph, OrdersDependenciesTopologically) {
+  EXPECT_TRUE((
+    std::is_same_v<
+      internal::resource_graph_t<GraphRoot>,
+      std::tuple<GraphLeafA, GraphMiddle, GraphLeafB, GraphRoot>
+    >
+  ));
+}
+
+TEST(ServerResourceGraph, ConstructsIndependentResourcesConcurrently) {
+  run([]() -> co::Future<void> {
+    ServerResourceContext context;
+    co_await context.create_and_get<GraphRoot>();
+
+    // GraphLeafA and GraphLeafB do not depend on each other so are both under
+    // construction at once.
+    EXPECT_EQ(GraphConstructionTracker::max_in_progress, 2);
+    EXPECT_EQ(GraphConstructionTracker::in_progress, 0);
+    EXPECT_EQ(GraphConstructionTracker::constructions, 4);
+  });
+}
+
+}
+}
@@ -4,6 +4,8 @@
 #include <experimental/source_location>
 #include <fcntl.h>
 #include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -83,6 +85,19 @@ void enable_socket_reuse(int sock) {
   }
 }
 
+void disable_nagle(int sock) {
+  // Writes are already batched by the streams above this socket, so holding
+  // back small ones only delays the last frames of a response.
+  int set_true = 1;
+  if (
+    ::setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &set_true, sizeof(set_true)) ==
+    -1
+  ) {
+    check_system_error();
+    throw Internal() << "Unknown system error in setsockopt.";
+  }
+}
+
 bool should_wait(int err) {
   // These errors indicate we need to wait for the socket to be ready before
   // trying again.
@@ -117,6 +132,14 @@ void Socket::close() {
   _socket_fd = 0;
 }
 
+void Socket::shutdown() {
+  if (_socket_fd == 0) {
+    throw FailedPrecondition() << "Socket is closed, cannot shut it down.";
+  }
+  // Fails only if the peer already disconnected, which is just as shut down.
+  ::shutdown(_socket_fd, SHUT_RDWR);
+}
+
 co::Future<void> Socket::connect(Address addr) {
   if (is_open()) {
     throw FailedPrecondition() << "Socket is already open before connecting.";
@@ -165,6 +188,7 @@ co::Future<void> Socket::connect(Address addr) {
       }
     }
 
+    disable_nagle(sock);
     _socket_fd = sock;
     break;
   }
@@ -186,7 +210,8 @@ co::Future<std::size_t> Socket::send(const Buffer& data) {
   }
   LW_CHECK_NULL(data.data());
 
-  return _do_send(data, /*flags=*/0);
+  // A peer which has gone away is reported as an error rather than SIGPIPE.
+  return _do_send(data, MSG_NOSIGNAL);
 }
 
 co::Future<std::size_t> Socket::_do_send(const Buffer& data, int flags) {
@@ -333,6 +358,7 @@ co::Future<Socket> Socket::_do_accept() const {
       check_system_error();
       throw Internal() << "Unknown system error setting socket to nonblocking.";
     }
+    disable_nagle(new_sock);
 
     co_return Socket{new_sock};
   }
@@ -25,11 +25,23 @@ public:
 
   bool is_open() const { return _socket_fd > 0; }
 
+  /**
+   * The file descriptor of the socket, for configuring it beyond what this
+   * class offers. Ownership stays with the socket.
+   */
+  int native_handle() const { return _socket_fd; }
+
   /**
    * Closes the socket, disabling any further reads or writes.
    */
   void close() override;
 
+  /**
+   * Stops all further reads and writes without releasing the socket. Any
+   * coroutine waiting to receive is woken to find the connection closed.
+   */
+  void shutdown();
+
   bool good() const override { return is_open(); }
   bool eof() const override {  return is_open(); }
   co::Future<std::size_t> write(const Buffer& data) override {
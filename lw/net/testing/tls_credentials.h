@@ -7,4 +7,8 @@ namespace lw::net::testing {
 constexpr std::string_view CERT_PATH = "lw/net/testing/test.cert.pem";
 constexpr std::string_view KEY_PATH = "lw/net/testing/test.key.pem";
 
+// A second certificate, issued to "other.example.com".
+constexpr std::string_view OTHER_CERT_PATH = "lw/net/testing/other.cert.pem";
+constexpr std::string_view OTHER_KEY_PATH = "lw/net/testing/other.key.pem";
+
 }
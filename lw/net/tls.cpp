@@ -1,97 +1,364 @@
 #include "lw/net/tls.h"
 
+#include <cstring>
+#include <exception>
 #include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
 
-#include "lw/flags/flags.h"
+#include "lw/co/future.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/err/canonical.h"
 #include "lw/memory/buffer.h"
+#include "lw/memory/buffer_pool.h"
 #include "lw/memory/buffer_view.h"
+#include "lw/net/internal/kernel_tls.h"
 #include "lw/net/internal/tls_client.h"
 #include "lw/net/internal/tls_context.h"
-
-LW_FLAG(
-  std::size_t, tls_buffer_size, 1024 * 1024,
-  "Size of write buffer for TLS streams."
-);
+#include "lw/net/socket.h"
 
 namespace lw::net {
+namespace {
+
+// The most plaintext a single TLS record carries.
+constexpr std::size_t MAX_RECORD_PLAINTEXT = 16 * 1024;
+
+/**
+ * Writes flushed in the background can outlive their stream, so every write
+ * coroutine checks the stream is still there each time it resumes.
+ */
+void check_alive(const std::shared_ptr<const bool>& alive) {
+  if (!*alive) throw Cancelled() << "TLS stream destroyed while writing.";
+}
+
+}
 
 TLSStream::TLSStream(
   std::unique_ptr<internal::TLSClientImpl> client,
-  std::unique_ptr<io::CoStream> raw_stream
+  std::unique_ptr<io::CoStream> raw_stream,
+  co::ThreadPool* handshake_pool,
+  bool kernel_tls,
+  bool coalesce_writes
 ):
   _client{std::move(client)},
   _raw_stream{std::move(raw_stream)},
-  _write_buffer{flags::tls_buffer_size}
+  _handshake_pool{handshake_pool},
+  _kernel_tls{kernel_tls},
+  _coalesce_writes{coalesce_writes}
 {}
 
 TLSStream::~TLSStream() {
   // This destructor must be defined in this file where it has access to the
   // full definition of the TLSClientImpl class.
+  *_alive = false;
+  std::vector<co::Promise<void>> waiters = std::move(_drain_waiters);
+  auto err = std::make_exception_ptr(Cancelled() << "TLS stream destroyed.");
+  for (co::Promise<void>& waiter : waiters) waiter.set_exception(err);
+  if (!_pending.empty()) {
+    internal::tls_record_buffers().release(std::move(_pending));
+  }
+}
+
+std::string_view TLSStream::alpn_protocol() const {
+  return _client->alpn_protocol();
 }
 
 co::Future<void> TLSStream::handshake() {
-  // Get into handshake mode.
-  _client->handshake();
-  do {
-    // Attempt to read outbound handshake data.
-    internal::TLSIOResult res = _client->read_encrypted_data(_write_buffer);
-    if (res && res.bytes > 0) {
-      co_await _raw_stream->write(
-        {_write_buffer.data(), res.bytes, /*own_data=*/false}
-      );
-    }
+  internal::TLSResult state = co_await _handshake_step();
+  while (true) {
+    // Send any outbound handshake data, including the final flight.
+    co_await _flush_encrypted_data();
+    if (state == internal::TLSResult::COMPLETED) break;
 
     // If handshaking needs to receive more data, read it from the stream.
-    if (_client->handshake() == internal::TLSResult::NEED_TO_READ) {
-      const std::size_t bytes_read = co_await _raw_stream->read(_write_buffer);
-      _client->buffer_encrypted_data({_write_buffer.data(), bytes_read});
+    if (state == internal::TLSResult::NEED_TO_READ) {
+      Buffer encrypted = internal::tls_record_buffers().acquire();
+      const std::size_t bytes_read = co_await _raw_stream->read(encrypted);
+      _client->buffer_encrypted_data({encrypted.data(), bytes_read});
+      internal::tls_record_buffers().release(std::move(encrypted));
+
+      // Nothing new arrived, so there is nothing to advance the handshake with.
+      if (bytes_read == 0) continue;
     }
-  } while (_client->handshake() != internal::TLSResult::COMPLETED);
+    state = co_await _handshake_step();
+  }
+
+  if (_kernel_tls) _start_kernel_tls();
 }
 
-co::Future<std::size_t> TLSStream::read(Buffer& buffer) {
-  const std::size_t bytes_read = co_await _raw_stream->read(buffer);
-  internal::TLSIOResult res =
-    _client->buffer_encrypted_data({buffer.data(), bytes_read});
-  if (res) {
-    if (res.bytes != bytes_read) {
-      throw Internal() << "Failed to buffer all encrypted data from the wire.";
+co::Future<internal::TLSResult> TLSStream::_handshake_step() {
+  // Checking a finished handshake is cheap, so it is not worth a thread hop.
+  if (!_handshake_pool || _client->handshake_finished()) {
+    co_return _client->handshake();
+  }
+
+  // The stream is not touched by anything else while the handshake is in
+  // progress, so the client can be handed to the pool until this resolves.
+  // Whole steps are offloaded, rather than only signing through an async
+  // SSL_PRIVATE_KEY_METHOD, as the key exchange costs as much or more than
+  // an ECDSA signature and resumed TLS 1.3 handshakes still do one.
+  co_return co_await _handshake_pool->run([this]() {
+    return _client->offloaded_handshake();
+  });
+}
+
+co::Future<void> TLSStream::_flush_encrypted_data() {
+  const std::shared_ptr<const bool> alive = _alive;
+
+  // The encrypted data is sent straight from the client's record buffer.
+  for (
+    BufferView pending = _client->encrypted_data();
+    !pending.empty();
+    pending = _client->encrypted_data()
+  ) {
+    const std::size_t bytes_sent = co_await _raw_stream->write({
+      const_cast<std::uint8_t*>(pending.data()),
+      pending.size(),
+      /*own_data=*/false
+    });
+    check_alive(alive);
+    if (bytes_sent == 0) {
+      throw Internal() << "Failed to send encrypted data on the wire.";
     }
+    _client->consume_encrypted_data(bytes_sent);
+  }
+}
 
-    res = _client->read_decrypted_data(buffer);
-    if (!res) {
-      throw Internal() << "Failed to read decrypted data from TLS client.";
+void TLSStream::_start_kernel_tls() {
+  _kernel_tls = false;
+  auto* socket = dynamic_cast<Socket*>(_raw_stream.get());
+  if (
+    !socket ||
+    !_client->encrypted_data().empty() ||
+    !internal::enable_kernel_tls(socket->native_handle())
+  ) {
+    _client->forget_traffic_secrets();
+    return;
+  }
+
+  std::optional<internal::TLSTrafficKeys> keys =
+    _client->traffic_keys(internal::TLSDirection::SEND);
+  _kernel_send = keys && internal::install_kernel_tls_keys(
+    socket->native_handle(),
+    internal::TLSDirection::SEND,
+    *keys
+  );
+
+  // The kernel refuses to pass post-handshake messages, such as the session
+  // tickets sent to clients, through as data, so only servers decrypt there.
+  _kernel_receive_pending = _client->is_server();
+  _try_kernel_receive();
+}
+
+void TLSStream::_try_kernel_receive() {
+  if (_client->has_buffered_input()) return;
+  _kernel_receive_pending = false;
+
+  std::optional<internal::TLSTrafficKeys> keys =
+    _client->traffic_keys(internal::TLSDirection::RECEIVE);
+  _kernel_receive = keys && internal::install_kernel_tls_keys(
+    static_cast<Socket&>(*_raw_stream).native_handle(),
+    internal::TLSDirection::RECEIVE,
+    *keys
+  );
+  _client->forget_traffic_secrets();
+}
+
+co::Future<void> TLSStream::_write_raw(BufferView data) {
+  const std::shared_ptr<const bool> alive = _alive;
+  std::size_t bytes_written = 0;
+  while (bytes_written < data.size()) {
+    const std::size_t bytes_sent = co_await _raw_stream->write({
+      const_cast<std::uint8_t*>(data.data()) + bytes_written,
+      data.size() - bytes_written,
+      /*own_data=*/false
+    });
+    check_alive(alive);
+    if (bytes_sent == 0) {
+      throw Internal() << "Failed to send data on the wire.";
     }
-    co_return res.bytes;
+    bytes_written += bytes_sent;
   }
-  if (res.result == internal::TLSResult::AGAIN) co_return 0;
-  throw Internal() << "Unknown failure buffering encrypted data.";
+}
+
+co::Future<std::size_t> TLSStream::read(Buffer& buffer) {
+  if (_kernel_receive) co_return co_await _raw_stream->read(buffer);
+
+  // Hand out anything already received before waiting on the connection.
+  internal::TLSIOResult res = _client->read_decrypted_data(buffer);
+  if (res) co_return res.bytes;
+
+  if (_kernel_receive_pending) {
+    _try_kernel_receive();
+    if (_kernel_receive) co_return co_await _raw_stream->read(buffer);
+  }
+
+  // Buffers with room for a whole record are filled with ciphertext straight
+  // from the wire, so one read carries as many records as fit, which are then
+  // decrypted in place. Plaintext is written from the front and never outgrows
+  // the ciphertext it came from, so it cannot overtake unread ciphertext as
+  // long as that starts past any partial record still held by the client.
+  // Smaller buffers read through a pooled record buffer instead, with the
+  // surplus kept for the following reads. Records without any application
+  // data, such as session tickets, are consumed until some data arrives.
+  const std::size_t record_size = internal::tls_record_buffers().buffer_size();
+  std::size_t bytes_read = 0;
+  do {
+    const std::size_t headroom =
+      _client->has_buffered_input() ? record_size : 0;
+    if (buffer.size() >= headroom + record_size) {
+      Buffer encrypted{
+        buffer.data() + headroom,
+        buffer.size() - headroom,
+        /*own_data=*/false
+      };
+      bytes_read = co_await _raw_stream->read(encrypted);
+      res = _client->decrypt({encrypted.data(), bytes_read}, buffer);
+    } else {
+      Buffer encrypted = internal::tls_record_buffers().acquire();
+      bytes_read = co_await _raw_stream->read(encrypted);
+      res = _client->decrypt({encrypted.data(), bytes_read}, buffer);
+      internal::tls_record_buffers().release(std::move(encrypted));
+    }
+    if (res) co_return res.bytes;
+  } while (res.result == internal::TLSResult::NEED_TO_READ && bytes_read > 0);
+
+  if (res.result == internal::TLSResult::NEED_TO_READ) co_return 0;
+  throw Internal() << "Unknown failure decrypting data from the wire.";
 }
 
 co::Future<std::size_t> TLSStream::write(const Buffer& buffer) {
-  internal::TLSIOResult res = _client->buffer_plaintext_data(buffer);
-  if (!res || res.bytes != buffer.size()) {
-    throw Internal() << "Failed to buffer plaintext data into TLS client.";
+  if (_flush_error) {
+    std::rethrow_exception(std::exchange(_flush_error, nullptr));
+  }
+  if (!_coalesce_writes) {
+    co_await _send(buffer);
+    co_return buffer.size();
+  }
+
+  // Data which fills a record on its own gains nothing from being copied.
+  if (buffer.size() >= MAX_RECORD_PLAINTEXT) {
+    co_await _drain(buffer);
+    co_return buffer.size();
+  }
+  while (_pending_size + buffer.size() > MAX_RECORD_PLAINTEXT) {
+    co_await _drain({});
+  }
+
+  if (_pending.empty()) _pending = internal::tls_record_buffers().acquire();
+  std::memcpy(_pending.data() + _pending_size, buffer.data(), buffer.size());
+  _pending_size += buffer.size();
+  if (!_flush_scheduled) {
+    _flush_scheduled = true;
+    co::Scheduler::this_thread().schedule(_flush_next_tick(_alive));
+  }
+  co_return buffer.size();
+}
+
+co::Future<void> TLSStream::flush() {
+  if (_flush_error) {
+    std::rethrow_exception(std::exchange(_flush_error, nullptr));
   }
+  co_await _drain({});
+}
+
+co::Future<void> TLSStream::_send(BufferView data) {
+  if (_kernel_send) {
+    co_await _write_raw(data);
+    co_return;
+  }
+
+  const std::shared_ptr<const bool> alive = _alive;
 
-  // Transfer the encrypted data in a loop. The TLSStream's write buffer might
-  // be smaller than buffer handed in to write.
-  std::size_t bytes_transferred = 0;
-  while (bytes_transferred < buffer.size()) {
-    res = _client->read_encrypted_data(_write_buffer);
-    if (!res) break;
-    co_await _raw_stream->write(
-      {_write_buffer.data(), res.bytes, /*own_data=*/false}
-    );
-    bytes_transferred += res.bytes;
+  std::size_t bytes_buffered = 0;
+  while (bytes_buffered < data.size()) {
+    internal::TLSIOResult res = _client->buffer_plaintext_data({
+      data.data() + bytes_buffered,
+      data.size() - bytes_buffered
+    });
+
+    // The record buffer filled up, send it and retry with the same data.
+    if (res.result == internal::TLSResult::NEED_TO_WRITE) {
+      co_await _flush_encrypted_data();
+      check_alive(alive);
+      continue;
+    }
+    if (!res) {
+      throw Internal() << "Failed to buffer plaintext data into TLS client.";
+    }
+    bytes_buffered += res.bytes;
   }
 
-  co_return bytes_transferred;
+  co_await _flush_encrypted_data();
+}
+
+co::Future<void> TLSStream::_drain(BufferView data) {
+  const std::shared_ptr<const bool> alive = _alive;
+  while (_draining) co_await _drain_finished();
+  _draining = true;
+
+  // Writes made while this drain is sending start a new pending buffer.
+  Buffer pending = std::exchange(_pending, Buffer{});
+  const std::size_t pending_size = std::exchange(_pending_size, 0);
+  try {
+    if (pending_size > 0) co_await _send({pending.data(), pending_size});
+    check_alive(alive);
+    if (!data.empty()) co_await _send(data);
+    check_alive(alive);
+  } catch (...) {
+    if (*alive) {
+      _draining = false;
+      _wake_drain_waiters();
+    }
+    throw;
+  }
+  _draining = false;
+  _wake_drain_waiters();
+  if (!pending.empty()) {
+    internal::tls_record_buffers().release(std::move(pending));
+  }
+}
+
+co::Future<void> TLSStream::_drain_finished() {
+  co::Promise<void> promise;
+  co::Future<void> future = promise.get_future();
+  _drain_waiters.push_back(std::move(promise));
+  return future;
+}
+
+void TLSStream::_wake_drain_waiters() {
+  std::vector<co::Promise<void>> waiters = std::move(_drain_waiters);
+  _drain_waiters.clear();
+  for (co::Promise<void>& waiter : waiters) waiter.set_value();
+}
+
+co::Task TLSStream::_flush_next_tick(std::shared_ptr<const bool> alive) {
+  co_await co::next_tick();
+  if (!*alive) co_return;
+  _flush_scheduled = false;
+
+  // Nobody is waiting on this flush, so failures are reported by the next
+  // write or flush instead.
+  try {
+    co_await _drain({});
+  } catch (...) {
+    if (*alive) _flush_error = std::current_exception();
+  }
 }
 
 TLSStreamFactory::TLSStreamFactory(const TLSOptions& options):
-  _context{internal::TLSContextImpl::from_options(options)}
-{}
+  _context{internal::TLSContextImpl::from_options(options)},
+  _kernel_tls{options.kernel_tls},
+  _coalesce_writes{options.coalesce_writes}
+{
+  if (options.handshake_threads > 0) {
+    _handshake_pool =
+      std::make_unique<co::ThreadPool>(options.handshake_threads);
+  }
+}
 
 TLSStreamFactory::~TLSStreamFactory() {
   // This destructor must be defined in this file where it has access to the
@@ -99,11 +366,22 @@ TLSStreamFactory::~TLSStreamFactory() {
 }
 
 std::unique_ptr<TLSStream> TLSStreamFactory::wrap_stream(
-  std::unique_ptr<io::CoStream> stream
+  std::unique_ptr<io::CoStream> stream,
+  std::string_view server_name
 ) {
   return std::unique_ptr<TLSStream>{
-    new TLSStream{_context->make_client(), std::move(stream)}
+    new TLSStream{
+      _context->make_client(server_name),
+      std::move(stream),
+      _handshake_pool.get(),
+      _kernel_tls,
+      _coalesce_writes
+    }
   };
 }
 
+TLSHandshakeStats TLSStreamFactory::handshake_stats() const {
+  return _context->handshake_stats();
+}
+
 }
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <exception>
 #include <memory>
+#include <string_view>
+#include <vector>
 
 #include "lw/co/future.h"
+#include "lw/co/task.h"
+#include "lw/co/thread_pool.h"
 #include "lw/io/co/co.h"
 #include "lw/memory/buffer.h"
+#include "lw/memory/buffer_view.h"
 #include "lw/net/tls_options.h"
 
 namespace lw::net {
@@ -12,6 +18,7 @@ namespace internal {
 
 class TLSClientImpl;
 class TLSContextImpl;
+enum class TLSResult;
 
 }
 
@@ -29,18 +36,101 @@ public:
 
   co::Future<std::size_t> read(Buffer& buffer) override;
   co::Future<std::size_t> write(const Buffer& buffer) override;
+  co::Future<void> flush() override;
+
+  /**
+   * Returns true once records sent on this stream are encrypted by the kernel.
+   */
+  bool kernel_tls_send() const { return _kernel_send; }
+
+  /**
+   * Returns true once records received on this stream are decrypted by the
+   * kernel.
+   */
+  bool kernel_tls_receive() const { return _kernel_receive; }
+
+  /**
+   * The application protocol agreed on with ALPN during the handshake, or
+   * empty if there was none.
+   */
+  std::string_view alpn_protocol() const;
 
 private:
   friend class TLSStreamFactory;
 
   TLSStream(
     std::unique_ptr<internal::TLSClientImpl> client,
-    std::unique_ptr<io::CoStream> raw_stream
+    std::unique_ptr<io::CoStream> raw_stream,
+    co::ThreadPool* handshake_pool,
+    bool kernel_tls,
+    bool coalesce_writes
   );
 
+  /**
+   * Advances the handshake, on the handshake pool if there is one.
+   */
+  co::Future<internal::TLSResult> _handshake_step();
+
+  /**
+   * Writes all pending encrypted data to the raw stream.
+   */
+  co::Future<void> _flush_encrypted_data();
+
+  /**
+   * Hands the established connection's record keys to the kernel, if the raw
+   * stream is a socket and both the kernel and the cipher support it.
+   */
+  void _start_kernel_tls();
+
+  /**
+   * Moves decryption to the kernel once no received data is left for the SSL
+   * client, as records already read from the socket can only be decrypted in
+   * user space.
+   */
+  void _try_kernel_receive();
+
+  /**
+   * Writes all of `data` to the raw stream.
+   */
+  co::Future<void> _write_raw(BufferView data);
+
+  /**
+   * Encrypts and sends all of `data`.
+   */
+  co::Future<void> _send(BufferView data);
+
+  /**
+   * Sends the held back writes followed by `data`. Only one drain sends at a
+   * time, later ones wait their turn so data leaves in the order written.
+   */
+  co::Future<void> _drain(BufferView data);
+  co::Future<void> _drain_finished();
+  void _wake_drain_waiters();
+
+  /**
+   * Drains the held back writes once the current scheduler tick is over,
+   * unless the stream is gone by then. Draining stops, without touching the
+   * stream again, if it is destroyed part way through.
+   */
+  co::Task _flush_next_tick(std::shared_ptr<const bool> alive);
+
   std::unique_ptr<internal::TLSClientImpl> _client;
   std::unique_ptr<io::CoStream> _raw_stream;
-  Buffer _write_buffer;
+  co::ThreadPool* _handshake_pool = nullptr;
+  bool _kernel_tls = false;
+  bool _kernel_send = false;
+  bool _kernel_receive = false;
+  bool _kernel_receive_pending = false;
+
+  // Plaintext held back by coalesced writes.
+  bool _coalesce_writes = false;
+  Buffer _pending;
+  std::size_t _pending_size = 0;
+  bool _draining = false;
+  std::vector<co::Promise<void>> _drain_waiters;
+  bool _flush_scheduled = false;
+  std::exception_ptr _flush_error = nullptr;
+  std::shared_ptr<bool> _alive = std::make_shared<bool>(true);
 };
 
 class TLSStreamFactory {
@@ -48,10 +138,26 @@ public:
   TLSStreamFactory(const TLSOptions& options);
   ~TLSStreamFactory();
 
-  std::unique_ptr<TLSStream> wrap_stream(std::unique_ptr<io::CoStream> stream);
+  /**
+   * @param server_name
+   *  The hostname to ask the server for when connecting, letting it pick the
+   *  certificate to present.
+   */
+  std::unique_ptr<TLSStream> wrap_stream(
+    std::unique_ptr<io::CoStream> stream,
+    std::string_view server_name = {}
+  );
+
+  /**
+   * Counts of handshakes completed by streams from this factory.
+   */
+  TLSHandshakeStats handshake_stats() const;
 
 private:
   std::unique_ptr<internal::TLSContextImpl> _context;
+  std::unique_ptr<co::ThreadPool> _handshake_pool;
+  bool _kernel_tls = false;
+  bool _coalesce_writes = false;
 };
 
 }
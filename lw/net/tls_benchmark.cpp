@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lw/co/scheduler.h"
+#include "lw/co/task.h"
+#include "lw/io/co/co.h"
+#include "lw/io/co/testing/string_connection.h"
+#include "lw/memory/buffer.h"
+#include "lw/net/socket.h"
+#include "lw/net/testing/tls_credentials.h"
+#include "lw/net/tls.h"
+#include "lw/net/tls_options.h"
+
+namespace lw::net {
+namespace {
+
+using ::std::chrono::nanoseconds;
+using ::std::chrono::steady_clock;
+
+constexpr std::size_t ESTABLISHED_CONNECTIONS = 8;
+constexpr std::size_t STORM_SIZE = 32;
+constexpr std::size_t THROUGHPUT_CHUNK_SIZE = 64 * 1024;
+constexpr std::size_t THROUGHPUT_BYTES = 64 * 1024 * 1024;
+constexpr std::size_t SMALL_RESPONSE_BATCH = 64;
+constexpr std::size_t SMALL_RESPONSE_SIZE = 128;
+
+struct Connection {
+  std::unique_ptr<TLSStream> client;
+  std::unique_ptr<TLSStream> server;
+};
+
+Connection connect(TLSStreamFactory& client, TLSStreamFactory& server) {
+  auto [client_conn, server_conn] =
+    io::testing::CoStringConnection::make_connection();
+  return {
+    .client = client.wrap_stream(std::move(client_conn)),
+    .server = server.wrap_stream(std::move(server_conn))
+  };
+}
+
+co::Task handshake(TLSStream& stream, std::size_t& remaining) {
+  co_await stream.handshake();
+  --remaining;
+}
+
+/**
+ * Sends small requests over an established connection until the storm is
+ * over, recording how long each took to arrive.
+ */
+co::Task ping(
+  Connection& conn,
+  const std::size_t& storm_remaining,
+  std::vector<nanoseconds>& latencies
+) {
+  Buffer request{64};
+  Buffer received{1024};
+  request.copy("ping", 4);
+  do {
+    const steady_clock::time_point start = steady_clock::now();
+    co_await conn.client->write(request);
+    co_await conn.server->read(received);
+    latencies.push_back(steady_clock::now() - start);
+  } while (storm_remaining > 0);
+}
+
+/**
+ * Latency of requests on established connections while a burst of new
+ * connections handshake with the same server, with the server's handshakes
+ * run on `state.range(0)` dedicated threads.
+ */
+void BM_LatencyDuringHandshakeStorm(benchmark::State& state) {
+  // Clients always run on their own pool so that only the server's handshake
+  // work competes with the established connections.
+  TLSStreamFactory client_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::CONNECT,
+    .handshake_threads = 4
+  }};
+  TLSStreamFactory server_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::ACCEPT,
+    .handshake_threads = static_cast<std::size_t>(state.range(0))
+  }};
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+
+  std::vector<Connection> established;
+  std::size_t setup_remaining = ESTABLISHED_CONNECTIONS * 2;
+  for (std::size_t i = 0; i < ESTABLISHED_CONNECTIONS; ++i) {
+    established.push_back(connect(client_factory, server_factory));
+    scheduler.schedule(handshake(*established.back().client, setup_remaining));
+    scheduler.schedule(handshake(*established.back().server, setup_remaining));
+  }
+  scheduler.run();
+
+  std::vector<nanoseconds> latencies;
+  for (auto _ : state) {
+    std::vector<Connection> storm;
+    std::size_t storm_remaining = STORM_SIZE * 2;
+    for (std::size_t i = 0; i < STORM_SIZE; ++i) {
+      storm.push_back(connect(client_factory, server_factory));
+      scheduler.schedule(handshake(*storm.back().client, storm_remaining));
+      scheduler.schedule(handshake(*storm.back().server, storm_remaining));
+    }
+    for (Connection& conn : established) {
+      scheduler.schedule(ping(conn, storm_remaining, latencies));
+    }
+    scheduler.run();
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) {
+    const std::size_t index = static_cast<std::size_t>(
+      p * static_cast<double>(latencies.size() - 1)
+    );
+    return static_cast<double>(latencies[index].count()) / 1000.0;
+  };
+  state.counters["p50_us"] = percentile(0.50);
+  state.counters["p99_us"] = percentile(0.99);
+  state.SetItemsProcessed(state.iterations() * STORM_SIZE);
+}
+BENCHMARK(BM_LatencyDuringHandshakeStorm)
+  ->Arg(0)->Arg(1)->Arg(4)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/**
+ * Resident set size of this process in bytes.
+ */
+std::size_t resident_memory() {
+  std::size_t total_pages = 0;
+  std::size_t resident_pages = 0;
+  std::ifstream{"/proc/self/statm"} >> total_pages >> resident_pages;
+  return resident_pages * 4096;
+}
+
+/**
+ * Memory held by established TLS connections which have gone idle after
+ * exchanging a request, `state.range(0)` at a time. Both ends of every
+ * connection live in this process.
+ */
+void BM_IdleConnectionMemory(benchmark::State& state) {
+  const std::size_t connections = static_cast<std::size_t>(state.range(0));
+  TLSStreamFactory client_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::CONNECT
+  }};
+  TLSStreamFactory server_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::ACCEPT
+  }};
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+
+  auto exchange = [](Connection& conn) -> co::Task {
+    co_await conn.server->handshake();
+    Buffer message{512};
+    message.set_memory('x');
+    co_await conn.client->write(message);
+    std::size_t received = 0;
+    while (received == 0) received = co_await conn.server->read(message);
+  };
+
+  std::size_t growth = 0;
+  for (auto _ : state) {
+    const std::size_t before = resident_memory();
+    std::vector<Connection> established;
+    established.reserve(connections);
+    std::size_t remaining = connections;
+    for (std::size_t i = 0; i < connections; ++i) {
+      established.push_back(connect(client_factory, server_factory));
+      scheduler.schedule(handshake(*established.back().client, remaining));
+      scheduler.schedule(exchange(established.back()));
+    }
+    scheduler.run();
+    growth = resident_memory() - before;
+  }
+
+  state.counters["rss_per_connection_kib"] =
+    static_cast<double>(growth) / connections / 1024.0;
+}
+BENCHMARK(BM_IdleConnectionMemory)
+  ->Arg(256)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+/**
+ * Forwards to another stream, counting the reads made from it.
+ */
+class ReadCountingStream: public io::CoStream {
+public:
+  ReadCountingStream(std::unique_ptr<io::CoStream> stream, std::size_t& reads):
+    _stream{std::move(stream)},
+    _reads{reads}
+  {}
+
+  bool eof() const override { return _stream->eof(); }
+  bool good() const override { return _stream->good(); }
+  void close() override { _stream->close(); }
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    ++_reads;
+    return _stream->read(buffer);
+  }
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    return _stream->write(buffer);
+  }
+
+private:
+  std::unique_ptr<io::CoStream> _stream;
+  std::size_t& _reads;
+};
+
+/**
+ * Connects a client and server over a loopback socket on `port` and completes
+ * their handshakes. If `server_reads` is given, it counts the server's reads
+ * from the socket.
+ */
+Connection connect_sockets(
+  TLSStreamFactory& client_factory,
+  TLSStreamFactory& server_factory,
+  const char* port,
+  std::size_t* server_reads = nullptr
+) {
+  const Address addr{.hostname = "localhost", .service = port};
+  Connection conn;
+  auto accept = [&]() -> co::Task {
+    Socket listener;
+    listener.listen(addr);
+    std::unique_ptr<io::CoStream> socket =
+      std::make_unique<Socket>(co_await listener.accept());
+    if (server_reads) {
+      socket =
+        std::make_unique<ReadCountingStream>(std::move(socket), *server_reads);
+    }
+    conn.server = server_factory.wrap_stream(std::move(socket));
+    co_await conn.server->handshake();
+  };
+  auto connect = [&]() -> co::Task {
+    auto socket = std::make_unique<Socket>();
+    co_await socket->connect(addr);
+    conn.client = client_factory.wrap_stream(std::move(socket));
+    co_await conn.client->handshake();
+  };
+  co::Scheduler::this_thread().schedule(accept);
+  co::Scheduler::this_thread().schedule(connect);
+  co::Scheduler::this_thread().run();
+  return conn;
+}
+
+/**
+ * Bulk transfer from client to server over a loopback socket, with kernel TLS
+ * requested when `state.range(0)` is 1. The `kernel_tls` counter reports
+ * whether the kernel actually took over, as the streams fall back to user
+ * space on kernels without TLS support.
+ */
+void BM_SocketThroughput(benchmark::State& state) {
+  const bool kernel_tls = state.range(0) != 0;
+  TLSStreamFactory client_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::CONNECT,
+    .kernel_tls = kernel_tls
+  }};
+  TLSStreamFactory server_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::ACCEPT,
+    .kernel_tls = kernel_tls
+  }};
+  Connection conn = connect_sockets(client_factory, server_factory, "8444");
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+
+  Buffer chunk{THROUGHPUT_CHUNK_SIZE};
+  Buffer received{THROUGHPUT_CHUNK_SIZE};
+  chunk.set_memory('x');
+  auto send = [&]() -> co::Task {
+    for (std::size_t sent = 0; sent < THROUGHPUT_BYTES; sent += chunk.size()) {
+      co_await conn.client->write(chunk);
+    }
+  };
+  auto receive = [&]() -> co::Task {
+    std::size_t total = 0;
+    while (total < THROUGHPUT_BYTES) {
+      total += co_await conn.server->read(received);
+    }
+  };
+  for (auto _ : state) {
+    scheduler.schedule(send);
+    scheduler.schedule(receive);
+    scheduler.run();
+  }
+
+  state.SetBytesProcessed(state.iterations() * THROUGHPUT_BYTES);
+  state.counters["kernel_tls"] = conn.client->kernel_tls_send() ? 1 : 0;
+}
+BENCHMARK(BM_SocketThroughput)
+  ->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/**
+ * Reads from the socket per MiB received over TLS, with the receiver reading
+ * into a buffer of `state.range(0)` bytes.
+ */
+void BM_ReceiveReadsPerMiB(benchmark::State& state) {
+  TLSStreamFactory client_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::CONNECT
+  }};
+  TLSStreamFactory server_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::ACCEPT
+  }};
+  std::size_t reads = 0;
+  Connection conn =
+    connect_sockets(client_factory, server_factory, "8446", &reads);
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+
+  Buffer chunk{THROUGHPUT_CHUNK_SIZE};
+  Buffer received{static_cast<std::size_t>(state.range(0))};
+  chunk.set_memory('x');
+  auto send = [&]() -> co::Task {
+    for (std::size_t sent = 0; sent < THROUGHPUT_BYTES; sent += chunk.size()) {
+      co_await conn.client->write(chunk);
+    }
+  };
+  auto receive = [&]() -> co::Task {
+    std::size_t total = 0;
+    while (total < THROUGHPUT_BYTES) {
+      total += co_await conn.server->read(received);
+    }
+  };
+  reads = 0;
+  for (auto _ : state) {
+    scheduler.schedule(send);
+    scheduler.schedule(receive);
+    scheduler.run();
+  }
+
+  state.SetBytesProcessed(state.iterations() * THROUGHPUT_BYTES);
+  state.counters["reads_per_mib"] = static_cast<double>(reads) /
+    (state.iterations() * THROUGHPUT_BYTES / (1024.0 * 1024.0));
+}
+BENCHMARK(BM_ReceiveReadsPerMiB)
+  ->Arg(4 * 1024)->Arg(16 * 1024)->Arg(64 * 1024)->Arg(256 * 1024)
+  ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/**
+ * Batches of small responses sent back to back over a keep-alive loopback
+ * socket, as a chatty API answering pipelined requests would. The server
+ * coalesces its writes when `state.range(0)` is 1.
+ */
+void BM_SmallResponses(benchmark::State& state) {
+  TLSStreamFactory client_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::CONNECT
+  }};
+  TLSStreamFactory server_factory{{
+    .private_key = testing::KEY_PATH,
+    .certificate = testing::CERT_PATH,
+    .connection_mode = TLSOptions::ACCEPT,
+    .coalesce_writes = state.range(0) != 0
+  }};
+  Connection conn = connect_sockets(client_factory, server_factory, "8445");
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+
+  Buffer response{SMALL_RESPONSE_SIZE};
+  Buffer received{16 * 1024};
+  response.set_memory('x');
+  auto respond = [&]() -> co::Task {
+    for (std::size_t i = 0; i < SMALL_RESPONSE_BATCH; ++i) {
+      co_await conn.server->write(response);
+    }
+    co_await conn.server->flush();
+  };
+  auto receive = [&]() -> co::Task {
+    std::size_t total = 0;
+    while (total < SMALL_RESPONSE_BATCH * SMALL_RESPONSE_SIZE) {
+      total += co_await conn.client->read(received);
+    }
+  };
+  for (auto _ : state) {
+    scheduler.schedule(respond);
+    scheduler.schedule(receive);
+    scheduler.run();
+  }
+
+  state.SetItemsProcessed(state.iterations() * SMALL_RESPONSE_BATCH);
+  state.SetBytesProcessed(
+    state.iterations() * SMALL_RESPONSE_BATCH * SMALL_RESPONSE_SIZE
+  );
+}
+BENCHMARK(BM_SmallResponses)
+  ->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+}
+}
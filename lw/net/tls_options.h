@@ -1,21 +1,160 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
+#include <vector>
 
 namespace lw::net {
 
+/**
+ * Controls how servers let returning clients skip the full handshake. Ignored
+ * when connecting.
+ */
+struct TLSSessionResumptionOptions {
+  /**
+   * Keep the state of established sessions in a cache shared by every
+   * connection accepted with the same options, keyed by session ID.
+   */
+  bool session_cache = true;
+
+  /**
+   * Maximum number of sessions held by the cache.
+   */
+  std::size_t session_cache_size = 20'000;
+
+  /**
+   * Number of independently locked shards the session cache is split into.
+   */
+  std::size_t session_cache_shards = 16;
+
+  /**
+   * Issue session tickets, which hand the session state to the client
+   * encrypted with a key only the server knows. Resuming from a ticket needs no
+   * server-side storage.
+   */
+  bool session_tickets = true;
+
+  /**
+   * How often a new session ticket encryption key is generated. Tickets issued
+   * with an older key are still accepted until they expire, and are replaced
+   * with one using the current key when resumed.
+   */
+  std::chrono::seconds ticket_key_rotation = std::chrono::hours{12};
+
+  /**
+   * How long after it was established a session may be resumed.
+   */
+  std::chrono::seconds session_lifetime = std::chrono::hours{2};
+};
+
+/**
+ * Counts of completed handshakes by how the session was established.
+ */
+struct TLSHandshakeStats {
+  std::uint64_t full = 0;
+  std::uint64_t resumed = 0;
+};
+
+/**
+ * PEM encoded key material held in memory instead of read from a file.
+ */
+class TLSPem {
+public:
+  explicit TLSPem(std::string pem): _pem{std::move(pem)} {}
+
+  std::string_view data() const { return _pem; }
+
+private:
+  std::string _pem;
+};
+
+/**
+ * A PEM file, or PEM data in memory.
+ */
+typedef std::variant<std::filesystem::path, TLSPem> TLSKeyMaterial;
+
+/**
+ * A certificate, optionally followed by its chain, and its private key.
+ */
+struct TLSCertificate {
+  TLSKeyMaterial private_key;
+  TLSKeyMaterial certificate;
+};
+
 struct TLSOptions {
-  // TODO(alaina): Add utility for self-signed certs in memory and support for
-  // passing a private key here.
-  std::variant<std::filesystem::path> private_key;
-  std::variant<std::filesystem::path> certificate;
+  // TODO(alaina): Add utility for self-signed certs in memory.
+  TLSKeyMaterial private_key;
+  TLSKeyMaterial certificate;
+
+  /**
+   * Certificates for other hostnames, picked by the name clients ask for with
+   * SNI. A name starting with "*." matches any one label in its place. Clients
+   * asking for any other name, or none, get `certificate`. Each is only loaded
+   * the first time a client asks for it. Ignored when connecting.
+   */
+  std::map<std::string, TLSCertificate> certificates;
+
+  /**
+   * How often certificate and key files are checked for changes. Handshakes
+   * after a change use the new files while established connections carry on
+   * with the old ones. When 0, files are never reloaded. Ignored when
+   * connecting.
+   */
+  std::chrono::seconds certificate_reload_interval{0};
 
   enum ConnectionMode {
     CONNECT,  // Initiator of TLS connection.
     ACCEPT    // Acceptor of TLS connection.
   };
   ConnectionMode connection_mode = CONNECT;
+
+  enum Version {
+    TLS_1_2,
+    TLS_1_3
+  };
+  Version max_version = TLS_1_3;
+
+  TLSSessionResumptionOptions session_resumption;
+
+  /**
+   * Number of dedicated threads which run the cryptographic steps of
+   * handshakes, such as signing with the private key. This keeps a burst of new
+   * connections from stalling established ones on the same scheduler. When 0,
+   * handshakes run inline on the connection's scheduler thread.
+   */
+  std::size_t handshake_threads = 0;
+
+  /**
+   * Hand record encryption to the kernel once the handshake completes, so sent
+   * data goes straight to the socket. Servers also hand it record decryption.
+   * Only TLS 1.3 connections using AES-GCM over a `Socket` are offloaded, any
+   * other connection silently keeps encrypting in user space, as do all of them
+   * if the kernel lacks TLS support.
+   */
+  bool kernel_tls = false;
+
+  /**
+   * Combine small writes into full size records. Written data is held back
+   * until a record fills, the current scheduler tick ends, or `flush()` is
+   * called, so that many small responses cost one record and one send. Flush
+   * before closing or destroying the stream, or held data is lost.
+   */
+  bool coalesce_writes = false;
+
+  /**
+   * Application protocols to negotiate with ALPN, most preferred first, such
+   * as "h2" and "http/1.1". Servers pick the first of theirs which the client
+   * also offers, and carry on without one if there are none in common.
+   * Clients offer all of them.
+   */
+  std::vector<std::string> alpn_protocols;
 };
 
 }
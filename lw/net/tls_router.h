@@ -1,6 +1,10 @@
 #pragma once
 
+#include <chrono>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "lw/co/await.h"
 #include "lw/co/future.h"
@@ -20,10 +24,16 @@ co::Future<std::unique_ptr<net::TLSStream>> tls_wrap_connection(
 }
 
 struct TLSRouterOptions {
-  // TODO(alaina): Add utility for self-signed certs in memory and support for
-  // passing a private key here.
-  std::variant<std::filesystem::path> private_key;
-  std::variant<std::filesystem::path> certificate;
+  // TODO(alaina): Add utility for self-signed certs in memory.
+  TLSKeyMaterial private_key;
+  TLSKeyMaterial certificate;
+  std::map<std::string, TLSCertificate> certificates;
+  std::chrono::seconds certificate_reload_interval{0};
+  TLSSessionResumptionOptions session_resumption;
+  std::size_t handshake_threads = 0;
+  bool kernel_tls = false;
+  bool coalesce_writes = false;
+  std::vector<std::string> alpn_protocols;
 };
 
 template <typename BaseRouter, typename Options = ::lw::net::TLSRouterOptions>
@@ -37,7 +47,10 @@ public:
     _tls_factory{{
       .private_key = options.tls.private_key,
       .certificate = options.tls.certificate,
-      .connection_mode = TLSOptions::ACCEPT
+      .certificates = options.tls.certificates,
+      .certificate_reload_interval = options.tls.certificate_reload_interval,
+      .connection_mode = TLSOptions::ACCEPT,
+      .alpn_protocols = options.tls.alpn_protocols
     }}
   {}
 
@@ -49,6 +62,10 @@ public:
     return _router.connection_count();
   }
 
+  TLSHandshakeStats handshake_stats() const {
+    return _tls_factory.handshake_stats();
+  }
+
   co::Task run(std::unique_ptr<io::CoStream> conn) override {
     auto tls_conn = co_await internal::tls_wrap_connection(
       _tls_factory,
@@ -73,7 +90,14 @@ public:
     _tls_factory{{
       .private_key = options.private_key,
       .certificate = options.certificate,
-      .connection_mode = TLSOptions::ACCEPT
+      .certificates = options.certificates,
+      .certificate_reload_interval = options.certificate_reload_interval,
+      .connection_mode = TLSOptions::ACCEPT,
+      .session_resumption = options.session_resumption,
+      .handshake_threads = options.handshake_threads,
+      .kernel_tls = options.kernel_tls,
+      .coalesce_writes = options.coalesce_writes,
+      .alpn_protocols = options.alpn_protocols
     }}
   {}
 
@@ -85,6 +109,10 @@ public:
     return _router.connection_count();
   }
 
+  TLSHandshakeStats handshake_stats() const {
+    return _tls_factory.handshake_stats();
+  }
+
   co::Task run(std::unique_ptr<io::CoStream> conn) override {
     auto tls_conn = co_await internal::tls_wrap_connection(
       _tls_factory,
@@ -2,11 +2,16 @@
 
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "lw/co/future.h"
 #include "lw/co/scheduler.h"
 #include "lw/co/testing/destroy_scheduler.h"
+#include "lw/err/canonical.h"
 #include "lw/io/co/testing/string_connection.h"
 #include "lw/io/co/testing/string_stream.h"
+#include "lw/net/socket.h"
 #include "lw/net/testing/tls_credentials.h"
 #include "lw/net/tls_options.h"
 #include "gtest/gtest.h"
@@ -82,7 +87,10 @@ TEST_F(TLSStreamTest, CanSendDataFromServerToClient) {
   scheduler().schedule([&]() -> co::Task {
     co_await _client->handshake();
     Buffer buff{10};
-    std::size_t read = co_await _client->read(buff);
+    // String connections do not wait for data, so this may first return with
+    // only the server's session tickets consumed.
+    std::size_t read = 0;
+    while (read == 0) read = co_await _client->read(buff);
     EXPECT_EQ(read, 6);
     EXPECT_EQ(static_cast<std::string_view>(buff).substr(0, 6), "foobar");
   });
@@ -96,5 +104,380 @@ TEST_F(TLSStreamTest, CanSendDataFromServerToClient) {
   scheduler().run();
 }
 
+TEST_F(TLSStreamTest, ReadsManyRecordsIntoLargeBuffers) {
+  // Odd sizes leave partial records behind between reads.
+  std::string message(200 * 1024 + 17, '\0');
+  for (std::size_t i = 0; i < message.size(); ++i) {
+    message[i] = static_cast<char>(i % 251);
+  }
+  std::string received;
+  scheduler().schedule([&]() -> co::Task {
+    co_await _client->handshake();
+    Buffer buff{message.size()};
+    buff.copy(message.data(), message.size());
+    co_await _client->write(buff);
+  });
+  scheduler().schedule([&]() -> co::Task {
+    co_await _server->handshake();
+    Buffer buff{40 * 1024 + 3};
+    while (received.size() < message.size()) {
+      const std::size_t read = co_await _server->read(buff);
+      received += static_cast<std::string_view>(buff).substr(0, read);
+    }
+  });
+  scheduler().run();
+
+  EXPECT_EQ(received.size(), message.size());
+  EXPECT_TRUE(received == message);
+}
+
+TEST(TLSHandshakePool, HandshakesOnThreadPool) {
+  TLSStreamFactory client_factory{{
+      .private_key = testing::KEY_PATH,
+      .certificate = testing::CERT_PATH,
+      .connection_mode = TLSOptions::CONNECT,
+      .handshake_threads = 1}};
+  TLSStreamFactory server_factory{{
+      .private_key = testing::KEY_PATH,
+      .certificate = testing::CERT_PATH,
+      .connection_mode = TLSOptions::ACCEPT,
+      .handshake_threads = 2}};
+  auto [client_conn, server_conn] =
+      io::testing::CoStringConnection::make_connection();
+  auto client = client_factory.wrap_stream(std::move(client_conn));
+  auto server = server_factory.wrap_stream(std::move(server_conn));
+
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+  scheduler.schedule([&]() -> co::Task {
+    co_await client->handshake();
+    Buffer buff{6};
+    buff.copy("foobar", 6);
+    co_await client->write(buff);
+  });
+  scheduler.schedule([&]() -> co::Task {
+    co_await server->handshake();
+    Buffer buff{10};
+    std::size_t read = co_await server->read(buff);
+    EXPECT_EQ(read, 6);
+    EXPECT_EQ(static_cast<std::string_view>(buff).substr(0, 6), "foobar");
+  });
+  scheduler.run();
+
+  EXPECT_EQ(server_factory.handshake_stats().full, 1);
+  co::testing::destroy_all_schedulers();
+}
+
+// -------------------------------------------------------------------------- //
+
+class TLSKernelOffloadTest : public ::testing::Test {
+protected:
+  TLSKernelOffloadTest()
+      : _client_factory{{
+            .private_key = testing::KEY_PATH,
+            .certificate = testing::CERT_PATH,
+            .connection_mode = TLSOptions::CONNECT,
+            .kernel_tls = true}},
+        _server_factory{{
+            .private_key = testing::KEY_PATH,
+            .certificate = testing::CERT_PATH,
+            .connection_mode = TLSOptions::ACCEPT,
+            .kernel_tls = true}} {}
+
+  ~TLSKernelOffloadTest() { co::testing::destroy_all_schedulers(); }
+
+  /**
+   * Sends a message each way once both ends have finished handshaking.
+   */
+  static co::Future<void> exchange(TLSStream& stream, std::string_view message) {
+    co_await stream.handshake();
+    Buffer out{message.size()};
+    out.copy(message.data(), message.size());
+    EXPECT_EQ(co_await stream.write(out), message.size());
+
+    Buffer in{64};
+    std::size_t read = 0;
+    while (read == 0) read = co_await stream.read(in);
+    EXPECT_EQ(read, message.size());
+  }
+
+  TLSStreamFactory _client_factory;
+  TLSStreamFactory _server_factory;
+};
+
+TEST_F(TLSKernelOffloadTest, FallsBackWithoutSocket) {
+  auto [client_conn, server_conn] =
+      io::testing::CoStringConnection::make_connection();
+  auto client = _client_factory.wrap_stream(std::move(client_conn));
+  auto server = _server_factory.wrap_stream(std::move(server_conn));
+
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+  scheduler.schedule(
+      [&]() -> co::Task { co_await exchange(*client, "foobar"); });
+  scheduler.schedule(
+      [&]() -> co::Task { co_await exchange(*server, "barfoo"); });
+  scheduler.run();
+
+  EXPECT_FALSE(client->kernel_tls_send());
+  EXPECT_FALSE(server->kernel_tls_send());
+  EXPECT_FALSE(server->kernel_tls_receive());
+}
+
+TEST_F(TLSKernelOffloadTest, ExchangesDataOverSockets) {
+  // Kernel TLS is used if this machine supports it, otherwise the streams fall
+  // back to user space. Data must flow the same either way.
+  Address addr{.hostname = "localhost", .service = "8443"};
+  std::unique_ptr<TLSStream> client;
+  std::unique_ptr<TLSStream> server;
+
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+  scheduler.schedule([&]() -> co::Task {
+    Socket listener;
+    listener.listen(addr);
+    server = _server_factory.wrap_stream(
+        std::make_unique<Socket>(co_await listener.accept()));
+    co_await exchange(*server, "barfoo");
+  });
+  scheduler.schedule([&]() -> co::Task {
+    auto socket = std::make_unique<Socket>();
+    co_await socket->connect(addr);
+    client = _client_factory.wrap_stream(std::move(socket));
+    co_await exchange(*client, "foobar");
+  });
+  scheduler.run();
+
+  ASSERT_NE(client, nullptr);
+  ASSERT_NE(server, nullptr);
+  EXPECT_FALSE(client->kernel_tls_receive());
+  EXPECT_EQ(client->kernel_tls_send(), server->kernel_tls_send());
+}
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * Forwards to another stream, counting the writes made to it. Deferred writes
+ * resolve a tick after being made, like a socket waiting for room to send.
+ */
+class CountingStream : public io::CoStream {
+public:
+  CountingStream(std::unique_ptr<io::CoStream> stream, std::size_t& writes)
+      : _stream{std::move(stream)}, _writes{writes} {}
+
+  bool eof() const override { return _stream->eof(); }
+  bool good() const override { return _stream->good(); }
+  void close() override { _stream->close(); }
+
+  co::Future<std::size_t> read(Buffer& buffer) override {
+    return _stream->read(buffer);
+  }
+
+  co::Future<std::size_t> write(const Buffer& buffer) override {
+    ++_writes;
+    if (!defer_writes) return _stream->write(buffer);
+    return _deferred_write(_stream->write(buffer));
+  }
+
+  bool defer_writes = false;
+
+private:
+  static co::Future<std::size_t> _deferred_write(
+      co::Future<std::size_t> write) {
+    const std::size_t written = co_await write;
+    co_await co::next_tick();
+    co_return written;
+  }
+
+  std::unique_ptr<io::CoStream> _stream;
+  std::size_t& _writes;
+};
+
+class TLSWriteCoalescingTest : public ::testing::Test {
+protected:
+  TLSWriteCoalescingTest()
+      : _client_factory{{
+            .private_key = testing::KEY_PATH,
+            .certificate = testing::CERT_PATH,
+            .connection_mode = TLSOptions::CONNECT,
+            .coalesce_writes = true}},
+        _server_factory{{
+            .private_key = testing::KEY_PATH,
+            .certificate = testing::CERT_PATH,
+            .connection_mode = TLSOptions::ACCEPT}} {
+    auto [client, server] = io::testing::CoStringConnection::make_connection();
+    auto counting =
+        std::make_unique<CountingStream>(std::move(client), _client_writes);
+    _client_raw = counting.get();
+    _client = _client_factory.wrap_stream(std::move(counting));
+    _server = _server_factory.wrap_stream(std::move(server));
+  }
+
+  ~TLSWriteCoalescingTest() { co::testing::destroy_all_schedulers(); }
+
+  co::Scheduler& scheduler() const { return co::Scheduler::this_thread(); }
+
+  static co::Future<void> write(TLSStream& stream, std::string_view data) {
+    Buffer buff{data.size()};
+    buff.copy(data.data(), data.size());
+    EXPECT_EQ(co_await stream.write(buff), data.size());
+  }
+
+  static co::Future<std::string> read_all(
+      TLSStream& stream, std::size_t size) {
+    std::string received;
+    Buffer buff{size};
+    while (received.size() < size) {
+      const std::size_t read = co_await stream.read(buff);
+      received += static_cast<std::string_view>(buff).substr(0, read);
+    }
+    co_return received;
+  }
+
+  TLSStreamFactory _client_factory;
+  TLSStreamFactory _server_factory;
+  std::size_t _client_writes = 0;
+  CountingStream* _client_raw = nullptr;
+  std::unique_ptr<TLSStream> _client;
+  std::unique_ptr<TLSStream> _server;
+};
+
+TEST_F(TLSWriteCoalescingTest, CombinesWritesIntoOneSend) {
+  std::size_t sends = 0;
+  std::string received;
+  scheduler().schedule([&]() -> co::Task {
+    co_await _client->handshake();
+    const std::size_t handshake_writes = _client_writes;
+    co_await write(*_client, "foo");
+    co_await write(*_client, "bar");
+    co_await write(*_client, "baz");
+    EXPECT_EQ(_client_writes, handshake_writes);
+    co_await _client->flush();
+    sends = _client_writes - handshake_writes;
+  });
+  scheduler().schedule([&]() -> co::Task {
+    co_await _server->handshake();
+    received = co_await read_all(*_server, 9);
+  });
+  scheduler().run();
+
+  EXPECT_EQ(sends, 1);
+  EXPECT_EQ(received, "foobarbaz");
+}
+
+TEST_F(TLSWriteCoalescingTest, SendsHeldDataAfterTheTick) {
+  std::string received;
+  scheduler().schedule([&]() -> co::Task {
+    co_await _client->handshake();
+    co_await write(*_client, "hello");
+  });
+  scheduler().schedule([&]() -> co::Task {
+    co_await _server->handshake();
+    received = co_await read_all(*_server, 5);
+  });
+  scheduler().run();
+
+  EXPECT_EQ(received, "hello");
+}
+
+TEST_F(TLSWriteCoalescingTest, KeepsOrderAroundLargeWrites) {
+  const std::string large(40 * 1024, 'b');
+  const std::string expected = "a" + large + "c";
+  std::string received;
+  scheduler().schedule([&]() -> co::Task {
+    co_await _client->handshake();
+    co_await write(*_client, "a");
+    co_await write(*_client, large);
+    co_await write(*_client, "c");
+    co_await _client->flush();
+  });
+  scheduler().schedule([&]() -> co::Task {
+    co_await _server->handshake();
+    received = co_await read_all(*_server, expected.size());
+  });
+  scheduler().run();
+
+  EXPECT_EQ(received, expected);
+}
+
+TEST_F(TLSWriteCoalescingTest, StopsHeldFlushWhenDestroyed) {
+  std::size_t writes_at_destruction = 0;
+  auto client = [&]() -> co::Task {
+    co_await _client->handshake();
+    _client_raw->defer_writes = true;
+    co_await write(*_client, "hello");
+
+    // The held flush starts sending two ticks later, then is still waiting on
+    // the wire when the stream is destroyed.
+    co_await co::next_tick();
+    co_await co::next_tick();
+    writes_at_destruction = _client_writes;
+    _client.reset();
+  };
+  auto server = [&]() -> co::Task { co_await _server->handshake(); };
+  scheduler().schedule(client);
+  scheduler().schedule(server);
+  scheduler().run();
+
+  EXPECT_EQ(_client_writes, writes_at_destruction);
+}
+
+// -------------------------------------------------------------------------- //
+
+/**
+ * Handshakes a client offering `client_protocols` with a server supporting
+ * `server_protocols`, returning the protocol each end agreed on.
+ */
+std::pair<std::string, std::string> negotiate_alpn(
+    std::vector<std::string> client_protocols,
+    std::vector<std::string> server_protocols) {
+  TLSStreamFactory client_factory{{
+      .private_key = testing::KEY_PATH,
+      .certificate = testing::CERT_PATH,
+      .connection_mode = TLSOptions::CONNECT,
+      .alpn_protocols = std::move(client_protocols)}};
+  TLSStreamFactory server_factory{{
+      .private_key = testing::KEY_PATH,
+      .certificate = testing::CERT_PATH,
+      .connection_mode = TLSOptions::ACCEPT,
+      .alpn_protocols = std::move(server_protocols)}};
+  auto [client_conn, server_conn] =
+      io::testing::CoStringConnection::make_connection();
+  auto client = client_factory.wrap_stream(std::move(client_conn));
+  auto server = server_factory.wrap_stream(std::move(server_conn));
+
+  co::Scheduler& scheduler = co::Scheduler::this_thread();
+  scheduler.schedule([&]() -> co::Task { co_await client->handshake(); });
+  scheduler.schedule([&]() -> co::Task { co_await server->handshake(); });
+  scheduler.run();
+  return {
+      std::string{client->alpn_protocol()},
+      std::string{server->alpn_protocol()}};
+}
+
+TEST(TLSAlpn, PrefersServerOrder) {
+  EXPECT_EQ(
+      negotiate_alpn({"http/1.1", "h2"}, {"h2", "http/1.1"}),
+      std::make_pair(std::string{"h2"}, std::string{"h2"}));
+  EXPECT_EQ(
+      negotiate_alpn({"http/1.1"}, {"h2", "http/1.1"}),
+      std::make_pair(std::string{"http/1.1"}, std::string{"http/1.1"}));
+}
+
+TEST(TLSAlpn, ContinuesWithoutCommonProtocol) {
+  EXPECT_EQ(
+      negotiate_alpn({"spdy/3"}, {"h2"}),
+      std::make_pair(std::string{}, std::string{}));
+  EXPECT_EQ(
+      negotiate_alpn({}, {"h2"}),
+      std::make_pair(std::string{}, std::string{}));
+}
+
+TEST(TLSAlpn, RejectsInvalidProtocolNames) {
+  EXPECT_THROW(
+      TLSStreamFactory({
+          .private_key = testing::KEY_PATH,
+          .certificate = testing::CERT_PATH,
+          .alpn_protocols = {""}}),
+      InvalidArgument);
+}
+
 } // namespace
 } // namespace lw::net